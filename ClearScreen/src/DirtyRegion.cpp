@@ -0,0 +1,250 @@
+#include "DirtyRegion.h"
+
+#include <algorithm>
+
+DirtyRect Intersect(const DirtyRect &a, const DirtyRect &b) {
+    return { (std::max)(a.left, b.left), (std::max)(a.top, b.top), (std::min)(a.right, b.right), (std::min)(a.bottom, b.bottom) };
+}
+
+DirtyRect GetBounds(const DirtyRect &a, const DirtyRect &b) {
+    if (IsEmpty(a)) {
+        return b;
+    }
+    if (IsEmpty(b)) {
+        return a;
+    }
+    return { (std::min)(a.left, b.left), (std::min)(a.top, b.top), (std::max)(a.right, b.right), (std::max)(a.bottom, b.bottom) };
+}
+
+DirtyRect Offset(const DirtyRect &rect, int32_t x, int32_t y) {
+    return { rect.left + x, rect.top + y, rect.right + x, rect.bottom + y };
+}
+
+void Subtract(const DirtyRect &rect, const DirtyRect &cut, std::vector<DirtyRect> &out) {
+    DirtyRect overlap = Intersect(rect, cut);
+    if (IsEmpty(overlap)) {
+        if (!IsEmpty(rect)) {
+            out.push_back(rect);
+        }
+        return;
+    }
+
+    // Full-width bands above and below the overlap, then the sides within its rows.
+    if (rect.top < overlap.top) {
+        out.push_back({ rect.left, rect.top, rect.right, overlap.top });
+    }
+    if (overlap.bottom < rect.bottom) {
+        out.push_back({ rect.left, overlap.bottom, rect.right, rect.bottom });
+    }
+    if (rect.left < overlap.left) {
+        out.push_back({ rect.left, overlap.top, overlap.left, overlap.bottom });
+    }
+    if (overlap.right < rect.right) {
+        out.push_back({ overlap.right, overlap.top, rect.right, overlap.bottom });
+    }
+}
+
+DirtyRegion::DirtyRegion(int32_t width, int32_t height) {
+    Reset(width, height);
+}
+
+void DirtyRegion::Reset(int32_t width, int32_t height) {
+    this->width = width;
+    this->height = height;
+    rects.clear();
+}
+
+void DirtyRegion::Add(const DirtyRect &rect) {
+    DirtyRect clipped = Intersect(rect, GetSurface());
+    if (::IsEmpty(clipped)) {
+        return;
+    }
+
+    // Only the parts not covered yet are added.
+    pieces.assign(1, clipped);
+    for (const DirtyRect &existing : rects) {
+        nextPieces.clear();
+        for (const DirtyRect &piece : pieces) {
+            ::Subtract(piece, existing, nextPieces);
+        }
+        pieces.swap(nextPieces);
+        if (pieces.empty()) {
+            return;
+        }
+    }
+    rects.insert(rects.end(), pieces.begin(), pieces.end());
+
+    while (rects.size() > MaxRects) {
+        MergeCheapestPair();
+    }
+}
+
+void DirtyRegion::Add(const DirtyRegion &region) {
+    for (const DirtyRect &rect : region.rects) {
+        Add(rect);
+    }
+}
+
+bool DirtyRegion::IsAll() const {
+    return GetArea() == int64_t(width) * height;
+}
+
+bool DirtyRegion::Intersects(const DirtyRect &rect) const {
+    for (const DirtyRect &existing : rects) {
+        if (!::IsEmpty(Intersect(existing, rect))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t DirtyRegion::GetArea() const {
+    int64_t area = 0;
+    for (const DirtyRect &rect : rects) {
+        area += ::GetArea(rect);
+    }
+    return area;
+}
+
+void DirtyRegion::Subtract(const DirtyRect &cut) {
+    pieces.clear();
+    for (const DirtyRect &rect : rects) {
+        ::Subtract(rect, cut, pieces);
+    }
+    rects.swap(pieces);
+    while (rects.size() > MaxRects) {
+        MergeCheapestPair();
+    }
+}
+
+void DirtyRegion::MergeCheapestPair() {
+    size_t first = 0;
+    size_t second = 1;
+    int64_t bestWaste = INT64_MAX;
+    for (size_t i = 0; i < rects.size(); i++) {
+        for (size_t j = i + 1; j < rects.size(); j++) {
+            int64_t waste = ::GetArea(GetBounds(rects[i], rects[j])) - ::GetArea(rects[i]) - ::GetArea(rects[j]);
+            if (waste < bestWaste) {
+                bestWaste = waste;
+                first = i;
+                second = j;
+            }
+        }
+    }
+
+    // The bounds may cover other rectangles; they are absorbed until none overlaps, so
+    // the count always drops.
+    DirtyRect merged = GetBounds(rects[first], rects[second]);
+    rects.erase(rects.begin() + second);
+    rects.erase(rects.begin() + first);
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        for (size_t i = 0; i < rects.size(); i++) {
+            if (!::IsEmpty(Intersect(rects[i], merged))) {
+                merged = GetBounds(merged, rects[i]);
+                rects.erase(rects.begin() + i);
+                grown = true;
+                break;
+            }
+        }
+    }
+    rects.push_back(merged);
+}
+
+void PresentPlanner::SubtractAll(std::vector<DirtyRect> &rects, const DirtyRect &cut) {
+    pieces.clear();
+    for (const DirtyRect &rect : rects) {
+        Subtract(rect, cut, pieces);
+    }
+    rects.swap(pieces);
+}
+
+void PresentPlanner::Reset(int32_t width, int32_t height, uint32_t bufferCount) {
+    this->width = width;
+    this->height = height;
+    // Buffers start with undefined contents.
+    stale.assign(bufferCount, DirtyRegion(width, height));
+    for (DirtyRegion &region : stale) {
+        region.AddAll();
+    }
+    hasPrevious = false;
+    stats = { };
+}
+
+bool PresentPlanner::Plan(uint32_t buffer, const DirtyRegion &changes, const ScrollMove *scroll, PresentPlan &plan) {
+    bool scrolling = scroll && (scroll->x != 0 || scroll->y != 0) && !IsEmpty(scroll->rect);
+    if (changes.IsEmpty() && !scrolling) {
+        stats.skippedFrames++;
+        return false;
+    }
+
+    plan.copies.clear();
+    plan.scrolled = false;
+    plan.scrollRect = { };
+    plan.scrollX = 0;
+    plan.scrollY = 0;
+    plan.redraw.Reset(width, height);
+    plan.redraw.Add(changes);
+
+    // Without a complete previous frame there is nothing to copy from.
+    if (!hasPrevious) {
+        plan.redraw.AddAll();
+    }
+
+    if (scrolling && !plan.redraw.IsAll()) {
+        DirtyRect rect = Intersect(scroll->rect, plan.redraw.GetSurface());
+        DirtyRect destination = Intersect(rect, Offset(rect, scroll->x, scroll->y));
+        if (!IsEmpty(destination) && !plan.redraw.Intersects(destination)) {
+            plan.scrolled = true;
+            // The part of the rectangle that scrolled in is drawn.
+            pieces.clear();
+            Subtract(rect, destination, pieces);
+            for (const DirtyRect &piece : pieces) {
+                plan.redraw.Add(piece);
+            }
+        }
+        // Merging rectangles may have grown the drawn part over the scroll.
+        if (!plan.scrolled || plan.redraw.Intersects(destination)) {
+            plan.scrolled = false;
+            plan.redraw.Add(rect);
+        } else {
+            plan.scrollRect = destination;
+            plan.scrollX = scroll->x;
+            plan.scrollY = scroll->y;
+        }
+    }
+
+    // Stale parts of this buffer that the frame does not overwrite anyway. They are cut
+    // exactly, without merging, so no copy overlaps the scroll.
+    if (hasPrevious) {
+        plan.copies = stale[buffer].GetRects();
+        for (const DirtyRect &rect : plan.redraw.GetRects()) {
+            SubtractAll(plan.copies, rect);
+        }
+        if (plan.scrolled) {
+            SubtractAll(plan.copies, plan.scrollRect);
+        }
+    }
+
+    // Everything presented now is missing from the other buffers.
+    for (uint32_t i = 0; i < (uint32_t) stale.size(); i++) {
+        if (i != buffer) {
+            stale[i].Add(plan.redraw);
+            if (plan.scrolled) {
+                stale[i].Add(plan.scrollRect);
+            }
+        }
+    }
+    stale[buffer].Clear();
+    hasPrevious = true;
+
+    stats.presentedFrames++;
+    stats.redrawnPixels += (uint64_t) plan.redraw.GetArea();
+    stats.scrolledPixels += (uint64_t) GetArea(plan.scrollRect);
+    for (const DirtyRect &rect : plan.copies) {
+        stats.copiedPixels += (uint64_t) GetArea(rect);
+    }
+    stats.surfacePixels += uint64_t(width) * height;
+    return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Same layout as RECT; right and bottom are exclusive.
+struct DirtyRect {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+inline bool IsEmpty(const DirtyRect &rect) {
+    return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+inline int64_t GetArea(const DirtyRect &rect) {
+    return IsEmpty(rect) ? 0 : int64_t(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+DirtyRect Intersect(const DirtyRect &a, const DirtyRect &b);
+DirtyRect GetBounds(const DirtyRect &a, const DirtyRect &b);
+DirtyRect Offset(const DirtyRect &rect, int32_t x, int32_t y);
+
+// Appends the parts of rect outside cut to out, at most four.
+void Subtract(const DirtyRect &rect, const DirtyRect &cut, std::vector<DirtyRect> &out);
+
+// Disjoint rectangles inside a surface. Added rectangles are clipped to the surface and
+// split against the ones already there, so the area is exact. Above MaxRects, the two
+// rectangles whose bounds waste the fewest pixels are merged.
+class DirtyRegion {
+public:
+    static constexpr uint32_t MaxRects = 8;
+
+    DirtyRegion() = default;
+    DirtyRegion(int32_t width, int32_t height);
+
+    void Reset(int32_t width, int32_t height);
+    void Clear() { rects.clear(); }
+
+    void Add(const DirtyRect &rect);
+    void Add(const DirtyRegion &region);
+    void AddAll() { rects.assign(1, GetSurface()); }
+
+    bool IsEmpty() const { return rects.empty(); }
+    bool IsAll() const;
+    bool Intersects(const DirtyRect &rect) const;
+    int64_t GetArea() const;
+
+    // The region outside cut.
+    void Subtract(const DirtyRect &cut);
+
+    DirtyRect GetSurface() const { return { 0, 0, width, height }; }
+    const std::vector<DirtyRect> &GetRects() const { return rects; }
+
+private:
+    void MergeCheapestPair();
+
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<DirtyRect> rects;
+    std::vector<DirtyRect> pieces;
+    std::vector<DirtyRect> nextPieces;
+};
+
+// Content of rect moved by (x, y) since the previous frame. Anything drawn over the
+// rectangle that does not move with it must be part of the frame's changes.
+struct ScrollMove {
+    DirtyRect rect;
+    int32_t x;
+    int32_t y;
+};
+
+// How to bring the current back buffer up to date from the previous one.
+struct PresentPlan {
+    std::vector<DirtyRect> copies; // Copied from the previous back buffer at the same place.
+    bool scrolled;
+    DirtyRect scrollRect;          // Copied from scrollRect - (scrollX, scrollY) of the previous back buffer.
+    int32_t scrollX;
+    int32_t scrollY;
+    DirtyRegion redraw;            // Drawn this frame; the dirty rectangles of the present.
+};
+
+struct PresentStats {
+    uint64_t presentedFrames;
+    uint64_t skippedFrames;
+    uint64_t redrawnPixels;
+    uint64_t scrolledPixels;
+    uint64_t copiedPixels;
+    uint64_t surfacePixels;        // Presented frames times the surface size.
+};
+
+// Partial presentation with a flip-sequential swap chain, where each back buffer keeps
+// the frame it last showed. Every buffer collects the changes presented since then; a
+// frame copies the stale parts from the previous buffer, which is always complete,
+// scrolls with a copy from it, and only draws what the scene changed. A scroll that a
+// change overlaps is dropped in favour of drawing its rectangle.
+class PresentPlanner {
+public:
+    void Reset(int32_t width, int32_t height, uint32_t bufferCount);
+
+    // changes is what the scene changed since the last presented frame. Returns false,
+    // and counts a skipped frame, when there is nothing to present.
+    bool Plan(uint32_t buffer, const DirtyRegion &changes, const ScrollMove *scroll, PresentPlan &plan);
+
+    const PresentStats &GetStats() const { return stats; }
+
+private:
+    void SubtractAll(std::vector<DirtyRect> &rects, const DirtyRect &cut);
+
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<DirtyRegion> stale; // Per buffer, what changed since it was presented.
+    bool hasPrevious = false;
+    std::vector<DirtyRect> pieces;
+    PresentStats stats = { };
+};
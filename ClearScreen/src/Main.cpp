@@ -2,22 +2,28 @@
 #include <dxgi1_6.h>
 #include <wrl.h>
 
+#include "Log.h"
+#include "DirtyRegion.h"
+
 using Microsoft::WRL::ComPtr;
 
-inline void ThrowIfFailed(HRESULT hr, LPCWSTR file, int line) {
+inline void ThrowIfFailed(HRESULT hr, const LogSite &site) {
     if (FAILED(hr)) {
-        TCHAR buffer[256];
-        wsprintf(buffer, TEXT("\nFILE:[%s]\nLINE:[%d]\n\n"), file, line);
-        OutputDebugString(buffer);
+        WriteLog(site, hr);
+        FlushLog();
         throw hr;
     }
 }
 
-#define ThrowIfFailed(hr) ThrowIfFailed(hr, __FILEW__, __LINE__);
+#define ThrowIfFailed(hr) do { static constexpr LogSite throwSite = { LogLevel::Error, __FILE__, __LINE__, "Failed with %H" }; ThrowIfFailed(hr, throwSite); } while (0)
 
 constexpr UINT Width = 640;
 constexpr UINT Height = 480;
 constexpr UINT FrameCount = 2;
+constexpr LONG TickerHeight = 32;
+constexpr LONG TickerStripeWidth = 40;
+constexpr LONG TickerSpeed = 2; // Pixels per frame.
+constexpr LONG CursorSize = 24;
 
 // Win32 objects.
 HINSTANCE hInstance;
@@ -39,13 +45,35 @@ UINT64 fenceValue;
 HANDLE fenceEvent;
 UINT frameIndex;
 
+// Scene. Space pauses the background animation, T pauses the ticker at the bottom, and a
+// box follows the mouse.
+bool animating = true;
 bool upping[] = { true, true, true };
 float color[] = { 1.0f, 0.5f, 0.0f, 1.0f };
+bool tickerRunning = true;
+LONG tickerOffset = 0;
+const float tickerColors[][4] = { { 0.1f, 0.1f, 0.1f, 1.0f }, { 0.9f, 0.9f, 0.9f, 1.0f } };
+POINT cursorPosition = { -CursorSize, -CursorSize };
+DirtyRect cursorBox = { };  // Where the box was last drawn.
+const float cursorColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+// Change tracking. Frames without changes are skipped; the others redraw only what
+// changed and present it with dirty and scroll rectangles.
+DirtyRegion frameChanges(Width, Height);
+bool tickerScrolled;
+PresentPlanner presentPlanner;
+PresentPlan presentPlan;
 
 HRESULT InitWindow();
 HRESULT InitDirectX();
 void OnUpdate();
 void OnRender();
+void DrawScene(D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, const std::vector<DirtyRect> &region);
+void ClearClipped(D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, const float *clearColor, const DirtyRect &shape, const std::vector<DirtyRect> &region);
+void CopyRect(ID3D12Resource *dst, ID3D12Resource *src, const DirtyRect &rect, LONG offsetX, LONG offsetY);
+DirtyRect GetTickerRect();
+DirtyRect GetCursorBox();
+void ShowPresentStats();
 void WaitForPrevFrame();
 D3D12_RESOURCE_BARRIER &GetTransitionBarrier(
     D3D12_RESOURCE_BARRIER &barrier,
@@ -61,6 +89,8 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In
 
     ::hInstance = hInstance;
 
+    StartLog("ClearScreen.log");
+
     if (FAILED(InitWindow())) {
         return -10;
     }
@@ -174,7 +204,8 @@ HRESULT InitDirectX() {
         desc.BufferUsage        = DXGI_USAGE_RENDER_TARGET_OUTPUT;
         desc.BufferCount        = FrameCount;
         desc.Scaling            = DXGI_SCALING_STRETCH;
-        desc.SwapEffect         = DXGI_SWAP_EFFECT_FLIP_DISCARD; // DXGI_SWAP_EFFECT_DISCARD ƊԈႦȂ悤ɁIII
+        // Sequential, so back buffers keep their contents for partial presentation.
+        desc.SwapEffect         = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL; // DXGI_SWAP_EFFECT_SEQUENTIAL ƊԈႦȂ悤ɁIII
         desc.AlphaMode          = DXGI_ALPHA_MODE_UNSPECIFIED;
         desc.Flags              = 0;
 
@@ -232,38 +263,89 @@ HRESULT InitDirectX() {
         ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
     }
 
+    // Nothing has been drawn yet.
+    presentPlanner.Reset(Width, Height, FrameCount);
+    frameChanges.AddAll();
+
     return S_OK;
 }
 
 void OnUpdate() {
-    for (int i = 0; i < 3; i++) {
-        color[i] += upping[i] ? 0.01f : -0.01f;
-        if (color[i] < 0.0f) {
-            upping[i] = true;
-        } else if (color[i] > 1.0f) {
-            upping[i] = false;
+    if (animating) {
+        for (int i = 0; i < 3; i++) {
+            color[i] += upping[i] ? 0.01f : -0.01f;
+            if (color[i] < 0.0f) {
+                upping[i] = true;
+            } else if (color[i] > 1.0f) {
+                upping[i] = false;
+            }
         }
+        frameChanges.AddAll();
+    }
+
+    // The ticker moves left; the part that scrolls in is drawn by the planner.
+    tickerScrolled = tickerRunning;
+    if (tickerRunning) {
+        tickerOffset += TickerSpeed;
+    }
+
+    DirtyRect box = GetCursorBox();
+    if (box.left != cursorBox.left || box.top != cursorBox.top) {
+        frameChanges.Add(cursorBox);
+        frameChanges.Add(box);
+        cursorBox = box;
+    } else if (tickerScrolled && !IsEmpty(Intersect(box, GetTickerRect()))) {
+        // The box is drawn over the ticker and does not scroll with it.
+        frameChanges.Add(box);
     }
 }
 
 void OnRender() {
+    ScrollMove scroll = { GetTickerRect(), -TickerSpeed, 0 };
+    bool changed = presentPlanner.Plan(frameIndex, frameChanges, tickerScrolled ? &scroll : nullptr, presentPlan);
+    frameChanges.Clear();
+    if (!changed) {
+        return;
+    }
+
     ThrowIfFailed(commandAllocator->Reset());
 
     ThrowIfFailed(commandList->Reset(commandAllocator.Get(), nullptr));
 
-    D3D12_RESOURCE_BARRIER barrier;
-    commandList->ResourceBarrier(1, &GetTransitionBarrier(
-        barrier, renderTargets[frameIndex].Get(),
-        D3D12_RESOURCE_STATE_PRESENT,
-        D3D12_RESOURCE_STATE_RENDER_TARGET));
+    // The back buffer still holds an older frame. What changed since is copied from the
+    // previous back buffer, which holds the last one, and so is the scrolled ticker.
+    ID3D12Resource *backBuffer = renderTargets[frameIndex].Get();
+    ID3D12Resource *prevBuffer = renderTargets[(frameIndex + FrameCount - 1) % FrameCount].Get();
+    D3D12_RESOURCE_BARRIER barriers[2];
+    if (!presentPlan.copies.empty() || presentPlan.scrolled) {
+        GetTransitionBarrier(barriers[0], backBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
+        GetTransitionBarrier(barriers[1], prevBuffer, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        commandList->ResourceBarrier(_countof(barriers), barriers);
+
+        for (const DirtyRect &rect : presentPlan.copies) {
+            CopyRect(backBuffer, prevBuffer, rect, 0, 0);
+        }
+        if (presentPlan.scrolled) {
+            CopyRect(backBuffer, prevBuffer, presentPlan.scrollRect, presentPlan.scrollX, presentPlan.scrollY);
+        }
+
+        GetTransitionBarrier(barriers[0], backBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        GetTransitionBarrier(barriers[1], prevBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_PRESENT);
+        commandList->ResourceBarrier(_countof(barriers), barriers);
+    } else {
+        commandList->ResourceBarrier(1, &GetTransitionBarrier(
+            barriers[0], backBuffer,
+            D3D12_RESOURCE_STATE_PRESENT,
+            D3D12_RESOURCE_STATE_RENDER_TARGET));
+    }
 
     D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
     rtvHandle.ptr += SIZE_T(INT64(rtvDescriptorSize) * INT64(frameIndex));
 
-    commandList->ClearRenderTargetView(rtvHandle, color, 0, nullptr);
+    DrawScene(rtvHandle, presentPlan.redraw.GetRects());
 
     commandList->ResourceBarrier(1, &GetTransitionBarrier(
-        barrier, renderTargets[frameIndex].Get(),
+        barriers[0], backBuffer,
         D3D12_RESOURCE_STATE_RENDER_TARGET,
         D3D12_RESOURCE_STATE_PRESENT));
 
@@ -272,11 +354,109 @@ void OnRender() {
     ID3D12CommandList *commandLists[] = { commandList.Get() };
     commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
 
-    ThrowIfFailed(swapChain->Present(1, 0));
+    // A full redraw is presented without rectangles.
+    RECT dirtyRects[DirtyRegion::MaxRects];
+    UINT dirtyRectCount = 0;
+    for (const DirtyRect &rect : presentPlan.redraw.GetRects()) {
+        dirtyRects[dirtyRectCount++] = { rect.left, rect.top, rect.right, rect.bottom };
+    }
+    RECT scrollRect = { presentPlan.scrollRect.left, presentPlan.scrollRect.top, presentPlan.scrollRect.right, presentPlan.scrollRect.bottom };
+    POINT scrollOffset = { presentPlan.scrollX, presentPlan.scrollY };
+
+    DXGI_PRESENT_PARAMETERS parameters = { };
+    if (!presentPlan.redraw.IsAll()) {
+        parameters.DirtyRectsCount = dirtyRectCount;
+        parameters.pDirtyRects = dirtyRects;
+    }
+    if (presentPlan.scrolled) {
+        parameters.pScrollRect = &scrollRect;
+        parameters.pScrollOffset = &scrollOffset;
+    }
+    ThrowIfFailed(swapChain->Present1(1, 0, &parameters));
 
     WaitForPrevFrame();
 }
 
+void DrawScene(D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, const std::vector<DirtyRect> &region) {
+    ClearClipped(rtvHandle, color, { 0, 0, (LONG) Width, (LONG) Height }, region);
+
+    // Light stripes on a dark band, moving left as tickerOffset grows.
+    DirtyRect ticker = GetTickerRect();
+    ClearClipped(rtvHandle, tickerColors[0], ticker, region);
+    for (LONG x = -(tickerOffset % (2 * TickerStripeWidth)); x < (LONG) Width; x += 2 * TickerStripeWidth) {
+        ClearClipped(rtvHandle, tickerColors[1], { x, ticker.top, x + TickerStripeWidth, ticker.bottom }, region);
+    }
+
+    ClearClipped(rtvHandle, cursorColor, cursorBox, region);
+}
+
+// Clears the parts of shape inside the region.
+void ClearClipped(D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle, const float *clearColor, const DirtyRect &shape, const std::vector<DirtyRect> &region) {
+    D3D12_RECT rects[DirtyRegion::MaxRects];
+    UINT count = 0;
+    for (const DirtyRect &rect : region) {
+        DirtyRect clipped = Intersect(shape, rect);
+        if (!IsEmpty(clipped)) {
+            rects[count++] = { clipped.left, clipped.top, clipped.right, clipped.bottom };
+        }
+    }
+    if (count > 0) {
+        commandList->ClearRenderTargetView(rtvHandle, clearColor, count, rects);
+    }
+}
+
+// Copies rect - (offsetX, offsetY) of src to rect of dst.
+void CopyRect(ID3D12Resource *dst, ID3D12Resource *src, const DirtyRect &rect, LONG offsetX, LONG offsetY) {
+    D3D12_TEXTURE_COPY_LOCATION dstLocation;
+    dstLocation.pResource = dst;
+    dstLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    dstLocation.SubresourceIndex = 0;
+
+    D3D12_TEXTURE_COPY_LOCATION srcLocation;
+    srcLocation.pResource = src;
+    srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    srcLocation.SubresourceIndex = 0;
+
+    D3D12_BOX box;
+    box.left = UINT(rect.left - offsetX);
+    box.top = UINT(rect.top - offsetY);
+    box.front = 0;
+    box.right = UINT(rect.right - offsetX);
+    box.bottom = UINT(rect.bottom - offsetY);
+    box.back = 1;
+
+    commandList->CopyTextureRegion(&dstLocation, UINT(rect.left), UINT(rect.top), 0, &srcLocation, &box);
+}
+
+DirtyRect GetTickerRect() {
+    return { 0, (LONG) Height - TickerHeight, (LONG) Width, (LONG) Height };
+}
+
+DirtyRect GetCursorBox() {
+    LONG left = cursorPosition.x - CursorSize / 2;
+    LONG top = cursorPosition.y - CursorSize / 2;
+    return { left, top, left + CursorSize, top + CursorSize };
+}
+
+void ShowPresentStats() {
+    static ULONGLONG lastTime = 0;
+    ULONGLONG time = GetTickCount64();
+    if (time - lastTime < 1000) {
+        return;
+    }
+    lastTime = time;
+
+    // Pixel counts are percentages of the presented frames' full size.
+    const PresentStats &stats = presentPlanner.GetStats();
+    UINT64 surfacePixels = stats.surfacePixels ? stats.surfacePixels : 1;
+    TCHAR title[192];
+    wsprintf(title, TEXT("ClearScreen - DirectX12 | presented %u skipped %u | redrawn %u%% scrolled %u%% copied %u%%"),
+        (UINT) stats.presentedFrames, (UINT) stats.skippedFrames,
+        (UINT) (stats.redrawnPixels * 100 / surfacePixels), (UINT) (stats.scrolledPixels * 100 / surfacePixels),
+        (UINT) (stats.copiedPixels * 100 / surfacePixels));
+    SetWindowText(hWindow, title);
+}
+
 void WaitForPrevFrame() {
     ThrowIfFailed(commandQueue->Signal(fence.Get(), ++fenceValue));
 
@@ -310,9 +490,30 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
         PostQuitMessage(0);
         return 0;
 
+    case WM_KEYDOWN:
+        if (wParam == VK_SPACE) {
+            animating = !animating;
+        } else if (wParam == 'T') {
+            tickerRunning = !tickerRunning;
+        }
+        InvalidateRect(hwnd, nullptr, false);
+        return 0;
+
+    case WM_MOUSEMOVE:
+        cursorPosition.x = (SHORT) LOWORD(lParam);
+        cursorPosition.y = (SHORT) HIWORD(lParam);
+        InvalidateRect(hwnd, nullptr, false);
+        return 0;
+
     case WM_PAINT:
+        // Validated, so the message loop sleeps until input or an animation needs a frame.
+        ValidateRect(hwnd, nullptr);
         OnUpdate();
         OnRender();
+        ShowPresentStats();
+        if (animating || tickerRunning) {
+            InvalidateRect(hwnd, nullptr, false);
+        }
         return 0;
     }
 
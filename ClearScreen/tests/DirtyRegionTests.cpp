@@ -0,0 +1,185 @@
+#include "DirtyRegion.h"
+#include "Test.h"
+
+#include <vector>
+
+namespace {
+
+// Pixels of a surface as one value each; enough to tell every drawn frame apart.
+class Image {
+public:
+    Image(int32_t width, int32_t height, uint32_t fill) : width(width), height(height), pixels(size_t(width) * height, fill) { }
+
+    uint32_t &At(int32_t x, int32_t y) { return pixels[size_t(y) * width + x]; }
+    uint32_t At(int32_t x, int32_t y) const { return pixels[size_t(y) * width + x]; }
+    bool operator==(const Image &other) const { return pixels == other.pixels; }
+
+    void Fill(const DirtyRect &rect, uint32_t value) {
+        for (int32_t y = rect.top; y < rect.bottom; y++) {
+            for (int32_t x = rect.left; x < rect.right; x++) {
+                At(x, y) = value;
+            }
+        }
+    }
+
+    // Copies rect from source, shifted by (x, y): the destination pixel p comes from p - (x, y).
+    void Copy(const Image &source, const DirtyRect &rect, int32_t x, int32_t y) {
+        for (int32_t dy = rect.top; dy < rect.bottom; dy++) {
+            for (int32_t dx = rect.left; dx < rect.right; dx++) {
+                At(dx, dy) = source.At(dx - x, dy - y);
+            }
+        }
+    }
+
+    int32_t width;
+    int32_t height;
+    std::vector<uint32_t> pixels;
+};
+
+bool Contains(const DirtyRect &outer, const DirtyRect &inner) {
+    return inner.left >= outer.left && inner.top >= outer.top && inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+bool AreDisjoint(const std::vector<DirtyRect> &rects) {
+    for (size_t i = 0; i < rects.size(); i++) {
+        for (size_t j = i + 1; j < rects.size(); j++) {
+            if (!IsEmpty(Intersect(rects[i], rects[j]))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+DirtyRect RandomRect(TestRandom &random, int32_t width, int32_t height) {
+    // May reach past the surface, which clips it.
+    int32_t left = int32_t(random.Below(uint32_t(width + 8))) - 4;
+    int32_t top = int32_t(random.Below(uint32_t(height + 8))) - 4;
+    return { left, top, left + 1 + int32_t(random.Below(24)), top + 1 + int32_t(random.Below(16)) };
+}
+
+} // namespace
+
+TEST(DirtyRegionKeepsExactArea) {
+    DirtyRegion region(64, 48);
+    region.Add({ 0, 0, 10, 10 });
+    region.Add({ 5, 5, 15, 15 });   // Overlaps by 25 pixels.
+    region.Add({ 60, 40, 80, 60 }); // Clipped to 4 x 8.
+    region.Add({ 2, 2, 8, 8 });     // Already covered.
+    CHECK_EQ(region.GetArea(), int64_t(100 + 75 + 32));
+    CHECK(AreDisjoint(region.GetRects()));
+
+    region.Subtract({ 0, 0, 64, 5 });
+    CHECK_EQ(region.GetArea(), int64_t(50 + 75 + 32));
+    CHECK(!region.Intersects({ 0, 0, 64, 5 }));
+
+    // Above MaxRects the cheapest pair is merged: the area may only grow and the rectangles
+    // stay disjoint.
+    TestRandom random(40);
+    DirtyRegion merged(64, 48);
+    for (int i = 0; i < 200; i++) {
+        int64_t area = merged.GetArea();
+        DirtyRect rect = RandomRect(random, 64, 48);
+        merged.Add(rect);
+        REQUIRE(merged.GetRects().size() <= DirtyRegion::MaxRects);
+        REQUIRE(AreDisjoint(merged.GetRects()));
+        REQUIRE(merged.GetArea() >= area);
+        DirtyRect clipped = Intersect(rect, merged.GetSurface());
+        for (int32_t y = clipped.top; y < clipped.bottom; y++) {
+            for (int32_t x = clipped.left; x < clipped.right; x++) {
+                REQUIRE(merged.Intersects({ x, y, x + 1, y + 1 }));
+            }
+        }
+    }
+    merged.AddAll();
+    CHECK(merged.IsAll());
+}
+
+// Random scene changes and scrolls on a swap chain of two, then three, buffers. Each
+// presented buffer is brought up to date with the plan's copies, scroll and redraw, and
+// must then equal the frame drawn in full.
+TEST(PresentPlannerMatchesFullRedraw) {
+    const int32_t width = 64;
+    const int32_t height = 48;
+    const DirtyRect ticker = { 0, 40, width, height };
+
+    for (uint32_t bufferCount : { 2u, 3u }) {
+        TestRandom random(400 + bufferCount);
+        PresentPlanner planner;
+        planner.Reset(width, height, bufferCount);
+
+        Image scene(width, height, 0);
+        std::vector<Image> buffers(bufferCount, Image(width, height, 0xDEADBEEF));  // Undefined at first.
+        uint32_t buffer = 0;
+        uint32_t previous = 0;
+        uint32_t nextValue = 1;
+        uint32_t frames = 0;
+        uint32_t scrolledFrames = 0;
+
+        for (int frame = 0; frame < 3000; frame++) {
+            // The scroll moves the scene's content first; what scrolls in is new.
+            ScrollMove move;
+            bool scrolling = random.Below(3) != 0;
+            if (scrolling) {
+                if (random.Below(2) == 0) {
+                    move = { ticker, -2, 0 };
+                } else {
+                    move = { RandomRect(random, width, height), int32_t(random.Below(7)) - 3, int32_t(random.Below(7)) - 3 };
+                }
+                DirtyRect rect = Intersect(move.rect, { 0, 0, width, height });
+                Image before = scene;
+                for (int32_t y = rect.top; y < rect.bottom; y++) {
+                    for (int32_t x = rect.left; x < rect.right; x++) {
+                        bool inside = Contains(rect, { x - move.x, y - move.y, x - move.x + 1, y - move.y + 1 });
+                        scene.At(x, y) = inside ? before.At(x - move.x, y - move.y) : nextValue++;
+                    }
+                }
+            }
+
+            // Then changes are drawn over it, including over the scrolling rectangle.
+            DirtyRegion changes(width, height);
+            uint32_t changeCount = random.Below(4) == 0 ? 0 : random.Below(5);
+            for (uint32_t i = 0; i < changeCount; i++) {
+                DirtyRect rect = Intersect(RandomRect(random, width, height), changes.GetSurface());
+                scene.Fill(rect, nextValue++);
+                changes.Add(rect);
+            }
+
+            PresentPlan plan;
+            bool presented = planner.Plan(buffer, changes, scrolling ? &move : nullptr, plan);
+            bool moved = scrolling && (move.x != 0 || move.y != 0) && !IsEmpty(move.rect);
+            REQUIRE(presented == (!changes.IsEmpty() || moved));
+            if (!presented) {
+                continue;
+            }
+
+            // Copies and the scroll read the previous buffer and must not overlap what is drawn.
+            Image &target = buffers[buffer];
+            REQUIRE(AreDisjoint(plan.copies));
+            for (const DirtyRect &copy : plan.copies) {
+                REQUIRE(!plan.redraw.Intersects(copy));
+                REQUIRE(!plan.scrolled || IsEmpty(Intersect(copy, plan.scrollRect)));
+                target.Copy(buffers[previous], copy, 0, 0);
+            }
+            if (plan.scrolled) {
+                REQUIRE(!plan.redraw.Intersects(plan.scrollRect));
+                target.Copy(buffers[previous], plan.scrollRect, plan.scrollX, plan.scrollY);
+                scrolledFrames++;
+            }
+            for (const DirtyRect &rect : plan.redraw.GetRects()) {
+                target.Copy(scene, rect, 0, 0);
+            }
+            REQUIRE(target == scene);
+
+            previous = buffer;
+            buffer = (buffer + 1) % bufferCount;
+            frames++;
+        }
+
+        const PresentStats &stats = planner.GetStats();
+        CHECK_EQ(stats.presentedFrames, uint64_t(frames));
+        CHECK_EQ(stats.presentedFrames + stats.skippedFrames, uint64_t(3000));
+        CHECK(stats.redrawnPixels < stats.surfacePixels / 2);
+        CHECK(scrolledFrames > 100);
+    }
+}
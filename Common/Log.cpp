@@ -0,0 +1,502 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+namespace {
+
+constexpr uint32_t MaxLogThreads = 256;
+constexpr auto DrainInterval = std::chrono::milliseconds(10);
+
+// Followed by the payload. A null site marks padding up to the end of the ring.
+struct RecordHeader {
+    const LogSite *site;
+    uint64_t time;
+    uint32_t size;   // Including the header, a multiple of 8.
+    uint32_t thread;
+};
+
+// Single producer (the owning thread), single consumer (whoever holds drainMutex).
+// head and tail only grow; their difference is the number of bytes in use.
+struct LogRing {
+    std::atomic<uint64_t> head{ 0 };
+    char headPadding[64 - sizeof(uint64_t)];
+    std::atomic<uint64_t> tail{ 0 };
+    char tailPadding[64 - sizeof(uint64_t)];
+    std::atomic<bool> owned{ false };
+    std::atomic<uint64_t> dropped{ 0 };
+    uint8_t data[LogRingSize];
+};
+
+uint64_t GetLogTime() {
+    return (uint64_t) std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+struct Logger {
+    // Rings are never freed; a thread that exits hands its ring to a later new thread.
+    std::atomic<LogRing *> rings[MaxLogThreads] = { };
+    std::atomic<uint32_t> ringCount{ 0 };
+    std::mutex ringMutex;
+    std::atomic<uint32_t> threadCount{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+
+    std::timed_mutex drainMutex;
+    std::string text;
+    std::string output;
+    struct Line {
+        uint64_t time;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Line> lines;
+
+    std::thread thread;
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    bool running = false;
+    bool stopping = false;
+    uint32_t sinks = LogSinkDebugger;
+    FILE *file = nullptr;
+    uint64_t start = GetLogTime();
+    std::terminate_handler previousTerminate = nullptr;
+
+    ~Logger() {
+        StopLog();
+    }
+};
+
+Logger logger;
+
+struct ThreadRing {
+    LogRing *ring = nullptr;
+    uint32_t thread = 0;
+
+    ~ThreadRing() {
+        if (ring) {
+            ring->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRing threadRing;
+
+LogRing *AcquireRing() {
+    std::lock_guard<std::mutex> lock(logger.ringMutex);
+    uint32_t count = logger.ringCount.load(std::memory_order_relaxed);
+
+    // A ring that still holds records of its last owner leaves less room for the next one,
+    // so drained rings are reused first and new ones are made before taking an undrained
+    // ring. Rings are only taken under ringMutex, so one seen unowned here stays unowned.
+    LogRing *undrained = nullptr;
+    for (uint32_t i = 0; i < count; i++) {
+        LogRing *ring = logger.rings[i].load(std::memory_order_relaxed);
+        if (ring->owned.load(std::memory_order_acquire)) {
+            continue;
+        }
+        if (ring->tail.load(std::memory_order_acquire) == ring->head.load(std::memory_order_relaxed)) {
+            ring->owned.store(true, std::memory_order_relaxed);
+            return ring;
+        }
+        undrained = undrained ? undrained : ring;
+    }
+    if (count == MaxLogThreads) {
+        if (undrained) {
+            undrained->owned.store(true, std::memory_order_relaxed);
+        }
+        return undrained;
+    }
+
+    LogRing *ring = new LogRing();
+    ring->owned.store(true, std::memory_order_relaxed);
+    logger.rings[count].store(ring, std::memory_order_release);
+    logger.ringCount.store(count + 1, std::memory_order_release);
+    return ring;
+}
+
+const char *GetLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace:   return "TRACE";
+    case LogLevel::Debug:   return "DEBUG";
+    case LogLevel::Info:    return "INFO";
+    case LogLevel::Warning: return "WARNING";
+    case LogLevel::Error:   return "ERROR";
+    }
+    return "";
+}
+
+const char *GetFileName(const char *path) {
+    const char *name = path;
+    for (const char *c = path; *c; c++) {
+        if (*c == '\\' || *c == '/') {
+            name = c + 1;
+        }
+    }
+    return name;
+}
+
+void AppendFormat(std::string &text, const char *format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length > 0) {
+        text.append(buffer, (std::min)((size_t) length, sizeof(buffer) - 1));
+    }
+}
+
+// Keeps the low size bytes of bits and extends them to 64 bits.
+uint64_t ExtendInteger(uint64_t bits, uint32_t size, bool isSigned) {
+    if (size >= 8) {
+        return bits;
+    }
+    uint64_t mask = (uint64_t(1) << (size * 8)) - 1;
+    bits &= mask;
+    if (isSigned && (bits >> (size * 8 - 1)) != 0) {
+        bits |= ~mask;
+    }
+    return bits;
+}
+
+// Reads an integer argument back as printf would have received it: the logged type, promoted
+// to at least int, read with the signedness of the conversion.
+uint64_t ReadInteger(const uint8_t *&payload, bool asSigned) {
+    uint32_t size = payload[0] & 0x0F;
+    bool isSigned = (payload[0] & 0x80) != 0;
+    uint64_t bits;
+    memcpy(&bits, payload + 1, 8);
+    payload += 9;
+    bits = ExtendInteger(bits, size, isSigned);
+    return ExtendInteger(bits, (std::max)(size, (uint32_t) sizeof(int)), asSigned);
+}
+
+// Formats one record the way printf would, reading the arguments back from the payload.
+void FormatRecord(std::string &text, const RecordHeader &header, const uint8_t *payload) {
+    const LogSite &site = *header.site;
+    double seconds = (double) (int64_t) (header.time - logger.start) * std::chrono::steady_clock::period::num /
+                     std::chrono::steady_clock::period::den;
+    AppendFormat(text, "[%11.6f] %-7s %s(%d) t%u: ", seconds, GetLevelName(site.level), GetFileName(site.file), site.line, header.thread);
+
+    const char *format = site.format;
+    for (size_t i = 0; format[i]; i++) {
+        if (format[i] != '%') {
+            text.push_back(format[i]);
+            continue;
+        }
+        if (format[++i] == '%') {
+            text.push_back('%');
+            continue;
+        }
+
+        // Flags, width and precision are passed through to printf.
+        char spec[32] = "%";
+        size_t length = 1;
+        while (IsLogFlag(format[i]) || IsLogDigit(format[i]) || format[i] == '.') {
+            if (length < sizeof(spec) - 4) {
+                spec[length++] = format[i];
+            }
+            i++;
+        }
+
+        char conversion = format[i];
+        switch (conversion) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': {
+            uint64_t value = ReadInteger(payload, conversion == 'd' || conversion == 'i');
+            spec[length++] = 'l';
+            spec[length++] = 'l';
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            if (conversion == 'd' || conversion == 'i') {
+                AppendFormat(text, spec, (long long) value);
+            } else {
+                AppendFormat(text, spec, (unsigned long long) value);
+            }
+            break;
+        }
+        case 'H': {
+            uint64_t value = ReadInteger(payload, true);
+            const char *name = GetHresultName((int32_t) value);
+            AppendFormat(text, name ? "0x%08X (%s)" : "0x%08X", (uint32_t) value, name);
+            break;
+        }
+        case 'f': case 'e': case 'g': {
+            double value;
+            memcpy(&value, payload, 8);
+            payload += 8;
+            spec[length++] = conversion;
+            spec[length] = '\0';
+            AppendFormat(text, spec, value);
+            break;
+        }
+        case 's': {
+            uint16_t count;
+            memcpy(&count, payload, 2);
+            // Strings are not terminated in the payload, so flags and width are ignored.
+            AppendFormat(text, "%.*s", (int) count, (const char *) payload + 2);
+            payload += 2 + count;
+            break;
+        }
+        case 'p': {
+            uint64_t value;
+            memcpy(&value, payload, 8);
+            payload += 8;
+            AppendFormat(text, "0x%016llX", (unsigned long long) value);
+            break;
+        }
+        default:
+            text.push_back('\n');
+            return;
+        }
+    }
+    text.push_back('\n');
+}
+
+// Moves every complete record out of the ring and formats it. Called with drainMutex held.
+void DrainRing(LogRing &ring) {
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    while (tail < head) {
+        size_t offset = (size_t) (tail & (LogRingSize - 1));
+        size_t remaining = LogRingSize - offset;
+        if (remaining < sizeof(RecordHeader)) {
+            tail += remaining;
+            continue;
+        }
+
+        RecordHeader header;
+        memcpy(&header, ring.data + offset, sizeof(header));
+        if (header.site) {
+            size_t begin = logger.text.size();
+            FormatRecord(logger.text, header, ring.data + offset + sizeof(header));
+            logger.lines.push_back({ header.time, begin, logger.text.size() });
+        }
+        tail += header.size;
+    }
+    ring.tail.store(tail, std::memory_order_release);
+}
+
+void WriteSinks(const std::string &output) {
+    if (output.empty()) {
+        return;
+    }
+    if (logger.sinks & LogSinkDebugger) {
+#ifdef _WIN32
+        OutputDebugStringA(output.c_str());
+#else
+        fputs(output.c_str(), stderr);
+#endif
+    }
+    if ((logger.sinks & LogSinkFile) && logger.file) {
+        fwrite(output.data(), 1, output.size(), logger.file);
+        fflush(logger.file);
+    }
+}
+
+// Records of different threads are written in timestamp order.
+void Drain() {
+    logger.text.clear();
+    logger.lines.clear();
+    uint32_t count = logger.ringCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        DrainRing(*logger.rings[i].load(std::memory_order_acquire));
+    }
+
+    std::stable_sort(logger.lines.begin(), logger.lines.end(), [](const Logger::Line &a, const Logger::Line &b) {
+        return a.time < b.time;
+    });
+    logger.output.clear();
+    for (const Logger::Line &line : logger.lines) {
+        logger.output.append(logger.text, line.begin, line.end - line.begin);
+    }
+    WriteSinks(logger.output);
+}
+
+void DrainLoop() {
+    std::unique_lock<std::mutex> lock(logger.stateMutex);
+    while (!logger.stopping) {
+        logger.wake.wait_for(lock, DrainInterval);
+        lock.unlock();
+        {
+            std::lock_guard<std::timed_mutex> drainLock(logger.drainMutex);
+            Drain();
+        }
+        lock.lock();
+    }
+}
+
+void OnTerminate() {
+    FlushLog();
+    if (logger.previousTerminate) {
+        logger.previousTerminate();
+    }
+    std::abort();
+}
+
+#ifdef _WIN32
+LONG WINAPI OnUnhandledException(EXCEPTION_POINTERS *) {
+    FlushLog();
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+#endif
+
+}
+
+void WriteLogRecord(const LogSite &site, const void *payload, size_t size) {
+    LogRing *ring = threadRing.ring;
+    if (!ring) {
+        ring = threadRing.ring = AcquireRing();
+        threadRing.thread = logger.threadCount.fetch_add(1, std::memory_order_relaxed);
+        if (!ring) {
+            logger.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    size_t recordSize = (sizeof(RecordHeader) + size + 7) & ~size_t(7);
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t offset = (size_t) (head & (LogRingSize - 1));
+    size_t remaining = LogRingSize - offset;
+    size_t padding = remaining < recordSize ? remaining : 0;
+    if (head + padding + recordSize - tail > LogRingSize) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Records are contiguous, so one that does not fit before the end starts over at 0.
+    if (padding) {
+        if (remaining >= sizeof(RecordHeader)) {
+            RecordHeader skip = { nullptr, 0, (uint32_t) remaining, 0 };
+            memcpy(ring->data + offset, &skip, sizeof(skip));
+        }
+        head += padding;
+        offset = 0;
+    }
+
+    RecordHeader header = { &site, GetLogTime(), (uint32_t) recordSize, threadRing.thread };
+    memcpy(ring->data + offset, &header, sizeof(header));
+    memcpy(ring->data + offset + sizeof(header), payload, size);
+    ring->head.store(head + recordSize, std::memory_order_release);
+}
+
+bool StartLog(const char *filePath, uint32_t sinks) {
+    StopLog();
+
+    if (filePath && (sinks & LogSinkFile)) {
+#ifdef _WIN32
+        if (fopen_s(&logger.file, filePath, "wb") != 0) {
+            logger.file = nullptr;
+        }
+#else
+        logger.file = fopen(filePath, "wb");
+#endif
+        if (!logger.file) {
+            return false;
+        }
+    }
+
+    logger.sinks = sinks;
+    logger.stopping = false;
+    logger.running = true;
+    logger.thread = std::thread(DrainLoop);
+
+    logger.previousTerminate = std::set_terminate(OnTerminate);
+#ifdef _WIN32
+    SetUnhandledExceptionFilter(OnUnhandledException);
+#endif
+    return true;
+}
+
+void StopLog() {
+    if (!logger.running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(logger.stateMutex);
+        logger.stopping = true;
+    }
+    logger.wake.notify_one();
+    logger.thread.join();
+    logger.running = false;
+    std::set_terminate(logger.previousTerminate);
+
+    FlushLog();
+    if (logger.file) {
+        fclose(logger.file);
+        logger.file = nullptr;
+    }
+}
+
+void FlushLog() {
+    // A crash inside Drain() must not hang the handler that reports it.
+    if (!logger.drainMutex.try_lock_for(std::chrono::seconds(1))) {
+        return;
+    }
+    Drain();
+    logger.drainMutex.unlock();
+}
+
+uint64_t GetDroppedLogCount() {
+    uint64_t dropped = logger.dropped.load(std::memory_order_relaxed);
+    uint32_t count = logger.ringCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        dropped += logger.rings[i].load(std::memory_order_acquire)->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+const char *GetHresultName(int32_t hr) {
+    switch ((uint32_t) hr) {
+    case 0x00000000: return "S_OK";
+    case 0x00000001: return "S_FALSE";
+    case 0x80004001: return "E_NOTIMPL";
+    case 0x80004002: return "E_NOINTERFACE";
+    case 0x80004003: return "E_POINTER";
+    case 0x80004004: return "E_ABORT";
+    case 0x80004005: return "E_FAIL";
+    case 0x8000FFFF: return "E_UNEXPECTED";
+    case 0x80070002: return "ERROR_FILE_NOT_FOUND";
+    case 0x80070003: return "ERROR_PATH_NOT_FOUND";
+    case 0x80070005: return "E_ACCESSDENIED";
+    case 0x80070006: return "E_HANDLE";
+    case 0x8007000E: return "E_OUTOFMEMORY";
+    case 0x80070057: return "E_INVALIDARG";
+    case 0x087A0001: return "DXGI_STATUS_OCCLUDED";
+    case 0x887A0001: return "DXGI_ERROR_INVALID_CALL";
+    case 0x887A0002: return "DXGI_ERROR_NOT_FOUND";
+    case 0x887A0003: return "DXGI_ERROR_MORE_DATA";
+    case 0x887A0004: return "DXGI_ERROR_UNSUPPORTED";
+    case 0x887A0005: return "DXGI_ERROR_DEVICE_REMOVED";
+    case 0x887A0006: return "DXGI_ERROR_DEVICE_HUNG";
+    case 0x887A0007: return "DXGI_ERROR_DEVICE_RESET";
+    case 0x887A000A: return "DXGI_ERROR_WAS_STILL_DRAWING";
+    case 0x887A000B: return "DXGI_ERROR_FRAME_STATISTICS_DISJOINT";
+    case 0x887A0020: return "DXGI_ERROR_DRIVER_INTERNAL_ERROR";
+    case 0x887A0021: return "DXGI_ERROR_NONEXCLUSIVE";
+    case 0x887A0022: return "DXGI_ERROR_NOT_CURRENTLY_AVAILABLE";
+    case 0x887A0026: return "DXGI_ERROR_ACCESS_LOST";
+    case 0x887A0029: return "DXGI_ERROR_WAIT_TIMEOUT";
+    case 0x887A002D: return "DXGI_ERROR_SDK_COMPONENT_MISSING";
+    case 0x887E0001: return "D3D12_ERROR_ADAPTER_NOT_FOUND";
+    case 0x887E0002: return "D3D12_ERROR_DRIVER_VERSION_MISMATCH";
+    default:         return nullptr;
+    }
+}
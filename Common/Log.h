@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Structured logging that is cheap enough for hot paths. A log call copies its arguments
+// into a lock-free ring buffer owned by the calling thread; a background thread formats
+// the records and writes them to the sinks. Format strings are checked against the
+// argument types at compile time, and levels below LOG_MIN_LEVEL compile to nothing.
+//
+// Conversions: %d %i %u %x %X take integers, %f %e %g floating point values, %s strings,
+// %p pointers and %H an HRESULT, printed with its name when known. Flags, width and
+// precision are allowed; length modifiers are not, the argument type decides the size.
+// Strings are copied up to MaxLogStringLength bytes, so they may be freed after the call.
+
+enum class LogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+#ifndef LOG_MIN_LEVEL
+#ifdef _DEBUG
+#define LOG_MIN_LEVEL 1
+#else
+#define LOG_MIN_LEVEL 2
+#endif
+#endif
+
+constexpr bool IsLogLevelEnabled(LogLevel level) {
+    return (int) level >= LOG_MIN_LEVEL;
+}
+
+// Everything known at compile time about a log call; records only point to it.
+struct LogSite {
+    LogLevel level;
+    const char *file;
+    int line;
+    const char *format;
+};
+
+enum LogSink : uint32_t {
+    LogSinkDebugger = 1 << 0, // OutputDebugString, or stderr outside Windows.
+    LogSinkFile     = 1 << 1,
+};
+
+constexpr size_t LogRingSize = 64 * 1024;  // Per thread. Records that do not fit are dropped.
+constexpr size_t MaxLogStringLength = 256;
+
+// Starts the background thread. filePath may be null when only the debugger sink is used.
+// Also installs handlers that flush the rings when the process dies with an unhandled
+// exception, so the last records before a crash reach the file.
+bool StartLog(const char *filePath, uint32_t sinks = LogSinkDebugger | LogSinkFile);
+void StopLog();
+
+// Formats and writes every record logged so far, draining the rings of all threads, not
+// only the caller's. Waits at most a second for a drain already running. Safe to call from
+// crash handlers as long as the crashing thread is not inside a log call.
+void FlushLog();
+
+// Records lost because a ring was full.
+uint64_t GetDroppedLogCount();
+
+// Name of a common HRESULT, or null.
+const char *GetHresultName(int32_t hr);
+
+// Compile-time format checking
+
+enum class LogArgKind : uint8_t {
+    Signed,
+    Unsigned,
+    Float,
+    String,
+    Pointer,
+};
+
+template <LogArgKind... Kinds>
+struct LogArgKinds { };
+
+template <typename T, typename = void>
+struct LogArgTraits;
+
+template <typename T>
+struct LogArgTraits<T, std::enable_if_t<std::is_integral<T>::value && std::is_signed<T>::value>> {
+    static constexpr LogArgKind kind = LogArgKind::Signed;
+};
+
+template <typename T>
+struct LogArgTraits<T, std::enable_if_t<std::is_integral<T>::value && !std::is_signed<T>::value>> {
+    static constexpr LogArgKind kind = LogArgKind::Unsigned;
+};
+
+template <typename T>
+struct LogArgTraits<T, std::enable_if_t<std::is_enum<T>::value>> {
+    static constexpr LogArgKind kind = LogArgKind::Unsigned;
+};
+
+template <typename T>
+struct LogArgTraits<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static constexpr LogArgKind kind = LogArgKind::Float;
+};
+
+template <typename T>
+struct LogArgTraits<T *, std::enable_if_t<!std::is_same<std::remove_cv_t<T>, char>::value>> {
+    static constexpr LogArgKind kind = LogArgKind::Pointer;
+};
+
+template <>
+struct LogArgTraits<const char *> {
+    static constexpr LogArgKind kind = LogArgKind::String;
+};
+
+template <>
+struct LogArgTraits<char *> {
+    static constexpr LogArgKind kind = LogArgKind::String;
+};
+
+// Only used in decltype; never called.
+template <typename... Args>
+LogArgKinds<LogArgTraits<std::decay_t<Args>>::kind...> GetLogArgKinds(const Args &...);
+
+constexpr bool IsLogFlag(char c) {
+    return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+}
+
+constexpr bool IsLogDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool IsLogConversionAccepted(char conversion, LogArgKind kind) {
+    switch (conversion) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'H':
+        return kind == LogArgKind::Signed || kind == LogArgKind::Unsigned;
+    case 'f': case 'e': case 'g':
+        return kind == LogArgKind::Float;
+    case 's':
+        return kind == LogArgKind::String;
+    case 'p':
+        return kind == LogArgKind::Pointer;
+    default:
+        return false;
+    }
+}
+
+// True when every conversion in format consumes one argument of a matching kind.
+template <LogArgKind... Kinds>
+constexpr bool IsLogFormatValid(const char *format, LogArgKinds<Kinds...>) {
+    const LogArgKind kinds[] = { Kinds..., LogArgKind::Signed };
+    size_t count = sizeof...(Kinds);
+    size_t used = 0;
+    for (size_t i = 0; format[i]; i++) {
+        if (format[i] != '%') {
+            continue;
+        }
+        i++;
+        if (format[i] == '%') {
+            continue;
+        }
+        while (IsLogFlag(format[i])) { i++; }
+        while (IsLogDigit(format[i])) { i++; }
+        if (format[i] == '.') {
+            i++;
+            while (IsLogDigit(format[i])) { i++; }
+        }
+        if (used == count || !IsLogConversionAccepted(format[i], kinds[used])) {
+            return false;
+        }
+        used++;
+    }
+    return used == count;
+}
+
+// Writing records
+
+void WriteLogRecord(const LogSite &site, const void *payload, size_t size);
+
+// Integers keep their size and signedness, so the formatter can give them back to printf
+// at the type they were logged with: %u of the int -1 prints 4294967295, not 2^64 - 1.
+struct LogInteger {
+    uint64_t bits;
+    uint8_t size;
+    bool isSigned;
+};
+
+inline uint8_t *PutLogArg(uint8_t *out, const LogInteger &value) {
+    out[0] = (uint8_t) (value.size | (value.isSigned ? 0x80 : 0));
+    memcpy(out + 1, &value.bits, 8);
+    return out + 9;
+}
+inline uint8_t *PutLogArg(uint8_t *out, double value) { memcpy(out, &value, 8); return out + 8; }
+inline uint8_t *PutLogArg(uint8_t *out, const void *value) {
+    uint64_t address = (uint64_t) (uintptr_t) value;
+    memcpy(out, &address, 8);
+    return out + 8;
+}
+inline uint8_t *PutLogArg(uint8_t *out, const char *string) {
+    uint16_t length = (uint16_t) (string ? strnlen(string, MaxLogStringLength) : 0);
+    memcpy(out, &length, 2);
+    if (length) {
+        memcpy(out + 2, string, length);
+    }
+    return out + 2 + length;
+}
+
+// Widens an argument to the representation stored in the record.
+template <typename T, LogArgKind = LogArgTraits<std::decay_t<T>>::kind>
+struct LogArgStorage;
+
+template <typename T>
+struct LogArgStorage<T, LogArgKind::Signed> {
+    static LogInteger Get(T value) { return { (uint64_t) (int64_t) value, (uint8_t) sizeof(T), true }; }
+};
+
+template <typename T>
+struct LogArgStorage<T, LogArgKind::Unsigned> {
+    static LogInteger Get(T value) { return { (uint64_t) value, (uint8_t) sizeof(T), false }; }
+};
+
+template <typename T>
+struct LogArgStorage<T, LogArgKind::Float> {
+    static double Get(T value) { return (double) value; }
+};
+
+template <typename T>
+struct LogArgStorage<T, LogArgKind::String> {
+    static const char *Get(const char *value) { return value; }
+};
+
+template <typename T>
+struct LogArgStorage<T, LogArgKind::Pointer> {
+    static const void *Get(const volatile void *value) { return (const void *) value; }
+};
+
+template <typename T>
+auto StoreLogArg(const T &value) {
+    return LogArgStorage<T>::Get(value);
+}
+
+inline uint8_t *PutLogArgs(uint8_t *out) { return out; }
+
+template <typename T, typename... Args>
+uint8_t *PutLogArgs(uint8_t *out, const T &value, const Args &...args) {
+    return PutLogArgs(PutLogArg(out, StoreLogArg(value)), args...);
+}
+
+template <typename... Args>
+void WriteLog(const LogSite &site, const Args &...args) {
+    // Strings are bounded, so the payload of any call fits on the stack.
+    uint8_t payload[sizeof...(Args) * (2 + MaxLogStringLength) + 1];
+    size_t size = (size_t) (PutLogArgs(payload, args...) - payload);
+    WriteLogRecord(site, payload, size);
+}
+
+// The format is checked even when the level is compiled out, so disabled calls cannot rot.
+#define LogAt(level, format, ...)                                                               \
+    do {                                                                                        \
+        static_assert(IsLogFormatValid(format, decltype(GetLogArgKinds(__VA_ARGS__))()),        \
+                      "Log format does not match its arguments.");                              \
+        if (IsLogLevelEnabled(level)) {                                                         \
+            static constexpr LogSite logSite = { level, __FILE__, __LINE__, format };           \
+            WriteLog(logSite, ##__VA_ARGS__);                                                   \
+        }                                                                                       \
+    } while (0)
+
+#define LogTrace(format, ...)   LogAt(LogLevel::Trace, format, ##__VA_ARGS__)
+#define LogDebug(format, ...)   LogAt(LogLevel::Debug, format, ##__VA_ARGS__)
+#define LogInfo(format, ...)    LogAt(LogLevel::Info, format, ##__VA_ARGS__)
+#define LogWarning(format, ...) LogAt(LogLevel::Warning, format, ##__VA_ARGS__)
+#define LogError(format, ...)   LogAt(LogLevel::Error, format, ##__VA_ARGS__)
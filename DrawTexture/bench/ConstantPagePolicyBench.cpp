@@ -0,0 +1,66 @@
+#include "Bench.h"
+#include "ConstantPagePolicy.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// ObjectConstants of DrawTexture: a world matrix and a texture index.
+struct ObjectConstants {
+    float world[16];
+    uint32_t textureIndex;
+};
+
+} // namespace
+
+// The per-frame constant traffic of DrawTexture, scaled up: one small allocation per object
+// and one array of all objects, written into plain memory pages. Three frames are in flight,
+// so pages come back from the fence two frames later.
+BENCH(ConstantAllocatorFrame) {
+    const uint32_t objectCount = 4096;
+    const uint64_t frameCount = BenchIterations(2000);
+    const uint64_t framesInFlight = 3;
+
+    ConstantPagePolicy policy;
+    policy.Reset(64 * 1024);
+    std::vector<std::vector<uint8_t>> pages;
+
+    ObjectConstants constants = { };
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    BenchTimer timer;
+    for (uint64_t frame = 1; frame <= frameCount; frame++) {
+        policy.BeginFrame(frame > framesInFlight ? frame - framesInFlight : 0);
+
+        auto allocate = [&](uint64_t size) {
+            size_t page;
+            uint64_t offset;
+            if (!policy.Allocate(size, page, offset)) {
+                pages.emplace_back(policy.GetNewPageSize(size));
+                policy.AddPage(pages.back().size());
+                policy.Allocate(size, page, offset);
+            }
+            return pages[page].data() + offset;
+        };
+
+        uint8_t *array = allocate(sizeof(ObjectConstants) * objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            constants.textureIndex = i;
+            memcpy(array + sizeof(ObjectConstants) * i, &constants, sizeof(constants));
+            memcpy(allocate(sizeof(constants)), &constants, sizeof(constants));
+        }
+
+        allocations += policy.GetFrameAllocations();
+        bytes += sizeof(ObjectConstants) * objectCount * 2;
+        policy.EndFrame(frame);
+    }
+    double seconds = timer.GetSeconds();
+    KeepBenchValue(pages.front()[0]);
+
+    ReportBench("ConstantAllocatorFrame", "allocations", allocations / seconds / 1e6, "M/s");
+    ReportBench("ConstantAllocatorFrame", "ns per allocation + write", seconds * 1e9 / allocations, "ns");
+    ReportBench("ConstantAllocatorFrame", "constants written", bytes / seconds / 1e6, "MB/s");
+    ReportBench("ConstantAllocatorFrame", "frame", seconds * 1e3 / frameCount, "ms");
+    ReportBench("ConstantAllocatorFrame", "pages", double(policy.GetPageCount()), "");
+}
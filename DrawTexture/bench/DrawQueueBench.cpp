@@ -0,0 +1,81 @@
+#include "Bench.h"
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+// Fills the queue with count packets; the keys of a typical scene or fully random ones.
+void FillQueue(DrawQueue &queue, size_t count, bool randomKeys, uint32_t seed) {
+    std::mt19937_64 random(seed);
+    std::uniform_int_distribution<uint32_t> pipelines(0, 7);
+    std::uniform_int_distribution<uint32_t> materials(0, 4095);
+    std::uniform_real_distribution<float> depths(0.1f, 1000.0f);
+    queue.Clear();
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = randomKeys ? random() : DrawKey::Make(0, pipelines(random), materials(random), depths(random));
+        queue.Add(key, (uint32_t) i, (uint32_t) (i & 15));
+    }
+}
+
+} // namespace
+
+// 1M draw packets sorted by DrawQueue's radix sort, against std::sort and std::stable_sort
+// by key on the same packets. The scene keys have a single layer, eight pipelines and
+// 4096 materials, so some digits are skipped; the random keys need all eight passes.
+BENCH(DrawQueueSort1M) {
+    const size_t packetCount = 1000000;
+    const uint64_t sortCount = BenchIterations(20);
+
+    DrawQueue queue;
+    queue.Reserve(packetCount);
+    for (bool randomKeys : { false, true }) {
+        const char *keys = randomKeys ? "random keys" : "scene keys";
+        double radixMilliseconds = 0.0;
+        double sortMilliseconds = 0.0;
+        double stableMilliseconds = 0.0;
+        bool same = true;
+        for (uint64_t i = 0; i < sortCount; i++) {
+            FillQueue(queue, packetCount, randomKeys, uint32_t(43 + i));
+            std::vector<DrawPacket> packets = queue.GetPackets();
+            std::vector<DrawPacket> stablePackets = packets;
+
+            BenchTimer radixTimer;
+            queue.Sort();
+            radixMilliseconds += radixTimer.GetMilliseconds();
+
+            auto byKey = [](const DrawPacket &a, const DrawPacket &b) { return a.key < b.key; };
+            BenchTimer sortTimer;
+            std::sort(packets.begin(), packets.end(), byKey);
+            sortMilliseconds += sortTimer.GetMilliseconds();
+
+            BenchTimer stableTimer;
+            std::stable_sort(stablePackets.begin(), stablePackets.end(), byKey);
+            stableMilliseconds += stableTimer.GetMilliseconds();
+
+            // The radix sort is stable, so it must give exactly the stable_sort order.
+            const std::vector<DrawPacket> &sorted = queue.GetPackets();
+            for (size_t j = 0; j < packetCount && same; j++) {
+                same = sorted[j].key == stablePackets[j].key && sorted[j].objectId == stablePackets[j].objectId;
+            }
+            KeepBenchValue(packets[packetCount / 2].key);
+        }
+
+        char metric[64];
+        snprintf(metric, sizeof(metric), "%s radix", keys);
+        ReportBench("DrawQueueSort1M", metric, radixMilliseconds / sortCount, "ms");
+        snprintf(metric, sizeof(metric), "%s std::sort", keys);
+        ReportBench("DrawQueueSort1M", metric, sortMilliseconds / sortCount, "ms");
+        snprintf(metric, sizeof(metric), "%s std::stable_sort", keys);
+        ReportBench("DrawQueueSort1M", metric, stableMilliseconds / sortCount, "ms");
+        snprintf(metric, sizeof(metric), "%s speedup over std::sort", keys);
+        ReportBench("DrawQueueSort1M", metric, sortMilliseconds / radixMilliseconds, "x");
+        snprintf(metric, sizeof(metric), "%s passes", keys);
+        ReportBench("DrawQueueSort1M", metric, queue.GetSortPasses(), "");
+        if (!same) {
+            ReportBenchFailure("DrawQueueSort1M", "%s sorted differently from std::stable_sort", keys);
+        }
+    }
+}
@@ -0,0 +1,194 @@
+#include "BatchMath.h"
+#include "Bench.h"
+#include "DrawQueue.h"
+#include "FrameArena.h"
+#include "FrustumCuller.h"
+#include "QueueSchedule.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+// Heap allocations through operator new in this program, counted so the frame loop below
+// can show that it makes none once warmed up. The other benchmarks are unaffected but
+// for one relaxed increment per allocation.
+namespace {
+
+std::atomic<uint64_t> heapAllocationCount(0);
+
+} // namespace
+
+void *operator new(size_t size) {
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    free(memory);
+}
+
+namespace {
+
+const uint32_t FramesInFlight = 2;
+
+// The portable part of DrawTexture's OnUpdate() and OnRender() for a scene of quads:
+// world matrices, bounds, culling, the sorted draw queue, the draw IDs and indirect
+// records from the frame arena, and the queue schedule, with the GPU FramesInFlight
+// frames behind.
+class FrameLoop {
+public:
+    explicit FrameLoop(size_t objectCount) {
+        std::mt19937 random(48);
+        std::uniform_real_distribution<float> positions(-1.0f, 1.0f);
+        std::uniform_int_distribution<uint32_t> textures(0, 255);
+        transforms.Resize(objectCount);
+        localBounds.Resize(objectCount);
+        for (size_t i = 0; i < objectCount; i++) {
+            transforms.position.x[i] = positions(random);
+            transforms.position.y[i] = positions(random);
+            transforms.position.z[i] = positions(random) * 0.5f + 0.5f;
+            transforms.scale.x[i] = transforms.scale.y[i] = transforms.scale.z[i] = 0.05f;
+            localBounds.extents.x[i] = localBounds.extents.y[i] = 1.0f;
+            textureIds.push_back(textures(random));
+        }
+        worlds.resize(objectCount);
+        batchIds.assign(objectCount, 0);
+        drawQueue.Reserve(objectCount);
+        arenas.Init(2);
+        // There is no camera in the sample, so clip space is world space.
+        viewProjection = { };
+        for (int i = 0; i < 4; i++) {
+            viewProjection.m[i][i] = 1.0f;
+        }
+    }
+
+    void Frame() {
+        arenas.BeginFrame(frame >= FramesInFlight ? frame - FramesInFlight : 0);
+
+        // OnUpdate(): objects move a little every frame.
+        for (size_t i = 0; i < transforms.GetCount(); i++) {
+            transforms.position.x[i] += i & 1 ? 1e-4f : -1e-4f;
+        }
+        BuildWorldMatrices(transforms, worlds.data());
+        TransformBounds(worlds.data(), localBounds, bounds);
+        ComputeBoundingSpheres(bounds, spheres);
+        const float camera[3] = { 0.0f, 0.0f, 0.0f };
+        culler.Cull(ExtractFrustum(viewProjection), camera, spheres, bounds, batchIds, 1);
+
+        // OnRender(): the sorted draws, their IDs and records live for the frame.
+        const InstanceBatch &visible = culler.GetBatch(0);
+        const uint32_t *ids = culler.GetInstances().data() + visible.offset;
+        drawQueue.Clear();
+        for (uint32_t i = 0; i < visible.count; i++) {
+            drawQueue.Add(DrawKey::Make(0, ids[i] & 7, textureIds[ids[i]], worlds[ids[i]].m[3][2]), ids[i], 0);
+        }
+        drawQueue.Sort();
+
+        FrameArena &arena = arenas.Get(0);
+        const std::vector<DrawPacket> &packets = drawQueue.GetPackets();
+        uint32_t *drawIds = arena.AllocateArray<uint32_t>(packets.size());
+        for (size_t i = 0; i < packets.size(); i++) {
+            drawIds[i] = packets[i].objectId;
+        }
+        IndirectDrawRecord *records = arena.AllocateArray<IndirectDrawRecord>(packets.size());
+        WriteIndirectDraws({ 0, 6, 1, 0, 0, 0 }, drawIds, records, packets.size());
+
+        // A worker's arena, through the standard allocator adapter.
+        FrameVector<uint32_t> textureList{ ArenaAllocator<uint32_t>(arenas.Get(1)) };
+        textureList.reserve(packets.size());
+        for (size_t i = 0; i < packets.size(); i++) {
+            textureList.push_back(textureIds[packets[i].objectId]);
+        }
+
+        schedule.Reset();
+        PassHandle copy = schedule.AddPass(QueueType::Copy);
+        schedule.AddPass(QueueType::Graphics, { copy });
+        schedule.Resolve(arena);
+
+        if (!packets.empty()) {
+            KeepBenchValue(records[packets.size() / 2].objectId + textureList.back());
+        }
+        arenas.EndFrame(++frame);
+    }
+
+    const FrameArenaPool &GetArenas() const { return arenas; }
+
+private:
+    TransformSoA transforms;
+    BoundsSoA localBounds;
+    BoundsSoA bounds;
+    SphereSoA spheres;
+    std::vector<Matrix4x4> worlds;
+    std::vector<uint32_t> batchIds;
+    std::vector<uint32_t> textureIds;
+    Matrix4x4 viewProjection;
+    FrustumCuller culler;
+    DrawQueue drawQueue;
+    QueueSchedule schedule;
+    FrameArenaPool arenas;
+    uint64_t frame = 0;
+};
+
+} // namespace
+
+// The frame loop of a sample-sized scene after a warmup of warmupFrames: heap allocations
+// per frame, which must be zero, the growth of the arenas, and the time of a frame. Kept
+// under FrustumCuller::ChunkSize objects, where ParallelFor would start threads per call.
+BENCH(FrameLoopAllocations) {
+    const uint64_t warmupFrames = 10;
+    // Growth of the arenas' block lists used to show only after about 850 frames, so --quick
+    // runs still go through 1000.
+    const uint64_t frameCount = (std::max<uint64_t>)(BenchIterations(2000), 1000);
+
+    for (size_t objectCount : { size_t(1), size_t(4096) }) {
+        FrameLoop loop(objectCount);
+        for (uint64_t i = 0; i < warmupFrames; i++) {
+            loop.Frame();
+        }
+
+        size_t capacity = loop.GetArenas().GetCapacity();
+        uint64_t arenaAllocations = loop.GetArenas().GetHeapAllocationCount();
+        uint64_t allocations = heapAllocationCount.load(std::memory_order_relaxed);
+        BenchTimer timer;
+        for (uint64_t i = 0; i < frameCount; i++) {
+            loop.Frame();
+        }
+        double milliseconds = timer.GetMilliseconds();
+        allocations = heapAllocationCount.load(std::memory_order_relaxed) - allocations;
+
+        char metric[64];
+        snprintf(metric, sizeof(metric), "%zu objects, allocations", objectCount);
+        ReportBench("FrameLoopAllocations", metric, double(allocations) / frameCount, "/frame");
+        snprintf(metric, sizeof(metric), "%zu objects, arena high-water mark", objectCount);
+        ReportBench("FrameLoopAllocations", metric, double(loop.GetArenas().GetHighWaterMark()) / 1024.0, "KiB");
+        snprintf(metric, sizeof(metric), "%zu objects, frame", objectCount);
+        ReportBench("FrameLoopAllocations", metric, milliseconds * 1000.0 / frameCount, "us");
+        if (allocations != 0 || loop.GetArenas().GetCapacity() != capacity ||
+            loop.GetArenas().GetHeapAllocationCount() != arenaAllocations) {
+            ReportBenchFailure("FrameLoopAllocations", "%zu objects: %llu heap allocations after the warmup",
+                               objectCount, (unsigned long long) allocations);
+        }
+    }
+}
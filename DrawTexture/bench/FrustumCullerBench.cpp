@@ -0,0 +1,81 @@
+#include "Bench.h"
+#include "FrustumCuller.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+const char *const SimdLevelNames[] = { "scalar", "AVX2", "AVX-512" };
+
+// Row-vector left-handed perspective like XMMatrixPerspectiveFovLH, camera at the origin
+// looking down +z.
+Matrix4x4 Perspective(float fovY, float aspect, float nearZ, float farZ) {
+    float yScale = 1.0f / std::tan(fovY * 0.5f);
+    float range = farZ / (farZ - nearZ);
+    Matrix4x4 m = { };
+    m.m[0][0] = yScale / aspect;
+    m.m[1][1] = yScale;
+    m.m[2][2] = range;
+    m.m[2][3] = 1.0f;
+    m.m[3][2] = -nearZ * range;
+    return m;
+}
+
+} // namespace
+
+// A synthetic scene of 1M boxes scattered in a cube around the camera, so most of them
+// are behind it or outside the sides; 64 batches with three LODs. Timed at every supported SIMD level.
+BENCH(FrustumCuller1M) {
+    const size_t objectCount = 1000000;
+    const uint32_t batchCount = 64;
+    const uint64_t frameCount = BenchIterations(200);
+
+    std::mt19937 random(30);
+    std::uniform_real_distribution<float> positions(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> extents(0.5f, 4.5f);
+    std::uniform_int_distribution<uint32_t> batches(0, batchCount - 1);
+    BoundsSoA bounds;
+    bounds.Resize(objectCount);
+    std::vector<uint32_t> batchIds(objectCount);
+    for (size_t i = 0; i < objectCount; i++) {
+        bounds.center.x[i] = positions(random);
+        bounds.center.y[i] = positions(random);
+        bounds.center.z[i] = positions(random);
+        bounds.extents.x[i] = extents(random);
+        bounds.extents.y[i] = extents(random);
+        bounds.extents.z[i] = extents(random);
+        batchIds[i] = batches(random);
+    }
+    SphereSoA spheres;
+    ComputeBoundingSpheres(bounds, spheres);
+
+    Frustum frustum = ExtractFrustum(Perspective(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f));
+    const float camera[3] = { 0.0f, 0.0f, 0.0f };
+
+    FrustumCuller culler;
+    culler.SetLodDistances({ 100.0f, 400.0f });
+
+    SimdLevel supported = GetSupportedSimdLevel();
+    for (int level = 0; level <= int(supported); level++) {
+        SetSimdLevel(SimdLevel(level));
+        culler.Cull(frustum, camera, spheres, bounds, batchIds, batchCount); // Warm-up.
+
+        BenchTimer timer;
+        for (uint64_t frame = 0; frame < frameCount; frame++) {
+            culler.Cull(frustum, camera, spheres, bounds, batchIds, batchCount);
+            KeepBenchValue(culler.GetVisibleCount());
+        }
+        double milliseconds = timer.GetMilliseconds() / frameCount;
+
+        char metric[64];
+        snprintf(metric, sizeof(metric), "%s ms/frame", SimdLevelNames[level]);
+        ReportBench("FrustumCuller1M", metric, milliseconds, "ms");
+        snprintf(metric, sizeof(metric), "%s objects/s", SimdLevelNames[level]);
+        ReportBench("FrustumCuller1M", metric, objectCount / milliseconds / 1000.0, "M/s");
+    }
+    SetSimdLevel(supported);
+
+    ReportBench("FrustumCuller1M", "visible", 100.0 * culler.GetVisibleCount() / objectCount, "%");
+}
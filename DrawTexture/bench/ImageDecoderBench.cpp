@@ -0,0 +1,179 @@
+#include "Bench.h"
+#include "ImageDecoder.h"
+#include "ImageEncoder.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Tightly packed RGBA8 pixels the decoder's output is compared with.
+struct Reference {
+    std::vector<uint8_t> pixels;
+    uint32_t width;
+    uint32_t height;
+    int maxError;  // Per channel; 0 for lossless formats.
+};
+
+// Compares pixels decoded at rowPitch with the reference; a mismatch fails the run, since
+// a decoder that is fast but wrong is no improvement.
+bool CheckDecoded(const char *name, const uint8_t *pixels, size_t rowPitch, const Reference &reference) {
+    const size_t rowBytes = size_t(reference.width) * 4;
+    int maxError = 0;
+    for (uint32_t y = 0; y < reference.height; y++) {
+        const uint8_t *row = pixels + y * rowPitch;
+        const uint8_t *expected = &reference.pixels[y * rowBytes];
+        for (size_t i = 0; i < rowBytes; i++) {
+            int error = abs(int(row[i]) - int(expected[i]));
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+    if (maxError > reference.maxError) {
+        ReportBenchFailure(name, "decoded pixels differ from the reference by up to %d", maxError);
+        return false;
+    }
+    return true;
+}
+
+// Decodes an opened image count times into a pitch-aligned buffer, like an upload buffer
+// at a texture footprint, and reports megapixels and compressed megabytes per second.
+void BenchDecode(const char *name, ImageDecoder &decoder, size_t fileSize, uint64_t count, const Reference &reference) {
+    const ImageInfo &info = decoder.GetInfo();
+    size_t rowPitch = (size_t(info.width) * 4 + 255) & ~size_t(255);
+    std::vector<uint8_t> pixels(rowPitch * info.height);
+    if (info.width != reference.width || info.height != reference.height) {
+        ReportBenchFailure(name, "%ux%u image, the reference is %ux%u", info.width, info.height, reference.width, reference.height);
+        return;
+    }
+
+    BenchTimer timer;
+    for (uint64_t i = 0; i < count; i++) {
+        if (!decoder.Decode(pixels.data(), rowPitch)) {
+            ReportBenchFailure(name, "decoding failed");
+            return;
+        }
+        KeepBenchValue(pixels[i % pixels.size()]);
+    }
+    double seconds = timer.GetSeconds();
+
+    ReportBench(name, "pixels", double(info.width) * info.height * count / 1e6 / seconds, "MP/s");
+    ReportBench(name, "input", double(fileSize) * count / 1e6 / seconds, "MB/s");
+    CheckDecoded(name, pixels.data(), rowPitch, reference);
+}
+
+// What libjpeg decodes from assets/icon.jpg, saved as a PNG. WIC, the decode path this
+// decoder replaced, is not available here; libjpeg rounds differently from the float IDCT,
+// hence the tolerance.
+bool LoadJpegReference(Reference &reference) {
+    ImageDecoder decoder;
+    if (!decoder.Open("tests/images/decoder/icon.png")) {
+        return false;
+    }
+    reference.width = decoder.GetInfo().width;
+    reference.height = decoder.GetInfo().height;
+    reference.maxError = 3;
+    reference.pixels.resize(size_t(reference.width) * reference.height * 4);
+    return decoder.Decode(reference.pixels.data(), size_t(reference.width) * 4);
+}
+
+// A 1024x1024 RGBA image with gradients and noise, so PNG filtering and deflate have work.
+// The pixels it was encoded from are the reference.
+std::vector<uint8_t> MakePng(Reference *reference = nullptr) {
+    const uint32_t size = 1024;
+    std::vector<uint8_t> pixels(size_t(size) * size * 4);
+    uint32_t noise = 1;
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            noise = noise * 1664525u + 1013904223u;
+            uint8_t *p = &pixels[(size_t(y) * size + x) * 4];
+            p[0] = uint8_t(x);
+            p[1] = uint8_t(y);
+            p[2] = uint8_t((x ^ y) + (noise >> 29));
+            p[3] = uint8_t(255 - (noise >> 30));
+        }
+    }
+    std::vector<uint8_t> file;
+    EncodePng({ pixels.data(), size, size, size_t(size) * 4, ChannelOrder::Rgba }, file);
+    if (reference) {
+        *reference = { pixels, size, size, 0 };
+    }
+    return file;
+}
+
+} // namespace
+
+// The JPEG shipped with the sample.
+BENCH(ImageDecoderJpeg) {
+    ImageDecoder decoder;
+    Reference reference;
+    if (!decoder.Open("assets/icon.jpg") || !LoadJpegReference(reference)) {
+        ReportBenchFailure("ImageDecoderJpeg", "cannot open assets/icon.jpg or its reference");
+        return;
+    }
+    MappedFile file;
+    size_t fileSize = file.Open("assets/icon.jpg") ? file.GetSize() : 0;
+    BenchDecode("ImageDecoderJpeg", decoder, fileSize, BenchIterations(2000), reference);
+}
+
+BENCH(ImageDecoderPng) {
+    Reference reference;
+    std::vector<uint8_t> file = MakePng(&reference);
+    ImageDecoder decoder;
+    if (!decoder.OpenMemory(file.data(), file.size())) {
+        ReportBenchFailure("ImageDecoderPng", "cannot open the encoded image");
+        return;
+    }
+    BenchDecode("ImageDecoderPng", decoder, file.size(), BenchIterations(100), reference);
+}
+
+// Many images at once through DecodeImages(), which spreads them over the worker threads.
+BENCH(ImageDecoderParallel) {
+    const size_t imageCount = 32;
+    Reference references[2];
+    std::vector<uint8_t> png = MakePng(&references[1]);
+    if (!LoadJpegReference(references[0])) {
+        ReportBenchFailure("ImageDecoderParallel", "cannot open the reference of assets/icon.jpg");
+        return;
+    }
+
+    std::vector<std::unique_ptr<ImageDecoder>> decoders;
+    std::vector<const ImageDecoder *> decoderPointers;
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<void *> pixels;
+    std::vector<size_t> rowPitches;
+    double megapixels = 0.0;
+    for (size_t i = 0; i < imageCount; i++) {
+        decoders.emplace_back(new ImageDecoder());
+        bool opened = i % 2 ? decoders.back()->OpenMemory(png.data(), png.size()) : decoders.back()->Open("assets/icon.jpg");
+        if (!opened) {
+            ReportBenchFailure("ImageDecoderParallel", "cannot open image %zu", i);
+            return;
+        }
+        const ImageInfo &info = decoders.back()->GetInfo();
+        rowPitches.push_back((size_t(info.width) * 4 + 255) & ~size_t(255));
+        buffers.emplace_back(rowPitches.back() * info.height);
+        decoderPointers.push_back(decoders.back().get());
+        pixels.push_back(buffers.back().data());
+        megapixels += double(info.width) * info.height / 1e6;
+    }
+
+    const uint64_t rounds = BenchIterations(20);
+    BenchTimer timer;
+    for (uint64_t round = 0; round < rounds; round++) {
+        if (!DecodeImages(decoderPointers.data(), pixels.data(), rowPitches.data(), imageCount)) {
+            ReportBenchFailure("ImageDecoderParallel", "decoding failed");
+            return;
+        }
+    }
+    double seconds = timer.GetSeconds();
+    for (size_t i = 0; i < imageCount; i++) {
+        if (!CheckDecoded("ImageDecoderParallel", (const uint8_t *) pixels[i], rowPitches[i], references[i % 2])) {
+            break;
+        }
+    }
+
+    ReportBench("ImageDecoderParallel", "pixels", megapixels * rounds / seconds, "MP/s");
+    ReportBench("ImageDecoderParallel", "images", imageCount * rounds / seconds, "images/s");
+}
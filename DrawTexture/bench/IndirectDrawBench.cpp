@@ -0,0 +1,53 @@
+#include "BatchMath.h"
+#include "Bench.h"
+#include "IndirectDrawLayout.h"
+
+#include <vector>
+
+// The CPU side of AddDrawPackets(): 64K sorted draws in 16 buckets, runs of 32 draws per
+// mesh, placed by IndirectDrawLayout and written with WriteIndirectDraws(). The records go
+// to plain memory here; in the sample they go to a write-combined upload buffer.
+BENCH(IndirectDrawArguments) {
+    const uint32_t maxCommands = 1 << 16;
+    const uint32_t bucketCount = 16;
+    const uint32_t runLength = 32;
+    const uint64_t frameCount = BenchIterations(2000);
+
+    std::vector<uint32_t> objectIds(maxCommands);
+    for (uint32_t i = 0; i < maxCommands; i++) {
+        objectIds[i] = i * 7 % maxCommands;
+    }
+    std::vector<IndirectDrawRecord> records(maxCommands);
+    std::vector<uint32_t> counts(bucketCount);
+
+    IndirectDrawLayout layout;
+    layout.Reset(maxCommands, bucketCount);
+
+    const uint32_t bucketSize = maxCommands / bucketCount;
+    uint64_t commands = 0;
+    BenchTimer timer;
+    for (uint64_t frame = 0; frame < frameCount; frame++) {
+        layout.Clear();
+        for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+            layout.BeginBucket();
+            for (uint32_t run = 0; run < bucketSize; run += runLength) {
+                uint32_t begin = bucket * bucketSize + run;
+                IndirectDrawRecord draw = { 0, 36 + run, 1, run * 36, int32_t(run), 0 };
+                uint32_t first;
+                if (layout.AddCommands(runLength, first)) {
+                    WriteIndirectDraws(draw, objectIds.data() + begin, records.data() + first, runLength);
+                }
+            }
+            layout.EndBucket();
+            counts[bucket] = layout.GetBuckets().back().commandCount;
+        }
+        commands += layout.GetCommandCount();
+        KeepBenchValue(records[frame % maxCommands]);
+    }
+    double milliseconds = timer.GetMilliseconds();
+
+    KeepBenchValue(counts[0]);
+    ReportBench("IndirectDrawArguments", "arguments", commands / milliseconds, "args/ms");
+    ReportBench("IndirectDrawArguments", "bandwidth", commands * sizeof(IndirectDrawRecord) / 1e6 / (milliseconds / 1000.0), "MB/s");
+    ReportBench("IndirectDrawArguments", "frame", milliseconds / frameCount, "ms");
+}
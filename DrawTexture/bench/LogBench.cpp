@@ -0,0 +1,60 @@
+#include "Bench.h"
+#include "Log.h"
+
+#include <cstdio>
+
+// Cost of a log call on the calling thread, against formatting the same line with
+// snprintf there. The rings are drained between chunks that fit into one ring, so no record
+// is dropped and the timed loop only contains the calls. Without sinks the background
+// thread still formats every record; its cost per record is reported too.
+BENCH(LogCall) {
+    const uint32_t chunkSize = 1000;  // About 48 bytes per record, well within LogRingSize.
+    const uint64_t chunkCount = BenchIterations(2000);
+    const char *pass = "scene";
+
+    StartLog(nullptr, 0);
+    FlushLog();
+
+    double callMilliseconds = 0.0;
+    double drainMilliseconds = 0.0;
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        BenchTimer timer;
+        for (uint32_t i = 0; i < chunkSize; i++) {
+            LogInfo("Frame %u: %s took %.3f ms", i, pass, i * 0.001);
+        }
+        callMilliseconds += timer.GetMilliseconds();
+
+        BenchTimer drainTimer;
+        FlushLog();
+        drainMilliseconds += drainTimer.GetMilliseconds();
+    }
+
+    // Below LOG_MIN_LEVEL a call compiles to nothing.
+    BenchTimer disabledTimer;
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        for (uint32_t i = 0; i < chunkSize; i++) {
+            LogTrace("Frame %u: %s took %.3f ms", i, pass, i * 0.001);
+        }
+    }
+    double disabledMilliseconds = disabledTimer.GetMilliseconds();
+
+    uint64_t dropped = GetDroppedLogCount();
+    StopLog();
+
+    char line[256];
+    BenchTimer formatTimer;
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        for (uint32_t i = 0; i < chunkSize; i++) {
+            snprintf(line, sizeof(line), "Frame %u: %s took %.3f ms", i, pass, i * 0.001);
+            KeepBenchValue(line[0]);
+        }
+    }
+    double formatMilliseconds = formatTimer.GetMilliseconds();
+
+    double calls = double(chunkCount) * chunkSize;
+    ReportBench("LogCall", "LogInfo", callMilliseconds * 1e6 / calls, "ns/call");
+    ReportBench("LogCall", "LogTrace, compiled out", disabledMilliseconds * 1e6 / calls, "ns/call");
+    ReportBench("LogCall", "snprintf on the caller", formatMilliseconds * 1e6 / calls, "ns/call");
+    ReportBench("LogCall", "drain and format", drainMilliseconds * 1e6 / calls, "ns/record");
+    ReportBench("LogCall", "dropped", double(dropped), "records");
+}
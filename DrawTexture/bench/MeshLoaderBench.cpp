@@ -0,0 +1,44 @@
+#include "Bench.h"
+#include "MeshLoader.h"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+// Open() and Parse() of a generated OBJ grid, as DrawTexture loads its mesh at startup.
+BENCH(MeshLoaderObj) {
+    const uint32_t size = uint32_t(BenchIterations(1000));
+    char path[] = "/tmp/meshbenchXXXXXX";
+    int descriptor = mkstemp(path);
+    FILE *file = fdopen(descriptor, "w");
+    for (uint32_t y = 0; y <= size; y++) {
+        for (uint32_t x = 0; x <= size; x++) {
+            fprintf(file, "v %.6f %.6f 0.0\nvt %.6f %.6f\n", x * 0.01f, y * 0.01f, float(x) / size, float(y) / size);
+        }
+    }
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            uint32_t i = y * (size + 1) + x + 1;
+            fprintf(file, "f %u/%u %u/%u %u/%u %u/%u\n", i, i, i + 1, i + 1, i + size + 2, i + size + 2, i + size + 1, i + size + 1);
+        }
+    }
+    fclose(file);
+
+    MeshFile mesh;
+    BenchTimer timer;
+    bool opened = mesh.Open(path);
+    std::vector<MeshVertex> vertices(mesh.GetVertexCount());
+    std::vector<uint32_t> indices(mesh.GetIndexCount());
+    bool parsed = opened && mesh.Parse(vertices.data(), indices.data());
+    double seconds = timer.GetSeconds();
+    unlink(path);
+
+    if (!parsed) {
+        printf("MeshLoaderObj: failed to load the generated mesh\n");
+        return;
+    }
+    KeepBenchValue(indices.back());
+    ReportBench("MeshLoaderObj", "file size", mesh.GetFileSize() / 1e6, "MB");
+    ReportBench("MeshLoaderObj", "open + parse", mesh.GetFileSize() / seconds / 1e6, "MB/s");
+    ReportBench("MeshLoaderObj", "triangles", mesh.GetIndexCount() / 3 / seconds / 1e6, "M/s");
+}
@@ -0,0 +1,51 @@
+#include "Bench.h"
+#include "PerfHud.h"
+
+#include <random>
+
+// The CPU cost of the HUD per frame: AddFrame() with the timings of a frame, then Build()
+// of the whole overlay into a batch that is cleared and reused like the sample's. The
+// history is full from the start, so every graph bar and text line is laid out.
+BENCH(PerfHudBuild) {
+    const uint64_t frameCount = BenchIterations(20000);
+
+    std::mt19937 random(50);
+    std::uniform_real_distribution<float> times(2.0f, 18.0f);
+    PerfHudCounters counters = { };
+    counters.drawCount = 4098;
+    counters.barrierCount = 6;
+    counters.issuedStateCount = 12;
+    counters.elidedStateCount = 4085;
+    counters.residentBytes = 300ull << 20;
+    counters.residencyBudget = 2048ull << 20;
+    counters.arenaBytes = 208ull << 10;
+    counters.arenaCapacity = 256ull << 10;
+    counters.constantBytes = 512ull << 10;
+
+    PerfHud hud;
+    hud.SetPasses({ "scene", "upscale", "overlay" });
+    auto addFrame = [&]() {
+        float passTimes[3] = { times(random) * 0.6f, times(random) * 0.2f, 0.05f };
+        hud.AddFrame(times(random), times(random), passTimes, counters);
+    };
+    for (size_t i = 0; i < PerfHud::HistorySize; i++) {
+        addFrame();
+    }
+
+    OverlayBatch batch;
+    double buildMilliseconds = 0.0;
+    BenchTimer timer;
+    for (uint64_t i = 0; i < frameCount; i++) {
+        addFrame();
+        batch.Clear();
+        hud.Build(batch, 8.0f, 8.0f);
+        buildMilliseconds += hud.GetBuildTime();
+    }
+    double milliseconds = timer.GetMilliseconds();
+    KeepBenchValue(batch.GetQuads().back().left);
+
+    ReportBench("PerfHudBuild", "frame", milliseconds * 1000.0 / frameCount, "us");
+    ReportBench("PerfHudBuild", "Build", buildMilliseconds * 1000.0 / frameCount, "us");
+    ReportBench("PerfHudBuild", "quads", double(batch.GetQuadCount()), "");
+    ReportBench("PerfHudBuild", "vertex data", double(batch.GetQuadCount() * sizeof(OverlayQuad)) / 1024.0, "KiB");
+}
@@ -0,0 +1,68 @@
+#include "BatchMath.h"
+#include "Bench.h"
+#include "PixelFormat.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// AVX-512 uses the AVX2 kernels, so it is not measured separately.
+const char *const SimdLevelNames[] = { "scalar", "AVX2" };
+
+// Converts a 2048x2048 image once per supported SIMD level and reports megapixels per second.
+void BenchConvert(const char *name, PixelFormat srcFormat, PixelFormat dstFormat, uint32_t conversion, uint64_t iterations) {
+    const uint32_t size = 2048;
+    size_t srcPitch = size_t(size) * GetPixelSize(srcFormat);
+    size_t dstPitch = size_t(size) * GetPixelSize(dstFormat);
+    std::vector<uint8_t> src(srcPitch * size);
+    std::vector<uint8_t> dst(dstPitch * size);
+    uint32_t state = 1;
+    for (uint8_t &byte : src) {
+        state = state * 1664525u + 1013904223u;
+        byte = uint8_t(state >> 24);
+    }
+    if (srcFormat == PixelFormat::R16G16B16A16Float) {
+        // Halves in [0, 1], the range textures are converted from.
+        uint16_t *halves = (uint16_t *) src.data();
+        for (size_t i = 0; i < src.size() / 2; i++) {
+            halves[i] = uint16_t(halves[i] % 0x3C01);
+        }
+    }
+
+    SimdLevel supported = GetSupportedSimdLevel();
+    for (int level = 0; level <= int(supported) && level <= int(SimdLevel::Avx2); level++) {
+        SetSimdLevel(SimdLevel(level));
+        BenchTimer timer;
+        for (uint64_t i = 0; i < iterations; i++) {
+            ConvertPixels(src.data(), srcPitch, srcFormat, dst.data(), dstPitch, dstFormat, size, size, conversion);
+            KeepBenchValue(dst[i % dst.size()]);
+        }
+        double seconds = timer.GetSeconds();
+        ReportBench(name, SimdLevelNames[level], double(size) * size * iterations / 1e6 / seconds, "MP/s");
+    }
+    SetSimdLevel(supported);
+}
+
+} // namespace
+
+BENCH(PixelFormatSwapRedBlue) {
+    BenchConvert("PixelFormatSwapRedBlue", PixelFormat::B8G8R8A8, PixelFormat::R8G8B8A8, PixelConversionNone, BenchIterations(100));
+}
+
+BENCH(PixelFormatPremultiply) {
+    BenchConvert("PixelFormatPremultiply", PixelFormat::R8G8B8A8, PixelFormat::R8G8B8A8, PixelConversionPremultiplyAlpha, BenchIterations(100));
+}
+
+BENCH(PixelFormatExpandL8A8) {
+    BenchConvert("PixelFormatExpandL8A8", PixelFormat::L8A8, PixelFormat::R8G8B8A8, PixelConversionPremultiplyAlpha, BenchIterations(100));
+}
+
+BENCH(PixelFormatSrgbToHalf) {
+    BenchConvert("PixelFormatSrgbToHalf", PixelFormat::R8G8B8A8, PixelFormat::R16G16B16A16Float,
+                 PixelConversionSrgbToLinear | PixelConversionPremultiplyAlpha, BenchIterations(50));
+}
+
+BENCH(PixelFormatHalfToUnorm) {
+    BenchConvert("PixelFormatHalfToUnorm", PixelFormat::R16G16B16A16Float, PixelFormat::B8G8R8A8, PixelConversionNone, BenchIterations(50));
+}
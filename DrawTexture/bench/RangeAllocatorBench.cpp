@@ -0,0 +1,71 @@
+#include "Bench.h"
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Vertex size of the DrawTexture meshes: position and uv.
+constexpr double VertexBytes = 20.0;
+
+} // namespace
+
+// Mesh churn: a pool of 4M vertices about two thirds full, where every step frees a
+// random mesh and allocates a new one of random size.
+BENCH(RangeAllocatorChurn) {
+    const uint32_t capacity = 4u << 20;
+    const uint64_t steps = BenchIterations(1000000);
+    RangeAllocator allocator(capacity);
+    std::mt19937 random(27);
+    std::uniform_int_distribution<uint32_t> sizes(64, 4096);
+
+    std::vector<AllocatedRange> live;
+    for (uint32_t used = 0; used < capacity / 3 * 2; ) {
+        uint32_t size = sizes(random);
+        live.push_back({ allocator.Allocate(size), size });
+        used += size;
+    }
+
+    uint64_t allocated = 0;
+    uint64_t failures = 0;
+    BenchTimer timer;
+    for (uint64_t step = 0; step < steps; step++) {
+        size_t index = random() % live.size();
+        allocator.Free(live[index].offset, live[index].size);
+        uint32_t size = sizes(random);
+        uint32_t offset = allocator.Allocate(size);
+        if (offset == RangeAllocator::InvalidOffset) {
+            live[index] = live.back();
+            live.pop_back();
+            failures++;
+            continue;
+        }
+        live[index] = { offset, size };
+        allocated += size;
+    }
+    double seconds = timer.GetSeconds();
+
+    ReportBench("RangeAllocatorChurn", "free + allocate", steps / seconds / 1e6, "M/s");
+    ReportBench("RangeAllocatorChurn", "vertex data allocated", allocated * VertexBytes / seconds / 1e6, "MB/s");
+    ReportBench("RangeAllocatorChurn", "free blocks", double(allocator.GetFreeBlockCount()), "");
+    ReportBench("RangeAllocatorChurn", "fragmentation", allocator.GetFragmentation() * 100.0, "%");
+    ReportBench("RangeAllocatorChurn", "failed allocations", double(failures), "");
+
+    // Compaction of the fragmented pool.
+    std::sort(live.begin(), live.end(), [](const AllocatedRange &a, const AllocatedRange &b) {
+        return a.offset < b.offset;
+    });
+    std::vector<RangeCopy> copies;
+    BenchTimer packTimer;
+    PackRanges(live, copies);
+    double packSeconds = packTimer.GetSeconds();
+    uint64_t moved = 0;
+    for (const RangeCopy &copy : copies) {
+        moved += copy.size;
+    }
+    ReportBench("RangeAllocatorChurn", "compaction plan", packSeconds * 1e3, "ms");
+    ReportBench("RangeAllocatorChurn", "compaction copies", double(copies.size()), "");
+    ReportBench("RangeAllocatorChurn", "compaction moves", moved * VertexBytes / 1e6, "MB");
+}
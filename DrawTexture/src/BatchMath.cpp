@@ -0,0 +1,181 @@
+#include "BatchMath.h"
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BATCH_MATH_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+void MultiplyMatricesScalar(const Matrix4x4 *a, const Matrix4x4 *b, Matrix4x4 *result, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        MultiplyMatrixScalar(a[i], b[i], result[i]);
+    }
+}
+
+#ifdef BATCH_MATH_X86
+void CpuId(int leaf, int subleaf, unsigned info[4]) {
+#ifdef _MSC_VER
+    __cpuidex((int *) info, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+uint64_t GetXcr0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (uint64_t(edx) << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel DetectSimdLevel() {
+#ifdef BATCH_MATH_X86
+    unsigned info[4];
+    CpuId(0, 0, info);
+    if (info[0] < 7) {
+        return SimdLevel::Scalar;
+    }
+
+    // The OS must save the YMM (and for AVX-512 the opmask/ZMM) state.
+    CpuId(1, 0, info);
+    bool osxsave = (info[2] & (1u << 27)) != 0;
+    bool avx = (info[2] & (1u << 28)) != 0;
+    bool f16c = (info[2] & (1u << 29)) != 0; // Half conversions in the AVX2 pixel kernels.
+    bool fma = (info[2] & (1u << 12)) != 0;  // /arch:AVX2 lets the compiler emit FMA anywhere.
+    if (!osxsave || !avx) {
+        return SimdLevel::Scalar;
+    }
+
+    uint64_t xcr0 = GetXcr0();
+    CpuId(7, 0, info);
+    bool avx2 = (info[1] & (1u << 5)) != 0 && fma && f16c && (xcr0 & 0x06) == 0x06;
+    // /arch:AVX512 lets the compiler use F, CD, BW, DQ and VL instructions anywhere in
+    // BatchMathAvx512.cpp, so all of them are required, on top of everything AVX2 needs.
+    const unsigned avx512Bits = (1u << 16) | (1u << 17) | (1u << 28) | (1u << 30) | (1u << 31);
+    bool avx512 = avx2 && (info[1] & avx512Bits) == avx512Bits && (xcr0 & 0xE6) == 0xE6;
+
+    return avx512 ? SimdLevel::Avx512 : avx2 ? SimdLevel::Avx2 : SimdLevel::Scalar;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+std::atomic<int> simdLevel(-1);
+
+}
+
+const BatchKernels ScalarBatchKernels = {
+    BatchBuildWorldMatrices<ScalarOps>,
+    BatchTransformPoints<ScalarOps>,
+    BatchTransformBounds<ScalarOps>,
+    MultiplyMatricesScalar,
+    BatchCullObjects<ScalarOps>,
+    WriteIndirectDrawsScalar,
+};
+
+void Float3SoA::Resize(size_t count, float value) {
+    x.resize(count, value);
+    y.resize(count, value);
+    z.resize(count, value);
+}
+
+void QuaternionSoA::Resize(size_t count) {
+    x.resize(count, 0.0f);
+    y.resize(count, 0.0f);
+    z.resize(count, 0.0f);
+    w.resize(count, 1.0f);
+}
+
+void TransformSoA::Resize(size_t count) {
+    position.Resize(count);
+    rotation.Resize(count);
+    scale.Resize(count, 1.0f);
+}
+
+void BoundsSoA::Resize(size_t count) {
+    center.Resize(count);
+    extents.Resize(count);
+}
+
+void SphereSoA::Resize(size_t count) {
+    center.Resize(count);
+    radius.resize(count, 0.0f);
+}
+
+SimdLevel GetSupportedSimdLevel() {
+    static const SimdLevel supported = DetectSimdLevel();
+    return supported;
+}
+
+SimdLevel GetSimdLevel() {
+    int level = simdLevel.load(std::memory_order_relaxed);
+    return level < 0 ? GetSupportedSimdLevel() : SimdLevel(level);
+}
+
+void SetSimdLevel(SimdLevel level) {
+    if (level > GetSupportedSimdLevel()) {
+        level = GetSupportedSimdLevel();
+    }
+    simdLevel.store(int(level), std::memory_order_relaxed);
+}
+
+const BatchKernels &GetBatchKernels() {
+    switch (GetSimdLevel()) {
+#ifdef BATCH_MATH_X86
+    case SimdLevel::Avx512: return Avx512BatchKernels;
+    case SimdLevel::Avx2: return Avx2BatchKernels;
+#endif
+    default: return ScalarBatchKernels;
+    }
+}
+
+void BuildWorldMatrices(const TransformSoA &transforms, Matrix4x4 *worlds) {
+    TransformStreams streams = {
+        transforms.position.x.data(), transforms.position.y.data(), transforms.position.z.data(),
+        transforms.rotation.x.data(), transforms.rotation.y.data(), transforms.rotation.z.data(), transforms.rotation.w.data(),
+        transforms.scale.x.data(), transforms.scale.y.data(), transforms.scale.z.data(),
+    };
+    GetBatchKernels().buildWorldMatrices(streams, worlds, 0, transforms.GetCount());
+}
+
+void TransformPoints(const Matrix4x4 &matrix, const Float3SoA &points, Float3SoA &result) {
+    result.Resize(points.GetCount());
+
+    PointStreams input = { points.x.data(), points.y.data(), points.z.data() };
+    PointOutputStreams output = { result.x.data(), result.y.data(), result.z.data() };
+    GetBatchKernels().transformPoints(matrix, input, output, 0, points.GetCount());
+}
+
+void TransformBounds(const Matrix4x4 *worlds, const BoundsSoA &local, BoundsSoA &world) {
+    world.Resize(local.GetCount());
+
+    BoundsStreams input = {
+        local.center.x.data(), local.center.y.data(), local.center.z.data(),
+        local.extents.x.data(), local.extents.y.data(), local.extents.z.data(),
+    };
+    BoundsOutputStreams output = {
+        world.center.x.data(), world.center.y.data(), world.center.z.data(),
+        world.extents.x.data(), world.extents.y.data(), world.extents.z.data(),
+    };
+    GetBatchKernels().transformBounds(worlds, input, output, 0, local.GetCount());
+}
+
+void MultiplyMatrices(const Matrix4x4 *a, const Matrix4x4 *b, Matrix4x4 *result, size_t count) {
+    GetBatchKernels().multiplyMatrices(a, b, result, 0, count);
+}
+
+void WriteIndirectDraws(const IndirectDrawRecord &draw, const uint32_t *objectIds, IndirectDrawRecord *records, size_t count) {
+    GetBatchKernels().writeIndirectDraws(draw, objectIds, records, count);
+}
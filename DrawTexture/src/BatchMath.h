@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BatchMathKernels.h"
+
+// Structure-of-arrays streams for batch transforms. Each component is stored
+// contiguously so the kernels process 8 (AVX2) or 16 (AVX-512) elements per
+// instruction.
+struct Float3SoA {
+    std::vector<float> x, y, z;
+
+    size_t GetCount() const { return x.size(); }
+    void Resize(size_t count, float value = 0.0f);
+};
+
+struct QuaternionSoA {
+    std::vector<float> x, y, z, w;
+
+    size_t GetCount() const { return x.size(); }
+    void Resize(size_t count);
+};
+
+// Position, rotation quaternion and scale per object. New elements are identity transforms.
+struct TransformSoA {
+    Float3SoA position;
+    QuaternionSoA rotation;
+    Float3SoA scale;
+
+    size_t GetCount() const { return position.GetCount(); }
+    void Resize(size_t count);
+};
+
+// Axis-aligned bounding boxes as center and half extents.
+struct BoundsSoA {
+    Float3SoA center;
+    Float3SoA extents;
+
+    size_t GetCount() const { return center.GetCount(); }
+    void Resize(size_t count);
+};
+
+// Bounding spheres as center and radius.
+struct SphereSoA {
+    Float3SoA center;
+    std::vector<float> radius;
+
+    size_t GetCount() const { return radius.size(); }
+    void Resize(size_t count);
+};
+
+enum class SimdLevel {
+    Scalar,
+    Avx2,
+    Avx512,
+};
+
+// Highest level supported by the CPU and OS, detected with CPUID.
+SimdLevel GetSupportedSimdLevel();
+
+// Level used by the batch functions. Defaults to the supported level; SetSimdLevel()
+// can force a lower one, e.g. to compare results.
+SimdLevel GetSimdLevel();
+void SetSimdLevel(SimdLevel level);
+
+const BatchKernels &GetBatchKernels();
+
+// worlds[i] = Scaling(scale[i]) * RotationQuaternion(rotation[i]) * Translation(position[i])
+void BuildWorldMatrices(const TransformSoA &transforms, Matrix4x4 *worlds);
+
+// result[i] = XMVector3Transform(points[i], matrix)
+void TransformPoints(const Matrix4x4 &matrix, const Float3SoA &points, Float3SoA &result);
+
+// world[i] = local[i] transformed by worlds[i]
+void TransformBounds(const Matrix4x4 *worlds, const BoundsSoA &local, BoundsSoA &world);
+
+// result[i] = XMMatrixMultiply(a[i], b[i])
+void MultiplyMatrices(const Matrix4x4 *a, const Matrix4x4 *b, Matrix4x4 *result, size_t count);
+
+// records[i] = draw with objectId = objectIds[i], written front to back for write-combined memory.
+void WriteIndirectDraws(const IndirectDrawRecord &draw, const uint32_t *objectIds, IndirectDrawRecord *records, size_t count);
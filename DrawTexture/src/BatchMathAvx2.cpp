@@ -0,0 +1,82 @@
+// Compiled with AVX2 enabled (see DrawTexture.vcxproj). Only reached after CPUID reports AVX2.
+#include "BatchMathKernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops {
+    using V = __m256;
+    static constexpr size_t Width = 8;
+
+    static V Load(const float *p) { return _mm256_loadu_ps(p); }
+    static void Store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static V Set1(float f) { return _mm256_set1_ps(f); }
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V Abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+    static uint32_t NonNegativeMask(V a) { return (uint32_t) _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GE_OQ)); }
+};
+
+// Two result rows per iteration: each 128-bit lane holds one row of a, and
+// the splatted elements are multiplied with the rows of b.
+void MultiplyMatricesAvx2(const Matrix4x4 *a, const Matrix4x4 *b, Matrix4x4 *result, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        __m256 b0 = _mm256_broadcast_ps((const __m128 *) b[i].m[0]);
+        __m256 b1 = _mm256_broadcast_ps((const __m128 *) b[i].m[1]);
+        __m256 b2 = _mm256_broadcast_ps((const __m128 *) b[i].m[2]);
+        __m256 b3 = _mm256_broadcast_ps((const __m128 *) b[i].m[3]);
+
+        for (int r = 0; r < 4; r += 2) {
+            __m256 rows = _mm256_loadu_ps(a[i].m[r]);
+            __m256 x = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+            __m256 y = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(1, 1, 1, 1)), b1);
+            __m256 z = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(2, 2, 2, 2)), b2);
+            __m256 w = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, _MM_SHUFFLE(3, 3, 3, 3)), b3);
+            _mm256_storeu_ps(result[i].m[r], _mm256_add_ps(_mm256_add_ps(x, z), _mm256_add_ps(y, w)));
+        }
+    }
+}
+
+// Four 24-byte records are three 32-byte vectors. The constant fields come
+// from a template and the object IDs are permuted into their slots.
+void WriteIndirectDrawsAvx2(const IndirectDrawRecord &draw, const uint32_t *objectIds, IndirectDrawRecord *records, size_t count) {
+    static_assert(sizeof(IndirectDrawRecord) == 6 * sizeof(uint32_t), "Record must be six dwords.");
+
+    const uint32_t *fields = &draw.objectId;
+    alignas(32) uint32_t pattern[24];
+    for (int i = 0; i < 24; i++) {
+        pattern[i] = fields[i % 6];
+    }
+
+    const __m256i template0 = _mm256_load_si256((const __m256i *) pattern);
+    const __m256i template1 = _mm256_load_si256((const __m256i *) pattern + 1);
+    const __m256i template2 = _mm256_load_si256((const __m256i *) pattern + 2);
+    const __m256i permute0 = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 1, 0);
+    const __m256i permute1 = _mm256_setr_epi32(0, 0, 0, 0, 2, 0, 0, 0);
+    const __m256i permute2 = _mm256_setr_epi32(0, 0, 3, 0, 0, 0, 0, 0);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i ids = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (objectIds + i)));
+        __m256i *dst = (__m256i *) (records + i);
+        _mm256_storeu_si256(dst + 0, _mm256_blend_epi32(template0, _mm256_permutevar8x32_epi32(ids, permute0), 0x41));
+        _mm256_storeu_si256(dst + 1, _mm256_blend_epi32(template1, _mm256_permutevar8x32_epi32(ids, permute1), 0x10));
+        _mm256_storeu_si256(dst + 2, _mm256_blend_epi32(template2, _mm256_permutevar8x32_epi32(ids, permute2), 0x04));
+    }
+
+    WriteIndirectDrawsScalar(draw, objectIds + i, records + i, count - i);
+}
+
+}
+
+const BatchKernels Avx2BatchKernels = {
+    BatchBuildWorldMatrices<Avx2Ops>,
+    BatchTransformPoints<Avx2Ops>,
+    BatchTransformBounds<Avx2Ops>,
+    MultiplyMatricesAvx2,
+    BatchCullObjects<Avx2Ops>,
+    WriteIndirectDrawsAvx2,
+};
@@ -0,0 +1,79 @@
+// Compiled with AVX-512 enabled (see DrawTexture.vcxproj). Only reached after CPUID reports AVX-512F, CD, BW, DQ and VL.
+#include "BatchMathKernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Ops {
+    using V = __m512;
+    static constexpr size_t Width = 16;
+
+    static V Load(const float *p) { return _mm512_loadu_ps(p); }
+    static void Store(float *p, V v) { _mm512_storeu_ps(p, v); }
+    static V Set1(float f) { return _mm512_set1_ps(f); }
+    static V Add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V Abs(V a) { return _mm512_abs_ps(a); }
+    static V Min(V a, V b) { return _mm512_min_ps(a, b); }
+    static uint32_t NonNegativeMask(V a) { return _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GE_OQ); }
+};
+
+// The whole matrix per iteration: each 128-bit lane holds one row of a.
+void MultiplyMatricesAvx512(const Matrix4x4 *a, const Matrix4x4 *b, Matrix4x4 *result, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        __m512 b0 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[0]));
+        __m512 b1 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[1]));
+        __m512 b2 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[2]));
+        __m512 b3 = _mm512_broadcast_f32x4(_mm_loadu_ps(b[i].m[3]));
+
+        __m512 rows = _mm512_loadu_ps(a[i].m[0]);
+        __m512 x = _mm512_mul_ps(_mm512_shuffle_ps(rows, rows, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        __m512 y = _mm512_mul_ps(_mm512_shuffle_ps(rows, rows, _MM_SHUFFLE(1, 1, 1, 1)), b1);
+        __m512 z = _mm512_mul_ps(_mm512_shuffle_ps(rows, rows, _MM_SHUFFLE(2, 2, 2, 2)), b2);
+        __m512 w = _mm512_mul_ps(_mm512_shuffle_ps(rows, rows, _MM_SHUFFLE(3, 3, 3, 3)), b3);
+        _mm512_storeu_ps(result[i].m[0], _mm512_add_ps(_mm512_add_ps(x, z), _mm512_add_ps(y, w)));
+    }
+}
+
+// Eight 24-byte records are three 64-byte vectors; see WriteIndirectDrawsAvx2.
+void WriteIndirectDrawsAvx512(const IndirectDrawRecord &draw, const uint32_t *objectIds, IndirectDrawRecord *records, size_t count) {
+    static_assert(sizeof(IndirectDrawRecord) == 6 * sizeof(uint32_t), "Record must be six dwords.");
+
+    const uint32_t *fields = &draw.objectId;
+    alignas(64) uint32_t pattern[48];
+    for (int i = 0; i < 48; i++) {
+        pattern[i] = fields[i % 6];
+    }
+
+    const __m512i template0 = _mm512_load_si512(pattern);
+    const __m512i template1 = _mm512_load_si512(pattern + 16);
+    const __m512i template2 = _mm512_load_si512(pattern + 32);
+    // Records start at dwords 0, 6, 12 | 18, 24, 30 | 36, 42 of the 48.
+    const __m512i permute0 = _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 2, 0, 0, 0);
+    const __m512i permute1 = _mm512_setr_epi32(0, 0, 3, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 5, 0);
+    const __m512i permute2 = _mm512_setr_epi32(0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512i ids = _mm512_castsi256_si512(_mm256_loadu_si256((const __m256i *) (objectIds + i)));
+        uint32_t *dst = (uint32_t *) (records + i);
+        _mm512_storeu_si512(dst + 0, _mm512_mask_permutexvar_epi32(template0, 0x1041, permute0, ids));
+        _mm512_storeu_si512(dst + 16, _mm512_mask_permutexvar_epi32(template1, 0x4104, permute1, ids));
+        _mm512_storeu_si512(dst + 32, _mm512_mask_permutexvar_epi32(template2, 0x0410, permute2, ids));
+    }
+
+    WriteIndirectDrawsScalar(draw, objectIds + i, records + i, count - i);
+}
+
+}
+
+const BatchKernels Avx512BatchKernels = {
+    BatchBuildWorldMatrices<Avx512Ops>,
+    BatchTransformPoints<Avx512Ops>,
+    BatchTransformBounds<Avx512Ops>,
+    MultiplyMatricesAvx512,
+    BatchCullObjects<Avx512Ops>,
+    WriteIndirectDrawsAvx512,
+};
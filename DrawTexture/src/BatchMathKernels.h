@@ -0,0 +1,345 @@
+#pragma once
+
+// Kernels shared by BatchMath.cpp, BatchMathAvx2.cpp and BatchMathAvx512.cpp.
+// Each of those files is compiled for a different instruction set, so this
+// header must only contain code in the anonymous namespace (one private copy
+// per file) and must not pull in inline library code that the linker could
+// merge across them.
+
+#include <cstddef>
+#include <cstdint>
+
+// The kernels below must round the same way in every file, so the compiler may not fuse
+// their multiplies and adds into FMA, which /arch:AVX2 and /arch:AVX512 make available.
+// GCC has no pragma for this; CMakeLists.txt passes -ffp-contract=off instead.
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+// Row-major 4x4 matrix, layout compatible with DirectX::XMFLOAT4X4.
+struct Matrix4x4 {
+    float m[4][4];
+};
+
+struct TransformStreams {
+    const float *positionX, *positionY, *positionZ;
+    const float *rotationX, *rotationY, *rotationZ, *rotationW;
+    const float *scaleX, *scaleY, *scaleZ;
+};
+
+struct PointStreams {
+    const float *x, *y, *z;
+};
+
+struct PointOutputStreams {
+    float *x, *y, *z;
+};
+
+struct BoundsStreams {
+    const float *centerX, *centerY, *centerZ;
+    const float *extentX, *extentY, *extentZ;
+};
+
+struct BoundsOutputStreams {
+    float *centerX, *centerY, *centerZ;
+    float *extentX, *extentY, *extentZ;
+};
+
+// Frustum planes (nx, ny, nz, d) facing inwards: a point p is inside when dot(n, p) + d >= 0.
+struct Frustum {
+    float planes[6][4];
+};
+
+// Bounding spheres and world AABBs of the objects to cull.
+struct CullStreams {
+    const float *sphereX, *sphereY, *sphereZ, *sphereRadius;
+    const float *centerX, *centerY, *centerZ;
+    const float *extentX, *extentY, *extentZ;
+};
+
+// One ExecuteIndirect command: the object ID root constant followed by the
+// fields of D3D12_DRAW_INDEXED_ARGUMENTS.
+struct IndirectDrawRecord {
+    uint32_t objectId;
+    uint32_t indexCountPerInstance;
+    uint32_t instanceCount;
+    uint32_t startIndexLocation;
+    int32_t baseVertexLocation;
+    uint32_t startInstanceLocation;
+};
+
+// Kernels for one instruction set. All ranges are [begin, end) element indices.
+struct BatchKernels {
+    void (*buildWorldMatrices)(const TransformStreams &transforms, Matrix4x4 *worlds, size_t begin, size_t end);
+    void (*transformPoints)(const Matrix4x4 &matrix, const PointStreams &points, const PointOutputStreams &result, size_t begin, size_t end);
+    void (*transformBounds)(const Matrix4x4 *worlds, const BoundsStreams &local, const BoundsOutputStreams &world, size_t begin, size_t end);
+    void (*multiplyMatrices)(const Matrix4x4 *a, const Matrix4x4 *b, Matrix4x4 *result, size_t begin, size_t end);
+    // Writes the indices of objects intersecting the frustum to visible[0..n) and returns n.
+    size_t (*cullObjects)(const Frustum &frustum, const CullStreams &objects, uint32_t *visible, size_t begin, size_t end);
+    // records[i] = draw with objectId = objectIds[i]. Records may be write-combined memory and are never read.
+    void (*writeIndirectDraws)(const IndirectDrawRecord &draw, const uint32_t *objectIds, IndirectDrawRecord *records, size_t count);
+};
+
+extern const BatchKernels ScalarBatchKernels;
+extern const BatchKernels Avx2BatchKernels;
+extern const BatchKernels Avx512BatchKernels;
+
+namespace {
+
+// The arithmetic below follows the operation order of DirectXMath's SSE path
+// (XMMatrixRotationQuaternion, XMVector3Transform, XMMatrixMultiply) without
+// FMA, so every instruction set produces bit-identical results.
+
+struct ScalarOps {
+    using V = float;
+    static constexpr size_t Width = 1;
+
+    static V Load(const float *p) { return *p; }
+    static void Store(float *p, V v) { *p = v; }
+    static V Set1(float f) { return f; }
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V Mul(V a, V b) { return a * b; }
+    static V Abs(V a) { return a >= 0.0f ? a + 0.0f : -a; } // +0 for -0, like clearing the sign bit
+    static V Min(V a, V b) { return a < b ? a : b; }          // Second operand for NaN, like minps
+    static uint32_t NonNegativeMask(V a) { return a >= 0.0f ? 1u : 0u; }
+};
+
+template <typename Ops>
+void BuildWorldMatricesKernel(const TransformStreams &t, Matrix4x4 *worlds, size_t begin, size_t end) {
+    using V = typename Ops::V;
+    constexpr size_t W = Ops::Width;
+
+    const V one = Ops::Set1(1.0f);
+    alignas(64) float rows[9][W];
+
+    for (size_t i = begin; i + W <= end; i += W) {
+        V x = Ops::Load(t.rotationX + i);
+        V y = Ops::Load(t.rotationY + i);
+        V z = Ops::Load(t.rotationZ + i);
+        V w = Ops::Load(t.rotationW + i);
+
+        V x2 = Ops::Add(x, x);
+        V y2 = Ops::Add(y, y);
+        V z2 = Ops::Add(z, z);
+
+        V xx = Ops::Mul(x, x2);
+        V yy = Ops::Mul(y, y2);
+        V zz = Ops::Mul(z, z2);
+        V xy = Ops::Mul(x, y2);
+        V xz = Ops::Mul(x, z2);
+        V yz = Ops::Mul(y, z2);
+        V wx = Ops::Mul(w, x2);
+        V wy = Ops::Mul(w, y2);
+        V wz = Ops::Mul(w, z2);
+
+        V sx = Ops::Load(t.scaleX + i);
+        V sy = Ops::Load(t.scaleY + i);
+        V sz = Ops::Load(t.scaleZ + i);
+
+        // Scaling * RotationQuaternion; the translation only fills the last row.
+        Ops::Store(rows[0], Ops::Mul(sx, Ops::Sub(Ops::Sub(one, yy), zz)));
+        Ops::Store(rows[1], Ops::Mul(sx, Ops::Add(xy, wz)));
+        Ops::Store(rows[2], Ops::Mul(sx, Ops::Sub(xz, wy)));
+        Ops::Store(rows[3], Ops::Mul(sy, Ops::Sub(xy, wz)));
+        Ops::Store(rows[4], Ops::Mul(sy, Ops::Sub(Ops::Sub(one, xx), zz)));
+        Ops::Store(rows[5], Ops::Mul(sy, Ops::Add(yz, wx)));
+        Ops::Store(rows[6], Ops::Mul(sz, Ops::Add(xz, wy)));
+        Ops::Store(rows[7], Ops::Mul(sz, Ops::Sub(yz, wx)));
+        Ops::Store(rows[8], Ops::Mul(sz, Ops::Sub(Ops::Sub(one, xx), yy)));
+
+        for (size_t lane = 0; lane < W; lane++) {
+            float (*m)[4] = worlds[i + lane].m;
+            m[0][0] = rows[0][lane]; m[0][1] = rows[1][lane]; m[0][2] = rows[2][lane]; m[0][3] = 0.0f;
+            m[1][0] = rows[3][lane]; m[1][1] = rows[4][lane]; m[1][2] = rows[5][lane]; m[1][3] = 0.0f;
+            m[2][0] = rows[6][lane]; m[2][1] = rows[7][lane]; m[2][2] = rows[8][lane]; m[2][3] = 0.0f;
+            m[3][0] = t.positionX[i + lane];
+            m[3][1] = t.positionY[i + lane];
+            m[3][2] = t.positionZ[i + lane];
+            m[3][3] = 1.0f;
+        }
+    }
+}
+
+template <typename Ops>
+void TransformPointsKernel(const Matrix4x4 &matrix, const PointStreams &points, const PointOutputStreams &result, size_t begin, size_t end) {
+    using V = typename Ops::V;
+    constexpr size_t W = Ops::Width;
+
+    V m[4][3];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 3; c++) {
+            m[r][c] = Ops::Set1(matrix.m[r][c]);
+        }
+    }
+
+    for (size_t i = begin; i + W <= end; i += W) {
+        V x = Ops::Load(points.x + i);
+        V y = Ops::Load(points.y + i);
+        V z = Ops::Load(points.z + i);
+
+        Ops::Store(result.x + i, Ops::Add(Ops::Mul(x, m[0][0]), Ops::Add(Ops::Mul(y, m[1][0]), Ops::Add(Ops::Mul(z, m[2][0]), m[3][0]))));
+        Ops::Store(result.y + i, Ops::Add(Ops::Mul(x, m[0][1]), Ops::Add(Ops::Mul(y, m[1][1]), Ops::Add(Ops::Mul(z, m[2][1]), m[3][1]))));
+        Ops::Store(result.z + i, Ops::Add(Ops::Mul(x, m[0][2]), Ops::Add(Ops::Mul(y, m[1][2]), Ops::Add(Ops::Mul(z, m[2][2]), m[3][2]))));
+    }
+}
+
+// Transforms local AABBs (center/extents) by per-object matrices. The extents
+// are projected on the absolute matrix, which gives the tight box around the
+// eight transformed corners.
+template <typename Ops>
+void TransformBoundsKernel(const Matrix4x4 *worlds, const BoundsStreams &local, const BoundsOutputStreams &world, size_t begin, size_t end) {
+    using V = typename Ops::V;
+    constexpr size_t W = Ops::Width;
+
+    alignas(64) float lanes[4][3][W];
+
+    for (size_t i = begin; i + W <= end; i += W) {
+        // AoS matrices to SoA lanes.
+        for (size_t lane = 0; lane < W; lane++) {
+            const float (*src)[4] = worlds[i + lane].m;
+            for (int r = 0; r < 4; r++) {
+                lanes[r][0][lane] = src[r][0];
+                lanes[r][1][lane] = src[r][1];
+                lanes[r][2][lane] = src[r][2];
+            }
+        }
+
+        V cx = Ops::Load(local.centerX + i);
+        V cy = Ops::Load(local.centerY + i);
+        V cz = Ops::Load(local.centerZ + i);
+        V ex = Ops::Load(local.extentX + i);
+        V ey = Ops::Load(local.extentY + i);
+        V ez = Ops::Load(local.extentZ + i);
+
+        float *centers[3] = { world.centerX + i, world.centerY + i, world.centerZ + i };
+        float *extents[3] = { world.extentX + i, world.extentY + i, world.extentZ + i };
+
+        for (int c = 0; c < 3; c++) {
+            V m0 = Ops::Load(lanes[0][c]);
+            V m1 = Ops::Load(lanes[1][c]);
+            V m2 = Ops::Load(lanes[2][c]);
+            V m3 = Ops::Load(lanes[3][c]);
+
+            Ops::Store(centers[c], Ops::Add(Ops::Mul(cx, m0), Ops::Add(Ops::Mul(cy, m1), Ops::Add(Ops::Mul(cz, m2), m3))));
+            Ops::Store(extents[c], Ops::Add(Ops::Mul(ex, Ops::Abs(m0)), Ops::Add(Ops::Mul(ey, Ops::Abs(m1)), Ops::Mul(ez, Ops::Abs(m2)))));
+        }
+    }
+}
+
+// Sphere test against all six planes, then the tighter AABB test for vectors
+// with at least one sphere inside. An object is visible when its box does not
+// lie completely behind any plane. The visible indices are compacted without
+// branches: every lane is written, only visible ones advance.
+template <typename Ops>
+size_t CullObjectsKernel(const Frustum &frustum, const CullStreams &s, uint32_t *visible, size_t begin, size_t end) {
+    using V = typename Ops::V;
+    constexpr size_t W = Ops::Width;
+
+    V planes[6][4];
+    V absNormals[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = Ops::Set1(frustum.planes[p][c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            absNormals[p][c] = Ops::Abs(planes[p][c]);
+        }
+    }
+
+    size_t count = 0;
+
+    for (size_t i = begin; i + W <= end; i += W) {
+        V sx = Ops::Load(s.sphereX + i);
+        V sy = Ops::Load(s.sphereY + i);
+        V sz = Ops::Load(s.sphereZ + i);
+        V r = Ops::Load(s.sphereRadius + i);
+
+        V distance = Ops::Set1(0.0f);
+        for (int p = 0; p < 6; p++) {
+            const V *n = planes[p];
+            V sphere = Ops::Add(Ops::Add(Ops::Mul(sx, n[0]), Ops::Add(Ops::Mul(sy, n[1]), Ops::Add(Ops::Mul(sz, n[2]), n[3]))), r);
+            distance = p == 0 ? sphere : Ops::Min(distance, sphere);
+        }
+
+        if (Ops::NonNegativeMask(distance) == 0) {
+            continue;
+        }
+
+        V cx = Ops::Load(s.centerX + i);
+        V cy = Ops::Load(s.centerY + i);
+        V cz = Ops::Load(s.centerZ + i);
+        V ex = Ops::Load(s.extentX + i);
+        V ey = Ops::Load(s.extentY + i);
+        V ez = Ops::Load(s.extentZ + i);
+
+        for (int p = 0; p < 6; p++) {
+            const V *n = planes[p];
+            const V *a = absNormals[p];
+            V box = Ops::Add(
+                Ops::Add(Ops::Mul(cx, n[0]), Ops::Add(Ops::Mul(cy, n[1]), Ops::Add(Ops::Mul(cz, n[2]), n[3]))),
+                Ops::Add(Ops::Mul(ex, a[0]), Ops::Add(Ops::Mul(ey, a[1]), Ops::Mul(ez, a[2]))));
+            distance = p == 0 ? box : Ops::Min(distance, box);
+        }
+
+        uint32_t mask = Ops::NonNegativeMask(distance);
+        for (size_t lane = 0; lane < W; lane++) {
+            visible[count] = uint32_t(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+
+    return count;
+}
+
+inline void WriteIndirectDrawsScalar(const IndirectDrawRecord &draw, const uint32_t *objectIds, IndirectDrawRecord *records, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        IndirectDrawRecord record = draw;
+        record.objectId = objectIds[i];
+        records[i] = record;
+    }
+}
+
+inline void MultiplyMatrixScalar(const Matrix4x4 &a, const Matrix4x4 &b, Matrix4x4 &result) {
+    for (int r = 0; r < 4; r++) {
+        float x = a.m[r][0], y = a.m[r][1], z = a.m[r][2], w = a.m[r][3];
+        for (int c = 0; c < 4; c++) {
+            result.m[r][c] = (x * b.m[0][c] + z * b.m[2][c]) + (y * b.m[1][c] + w * b.m[3][c]);
+        }
+    }
+}
+
+// Entry points for BatchKernels: the SIMD kernel over whole vectors, the scalar one over the tail.
+// They are plain functions so each kernel table is constant-initialized and no code compiled
+// for AVX2/AVX-512 runs before CPUID has been checked.
+template <typename Ops>
+void BatchBuildWorldMatrices(const TransformStreams &transforms, Matrix4x4 *worlds, size_t begin, size_t end) {
+    size_t split = begin + (end - begin) / Ops::Width * Ops::Width;
+    BuildWorldMatricesKernel<Ops>(transforms, worlds, begin, split);
+    BuildWorldMatricesKernel<ScalarOps>(transforms, worlds, split, end);
+}
+
+template <typename Ops>
+void BatchTransformPoints(const Matrix4x4 &matrix, const PointStreams &points, const PointOutputStreams &result, size_t begin, size_t end) {
+    size_t split = begin + (end - begin) / Ops::Width * Ops::Width;
+    TransformPointsKernel<Ops>(matrix, points, result, begin, split);
+    TransformPointsKernel<ScalarOps>(matrix, points, result, split, end);
+}
+
+template <typename Ops>
+void BatchTransformBounds(const Matrix4x4 *worlds, const BoundsStreams &local, const BoundsOutputStreams &world, size_t begin, size_t end) {
+    size_t split = begin + (end - begin) / Ops::Width * Ops::Width;
+    TransformBoundsKernel<Ops>(worlds, local, world, begin, split);
+    TransformBoundsKernel<ScalarOps>(worlds, local, world, split, end);
+}
+
+template <typename Ops>
+size_t BatchCullObjects(const Frustum &frustum, const CullStreams &objects, uint32_t *visible, size_t begin, size_t end) {
+    size_t split = begin + (end - begin) / Ops::Width * Ops::Width;
+    size_t count = CullObjectsKernel<Ops>(frustum, objects, visible, begin, split);
+    return count + CullObjectsKernel<ScalarOps>(frustum, objects, visible + count, split, end);
+}
+
+}
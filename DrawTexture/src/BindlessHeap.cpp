@@ -0,0 +1,54 @@
+#include "BindlessHeap.h"
+
+#include <algorithm>
+
+HRESULT BindlessHeap::Init(ID3D12Device *device, UINT capacity) {
+    this->device = device;
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = { };
+    if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)))) {
+        bindingTier = options.ResourceBindingTier;
+    }
+    if (bindingTier == D3D12_RESOURCE_BINDING_TIER_1) {
+        capacity = (std::min)(capacity, UINT(D3D12_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT));
+    }
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc;
+    desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    desc.NumDescriptors = capacity;
+    desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    desc.NodeMask = 0;
+
+    HRESULT hr = device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&heap));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    descriptorSize = device->GetDescriptorHandleIncrementSize(desc.Type);
+    allocator.Reset(capacity);
+    return S_OK;
+}
+
+UINT BindlessHeap::CreateShaderResourceView(ID3D12Resource *resource, const D3D12_SHADER_RESOURCE_VIEW_DESC *desc) {
+    UINT index = allocator.Allocate();
+    if (index != InvalidIndex) {
+        device->CreateShaderResourceView(resource, desc, GetCpuHandle(index));
+    }
+    return index;
+}
+
+void BindlessHeap::Free(UINT index, UINT64 fenceValue) {
+    allocator.Free(index, fenceValue);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE BindlessHeap::GetCpuHandle(UINT index) const {
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = heap->GetCPUDescriptorHandleForHeapStart();
+    handle.ptr += SIZE_T(descriptorSize) * index;
+    return handle;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE BindlessHeap::GetGpuHandle(UINT index) const {
+    D3D12_GPU_DESCRIPTOR_HANDLE handle = heap->GetGPUDescriptorHandleForHeapStart();
+    handle.ptr += UINT64(descriptorSize) * index;
+    return handle;
+}
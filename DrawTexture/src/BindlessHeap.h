@@ -0,0 +1,43 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include "DescriptorIndexAllocator.h"
+
+// One shader-visible CBV/SRV/UAV heap for every view of the renderer. Views keep their
+// index for their whole lifetime, and shaders index an unbounded array bound to the start
+// of the heap, so switching textures needs no descriptor table change. Freed indices are
+// recycled once the fence value given to Free() has completed.
+class BindlessHeap {
+public:
+    static constexpr UINT InvalidIndex = DescriptorIndexAllocator::InvalidIndex;
+
+    // On resource binding tier 1 a table holds at most 128 SRVs, so the capacity is clamped.
+    HRESULT Init(ID3D12Device *device, UINT capacity);
+
+    void BeginFrame(UINT64 completedFenceValue) { allocator.Reclaim(completedFenceValue); }
+
+    // Returns the index of a new SRV or InvalidIndex when the heap is full.
+    UINT CreateShaderResourceView(ID3D12Resource *resource, const D3D12_SHADER_RESOURCE_VIEW_DESC *desc);
+    // Reserves an index for a view written later, e.g. by TextureStreamer.
+    UINT Allocate() { return allocator.Allocate(); }
+    // fenceValue is that of the last submission that may read the view.
+    void Free(UINT index, UINT64 fenceValue);
+
+    ID3D12DescriptorHeap *GetHeap() const { return heap.Get(); }
+    D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(UINT index) const;
+    D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(UINT index) const;
+    // The base of the bindless table; array element i is the view with index i.
+    D3D12_GPU_DESCRIPTOR_HANDLE GetTable() const { return GetGpuHandle(0); }
+
+    const DescriptorIndexAllocator &GetAllocator() const { return allocator; }
+    D3D12_RESOURCE_BINDING_TIER GetBindingTier() const { return bindingTier; }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap;
+    DescriptorIndexAllocator allocator;
+    UINT descriptorSize = 0;
+    D3D12_RESOURCE_BINDING_TIER bindingTier = D3D12_RESOURCE_BINDING_TIER_1;
+};
@@ -0,0 +1,88 @@
+#include "CommandListPolicy.h"
+
+#include <cassert>
+
+void CommandListPolicy::Reset(const uint32_t maxEntries[QueueCount]) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    entryCount = 0;
+    for (uint32_t queue = 0; queue < QueueCount; queue++) {
+        queues[queue].firstEntry = entryCount;
+        queues[queue].maxEntries = maxEntries[queue];
+        queues[queue].createdCount = 0;
+        queues[queue].pending.clear();
+        queues[queue].pending.reserve(maxEntries[queue]);
+        entryCount += maxEntries[queue];
+    }
+    stats = { };
+}
+
+CommandListPolicy::AcquireResult CommandListPolicy::Acquire(QueueType queueType, uint64_t completedFenceValue, uint32_t &entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Queue &queue = queues[(uint32_t) queueType];
+
+    // Releases come from several threads, so the list is not in fence order.
+    size_t oldest = SIZE_MAX;
+    for (size_t i = 0; i < queue.pending.size(); i++) {
+        if (queue.pending[i].fenceValue <= completedFenceValue &&
+            (oldest == SIZE_MAX || queue.pending[i].fenceValue < queue.pending[oldest].fenceValue)) {
+            oldest = i;
+        }
+    }
+    if (oldest != SIZE_MAX) {
+        entry = queue.pending[oldest].entry;
+        queue.pending[oldest] = queue.pending.back();
+        queue.pending.pop_back();
+        stats.reusedCount++;
+        stats.acquiredCount++;
+        stats.pendingCount--;
+        return AcquireResult::Reused;
+    }
+
+    if (queue.createdCount < queue.maxEntries) {
+        entry = queue.firstEntry + queue.createdCount++;
+        stats.createdCount++;
+        stats.acquiredCount++;
+        return AcquireResult::Created;
+    }
+
+    entry = InvalidEntry;
+    stats.exhaustedCount++;
+    return AcquireResult::Exhausted;
+}
+
+void CommandListPolicy::Release(uint32_t entry, uint64_t fenceValue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    assert(entry < entryCount);
+
+    Queue &queue = queues[(uint32_t) GetQueue(entry)];
+    assert(queue.pending.size() < queue.createdCount);
+    queue.pending.push_back({ entry, fenceValue });
+    stats.acquiredCount--;
+    stats.pendingCount++;
+}
+
+uint64_t CommandListPolicy::GetOldestFenceValue(QueueType queueType) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Queue &queue = queues[(uint32_t) queueType];
+
+    uint64_t oldest = 0;
+    for (const Pending &pending : queue.pending) {
+        oldest = oldest == 0 || pending.fenceValue < oldest ? pending.fenceValue : oldest;
+    }
+    return oldest;
+}
+
+QueueType CommandListPolicy::GetQueue(uint32_t entry) const {
+    // Ranges are fixed after Reset(), so this needs no lock.
+    uint32_t queue = 0;
+    while (queue + 1 < QueueCount && entry >= queues[queue + 1].firstEntry) {
+        queue++;
+    }
+    return (QueueType) queue;
+}
+
+CommandListStats CommandListPolicy::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
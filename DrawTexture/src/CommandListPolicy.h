@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "QueueSchedule.h"
+
+struct CommandListStats {
+    uint64_t createdCount;    // Acquire() calls that needed a new pair.
+    uint64_t reusedCount;     // Acquire() calls served by a retired pair.
+    uint64_t exhaustedCount;  // Acquire() calls that found every pair of the queue busy.
+    uint32_t acquiredCount;   // Pairs currently handed out.
+    uint32_t pendingCount;    // Pairs waiting for their fence.
+};
+
+// Bookkeeping for a pool of command allocator and command list pairs. Entries belong to one
+// queue type each; an acquired entry is owned by its caller until Release(), after which it
+// waits for the fence value of its submission and is handed out again once that value has
+// completed. Entries are numbered in fixed ranges per queue, so the pool can size its
+// arrays up front and never moves an entry another thread is using. No D3D12 types are
+// involved, so the retirement logic can be exercised with any fence. Thread-safe.
+class CommandListPolicy {
+public:
+    static constexpr uint32_t InvalidEntry = UINT32_MAX;
+
+    enum class AcquireResult {
+        Reused,     // entry was used before and its fence has completed.
+        Created,    // entry is new.
+        Exhausted,  // Every entry of the queue is acquired or in flight; entry is InvalidEntry.
+    };
+
+    // At most maxEntries[queue] entries of each queue.
+    void Reset(const uint32_t maxEntries[QueueCount]);
+
+    // completedFenceValue is the completed value of the queue's fence. The retired entry with
+    // the oldest fence is reused first.
+    AcquireResult Acquire(QueueType queue, uint64_t completedFenceValue, uint32_t &entry);
+    // fenceValue is signaled on the queue's fence after the last submission of the entry's
+    // list; 0 when the list was never submitted.
+    void Release(uint32_t entry, uint64_t fenceValue);
+
+    // Oldest fence value the entries of queue wait for, or 0 when none is in flight.
+    uint64_t GetOldestFenceValue(QueueType queue) const;
+
+    QueueType GetQueue(uint32_t entry) const;
+    uint32_t GetEntryCount() const { return entryCount; }  // Sum of maxEntries.
+    CommandListStats GetStats() const;
+
+private:
+    struct Pending {
+        uint32_t entry;
+        uint64_t fenceValue;
+    };
+
+    struct Queue {
+        uint32_t firstEntry;
+        uint32_t maxEntries;
+        uint32_t createdCount;
+        std::vector<Pending> pending;
+    };
+
+    mutable std::mutex mutex;
+    Queue queues[QueueCount] = { };
+    uint32_t entryCount = 0;
+    CommandListStats stats = { };
+};
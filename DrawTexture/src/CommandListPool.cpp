@@ -0,0 +1,87 @@
+#include "CommandListPool.h"
+
+namespace {
+
+D3D12_COMMAND_LIST_TYPE GetCommandListType(QueueType queue) {
+    switch (queue) {
+    case QueueType::Compute:
+        return D3D12_COMMAND_LIST_TYPE_COMPUTE;
+    case QueueType::Copy:
+        return D3D12_COMMAND_LIST_TYPE_COPY;
+    default:
+        return D3D12_COMMAND_LIST_TYPE_DIRECT;
+    }
+}
+
+}
+
+HRESULT CommandListPool::Init(ID3D12Device *device, ID3D12Fence *const fences[QueueCount], const UINT maxLists[QueueCount]) {
+    this->device = device;
+    for (uint32_t queue = 0; queue < QueueCount; queue++) {
+        this->fences[queue] = fences[queue];
+        if (maxLists[queue] && !fences[queue]) {
+            return E_INVALIDARG;
+        }
+    }
+
+    policy.Reset(maxLists);
+    entries.clear();
+    entries.resize(policy.GetEntryCount());
+    return S_OK;
+}
+
+HRESULT CommandListPool::Acquire(QueueType queue, ID3D12PipelineState *initialState, PooledCommandList &commandList) {
+    ID3D12Fence *fence = fences[(uint32_t) queue].Get();
+    if (!fence) {
+        return E_INVALIDARG;
+    }
+
+    uint32_t index;
+    CommandListPolicy::AcquireResult result;
+    while ((result = policy.Acquire(queue, fence->GetCompletedValue(), index)) == CommandListPolicy::AcquireResult::Exhausted) {
+        // Another thread may reuse the pair first; then this waits for the next one.
+        UINT64 value = policy.GetOldestFenceValue(queue);
+        if (value == 0) {
+            return E_OUTOFMEMORY;
+        }
+        // A null event blocks until the fence reaches the value.
+        HRESULT hr = fence->SetEventOnCompletion(value, nullptr);
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    // A new entry, or one whose creation failed, gets its pair now.
+    Entry &entry = entries[index];
+    HRESULT hr;
+    if (!entry.list) {
+        D3D12_COMMAND_LIST_TYPE type = GetCommandListType(queue);
+        hr = device->CreateCommandAllocator(type, IID_PPV_ARGS(&entry.allocator));
+        if (SUCCEEDED(hr)) {
+            hr = device->CreateCommandList(0, type, entry.allocator.Get(), initialState, IID_PPV_ARGS(&entry.list));
+        }
+    } else {
+        hr = entry.allocator->Reset();
+        if (SUCCEEDED(hr)) {
+            hr = entry.list->Reset(entry.allocator.Get(), initialState);
+        }
+    }
+    if (FAILED(hr)) {
+        // Nothing was recorded, so the entry can be handed out again right away.
+        entry = Entry();
+        policy.Release(index, 0);
+        return hr;
+    }
+
+    commandList.entry = index;
+    commandList.queue = queue;
+    commandList.allocator = entry.allocator.Get();
+    commandList.list = entry.list.Get();
+    return S_OK;
+}
+
+void CommandListPool::Release(const PooledCommandList &commandList, UINT64 fenceValue) {
+    if (commandList.entry != CommandListPolicy::InvalidEntry) {
+        policy.Release(commandList.entry, fenceValue);
+    }
+}
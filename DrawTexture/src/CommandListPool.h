@@ -0,0 +1,47 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <vector>
+
+#include "CommandListPolicy.h"
+
+// A command list with the allocator it records into, handed out by CommandListPool.
+struct PooledCommandList {
+    uint32_t entry = CommandListPolicy::InvalidEntry;
+    QueueType queue = QueueType::Graphics;
+    ID3D12CommandAllocator *allocator = nullptr;
+    ID3D12GraphicsCommandList *list = nullptr;
+};
+
+// Command allocators and lists for any thread, per queue type. Acquire() returns an open
+// list; after the list has been submitted, Release() hands it back with the value its
+// queue's fence reaches once the GPU is done with it. Pairs are reset only when they are
+// acquired again after that value has completed, and new pairs are created on demand up
+// to the configured number per queue. When all of them are busy, Acquire() waits for the
+// oldest fence. The bookkeeping is CommandListPolicy.
+class CommandListPool {
+public:
+    // fences[queue] is the fence the values given to Release() refer to. maxLists[queue]
+    // may be 0 for a queue type that is not used.
+    HRESULT Init(ID3D12Device *device, ID3D12Fence *const fences[QueueCount], const UINT maxLists[QueueCount]);
+
+    // The list is open, with initialState set. E_OUTOFMEMORY when every pair of the queue is
+    // acquired and none can be waited for.
+    HRESULT Acquire(QueueType queue, ID3D12PipelineState *initialState, PooledCommandList &commandList);
+    void Release(const PooledCommandList &commandList, UINT64 fenceValue);
+
+    CommandListStats GetStats() const { return policy.GetStats(); }
+
+private:
+    struct Entry {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> list;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12Fence> fences[QueueCount];
+    CommandListPolicy policy;
+    std::vector<Entry> entries;  // Sized once; an entry is only touched by its owner.
+};
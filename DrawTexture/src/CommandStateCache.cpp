@@ -0,0 +1,97 @@
+#include "CommandStateCache.h"
+
+#include <cstring>
+
+void CommandStateCache::Reset(ID3D12GraphicsCommandList *commandList, ID3D12PipelineState *initialState) {
+    this->commandList = commandList;
+    pipelineState = initialState;
+    rootSignature = nullptr;
+    heaps[0] = nullptr;
+    heaps[1] = nullptr;
+    ClearRootTables();
+    topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    memset(vertexBuffers, 0, sizeof(vertexBuffers));
+    memset(&indexBuffer, 0, sizeof(indexBuffer));
+    issuedCount = 0;
+    elidedCount = 0;
+}
+
+void CommandStateCache::SetPipelineState(ID3D12PipelineState *pipelineState) {
+    if (Filter(pipelineState == this->pipelineState)) {
+        this->pipelineState = pipelineState;
+        commandList->SetPipelineState(pipelineState);
+    }
+}
+
+void CommandStateCache::SetGraphicsRootSignature(ID3D12RootSignature *rootSignature) {
+    if (Filter(rootSignature == this->rootSignature)) {
+        this->rootSignature = rootSignature;
+        ClearRootTables();
+        commandList->SetGraphicsRootSignature(rootSignature);
+    }
+}
+
+void CommandStateCache::SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap *const *heaps) {
+    ID3D12DescriptorHeap *bound[2] = { };
+    for (UINT i = 0; i < count && i < 2; i++) {
+        bound[i] = heaps[i];
+    }
+
+    if (Filter(count <= 2 && bound[0] == this->heaps[0] && bound[1] == this->heaps[1])) {
+        this->heaps[0] = bound[0];
+        this->heaps[1] = bound[1];
+        ClearRootTables();
+        commandList->SetDescriptorHeaps(count, heaps);
+    }
+}
+
+void CommandStateCache::SetGraphicsRootDescriptorTable(UINT rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor) {
+    bool tracked = rootParameterIndex < MaxRootTables;
+    if (Filter(tracked && rootTables[rootParameterIndex].ptr == baseDescriptor.ptr)) {
+        if (tracked) {
+            rootTables[rootParameterIndex] = baseDescriptor;
+        }
+        commandList->SetGraphicsRootDescriptorTable(rootParameterIndex, baseDescriptor);
+    }
+}
+
+void CommandStateCache::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) {
+    if (Filter(topology == this->topology)) {
+        this->topology = topology;
+        commandList->IASetPrimitiveTopology(topology);
+    }
+}
+
+void CommandStateCache::IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW *views) {
+    bool tracked = views && startSlot + count <= MaxVertexBuffers;
+    if (Filter(tracked && memcmp(&vertexBuffers[startSlot], views, count * sizeof(D3D12_VERTEX_BUFFER_VIEW)) == 0)) {
+        // Untracked slots are unknown afterwards.
+        for (UINT slot = startSlot; slot < startSlot + count && slot < MaxVertexBuffers; slot++) {
+            vertexBuffers[slot] = views ? views[slot - startSlot] : D3D12_VERTEX_BUFFER_VIEW { };
+        }
+        commandList->IASetVertexBuffers(startSlot, count, views);
+    }
+}
+
+void CommandStateCache::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW *view) {
+    if (Filter(view && memcmp(&indexBuffer, view, sizeof(indexBuffer)) == 0)) {
+        indexBuffer = view ? *view : D3D12_INDEX_BUFFER_VIEW { };
+        commandList->IASetIndexBuffer(view);
+    }
+}
+
+// Counts the call and returns whether it has to be recorded.
+bool CommandStateCache::Filter(bool redundant) {
+    if (redundant) {
+        elidedCount++;
+        return false;
+    }
+    issuedCount++;
+    return true;
+}
+
+void CommandStateCache::ClearRootTables() {
+    for (D3D12_GPU_DESCRIPTOR_HANDLE &table : rootTables) {
+        table.ptr = 0;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <d3d12.h>
+
+// Records state changes into a graphics command list and drops the ones that set what is
+// already bound. Covers the state that sorted draws switch between: pipeline state, root
+// signature, descriptor heaps and tables, topology, vertex and index buffers. State set on
+// the command list directly (e.g. by ExecuteIndirect arguments) is not tracked.
+class CommandStateCache {
+public:
+    static constexpr UINT MaxRootTables = 8;
+    static constexpr UINT MaxVertexBuffers = 4;
+
+    // Forgets all state. Called after the command list was reset with initialState.
+    void Reset(ID3D12GraphicsCommandList *commandList, ID3D12PipelineState *initialState = nullptr);
+
+    ID3D12GraphicsCommandList *GetCommandList() const { return commandList; }
+
+    void SetPipelineState(ID3D12PipelineState *pipelineState);
+    // A different root signature clears the bound descriptor tables.
+    void SetGraphicsRootSignature(ID3D12RootSignature *rootSignature);
+    // Different heaps clear the bound descriptor tables.
+    void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap *const *heaps);
+    void SetGraphicsRootDescriptorTable(UINT rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor);
+    void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+    void IASetVertexBuffers(UINT startSlot, UINT count, const D3D12_VERTEX_BUFFER_VIEW *views);
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW *view);
+
+    // Since the last Reset().
+    UINT GetIssuedCount() const { return issuedCount; }
+    UINT GetElidedCount() const { return elidedCount; }
+
+private:
+    bool Filter(bool redundant);
+    void ClearRootTables();
+
+    ID3D12GraphicsCommandList *commandList = nullptr;
+    ID3D12PipelineState *pipelineState = nullptr;
+    ID3D12RootSignature *rootSignature = nullptr;
+    ID3D12DescriptorHeap *heaps[2] = { };  // CBV_SRV_UAV and sampler.
+    D3D12_GPU_DESCRIPTOR_HANDLE rootTables[MaxRootTables] = { };
+    D3D12_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    D3D12_VERTEX_BUFFER_VIEW vertexBuffers[MaxVertexBuffers] = { };
+    D3D12_INDEX_BUFFER_VIEW indexBuffer = { };
+    UINT issuedCount = 0;
+    UINT elidedCount = 0;
+};
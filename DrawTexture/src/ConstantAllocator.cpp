@@ -0,0 +1,103 @@
+#include "ConstantAllocator.h"
+
+static_assert(ConstantPagePolicy::Alignment == D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT,
+    "Constant allocations must be placed at constant buffer alignment.");
+
+HRESULT ConstantAllocator::Init(ID3D12Device *device, UINT64 pageSize) {
+    this->device = device;
+    policy.Reset(pageSize);
+    pages.clear();
+
+    // Create the first page up front so the first frame does not hit CreateCommittedResource.
+    return CreatePage(policy.GetPageSize());
+}
+
+void ConstantAllocator::TrackResidency(ResidencyManager *residency) {
+    this->residency = residency;
+    for (Page &page : pages) {
+        page.residency = residency->TrackMapped(page.resource.Get());
+    }
+}
+
+void ConstantAllocator::BeginFrame(UINT64 completedFenceValue) {
+    policy.BeginFrame(completedFenceValue);
+}
+
+void ConstantAllocator::EndFrame(UINT64 fenceValue) {
+    policy.EndFrame(fenceValue);
+}
+
+HRESULT ConstantAllocator::Allocate(UINT64 size, void **cpuAddress, D3D12_GPU_VIRTUAL_ADDRESS *gpuAddress,
+                                    ID3D12Resource **resource, UINT64 *resourceOffset) {
+    size_t page;
+    UINT64 offset;
+
+    if (!policy.Allocate(size, page, offset)) {
+        HRESULT hr = CreatePage(policy.GetNewPageSize(size));
+        if (FAILED(hr)) {
+            return hr;
+        }
+        policy.Allocate(size, page, offset);
+    }
+
+    if (residency) {
+        residency->Use(pages[page].residency);
+    }
+    *cpuAddress = pages[page].cpuAddress + offset;
+    *gpuAddress = pages[page].gpuAddress + offset;
+    if (resource) {
+        *resource = pages[page].resource.Get();
+    }
+    if (resourceOffset) {
+        *resourceOffset = offset;
+    }
+
+    return S_OK;
+}
+
+HRESULT ConstantAllocator::CreatePage(UINT64 size) {
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_UPLOAD;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Alignment          = 0;
+    desc.Width              = size;
+    desc.Height             = 1;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = DXGI_FORMAT_UNKNOWN;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    Page page = { };
+
+    HRESULT hr = device->CreateCommittedResource(
+        &properties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&page.resource));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Upload heaps may stay mapped for the lifetime of the resource. The CPU never reads them.
+    D3D12_RANGE readRange = { 0, 0 };
+    void *cpuAddress;
+    hr = page.resource->Map(0, &readRange, &cpuAddress);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    page.cpuAddress = (BYTE *) cpuAddress;
+    page.gpuAddress = page.resource->GetGPUVirtualAddress();
+    page.residency = residency ? residency->TrackMapped(page.resource.Get()) : ResidencyPolicy::InvalidHandle;
+
+    pages.push_back(page);
+    policy.AddPage(size);
+
+    return S_OK;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ConstantPagePolicy.h"
+#include "ResidencyManager.h"
+
+// Root constants are limited to 64 DWORDs per root signature; keep the fast path well below that.
+constexpr UINT MaxRootConstantBytes = 16 * sizeof(UINT);
+
+// Sets a small payload directly as root constants, avoiding constant buffer memory altogether.
+template <typename T>
+void SetGraphicsRootConstants(ID3D12GraphicsCommandList *commandList, UINT rootParameterIndex, const T &data) {
+    static_assert(sizeof(T) % sizeof(UINT) == 0, "Root constants are set in 32-bit values.");
+    static_assert(sizeof(T) <= MaxRootConstantBytes, "Payload is too large for root constants, use ConstantAllocator.");
+    commandList->SetGraphicsRoot32BitConstants(rootParameterIndex, sizeof(T) / sizeof(UINT), &data, 0);
+}
+
+// Linear allocator for per-frame constant data in persistently mapped UPLOAD-heap pages.
+// Every allocation is aligned to D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT so its GPU
+// virtual address can be passed to SetGraphicsRootConstantBufferView. Pages used by a frame
+// are recycled once the fence value given to EndFrame() has completed. The bookkeeping is
+// ConstantPagePolicy. DrawTexture uses it for data written once per frame (the object
+// constants, copied to video memory, and the HUD quads); per-object root CBVs went
+// away with ExecuteIndirect, see OnRender().
+class ConstantAllocator {
+public:
+    static constexpr UINT64 DefaultPageSize = 64 * 1024;
+
+    HRESULT Init(ID3D12Device *device, UINT64 pageSize = DefaultPageSize);
+    // Tracks the pages from now on, including new ones. Allocate() marks its page used.
+    void TrackResidency(ResidencyManager *residency);
+
+    void BeginFrame(UINT64 completedFenceValue);
+    void EndFrame(UINT64 fenceValue);
+
+    // resource and resourceOffset, when given, receive the page and the offset in it, for
+    // copies out of the allocation.
+    HRESULT Allocate(UINT64 size, void **cpuAddress, D3D12_GPU_VIRTUAL_ADDRESS *gpuAddress,
+                     ID3D12Resource **resource = nullptr, UINT64 *resourceOffset = nullptr);
+
+    // Copies data into constant memory and returns its GPU virtual address, or 0 on failure.
+    template <typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS Push(const T &data) {
+        void *cpuAddress;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+        if (FAILED(Allocate(sizeof(T), &cpuAddress, &gpuAddress))) {
+            return 0;
+        }
+        memcpy(cpuAddress, &data, sizeof(T));
+        return gpuAddress;
+    }
+
+    UINT64 GetFrameBytes() const { return policy.GetFrameBytes(); }
+    UINT GetFrameAllocations() const { return policy.GetFrameAllocations(); }
+    size_t GetPageCount() const { return pages.size(); }
+
+private:
+    struct Page {
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+        BYTE *cpuAddress;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+        ResidencyHandle residency;
+    };
+
+    HRESULT CreatePage(UINT64 size);
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    ConstantPagePolicy policy;
+    std::vector<Page> pages;  // Numbered like the pages of the policy.
+    ResidencyManager *residency = nullptr;
+};
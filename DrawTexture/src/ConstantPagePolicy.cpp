@@ -0,0 +1,86 @@
+#include "ConstantPagePolicy.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t Align(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+void ConstantPagePolicy::Reset(uint64_t pageSize) {
+    this->pageSize = Align(pageSize, Alignment);
+
+    pages.clear();
+    freePages.clear();
+    framePages.clear();
+    pendingPages.clear();
+    currentPage = SIZE_MAX;
+    offset = 0;
+    frameBytes = 0;
+    frameAllocations = 0;
+}
+
+void ConstantPagePolicy::BeginFrame(uint64_t completedFenceValue) {
+    pendingPages.erase(std::remove_if(pendingPages.begin(), pendingPages.end(), [&](size_t index) {
+        if (pages[index].fenceValue > completedFenceValue) {
+            return false;
+        }
+        freePages.push_back(index);
+        return true;
+    }), pendingPages.end());
+
+    currentPage = SIZE_MAX;
+    offset = 0;
+    frameBytes = 0;
+    frameAllocations = 0;
+}
+
+void ConstantPagePolicy::EndFrame(uint64_t fenceValue) {
+    for (size_t index : framePages) {
+        pages[index].fenceValue = fenceValue;
+        pendingPages.push_back(index);
+    }
+
+    framePages.clear();
+    currentPage = SIZE_MAX;
+}
+
+bool ConstantPagePolicy::Allocate(uint64_t size, size_t &page, uint64_t &offset) {
+    uint64_t alignedSize = Align((std::max<uint64_t>)(size, 1), Alignment);
+
+    if (currentPage == SIZE_MAX || this->offset + alignedSize > pages[currentPage].size) {
+        auto free = std::find_if(freePages.begin(), freePages.end(), [&](size_t index) {
+            return pages[index].size >= alignedSize;
+        });
+        if (free == freePages.end()) {
+            return false;
+        }
+
+        currentPage = *free;
+        freePages.erase(free);
+        framePages.push_back(currentPage);
+        this->offset = 0;
+    }
+
+    page = currentPage;
+    offset = this->offset;
+
+    this->offset += alignedSize;
+    frameBytes += alignedSize;
+    frameAllocations++;
+
+    return true;
+}
+
+uint64_t ConstantPagePolicy::GetNewPageSize(uint64_t size) const {
+    return (std::max)(Align((std::max<uint64_t>)(size, 1), Alignment), pageSize);
+}
+
+size_t ConstantPagePolicy::AddPage(uint64_t size) {
+    pages.push_back({ size, 0 });
+    freePages.push_back(pages.size() - 1);
+    return pages.size() - 1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bookkeeping for ConstantAllocator: linear sub-allocation from pages, and recycling of the
+// pages a frame used once the fence value of that frame has completed. Pages are numbered
+// in the order AddPage() is called; the allocator owns the memory behind them. No D3D12
+// types are involved, so the policy can be tested and measured with plain memory.
+class ConstantPagePolicy {
+public:
+    // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT.
+    static constexpr uint64_t Alignment = 256;
+
+    void Reset(uint64_t pageSize);
+
+    void BeginFrame(uint64_t completedFenceValue);
+    void EndFrame(uint64_t fenceValue);
+
+    // Places size bytes, rounded up to Alignment, in the current page or a free one. False
+    // when no page has room; the caller then adds a page of GetNewPageSize(size) bytes and
+    // calls Allocate() again.
+    bool Allocate(uint64_t size, size_t &page, uint64_t &offset);
+    uint64_t GetNewPageSize(uint64_t size) const;
+    // Adds a free page and returns its number.
+    size_t AddPage(uint64_t size);
+
+    uint64_t GetPageSize() const { return pageSize; }
+    uint64_t GetFrameBytes() const { return frameBytes; }
+    uint32_t GetFrameAllocations() const { return frameAllocations; }
+    size_t GetPageCount() const { return pages.size(); }
+    size_t GetFreePageCount() const { return freePages.size(); }
+
+private:
+    struct Page {
+        uint64_t size;
+        uint64_t fenceValue;
+    };
+
+    uint64_t pageSize = 0;
+    std::vector<Page> pages;
+    std::vector<size_t> freePages;    // Ready for reuse.
+    std::vector<size_t> framePages;   // Handed out in the current frame.
+    std::vector<size_t> pendingPages; // Waiting for their fence.
+    size_t currentPage = SIZE_MAX;
+    uint64_t offset = 0;
+    uint64_t frameBytes = 0;
+    uint32_t frameAllocations = 0;
+};
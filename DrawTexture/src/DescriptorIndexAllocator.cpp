@@ -0,0 +1,61 @@
+#include "DescriptorIndexAllocator.h"
+
+#include <algorithm>
+#include <functional>
+
+DescriptorIndexAllocator::DescriptorIndexAllocator(uint32_t capacity) {
+    Reset(capacity);
+}
+
+void DescriptorIndexAllocator::Reset(uint32_t capacity) {
+    this->capacity = capacity;
+    states.assign(capacity, State::Free);
+    freeIndices.clear();
+    pending.clear();
+    allocatedCount = 0;
+    highWaterMark = 0;
+}
+
+uint32_t DescriptorIndexAllocator::Allocate() {
+    uint32_t index;
+    if (!freeIndices.empty()) {
+        std::pop_heap(freeIndices.begin(), freeIndices.end(), std::greater<uint32_t>());
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    } else if (highWaterMark < capacity) {
+        // Indices above the high-water mark have never been used and need no free list entry.
+        index = highWaterMark++;
+    } else {
+        return InvalidIndex;
+    }
+
+    states[index] = State::Allocated;
+    allocatedCount++;
+    return index;
+}
+
+bool DescriptorIndexAllocator::Free(uint32_t index, uint64_t fenceValue) {
+    if (!IsAllocated(index)) {
+        return false;
+    }
+
+    states[index] = State::Pending;
+    allocatedCount--;
+    pending.push_back({ index, fenceValue });
+    return true;
+}
+
+void DescriptorIndexAllocator::Reclaim(uint64_t completedFenceValue) {
+    // Fence values may arrive out of order from different queues, so every entry is checked.
+    size_t kept = 0;
+    for (const PendingIndex &entry : pending) {
+        if (entry.fenceValue <= completedFenceValue) {
+            states[entry.index] = State::Free;
+            freeIndices.push_back(entry.index);
+            std::push_heap(freeIndices.begin(), freeIndices.end(), std::greater<uint32_t>());
+        } else {
+            pending[kept++] = entry;
+        }
+    }
+    pending.resize(kept);
+}
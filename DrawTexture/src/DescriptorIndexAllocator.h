@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stable indices into a bindless descriptor heap. Shaders reach a descriptor by its
+// index, so an index must not be reused while the GPU may still read it: Free() takes
+// the fence value of the last submission that can use the index, and the index only
+// becomes available again once Reclaim() sees that value completed. No D3D12 types are
+// involved, so the lifetime rules can be exercised without a device.
+class DescriptorIndexAllocator {
+public:
+    static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+    explicit DescriptorIndexAllocator(uint32_t capacity = 0);
+
+    // Forgets every allocation, including pending ones.
+    void Reset(uint32_t capacity);
+
+    // Returns the lowest free index or InvalidIndex when the heap is full.
+    uint32_t Allocate();
+    // False if index is not allocated, e.g. freed twice.
+    bool Free(uint32_t index, uint64_t fenceValue);
+    // Returns the indices whose fence value has completed to the free list.
+    void Reclaim(uint64_t completedFenceValue);
+
+    bool IsAllocated(uint32_t index) const { return index < capacity && states[index] == State::Allocated; }
+
+    uint32_t GetCapacity() const { return capacity; }
+    uint32_t GetAllocatedCount() const { return allocatedCount; }
+    uint32_t GetPendingCount() const { return uint32_t(pending.size()); }
+    // One past the highest index handed out since Reset(); descriptors above it were never written.
+    uint32_t GetHighWaterMark() const { return highWaterMark; }
+
+private:
+    enum class State : uint8_t {
+        Free,
+        Allocated,
+        Pending,    // Freed, waiting for its fence.
+    };
+
+    struct PendingIndex {
+        uint32_t index;
+        uint64_t fenceValue;
+    };
+
+    std::vector<State> states;
+    std::vector<uint32_t> freeIndices;   // A min-heap, so the used part of the heap stays compact.
+    std::vector<PendingIndex> pending;   // In the order of Free().
+    uint32_t capacity = 0;
+    uint32_t allocatedCount = 0;
+    uint32_t highWaterMark = 0;
+};
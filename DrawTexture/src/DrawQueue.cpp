@@ -0,0 +1,116 @@
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include "Parallel.h"
+
+uint64_t DrawKey::Make(uint32_t layer, uint32_t pipeline, uint32_t material, float depth, bool backToFront) {
+    // The bits of non-negative floats order like the floats themselves.
+    uint32_t depthBits = 0;
+    if (depth > 0.0f) {
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+    }
+    if (backToFront) {
+        depthBits = ~depthBits;
+    }
+
+    return Layer::Encode(layer) | Pipeline::Encode(pipeline) | Material::Encode(material) | Depth::Encode(depthBits);
+}
+
+void DrawQueue::Sort() {
+    auto start = std::chrono::steady_clock::now();
+
+    sortPasses = 0;
+    size_t count = packets.size();
+    size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    histograms.assign(chunkCount * DigitCount * BucketCount, 0);
+    scratch.resize(count);
+
+    auto getBucket = [](uint64_t key, uint32_t digit) {
+        return uint32_t(key >> (digit * DigitBits)) & (BucketCount - 1);
+    };
+
+    // Raw pointers, so the compiler does not reload them after every store.
+    DrawPacket *source = packets.data();
+    DrawPacket *target = scratch.data();
+
+    // One read counts all digits. The totals do not depend on the order, so they also
+    // tell which digits are the same in every key.
+    ParallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            uint32_t *counts = &histograms[chunk * DigitCount * BucketCount];
+            size_t last = (std::min)(count, (chunk + 1) * ChunkSize);
+            for (size_t i = chunk * ChunkSize; i < last; i++) {
+                uint64_t key = source[i].key;
+                for (uint32_t digit = 0; digit < DigitCount; digit++) {
+                    counts[digit * BucketCount + getBucket(key, digit)]++;
+                }
+            }
+        }
+    });
+
+    // The chunk counts of the first read match the order of the packets until the first scatter.
+    bool countsCurrent = true;
+    for (uint32_t digit = 0; digit < DigitCount; digit++) {
+        bool uniform = false;
+        for (uint32_t bucket = 0; bucket < BucketCount && !uniform; bucket++) {
+            size_t total = 0;
+            for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+                total += histograms[(chunk * DigitCount + digit) * BucketCount + bucket];
+            }
+            uniform = total == count;
+        }
+        if (uniform || count == 0) {
+            continue;
+        }
+
+        if (!countsCurrent) {
+            ParallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+                for (size_t chunk = begin; chunk < end; chunk++) {
+                    uint32_t *counts = &histograms[(chunk * DigitCount + digit) * BucketCount];
+                    memset(counts, 0, BucketCount * sizeof(uint32_t));
+                    size_t last = (std::min)(count, (chunk + 1) * ChunkSize);
+                    for (size_t i = chunk * ChunkSize; i < last; i++) {
+                        counts[getBucket(source[i].key, digit)]++;
+                    }
+                }
+            });
+        }
+
+        // Counts become write offsets: buckets in order, and chunks in order within a
+        // bucket, which keeps the sort stable.
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < BucketCount; bucket++) {
+            for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+                uint32_t &value = histograms[(chunk * DigitCount + digit) * BucketCount + bucket];
+                uint32_t bucketCount = value;
+                value = offset;
+                offset += bucketCount;
+            }
+        }
+
+        ParallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+            for (size_t chunk = begin; chunk < end; chunk++) {
+                uint32_t offsets[BucketCount];
+                memcpy(offsets, &histograms[(chunk * DigitCount + digit) * BucketCount], sizeof(offsets));
+                size_t last = (std::min)(count, (chunk + 1) * ChunkSize);
+                for (size_t i = chunk * ChunkSize; i < last; i++) {
+                    target[offsets[getBucket(source[i].key, digit)]++] = source[i];
+                }
+            }
+        });
+
+        std::swap(source, target);
+        countsCurrent = false;
+        sortPasses++;
+    }
+
+    if (source != packets.data()) {
+        std::swap(packets, scratch);
+    }
+
+    sortTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
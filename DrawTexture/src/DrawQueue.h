@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A value stored in bits [Shift, Shift + Bits) of a draw sort key.
+template <uint32_t Shift, uint32_t Bits>
+struct DrawKeyField {
+    static constexpr uint64_t Mask = ((uint64_t(1) << Bits) - 1) << Shift;
+    static constexpr uint64_t ValueCount = uint64_t(1) << Bits;
+
+    // Values that do not fit are truncated.
+    static constexpr uint64_t Encode(uint64_t value) {
+        return (value << Shift) & Mask;
+    }
+
+    static constexpr uint32_t Decode(uint64_t key) {
+        return uint32_t((key & Mask) >> Shift);
+    }
+};
+
+// Sort key of a draw, most significant field first. Sorting by the key groups draws by
+// layer, then by pipeline state and material so that state changes are rare, and orders
+// them by depth within each group.
+struct DrawKey {
+    using Depth = DrawKeyField<0, 32>;
+    using Material = DrawKeyField<32, 16>;
+    using Pipeline = DrawKeyField<48, 12>;
+    using Layer = DrawKeyField<60, 4>;
+
+    // Depths are view distances; negative ones are clamped to 0. Translucent layers sort
+    // back to front.
+    static uint64_t Make(uint32_t layer, uint32_t pipeline, uint32_t material, float depth, bool backToFront = false);
+};
+
+static_assert((DrawKey::Depth::Mask | DrawKey::Material::Mask | DrawKey::Pipeline::Mask | DrawKey::Layer::Mask) == UINT64_MAX, "Draw key fields must cover the key.");
+static_assert((DrawKey::Material::Mask & DrawKey::Pipeline::Mask) == 0 && (DrawKey::Pipeline::Mask & DrawKey::Layer::Mask) == 0, "Draw key fields overlap.");
+
+// One draw: its key, the object whose constants it uses and the mesh it draws.
+struct DrawPacket {
+    uint64_t key;
+    uint32_t objectId;
+    uint32_t mesh;
+};
+
+static_assert(sizeof(DrawPacket) == 16, "DrawPacket should stay 16 bytes; the sort moves whole packets.");
+
+// Draw packets of a frame, sorted by key with a parallel LSD radix sort: 8-bit digits,
+// per-chunk histograms counted in parallel, then a stable parallel scatter. Digits that
+// are equal in all keys (e.g. a single layer) are skipped, so typical frames take far
+// fewer than 8 passes. Equal keys keep the order in which they were added.
+class DrawQueue {
+public:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    void Clear() { packets.clear(); }
+    void Add(uint64_t key, uint32_t objectId, uint32_t mesh) { packets.push_back({ key, objectId, mesh }); }
+    void Reserve(size_t count) { packets.reserve(count); }
+
+    void Sort();
+
+    const std::vector<DrawPacket> &GetPackets() const { return packets; }
+    size_t GetCount() const { return packets.size(); }
+    uint32_t GetSortPasses() const { return sortPasses; } // Scatter passes run by the last Sort().
+    double GetSortTime() const { return sortTime; }      // Milliseconds spent in the last Sort().
+
+private:
+    static constexpr uint32_t DigitBits = 8;
+    static constexpr uint32_t DigitCount = 64 / DigitBits;
+    static constexpr uint32_t BucketCount = 1u << DigitBits;
+
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+    std::vector<uint32_t> histograms;  // [chunk][digit][bucket], then [chunk][bucket] write offsets.
+    uint32_t sortPasses = 0;
+    double sortTime = 0.0;
+};
@@ -0,0 +1,202 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uintptr_t Align(uintptr_t value, uintptr_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void Poison(uint8_t *memory, size_t size) {
+#ifdef _DEBUG
+    memset(memory, FrameArenaPoison, size);
+#else
+    (void) memory;
+    (void) size;
+#endif
+}
+
+}
+
+// FrameArena
+
+void FrameArena::Init(size_t blockSize) {
+    this->blockSize = blockSize;
+
+    blocks.clear();
+    freeBlocks.clear();
+    frameBlocks.clear();
+    pendingBlocks.clear();
+    currentBlock = SIZE_MAX;
+    offset = 0;
+    usedBytes = 0;
+    highWaterMark = 0;
+    capacity = 0;
+    heapAllocationCount = 0;
+
+    NextBlock(blockSize);
+    freeBlocks.push_back(frameBlocks.back());
+    frameBlocks.clear();
+    currentBlock = SIZE_MAX;
+}
+
+void FrameArena::BeginFrame(uint64_t completedFenceValue) {
+    pendingBlocks.erase(std::remove_if(pendingBlocks.begin(), pendingBlocks.end(), [&](size_t index) {
+        if (blocks[index].fenceValue > completedFenceValue) {
+            return false;
+        }
+        Poison(blocks[index].memory.get(), blocks[index].size);
+        freeBlocks.push_back(index);
+        return true;
+    }), pendingBlocks.end());
+
+    currentBlock = SIZE_MAX;
+    offset = 0;
+    usedBytes = 0;
+}
+
+void FrameArena::EndFrame(uint64_t fenceValue) {
+    for (size_t index : frameBlocks) {
+        blocks[index].fenceValue = fenceValue;
+        pendingBlocks.push_back(index);
+    }
+
+    frameBlocks.clear();
+    currentBlock = SIZE_MAX;
+    offset = 0;
+    usedBytes = 0;
+}
+
+void *FrameArena::Allocate(size_t size, size_t alignment) {
+    size = (std::max<size_t>)(size, 1);
+
+    // The address is aligned, not the offset, so alignments above the block's also hold.
+    auto getStart = [&]() {
+        uintptr_t base = (uintptr_t) blocks[frameBlocks[currentBlock]].memory.get();
+        return size_t(Align(base + offset, alignment) - base);
+    };
+    size_t start = currentBlock == SIZE_MAX ? 0 : getStart();
+    if (currentBlock == SIZE_MAX || start + size > blocks[frameBlocks[currentBlock]].size) {
+        NextBlock(size + alignment);
+        start = getStart();
+    }
+
+    uint8_t *memory = blocks[frameBlocks[currentBlock]].memory.get() + start;
+    usedBytes += start + size - offset;
+    offset = start + size;
+    highWaterMark = (std::max)(highWaterMark, usedBytes);
+    return memory;
+}
+
+void FrameArena::Rewind(const Marker &marker) {
+    if (currentBlock == SIZE_MAX || (marker.block == currentBlock && marker.offset >= offset)) {
+        return;
+    }
+
+    // Blocks after the marker's are not used by anything older, so they can be reused now.
+    size_t keep = marker.block == SIZE_MAX ? 0 : marker.block + 1;
+    for (size_t i = frameBlocks.size(); i-- > keep;) {
+        Poison(blocks[frameBlocks[i]].memory.get(), blocks[frameBlocks[i]].size);
+        freeBlocks.push_back(frameBlocks[i]);
+    }
+    frameBlocks.resize(keep);
+    if (marker.block != SIZE_MAX) {
+        Block &block = blocks[frameBlocks[marker.block]];
+        size_t end = marker.block == currentBlock ? offset : block.size;
+        Poison(block.memory.get() + marker.offset, end - marker.offset);
+    }
+
+    currentBlock = marker.block;
+    offset = marker.offset;
+    usedBytes = marker.usedBytes;
+}
+
+void FrameArena::NextBlock(size_t size) {
+    size_t index = SIZE_MAX;
+
+    // Free blocks are taken back to front, so Rewind() followed by the same allocations
+    // gets the same blocks.
+    for (size_t i = freeBlocks.size(); i-- > 0;) {
+        if (blocks[freeBlocks[i]].size >= size) {
+            index = freeBlocks[i];
+            freeBlocks.erase(freeBlocks.begin() + i);
+            break;
+        }
+    }
+
+    if (index == SIZE_MAX) {
+        Block block;
+        block.size = (std::max)(Align(size, alignof(std::max_align_t)), blockSize);
+        block.memory.reset(new uint8_t[block.size]);
+        block.fenceValue = 0;
+        Poison(block.memory.get(), block.size);
+        capacity += block.size;
+        heapAllocationCount++;
+
+        index = blocks.size();
+        blocks.push_back(std::move(block));
+
+        // Every block is on at most one of the lists, so sized for all of them now they
+        // never grow in BeginFrame() or EndFrame() once the arena has warmed up.
+        freeBlocks.reserve(blocks.size());
+        frameBlocks.reserve(blocks.size());
+        pendingBlocks.reserve(blocks.size());
+    }
+
+    // Bytes left at the end of the previous block count as used until the frame ends.
+    if (currentBlock != SIZE_MAX) {
+        usedBytes += blocks[frameBlocks[currentBlock]].size - offset;
+    }
+
+    frameBlocks.push_back(index);
+    currentBlock = frameBlocks.size() - 1;
+    offset = 0;
+}
+
+// FrameArenaPool
+
+void FrameArenaPool::Init(uint32_t threadCount, size_t blockSize) {
+    arenas.clear();
+    arenas.resize((std::max)(threadCount, 1u));
+    for (FrameArena &arena : arenas) {
+        arena.Init(blockSize);
+    }
+}
+
+void FrameArenaPool::BeginFrame(uint64_t completedFenceValue) {
+    for (FrameArena &arena : arenas) {
+        arena.BeginFrame(completedFenceValue);
+    }
+}
+
+void FrameArenaPool::EndFrame(uint64_t fenceValue) {
+    for (FrameArena &arena : arenas) {
+        arena.EndFrame(fenceValue);
+    }
+}
+
+size_t FrameArenaPool::GetHighWaterMark() const {
+    size_t bytes = 0;
+    for (const FrameArena &arena : arenas) {
+        bytes += arena.GetHighWaterMark();
+    }
+    return bytes;
+}
+
+size_t FrameArenaPool::GetCapacity() const {
+    size_t bytes = 0;
+    for (const FrameArena &arena : arenas) {
+        bytes += arena.GetCapacity();
+    }
+    return bytes;
+}
+
+uint64_t FrameArenaPool::GetHeapAllocationCount() const {
+    uint64_t count = 0;
+    for (const FrameArena &arena : arenas) {
+        count += arena.GetHeapAllocationCount();
+    }
+    return count;
+}
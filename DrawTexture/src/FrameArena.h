@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Bump allocator for CPU data that lives for one frame: draw lists, barrier batches,
+// culling results. Memory comes from blocks that are recycled once the fence value given to
+// EndFrame() has completed, like ConstantAllocator, so once the blocks cover the largest
+// frame the frame loop does not touch the heap. Destructors are not run and nothing is
+// freed individually; GetMarker() and Rewind() (or FrameArenaScope) release everything
+// allocated after a point, for nested lifetimes shorter than the frame. Debug builds fill
+// released memory with FrameArenaPoison. Not thread safe; FrameArenaPool has one per thread.
+class FrameArena {
+public:
+    static constexpr size_t DefaultBlockSize = 64 * 1024;
+
+    struct Marker {
+        size_t block;   // Index into frameBlocks, or SIZE_MAX before the first allocation.
+        size_t offset;
+        size_t usedBytes;
+    };
+
+    FrameArena() = default;
+    FrameArena(FrameArena &&) = default;
+    FrameArena &operator=(FrameArena &&) = default;
+
+    // Allocates the first block, so the first frame does not allocate.
+    void Init(size_t blockSize = DefaultBlockSize);
+
+    void BeginFrame(uint64_t completedFenceValue);
+    void EndFrame(uint64_t fenceValue);
+
+    // Never fails short of the heap; a request larger than the block size gets its own block.
+    // alignment must be a power of two.
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T *AllocateArray(size_t count) {
+        return (T *) Allocate(sizeof(T) * count, alignof(T));
+    }
+
+    Marker GetMarker() const { return { currentBlock, offset, usedBytes }; }
+    // Releases everything allocated after marker, which must be from the current frame.
+    void Rewind(const Marker &marker);
+
+    size_t GetUsedBytes() const { return usedBytes; }        // Allocated in the current frame.
+    size_t GetHighWaterMark() const { return highWaterMark; } // Most bytes allocated at once.
+    size_t GetCapacity() const { return capacity; }           // Bytes of all blocks.
+    size_t GetBlockCount() const { return blocks.size(); }
+    uint64_t GetHeapAllocationCount() const { return heapAllocationCount; }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+        uint64_t fenceValue;
+    };
+
+    void NextBlock(size_t size);
+
+    size_t blockSize = DefaultBlockSize;
+    std::vector<Block> blocks;
+    std::vector<size_t> freeBlocks;    // Indices into blocks, ready for reuse.
+    std::vector<size_t> frameBlocks;   // Blocks handed out in the current frame, in order.
+    std::vector<size_t> pendingBlocks; // Blocks waiting for their fence.
+    size_t currentBlock = SIZE_MAX;    // Index into frameBlocks.
+    size_t offset = 0;
+    size_t usedBytes = 0;
+    size_t highWaterMark = 0;
+    size_t capacity = 0;
+    uint64_t heapAllocationCount = 0;
+};
+
+constexpr uint8_t FrameArenaPoison = 0xDD;
+
+// Rewinds the arena to where it was when the scope was entered.
+class FrameArenaScope {
+public:
+    explicit FrameArenaScope(FrameArena &arena) : arena(arena), marker(arena.GetMarker()) { }
+    ~FrameArenaScope() { arena.Rewind(marker); }
+
+    FrameArenaScope(const FrameArenaScope &) = delete;
+    FrameArenaScope &operator=(const FrameArenaScope &) = delete;
+
+private:
+    FrameArena &arena;
+    FrameArena::Marker marker;
+};
+
+// Standard allocator over a FrameArena. deallocate() does nothing, so a growing container
+// leaves its old buffers behind until the frame ends; reserve what is known up front.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(FrameArena &arena) : arena(&arena) { }
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.GetArena()) { }
+
+    T *allocate(size_t count) { return arena->AllocateArray<T>(count); }
+    void deallocate(T *, size_t) { }
+
+    FrameArena *GetArena() const { return arena; }
+
+private:
+    FrameArena *arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.GetArena() == b.GetArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.GetArena() != b.GetArena();
+}
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+// One FrameArena per thread, recycled together. Thread 0 is the render thread; workers
+// use the index they are started with.
+class FrameArenaPool {
+public:
+    void Init(uint32_t threadCount, size_t blockSize = FrameArena::DefaultBlockSize);
+
+    void BeginFrame(uint64_t completedFenceValue);
+    void EndFrame(uint64_t fenceValue);
+
+    FrameArena &Get(uint32_t thread) { return arenas[thread]; }
+    uint32_t GetThreadCount() const { return (uint32_t) arenas.size(); }
+
+    // Sums over the threads.
+    size_t GetHighWaterMark() const;
+    size_t GetCapacity() const;
+    uint64_t GetHeapAllocationCount() const;
+
+private:
+    std::vector<FrameArena> arenas;
+};
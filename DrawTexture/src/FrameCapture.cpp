@@ -0,0 +1,163 @@
+#include "FrameCapture.h"
+
+#include <chrono>
+#include <memory>
+
+using Microsoft::WRL::ComPtr;
+
+FrameCapture::~FrameCapture() {
+    encoder.Stop();
+}
+
+HRESULT FrameCapture::Init(ID3D12Device *device, const D3D12_RESOURCE_DESC &targetDesc, UINT slotCount, UINT workerCount) {
+    switch (targetDesc.Format) {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        order = ChannelOrder::Rgba;
+        break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        order = ChannelOrder::Bgra;
+        break;
+    default:
+        return E_INVALIDARG;
+    }
+
+    encoder.Stop();
+    device->GetCopyableFootprints(&targetDesc, 0, 1, 0, &footprint, &height, nullptr, &bufferSize);
+
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_READBACK;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Alignment          = 0;
+    desc.Width              = bufferSize;
+    desc.Height             = 1;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = DXGI_FORMAT_UNKNOWN;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    slots.assign(slotCount, Slot());
+    for (Slot &slot : slots) {
+        HRESULT hr = device->CreateCommittedResource(&properties, D3D12_HEAP_FLAG_NONE, &desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&slot.buffer));
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    ring.Reset(slotCount);
+    // One job per slot can wait; more could not have a buffer anyway.
+    encoder.Start(workerCount, slotCount);
+    return S_OK;
+}
+
+void FrameCapture::TrackResidency(ResidencyManager *residency) {
+    this->residency = residency;
+    for (Slot &slot : slots) {
+        slot.residency = residency->TrackMapped(slot.buffer.Get());
+    }
+}
+
+void FrameCapture::BeginFrame(UINT64 completedFenceValue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.clear();
+    ring.Poll(completedFenceValue, ready);
+
+    for (uint32_t index : ready) {
+        Slot &slot = slots[index];
+        ID3D12Resource *buffer = slot.buffer.Get();
+
+        EncodeJob job;
+        job.path = slot.path;
+        job.format = slot.format;
+        // Mapping happens on the worker, so the render thread never touches the pixels.
+        // release() runs even when acquire() fails, and must only unmap what was mapped.
+        auto mapped = std::make_shared<bool>(false);
+        job.acquire = [this, buffer, mapped](ImageView &image) {
+            D3D12_RANGE readRange = { 0, SIZE_T(bufferSize) };
+            void *data;
+            if (FAILED(buffer->Map(0, &readRange, &data))) {
+                return false;
+            }
+            *mapped = true;
+            image = { (const uint8_t *) data + footprint.Offset, footprint.Footprint.Width, height,
+                      footprint.Footprint.RowPitch, order };
+            return true;
+        };
+        job.release = [this, buffer, index, mapped]() {
+            if (*mapped) {
+                D3D12_RANGE writtenRange = { 0, 0 };
+                buffer->Unmap(0, &writtenRange);
+            }
+            Release(index);
+        };
+
+        if (!encoder.Push(std::move(job))) {
+            queueDropCount++;
+            ring.Release(index);
+        }
+    }
+}
+
+bool FrameCapture::Record(ID3D12GraphicsCommandList *commandList, ID3D12Resource *source, const std::string &path, ImageFileFormat format) {
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t index;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index = ring.Acquire();
+    }
+    if (index != ReadbackRing::InvalidSlot) {
+        Slot &slot = slots[index];
+        slot.path = path;
+        slot.format = format;
+        if (residency) {
+            residency->Use(slot.residency);
+        }
+
+        D3D12_TEXTURE_COPY_LOCATION dst;
+        dst.pResource       = slot.buffer.Get();
+        dst.Type            = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        dst.PlacedFootprint = footprint;
+
+        D3D12_TEXTURE_COPY_LOCATION src;
+        src.pResource        = source;
+        src.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        src.SubresourceIndex = 0;
+
+        commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+
+    recordTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return index != ReadbackRing::InvalidSlot;
+}
+
+void FrameCapture::EndFrame(UINT64 fenceValue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ring.Submit(fenceValue);
+}
+
+void FrameCapture::Flush(UINT64 completedFenceValue) {
+    BeginFrame(completedFenceValue);
+    encoder.Flush();
+}
+
+UINT64 FrameCapture::GetDroppedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ring.GetDroppedCount() + queueDropCount;
+}
+
+void FrameCapture::Release(UINT slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ring.Release(slot);
+}
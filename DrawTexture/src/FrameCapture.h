@@ -0,0 +1,66 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ImageEncoder.h"
+#include "ReadbackRing.h"
+#include "ResidencyManager.h"
+
+// Screenshots and frame sequences without stalling the frame. Record() only records a
+// copy into one of a ring of READBACK buffers; once the fence of that frame has
+// completed, BeginFrame() hands the buffer to worker threads, which map it, encode it and
+// write the file. When every buffer or the encoder queue is busy the capture is dropped.
+class FrameCapture {
+public:
+    ~FrameCapture();
+
+    // targetDesc describes the textures to capture: 8-bit RGBA or BGRA, one subresource.
+    HRESULT Init(ID3D12Device *device, const D3D12_RESOURCE_DESC &targetDesc, UINT slotCount, UINT workerCount);
+    // Tracks the readback buffers. Record() marks the buffer it copies into used.
+    void TrackResidency(ResidencyManager *residency);
+
+    void BeginFrame(UINT64 completedFenceValue);
+    // Records a copy of source, which must be in D3D12_RESOURCE_STATE_COPY_SOURCE.
+    // False if the capture was dropped.
+    bool Record(ID3D12GraphicsCommandList *commandList, ID3D12Resource *source, const std::string &path, ImageFileFormat format);
+    void EndFrame(UINT64 fenceValue);
+
+    // Writes every capture whose fence has completed and waits for the files.
+    void Flush(UINT64 completedFenceValue);
+
+    double GetRecordTime() const { return recordTime; }   // Milliseconds spent in the last Record().
+    UINT64 GetDroppedCount() const;
+    UINT GetWrittenCount() const { return encoder.GetWrittenCount(); }
+
+private:
+    struct Slot {
+        Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+        std::string path;
+        ImageFileFormat format;
+        ResidencyHandle residency;
+    };
+
+    void Release(UINT slot);
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = { };
+    UINT height = 0;
+    UINT64 bufferSize = 0;
+    ChannelOrder order = ChannelOrder::Rgba;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> ready;
+    double recordTime = 0.0;
+    UINT64 queueDropCount = 0;
+    ResidencyManager *residency = nullptr;
+
+    // Workers release slots, so the ring is shared with them.
+    mutable std::mutex mutex;
+    ReadbackRing ring;
+
+    // Last, so the workers stop before the buffers they read are released.
+    ImageEncodeQueue encoder;
+};
@@ -0,0 +1,147 @@
+#include "FrustumCuller.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "Parallel.h"
+
+Frustum ExtractFrustum(const Matrix4x4 &viewProjection) {
+    // clip = (x, y, z, 1) * M, so each clip coordinate is a column of M.
+    float column[4][4];
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            column[c][r] = viewProjection.m[r][c];
+        }
+    }
+
+    Frustum frustum;
+    for (int i = 0; i < 4; i++) {
+        frustum.planes[0][i] = column[3][i] + column[0][i]; // Left
+        frustum.planes[1][i] = column[3][i] - column[0][i]; // Right
+        frustum.planes[2][i] = column[3][i] + column[1][i]; // Bottom
+        frustum.planes[3][i] = column[3][i] - column[1][i]; // Top
+        frustum.planes[4][i] = column[2][i];                // Near
+        frustum.planes[5][i] = column[3][i] - column[2][i]; // Far
+    }
+
+    // Normalize so that sphere radii and box extents are in the same units as the distances.
+    for (float (&plane)[4] : frustum.planes) {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (float &value : plane) {
+                value /= length;
+            }
+        }
+    }
+
+    return frustum;
+}
+
+void ComputeBoundingSpheres(const BoundsSoA &bounds, SphereSoA &spheres) {
+    size_t count = bounds.GetCount();
+    spheres.Resize(count);
+
+    spheres.center.x = bounds.center.x;
+    spheres.center.y = bounds.center.y;
+    spheres.center.z = bounds.center.z;
+
+    const float *ex = bounds.extents.x.data();
+    const float *ey = bounds.extents.y.data();
+    const float *ez = bounds.extents.z.data();
+    float *radius = spheres.radius.data();
+    for (size_t i = 0; i < count; i++) {
+        radius[i] = std::sqrt(ex[i] * ex[i] + ey[i] * ey[i] + ez[i] * ez[i]);
+    }
+}
+
+void FrustumCuller::SetLodDistances(const std::vector<float> &distances) {
+    lodDistancesSq.clear();
+    for (float distance : distances) {
+        lodDistancesSq.push_back(distance * distance);
+    }
+}
+
+void FrustumCuller::Cull(const Frustum &frustum, const float cameraPosition[3], const SphereSoA &spheres, const BoundsSoA &bounds,
+                         const std::vector<uint32_t> &batchIds, uint32_t batchCount) {
+    auto start = std::chrono::steady_clock::now();
+
+    size_t count = spheres.GetCount();
+    size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+    uint32_t lodCount = GetLodCount();
+    size_t listCount = size_t(batchCount) * lodCount;
+
+    visible.resize(count);
+    lists.resize(count);
+    chunkVisibleCounts.assign(chunkCount, 0);
+    listOffsets.assign(chunkCount * listCount, 0);
+    batches.assign(listCount, InstanceBatch());
+
+    CullStreams streams = {
+        spheres.center.x.data(), spheres.center.y.data(), spheres.center.z.data(), spheres.radius.data(),
+        bounds.center.x.data(), bounds.center.y.data(), bounds.center.z.data(),
+        bounds.extents.x.data(), bounds.extents.y.data(), bounds.extents.z.data(),
+    };
+    const BatchKernels &kernels = GetBatchKernels();
+
+    // Test each chunk and count its visible objects per list.
+    ParallelFor(chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+            size_t begin = chunk * ChunkSize;
+            size_t end = (std::min)(count, begin + ChunkSize);
+            uint32_t *chunkVisible = visible.data() + begin;
+            uint32_t *chunkLists = lists.data() + begin;
+            uint32_t *counts = listOffsets.data() + chunk * listCount;
+
+            size_t n = kernels.cullObjects(frustum, streams, chunkVisible, begin, end);
+
+            for (size_t i = 0; i < n; i++) {
+                uint32_t object = chunkVisible[i];
+                uint32_t lod = 0;
+                if (!lodDistancesSq.empty()) {
+                    float dx = spheres.center.x[object] - cameraPosition[0];
+                    float dy = spheres.center.y[object] - cameraPosition[1];
+                    float dz = spheres.center.z[object] - cameraPosition[2];
+                    float distanceSq = dx * dx + dy * dy + dz * dz;
+                    while (lod < lodDistancesSq.size() && distanceSq >= lodDistancesSq[lod]) {
+                        lod++;
+                    }
+                }
+
+                uint32_t list = batchIds[object] * lodCount + lod;
+                chunkLists[i] = list;
+                counts[list]++;
+            }
+
+            chunkVisibleCounts[chunk] = uint32_t(n);
+        }
+    });
+
+    // Turn the counts into write offsets: lists are contiguous, chunks ordered inside each list.
+    uint32_t offset = 0;
+    for (size_t list = 0; list < listCount; list++) {
+        batches[list].offset = offset;
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            uint32_t &slot = listOffsets[chunk * listCount + list];
+            uint32_t n = slot;
+            slot = offset;
+            offset += n;
+        }
+        batches[list].count = offset - batches[list].offset;
+    }
+
+    instances.resize(offset);
+
+    ParallelFor(chunkCount, 1, [&](size_t chunkBegin, size_t chunkEnd) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+            size_t begin = chunk * ChunkSize;
+            uint32_t *offsets = listOffsets.data() + chunk * listCount;
+            for (size_t i = 0; i < chunkVisibleCounts[chunk]; i++) {
+                instances[offsets[lists[begin + i]]++] = visible[begin + i];
+            }
+        }
+    });
+
+    visibleCount = offset;
+    culledCount = count - offset;
+    cullTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
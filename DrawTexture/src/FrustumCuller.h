@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BatchMath.h"
+
+// Planes of the clip volume 0 <= z <= w of a row-major (row vector) view-projection matrix.
+Frustum ExtractFrustum(const Matrix4x4 &viewProjection);
+
+// Spheres enclosing the boxes, used as the cheap first test of the culler.
+void ComputeBoundingSpheres(const BoundsSoA &bounds, SphereSoA &spheres);
+
+// Range of GetInstances() holding the visible objects of one batch and LOD.
+struct InstanceBatch {
+    uint32_t offset;
+    uint32_t count;
+};
+
+// Culls objects against a frustum in parallel chunks and compacts the visible
+// object indices into one instance list per batch. Each object belongs to a
+// batch (e.g. a mesh/material pair); with LOD distances set, a batch is split
+// into one list per level chosen by the distance to the camera. Lists keep
+// the object order, so results do not depend on the thread count.
+class FrustumCuller {
+public:
+    static constexpr size_t ChunkSize = 16 * 1024;
+
+    // Ascending distances at which the next LOD starts. Empty disables LOD selection.
+    void SetLodDistances(const std::vector<float> &distances);
+    uint32_t GetLodCount() const { return uint32_t(lodDistancesSq.size() + 1); }
+
+    void Cull(const Frustum &frustum, const float cameraPosition[3], const SphereSoA &spheres, const BoundsSoA &bounds,
+              const std::vector<uint32_t> &batchIds, uint32_t batchCount);
+
+    // Indexed by batchId * GetLodCount() + lod.
+    const std::vector<InstanceBatch> &GetBatches() const { return batches; }
+    const InstanceBatch &GetBatch(uint32_t batchId, uint32_t lod = 0) const { return batches[batchId * GetLodCount() + lod]; }
+    const std::vector<uint32_t> &GetInstances() const { return instances; }
+
+    size_t GetVisibleCount() const { return visibleCount; }
+    size_t GetCulledCount() const { return culledCount; }
+    double GetCullTime() const { return cullTime; } // Milliseconds spent in the last Cull().
+
+private:
+    std::vector<float> lodDistancesSq;
+    std::vector<uint32_t> visible;    // Per chunk: compacted indices at the chunk's offset.
+    std::vector<uint32_t> lists;      // List of each entry in visible.
+    std::vector<uint32_t> chunkVisibleCounts;
+    std::vector<uint32_t> listOffsets; // [chunk][list] counts, then write offsets.
+    std::vector<InstanceBatch> batches;
+    std::vector<uint32_t> instances;
+    size_t visibleCount = 0;
+    size_t culledCount = 0;
+    double cullTime = 0.0;
+};
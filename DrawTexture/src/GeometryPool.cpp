@@ -0,0 +1,202 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+constexpr D3D12_RESOURCE_STATES VertexReadState = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+constexpr D3D12_RESOURCE_STATES IndexReadState = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+
+void CopyRanges(ID3D12GraphicsCommandList *commandList, ID3D12Resource *dst, ID3D12Resource *src, const std::vector<RangeCopy> &copies, UINT64 elementSize) {
+    for (const RangeCopy &copy : copies) {
+        commandList->CopyBufferRegion(dst, copy.dstOffset * elementSize, src, copy.srcOffset * elementSize, copy.size * elementSize);
+    }
+}
+
+}
+
+HRESULT GeometryPool::Init(ID3D12Device *device, UINT vertexCapacity, UINT vertexStride, UINT indexCapacity) {
+    this->device = device;
+    this->vertexStride = vertexStride;
+
+    policy.Reset(vertexCapacity, indexCapacity);
+    retired.clear();
+
+    HRESULT hr = CreateBuffers(vertexBuffer, indexBuffer);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    vertexState = D3D12_RESOURCE_STATE_COPY_DEST;
+    indexState = D3D12_RESOURCE_STATE_COPY_DEST;
+    UpdateViews();
+
+    return S_OK;
+}
+
+void GeometryPool::TrackResidency(ResidencyManager *residency) {
+    this->residency = residency;
+    vertexResidency = residency->Track(vertexBuffer.Get());
+    indexResidency = residency->Track(indexBuffer.Get());
+}
+
+void GeometryPool::BeginUpload(ID3D12GraphicsCommandList *commandList) {
+    Transition(commandList, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_COPY_DEST);
+}
+
+void GeometryPool::Upload(ID3D12GraphicsCommandList *commandList, MeshHandle handle, ID3D12Resource *source, UINT64 vertexOffset, UINT64 indexOffset) {
+    const MeshRange &range = policy.GetRange(handle);
+
+    // Empty ranges are allowed and not copied.
+    if (range.vertexCount > 0) {
+        commandList->CopyBufferRegion(
+            vertexBuffer.Get(), UINT64(range.baseVertex) * vertexStride,
+            source, vertexOffset, UINT64(range.vertexCount) * vertexStride);
+    }
+    if (range.indexCount > 0) {
+        commandList->CopyBufferRegion(
+            indexBuffer.Get(), UINT64(range.startIndex) * sizeof(UINT32),
+            source, indexOffset, UINT64(range.indexCount) * sizeof(UINT32));
+    }
+}
+
+void GeometryPool::EndUpload(ID3D12GraphicsCommandList *commandList) {
+    Transition(commandList, VertexReadState, IndexReadState);
+}
+
+HRESULT GeometryPool::Compact(ID3D12GraphicsCommandList *commandList, UINT64 fenceValue) {
+    ComPtr<ID3D12Resource> newVertexBuffer;
+    ComPtr<ID3D12Resource> newIndexBuffer;
+
+    HRESULT hr = CreateBuffers(newVertexBuffer, newIndexBuffer);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    std::vector<RangeCopy> vertexCopies;
+    std::vector<RangeCopy> indexCopies;
+    policy.Compact(vertexCopies, indexCopies);
+
+    Transition(commandList, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    CopyRanges(commandList, newVertexBuffer.Get(), vertexBuffer.Get(), vertexCopies, vertexStride);
+    CopyRanges(commandList, newIndexBuffer.Get(), indexBuffer.Get(), indexCopies, sizeof(UINT32));
+
+    retired.push_back({ vertexBuffer, indexBuffer, vertexResidency, indexResidency, fenceValue });
+
+    // The copies read the old buffers in this submission; Bind() marks the new ones.
+    if (residency) {
+        residency->Use(vertexResidency);
+        residency->Use(indexResidency);
+        vertexResidency = residency->Track(newVertexBuffer.Get());
+        indexResidency = residency->Track(newIndexBuffer.Get());
+    }
+
+    vertexBuffer = newVertexBuffer;
+    indexBuffer = newIndexBuffer;
+    vertexState = D3D12_RESOURCE_STATE_COPY_DEST;
+    indexState = D3D12_RESOURCE_STATE_COPY_DEST;
+    UpdateViews();
+
+    Transition(commandList, VertexReadState, IndexReadState);
+
+    return S_OK;
+}
+
+void GeometryPool::ReleaseRetired(UINT64 completedFenceValue) {
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [=](const Retired &buffers) {
+        if (buffers.fenceValue > completedFenceValue) {
+            return false;
+        }
+        if (residency) {
+            residency->Untrack(buffers.vertexResidency);
+            residency->Untrack(buffers.indexResidency);
+        }
+        return true;
+    }), retired.end());
+}
+
+void GeometryPool::Bind(CommandStateCache &state) const {
+    if (residency) {
+        residency->Use(vertexResidency);
+        residency->Use(indexResidency);
+    }
+    state.IASetVertexBuffers(0, 1, &vbView);
+    state.IASetIndexBuffer(&ibView);
+}
+
+void GeometryPool::Draw(ID3D12GraphicsCommandList *commandList, MeshHandle handle, UINT instanceCount) const {
+    const MeshRange &range = policy.GetRange(handle);
+    commandList->DrawIndexedInstanced(range.indexCount, instanceCount, range.startIndex, INT(range.baseVertex), 0);
+}
+
+HRESULT GeometryPool::CreateBuffers(ComPtr<ID3D12Resource> &newVertexBuffer, ComPtr<ID3D12Resource> &newIndexBuffer) {
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Alignment          = 0;
+    desc.Width              = UINT64(policy.GetVertexAllocator().GetCapacity()) * vertexStride;
+    desc.Height             = 1;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = DXGI_FORMAT_UNKNOWN;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    HRESULT hr = device->CreateCommittedResource(
+        &properties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&newVertexBuffer));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    desc.Width = UINT64(policy.GetIndexAllocator().GetCapacity()) * sizeof(UINT32);
+
+    return device->CreateCommittedResource(
+        &properties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&newIndexBuffer));
+}
+
+void GeometryPool::Transition(ID3D12GraphicsCommandList *commandList, D3D12_RESOURCE_STATES vertexAfter, D3D12_RESOURCE_STATES indexAfter) {
+    D3D12_RESOURCE_BARRIER barriers[2];
+    UINT count = 0;
+
+    auto add = [&](ID3D12Resource *resource, D3D12_RESOURCE_STATES &current, D3D12_RESOURCE_STATES after) {
+        if (current == after) {
+            return;
+        }
+
+        D3D12_RESOURCE_BARRIER &barrier = barriers[count++];
+        barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        barrier.Flags                  = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+        barrier.Transition.pResource   = resource;
+        barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+        barrier.Transition.StateBefore = current;
+        barrier.Transition.StateAfter  = after;
+        current = after;
+    };
+
+    add(vertexBuffer.Get(), vertexState, vertexAfter);
+    add(indexBuffer.Get(), indexState, indexAfter);
+
+    if (count > 0) {
+        commandList->ResourceBarrier(count, barriers);
+    }
+}
+
+void GeometryPool::UpdateViews() {
+    vbView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
+    vbView.SizeInBytes = policy.GetVertexAllocator().GetCapacity() * vertexStride;
+    vbView.StrideInBytes = vertexStride;
+
+    ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
+    ibView.SizeInBytes = policy.GetIndexAllocator().GetCapacity() * sizeof(UINT32);
+    ibView.Format = DXGI_FORMAT_R32_UINT;
+}
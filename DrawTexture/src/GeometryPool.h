@@ -0,0 +1,73 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <vector>
+
+#include "CommandStateCache.h"
+#include "GeometryPoolPolicy.h"
+#include "ResidencyManager.h"
+
+// One large DEFAULT-heap vertex buffer and index buffer shared by all meshes.
+// Meshes are sub-allocated from free lists and drawn with their base vertex
+// and start index, so the buffers are bound once per frame. Indices are
+// 32-bit and relative to the mesh's first vertex.
+class GeometryPool {
+public:
+    static constexpr MeshHandle InvalidHandle = GeometryPoolPolicy::InvalidHandle;
+
+    HRESULT Init(ID3D12Device *device, UINT vertexCapacity, UINT vertexStride, UINT indexCapacity);
+    // Tracks the buffers from now on, including the ones Compact() creates. Bind() marks
+    // them used.
+    void TrackResidency(ResidencyManager *residency);
+
+    bool Allocate(UINT vertexCount, UINT indexCount, MeshHandle &handle) { return policy.Allocate(vertexCount, indexCount, handle); }
+    void Free(MeshHandle handle) { policy.Free(handle); }
+    const MeshRange &GetRange(MeshHandle handle) const { return policy.GetRange(handle); }
+
+    // Uploads are recorded between BeginUpload() and EndUpload().
+    void BeginUpload(ID3D12GraphicsCommandList *commandList);
+    void Upload(ID3D12GraphicsCommandList *commandList, MeshHandle handle, ID3D12Resource *source, UINT64 vertexOffset, UINT64 indexOffset);
+    void EndUpload(ID3D12GraphicsCommandList *commandList);
+
+    // Compaction packs all meshes into fresh buffers. Handles stay valid, the old
+    // buffers are kept alive until fenceValue has completed.
+    bool NeedsCompaction() const { return policy.NeedsCompaction(); }
+    HRESULT Compact(ID3D12GraphicsCommandList *commandList, UINT64 fenceValue);
+    void ReleaseRetired(UINT64 completedFenceValue);
+
+    void Bind(CommandStateCache &state) const;
+    void Draw(ID3D12GraphicsCommandList *commandList, MeshHandle handle, UINT instanceCount = 1) const;
+
+    const RangeAllocator &GetVertexAllocator() const { return policy.GetVertexAllocator(); }
+    const RangeAllocator &GetIndexAllocator() const { return policy.GetIndexAllocator(); }
+
+private:
+    struct Retired {
+        Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
+        Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
+        ResidencyHandle vertexResidency;
+        ResidencyHandle indexResidency;
+        UINT64 fenceValue;
+    };
+
+    HRESULT CreateBuffers(Microsoft::WRL::ComPtr<ID3D12Resource> &newVertexBuffer, Microsoft::WRL::ComPtr<ID3D12Resource> &newIndexBuffer);
+    void Transition(ID3D12GraphicsCommandList *commandList, D3D12_RESOURCE_STATES vertexAfter, D3D12_RESOURCE_STATES indexAfter);
+    void UpdateViews();
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
+    D3D12_RESOURCE_STATES vertexState;
+    D3D12_RESOURCE_STATES indexState;
+    D3D12_VERTEX_BUFFER_VIEW vbView;
+    D3D12_INDEX_BUFFER_VIEW ibView;
+    UINT vertexStride = 0;
+
+    GeometryPoolPolicy policy;
+    std::vector<Retired> retired;
+    ResidencyManager *residency = nullptr;
+    ResidencyHandle vertexResidency = ResidencyPolicy::InvalidHandle;
+    ResidencyHandle indexResidency = ResidencyPolicy::InvalidHandle;
+};
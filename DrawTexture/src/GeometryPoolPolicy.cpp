@@ -0,0 +1,93 @@
+#include "GeometryPoolPolicy.h"
+
+#include <algorithm>
+
+namespace {
+
+// Compact once less than half of the free space is in the largest block.
+constexpr float CompactionThreshold = 0.5f;
+
+}
+
+void GeometryPoolPolicy::Reset(uint32_t vertexCapacity, uint32_t indexCapacity) {
+    vertexAllocator.Reset(vertexCapacity);
+    indexAllocator.Reset(indexCapacity);
+    meshes.clear();
+    freeHandles.clear();
+}
+
+bool GeometryPoolPolicy::Allocate(uint32_t vertexCount, uint32_t indexCount, MeshHandle &handle) {
+    uint32_t baseVertex = vertexAllocator.Allocate(vertexCount);
+    if (baseVertex == RangeAllocator::InvalidOffset) {
+        return false;
+    }
+
+    uint32_t startIndex = indexAllocator.Allocate(indexCount);
+    if (startIndex == RangeAllocator::InvalidOffset) {
+        vertexAllocator.Free(baseVertex, vertexCount);
+        return false;
+    }
+
+    if (freeHandles.empty()) {
+        handle = (MeshHandle) meshes.size();
+        meshes.emplace_back();
+    } else {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+
+    meshes[handle].range = { baseVertex, vertexCount, startIndex, indexCount };
+    meshes[handle].live = true;
+
+    return true;
+}
+
+void GeometryPoolPolicy::Free(MeshHandle handle) {
+    Mesh &mesh = meshes[handle];
+    if (!mesh.live) {
+        return;
+    }
+
+    vertexAllocator.Free(mesh.range.baseVertex, mesh.range.vertexCount);
+    indexAllocator.Free(mesh.range.startIndex, mesh.range.indexCount);
+    mesh.live = false;
+    freeHandles.push_back(handle);
+}
+
+bool GeometryPoolPolicy::NeedsCompaction() const {
+    return vertexAllocator.GetFragmentation() > CompactionThreshold || indexAllocator.GetFragmentation() > CompactionThreshold;
+}
+
+void GeometryPoolPolicy::Compact(std::vector<RangeCopy> &vertexCopies, std::vector<RangeCopy> &indexCopies) {
+    std::vector<MeshHandle> order;
+    for (MeshHandle handle = 0; handle < (MeshHandle) meshes.size(); handle++) {
+        if (meshes[handle].live) {
+            order.push_back(handle);
+        }
+    }
+
+    // Vertices and indices are packed separately, each in the order of its own offsets.
+    auto pack = [&](uint32_t MeshRange::*offset, uint32_t MeshRange::*count, std::vector<RangeCopy> &copies) {
+        std::sort(order.begin(), order.end(), [&](MeshHandle a, MeshHandle b) {
+            return meshes[a].range.*offset < meshes[b].range.*offset;
+        });
+        std::vector<AllocatedRange> ranges(order.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            ranges[i] = { meshes[order[i]].range.*offset, meshes[order[i]].range.*count };
+        }
+        PackRanges(ranges, copies);
+        for (size_t i = 0; i < order.size(); i++) {
+            meshes[order[i]].range.*offset = ranges[i].offset;
+        }
+    };
+    pack(&MeshRange::baseVertex, &MeshRange::vertexCount, vertexCopies);
+    pack(&MeshRange::startIndex, &MeshRange::indexCount, indexCopies);
+
+    // Everything is packed at the front now.
+    uint32_t usedVertices = vertexAllocator.GetCapacity() - vertexAllocator.GetFreeSize();
+    uint32_t usedIndices = indexAllocator.GetCapacity() - indexAllocator.GetFreeSize();
+    vertexAllocator.Reset(vertexAllocator.GetCapacity());
+    indexAllocator.Reset(indexAllocator.GetCapacity());
+    vertexAllocator.Allocate(usedVertices);
+    indexAllocator.Allocate(usedIndices);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RangeAllocator.h"
+
+// Location of a mesh inside the shared buffers of a GeometryPool.
+struct MeshRange {
+    uint32_t baseVertex;
+    uint32_t vertexCount;
+    uint32_t startIndex;
+    uint32_t indexCount;
+};
+
+using MeshHandle = uint32_t;
+
+// Bookkeeping for GeometryPool: the vertex and index ranges of every mesh, and the plan
+// that packs them when the free space has split up. Handles stay valid across Compact();
+// only their ranges move. No D3D12 types are involved, so compaction can be tested
+// without buffers.
+class GeometryPoolPolicy {
+public:
+    static constexpr MeshHandle InvalidHandle = UINT32_MAX;
+
+    void Reset(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+    bool Allocate(uint32_t vertexCount, uint32_t indexCount, MeshHandle &handle);
+    void Free(MeshHandle handle);
+    const MeshRange &GetRange(MeshHandle handle) const { return meshes[handle].range; }
+
+    // True once less than half of the free vertex or index space is in its largest block.
+    bool NeedsCompaction() const;
+    // Packs the live meshes to the front of both buffers in their current order, rewrites
+    // their ranges and the allocators, and returns the copies, in elements, from the old
+    // buffers to new ones.
+    void Compact(std::vector<RangeCopy> &vertexCopies, std::vector<RangeCopy> &indexCopies);
+
+    const RangeAllocator &GetVertexAllocator() const { return vertexAllocator; }
+    const RangeAllocator &GetIndexAllocator() const { return indexAllocator; }
+
+private:
+    struct Mesh {
+        MeshRange range;
+        bool live;
+    };
+
+    RangeAllocator vertexAllocator;
+    RangeAllocator indexAllocator;
+    std::vector<Mesh> meshes;
+    std::vector<MeshHandle> freeHandles;
+};
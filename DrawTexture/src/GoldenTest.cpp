@@ -0,0 +1,232 @@
+#include "GoldenTest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ImageDecoder.h"
+#include "Log.h"
+
+namespace {
+
+FILE *OpenFile(const char *path, const char *mode) {
+    FILE *file;
+#ifdef _WIN32
+    if (fopen_s(&file, path, mode) != 0) {
+        return nullptr;
+    }
+#else
+    file = fopen(path, mode);
+#endif
+    return file;
+}
+
+bool ParseNumber(const std::string &text, double &value) {
+    char *end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+bool ParseCount(const std::string &text, uint32_t &value) {
+    double number;
+    if (!ParseNumber(text, number) || number < 0.0 || number > 4294967295.0 || number != std::floor(number)) {
+        return false;
+    }
+    value = uint32_t(number);
+    return true;
+}
+
+bool ParseOption(const std::string &key, const std::string &value, GoldenTest &test) {
+    if (key == "sampling") {
+        test.pointSampling = value == "point";
+        return value == "point" || value == "linear";
+    }
+    if (key == "warmup") {
+        return ParseCount(value, test.warmupFrames);
+    }
+    if (key == "frames") {
+        return ParseCount(value, test.measuredFrames) && test.measuredFrames > 0;
+    }
+    if (key == "psnr") {
+        return ParseNumber(value, test.minPsnr);
+    }
+    if (key == "ssim") {
+        return ParseNumber(value, test.minSsim);
+    }
+    if (key == "tolerance") {
+        return ParseCount(value, test.tolerance);
+    }
+    if (key == "exceed") {
+        return ParseNumber(value, test.maxExceedFraction);
+    }
+    if (key == "frameMs") {
+        return ParseNumber(value, test.maxFrameTime);
+    }
+    return false;
+}
+
+// Splits a line at spaces and tabs, up to a '#'.
+std::vector<std::string> SplitLine(const char *line) {
+    std::vector<std::string> words;
+    const char *p = line;
+    while (*p && *p != '#') {
+        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+            continue;
+        }
+        const char *begin = p;
+        while (*p && *p != '#' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+        words.emplace_back(begin, p);
+    }
+    return words;
+}
+
+bool LoadImage(const char *path, std::vector<uint8_t> &pixels, ImageView &view) {
+    ImageDecoder decoder;
+    if (!decoder.Open(path)) {
+        return false;
+    }
+    const ImageInfo &info = decoder.GetInfo();
+    pixels.resize(size_t(info.width) * info.height * 4);
+    if (!decoder.Decode(pixels.data(), size_t(info.width) * 4)) {
+        return false;
+    }
+    view = { pixels.data(), info.width, info.height, size_t(info.width) * 4, ChannelOrder::Rgba };
+    return true;
+}
+
+bool IsFile(const char *path) {
+    FILE *file = OpenFile(path, "rb");
+    if (file) {
+        fclose(file);
+    }
+    return file != nullptr;
+}
+
+}
+
+bool LoadGoldenTests(const char *path, std::vector<GoldenTest> &tests) {
+    FILE *file = OpenFile(path, "rb");
+    if (!file) {
+        LogError("Golden tests: cannot open %s", path);
+        return false;
+    }
+
+    bool succeeded = true;
+    char line[1024];
+    for (int lineNumber = 1; fgets(line, sizeof(line), file); lineNumber++) {
+        std::vector<std::string> words = SplitLine(line);
+        if (words.empty()) {
+            continue;
+        }
+        if (words.size() < 2) {
+            LogError("Golden tests: %s(%d): expected a name and a golden image", path, lineNumber);
+            succeeded = false;
+            continue;
+        }
+
+        GoldenTest test;
+        test.name = words[0];
+        test.goldenPath = words[1];
+        for (size_t i = 2; i < words.size(); i++) {
+            size_t equals = words[i].find('=');
+            if (equals == std::string::npos || !ParseOption(words[i].substr(0, equals), words[i].substr(equals + 1), test)) {
+                LogError("Golden tests: %s(%d): invalid option %s", path, lineNumber, words[i].c_str());
+                succeeded = false;
+            }
+        }
+        tests.push_back(test);
+    }
+
+    fclose(file);
+    return succeeded;
+}
+
+GoldenResult CheckGolden(const GoldenTest &test, const char *actualPath, const char *outputDir,
+                         double cpuFrameTime, double gpuFrameTime, bool createMissing) {
+    GoldenResult result = { GoldenStatus::Error, { }, cpuFrameTime, gpuFrameTime };
+
+    std::vector<uint8_t> actualPixels;
+    ImageView actual;
+    if (!LoadImage(actualPath, actualPixels, actual)) {
+        LogError("Golden %s: cannot read the rendered image %s", test.name.c_str(), actualPath);
+        return result;
+    }
+
+    // A new test records its golden image when asked to; it still fails until the image is
+    // reviewed and committed.
+    if (!IsFile(test.goldenPath.c_str())) {
+        if (!createMissing) {
+            LogError("Golden %s: no golden image %s", test.name.c_str(), test.goldenPath.c_str());
+            result.status = GoldenStatus::Missing;
+            return result;
+        }
+        if (!SaveImage(test.goldenPath.c_str(), actual, ImageFileFormat::Png)) {
+            LogError("Golden %s: cannot write %s", test.name.c_str(), test.goldenPath.c_str());
+            return result;
+        }
+        LogWarning("Golden %s: no golden image, saved the rendered image as %s", test.name.c_str(), test.goldenPath.c_str());
+        result.status = GoldenStatus::Created;
+        return result;
+    }
+
+    std::vector<uint8_t> goldenPixels;
+    ImageView golden;
+    if (!LoadImage(test.goldenPath.c_str(), goldenPixels, golden)) {
+        LogError("Golden %s: cannot read %s", test.name.c_str(), test.goldenPath.c_str());
+        return result;
+    }
+
+    std::vector<uint8_t> diff;
+    if (!CompareImages(actual, golden, test.tolerance, result.comparison, &diff)) {
+        LogError("Golden %s: rendered %ux%u, golden %ux%u", test.name.c_str(), actual.width, actual.height, golden.width, golden.height);
+        return result;
+    }
+
+    std::string diffPath = std::string(outputDir) + "/" + test.name + "_diff.png";
+    ImageView diffView = { diff.data(), actual.width, actual.height, size_t(actual.width) * 4, ChannelOrder::Rgba };
+    if (!SaveImage(diffPath.c_str(), diffView, ImageFileFormat::Png)) {
+        LogWarning("Golden %s: cannot write %s", test.name.c_str(), diffPath.c_str());
+    }
+
+    const ImageComparison &comparison = result.comparison;
+    bool passed = comparison.psnr >= test.minPsnr && comparison.ssim >= test.minSsim &&
+                  comparison.exceedFraction <= test.maxExceedFraction &&
+                  (test.maxFrameTime <= 0.0 || cpuFrameTime <= test.maxFrameTime);
+    result.status = passed ? GoldenStatus::Passed : GoldenStatus::Failed;
+    return result;
+}
+
+const char *GetGoldenStatusName(GoldenStatus status) {
+    switch (status) {
+    case GoldenStatus::Passed:
+        return "passed";
+    case GoldenStatus::Failed:
+        return "FAILED";
+    case GoldenStatus::Missing:
+        return "MISSING";
+    case GoldenStatus::Created:
+        return "created";
+    default:
+        return "ERROR";
+    }
+}
+
+bool WriteGoldenReport(const char *path, const std::vector<GoldenTest> &tests, const std::vector<GoldenResult> &results) {
+    FILE *file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "# name status psnr ssim maxDiff exceed cpuMs gpuMs\n");
+    for (size_t i = 0; i < tests.size() && i < results.size(); i++) {
+        const ImageComparison &comparison = results[i].comparison;
+        fprintf(file, "%s %s %.2f %.5f %u %.6f %.3f %.3f\n", tests[i].name.c_str(), GetGoldenStatusName(results[i].status),
+                comparison.psnr, comparison.ssim, comparison.maxDifference, comparison.exceedFraction,
+                results[i].cpuFrameTime, results[i].gpuFrameTime);
+    }
+    return fclose(file) == 0;
+}
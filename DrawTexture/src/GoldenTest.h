@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ImageCompare.h"
+
+// A rendered image checked against a stored golden image. Read from a config file with one
+// test per line:
+//
+//     name golden/path.png [key=value ...]
+//
+// Keys: sampling=linear|point, warmup=frames, frames=measured frames, psnr=min dB,
+// ssim=min SSIM, tolerance=max channel difference, exceed=max fraction of pixels over the
+// tolerance, frameMs=max mean CPU frame time (0 for none). '#' starts a comment.
+struct GoldenTest {
+    std::string name;
+    std::string goldenPath;
+    bool pointSampling = false;
+    uint32_t warmupFrames = 8;
+    uint32_t measuredFrames = 60;
+    double minPsnr = 40.0;
+    double minSsim = 0.98;
+    uint32_t tolerance = 2;
+    double maxExceedFraction = 0.001;
+    double maxFrameTime = 0.0;
+};
+
+// Paths in the file are relative to the working directory. False if the file cannot be
+// read or a line is malformed; the error is logged with its line number.
+bool LoadGoldenTests(const char *path, std::vector<GoldenTest> &tests);
+
+enum class GoldenStatus {
+    Passed,
+    Failed,   // A metric is over its threshold.
+    Missing,  // There is no golden image.
+    Created,  // There was no golden image; the rendered image was saved as the golden.
+    Error,    // An image could not be read, or the sizes differ.
+};
+
+struct GoldenResult {
+    GoldenStatus status;
+    ImageComparison comparison;
+    double cpuFrameTime;  // Mean milliseconds of the measured frames.
+    double gpuFrameTime;
+};
+
+// Compares the rendered image at actualPath with the golden image of test and writes the
+// amplified difference to <outputDir>/<name>_diff.png. Only the comparison of files, so it
+// also runs on images rendered elsewhere. A missing golden image is saved from the rendered
+// one only with createMissing; either way the test does not pass.
+GoldenResult CheckGolden(const GoldenTest &test, const char *actualPath, const char *outputDir,
+                         double cpuFrameTime, double gpuFrameTime, bool createMissing = false);
+
+const char *GetGoldenStatusName(GoldenStatus status);
+
+// Writes one line per test with its status, metrics and frame times.
+bool WriteGoldenReport(const char *path, const std::vector<GoldenTest> &tests, const std::vector<GoldenResult> &results);
@@ -1,7 +1,29 @@
+// Shader variant axes, defined to 0 or 1 by ShaderPermutations.
+#ifndef SAMPLING_POINT
+#define SAMPLING_POINT 0
+#endif
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 0
+#endif
+
 struct PSInput {
     float4 position : SV_POSITION;
     float2 uv : TEXCOORD;
+    nointerpolation uint textureIndex : TEXTURE_INDEX;
+};
+
+struct ObjectConstants {
+    float4x4 world;
+    uint textureIndex;
 };
 
-Texture2D<float4> g_texture : register(t0);
+cbuffer DrawConstants : register(b0) {
+    uint g_objectId;
+};
+
+StructuredBuffer<ObjectConstants> g_objects : register(t1);
+
+// Every view of the bindless heap, indexed by ObjectConstants.textureIndex.
+Texture2D<float4> g_textures[] : register(t0, space1);
 SamplerState g_sampler : register(s0);
+SamplerState g_pointSampler : register(s1);
@@ -0,0 +1,136 @@
+#include "ImageCompare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "BatchMath.h"
+#include "ImageCompareKernels.h"
+#include "Parallel.h"
+
+const CompareKernels ScalarCompareKernels = {
+    CompareRowScalar,
+};
+
+namespace {
+
+constexpr uint32_t BlockSize = 8;
+
+const CompareKernels &GetCompareKernels() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    if (GetSimdLevel() >= SimdLevel::Avx2) {
+        return Avx2CompareKernels;
+    }
+#endif
+    return ScalarCompareKernels;
+}
+
+// Copies a row to RGBA order if needed and returns it.
+const uint8_t *GetRgbaRow(const ImageView &image, uint32_t y, uint8_t *scratch) {
+    const uint8_t *row = image.pixels + image.rowPitch * y;
+    if (image.order == ChannelOrder::Rgba) {
+        return row;
+    }
+    for (uint32_t x = 0; x < image.width; x++) {
+        scratch[x * 4 + 0] = row[x * 4 + 2];
+        scratch[x * 4 + 1] = row[x * 4 + 1];
+        scratch[x * 4 + 2] = row[x * 4 + 0];
+        scratch[x * 4 + 3] = row[x * 4 + 3];
+    }
+    return scratch;
+}
+
+// SSIM of one window from its luma sums over count pixels.
+double GetSsim(double x, double y, double xx, double yy, double xy, double count) {
+    const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+    const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+    double meanX = x / count;
+    double meanY = y / count;
+    double varianceX = xx / count - meanX * meanX;
+    double varianceY = yy / count - meanY * meanY;
+    double covariance = xy / count - meanX * meanY;
+    return ((2.0 * meanX * meanY + c1) * (2.0 * covariance + c2)) /
+           ((meanX * meanX + meanY * meanY + c1) * (varianceX + varianceY + c2));
+}
+
+struct BandResult {
+    RowDifference difference;
+    double ssimSum;
+    uint32_t blockCount;
+};
+
+}
+
+bool CompareImages(const ImageView &actual, const ImageView &expected, uint32_t tolerance,
+                   ImageComparison &result, std::vector<uint8_t> *diff) {
+    if (actual.width != expected.width || actual.height != expected.height) {
+        return false;
+    }
+
+    const CompareKernels &kernels = GetCompareKernels();
+    uint32_t width = actual.width;
+    uint32_t height = actual.height;
+    size_t rowSize = size_t(width) * 4;
+    if (diff) {
+        diff->resize(rowSize * height);
+    }
+
+    // Bands of BlockSize rows, so the SSIM blocks of a band are complete within it.
+    uint32_t bandCount = (height + BlockSize - 1) / BlockSize;
+    std::vector<BandResult> bands(bandCount);
+    ParallelFor(bandCount, 4, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> sums(size_t(width) * 5);
+        ColumnSums columns = { sums.data(), sums.data() + width, sums.data() + width * 2, sums.data() + width * 3, sums.data() + width * 4 };
+        std::vector<uint8_t> scratch(rowSize * 3);
+
+        for (size_t band = begin; band < end; band++) {
+            BandResult &bandResult = bands[band];
+            bandResult = { { 0, 0, 0 }, 0.0, 0 };
+            std::fill(sums.begin(), sums.end(), 0u);
+
+            uint32_t y0 = uint32_t(band) * BlockSize;
+            uint32_t y1 = (std::min)(y0 + BlockSize, height);
+            for (uint32_t y = y0; y < y1; y++) {
+                const uint8_t *a = GetRgbaRow(actual, y, scratch.data());
+                const uint8_t *b = GetRgbaRow(expected, y, scratch.data() + rowSize);
+                uint8_t *diffRow = diff ? diff->data() + rowSize * y : scratch.data() + rowSize * 2;
+                kernels.compareRow(a, b, width, tolerance, diffRow, columns, bandResult.difference);
+            }
+
+            // Edge blocks are smaller; each block counts once in the mean.
+            for (uint32_t x0 = 0; x0 < width; x0 += BlockSize) {
+                uint32_t x1 = (std::min)(x0 + BlockSize, width);
+                double sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+                for (uint32_t x = x0; x < x1; x++) {
+                    sx += columns.x[x];
+                    sy += columns.y[x];
+                    sxx += columns.xx[x];
+                    syy += columns.yy[x];
+                    sxy += columns.xy[x];
+                }
+                bandResult.ssimSum += GetSsim(sx, sy, sxx, syy, sxy, double((x1 - x0) * (y1 - y0)));
+                bandResult.blockCount++;
+            }
+        }
+    });
+
+    RowDifference total = { 0, 0, 0 };
+    double ssimSum = 0.0;
+    uint64_t blockCount = 0;
+    for (const BandResult &band : bands) {
+        total.squaredError += band.difference.squaredError;
+        total.maxDifference = (std::max)(total.maxDifference, band.difference.maxDifference);
+        total.exceedCount += band.difference.exceedCount;
+        ssimSum += band.ssimSum;
+        blockCount += band.blockCount;
+    }
+
+    uint64_t pixelCount = uint64_t(width) * height;
+    double meanSquaredError = pixelCount ? double(total.squaredError) / double(pixelCount * 3) : 0.0;
+    result.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+    result.ssim = blockCount ? ssimSum / double(blockCount) : 1.0;
+    result.maxDifference = total.maxDifference;
+    result.exceedCount = total.exceedCount;
+    result.exceedFraction = pixelCount ? double(total.exceedCount) / double(pixelCount) : 0.0;
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ImageEncoder.h"
+
+// Result of comparing a rendered image with its expected image. Color metrics cover RGB;
+// alpha is ignored.
+struct ImageComparison {
+    double psnr;              // dB; infinity when the images are identical.
+    double ssim;              // Mean SSIM of the luma of 8x8 blocks, 1 when identical.
+    uint32_t maxDifference;   // Largest difference of a channel.
+    uint64_t exceedCount;     // Pixels with a channel differing by more than the tolerance.
+    double exceedFraction;    // exceedCount / pixel count.
+};
+
+// Compares two images of the same size in parallel bands, with AVX2 row kernels when the
+// CPU supports them. diff, if given, receives tightly packed RGBA rows of the absolute
+// differences amplified 8 times. False if the sizes differ.
+bool CompareImages(const ImageView &actual, const ImageView &expected, uint32_t tolerance,
+                   ImageComparison &result, std::vector<uint8_t> *diff = nullptr);
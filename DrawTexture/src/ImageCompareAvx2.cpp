@@ -0,0 +1,111 @@
+// Compiled with AVX2 enabled (see DrawTexture.vcxproj). Only reached after CPUID reports AVX2.
+#include "ImageCompareKernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+inline uint32_t CountBits8(uint32_t mask) {
+    mask = mask - ((mask >> 1) & 0x55);
+    mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+    return (mask + (mask >> 4)) & 0x0F;
+}
+
+inline __m256i LoadColumn(const uint32_t *column) {
+    return _mm256_loadu_si256((const __m256i *) column);
+}
+
+inline void AddColumn(uint32_t *column, __m256i value) {
+    _mm256_storeu_si256((__m256i *) column, _mm256_add_epi32(LoadColumn(column), value));
+}
+
+// Luma of 8 RGBA pixels as 32-bit lanes, like GetLuma().
+inline __m256i GetLuma8(__m256i pixels) {
+    // madd_epi16 on (R, G) and (B, 0) pairs with weights (77, 150) and (29, 0).
+    const __m256i low = _mm256_set1_epi32(0x00FF00FF);
+    __m256i redBlue = _mm256_and_si256(pixels, low);                       // R, B as 16-bit lanes
+    __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), low);   // G, A
+    __m256i luma = _mm256_add_epi32(
+        _mm256_madd_epi16(redBlue, _mm256_set1_epi32((29 << 16) | 77)),
+        _mm256_madd_epi16(green, _mm256_set1_epi32(150)));
+    return _mm256_srli_epi32(_mm256_add_epi32(luma, _mm256_set1_epi32(128)), 8);
+}
+
+void CompareRowAvx2(const uint8_t *a, const uint8_t *b, size_t count, uint32_t tolerance,
+                    uint8_t *diff, const ColumnSums &columns, RowDifference &result) {
+    const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i limit = _mm256_set1_epi32((int) tolerance);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i squared = zero;     // 32-bit partial sums, flushed before they can overflow.
+    __m256i maxDifference = zero;
+    uint64_t squaredError = 0;
+    uint32_t exceedCount = 0;
+    uint32_t pending = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pa = _mm256_loadu_si256((const __m256i *) (a + i * 4));
+        __m256i pb = _mm256_loadu_si256((const __m256i *) (b + i * 4));
+        __m256i d = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(pa, pb), _mm256_subs_epu8(pb, pa)), colorMask);
+
+        // Largest channel of each pixel.
+        __m256i m = _mm256_max_epu8(d, _mm256_srli_epi32(d, 8));
+        m = _mm256_and_si256(_mm256_max_epu8(m, _mm256_srli_epi32(d, 16)), byteMask);
+        maxDifference = _mm256_max_epu32(maxDifference, m);
+        exceedCount += CountBits8((uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(m, limit))));
+
+        // Each lane adds at most 2 * 255^2 per unpack, so 4096 iterations stay below 2^32.
+        __m256i dLow = _mm256_unpacklo_epi8(d, zero);
+        __m256i dHigh = _mm256_unpackhi_epi8(d, zero);
+        squared = _mm256_add_epi32(squared, _mm256_add_epi32(_mm256_madd_epi16(dLow, dLow), _mm256_madd_epi16(dHigh, dHigh)));
+        if (++pending == 4096) {
+            __m256i wide = _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(squared)),
+                                            _mm256_cvtepu32_epi64(_mm256_extracti128_si256(squared, 1)));
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256((__m256i *) lanes, wide);
+            squaredError += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            squared = zero;
+            pending = 0;
+        }
+
+        // DiffScale = 8: three saturating doublings.
+        __m256i amplified = _mm256_adds_epu8(d, d);
+        amplified = _mm256_adds_epu8(amplified, amplified);
+        amplified = _mm256_adds_epu8(amplified, amplified);
+        _mm256_storeu_si256((__m256i *) (diff + i * 4), _mm256_or_si256(amplified, alpha));
+
+        __m256i x = GetLuma8(pa);
+        __m256i y = GetLuma8(pb);
+        AddColumn(columns.x + i, x);
+        AddColumn(columns.y + i, y);
+        AddColumn(columns.xx + i, _mm256_mullo_epi32(x, x));
+        AddColumn(columns.yy + i, _mm256_mullo_epi32(y, y));
+        AddColumn(columns.xy + i, _mm256_mullo_epi32(x, y));
+    }
+
+    __m256i wide = _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(squared)),
+                                    _mm256_cvtepu32_epi64(_mm256_extracti128_si256(squared, 1)));
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256((__m256i *) lanes, wide);
+    squaredError += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    alignas(32) uint32_t maxLanes[8];
+    _mm256_store_si256((__m256i *) maxLanes, maxDifference);
+    for (uint32_t lane : maxLanes) {
+        result.maxDifference = lane > result.maxDifference ? lane : result.maxDifference;
+    }
+    result.squaredError += squaredError;
+    result.exceedCount += exceedCount;
+
+    ColumnSums tail = { columns.x + i, columns.y + i, columns.xx + i, columns.yy + i, columns.xy + i };
+    CompareRowScalar(a + i * 4, b + i * 4, count - i, tolerance, diff + i * 4, tail, result);
+}
+
+}
+
+const CompareKernels Avx2CompareKernels = {
+    CompareRowAvx2,
+};
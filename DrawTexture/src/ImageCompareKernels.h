@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-row sums of a comparison. Color differences cover RGB; alpha is ignored.
+struct RowDifference {
+    uint64_t squaredError;
+    uint32_t maxDifference;  // Largest channel difference.
+    uint32_t exceedCount;    // Pixels with a channel differing by more than the tolerance.
+};
+
+// Per-column luma sums of the rows of one block row, for SSIM. Arrays of width elements.
+struct ColumnSums {
+    uint32_t *x;
+    uint32_t *y;
+    uint32_t *xx;
+    uint32_t *yy;
+    uint32_t *xy;
+};
+
+// Row kernel for image comparison. a and b are RGBA8 rows of count pixels. diff receives
+// |a - b| per channel, amplified by DiffScale and saturated, with opaque alpha. The luma
+// of both rows is added to columns.
+struct CompareKernels {
+    void (*compareRow)(const uint8_t *a, const uint8_t *b, size_t count, uint32_t tolerance,
+                       uint8_t *diff, const ColumnSums &columns, RowDifference &result);
+};
+
+extern const CompareKernels ScalarCompareKernels;
+extern const CompareKernels Avx2CompareKernels;
+
+// Shared scalar code. The SIMD kernel uses it for row tails and must produce identical results.
+namespace {
+
+constexpr uint32_t DiffScale = 8;
+
+// BT.601 luma in 8.8 fixed point, rounded.
+inline uint32_t GetLuma(const uint8_t *pixel) {
+    return (77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8;
+}
+
+inline void CompareRowScalar(const uint8_t *a, const uint8_t *b, size_t count, uint32_t tolerance,
+                             uint8_t *diff, const ColumnSums &columns, RowDifference &result) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *pa = a + i * 4;
+        const uint8_t *pb = b + i * 4;
+        uint32_t maxDifference = 0;
+        for (int c = 0; c < 3; c++) {
+            uint32_t d = pa[c] > pb[c] ? pa[c] - pb[c] : pb[c] - pa[c];
+            result.squaredError += d * d;
+            maxDifference = d > maxDifference ? d : maxDifference;
+            uint32_t amplified = d * DiffScale;
+            diff[i * 4 + c] = uint8_t(amplified > 255 ? 255 : amplified);
+        }
+        diff[i * 4 + 3] = 255;
+        result.maxDifference = maxDifference > result.maxDifference ? maxDifference : result.maxDifference;
+        result.exceedCount += maxDifference > tolerance ? 1 : 0;
+
+        uint32_t x = GetLuma(pa);
+        uint32_t y = GetLuma(pb);
+        columns.x[i] += x;
+        columns.y[i] += y;
+        columns.xx[i] += x * x;
+        columns.yy[i] += y * y;
+        columns.xy[i] += x * y;
+    }
+}
+
+}
@@ -0,0 +1,89 @@
+#include "ImageDecoder.h"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "JpegDecoder.h"
+#include "Parallel.h"
+#include "PngDecoder.h"
+
+bool ImageDecoder::Open(const char *path) {
+    if (!file.Open(path)) {
+        return false;
+    }
+    return OpenMemory(file.GetData(), file.GetSize());
+}
+
+bool ImageDecoder::OpenMemory(const void *data, size_t size) {
+    this->data = (const uint8_t *) data;
+    this->size = size;
+    info = { };
+
+    if (size >= 2 && this->data[0] == 0xFF && this->data[1] == 0xD8) {
+        return ReadJpegInfo(this->data, size, info);
+    }
+    if (size >= 8 && memcmp(this->data, "\x89PNG", 4) == 0) {
+        return ReadPngInfo(this->data, size, info);
+    }
+    return false;
+}
+
+PixelFormat GetNativePixelFormat(const ImageInfo &info) {
+    switch (info.channels) {
+    case 1:
+        return PixelFormat::L8;
+    case 2:
+        return PixelFormat::L8A8;
+    default:
+        return PixelFormat::R8G8B8A8;
+    }
+}
+
+bool ImageDecoder::Decode(void *pixels, size_t rowPitch, PixelFormat format, uint32_t conversion) const {
+    if (GetPixelSize(format) == 0 || rowPitch < size_t(info.width) * GetPixelSize(format)) {
+        return false;
+    }
+
+    // The decoders produce RGBA8; anything else is converted from a temporary image.
+    std::vector<uint8_t> rgba;
+    uint8_t *target = (uint8_t *) pixels;
+    size_t targetPitch = rowPitch;
+    bool convert = format != PixelFormat::R8G8B8A8 || conversion != PixelConversionNone;
+    if (convert) {
+        targetPitch = size_t(info.width) * 4;
+        rgba.resize(targetPitch * info.height);
+        target = rgba.data();
+    }
+
+    bool decoded;
+    switch (info.format) {
+    case ImageFormat::Jpeg:
+        decoded = DecodeJpeg(data, size, target, targetPitch);
+        break;
+    case ImageFormat::Png:
+        decoded = DecodePng(data, size, target, targetPitch);
+        break;
+    default:
+        return false;
+    }
+
+    if (!decoded || !convert) {
+        return decoded;
+    }
+    return ConvertPixels(target, targetPitch, PixelFormat::R8G8B8A8, pixels, rowPitch, format, info.width, info.height, conversion);
+}
+
+bool DecodeImages(const ImageDecoder *const *decoders, void *const *pixels, const size_t *rowPitches, size_t count) {
+    // Each image still parallelizes internally; running images side by side covers the
+    // serial parts (entropy decoding without restart markers, inflate and PNG unfiltering).
+    std::atomic<bool> failed(false);
+    ParallelFor(count, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!decoders[i]->Decode(pixels[i], rowPitches[i])) {
+                failed = true;
+            }
+        }
+    });
+    return !failed;
+}
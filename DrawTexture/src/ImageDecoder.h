@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "PixelFormat.h"
+
+enum class ImageFormat {
+    Unknown,
+    Jpeg,
+    Png,
+};
+
+struct ImageInfo {
+    ImageFormat format;
+    uint32_t width;
+    uint32_t height;
+    bool progressive; // Progressive JPEG or Adam7 interlaced PNG.
+    uint32_t channels; // 1 gray, 2 gray + alpha, 3 RGB, 4 RGBA (including tRNS transparency).
+};
+
+// Smallest format that holds the decoded image without loss: L8, L8A8 or R8G8B8A8.
+// Never sRGB or 16-bit: Decode() cuts 16-bit PNG samples to 8 bits, and the sample
+// renders without sRGB conversion, so textures are sampled as UNORM.
+PixelFormat GetNativePixelFormat(const ImageInfo &info);
+
+// Built-in decoder for JPEG (Huffman coded, 8-bit, baseline and progressive)
+// and PNG (all color types, 1-16 bit, Adam7). Output is always R8G8B8A8.
+// Open() only reads the header, so the caller can size the destination first;
+// Decode() then writes rows straight into caller memory such as a mapped upload
+// buffer at the texture's footprint offset and row pitch. JPEG restart
+// intervals, IDCT and color conversion run in parallel. Other destination
+// formats are converted from RGBA8 with ConvertPixels().
+class ImageDecoder {
+public:
+    bool Open(const char *path);
+
+    // The memory must stay valid while the decoder is used.
+    bool OpenMemory(const void *data, size_t size);
+
+    const ImageInfo &GetInfo() const { return info; }
+    // The encoded image.
+    const void *GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+    // rowPitch must be at least width * GetPixelSize(format) bytes.
+    bool Decode(void *pixels, size_t rowPitch, PixelFormat format = PixelFormat::R8G8B8A8, uint32_t conversion = PixelConversionNone) const;
+
+private:
+    MappedFile file;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    ImageInfo info = { };
+};
+
+// Decodes several opened images in parallel.
+bool DecodeImages(const ImageDecoder *const *decoders, void *const *pixels, const size_t *rowPitches, size_t count);
@@ -0,0 +1,516 @@
+#include "ImageEncoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Checksums
+
+uint32_t GetCrc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+    static const struct Table {
+        uint32_t values[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                values[i] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t GetAdler32(const uint8_t *data, size_t size) {
+    // 5552 bytes is the most that can be summed before the 32-bit sums may overflow.
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        size_t block = (std::min)(size, size_t(5552));
+        for (size_t i = 0; i < block; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+// Deflate
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t> &out) : out(out) { }
+
+    void Write(uint32_t bits, uint32_t count) {
+        buffer |= uint64_t(bits) << bitCount;
+        bitCount += count;
+        while (bitCount >= 8) {
+            out.push_back(uint8_t(buffer));
+            buffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    void Flush() {
+        if (bitCount > 0) {
+            out.push_back(uint8_t(buffer));
+        }
+        buffer = 0;
+        bitCount = 0;
+    }
+
+private:
+    std::vector<uint8_t> &out;
+    uint64_t buffer = 0;
+    uint32_t bitCount = 0;
+};
+
+uint32_t ReverseBits(uint32_t bits, uint32_t count) {
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        reversed = (reversed << 1) | ((bits >> i) & 1);
+    }
+    return reversed;
+}
+
+const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+const uint8_t LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+const uint16_t DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+const uint8_t DistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+// The fixed Huffman codes of RFC 1951 3.2.6, bit-reversed for LSB-first output.
+struct FixedCodes {
+    uint16_t literal[288];
+    uint8_t literalLength[288];
+    uint8_t distance[30];
+    uint8_t lengthSymbol[259];  // Match length -> index into LengthBase.
+
+    FixedCodes() {
+        for (uint32_t symbol = 0; symbol < 288; symbol++) {
+            uint32_t code, length;
+            if (symbol < 144) {
+                code = 0x30 + symbol;
+                length = 8;
+            } else if (symbol < 256) {
+                code = 0x190 + symbol - 144;
+                length = 9;
+            } else if (symbol < 280) {
+                code = symbol - 256;
+                length = 7;
+            } else {
+                code = 0xC0 + symbol - 280;
+                length = 8;
+            }
+            literal[symbol] = uint16_t(ReverseBits(code, length));
+            literalLength[symbol] = uint8_t(length);
+        }
+        for (uint32_t symbol = 0; symbol < 30; symbol++) {
+            distance[symbol] = uint8_t(ReverseBits(symbol, 5));
+        }
+        for (uint32_t length = 3, index = 0; length <= 258; length++) {
+            while (index + 1 < 29 && LengthBase[index + 1] <= length) {
+                index++;
+            }
+            lengthSymbol[length] = uint8_t(index);
+        }
+    }
+};
+
+const FixedCodes &GetFixedCodes() {
+    static const FixedCodes codes;
+    return codes;
+}
+
+constexpr uint32_t WindowSize = 32768;
+constexpr uint32_t MinMatch = 3;
+constexpr uint32_t MaxMatch = 258;
+constexpr uint32_t HashBits = 15;
+constexpr uint32_t MaxChain = 8;  // Candidates tried per position; more compresses better but slower.
+
+uint32_t Hash(const uint8_t *data) {
+    uint32_t value = uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16);
+    return (value * 2654435761u) >> (32 - HashBits);
+}
+
+// Stored blocks, for data that the fixed codes would expand, such as noise.
+void DeflateStored(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+    do {
+        size_t block = (std::min)(size, size_t(65535));
+        out.push_back(block == size ? 1 : 0);  // BFINAL, BTYPE = stored
+        out.push_back(uint8_t(block));
+        out.push_back(uint8_t(block >> 8));
+        out.push_back(uint8_t(~block));
+        out.push_back(uint8_t(~block >> 8));
+        out.insert(out.end(), data, data + block);
+        data += block;
+        size -= block;
+    } while (size > 0);
+}
+
+// One final block with the fixed codes. Images compress well enough with them, and no
+// code tables have to be built or sent.
+void Deflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+    size_t start = out.size();
+    const FixedCodes &codes = GetFixedCodes();
+    BitWriter writer(out);
+    writer.Write(1, 1);  // BFINAL
+    writer.Write(1, 2);  // BTYPE = fixed Huffman
+
+    auto writeLiteral = [&](uint32_t symbol) {
+        writer.Write(codes.literal[symbol], codes.literalLength[symbol]);
+    };
+
+    std::vector<int32_t> head(size_t(1) << HashBits, -1);
+    std::vector<int32_t> previous(WindowSize, -1);
+    auto insert = [&](size_t position) {
+        uint32_t hash = Hash(data + position);
+        previous[position & (WindowSize - 1)] = head[hash];
+        head[hash] = int32_t(position);
+    };
+
+    size_t position = 0;
+    while (position < size) {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+        if (position + MinMatch <= size) {
+            uint32_t maxLength = uint32_t((std::min)(size - position, size_t(MaxMatch)));
+            int32_t candidate = head[Hash(data + position)];
+            for (uint32_t chain = 0; candidate >= 0 && chain < MaxChain; chain++) {
+                size_t distance = position - size_t(candidate);
+                if (distance > WindowSize) {
+                    break;
+                }
+                const uint8_t *a = data + candidate;
+                const uint8_t *b = data + position;
+                if (a[bestLength] == b[bestLength]) {
+                    uint32_t length = 0;
+                    while (length < maxLength && a[length] == b[length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = uint32_t(distance);
+                        if (length == maxLength) {
+                            break;
+                        }
+                    }
+                }
+                candidate = previous[candidate & (WindowSize - 1)];
+            }
+            insert(position);
+        }
+
+        if (bestLength >= MinMatch) {
+            uint32_t lengthIndex = codes.lengthSymbol[bestLength];
+            writeLiteral(257 + lengthIndex);
+            writer.Write(bestLength - LengthBase[lengthIndex], LengthExtra[lengthIndex]);
+
+            uint32_t distanceIndex = uint32_t(std::upper_bound(DistanceBase, DistanceBase + 30, bestDistance) - DistanceBase) - 1;
+            writer.Write(codes.distance[distanceIndex], 5);
+            writer.Write(bestDistance - DistanceBase[distanceIndex], DistanceExtra[distanceIndex]);
+
+            for (size_t i = position + 1; i < position + bestLength && i + MinMatch <= size; i++) {
+                insert(i);
+            }
+            position += bestLength;
+        } else {
+            writeLiteral(data[position]);
+            position++;
+        }
+    }
+
+    writeLiteral(256);
+    writer.Flush();
+
+    size_t storedSize = size + (size / 65535 + 1) * 5;
+    if (out.size() - start > storedSize) {
+        out.resize(start);
+        DeflateStored(data, size, out);
+    }
+}
+
+// PNG
+
+void WriteUint32(std::vector<uint8_t> &out, uint32_t value) {
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+void PatchUint32(std::vector<uint8_t> &out, size_t offset, uint32_t value) {
+    out[offset + 0] = uint8_t(value >> 24);
+    out[offset + 1] = uint8_t(value >> 16);
+    out[offset + 2] = uint8_t(value >> 8);
+    out[offset + 3] = uint8_t(value);
+}
+
+// Chunks are written in place; the length and CRC are filled in by EndChunk().
+size_t BeginChunk(std::vector<uint8_t> &file, const char *type) {
+    size_t offset = file.size();
+    WriteUint32(file, 0);
+    file.insert(file.end(), type, type + 4);
+    return offset;
+}
+
+void EndChunk(std::vector<uint8_t> &file, size_t offset) {
+    size_t dataSize = file.size() - offset - 8;
+    PatchUint32(file, offset, uint32_t(dataSize));
+    WriteUint32(file, GetCrc32(file.data() + offset + 4, dataSize + 4));
+}
+
+// Copies a row to RGB or RGBA order.
+void ReadRow(const ImageView &image, uint32_t y, uint32_t channels, uint8_t *row) {
+    const uint8_t *source = image.pixels + image.rowPitch * y;
+    uint32_t red = image.order == ChannelOrder::Bgra ? 2 : 0;
+    uint32_t blue = 2 - red;
+    for (uint32_t x = 0; x < image.width; x++) {
+        row[0] = source[red];
+        row[1] = source[1];
+        row[2] = source[blue];
+        if (channels == 4) {
+            row[3] = source[3];
+        }
+        source += 4;
+        row += channels;
+    }
+}
+
+uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = int(a) + int(b) - int(c);
+    int pa = std::abs(p - int(a));
+    int pb = std::abs(p - int(b));
+    int pc = std::abs(p - int(c));
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Writes filter type and filtered bytes of all five filters to candidates, one row of
+// size + 1 bytes each, and returns the index of the one with the smallest sum.
+uint32_t FilterRow(const uint8_t *row, const uint8_t *above, size_t size, uint32_t bytesPerPixel, uint8_t *candidates) {
+    uint32_t best = 0;
+    uint64_t bestSum = UINT64_MAX;
+    for (uint32_t filter = 0; filter < 5; filter++) {
+        uint8_t *out = candidates + filter * (size + 1);
+        out[0] = uint8_t(filter);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; i++) {
+            uint8_t left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+            uint8_t up = above[i];
+            uint8_t upLeft = i >= bytesPerPixel ? above[i - bytesPerPixel] : 0;
+            uint8_t predicted;
+            switch (filter) {
+            case 0:  predicted = 0; break;
+            case 1:  predicted = left; break;
+            case 2:  predicted = up; break;
+            case 3:  predicted = uint8_t((uint32_t(left) + up) / 2); break;
+            default: predicted = Paeth(left, up, upLeft); break;
+            }
+            uint8_t value = uint8_t(row[i] - predicted);
+            out[i + 1] = value;
+            sum += uint64_t(std::abs(int(int8_t(value))));
+        }
+        if (sum < bestSum) {
+            bestSum = sum;
+            best = filter;
+        }
+    }
+    return best;
+}
+
+}
+
+void EncodePng(const ImageView &image, std::vector<uint8_t> &file) {
+    bool opaque = true;
+    for (uint32_t y = 0; y < image.height && opaque; y++) {
+        const uint8_t *row = image.pixels + image.rowPitch * y;
+        for (uint32_t x = 0; x < image.width; x++) {
+            if (row[x * 4 + 3] != 0xFF) {
+                opaque = false;
+                break;
+            }
+        }
+    }
+    uint32_t channels = opaque ? 3 : 4;
+
+    // Filtered scanlines, each with its filter type byte.
+    size_t rowSize = size_t(image.width) * channels;
+    std::vector<uint8_t> filtered((rowSize + 1) * image.height);
+    std::vector<uint8_t> rows(rowSize * 2, 0);   // Current and previous row; the one above the first is zero.
+    std::vector<uint8_t> candidates((rowSize + 1) * 5);
+    for (uint32_t y = 0; y < image.height; y++) {
+        uint8_t *row = rows.data() + rowSize * (y & 1);
+        const uint8_t *above = rows.data() + rowSize * ((y + 1) & 1);
+        ReadRow(image, y, channels, row);
+        uint32_t filter = FilterRow(row, above, rowSize, channels, candidates.data());
+        memcpy(filtered.data() + (rowSize + 1) * y, candidates.data() + (rowSize + 1) * filter, rowSize + 1);
+    }
+
+    file.clear();
+    file.reserve(filtered.size() + filtered.size() / 8 + 1024);
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.insert(file.end(), signature, signature + 8);
+
+    size_t chunk = BeginChunk(file, "IHDR");
+    WriteUint32(file, image.width);
+    WriteUint32(file, image.height);
+    file.push_back(8);                       // Bit depth
+    file.push_back(opaque ? 2 : 6);          // Color type: RGB or RGBA
+    file.push_back(0);                       // Compression
+    file.push_back(0);                       // Filter
+    file.push_back(0);                       // Interlace
+    EndChunk(file, chunk);
+
+    // zlib stream: header without preset dictionary, deflate data, Adler-32 of the input.
+    chunk = BeginChunk(file, "IDAT");
+    file.push_back(0x78);
+    file.push_back(0x01);
+    Deflate(filtered.data(), filtered.size(), file);
+    WriteUint32(file, GetAdler32(filtered.data(), filtered.size()));
+    EndChunk(file, chunk);
+
+    chunk = BeginChunk(file, "IEND");
+    EndChunk(file, chunk);
+}
+
+void EncodeRaw(const ImageView &image, std::vector<uint8_t> &file) {
+    size_t rowSize = size_t(image.width) * 4;
+    file.resize(rowSize * image.height);
+    for (uint32_t y = 0; y < image.height; y++) {
+        ReadRow(image, y, 4, file.data() + rowSize * y);
+    }
+}
+
+bool SaveImage(const char *path, const ImageView &image, ImageFileFormat format) {
+    std::vector<uint8_t> data;
+    if (format == ImageFileFormat::Png) {
+        EncodePng(image, data);
+    } else {
+        EncodeRaw(image, data);
+    }
+
+    FILE *file;
+#ifdef _WIN32
+    if (fopen_s(&file, path, "wb") != 0) {
+        return false;
+    }
+#else
+    file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+#endif
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+// ImageEncodeQueue
+
+ImageEncodeQueue::~ImageEncodeQueue() {
+    Stop();
+}
+
+void ImageEncodeQueue::Start(uint32_t workerCount, uint32_t maxQueued) {
+    Stop();
+    this->maxQueued = maxQueued;
+    stopping = false;
+    for (uint32_t i = 0; i < (std::max)(workerCount, 1u); i++) {
+        workers.emplace_back(&ImageEncodeQueue::WorkerMain, this);
+    }
+}
+
+void ImageEncodeQueue::Stop() {
+    if (workers.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+bool ImageEncodeQueue::Push(EncodeJob &&job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (workers.empty() || stopping || queued.size() >= maxQueued) {
+            return false;
+        }
+        queued.push_back(std::move(job));
+    }
+    wake.notify_one();
+    return true;
+}
+
+void ImageEncodeQueue::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [&] { return queued.empty() && running == 0; });
+}
+
+uint32_t ImageEncodeQueue::GetWrittenCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writtenCount;
+}
+
+uint32_t ImageEncodeQueue::GetFailedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failedCount;
+}
+
+void ImageEncodeQueue::WorkerMain() {
+    for (;;) {
+        EncodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Queued jobs are finished before stopping, so no capture is lost at exit.
+            wake.wait(lock, [&] { return stopping || !queued.empty(); });
+            if (queued.empty()) {
+                return;
+            }
+            job = std::move(queued.front());
+            queued.pop_front();
+            running++;
+        }
+
+        ImageView image;
+        bool written = job.acquire(image) && SaveImage(job.path.c_str(), image, job.format);
+        if (job.release) {
+            job.release();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+            if (written) {
+                writtenCount++;
+            } else {
+                failedCount++;
+            }
+        }
+        idle.notify_all();
+    }
+}
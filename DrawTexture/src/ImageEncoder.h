@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ImageFileFormat {
+    Png,
+    Raw,  // Tightly packed R8G8B8A8 rows, top to bottom, no header.
+};
+
+enum class ChannelOrder {
+    Rgba,
+    Bgra,
+};
+
+// 8-bit, 4-channel pixels, e.g. a mapped readback buffer at its footprint's row pitch.
+struct ImageView {
+    const uint8_t *pixels;
+    uint32_t width;
+    uint32_t height;
+    size_t rowPitch;
+    ChannelOrder order;
+};
+
+// Writes an 8-bit RGB PNG, or RGBA if any pixel is not opaque. Rows are filtered with the
+// filter that gives the smallest sum of absolute differences; the data is deflated with
+// fixed Huffman codes and a short LZ77 hash chain, which trades some size for speed.
+void EncodePng(const ImageView &image, std::vector<uint8_t> &file);
+void EncodeRaw(const ImageView &image, std::vector<uint8_t> &file);
+bool SaveImage(const char *path, const ImageView &image, ImageFileFormat format);
+
+// An image to write on a worker thread. acquire() provides the pixels on the worker,
+// e.g. by mapping a readback buffer, and release() is called once they are no longer
+// read, whether or not writing succeeded. release() is also called if acquire() fails.
+struct EncodeJob {
+    std::string path;
+    ImageFileFormat format;
+    std::function<bool(ImageView &image)> acquire;
+    std::function<void()> release;
+};
+
+// Worker threads that encode and write images. Push() never waits: when maxQueued jobs
+// are waiting it fails, and the caller drops the image instead of stalling.
+class ImageEncodeQueue {
+public:
+    ~ImageEncodeQueue();
+
+    void Start(uint32_t workerCount, uint32_t maxQueued);
+    // Finishes the queued jobs and joins the workers.
+    void Stop();
+
+    bool Push(EncodeJob &&job);
+    // Waits until every pushed job has been written.
+    void Flush();
+
+    uint32_t GetWrittenCount() const;
+    uint32_t GetFailedCount() const;
+
+private:
+    void WorkerMain();
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<EncodeJob> queued;
+    uint32_t maxQueued = 0;
+    uint32_t running = 0;    // Jobs taken by workers and not finished yet.
+    uint32_t writtenCount = 0;
+    uint32_t failedCount = 0;
+    bool stopping = false;
+};
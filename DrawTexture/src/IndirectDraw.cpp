@@ -0,0 +1,206 @@
+#include "IndirectDraw.h"
+
+using Microsoft::WRL::ComPtr;
+
+HRESULT IndirectDrawBuilder::Init(ID3D12Device *device, ID3D12RootSignature *rootSignature, UINT objectIdRootParameterIndex, UINT materialRootParameterIndex,
+                                  UINT maxCommands, UINT maxBuckets) {
+    this->device = device;
+    this->materialRootParameterIndex = materialRootParameterIndex;
+
+    frames.clear();
+    currentFrame = SIZE_MAX;
+    layout.Reset(maxCommands, maxBuckets);
+    bucketStates.clear();
+
+    D3D12_INDIRECT_ARGUMENT_DESC arguments[2];
+    arguments[0].Type                             = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+    arguments[0].Constant.RootParameterIndex      = objectIdRootParameterIndex;
+    arguments[0].Constant.DestOffsetIn32BitValues = 0;
+    arguments[0].Constant.Num32BitValuesToSet     = 1;
+    arguments[1].Type                             = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+    D3D12_COMMAND_SIGNATURE_DESC desc;
+    desc.ByteStride       = sizeof(IndirectDrawRecord);
+    desc.NumArgumentDescs = _countof(arguments);
+    desc.pArgumentDescs   = arguments;
+    desc.NodeMask         = 0;
+
+    // Root signature is required because the signature changes a root constant.
+    HRESULT hr = device->CreateCommandSignature(&desc, rootSignature, IID_PPV_ARGS(&commandSignature));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Two frames in flight are created up front, more only if the GPU falls behind.
+    for (int i = 0; i < 2; i++) {
+        size_t index;
+        hr = CreateFrame(index);
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+void IndirectDrawBuilder::TrackResidency(ResidencyManager *residency) {
+    this->residency = residency;
+    for (Frame &frame : frames) {
+        frame.argumentsResidency = residency->TrackMapped(frame.arguments.Get());
+        frame.countsResidency = residency->TrackMapped(frame.counts.Get());
+    }
+}
+
+void IndirectDrawBuilder::BeginFrame(UINT64 completedFenceValue) {
+    currentFrame = SIZE_MAX;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].fenceValue <= completedFenceValue) {
+            currentFrame = i;
+            break;
+        }
+    }
+
+    if (currentFrame == SIZE_MAX) {
+        size_t index;
+        if (SUCCEEDED(CreateFrame(index))) {
+            currentFrame = index;
+        }
+    }
+
+    // Reserved until EndFrame() so the next BeginFrame() does not pick it again.
+    if (currentFrame != SIZE_MAX) {
+        frames[currentFrame].fenceValue = UINT64_MAX;
+    }
+
+    layout.Clear();
+    bucketStates.clear();
+}
+
+void IndirectDrawBuilder::EndFrame(UINT64 fenceValue) {
+    if (currentFrame != SIZE_MAX) {
+        frames[currentFrame].fenceValue = fenceValue;
+    }
+    currentFrame = SIZE_MAX;
+}
+
+bool IndirectDrawBuilder::BeginBucket(ID3D12PipelineState *pipelineState, D3D12_GPU_DESCRIPTOR_HANDLE materialTable) {
+    if (currentFrame == SIZE_MAX || !layout.BeginBucket()) {
+        return false;
+    }
+    bucketStates.push_back({ pipelineState, materialTable });
+    return true;
+}
+
+bool IndirectDrawBuilder::AddDraws(const MeshRange &mesh, const UINT *objectIds, UINT count) {
+    UINT firstCommand;
+    if (currentFrame == SIZE_MAX || !layout.AddCommands(count, firstCommand)) {
+        return false;
+    }
+
+    IndirectDrawRecord draw;
+    draw.objectId              = 0;
+    draw.indexCountPerInstance = mesh.indexCount;
+    draw.instanceCount         = 1;
+    draw.startIndexLocation    = mesh.startIndex;
+    draw.baseVertexLocation    = INT(mesh.baseVertex);
+    draw.startInstanceLocation = 0;
+
+    WriteIndirectDraws(draw, objectIds, frames[currentFrame].argumentData + firstCommand, count);
+
+    return true;
+}
+
+void IndirectDrawBuilder::EndBucket() {
+    // The count is read by the GPU, so a culling pass could later write it instead.
+    if (currentFrame != SIZE_MAX && layout.EndBucket()) {
+        const std::vector<IndirectBucket> &buckets = layout.GetBuckets();
+        frames[currentFrame].countData[buckets.size() - 1] = buckets.back().commandCount;
+    }
+}
+
+void IndirectDrawBuilder::Execute(CommandStateCache &state) const {
+    if (currentFrame == SIZE_MAX) {
+        return;
+    }
+
+    const Frame &frame = frames[currentFrame];
+    const std::vector<IndirectBucket> &buckets = layout.GetBuckets();
+    if (residency && layout.GetCommandCount() > 0) {
+        residency->Use(frame.argumentsResidency);
+        residency->Use(frame.countsResidency);
+    }
+
+    for (size_t i = 0; i < buckets.size(); i++) {
+        const IndirectBucket &bucket = buckets[i];
+        if (bucket.commandCount == 0) {
+            continue;
+        }
+
+        state.SetPipelineState(bucketStates[i].pipelineState);
+        state.SetGraphicsRootDescriptorTable(materialRootParameterIndex, bucketStates[i].materialTable);
+        state.GetCommandList()->ExecuteIndirect(
+            commandSignature.Get(),
+            bucket.commandCount,
+            frame.arguments.Get(), UINT64(bucket.firstCommand) * sizeof(IndirectDrawRecord),
+            frame.counts.Get(), UINT64(i) * sizeof(UINT));
+    }
+}
+
+HRESULT IndirectDrawBuilder::CreateFrame(size_t &index) {
+    Frame frame = { };
+
+    void *data;
+    HRESULT hr = CreateUploadBuffer(UINT64(layout.GetMaxCommands()) * sizeof(IndirectDrawRecord), frame.arguments, &data);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    frame.argumentData = (IndirectDrawRecord *) data;
+
+    hr = CreateUploadBuffer(UINT64(layout.GetMaxBuckets()) * sizeof(UINT), frame.counts, &data);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    frame.countData = (UINT *) data;
+
+    if (residency) {
+        frame.argumentsResidency = residency->TrackMapped(frame.arguments.Get());
+        frame.countsResidency = residency->TrackMapped(frame.counts.Get());
+    }
+
+    index = frames.size();
+    frames.push_back(frame);
+
+    return S_OK;
+}
+
+HRESULT IndirectDrawBuilder::CreateUploadBuffer(UINT64 size, ComPtr<ID3D12Resource> &buffer, void **data) {
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_UPLOAD;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Alignment          = 0;
+    desc.Width              = size > 0 ? size : 1;
+    desc.Height             = 1;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = DXGI_FORMAT_UNKNOWN;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    // GENERIC_READ includes INDIRECT_ARGUMENT, upload buffers cannot leave it.
+    HRESULT hr = device->CreateCommittedResource(
+        &properties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    D3D12_RANGE readRange = { 0, 0 };
+    return buffer->Map(0, &readRange, data);
+}
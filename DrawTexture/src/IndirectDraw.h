@@ -0,0 +1,85 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "BatchMath.h"
+#include "CommandStateCache.h"
+#include "GeometryPool.h"
+#include "IndirectDrawLayout.h"
+#include "ResidencyManager.h"
+
+// The record layout must match the command signature: one root constant, then the draw arguments.
+static_assert(sizeof(IndirectDrawRecord) == sizeof(UINT) + sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), "IndirectDrawRecord size mismatch.");
+static_assert(offsetof(IndirectDrawRecord, indexCountPerInstance) == sizeof(UINT) + offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, IndexCountPerInstance), "IndirectDrawRecord layout mismatch.");
+static_assert(offsetof(IndirectDrawRecord, baseVertexLocation) == sizeof(UINT) + offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, BaseVertexLocation), "IndirectDrawRecord layout mismatch.");
+static_assert(offsetof(IndirectDrawRecord, startInstanceLocation) == sizeof(UINT) + offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, StartInstanceLocation), "IndirectDrawRecord layout mismatch.");
+
+// Builds ExecuteIndirect arguments for meshes of a GeometryPool. Draws are grouped
+// into buckets that share a pipeline state and material; each bucket becomes one ExecuteIndirect
+// with its own slot in the count buffer. The object ID of every draw is passed as a
+// root constant so shaders can fetch per-object data. Argument and count buffers are
+// persistently mapped UPLOAD buffers, one set per frame in flight, recycled by fence
+// like ConstantAllocator pages. IndirectDrawLayout places the commands and buckets.
+class IndirectDrawBuilder {
+public:
+    // The material of a bucket is a descriptor table bound at materialRootParameterIndex.
+    HRESULT Init(ID3D12Device *device, ID3D12RootSignature *rootSignature, UINT objectIdRootParameterIndex, UINT materialRootParameterIndex,
+                 UINT maxCommands, UINT maxBuckets);
+    // Tracks the argument and count buffers from now on, including new ones. Execute()
+    // marks the buffers of the frame used.
+    void TrackResidency(ResidencyManager *residency);
+
+    void BeginFrame(UINT64 completedFenceValue);
+    void EndFrame(UINT64 fenceValue);
+
+    // Draws added between BeginBucket() and EndBucket() are issued with pipelineState and materialTable.
+    // BeginBucket() fails once maxBuckets are used, AddDraws() once maxCommands would be
+    // exceeded; either stops recording, and every later bucket and draw of the frame fails too.
+    bool BeginBucket(ID3D12PipelineState *pipelineState, D3D12_GPU_DESCRIPTOR_HANDLE materialTable);
+    bool AddDraws(const MeshRange &mesh, const UINT *objectIds, UINT count);
+    void EndBucket();
+
+    // One ExecuteIndirect per non-empty bucket; pipeline states and material tables are only
+    // set where they change. The caller binds the root signature, geometry and the other
+    // root parameters.
+    void Execute(CommandStateCache &state) const;
+
+    ID3D12CommandSignature *GetCommandSignature() const { return commandSignature.Get(); }
+    UINT GetCommandCount() const { return layout.GetCommandCount(); }
+    UINT GetBucketCount() const { return UINT(layout.GetBuckets().size()); }
+    bool HasOverflowed() const { return layout.HasOverflowed(); }
+
+private:
+    // State of each bucket of layout, by index.
+    struct BucketState {
+        ID3D12PipelineState *pipelineState;
+        D3D12_GPU_DESCRIPTOR_HANDLE materialTable;
+    };
+
+    struct Frame {
+        Microsoft::WRL::ComPtr<ID3D12Resource> arguments;
+        Microsoft::WRL::ComPtr<ID3D12Resource> counts;
+        IndirectDrawRecord *argumentData;
+        UINT *countData;
+        ResidencyHandle argumentsResidency;
+        ResidencyHandle countsResidency;
+        UINT64 fenceValue;
+    };
+
+    HRESULT CreateFrame(size_t &index);
+    HRESULT CreateUploadBuffer(UINT64 size, Microsoft::WRL::ComPtr<ID3D12Resource> &buffer, void **data);
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12CommandSignature> commandSignature;
+    UINT materialRootParameterIndex = 0;
+
+    std::vector<Frame> frames;
+    size_t currentFrame = SIZE_MAX;
+    IndirectDrawLayout layout;
+    std::vector<BucketState> bucketStates;
+    ResidencyManager *residency = nullptr;
+};
@@ -0,0 +1,46 @@
+#include "IndirectDrawLayout.h"
+
+void IndirectDrawLayout::Reset(uint32_t maxCommands, uint32_t maxBuckets) {
+    this->maxCommands = maxCommands;
+    this->maxBuckets = maxBuckets;
+    buckets.reserve(maxBuckets);
+    Clear();
+}
+
+void IndirectDrawLayout::Clear() {
+    buckets.clear();
+    commandCount = 0;
+    bucketOpen = false;
+    overflowed = false;
+}
+
+bool IndirectDrawLayout::BeginBucket() {
+    bucketOpen = false;
+    if (overflowed || buckets.size() >= maxBuckets) {
+        overflowed = true;
+        return false;
+    }
+    buckets.push_back({ commandCount, 0 });
+    bucketOpen = true;
+    return true;
+}
+
+bool IndirectDrawLayout::AddCommands(uint32_t count, uint32_t &firstCommand) {
+    if (!bucketOpen || overflowed) {
+        return false;
+    }
+    if (count > maxCommands - commandCount) {
+        overflowed = true;
+        return false;
+    }
+    firstCommand = commandCount;
+    commandCount += count;
+    buckets.back().commandCount += count;
+    return true;
+}
+
+bool IndirectDrawLayout::EndBucket() {
+    bool closed = bucketOpen;
+    bucketOpen = false;
+    return closed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Commands of one bucket: records [firstCommand, firstCommand + commandCount) of the
+// argument buffer; the bucket's index is its slot in the count buffer.
+struct IndirectBucket {
+    uint32_t firstCommand;
+    uint32_t commandCount;
+};
+
+// Places the draws of one frame in the argument and count buffers of IndirectDrawBuilder.
+// Buckets are contiguous and in the order they were begun. When a limit is reached the
+// layout stops recording: the bucket or draws that did not fit are rejected, and so is
+// everything after them until Clear(), so a frame never executes a partial bucket list
+// that skips some draws but not later ones. No D3D12 types are involved.
+class IndirectDrawLayout {
+public:
+    void Reset(uint32_t maxCommands, uint32_t maxBuckets);
+    void Clear();
+
+    // Opens the next bucket. False when all maxBuckets slots are used or recording stopped.
+    bool BeginBucket();
+    // Reserves count commands at the end of the open bucket and returns the first one.
+    // False without a bucket, when maxCommands would be exceeded, or when recording stopped.
+    bool AddCommands(uint32_t count, uint32_t &firstCommand);
+    // Closes the open bucket; false when none was open. A bucket that overflowed is still
+    // closed and keeps the commands added before the overflow.
+    bool EndBucket();
+
+    const std::vector<IndirectBucket> &GetBuckets() const { return buckets; }
+    uint32_t GetCommandCount() const { return commandCount; }
+    uint32_t GetMaxCommands() const { return maxCommands; }
+    uint32_t GetMaxBuckets() const { return maxBuckets; }
+    bool IsBucketOpen() const { return bucketOpen; }
+    bool HasOverflowed() const { return overflowed; }
+
+private:
+    std::vector<IndirectBucket> buckets;
+    uint32_t commandCount = 0;
+    uint32_t maxCommands = 0;
+    uint32_t maxBuckets = 0;
+    bool bucketOpen = false;
+    bool overflowed = false;
+};
@@ -0,0 +1,1180 @@
+#include "JpegDecoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Parallel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define JPEG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int HuffmanFastBits = 9;
+constexpr int MaxComponents = 3;
+
+// Zigzag scan order to natural order.
+constexpr uint8_t ZigZag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+struct HuffmanTable {
+    uint16_t fast[1 << HuffmanFastBits]; // (length << 8) | value, 0 when the code is longer.
+    uint32_t maxCode[18];                // First code past each length, left-aligned to 16 bits.
+    int32_t valueOffset[17];
+    uint8_t values[256];
+    bool defined;
+};
+
+struct Component {
+    uint8_t id;
+    int h, v;
+    int tq;
+    int td, ta;
+    uint32_t blocksPerLine;   // Padded to whole MCUs.
+    uint32_t blocksPerColumn;
+    uint32_t widthInBlocks;   // Blocks that cover the image, used by non-interleaved scans.
+    uint32_t heightInBlocks;
+    std::vector<int16_t> coefficients;
+    std::vector<uint8_t> plane;
+};
+
+struct Frame {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool progressive = false;
+    bool defined = false;
+    int hmax = 1, vmax = 1;
+    uint32_t mcusX = 0, mcusY = 0;
+    int componentCount = 0;
+    Component components[MaxComponents];
+    uint16_t quant[4][64] = { };    // Natural order.
+    float idctScale[MaxComponents][64];
+    HuffmanTable dc[4] = { };
+    HuffmanTable ac[4] = { };
+    uint32_t restartInterval = 0;
+    int adobeTransform = -1;
+};
+
+struct Scan {
+    int componentCount;
+    int componentIndex[MaxComponents];
+    int ss, se, ah, al;
+};
+
+inline uint32_t ReadU16(const uint8_t *p) {
+    return (uint32_t(p[0]) << 8) | p[1];
+}
+
+bool BuildHuffmanTable(HuffmanTable &table, const uint8_t *counts, const uint8_t *values, int valueCount) {
+    uint16_t codes[256];
+    uint8_t sizes[256];
+    int k = 0;
+    uint32_t code = 0;
+
+    for (int length = 1; length <= 16; length++) {
+        table.valueOffset[length] = k - (int) code;
+        for (int i = 0; i < counts[length - 1]; i++) {
+            if (k >= valueCount) {
+                return false;
+            }
+            codes[k] = (uint16_t) code++;
+            sizes[k] = (uint8_t) length;
+            k++;
+        }
+        if (code > (1u << length)) {
+            return false;
+        }
+        table.maxCode[length] = code << (16 - length);
+        code <<= 1;
+    }
+    table.maxCode[17] = UINT32_MAX;
+
+    memset(table.fast, 0, sizeof(table.fast));
+    memcpy(table.values, values, k);
+    for (int i = 0; i < k; i++) {
+        if (sizes[i] <= HuffmanFastBits) {
+            int shift = HuffmanFastBits - sizes[i];
+            int first = codes[i] << shift;
+            for (int j = 0; j < (1 << shift); j++) {
+                table.fast[first + j] = (uint16_t) ((sizes[i] << 8) | values[i]);
+            }
+        }
+    }
+
+    table.defined = true;
+    return true;
+}
+
+// MSB-first reader over one restart interval of entropy-coded data. Reading past the end yields zeros.
+class BitReader {
+public:
+    BitReader(const uint8_t *begin, const uint8_t *end) : p(begin), end(end) {}
+
+    uint32_t Peek16() {
+        if (count < 16) {
+            Fill();
+        }
+        return uint32_t(bits >> 48);
+    }
+
+    void Skip(int n) {
+        bits <<= n;
+        count -= n;
+    }
+
+    int GetBits(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        if (count < n) {
+            Fill();
+        }
+        int value = int(bits >> (64 - n));
+        Skip(n);
+        return value;
+    }
+
+    int GetBit() {
+        return GetBits(1);
+    }
+
+    // Reads n bits as a signed magnitude category value.
+    int Receive(int n) {
+        int value = GetBits(n);
+        return n && value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+    }
+
+    int Decode(const HuffmanTable &table) {
+        uint32_t peek = Peek16();
+        uint16_t fast = table.fast[peek >> (16 - HuffmanFastBits)];
+        if (fast) {
+            Skip(fast >> 8);
+            return fast & 0xFF;
+        }
+
+        int length = HuffmanFastBits + 1;
+        while (length <= 16 && peek >= table.maxCode[length]) {
+            length++;
+        }
+        if (length > 16) {
+            return -1;
+        }
+
+        int index = int(peek >> (16 - length)) + table.valueOffset[length];
+        if (index < 0 || index > 255) {
+            return -1;
+        }
+        Skip(length);
+        return table.values[index];
+    }
+
+private:
+    void Fill() {
+        while (count <= 56) {
+            uint32_t byte = 0;
+            if (p < end) {
+                byte = *p++;
+                if (byte == 0xFF) {
+                    if (p < end && *p == 0x00) {
+                        p++;
+                    } else {
+                        p = end;
+                        byte = 0;
+                    }
+                }
+            }
+            bits |= uint64_t(byte) << (56 - count);
+            count += 8;
+        }
+    }
+
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t bits = 0;
+    int count = 0;
+};
+
+// Inverse DCT
+
+// AAN scale factors, folded into the dequantization table together with the final 1/8.
+const float AanScale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+};
+
+// One-dimensional AAN inverse DCT on eight values of type V (float or four SIMD lanes).
+template <typename V>
+inline void Idct8(V *d) {
+    V tmp0 = d[0], tmp1 = d[2], tmp2 = d[4], tmp3 = d[6];
+
+    V tmp10 = tmp0 + tmp2;
+    V tmp11 = tmp0 - tmp2;
+    V tmp13 = tmp1 + tmp3;
+    V tmp12 = (tmp1 - tmp3) * V(1.414213562f) - tmp13;
+
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    V tmp4 = d[1], tmp5 = d[3], tmp6 = d[5], tmp7 = d[7];
+
+    V z13 = tmp6 + tmp5;
+    V z10 = tmp6 - tmp5;
+    V z11 = tmp4 + tmp7;
+    V z12 = tmp4 - tmp7;
+
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * V(1.414213562f);
+
+    V z5 = (z10 + z12) * V(1.847759065f);
+    tmp10 = z5 - z12 * V(1.082392200f);
+    tmp12 = z5 - z10 * V(2.613125930f);
+
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 - tmp5;
+
+    d[0] = tmp0 + tmp7;
+    d[7] = tmp0 - tmp7;
+    d[1] = tmp1 + tmp6;
+    d[6] = tmp1 - tmp6;
+    d[2] = tmp2 + tmp5;
+    d[5] = tmp2 - tmp5;
+    d[3] = tmp3 + tmp4;
+    d[4] = tmp3 - tmp4;
+}
+
+#ifdef JPEG_SSE2
+
+struct Float4 {
+    __m128 v;
+
+    Float4() = default;
+    Float4(__m128 v) : v(v) {}
+    Float4(float f) : v(_mm_set1_ps(f)) {}
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+
+// Transposes the 8x8 matrix held as rows[r][half].
+inline void Transpose8x8(Float4 (*rows)[2]) {
+    _MM_TRANSPOSE4_PS(rows[0][0].v, rows[1][0].v, rows[2][0].v, rows[3][0].v);
+    _MM_TRANSPOSE4_PS(rows[0][1].v, rows[1][1].v, rows[2][1].v, rows[3][1].v);
+    _MM_TRANSPOSE4_PS(rows[4][0].v, rows[5][0].v, rows[6][0].v, rows[7][0].v);
+    _MM_TRANSPOSE4_PS(rows[4][1].v, rows[5][1].v, rows[6][1].v, rows[7][1].v);
+    for (int i = 0; i < 4; i++) {
+        Float4 swap = rows[i][1];
+        rows[i][1] = rows[i + 4][0];
+        rows[i + 4][0] = swap;
+    }
+}
+
+void IdctBlock(const int16_t *coefficients, const float *scale, uint8_t *out, size_t stride) {
+    // Smooth areas often have no AC energy at all; such a block is flat.
+    __m128i ac = _mm_andnot_si128(_mm_cvtsi32_si128(0xFFFF), _mm_loadu_si128((const __m128i *) coefficients));
+    for (int r = 1; r < 8; r++) {
+        ac = _mm_or_si128(ac, _mm_loadu_si128((const __m128i *) (coefficients + r * 8)));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(ac, _mm_setzero_si128())) == 0xFFFF) {
+        __m128i value = _mm_cvtps_epi32(_mm_set1_ps(coefficients[0] * scale[0] + 128.0f));
+        value = _mm_packs_epi32(value, value);
+        value = _mm_packus_epi16(value, value);
+        for (int r = 0; r < 8; r++) {
+            _mm_storel_epi64((__m128i *) (out + r * stride), value);
+        }
+        return;
+    }
+
+    Float4 rows[8][2];
+    for (int r = 0; r < 8; r++) {
+        __m128i c = _mm_loadu_si128((const __m128i *) (coefficients + r * 8));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(c, c), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(c, c), 16);
+        rows[r][0] = _mm_mul_ps(_mm_cvtepi32_ps(lo), _mm_loadu_ps(scale + r * 8));
+        rows[r][1] = _mm_mul_ps(_mm_cvtepi32_ps(hi), _mm_loadu_ps(scale + r * 8 + 4));
+    }
+
+    // Columns, then rows; each pass transforms four columns per lane group.
+    for (int pass = 0; pass < 2; pass++) {
+        for (int half = 0; half < 2; half++) {
+            Float4 column[8];
+            for (int k = 0; k < 8; k++) {
+                column[k] = rows[k][half];
+            }
+            Idct8(column);
+            for (int k = 0; k < 8; k++) {
+                rows[k][half] = column[k];
+            }
+        }
+        Transpose8x8(rows);
+    }
+
+    const __m128 bias = _mm_set1_ps(128.0f);
+    for (int r = 0; r < 8; r++) {
+        __m128i lo = _mm_cvtps_epi32(_mm_add_ps(rows[r][0].v, bias));
+        __m128i hi = _mm_cvtps_epi32(_mm_add_ps(rows[r][1].v, bias));
+        __m128i words = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *) (out + r * stride), _mm_packus_epi16(words, words));
+    }
+}
+
+#else
+
+inline uint8_t ClampToByte(float value) {
+    long i = lrintf(value);
+    return (uint8_t) (i < 0 ? 0 : i > 255 ? 255 : i);
+}
+
+void IdctBlock(const int16_t *coefficients, const float *scale, uint8_t *out, size_t stride) {
+    int ac = 0;
+    for (int i = 1; i < 64; i++) {
+        ac |= coefficients[i];
+    }
+    if (ac == 0) {
+        uint8_t value = ClampToByte(coefficients[0] * scale[0] + 128.0f);
+        for (int r = 0; r < 8; r++) {
+            memset(out + r * stride, value, 8);
+        }
+        return;
+    }
+
+    float workspace[64];
+    for (int c = 0; c < 8; c++) {
+        float column[8];
+        for (int k = 0; k < 8; k++) {
+            column[k] = coefficients[k * 8 + c] * scale[k * 8 + c];
+        }
+        Idct8(column);
+        for (int k = 0; k < 8; k++) {
+            workspace[k * 8 + c] = column[k];
+        }
+    }
+
+    for (int r = 0; r < 8; r++) {
+        float *row = workspace + r * 8;
+        Idct8(row);
+        for (int k = 0; k < 8; k++) {
+            out[r * stride + k] = ClampToByte(row[k] + 128.0f);
+        }
+    }
+}
+
+#endif
+
+// Per-interval entropy decoder state. Every restart interval starts from a clean state,
+// which is what makes the intervals independent.
+struct EntropyState {
+    BitReader reader;
+    int dcPredictor[MaxComponents];
+    uint32_t eobRun;
+};
+
+bool DecodeBaselineBlock(EntropyState &state, const Frame &frame, int c, int16_t *block) {
+    const Component &component = frame.components[c];
+    BitReader &reader = state.reader;
+
+    int t = reader.Decode(frame.dc[component.td]);
+    if (t < 0 || t > 16) {
+        return false;
+    }
+    state.dcPredictor[c] += reader.Receive(t);
+    block[0] = (int16_t) state.dcPredictor[c];
+
+    const HuffmanTable &ac = frame.ac[component.ta];
+    for (int k = 1; k < 64; ) {
+        int rs = reader.Decode(ac);
+        if (rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        int s = rs & 15;
+        if (s == 0) {
+            if (r != 15) {
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += r;
+        if (k > 63) {
+            return false;
+        }
+        block[ZigZag[k++]] = (int16_t) reader.Receive(s);
+    }
+    return true;
+}
+
+bool DecodeDcFirst(EntropyState &state, const Frame &frame, const Scan &scan, int c, int16_t *block) {
+    int t = state.reader.Decode(frame.dc[frame.components[c].td]);
+    if (t < 0 || t > 16) {
+        return false;
+    }
+    state.dcPredictor[c] += state.reader.Receive(t);
+    block[0] = (int16_t) (state.dcPredictor[c] * (1 << scan.al));
+    return true;
+}
+
+bool DecodeDcRefine(EntropyState &state, const Scan &scan, int16_t *block) {
+    if (state.reader.GetBit()) {
+        block[0] |= (int16_t) (1 << scan.al);
+    }
+    return true;
+}
+
+bool DecodeAcFirst(EntropyState &state, const Frame &frame, const Scan &scan, int c, int16_t *block) {
+    if (state.eobRun > 0) {
+        state.eobRun--;
+        return true;
+    }
+
+    BitReader &reader = state.reader;
+    const HuffmanTable &ac = frame.ac[frame.components[c].ta];
+    for (int k = scan.ss; k <= scan.se; ) {
+        int rs = reader.Decode(ac);
+        if (rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        int s = rs & 15;
+        if (s == 0) {
+            if (r < 15) {
+                state.eobRun = (1u << r) - 1;
+                if (r) {
+                    state.eobRun += reader.GetBits(r);
+                }
+                break;
+            }
+            k += 16;
+            continue;
+        }
+        k += r;
+        if (k > 63) {
+            return false;
+        }
+        block[ZigZag[k++]] = (int16_t) (reader.Receive(s) * (1 << scan.al));
+    }
+    return true;
+}
+
+// Successive approximation refinement of AC coefficients, following the structure of the
+// reference decoder: correction bits are read for every nonzero coefficient that is skipped.
+bool DecodeAcRefine(EntropyState &state, const Frame &frame, const Scan &scan, int c, int16_t *block) {
+    BitReader &reader = state.reader;
+    const int p1 = 1 << scan.al;
+    const int m1 = -(1 << scan.al);
+
+    auto refine = [&](int16_t &coefficient) {
+        if (reader.GetBit() && (coefficient & p1) == 0) {
+            coefficient = (int16_t) (coefficient + (coefficient >= 0 ? p1 : m1));
+        }
+    };
+
+    int k = scan.ss;
+    if (state.eobRun == 0) {
+        const HuffmanTable &ac = frame.ac[frame.components[c].ta];
+        for (; k <= scan.se; k++) {
+            int rs = reader.Decode(ac);
+            if (rs < 0) {
+                return false;
+            }
+            int r = rs >> 4;
+            int s = rs & 15;
+            int value = 0;
+
+            if (s == 0) {
+                if (r < 15) {
+                    state.eobRun = 1u << r;
+                    if (r) {
+                        state.eobRun += reader.GetBits(r);
+                    }
+                    break;
+                }
+            } else {
+                if (s != 1) {
+                    return false;
+                }
+                value = reader.GetBit() ? p1 : m1;
+            }
+
+            while (k <= scan.se) {
+                int16_t &coefficient = block[ZigZag[k]];
+                if (coefficient != 0) {
+                    refine(coefficient);
+                } else {
+                    if (r == 0) {
+                        if (value) {
+                            coefficient = (int16_t) value;
+                        }
+                        break;
+                    }
+                    r--;
+                }
+                k++;
+            }
+        }
+    }
+
+    if (state.eobRun > 0) {
+        for (; k <= scan.se; k++) {
+            int16_t &coefficient = block[ZigZag[k]];
+            if (coefficient != 0) {
+                refine(coefficient);
+            }
+        }
+        state.eobRun--;
+    }
+    return true;
+}
+
+bool DecodeBlock(EntropyState &state, const Frame &frame, const Scan &scan, int c, int16_t *block) {
+    if (!frame.progressive) {
+        return DecodeBaselineBlock(state, frame, c, block);
+    }
+    if (scan.ss == 0) {
+        return scan.ah == 0 ? DecodeDcFirst(state, frame, scan, c, block) : DecodeDcRefine(state, scan, block);
+    }
+    return scan.ah == 0 ? DecodeAcFirst(state, frame, scan, c, block) : DecodeAcRefine(state, frame, scan, c, block);
+}
+
+// Baseline blocks are transformed into the component plane as soon as they are decoded, so
+// only progressive frames keep the whole coefficient image in memory.
+bool DecodeBlockAt(EntropyState &state, Frame &frame, const Scan &scan, int c, size_t bx, size_t by) {
+    Component &component = frame.components[c];
+    if (frame.progressive) {
+        return DecodeBlock(state, frame, scan, c, &component.coefficients[(by * component.blocksPerLine + bx) * 64]);
+    }
+
+    alignas(16) int16_t block[64] = { };
+    if (!DecodeBaselineBlock(state, frame, c, block)) {
+        return false;
+    }
+    size_t stride = size_t(component.blocksPerLine) * 8;
+    IdctBlock(block, frame.idctScale[c], &component.plane[by * 8 * stride + bx * 8], stride);
+    return true;
+}
+
+bool DecodeInterval(Frame &frame, const Scan &scan, const uint8_t *begin, const uint8_t *end, uint32_t mcuBegin, uint32_t mcuEnd) {
+    EntropyState state = { BitReader(begin, end), { }, 0 };
+
+    for (uint32_t mcu = mcuBegin; mcu < mcuEnd; mcu++) {
+        if (scan.componentCount == 1) {
+            int c = scan.componentIndex[0];
+            const Component &component = frame.components[c];
+            if (!DecodeBlockAt(state, frame, scan, c, mcu % component.widthInBlocks, mcu / component.widthInBlocks)) {
+                return false;
+            }
+            continue;
+        }
+
+        uint32_t mx = mcu % frame.mcusX;
+        uint32_t my = mcu / frame.mcusX;
+        for (int i = 0; i < scan.componentCount; i++) {
+            int c = scan.componentIndex[i];
+            const Component &component = frame.components[c];
+            for (int y = 0; y < component.v; y++) {
+                for (int x = 0; x < component.h; x++) {
+                    if (!DecodeBlockAt(state, frame, scan, c, size_t(mx) * component.h + x, size_t(my) * component.v + y)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Splits the entropy-coded segment at RSTn markers and decodes the intervals in parallel.
+// Returns the position of the marker that ends the scan.
+const uint8_t *DecodeScan(Frame &frame, const Scan &scan, const uint8_t *p, const uint8_t *end, bool &ok) {
+    std::vector<const uint8_t *> starts(1, p);
+    std::vector<const uint8_t *> ends;
+
+    while (true) {
+        p = (const uint8_t *) memchr(p, 0xFF, end - p);
+        if (!p || p + 1 >= end) {
+            p = end;
+            break;
+        }
+        uint8_t marker = p[1];
+        if (marker == 0x00 || marker == 0xFF) {
+            p++;
+            continue;
+        }
+        if (marker >= 0xD0 && marker <= 0xD7) {
+            ends.push_back(p);
+            p += 2;
+            starts.push_back(p);
+            continue;
+        }
+        break;
+    }
+    ends.push_back(p);
+
+    uint32_t mcuCount;
+    if (scan.componentCount == 1) {
+        const Component &component = frame.components[scan.componentIndex[0]];
+        mcuCount = component.widthInBlocks * component.heightInBlocks;
+    } else {
+        mcuCount = frame.mcusX * frame.mcusY;
+    }
+    uint32_t interval = frame.restartInterval ? frame.restartInterval : mcuCount;
+    size_t intervalCount = (std::min<size_t>)(starts.size(), (mcuCount + interval - 1) / interval);
+
+    std::atomic<bool> failed(false);
+    ParallelFor(intervalCount, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last && !failed; i++) {
+            uint32_t mcuBegin = uint32_t(i * interval);
+            uint32_t mcuEnd = (std::min)(mcuCount, mcuBegin + interval);
+            if (!DecodeInterval(frame, scan, starts[i], ends[i], mcuBegin, mcuEnd)) {
+                failed = true;
+            }
+        }
+    });
+
+    ok = !failed;
+    return p;
+}
+
+void ComputeIdctScales(Frame &frame) {
+    for (int c = 0; c < frame.componentCount; c++) {
+        const uint16_t *quant = frame.quant[frame.components[c].tq];
+        for (int i = 0; i < 64; i++) {
+            frame.idctScale[c][i] = quant[i] * AanScale[i >> 3] * AanScale[i & 7] * 0.125f;
+        }
+    }
+}
+
+// Progressive frames are transformed once all scans are in.
+void IdctComponents(Frame &frame) {
+    struct Job {
+        int component;
+        uint32_t blockRow;
+    };
+
+    ComputeIdctScales(frame);
+
+    std::vector<Job> jobs;
+    for (int c = 0; c < frame.componentCount; c++) {
+        for (uint32_t row = 0; row < frame.components[c].blocksPerColumn; row++) {
+            jobs.push_back({ c, row });
+        }
+    }
+
+    ParallelFor(jobs.size(), 4, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Component &component = frame.components[jobs[i].component];
+            size_t stride = size_t(component.blocksPerLine) * 8;
+            const int16_t *coefficients = &component.coefficients[size_t(jobs[i].blockRow) * component.blocksPerLine * 64];
+            uint8_t *out = &component.plane[size_t(jobs[i].blockRow) * 8 * stride];
+            for (uint32_t x = 0; x < component.blocksPerLine; x++) {
+                IdctBlock(coefficients + x * 64, frame.idctScale[jobs[i].component], out + x * 8, stride);
+            }
+        }
+    });
+}
+
+// Color conversion
+
+inline uint8_t ClampInt(int value) {
+    return (uint8_t) (value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+#ifdef JPEG_SSE2
+
+inline void StoreRgba(uint8_t *out, __m128i r, __m128i g, __m128i b, __m128i a) {
+    __m128i rgLo = _mm_unpacklo_epi8(r, g);
+    __m128i rgHi = _mm_unpackhi_epi8(r, g);
+    __m128i baLo = _mm_unpacklo_epi8(b, a);
+    __m128i baHi = _mm_unpackhi_epi8(b, a);
+    _mm_storeu_si128((__m128i *) (out +  0), _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *) (out + 16), _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i *) (out + 32), _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128((__m128i *) (out + 48), _mm_unpackhi_epi16(rgHi, baHi));
+}
+
+// Widens four bytes of a 16-byte vector (quarter q) to floats.
+inline __m128 BytesToFloat(__m128i words, int q) {
+    __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(q & 1 ? _mm_unpackhi_epi16(words, zero) : _mm_unpacklo_epi16(words, zero));
+}
+
+#endif
+
+void YCbCrToRgba(const uint8_t *y, const uint8_t *cb, const uint8_t *cr, uint8_t *out, uint32_t width) {
+    uint32_t x = 0;
+#ifdef JPEG_SSE2
+    const __m128 crToR = _mm_set1_ps(1.402f);
+    const __m128 cbToG = _mm_set1_ps(-0.344136f);
+    const __m128 crToG = _mm_set1_ps(-0.714136f);
+    const __m128 cbToB = _mm_set1_ps(1.772f);
+    const __m128 center = _mm_set1_ps(128.0f);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 16 <= width; x += 16) {
+        __m128i yBytes = _mm_loadu_si128((const __m128i *) (y + x));
+        __m128i cbBytes = _mm_loadu_si128((const __m128i *) (cb + x));
+        __m128i crBytes = _mm_loadu_si128((const __m128i *) (cr + x));
+
+        __m128i r[4], g[4], b[4];
+        for (int q = 0; q < 4; q++) {
+            __m128i yWords = q < 2 ? _mm_unpacklo_epi8(yBytes, zero) : _mm_unpackhi_epi8(yBytes, zero);
+            __m128i cbWords = q < 2 ? _mm_unpacklo_epi8(cbBytes, zero) : _mm_unpackhi_epi8(cbBytes, zero);
+            __m128i crWords = q < 2 ? _mm_unpacklo_epi8(crBytes, zero) : _mm_unpackhi_epi8(crBytes, zero);
+
+            __m128 yf = BytesToFloat(yWords, q);
+            __m128 cbf = _mm_sub_ps(BytesToFloat(cbWords, q), center);
+            __m128 crf = _mm_sub_ps(BytesToFloat(crWords, q), center);
+
+            r[q] = _mm_cvtps_epi32(_mm_add_ps(yf, _mm_mul_ps(crf, crToR)));
+            g[q] = _mm_cvtps_epi32(_mm_add_ps(yf, _mm_add_ps(_mm_mul_ps(cbf, cbToG), _mm_mul_ps(crf, crToG))));
+            b[q] = _mm_cvtps_epi32(_mm_add_ps(yf, _mm_mul_ps(cbf, cbToB)));
+        }
+
+        __m128i rBytes = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]));
+        __m128i gBytes = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), _mm_packs_epi32(g[2], g[3]));
+        __m128i bBytes = _mm_packus_epi16(_mm_packs_epi32(b[0], b[1]), _mm_packs_epi32(b[2], b[3]));
+        StoreRgba(out + x * 4, rBytes, gBytes, bBytes, _mm_set1_epi8(-1));
+    }
+#endif
+    for (; x < width; x++) {
+        float cbf = cb[x] - 128.0f;
+        float crf = cr[x] - 128.0f;
+        out[x * 4 + 0] = ClampInt((int) lrintf(y[x] + crf * 1.402f));
+        out[x * 4 + 1] = ClampInt((int) lrintf(y[x] + cbf * -0.344136f + crf * -0.714136f));
+        out[x * 4 + 2] = ClampInt((int) lrintf(y[x] + cbf * 1.772f));
+        out[x * 4 + 3] = 255;
+    }
+}
+
+void PlanesToRgba(const uint8_t *r, const uint8_t *g, const uint8_t *b, uint8_t *out, uint32_t width) {
+    uint32_t x = 0;
+#ifdef JPEG_SSE2
+    for (; x + 16 <= width; x += 16) {
+        StoreRgba(out + x * 4,
+            _mm_loadu_si128((const __m128i *) (r + x)),
+            _mm_loadu_si128((const __m128i *) (g + x)),
+            _mm_loadu_si128((const __m128i *) (b + x)),
+            _mm_set1_epi8(-1));
+    }
+#endif
+    for (; x < width; x++) {
+        out[x * 4 + 0] = r[x];
+        out[x * 4 + 1] = g[x];
+        out[x * 4 + 2] = b[x];
+        out[x * 4 + 3] = 255;
+    }
+}
+
+// Chroma upsampling like libjpeg's default "fancy" upsampling, with the same rounding, so
+// the output matches what libjpeg and WIC decode: each output sample weighs the nearest
+// source sample 3/4 and the next nearest 1/4, horizontally for hRatio 2 and vertically
+// when neighbor, the source row on the other side of the output row, is given. Edges
+// repeat the outermost sample. Other ratios repeat samples.
+void UpsampleRow(const uint8_t *source, const uint8_t *neighbor, bool lowerRow, uint8_t *row, uint32_t width,
+                 uint32_t sourceWidth, int hRatio) {
+    if (hRatio == 2 && neighbor) {
+        int last = source[0] * 3 + neighbor[0];
+        int current = last;
+        for (uint32_t i = 0, x = 0; i < sourceWidth; i++, x += 2) {
+            int next = i + 1 < sourceWidth ? source[i + 1] * 3 + neighbor[i + 1] : current;
+            row[x] = (uint8_t) ((current * 3 + last + 8) >> 4);
+            if (x + 1 < width) {
+                row[x + 1] = (uint8_t) ((current * 3 + next + 7) >> 4);
+            }
+            last = current;
+            current = next;
+        }
+    } else if (hRatio == 2) {
+        for (uint32_t i = 0, x = 0; i < sourceWidth; i++, x += 2) {
+            int current = source[i] * 3;
+            row[x] = (uint8_t) ((current + source[i ? i - 1 : 0] + 1) >> 2);
+            if (x + 1 < width) {
+                row[x + 1] = (uint8_t) ((current + source[i + 1 < sourceWidth ? i + 1 : i] + 2) >> 2);
+            }
+        }
+    } else if (hRatio == 1 && neighbor) {
+        int bias = lowerRow ? 2 : 1;
+        for (uint32_t x = 0; x < width; x++) {
+            row[x] = (uint8_t) ((source[x] * 3 + neighbor[x] + bias) >> 2);
+        }
+    } else {
+        for (uint32_t x = 0; x < width; x += hRatio) {
+            uint8_t sample = source[x / hRatio];
+            for (int i = 0; i < hRatio && x + i < width; i++) {
+                row[x + i] = sample;
+            }
+        }
+    }
+}
+
+bool ConvertColors(const Frame &frame, uint8_t *pixels, size_t rowPitch) {
+    // Adobe transform 0 or JFIF-less files with 'R','G','B' component ids store RGB directly.
+    bool ycbcr = frame.componentCount == 3;
+    if (ycbcr) {
+        if (frame.adobeTransform == 0) {
+            ycbcr = false;
+        } else if (frame.adobeTransform < 0 &&
+                   frame.components[0].id == 'R' && frame.components[1].id == 'G' && frame.components[2].id == 'B') {
+            ycbcr = false;
+        }
+    }
+
+    ParallelFor(frame.height, 16, [&](size_t begin, size_t end) {
+        std::vector<uint8_t> upsampled(size_t(frame.width) * MaxComponents);
+
+        for (size_t y = begin; y < end; y++) {
+            const uint8_t *rows[MaxComponents];
+            for (int c = 0; c < frame.componentCount; c++) {
+                const Component &component = frame.components[c];
+                size_t stride = size_t(component.blocksPerLine) * 8;
+                const uint8_t *source = &component.plane[(y * component.v / frame.vmax) * stride];
+                if (component.h == frame.hmax && component.v == frame.vmax) {
+                    rows[c] = source;
+                    continue;
+                }
+
+                // The ratios are always integers. The neighbor row is above for the upper
+                // of two output rows and below for the lower one, within the image.
+                int hRatio = frame.hmax / component.h;
+                int vRatio = frame.vmax / component.v;
+                uint32_t sourceWidth = (frame.width * component.h + frame.hmax - 1) / frame.hmax;
+                uint32_t sourceHeight = (frame.height * component.v + frame.vmax - 1) / frame.vmax;
+                const uint8_t *neighbor = nullptr;
+                bool lowerRow = y % 2 != 0;
+                if (vRatio == 2 && hRatio <= 2) {
+                    size_t sourceY = y / 2;
+                    size_t neighborY = lowerRow ? (std::min)(sourceY + 1, size_t(sourceHeight) - 1) : (sourceY ? sourceY - 1 : 0);
+                    neighbor = &component.plane[neighborY * stride];
+                }
+                uint8_t *row = &upsampled[size_t(c) * frame.width];
+                UpsampleRow(source, neighbor, lowerRow, row, frame.width, sourceWidth, hRatio);
+                rows[c] = row;
+            }
+
+            uint8_t *out = pixels + y * rowPitch;
+            if (frame.componentCount == 1) {
+                PlanesToRgba(rows[0], rows[0], rows[0], out, frame.width);
+            } else if (ycbcr) {
+                YCbCrToRgba(rows[0], rows[1], rows[2], out, frame.width);
+            } else {
+                PlanesToRgba(rows[0], rows[1], rows[2], out, frame.width);
+            }
+        }
+    });
+    return true;
+}
+
+// Markers
+
+bool ReadFrameHeader(Frame &frame, const uint8_t *segment, uint32_t length, bool progressive) {
+    if (frame.defined || length < 6) {
+        return false;
+    }
+    if (segment[0] != 8) {
+        return false; // Only 8-bit precision.
+    }
+
+    frame.height = ReadU16(segment + 1);
+    frame.width = ReadU16(segment + 3);
+    frame.componentCount = segment[5];
+    frame.progressive = progressive;
+    if (frame.width == 0 || frame.height == 0) {
+        return false; // DNL is not supported.
+    }
+    if ((frame.componentCount != 1 && frame.componentCount != 3) || length < 6u + frame.componentCount * 3) {
+        return false;
+    }
+
+    frame.hmax = 1;
+    frame.vmax = 1;
+    for (int c = 0; c < frame.componentCount; c++) {
+        const uint8_t *p = segment + 6 + c * 3;
+        Component &component = frame.components[c];
+        component.id = p[0];
+        component.h = p[1] >> 4;
+        component.v = p[1] & 15;
+        component.tq = p[2];
+        if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.tq > 3) {
+            return false;
+        }
+        frame.hmax = (std::max)(frame.hmax, component.h);
+        frame.vmax = (std::max)(frame.vmax, component.v);
+    }
+    if (frame.componentCount == 1) {
+        // A single component is never interleaved, so its sampling factors do not matter.
+        frame.components[0].h = frame.components[0].v = frame.hmax = frame.vmax = 1;
+    }
+
+    frame.mcusX = (frame.width + 8 * frame.hmax - 1) / (8 * frame.hmax);
+    frame.mcusY = (frame.height + 8 * frame.vmax - 1) / (8 * frame.vmax);
+    for (int c = 0; c < frame.componentCount; c++) {
+        Component &component = frame.components[c];
+        if (frame.hmax % component.h || frame.vmax % component.v) {
+            return false; // Fractional sampling ratios are not supported.
+        }
+        uint32_t width = (frame.width * component.h + frame.hmax - 1) / frame.hmax;
+        uint32_t height = (frame.height * component.v + frame.vmax - 1) / frame.vmax;
+        component.widthInBlocks = (width + 7) / 8;
+        component.heightInBlocks = (height + 7) / 8;
+        component.blocksPerLine = frame.mcusX * component.h;
+        component.blocksPerColumn = frame.mcusY * component.v;
+    }
+
+    frame.defined = true;
+    return true;
+}
+
+bool ReadHuffmanTables(Frame &frame, const uint8_t *p, const uint8_t *end) {
+    while (p < end) {
+        if (end - p < 17) {
+            return false;
+        }
+        int tc = p[0] >> 4;
+        int th = p[0] & 15;
+        const uint8_t *counts = p + 1;
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            total += counts[i];
+        }
+        if (tc > 1 || th > 3 || total > 256 || end - p < 17 + total) {
+            return false;
+        }
+        HuffmanTable &table = tc == 0 ? frame.dc[th] : frame.ac[th];
+        if (!BuildHuffmanTable(table, counts, p + 17, total)) {
+            return false;
+        }
+        p += 17 + total;
+    }
+    return true;
+}
+
+bool ReadQuantizationTables(Frame &frame, const uint8_t *p, const uint8_t *end) {
+    while (p < end) {
+        int pq = p[0] >> 4;
+        int tq = p[0] & 15;
+        if (pq > 1 || tq > 3 || end - p < 1 + 64 * (pq + 1)) {
+            return false;
+        }
+        for (int k = 0; k < 64; k++) {
+            frame.quant[tq][ZigZag[k]] = (uint16_t) (pq ? ReadU16(p + 1 + k * 2) : p[1 + k]);
+        }
+        p += 1 + 64 * (pq + 1);
+    }
+    return true;
+}
+
+bool ReadScanHeader(Frame &frame, Scan &scan, const uint8_t *segment, uint32_t length) {
+    if (!frame.defined || length < 1) {
+        return false;
+    }
+    scan.componentCount = segment[0];
+    if (scan.componentCount < 1 || scan.componentCount > frame.componentCount || length < 4u + scan.componentCount * 2) {
+        return false;
+    }
+
+    int blocksPerMcu = 0;
+    for (int i = 0; i < scan.componentCount; i++) {
+        const uint8_t *p = segment + 1 + i * 2;
+        int index = -1;
+        for (int c = 0; c < frame.componentCount; c++) {
+            if (frame.components[c].id == p[0]) {
+                index = c;
+            }
+        }
+        if (index < 0) {
+            return false;
+        }
+        Component &component = frame.components[index];
+        component.td = p[1] >> 4;
+        component.ta = p[1] & 15;
+        if (component.td > 3 || component.ta > 3) {
+            return false;
+        }
+        scan.componentIndex[i] = index;
+        blocksPerMcu += component.h * component.v;
+    }
+    if (scan.componentCount > 1 && blocksPerMcu > 10) {
+        return false;
+    }
+
+    const uint8_t *p = segment + 1 + scan.componentCount * 2;
+    scan.ss = p[0];
+    scan.se = p[1];
+    scan.ah = p[2] >> 4;
+    scan.al = p[2] & 15;
+
+    if (frame.progressive) {
+        if (scan.ss > scan.se || scan.se > 63 || (scan.ss == 0 && scan.se != 0) || (scan.ss > 0 && scan.componentCount != 1) || scan.al > 13) {
+            return false;
+        }
+    } else {
+        scan.ss = 0;
+        scan.se = 63;
+        scan.ah = scan.al = 0;
+    }
+
+    // Check that every table the scan will use has been defined.
+    for (int i = 0; i < scan.componentCount; i++) {
+        const Component &component = frame.components[scan.componentIndex[i]];
+        bool needsDc = scan.ss == 0 && scan.ah == 0;
+        bool needsAc = scan.se > 0;
+        if ((needsDc && !frame.dc[component.td].defined) || (needsAc && !frame.ac[component.ta].defined)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Walks the marker segments. Without decode it stops right after the frame header.
+bool ParseJpeg(const uint8_t *data, size_t size, Frame &frame, bool decode) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    // A file that ends before EOI is truncated: later scans or rows of the last one are
+    // missing, so it fails instead of decoding to a partly gray image.
+    bool scanned = false;
+    const uint8_t *p = data + 2;
+    const uint8_t *end = data + size;
+    while (p < end) {
+        if (*p != 0xFF) {
+            p++; // Tolerate garbage between segments.
+            continue;
+        }
+        while (p < end && *p == 0xFF) {
+            p++;
+        }
+        if (p >= end) {
+            break;
+        }
+        uint8_t marker = *p++;
+
+        if (marker == 0xD9) {
+            return frame.defined && scanned;
+        }
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            continue;
+        }
+
+        if (end - p < 2) {
+            return false;
+        }
+        uint32_t length = ReadU16(p);
+        if (length < 2 || size_t(end - p) < length) {
+            return false;
+        }
+        const uint8_t *segment = p + 2;
+        const uint8_t *segmentEnd = p + length;
+        length -= 2;
+        p = segmentEnd;
+
+        switch (marker) {
+        case 0xC0:
+        case 0xC1:
+        case 0xC2:
+            if (!ReadFrameHeader(frame, segment, length, marker == 0xC2)) {
+                return false;
+            }
+            if (!decode) {
+                return true;
+            }
+            for (int c = 0; c < frame.componentCount; c++) {
+                Component &component = frame.components[c];
+                component.plane.resize(size_t(component.blocksPerLine) * 8 * component.blocksPerColumn * 8);
+                if (frame.progressive) {
+                    component.coefficients.assign(size_t(component.blocksPerLine) * component.blocksPerColumn * 64, 0);
+                }
+            }
+            break;
+        case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB:
+        case 0xCD: case 0xCE: case 0xCF:
+            return false; // Lossless, hierarchical and arithmetic coding.
+        case 0xC4:
+            if (!ReadHuffmanTables(frame, segment, segmentEnd)) {
+                return false;
+            }
+            break;
+        case 0xDB:
+            if (!ReadQuantizationTables(frame, segment, segmentEnd)) {
+                return false;
+            }
+            break;
+        case 0xDD:
+            if (length < 2) {
+                return false;
+            }
+            frame.restartInterval = ReadU16(segment);
+            break;
+        case 0xDA: {
+            Scan scan;
+            if (!ReadScanHeader(frame, scan, segment, length)) {
+                return false;
+            }
+            if (!frame.progressive) {
+                ComputeIdctScales(frame);
+            }
+            bool ok;
+            p = DecodeScan(frame, scan, p, end, ok);
+            if (!ok) {
+                return false;
+            }
+            scanned = true;
+            break;
+        }
+        case 0xEE:
+            if (length >= 12 && memcmp(segment, "Adobe", 5) == 0) {
+                frame.adobeTransform = segment[11];
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+}
+
+bool ReadJpegInfo(const uint8_t *data, size_t size, ImageInfo &info) {
+    Frame frame;
+    if (!ParseJpeg(data, size, frame, false)) {
+        return false;
+    }
+
+    info.format = ImageFormat::Jpeg;
+    info.width = frame.width;
+    info.height = frame.height;
+    info.progressive = frame.progressive;
+    info.channels = (uint32_t) frame.componentCount;
+    return true;
+}
+
+bool DecodeJpeg(const uint8_t *data, size_t size, uint8_t *pixels, size_t rowPitch) {
+    Frame frame;
+    if (!ParseJpeg(data, size, frame, true)) {
+        return false;
+    }
+
+    if (frame.progressive) {
+        IdctComponents(frame);
+    }
+    return ConvertColors(frame, pixels, rowPitch);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ImageDecoder.h"
+
+// Reads the frame header without decoding any scan.
+bool ReadJpegInfo(const uint8_t *data, size_t size, ImageInfo &info);
+
+// Decodes to R8G8B8A8 rows of rowPitch bytes.
+bool DecodeJpeg(const uint8_t *data, size_t size, uint8_t *pixels, size_t rowPitch);
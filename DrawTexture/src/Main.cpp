@@ -1,33 +1,96 @@
 #include <d3d12.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
-#include <DirectXTex.h>
 #include <dxgi1_6.h>
 #include <wrl.h>
 
+#include "BatchMath.h"
+#include "BindlessHeap.h"
+#include "CommandListPool.h"
+#include "CommandStateCache.h"
+#include "ConstantAllocator.h"
+#include "DrawQueue.h"
+#include "FrameArena.h"
+#include "FrameCapture.h"
+#include "FrustumCuller.h"
+#include "GeometryPool.h"
+#include "GoldenTest.h"
+#include "ImageDecoder.h"
+#include "IndirectDraw.h"
+#include "Log.h"
+#include "OverlayAtlas.h"
+#include "OverlayBatch.h"
+#include "PerfHud.h"
+#include "ResidencyManager.h"
+#include "ResolutionScaler.h"
+#include "RootSignatureCache.h"
+#include "ShaderLayout.h"
+#include "ShaderPermutations.h"
+#include "TextureStreamer.h"
+#include "MeshLoader.h"
+#include "MipCache.h"
+#include "Parallel.h"
+#include "QueueScheduler.h"
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 
-inline void ThrowIfFailed(HRESULT hr, LPCWSTR file, int line) {
+inline void ThrowIfFailed(HRESULT hr, const LogSite &site) {
     if (FAILED(hr)) {
-        TCHAR buffer[256];
-        wsprintf(buffer, TEXT("\nFILE:[%s]\nLINE:[%d]\n\n"), file, line);
-        OutputDebugString(buffer);
+        WriteLog(site, hr);
+        FlushLog();
         throw hr;
     }
 }
 
-#define __FILENAME__ (wcsrchr(__FILEW__, TEXT('\\')) ? wcsrchr(__FILEW__, TEXT('\\')) + 1 : __FILEW__)
-#define ThrowIfFailed(hr) ThrowIfFailed(hr, __FILENAME__, __LINE__);
+#define ThrowIfFailed(hr) do { static constexpr LogSite throwSite = { LogLevel::Error, __FILE__, __LINE__, "Failed with %H" }; ThrowIfFailed(hr, throwSite); } while (0)
 
 struct Vertex {
     XMFLOAT3 position;
     XMFLOAT2 uv;
 };
 
+static_assert(sizeof(Vertex) == sizeof(MeshVertex), "Vertex must match the layout written by MeshFile.");
+static_assert(sizeof(XMFLOAT4X4) == sizeof(Matrix4x4), "XMFLOAT4X4 is passed to BatchMath as Matrix4x4.");
+
+// Matches ObjectConstants in Header.hlsli. One per object in a structured buffer indexed by the object ID.
+struct ObjectConstants {
+    XMFLOAT4X4 world;
+    UINT textureIndex;  // Into bindlessHeap.
+};
+
 constexpr UINT Width = 640;
 constexpr UINT Height = 480;
 constexpr UINT FrameCount = 2;
+constexpr UINT GeometryPoolVertexCapacity = 1 << 20;
+constexpr UINT GeometryPoolIndexCapacity = 1 << 21;
+constexpr UINT MaxIndirectDraws = 1 << 16;
+constexpr UINT MaxIndirectBuckets = 16;
+constexpr UINT StreamingMinSize = 4096;  // Images this large in either dimension are streamed per mip.
+constexpr UINT StreamingPoolTiles = 2048; // 64 KB tiles shared by streamed textures (128 MB).
+constexpr const char *TexturePath = "assets/icon.jpg";
+constexpr const char *TextureMipCachePath = "assets/icon.jpg.mips";  // Written by the first run that streams the texture.
+constexpr UINT BindlessHeapCapacity = 4096;
+const UINT MaxCommandLists[QueueCount] = { 8, 4, 4 };  // Pairs per queue type in commandListPool.
+
+// GPU timestamps of every frame: its start, the end of each pass and its end.
+enum GpuTimestamp : UINT {
+    TimestampFrameStart,
+    TimestampSceneEnd,
+    TimestampUpscaleEnd,
+    TimestampOverlayEnd,
+    TimestampFrameEnd,
+    TimestampCount,
+};
+constexpr UINT GpuPassCount = TimestampOverlayEnd;  // Scene, upscale and overlay.
 
 // Win32 objects.
 HINSTANCE hInstance;
@@ -36,37 +99,158 @@ HWND hWindow;
 // Pipeline objects.
 ComPtr<ID3D12Device> device;
 ComPtr<ID3D12CommandQueue> commandQueue;
+QueueScheduler queueScheduler;
 ComPtr<IDXGISwapChain4> swapChain;
 ComPtr<ID3D12DescriptorHeap> rtvHeap;
 UINT rtvDescriptorSize;
 ComPtr<ID3D12Resource> renderTargets[FrameCount];
-ComPtr<ID3D12DescriptorHeap> srvHeap;
-ComPtr<ID3D12CommandAllocator> commandAllocator;
-ComPtr<ID3D12GraphicsCommandList> commandList;
+BindlessHeap bindlessHeap;  // Every SRV; shaders index it with ObjectConstants::textureIndex.
+CommandListPool commandListPool;
+PooledCommandList frameCommands;        // The list of the frame being recorded,
+ID3D12GraphicsCommandList *commandList; // frameCommands.list.
 ComPtr<ID3D12RootSignature> rootSignature;
-ComPtr<ID3D12PipelineState> pipelineState;
-D3D12_VIEWPORT viewport;
+RootSignatureCache rootSignatureCache;
+RootLayout sceneRootLayout;  // Generated from the reflection of the scene shaders.
+UINT textureParameter;       // Root parameter indices in sceneRootLayout.
+UINT objectsParameter;
+UINT drawConstantsParameter;
+ShaderPermutations shaderPermutations;
+ShaderKey shaderKey(SamplingMode::Linear, false);
+ConstantAllocator constantAllocator;
+ComPtr<ID3D12Resource> objectBuffers[FrameCount];  // Per back buffer; the object constants, copied on the copy queue.
+ResidencyHandle objectBufferResidency[FrameCount];
+PooledCommandList copyCommands;
+IndirectDrawBuilder indirectDraws;
+CommandStateCache stateCache;
+DrawQueue drawQueue;
+FrameArenaPool frameArenas;  // CPU data of a frame. Only this thread records the frame, so one arena.
+ResidencyManager residency;
+D3D12_VIEWPORT viewport;   // The scaled render size of the scene.
 D3D12_RECT scissorRect;
 
+// Dynamic resolution. The scene is rendered into the top-left part of sceneTarget, which
+// has the size of the back buffers, and then upscaled to the back buffer.
+ComPtr<ID3D12Resource> sceneTarget;
+ResidencyHandle sceneTargetResidency;
+UINT sceneTargetSrv;
+ComPtr<ID3D12RootSignature> upscaleRootSignature;
+RootLayout upscaleRootLayout;
+UINT sceneParameter;         // Root parameter indices in upscaleRootLayout.
+UINT upscaleConstantsParameter;
+ShaderPermutations upscalePermutations;
+ResolutionScaler resolutionScaler;
+float renderScales[FrameCount] = { };  // Scale of the last frame on each back buffer.
+ComPtr<ID3D12QueryHeap> timestampHeap;
+ComPtr<ID3D12Resource> timestampReadback;
+UINT64 timestampFrequency;
+bool timestampsWritten[FrameCount] = { };  // Per back buffer; each frame has its own range of queries.
+
+// Performance HUD, toggled with H. It is drawn over the back buffer with one draw, from
+// quads in constant memory and a glyph atlas in bindlessHeap.
+ComPtr<ID3D12RootSignature> overlayRootSignature;
+RootLayout overlayRootLayout;
+UINT overlayQuadsParameter;  // Root parameter indices in overlayRootLayout.
+UINT overlayConstantsParameter;
+UINT overlayAtlasParameter;
+ShaderPermutations overlayPermutations;
+OverlayAtlas overlayAtlas;
+UINT overlayAtlasSrv;
+OverlayBatch overlayBatch;
+PerfHud perfHud;
+PerfHudCounters hudCounters = { };  // Of the last frame; shown with its GPU times.
+std::chrono::steady_clock::time_point lastFrameStart;
+bool hudVisible = false;  // Toggled with H.
+
+// Captures of the back buffer: C saves a screenshot, R starts and stops writing every frame.
+FrameCapture frameCapture;
+bool screenshotRequested = false;
+bool recordingFrames = false;
+UINT screenshotCount = 0;
+UINT recordedFrameCount = 0;
+
+// Golden image tests (-golden <config>): the scene is rendered with the window hidden and
+// compared with stored images, see GoldenTest.h. -warp selects the WARP adapter, whose
+// output does not depend on the GPU or its driver. -golden-create saves missing golden images
+// from the rendered ones, to be reviewed before they are committed.
+bool useWarpAdapter = false;
+bool createMissingGoldens = false;
+UINT syncInterval = 1;
+std::string goldenCapturePath;  // The next frame is saved here when set.
+
 // Resources.
-ComPtr<ID3D12Resource> vertexBuffer;
-ComPtr<ID3D12Resource> indexBuffer;
-D3D12_VERTEX_BUFFER_VIEW vbView;
-D3D12_INDEX_BUFFER_VIEW ibView;
+GeometryPool geometryPool;
+MeshHandle quadMesh;
+TransformSoA quadTransforms;
+std::vector<XMFLOAT4X4> quadWorlds;
+BoundsSoA quadLocalBounds;
+BoundsSoA quadBounds;
+SphereSoA quadSpheres;
+std::vector<UINT32> quadBatchIds;
+FrustumCuller culler;
 ComPtr<ID3D12Resource> texture;
+ResidencyHandle textureResidency;
+UINT textureSrv;
+std::vector<UINT> quadTextures;  // SRV index of each quad.
+TextureStreamer textureStreamer;
+StreamingHandle streamedTexture = MipStreamingPolicy::InvalidHandle;
+MipCache textureMipCache;  // Mip chain of a streamed texture, read by its loader.
+
+// Intermediate results passed between the startup tasks, released once startup is done.
+struct StartupData {
+    ComPtr<IDXGIFactory4> factory;
+    ComPtr<ID3D12Resource> meshUploadHeap;
+    ComPtr<ID3D12Resource> textureUploadHeap;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT textureLayout;
+    BYTE *texturePixels;  // The texture's footprint in the mapped upload heap.
+    std::unique_ptr<ImageDecoder> textureDecoder;
+    ImageInfo imageInfo;
+    PixelFormat pixelFormat;
+    bool streamed;
+};
+StartupData startup;
 
 // Synchronization objects.
 ComPtr<ID3D12Fence> fence;
 UINT64 fenceValue;
+UINT64 frameFenceValues[FrameCount] = { };  // Signaled after the last frame that used each back buffer.
 HANDLE fenceEvent;
 UINT frameIndex;
 
+std::vector<std::string> SplitCommandLine(const char *commandLine);
+bool RunStartup();
+int RunGoldenTests(const char *configPath);
+void LogStartupTimeline(const TaskGraph &graph);
 HRESULT InitWindow();
-HRESULT InitDirectX();
-HRESULT InitResource();
+HRESULT InitDevice();
+HRESULT InitSwapChain();
+HRESULT InitSceneTarget();
+HRESULT InitCommands();
+HRESULT InitRootSignatures();
+std::vector<ShaderKey> GetSceneShaderKeys();
+UINT GetShaderCompileFlags();
+HRESULT CompileSceneShaders();
+HRESULT CompileUpscaleShaders();
+HRESULT CompileOverlayShaders();
+HRESULT InitScenePipelines();
+HRESULT InitUpscalePipeline();
+HRESULT InitOverlayPipeline();
+HRESULT InitOverlayAtlas();
+HRESULT InitMesh();
+HRESULT OpenTexture();
+HRESULT InitTexture();
+HRESULT DecodeTexture();
+HRESULT InitStreamedTexture();
+HRESULT UploadResources();
 void OnUpdate();
+void ShowCullStats();
+double ReadGpuFrameTime(UINT frame, float *passTimes = nullptr);
+void UpdateRenderScale(float gpuTime);
 void OnRender();
-void WaitForPrevFrame();
+void AddDrawPackets();
+void DrawOverlay();
+void WaitForFrame();
+void WaitForGpu();
+void WaitForFence(UINT64 value);
 D3D12_BLEND_DESC GetDefaultBlendDesc();
 D3D12_RASTERIZER_DESC GetDefaultRasterizerDesc();
 D3D12_RESOURCE_DESC &GetBufferResourceDesc(
@@ -81,24 +265,36 @@ D3D12_RESOURCE_BARRIER &GetTransitionBarrier(
     D3D12_RESOURCE_STATES after,
     UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
     D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE);
-HRESULT LoadImageFromFile(LPCTSTR file, TexMetadata &metadata, Image &image);
+DXGI_FORMAT GetDxgiFormat(PixelFormat format);
+UINT GetShaderComponentMapping(PixelFormat format);
 LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In_ int nCmdShow) {
+int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR lpCmdLine, _In_ int nCmdShow) {
     MSG msg = { };
 
     ::hInstance = hInstance;
 
-    if (FAILED(InitWindow())) {
-        return -10;
+    std::string goldenConfig;
+    std::vector<std::string> arguments = SplitCommandLine(lpCmdLine);
+    for (size_t i = 0; i < arguments.size(); i++) {
+        if (arguments[i] == "-golden" && i + 1 < arguments.size()) {
+            goldenConfig = arguments[++i];
+        } else if (arguments[i] == "-warp") {
+            useWarpAdapter = true;
+        } else if (arguments[i] == "-golden-create") {
+            createMissingGoldens = true;
+        }
     }
 
-    if (FAILED(InitDirectX())) {
-        return -11;
+    StartLog("DrawTexture.log");
+
+    if (!RunStartup()) {
+        return -10;
     }
 
-    if (FAILED(InitResource())) {
-        return -12;
+    // The exit code is the number of tests that did not pass.
+    if (!goldenConfig.empty()) {
+        return RunGoldenTests(goldenConfig.c_str());
     }
 
     ShowWindow(hWindow, nCmdShow);
@@ -107,9 +303,171 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In
         DispatchMessage(&msg);
     }
 
+    // Wait for the frames in flight, then write the captures still in the ring.
+    WaitForGpu();
+    frameCapture.Flush(fence->GetCompletedValue());
+
+    CommandListStats commandListStats = commandListPool.GetStats();
+    LogInfo("Command lists: %u created, %u reused, %u waits for a free list",
+        (UINT) commandListStats.createdCount, (UINT) commandListStats.reusedCount, (UINT) commandListStats.exhaustedCount);
+
     return (int) msg.wParam;
 }
 
+// Splits at spaces outside double quotes.
+std::vector<std::string> SplitCommandLine(const char *commandLine) {
+    std::vector<std::string> arguments;
+    std::string argument;
+    bool quoted = false;
+    bool pending = false;
+    for (const char *p = commandLine; *p; p++) {
+        if (*p == '"') {
+            quoted = !quoted;
+            pending = true;
+        } else if ((*p == ' ' || *p == '\t') && !quoted) {
+            if (pending) {
+                arguments.push_back(argument);
+                argument.clear();
+                pending = false;
+            }
+        } else {
+            argument += *p;
+            pending = true;
+        }
+    }
+    if (pending) {
+        arguments.push_back(argument);
+    }
+    return arguments;
+}
+
+// Startup as a task graph. Device creation, shader compilation and reading the image
+// header overlap; the image is decoded into its upload heap alongside mesh loading once
+// the device exists, and the GPU uploads are joined at the end. The window and its swap
+// chain are created on this thread, which owns the window's messages.
+bool RunStartup() {
+    auto task = [](HRESULT (*init)()) {
+        return [init]() { return SUCCEEDED(init()); };
+    };
+
+    TaskGraph graph;
+    TaskHandle deviceTask = graph.Add("Device", task(InitDevice));
+    TaskHandle sceneShadersTask = graph.Add("Scene shaders", task(CompileSceneShaders));
+    TaskHandle upscaleShadersTask = graph.Add("Upscale shaders", task(CompileUpscaleShaders));
+    TaskHandle overlayShadersTask = graph.Add("Overlay shaders", task(CompileOverlayShaders));
+    TaskHandle textureHeaderTask = graph.Add("Texture header", task(OpenTexture));
+    TaskHandle windowTask = graph.Add("Window", task(InitWindow), { }, TaskThread::Main);
+    TaskHandle swapChainTask = graph.Add("Swap chain", task(InitSwapChain), { windowTask, deviceTask }, TaskThread::Main);
+    TaskHandle sceneTargetTask = graph.Add("Scene target", task(InitSceneTarget), { deviceTask });
+    TaskHandle commandsTask = graph.Add("Commands", task(InitCommands), { deviceTask });
+    TaskHandle rootSignaturesTask = graph.Add("Root signatures", task(InitRootSignatures), { deviceTask, sceneShadersTask, upscaleShadersTask, overlayShadersTask });
+    graph.Add("Scene pipelines", task(InitScenePipelines), { rootSignaturesTask });
+    graph.Add("Upscale pipeline", task(InitUpscalePipeline), { rootSignaturesTask });
+    graph.Add("Overlay pipeline", task(InitOverlayPipeline), { rootSignaturesTask });
+    TaskHandle meshTask = graph.Add("Mesh", task(InitMesh), { deviceTask });
+    TaskHandle textureTask = graph.Add("Texture", task(InitTexture), { deviceTask, textureHeaderTask });
+    TaskHandle decodeTask = graph.Add("Texture decode", task(DecodeTexture), { textureTask });
+    TaskHandle overlayAtlasTask = graph.Add("Overlay atlas", task(InitOverlayAtlas), { deviceTask });
+    graph.Add("Upload", task(UploadResources), { swapChainTask, sceneTargetTask, commandsTask, meshTask, decodeTask, overlayAtlasTask });
+
+    bool succeeded = graph.Run((std::min)(GetWorkerCount(), graph.GetTaskCount()) - 1);
+    LogStartupTimeline(graph);
+
+    startup = StartupData();
+    return succeeded;
+}
+
+// Each test renders its warmup frames, then its measured frames at full resolution, and
+// compares the last frame with its golden image. Images, diffs and report.txt are written
+// to golden_output. Returns the number of tests that did not pass.
+int RunGoldenTests(const char *configPath) {
+    std::vector<GoldenTest> tests;
+    if (!LoadGoldenTests(configPath, tests)) {
+        return -11;
+    }
+
+    // Dynamic resolution would make the images depend on the speed of the GPU, and vsync
+    // would hide the frame time.
+    ResolutionScalerSettings settings;
+    settings.minScale = 1.0f;
+    settings.maxScale = 1.0f;
+    resolutionScaler.Reset(settings);
+    syncInterval = 0;
+    // The HUD shows timings, which differ on every run.
+    hudVisible = false;
+
+    const char *outputDir = "golden_output";
+    CreateDirectoryA(outputDir, nullptr);
+
+    std::vector<GoldenResult> results;
+    int failedCount = 0;
+    for (const GoldenTest &test : tests) {
+        shaderKey = ShaderKey(test.pointSampling ? SamplingMode::Point : SamplingMode::Linear, false);
+        for (UINT i = 0; i < test.warmupFrames; i++) {
+            OnUpdate();
+            OnRender();
+        }
+
+        // OnRender() waits for its frame, so the GPU time can be read right after it.
+        std::string actualPath = std::string(outputDir) + "/" + test.name + ".png";
+        DeleteFileA(actualPath.c_str());
+        double cpuTime = 0.0;
+        double gpuTime = 0.0;
+        for (UINT i = 0; i < test.measuredFrames; i++) {
+            if (i + 1 == test.measuredFrames) {
+                goldenCapturePath = actualPath;
+            }
+            auto start = std::chrono::steady_clock::now();
+            OnUpdate();
+            OnRender();
+            cpuTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            // Golden frames run one at a time, so every frame has its GPU time.
+            WaitForGpu();
+            gpuTime += ReadGpuFrameTime(frameIndex);
+        }
+        frameCapture.Flush(fence->GetCompletedValue());
+
+        GoldenResult result = CheckGolden(test, actualPath.c_str(), outputDir, cpuTime / test.measuredFrames, gpuTime / test.measuredFrames,
+                                          createMissingGoldens);
+        const ImageComparison &comparison = result.comparison;
+        LogInfo("Golden %s: %s, PSNR %.2f dB, SSIM %.5f, max difference %u, %.4f%% over tolerance, %.3f ms CPU, %.3f ms GPU",
+            test.name.c_str(), GetGoldenStatusName(result.status), comparison.psnr, comparison.ssim, comparison.maxDifference,
+            comparison.exceedFraction * 100.0, result.cpuFrameTime, result.gpuFrameTime);
+        failedCount += result.status == GoldenStatus::Passed ? 0 : 1;
+        results.push_back(result);
+    }
+
+    WriteGoldenReport("golden_output/report.txt", tests, results);
+    LogInfo("Golden tests: %u of %u passed", (UINT) (tests.size() - failedCount), (UINT) tests.size());
+    return failedCount;
+}
+
+void LogStartupTimeline(const TaskGraph &graph) {
+    std::vector<TaskHandle> criticalPath = graph.GetCriticalPath();
+    std::string pathNames;
+    for (TaskHandle handle : criticalPath) {
+        pathNames += pathNames.empty() ? "" : " > ";
+        pathNames += graph.GetName(handle);
+    }
+
+    double taskTime = 0.0;
+    for (TaskHandle handle = 0; handle < graph.GetTaskCount(); handle++) {
+        const TaskTiming &timing = graph.GetTiming(handle);
+        taskTime += timing.start >= 0.0 ? timing.end - timing.start : 0.0;
+    }
+
+    LogInfo("Startup: %.1f ms (%.1f ms of tasks), critical path: %s", graph.GetTotalTime(), taskTime, pathNames.c_str());
+    for (TaskHandle handle = 0; handle < graph.GetTaskCount(); handle++) {
+        const TaskTiming &timing = graph.GetTiming(handle);
+        if (timing.start < 0.0) {
+            LogInfo("  %s: not run", graph.GetName(handle));
+            continue;
+        }
+        bool critical = std::find(criticalPath.begin(), criticalPath.end(), handle) != criticalPath.end();
+        LogInfo("  %s%s: %.1f - %.1f ms on thread %u", critical ? "* " : "", graph.GetName(handle), timing.start, timing.end, timing.thread);
+    }
+}
+
 HRESULT InitWindow() {
     LPCTSTR WindowClassName = TEXT("WindowClass");
     WNDCLASS wc;
@@ -158,7 +516,7 @@ HRESULT InitWindow() {
     return S_OK;
 }
 
-HRESULT InitDirectX() {
+HRESULT InitDevice() {
     UINT factoryFlags = 0;
 
 #ifdef _DEBUG
@@ -171,18 +529,20 @@ HRESULT InitDirectX() {
     }
 #endif
 
-    ComPtr<IDXGIFactory4> factory4;
-    ThrowIfFailed(CreateDXGIFactory2(factoryFlags, IID_PPV_ARGS(&factory4)));
+    ThrowIfFailed(CreateDXGIFactory2(factoryFlags, IID_PPV_ARGS(&startup.factory)));
 
     ComPtr<IDXGIAdapter1> adapter;
     ComPtr<IDXGIFactory6> factory6;
-    if (SUCCEEDED(factory4->QueryInterface(IID_PPV_ARGS(&factory6)))) {
+    if (useWarpAdapter) {
+        ThrowIfFailed(startup.factory->EnumWarpAdapter(IID_PPV_ARGS(&adapter)));
+    } else if (SUCCEEDED(startup.factory->QueryInterface(IID_PPV_ARGS(&factory6)))) {
         factory6->EnumAdapterByGpuPreference(0, DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&adapter));
     } else {
-        factory4->EnumAdapters1(0, &adapter);
+        startup.factory->EnumAdapters1(0, &adapter);
     }
 
     ThrowIfFailed(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device)));
+    ThrowIfFailed(residency.Init(device.Get(), adapter.Get()));
 
     // Command Queue
     {
@@ -192,8 +552,40 @@ HRESULT InitDirectX() {
         desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
         desc.NodeMask = 0;
         ThrowIfFailed(device->CreateCommandQueue(&desc, IID_PPV_ARGS(&commandQueue)));
+
+        // Compute and copy queues next to it, submitted through the scheduler.
+        ThrowIfFailed(queueScheduler.Init(device.Get(), commandQueue.Get()));
+    }
+
+    // Descriptor Heap for RTV
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc;
+        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        desc.NumDescriptors = FrameCount + 1; // The last one is the scene target's.
+        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        desc.NodeMask = 0;
+
+        ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&rtvHeap)));
+
+        rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(desc.Type);
     }
 
+    // Bindless SRV heap. The indices of the views created by other startup tasks are
+    // reserved here, so those tasks only write descriptors and can run in parallel.
+    {
+        ThrowIfFailed(bindlessHeap.Init(device.Get(), BindlessHeapCapacity));
+        textureSrv = bindlessHeap.Allocate();
+        sceneTargetSrv = bindlessHeap.Allocate();
+        overlayAtlasSrv = bindlessHeap.Allocate();
+
+        LogInfo("Bindless heap: %u descriptors, resource binding tier %d",
+            bindlessHeap.GetAllocator().GetCapacity(), int(bindlessHeap.GetBindingTier()));
+    }
+
+    return S_OK;
+}
+
+HRESULT InitSwapChain() {
     // Swap Chain
     {
         DXGI_SWAP_CHAIN_DESC1 desc;
@@ -211,7 +603,7 @@ HRESULT InitDirectX() {
         desc.Flags = 0;
 
         ComPtr<IDXGISwapChain1> swapChain1;
-        ThrowIfFailed(factory4->CreateSwapChainForHwnd(
+        ThrowIfFailed(startup.factory->CreateSwapChainForHwnd(
             commandQueue.Get(),
             hWindow,
             &desc,
@@ -224,19 +616,6 @@ HRESULT InitDirectX() {
         frameIndex = swapChain->GetCurrentBackBufferIndex();
     }
 
-    // Descriptor Heap for RTV
-    {
-        D3D12_DESCRIPTOR_HEAP_DESC desc;
-        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-        desc.NumDescriptors = FrameCount;
-        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        desc.NodeMask = 0;
-
-        ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&rtvHeap)));
-
-        rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(desc.Type);
-    }
-
     // Render Target View (RTV)
     {
         D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
@@ -249,110 +628,55 @@ HRESULT InitDirectX() {
         }
     }
 
-    // Descriptor Heap for SRV
-    {
-        D3D12_DESCRIPTOR_HEAP_DESC desc;
-        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        desc.NumDescriptors = 1;
-        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        desc.NodeMask = 0;
-
-        ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&srvHeap)));
-    }
-
-    // Command Allocator
-    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
-
-    // Command List
-    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList)));
-    ThrowIfFailed(commandList->Close());
+    // Frame Capture. A buffer per frame in flight and one more, so a capture per frame never waits.
+    ThrowIfFailed(frameCapture.Init(device.Get(), renderTargets[0]->GetDesc(), FrameCount + 1, 2));
 
-    // Root Signature
-    {
-        D3D12_DESCRIPTOR_RANGE ranges[1];
-        ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-        ranges[0].NumDescriptors = 1;
-        ranges[0].BaseShaderRegister = 0;
-        ranges[0].RegisterSpace = 0;
-        ranges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-
-        D3D12_ROOT_PARAMETER rootParameters[1];
-        rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-        rootParameters[0].DescriptorTable.NumDescriptorRanges = _countof(ranges);
-        rootParameters[0].DescriptorTable.pDescriptorRanges = ranges;
-        rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-
-        D3D12_STATIC_SAMPLER_DESC samplers[1];
-        samplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR; // `ԂpăeNX`tB^O
-        samplers[0].AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-        samplers[0].AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-        samplers[0].AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-        samplers[0].MipLODBias = 0;
-        samplers[0].MaxAnisotropy = 0;
-        samplers[0].ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
-        samplers[0].BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK; // ADDRESS_MODE(AddressU, etc.)  BORDER ł͂Ȃ̂ŎgpȂ
-        samplers[0].MinLOD = 0.0f;
-        samplers[0].MaxLOD = D3D12_FLOAT32_MAX;
-        samplers[0].ShaderRegister = 0;
-        samplers[0].RegisterSpace = 0;
-        samplers[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-
-        D3D12_ROOT_SIGNATURE_DESC desc;
-        desc.NumParameters = _countof(rootParameters);
-        desc.pParameters = rootParameters;
-        desc.NumStaticSamplers = _countof(samplers);
-        desc.pStaticSamplers = samplers;
-        desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
-
-        ComPtr<ID3DBlob> rsBlob;
-        ThrowIfFailed(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1_0, &rsBlob, nullptr));
-        ThrowIfFailed(device->CreateRootSignature(0, rsBlob->GetBufferPointer(), rsBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
-    }
+    return S_OK;
+}
 
-    // Pipeline State
+HRESULT InitSceneTarget() {
+    // Scene Target. Allocated at the full size once; the scale only changes the viewport.
     {
-        ComPtr<ID3DBlob> vsBlob;
-        ComPtr<ID3DBlob> psBlob;
-        UINT compileFlags = 0;
+        D3D12_HEAP_PROPERTIES properties;
+        properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
+        properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        properties.CreationNodeMask     = 0;
+        properties.VisibleNodeMask      = 0;
 
-#ifdef _DEBUG
-        compileFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+        D3D12_RESOURCE_DESC desc;
+        desc.Dimension          = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        desc.Alignment          = 0;
+        desc.Width              = Width;
+        desc.Height             = Height;
+        desc.DepthOrArraySize   = 1;
+        desc.MipLevels          = 1;
+        desc.Format             = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count   = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Layout             = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+        desc.Flags              = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
 
-        ThrowIfFailed(D3DCompileFromFile(TEXT("src/VertexShader.hlsl"), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "Main", "vs_5_0", compileFlags, 0, &vsBlob, nullptr));
-        ThrowIfFailed(D3DCompileFromFile(TEXT("src/PixelShader.hlsl"), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "Main", "ps_5_0", compileFlags, 0, &psBlob, nullptr));
+        D3D12_CLEAR_VALUE clearValue;
+        clearValue.Format   = desc.Format;
+        clearValue.Color[0] = 0.5f;
+        clearValue.Color[1] = 0.5f;
+        clearValue.Color[2] = 0.5f;
+        clearValue.Color[3] = 1.0f;
 
-        D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        };
+        ThrowIfFailed(device->CreateCommittedResource(
+            &properties,
+            D3D12_HEAP_FLAG_NONE,
+            &desc,
+            D3D12_RESOURCE_STATE_RENDER_TARGET,
+            &clearValue,
+            IID_PPV_ARGS(&sceneTarget)));
 
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
-        desc.pRootSignature = rootSignature.Get();
-        desc.VS = { vsBlob->GetBufferPointer(), vsBlob->GetBufferSize() };
-        desc.PS = { psBlob->GetBufferPointer(), psBlob->GetBufferSize() };
-        desc.DS = { };
-        desc.HS = { };
-        desc.GS = { };
-        desc.StreamOutput = { };
-        desc.BlendState = GetDefaultBlendDesc();
-        desc.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
-        desc.RasterizerState = GetDefaultRasterizerDesc();
-        desc.DepthStencilState = { };
-        desc.InputLayout = { inputLayout, _countof(inputLayout) };
-        desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
-        desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-        desc.NumRenderTargets = 1;
-        for (DXGI_FORMAT &format : desc.RTVFormats) { format = DXGI_FORMAT_UNKNOWN; }
-        desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-        desc.DSVFormat = { };
-        desc.SampleDesc.Count = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.NodeMask = 0;
-        desc.CachedPSO = { };
-        desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+        D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
+        rtvHandle.ptr += SIZE_T(rtvDescriptorSize) * FrameCount;
+        device->CreateRenderTargetView(sceneTarget.Get(), nullptr, rtvHandle);
 
-        ThrowIfFailed(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+        device->CreateShaderResourceView(sceneTarget.Get(), nullptr, bindlessHeap.GetCpuHandle(sceneTargetSrv));
     }
 
     // Viewport & Scissor Rect
@@ -369,6 +693,13 @@ HRESULT InitDirectX() {
         scissorRect.right = Width;
         scissorRect.bottom = Height;
     }
+    return S_OK;
+}
+
+HRESULT InitCommands() {
+    // Constant Allocator
+    ThrowIfFailed(constantAllocator.Init(device.Get()));
+    frameArenas.Init(1);
 
     // Fence
     ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
@@ -378,55 +709,343 @@ HRESULT InitDirectX() {
         ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
     }
 
-    return S_OK;
-}
+    // Command lists for any thread. Graphics lists are retired by the frame fence, the
+    // others by the fences of the queues the scheduler signals.
+    ID3D12Fence *listFences[QueueCount] = { fence.Get(), queueScheduler.GetFence(QueueType::Compute), queueScheduler.GetFence(QueueType::Copy) };
+    ThrowIfFailed(commandListPool.Init(device.Get(), listFences, MaxCommandLists));
 
-HRESULT InitResource() {
-    // Vertex Buffer
+    // Timestamps around the passes of every frame, read back for the resolution scaler and the HUD.
     {
-        Vertex vertices[] = {
-            { { -0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f } }, // 
-            { { -0.5f,  0.5f, 0.0f }, { 0.0f, 0.0f } }, // 
-            { {  0.5f, -0.5f, 0.0f }, { 1.0f, 1.0f } }, // E
-            { {  0.5f,  0.5f, 0.0f }, { 1.0f, 0.0f } }, // E
-        };
+        D3D12_QUERY_HEAP_DESC desc;
+        desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        desc.Count = TimestampCount * FrameCount;
+        desc.NodeMask = 0;
+
+        ThrowIfFailed(device->CreateQueryHeap(&desc, IID_PPV_ARGS(&timestampHeap)));
 
         D3D12_HEAP_PROPERTIES properties;
-        properties.Type                 = D3D12_HEAP_TYPE_UPLOAD;
+        properties.Type                 = D3D12_HEAP_TYPE_READBACK;
         properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
         properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
         properties.CreationNodeMask     = 0;
         properties.VisibleNodeMask      = 0;
 
-        D3D12_RESOURCE_DESC desc;
-
+        D3D12_RESOURCE_DESC bufferDesc;
         ThrowIfFailed(device->CreateCommittedResource(
             &properties,
             D3D12_HEAP_FLAG_NONE,
-            &GetBufferResourceDesc(desc, sizeof(vertices)),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
+            &GetBufferResourceDesc(bufferDesc, TimestampCount * FrameCount * sizeof(UINT64)),
+            D3D12_RESOURCE_STATE_COPY_DEST,
             nullptr,
-            IID_PPV_ARGS(&vertexBuffer)
-        ));
+            IID_PPV_ARGS(&timestampReadback)));
 
-        void *buffer;
-        ThrowIfFailed(vertexBuffer->Map(0, nullptr, &buffer));
-        memcpy(buffer, vertices, sizeof(vertices));
-        vertexBuffer->Unmap(0, nullptr);
+        ThrowIfFailed(commandQueue->GetTimestampFrequency(&timestampFrequency));
+        perfHud.SetPasses({ "scene", "upscale", "overlay" });
+    }
+    return S_OK;
+}
+
+// Root signatures are generated from the reflection of the compiled shaders, so they
+// follow Header.hlsli and Upscale.hlsli without hand-written copies.
+HRESULT InitRootSignatures() {
+    // Static samplers, referenced by name below. Registers and visibility come from the shaders.
+    D3D12_STATIC_SAMPLER_DESC samplers[3];
+    samplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR; // `ԂpăeNX`tB^O
+    samplers[0].AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+    samplers[0].AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+    samplers[0].AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+    samplers[0].MipLODBias = 0;
+    samplers[0].MaxAnisotropy = 0;
+    samplers[0].ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+    samplers[0].BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK; // ADDRESS_MODE(AddressU, etc.)  BORDER ł͂Ȃ̂ŎgpȂ
+    samplers[0].MinLOD = 0.0f;
+    samplers[0].MaxLOD = D3D12_FLOAT32_MAX;
+
+    // Point sampling for the SAMPLING_POINT shader variants.
+    samplers[1] = samplers[0];
+    samplers[1].Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+
+    // Clamped, so the edge of the scene is not blended with the opposite one.
+    samplers[2] = samplers[0];
+    samplers[2].AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplers[2].AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    samplers[2].AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+
+    ThrowIfFailed(rootSignatureCache.Init(device.Get(), { std::begin(samplers), std::end(samplers) }));
+
+    // Scene. The bindings of all variants are merged, so the variants share one root signature.
+    {
+        ShaderReflectionData vertex = { ShaderStage::Vertex };
+        ShaderReflectionData pixel = { ShaderStage::Pixel };
+        for (ShaderKey key : GetSceneShaderKeys()) {
+            ShaderReflectionData reflection;
+            ThrowIfFailed(ReflectShader(shaderPermutations.GetVertexShader(key), ShaderStage::Vertex, reflection));
+            MergeReflection(reflection, vertex);
+            ThrowIfFailed(ReflectShader(shaderPermutations.GetPixelShader(key), ShaderStage::Pixel, reflection));
+            MergeReflection(reflection, pixel);
+        }
+
+        RootLayoutOptions options;
+        options.staticSamplers = { { "g_sampler", 0 }, { "g_pointSampler", 1 } };
+        // The bindless table covers views that are created and freed while frames are in flight.
+        options.flags = { { "g_textures", DescriptorFlags::DescriptorsVolatile | DescriptorFlags::DataStaticWhileSetAtExecute } };
+        if (!sceneRootLayout.Build({ vertex, pixel }, options)) {
+            return E_FAIL;
+        }
+        ThrowIfFailed(rootSignatureCache.Get(sceneRootLayout, rootSignature));
+
+        textureParameter = sceneRootLayout.FindParameter("g_textures");
+        objectsParameter = sceneRootLayout.FindParameter("g_objects");
+        drawConstantsParameter = sceneRootLayout.FindParameter("DrawConstants");
+        if (textureParameter == RootLayout::InvalidIndex || objectsParameter == RootLayout::InvalidIndex ||
+            drawConstantsParameter == RootLayout::InvalidIndex) {
+            return E_FAIL;
+        }
+    }
+
+    // Upscale
+    {
+        ShaderReflectionData vertex, pixel;
+        ThrowIfFailed(ReflectShader(upscalePermutations.GetVertexShader(ShaderKey()), ShaderStage::Vertex, vertex));
+        ThrowIfFailed(ReflectShader(upscalePermutations.GetPixelShader(ShaderKey()), ShaderStage::Pixel, pixel));
+
+        RootLayoutOptions options;
+        options.staticSamplers = { { "g_sampler", 2 } };
+        if (!upscaleRootLayout.Build({ vertex, pixel }, options)) {
+            return E_FAIL;
+        }
+        ThrowIfFailed(rootSignatureCache.Get(upscaleRootLayout, upscaleRootSignature));
+
+        sceneParameter = upscaleRootLayout.FindParameter("g_scene");
+        upscaleConstantsParameter = upscaleRootLayout.FindParameter("UpscaleConstants");
+        if (sceneParameter == RootLayout::InvalidIndex || upscaleConstantsParameter == RootLayout::InvalidIndex) {
+            return E_FAIL;
+        }
+    }
+
+    // Overlay
+    {
+        ShaderReflectionData vertex, pixel;
+        ThrowIfFailed(ReflectShader(overlayPermutations.GetVertexShader(ShaderKey()), ShaderStage::Vertex, vertex));
+        ThrowIfFailed(ReflectShader(overlayPermutations.GetPixelShader(ShaderKey()), ShaderStage::Pixel, pixel));
+
+        RootLayoutOptions options;
+        options.staticSamplers = { { "g_sampler", 1 } };
+        if (!overlayRootLayout.Build({ vertex, pixel }, options)) {
+            return E_FAIL;
+        }
+        ThrowIfFailed(rootSignatureCache.Get(overlayRootLayout, overlayRootSignature));
+
+        overlayQuadsParameter = overlayRootLayout.FindParameter("g_quads");
+        overlayConstantsParameter = overlayRootLayout.FindParameter("OverlayConstants");
+        overlayAtlasParameter = overlayRootLayout.FindParameter("g_atlas");
+        if (overlayQuadsParameter == RootLayout::InvalidIndex || overlayConstantsParameter == RootLayout::InvalidIndex ||
+            overlayAtlasParameter == RootLayout::InvalidIndex) {
+            return E_FAIL;
+        }
+    }
 
-        // Vertex Buffer View
-        vbView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
-        vbView.SizeInBytes = sizeof(vertices);
-        vbView.StrideInBytes = sizeof(Vertex);
+    LogInfo("Root signatures: %u for %u layouts, version 1.%u", rootSignatureCache.GetCount(), rootSignatureCache.GetRequestCount(),
+        rootSignatureCache.GetVersion() == D3D_ROOT_SIGNATURE_VERSION_1_0 ? 0u : 1u);
+
+    return S_OK;
+}
+
+// Variants used by this sample: both sampling modes, with and without alpha test.
+std::vector<ShaderKey> GetSceneShaderKeys() {
+    std::vector<ShaderKey> keys;
+    for (SamplingMode sampling : { SamplingMode::Linear, SamplingMode::Point }) {
+        for (bool alphaTest : { false, true }) {
+            keys.push_back(ShaderKey(sampling, alphaTest));
+        }
     }
+    return keys;
+}
+
+UINT GetShaderCompileFlags() {
+    UINT compileFlags = 0;
+
+#ifdef _DEBUG
+    compileFlags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+    return compileFlags;
+}
+
+// Shaders are compiled without the device; pipeline states are created once the root signatures exist.
+HRESULT CompileSceneShaders() {
+    ShaderStageDesc vertexShader = { TEXT("src/VertexShader.hlsl"), "Main", "vs_5_1", 0 };
+    ShaderStageDesc pixelShader = { TEXT("src/PixelShader.hlsl"), "Main", "ps_5_1", ShaderKey::AllAxes };
+
+    ThrowIfFailed(shaderPermutations.Compile(vertexShader, pixelShader, GetShaderCompileFlags(), GetSceneShaderKeys()));
+
+    return S_OK;
+}
+
+HRESULT CompileUpscaleShaders() {
+    // No variants; the default key is the only one.
+    ShaderStageDesc vertexShader = { TEXT("src/UpscaleVertexShader.hlsl"), "Main", "vs_5_0", 0 };
+    ShaderStageDesc pixelShader = { TEXT("src/UpscalePixelShader.hlsl"), "Main", "ps_5_0", 0 };
+
+    ThrowIfFailed(upscalePermutations.Compile(vertexShader, pixelShader, GetShaderCompileFlags(), { ShaderKey() }));
+
+    return S_OK;
+}
 
-    // Index Buffer
+HRESULT CompileOverlayShaders() {
+    ShaderStageDesc vertexShader = { TEXT("src/OverlayVertexShader.hlsl"), "Main", "vs_5_0", 0 };
+    ShaderStageDesc pixelShader = { TEXT("src/OverlayPixelShader.hlsl"), "Main", "ps_5_0", 0 };
+
+    ThrowIfFailed(overlayPermutations.Compile(vertexShader, pixelShader, GetShaderCompileFlags(), { ShaderKey() }));
+
+    return S_OK;
+}
+
+HRESULT InitScenePipelines() {
+    // Pipeline State
     {
-        UINT16 indices[] = {
-            0, 1, 2,
-            2, 1, 3,
+        // Every attribute the meshes can provide. Each variant gets the attributes its vertex
+        // shader reads, in the order of its inputs.
+        static const std::vector<VertexAttribute> vertexAttributes = {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, UINT(offsetof(Vertex, position)) },
+            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, UINT(offsetof(Vertex, uv)) },
         };
 
+        static std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayouts[ShaderKey::Count];
+        for (ShaderKey key : GetSceneShaderKeys()) {
+            ShaderReflectionData reflection;
+            ThrowIfFailed(ReflectShader(shaderPermutations.GetVertexShader(key), ShaderStage::Vertex, reflection));
+
+            std::vector<VertexAttribute> layout;
+            std::string missing;
+            if (!BuildInputLayout(reflection, vertexAttributes, layout, &missing)) {
+                LogError("No vertex attribute for shader input %s", missing.c_str());
+                return E_FAIL;
+            }
+            GetInputElements(layout, inputLayouts[key.GetValue()]);
+        }
+
+        ThrowIfFailed(shaderPermutations.CreatePipelines(device.Get(), GetSceneShaderKeys(), [](ShaderKey key, D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc) {
+            desc.pRootSignature = rootSignature.Get();
+            desc.DS = { };
+            desc.HS = { };
+            desc.GS = { };
+            desc.StreamOutput = { };
+            desc.BlendState = GetDefaultBlendDesc();
+            desc.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
+            desc.RasterizerState = GetDefaultRasterizerDesc();
+            desc.DepthStencilState = { };
+            const std::vector<D3D12_INPUT_ELEMENT_DESC> &inputLayout = inputLayouts[key.GetValue()];
+            desc.InputLayout = { inputLayout.data(), UINT(inputLayout.size()) };
+            desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+            desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+            desc.NumRenderTargets = 1;
+            for (DXGI_FORMAT &format : desc.RTVFormats) { format = DXGI_FORMAT_UNKNOWN; }
+            desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+            desc.DSVFormat = { };
+            desc.SampleDesc.Count = 1;
+            desc.SampleDesc.Quality = 0;
+            desc.NodeMask = 0;
+            desc.CachedPSO = { };
+            desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+        }));
+
+        LogInfo("Shader variants: %u, pipeline states: %u, build time: %.1f ms",
+            shaderPermutations.GetShaderVariantCount(), shaderPermutations.GetPipelineCount(), shaderPermutations.GetBuildTime());
+    }
+
+    // Indirect Draws
+    ThrowIfFailed(indirectDraws.Init(device.Get(), rootSignature.Get(), drawConstantsParameter, textureParameter, MaxIndirectDraws, MaxIndirectBuckets));
+
+    return S_OK;
+}
+
+HRESULT InitUpscalePipeline() {
+    ThrowIfFailed(upscalePermutations.CreatePipelines(device.Get(), { ShaderKey() }, [](ShaderKey, D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc) {
+        desc.pRootSignature = upscaleRootSignature.Get();
+        desc.DS = { };
+        desc.HS = { };
+        desc.GS = { };
+        desc.StreamOutput = { };
+        desc.BlendState = GetDefaultBlendDesc();
+        desc.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
+        desc.RasterizerState = GetDefaultRasterizerDesc();
+        desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+        desc.DepthStencilState = { };
+        desc.InputLayout = { };
+        desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+        desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        desc.NumRenderTargets = 1;
+        for (DXGI_FORMAT &format : desc.RTVFormats) { format = DXGI_FORMAT_UNKNOWN; }
+        desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.DSVFormat = { };
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.NodeMask = 0;
+        desc.CachedPSO = { };
+        desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+    }));
+
+    return S_OK;
+}
+
+HRESULT InitOverlayPipeline() {
+    ThrowIfFailed(overlayPermutations.CreatePipelines(device.Get(), { ShaderKey() }, [](ShaderKey, D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc) {
+        desc.pRootSignature = overlayRootSignature.Get();
+        desc.DS = { };
+        desc.HS = { };
+        desc.GS = { };
+        desc.StreamOutput = { };
+        // Blended over the upscaled scene with the alpha of the quad and the glyph coverage.
+        desc.BlendState = GetDefaultBlendDesc();
+        desc.BlendState.RenderTarget[0].BlendEnable = true;
+        desc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_SRC_ALPHA;
+        desc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+        desc.BlendState.RenderTarget[0].BlendOp = D3D12_BLEND_OP_ADD;
+        desc.BlendState.RenderTarget[0].SrcBlendAlpha = D3D12_BLEND_ONE;
+        desc.BlendState.RenderTarget[0].DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+        desc.BlendState.RenderTarget[0].BlendOpAlpha = D3D12_BLEND_OP_ADD;
+        desc.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
+        desc.RasterizerState = GetDefaultRasterizerDesc();
+        desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+        desc.DepthStencilState = { };
+        desc.InputLayout = { };
+        desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+        desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        desc.NumRenderTargets = 1;
+        for (DXGI_FORMAT &format : desc.RTVFormats) { format = DXGI_FORMAT_UNKNOWN; }
+        desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.DSVFormat = { };
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.NodeMask = 0;
+        desc.CachedPSO = { };
+        desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+    }));
+
+    return S_OK;
+}
+
+HRESULT InitOverlayAtlas() {
+    ThrowIfFailed(overlayAtlas.Init(device.Get(), bindlessHeap.GetCpuHandle(overlayAtlasSrv)));
+
+    return S_OK;
+}
+
+HRESULT InitMesh() {
+    // Mesh
+    {
+        ThrowIfFailed(geometryPool.Init(device.Get(), GeometryPoolVertexCapacity, sizeof(Vertex), GeometryPoolIndexCapacity));
+
+        MeshFile mesh;
+        if (!mesh.Open("assets/quad.obj")) {
+            return E_FAIL;
+        }
+
+        UINT vbSize = mesh.GetVertexCount() * (UINT) sizeof(Vertex);
+        UINT ibSize = mesh.GetIndexCount() * (UINT) sizeof(UINT32);
+
+        // The mesh is parsed straight into the upload buffer.
         D3D12_HEAP_PROPERTIES properties;
         properties.Type                 = D3D12_HEAP_TYPE_UPLOAD;
         properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
@@ -439,201 +1058,650 @@ HRESULT InitResource() {
         ThrowIfFailed(device->CreateCommittedResource(
             &properties,
             D3D12_HEAP_FLAG_NONE,
-            &GetBufferResourceDesc(desc, sizeof(indices)),
+            &GetBufferResourceDesc(desc, UINT64(vbSize) + ibSize),
             D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
-            IID_PPV_ARGS(&indexBuffer)
+            IID_PPV_ARGS(&startup.meshUploadHeap)
         ));
 
         void *buffer;
-        ThrowIfFailed(indexBuffer->Map(0, nullptr, &buffer));
-        memcpy(buffer, indices, sizeof(indices));
-        indexBuffer->Unmap(0, nullptr);
+        ThrowIfFailed(startup.meshUploadHeap->Map(0, nullptr, &buffer));
+        bool parsed = mesh.Parse((MeshVertex *) buffer, (UINT32 *) ((BYTE *) buffer + vbSize));
+        XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        if (parsed) {
+            const MeshVertex *vertices = (const MeshVertex *) buffer;
+            for (UINT i = 0; i < mesh.GetVertexCount(); i++) {
+                XMStoreFloat3(&boundsMin, XMVectorMin(XMLoadFloat3(&boundsMin), XMLoadFloat3((const XMFLOAT3 *) vertices[i].position)));
+                XMStoreFloat3(&boundsMax, XMVectorMax(XMLoadFloat3(&boundsMax), XMLoadFloat3((const XMFLOAT3 *) vertices[i].position)));
+            }
+        }
+        startup.meshUploadHeap->Unmap(0, nullptr);
+
+        if (!parsed) {
+            return E_FAIL;
+        }
 
-        // Index Buffer View
-        ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-        ibView.SizeInBytes = sizeof(indices);
-        ibView.Format = DXGI_FORMAT_R16_UINT;
+        // The mesh is copied into its range of the shared DEFAULT-heap buffers below.
+        if (!geometryPool.Allocate(mesh.GetVertexCount(), mesh.GetIndexCount(), quadMesh)) {
+            return E_OUTOFMEMORY;
+        }
+
+        quadTransforms.Resize(1);
+        quadWorlds.resize(1);
+        quadBatchIds.assign(1, 0);
+        quadTextures.assign(1, textureSrv);
+
+        quadLocalBounds.Resize(1);
+        quadLocalBounds.center.x[0]  = (boundsMin.x + boundsMax.x) * 0.5f;
+        quadLocalBounds.center.y[0]  = (boundsMin.y + boundsMax.y) * 0.5f;
+        quadLocalBounds.center.z[0]  = (boundsMin.z + boundsMax.z) * 0.5f;
+        quadLocalBounds.extents.x[0] = (boundsMax.x - boundsMin.x) * 0.5f;
+        quadLocalBounds.extents.y[0] = (boundsMax.y - boundsMin.y) * 0.5f;
+        quadLocalBounds.extents.z[0] = (boundsMax.z - boundsMin.z) * 0.5f;
     }
 
-    // Texture
-    {
-        // eNX`̓ǂݍ
-        TexMetadata metadata;
-        ScratchImage scratchImage;
-        ThrowIfFailed(LoadFromWICFile(TEXT("assets/icon.jpg"), WIC_FLAGS_NONE, &metadata, scratchImage));
+    return S_OK;
+}
+
+// Only reads the header, so the texture and its upload heap can be created at the image's
+// size while the device starts; DecodeTexture() then decodes into the mapped upload heap.
+HRESULT OpenTexture() {
+    // eNX`̓ǂݍ
+    startup.textureDecoder.reset(new ImageDecoder());
+    if (!startup.textureDecoder->Open(TexturePath)) {
+        return E_FAIL;
+    }
+    startup.imageInfo = startup.textureDecoder->GetInfo();
+    // Gray images stay one or two channels on the GPU; the SRV swizzles them back to RGBA.
+    startup.pixelFormat = GetNativePixelFormat(startup.imageInfo);
+    return S_OK;
+}
 
-        const Image *image = scratchImage.GetImage(0, 0, 0);
+HRESULT InitTexture() {
+    const ImageInfo &info = startup.imageInfo;
+    PixelFormat pixelFormat = startup.pixelFormat;
 
-        // Abv[hobt@p\[X̍쐬
-        D3D12_HEAP_PROPERTIES properties;
-        properties.Type                 = D3D12_HEAP_TYPE_UPLOAD;
-        properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        properties.CreationNodeMask     = 0;
-        properties.VisibleNodeMask      = 0;
+    // Very large images are streamed per mip level from a tile pool instead of uploaded whole.
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = { };
+    device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+    startup.streamed = (info.width >= StreamingMinSize || info.height >= StreamingMinSize) &&
+        options.TiledResourcesTier != D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED;
 
-        D3D12_RESOURCE_DESC desc;
-        desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
-        desc.Alignment          = 0;
-        desc.Width              = image->slicePitch;
-        desc.Height             = 1;
-        desc.DepthOrArraySize   = 1;
-        desc.MipLevels          = 1;
-        desc.Format             = DXGI_FORMAT_UNKNOWN;
-        desc.SampleDesc.Count   = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+    if (startup.streamed) {
+        return S_OK;
+    }
 
-        ComPtr<ID3D12Resource> uploadHeap;
-        ThrowIfFailed(device->CreateCommittedResource(
-            &properties,
-            D3D12_HEAP_FLAG_NONE,
-            &desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&uploadHeap)));
+    // eNX`\[X̍쐬
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Alignment          = 0;
+    desc.Width              = (UINT64) info.width;
+    desc.Height             = (UINT) info.height;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = GetDxgiFormat(pixelFormat);
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
 
-        void *buffer;
-        ThrowIfFailed(uploadHeap->Map(0, nullptr, &buffer));
-        memcpy(buffer, image->pixels, image->slicePitch);
-        uploadHeap->Unmap(0, nullptr);
+    ThrowIfFailed(device->CreateCommittedResource(
+        &properties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&texture)));
 
-        // eNX`\[X̍쐬
-        properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
-        properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        properties.CreationNodeMask     = 0;
-        properties.VisibleNodeMask      = 0;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT &layout = startup.textureLayout;
+    UINT64 uploadSize;
+    device->GetCopyableFootprints(&desc, 0, 1, 0, &layout, nullptr, nullptr, &uploadSize);
 
-        desc.Dimension          = D3D12_RESOURCE_DIMENSION(metadata.dimension);
-        desc.Alignment          = 0;
-        desc.Width              = (UINT64) metadata.width;
-        desc.Height             = (UINT) metadata.height;
-        desc.DepthOrArraySize   = (UINT16) metadata.arraySize;
-        desc.MipLevels          = (UINT16) metadata.mipLevels;
-        desc.Format             = metadata.format;
-        desc.SampleDesc.Count   = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.Layout             = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-        desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+    // Abv[hobt@p\[X̍쐬
+    properties.Type = D3D12_HEAP_TYPE_UPLOAD;
 
-        ThrowIfFailed(device->CreateCommittedResource(
-            &properties,
-            D3D12_HEAP_FLAG_NONE,
-            &desc,
-            D3D12_RESOURCE_STATE_COPY_DEST,
-            nullptr,
-            IID_PPV_ARGS(&texture)));
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Alignment          = 0;
+    desc.Width              = uploadSize;
+    desc.Height             = 1;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = DXGI_FORMAT_UNKNOWN;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    ThrowIfFailed(device->CreateCommittedResource(
+        &properties,
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&startup.textureUploadHeap)));
 
+    // Stays mapped until DecodeTexture() has written the rows.
+    void *buffer;
+    ThrowIfFailed(startup.textureUploadHeap->Map(0, nullptr, &buffer));
+    startup.texturePixels = (BYTE *) buffer + layout.Offset;
+
+    return S_OK;
+}
+
+// Decodes straight into the upload heap at the footprint's row pitch, with no copy in
+// between. A streamed texture reads its levels from a mip cache file instead; the image
+// is only decoded when the cache is missing or was built from another image.
+HRESULT DecodeTexture() {
+    const ImageInfo &info = startup.imageInfo;
+    if (startup.streamed) {
+        const ImageDecoder &decoder = *startup.textureDecoder;
+        MipCacheSource source = GetMipCacheSource(decoder.GetData(), decoder.GetSize());
+        if (!textureMipCache.Open(TextureMipCachePath, source, startup.pixelFormat, info.width, info.height)) {
+            size_t rowBytes = size_t(info.width) * GetPixelSize(startup.pixelFormat);
+            std::vector<BYTE> pixels(rowBytes * info.height);
+            if (!decoder.Decode(pixels.data(), rowBytes, startup.pixelFormat)) {
+                return E_FAIL;
+            }
+            if (!BuildMipCache(TextureMipCachePath, source, pixels.data(), rowBytes, startup.pixelFormat, info.width, info.height) ||
+                !textureMipCache.Open(TextureMipCachePath, source, startup.pixelFormat, info.width, info.height)) {
+                LogError("Cannot write the mip cache %s", TextureMipCachePath);
+                return E_FAIL;
+            }
+        }
+        return InitStreamedTexture();
+    }
+
+    bool decoded = startup.textureDecoder->Decode(startup.texturePixels, startup.textureLayout.Footprint.RowPitch, startup.pixelFormat);
+    startup.textureUploadHeap->Unmap(0, nullptr);
+    startup.texturePixels = nullptr;
+    return decoded ? S_OK : E_FAIL;
+}
+
+HRESULT InitStreamedTexture() {
+    HRESULT hr = textureStreamer.Init(device.Get(), commandQueue.Get(), StreamingPoolTiles);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // Levels are copied out of the mapped cache, so only the ones requested are read from disk.
+    MipLoader loader = [](uint32_t mip, void *pixels, size_t rowPitch) {
+        return textureMipCache.ReadMip(mip, pixels, rowPitch);
+    };
+    const ImageInfo &info = startup.imageInfo;
+    PixelFormat format = startup.pixelFormat;
+    return textureStreamer.Add(info.width, info.height, GetDxgiFormat(format), GetShaderComponentMapping(format),
+                               loader, bindlessHeap.GetCpuHandle(textureSrv), streamedTexture);
+}
+
+// Joins the startup tasks: records and submits the mesh and texture uploads and waits for them.
+HRESULT UploadResources() {
+    // Residency is tracked here, on one thread, once every resource exists.
+    sceneTargetResidency = residency.Track(sceneTarget.Get());
+    if (startup.streamed) {
+        textureResidency = residency.Track(textureStreamer.GetHeap(), UINT64(StreamingPoolTiles) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES);
+    } else {
+        textureResidency = residency.Track(texture.Get());
+    }
+    geometryPool.TrackResidency(&residency);
+    constantAllocator.TrackResidency(&residency);
+    indirectDraws.TrackResidency(&residency);
+    frameCapture.TrackResidency(&residency);
+
+    // The uploads get their own list from the pool instead of borrowing the frame's.
+    PooledCommandList uploadCommands;
+    ThrowIfFailed(commandListPool.Acquire(QueueType::Graphics, nullptr, uploadCommands));
+    ID3D12GraphicsCommandList *uploadList = uploadCommands.list;
+
+    // Mesh and texture uploads are submitted together.
+    const MeshRange &quadRange = geometryPool.GetRange(quadMesh);
+    geometryPool.BeginUpload(uploadList);
+    geometryPool.Upload(uploadList, quadMesh, startup.meshUploadHeap.Get(), 0, UINT64(quadRange.vertexCount) * sizeof(Vertex));
+    geometryPool.EndUpload(uploadList);
+    if (!startup.streamed) {
         // Rs[
         D3D12_TEXTURE_COPY_LOCATION src;
-        src.pResource              = uploadHeap.Get();
+        src.pResource              = startup.textureUploadHeap.Get();
         src.Type                   = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-        src.PlacedFootprint.Offset = 0;
-        auto &footprint = src.PlacedFootprint.Footprint;
-        footprint.Format   = metadata.format;
-        footprint.Width    = metadata.width;
-        footprint.Height   = metadata.height;
-        footprint.Depth    = metadata.depth;
-        footprint.RowPitch = image->rowPitch;
+        src.PlacedFootprint        = startup.textureLayout;
 
         D3D12_TEXTURE_COPY_LOCATION dst;
         dst.pResource = texture.Get();
         dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
         dst.SubresourceIndex = 0;
 
-        ThrowIfFailed(commandAllocator->Reset());
-        ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState.Get()));
-
-        commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+        uploadList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
         D3D12_RESOURCE_BARRIER barrier;
-        commandList->ResourceBarrier(1, &GetTransitionBarrier(barrier, texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-        ThrowIfFailed(commandList->Close());
+        uploadList->ResourceBarrier(1, &GetTransitionBarrier(barrier, texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    }
+    overlayAtlas.Upload(uploadList);
+    ThrowIfFailed(uploadList->Close());
 
-        ID3D12CommandList *commandLists[] = { commandList.Get() };
-        commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+    ID3D12CommandList *commandLists[] = { uploadList };
+    commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+    commandListPool.Release(uploadCommands, fenceValue + 1);
 
-        WaitForPrevFrame();
+    WaitForGpu();
+    overlayAtlas.EndUpload();
 
-        // Shader Resource View (SRV)
-        {
-            D3D12_SHADER_RESOURCE_VIEW_DESC desc;
-            desc.Format                  = DXGI_FORMAT_R8G8B8A8_UNORM;
-            desc.ViewDimension           = D3D12_SRV_DIMENSION_TEXTURE2D;
-            desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-            desc.Texture2D               = { };
-            desc.Texture2D.MipLevels     = 1;
+    // The shaders read the object constants from DEFAULT-heap buffers that the copy queue
+    // fills each frame. Buffers are promoted from and decay to COMMON on both queues, so
+    // no barriers are needed.
+    {
+        D3D12_HEAP_PROPERTIES properties;
+        properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
+        properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        properties.CreationNodeMask     = 0;
+        properties.VisibleNodeMask      = 0;
 
-            device->CreateShaderResourceView(texture.Get(), &desc, srvHeap->GetCPUDescriptorHandleForHeapStart());
+        D3D12_RESOURCE_DESC desc;
+        for (UINT i = 0; i < FrameCount; i++) {
+            ThrowIfFailed(device->CreateCommittedResource(
+                &properties,
+                D3D12_HEAP_FLAG_NONE,
+                &GetBufferResourceDesc(desc, quadWorlds.size() * sizeof(ObjectConstants)),
+                D3D12_RESOURCE_STATE_COMMON,
+                nullptr,
+                IID_PPV_ARGS(&objectBuffers[i])));
+            objectBufferResidency[i] = residency.Track(objectBuffers[i].Get());
         }
     }
 
+    // Shader Resource View (SRV). The streamer writes its own.
+    if (!startup.streamed) {
+        D3D12_SHADER_RESOURCE_VIEW_DESC desc;
+        desc.Format                  = GetDxgiFormat(startup.pixelFormat);
+        desc.ViewDimension           = D3D12_SRV_DIMENSION_TEXTURE2D;
+        desc.Shader4ComponentMapping = GetShaderComponentMapping(startup.pixelFormat);
+        desc.Texture2D               = { };
+        desc.Texture2D.MipLevels     = 1;
+
+        device->CreateShaderResourceView(texture.Get(), &desc, bindlessHeap.GetCpuHandle(textureSrv));
+    }
     return S_OK;
 }
 
-void OnUpdate() { }
+void OnUpdate() {
+    BuildWorldMatrices(quadTransforms, (Matrix4x4 *) quadWorlds.data());
+
+    // Culling. There is no camera yet, so clip space is world space.
+    TransformBounds((const Matrix4x4 *) quadWorlds.data(), quadLocalBounds, quadBounds);
+    ComputeBoundingSpheres(quadBounds, quadSpheres);
+
+    Matrix4x4 viewProjection;
+    XMStoreFloat4x4((XMFLOAT4X4 *) &viewProjection, XMMatrixIdentity());
+    const float cameraPosition[3] = { 0.0f, 0.0f, 0.0f };
+    culler.Cull(ExtractFrustum(viewProjection), cameraPosition, quadSpheres, quadBounds, quadBatchIds, 1);
+
+    ShowCullStats();
+}
+
+void ShowCullStats() {
+    static ULONGLONG lastTime = 0;
+    ULONGLONG time = GetTickCount64();
+    if (time - lastTime < 1000) {
+        return;
+    }
+    lastTime = time;
+
+    const ResidencyStats &residencyStats = residency.GetPolicy().GetStats();
+    TCHAR title[256];
+    wsprintf(title, TEXT("DrawTexture - DirectX12 | visible %u culled %u cull %u us | sort %u us states %u elided %u | arena %u / %u KB | resident %u / %u MB | scale %u%% gpu %u us"),
+        (UINT) culler.GetVisibleCount(), (UINT) culler.GetCulledCount(), (UINT) (culler.GetCullTime() * 1000.0),
+        (UINT) (drawQueue.GetSortTime() * 1000.0), stateCache.GetIssuedCount(), stateCache.GetElidedCount(),
+        (UINT) (frameArenas.GetHighWaterMark() >> 10), (UINT) (frameArenas.GetCapacity() >> 10),
+        (UINT) (residencyStats.residentBytes >> 20), (UINT) (residencyStats.budget >> 20),
+        (UINT) (resolutionScaler.GetScale() * 100.0f + 0.5f), (UINT) (resolutionScaler.GetPredictedTime() * 1000.0f));
+    SetWindowText(hWindow, title);
+}
+
+// GPU milliseconds of the last frame that used back buffer frame. Its fence must have
+// completed, so its timestamps are in the readback buffer. passTimes, when given, receives
+// GpuPassCount pass times.
+double ReadGpuFrameTime(UINT frame, float *passTimes) {
+    if (!timestampsWritten[frame]) {
+        if (passTimes) {
+            std::fill(passTimes, passTimes + GpuPassCount, 0.0f);
+        }
+        return 0.0;
+    }
+    UINT64 *timestamps;
+    D3D12_RANGE readRange = { frame * TimestampCount * sizeof(UINT64), (frame + 1) * TimestampCount * sizeof(UINT64) };
+    D3D12_RANGE writtenRange = { 0, 0 };
+    ThrowIfFailed(timestampReadback->Map(0, &readRange, (void **) &timestamps));
+    timestamps += frame * TimestampCount;
+    double toMilliseconds = 1000.0 / double(timestampFrequency);
+    double gpuTime = double(timestamps[TimestampFrameEnd] - timestamps[TimestampFrameStart]) * toMilliseconds;
+    if (passTimes) {
+        for (UINT i = 0; i < GpuPassCount; i++) {
+            passTimes[i] = (float) (double(timestamps[i + 1] - timestamps[i]) * toMilliseconds);
+        }
+    }
+    timestampReadback->Unmap(0, &writtenRange);
+    return gpuTime;
+}
+
+void UpdateRenderScale(float gpuTime) {
+    if (timestampsWritten[frameIndex]) {
+        resolutionScaler.Update(gpuTime, renderScales[frameIndex]);
+    }
+
+    renderScales[frameIndex] = resolutionScaler.GetScale();
+    viewport.Width = (float) resolutionScaler.GetScaledSize(Width);
+    viewport.Height = (float) resolutionScaler.GetScaledSize(Height);
+    scissorRect.right = (LONG) resolutionScaler.GetScaledSize(Width);
+    scissorRect.bottom = (LONG) resolutionScaler.GetScaledSize(Height);
+}
 
 void OnRender() {
-    ThrowIfFailed(commandAllocator->Reset());
+    // Up to FrameCount frames are in flight. Per-frame memory below is recycled by fence.
+    WaitForFrame();
+    constantAllocator.BeginFrame(fence->GetCompletedValue());
+    frameArenas.BeginFrame(fence->GetCompletedValue());
+    indirectDraws.BeginFrame(fence->GetCompletedValue());
+    bindlessHeap.BeginFrame(fence->GetCompletedValue());
+    frameCapture.BeginFrame(fence->GetCompletedValue());
+    geometryPool.ReleaseRetired(fence->GetCompletedValue());
+
+    // The last frame on this back buffer has completed, so its GPU times go to the HUD,
+    // with the counters of the latest frame.
+    auto frameStart = std::chrono::steady_clock::now();
+    float passTimes[GpuPassCount];
+    float gpuTime = (float) ReadGpuFrameTime(frameIndex, passTimes);
+    if (timestampsWritten[frameIndex]) {
+        float cpuTime = std::chrono::duration<float, std::milli>(frameStart - lastFrameStart).count();
+        perfHud.AddFrame(cpuTime, gpuTime, passTimes, hudCounters);
+    }
+    lastFrameStart = frameStart;
+    UpdateRenderScale(gpuTime);
+
+    // SRVs are rewritten in place, so the frames in flight must finish first. That only
+    // happens when a level has become resident or was evicted.
+    if (streamedTexture != MipStreamingPolicy::InvalidHandle) {
+        textureStreamer.SetScreenSize(streamedTexture, viewport.Width, viewport.Height);
+        ThrowIfFailed(textureStreamer.Update(viewport.Width, viewport.Height, frameArenas.Get(0)));
+        if (textureStreamer.HasStaleViews()) {
+            WaitForGpu();
+            textureStreamer.WriteViews();
+        }
+    }
 
-    ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState.Get()));
+    ThrowIfFailed(commandListPool.Acquire(QueueType::Graphics, shaderPermutations.GetPipelineState(shaderKey), frameCommands));
+    commandList = frameCommands.list;
+    stateCache.Reset(commandList, shaderPermutations.GetPipelineState(shaderKey));
+    const UINT timestampBase = frameIndex * TimestampCount;
+    commandList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampBase + TimestampFrameStart);
 
-    commandList->SetGraphicsRootSignature(rootSignature.Get());
-    ID3D12DescriptorHeap *heaps[] = { srvHeap.Get() };
-    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
-    commandList->SetGraphicsRootDescriptorTable(0, srvHeap->GetGPUDescriptorHandleForHeapStart());
+    // State goes through stateCache, which drops calls that set what is already bound.
+    stateCache.SetGraphicsRootSignature(rootSignature.Get());
+    ID3D12DescriptorHeap *heaps[] = { bindlessHeap.GetHeap() };
+    stateCache.SetDescriptorHeaps(_countof(heaps), heaps);
 
     commandList->RSSetViewports(1, &viewport);
     commandList->RSSetScissorRects(1, &scissorRect);
 
-    D3D12_RESOURCE_BARRIER barrier;
-    commandList->ResourceBarrier(1, &GetTransitionBarrier(
-        barrier, renderTargets[frameIndex].Get(),
-        D3D12_RESOURCE_STATE_PRESENT,
-        D3D12_RESOURCE_STATE_RENDER_TARGET));
+    // The scene target stays in RENDER_TARGET between frames.
+    D3D12_CPU_DESCRIPTOR_HANDLE sceneRtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
+    sceneRtvHandle.ptr += SIZE_T(rtvDescriptorSize) * FrameCount;
+
+    // Set render target.
+    commandList->OMSetRenderTargets(1, &sceneRtvHandle, false, nullptr);
+
+    float bgcolor[] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    commandList->ClearRenderTargetView(sceneRtvHandle, bgcolor, 1, &scissorRect);
+    stateCache.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // Freed meshes leave holes in the pool. Packing it is recorded before anything binds it;
+    // the old buffers are released once this frame's fence has passed.
+    if (geometryPool.NeedsCompaction()) {
+        ThrowIfFailed(geometryPool.Compact(commandList, fenceValue + 1));
+    }
+    geometryPool.Bind(stateCache);
+
+    // Object constants of the frame. They are written to upload memory and copied to this
+    // back buffer's objectBuffers on the copy queue, which the scene pass waits for.
+    // There is no root CBV per object: that would take a CBV argument in every indirect
+    // command, and each draw would read its constants from upload memory, over PCIe on a
+    // discrete GPU. One copy per frame puts them all in video memory instead.
+    void *objectData;
+    D3D12_GPU_VIRTUAL_ADDRESS objectAddress;
+    ID3D12Resource *objectUpload;
+    UINT64 objectUploadOffset;
+    UINT64 objectBytes = quadWorlds.size() * sizeof(ObjectConstants);
+    ThrowIfFailed(constantAllocator.Allocate(objectBytes, &objectData, &objectAddress, &objectUpload, &objectUploadOffset));
+    ObjectConstants *objects = (ObjectConstants *) objectData;
+    for (size_t i = 0; i < quadWorlds.size(); i++) {
+        XMStoreFloat4x4(&objects[i].world, XMMatrixTranspose(XMLoadFloat4x4(&quadWorlds[i])));
+        objects[i].textureIndex = quadTextures[i];
+    }
+    ThrowIfFailed(commandListPool.Acquire(QueueType::Copy, nullptr, copyCommands));
+    copyCommands.list->CopyBufferRegion(objectBuffers[frameIndex].Get(), 0, objectUpload, objectUploadOffset, objectBytes);
+    ThrowIfFailed(copyCommands.list->Close());
+    commandList->SetGraphicsRootShaderResourceView(objectsParameter, objectBuffers[frameIndex]->GetGPUVirtualAddress());
+    residency.Use(objectBufferResidency[frameIndex]);
+
+    // Only the instances that survived culling are drawn. Their packets are sorted by
+    // pipeline state, texture and depth, then issued one ExecuteIndirect per pipeline state.
+    const InstanceBatch &quads = culler.GetBatch(0);
+    const UINT *quadIds = culler.GetInstances().data() + quads.offset;
+    drawQueue.Clear();
+    for (UINT i = 0; i < quads.count; i++) {
+        drawQueue.Add(DrawKey::Make(0, shaderKey.GetValue(), quadTextures[quadIds[i]], quadWorlds[quadIds[i]]._43), quadIds[i], quadMesh);
+    }
+    drawQueue.Sort();
+    AddDrawPackets();
+    indirectDraws.Execute(stateCache);
+    if (indirectDraws.GetCommandCount() > 0) {
+        residency.Use(textureResidency);
+    }
+    residency.Use(sceneTargetResidency);
+    commandList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampBase + TimestampSceneEnd);
+
+    // Upscale the rendered part of the scene target to the back buffer.
+    D3D12_RESOURCE_BARRIER barriers[2];
+    UINT barrierCount = 0;
+    GetTransitionBarrier(barriers[0], sceneTarget.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    GetTransitionBarrier(barriers[1], renderTargets[frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    commandList->ResourceBarrier(_countof(barriers), barriers);
+    barrierCount += _countof(barriers);
 
     D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
     rtvHandle.ptr += SIZE_T(INT64(rtvDescriptorSize) * INT64(frameIndex));
-
-    // Set render target.
     commandList->OMSetRenderTargets(1, &rtvHandle, false, nullptr);
 
-    float bgcolor[] = { 0.5f, 0.5f, 0.5f, 1.0f };
-    commandList->ClearRenderTargetView(rtvHandle, bgcolor, 0, nullptr);
-    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    commandList->IASetVertexBuffers(0, 1, &vbView);
-    commandList->IASetIndexBuffer(&ibView);
-    commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
+    D3D12_VIEWPORT fullViewport = { 0.0f, 0.0f, (float) Width, (float) Height, 0.0f, 1.0f };
+    D3D12_RECT fullRect = { 0, 0, (LONG) Width, (LONG) Height };
+    commandList->RSSetViewports(1, &fullViewport);
+    commandList->RSSetScissorRects(1, &fullRect);
+
+    float upscaleConstants[] = {
+        viewport.Width / Width, viewport.Height / Height,
+        (viewport.Width - 0.5f) / Width, (viewport.Height - 0.5f) / Height,
+    };
+    stateCache.SetGraphicsRootSignature(upscaleRootSignature.Get());
+    stateCache.SetPipelineState(upscalePermutations.GetPipelineState(ShaderKey()));
+    stateCache.SetGraphicsRootDescriptorTable(sceneParameter, bindlessHeap.GetGpuHandle(sceneTargetSrv));
+    SetGraphicsRootConstants(commandList, upscaleConstantsParameter, upscaleConstants);
+    stateCache.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList->DrawInstanced(3, 1, 0, 0);
+    commandList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampBase + TimestampUpscaleEnd);
+
+    // The HUD goes on top of the upscaled image, at full resolution, before the capture.
+    if (hudVisible) {
+        overlayBatch.Clear();
+        perfHud.Build(overlayBatch, 8.0f, 8.0f);
+        DrawOverlay();
+    }
+    commandList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampBase + TimestampOverlayEnd);
+
+    // Capture. The copy is recorded now and written out by frameCapture a frame or more later.
+    D3D12_RESOURCE_STATES backBufferState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    if (screenshotRequested || recordingFrames || !goldenCapturePath.empty()) {
+        commandList->ResourceBarrier(1, &GetTransitionBarrier(barriers[1], renderTargets[frameIndex].Get(), backBufferState, D3D12_RESOURCE_STATE_COPY_SOURCE));
+        backBufferState = D3D12_RESOURCE_STATE_COPY_SOURCE;
+        barrierCount++;
+
+        char path[MAX_PATH];
+        if (screenshotRequested) {
+            sprintf_s(path, "screenshot_%03u.png", screenshotCount++);
+            bool recorded = frameCapture.Record(commandList, renderTargets[frameIndex].Get(), path, ImageFileFormat::Png);
+            LogInfo("Screenshot %s: %s, %.3f ms on the render thread", path, recorded ? "recorded" : "dropped", frameCapture.GetRecordTime());
+            screenshotRequested = false;
+        }
+        if (recordingFrames) {
+            // Raw frames are cheap to write, so the workers keep up with the frame rate.
+            sprintf_s(path, "frames/frame_%06u.raw", recordedFrameCount++);
+            frameCapture.Record(commandList, renderTargets[frameIndex].Get(), path, ImageFileFormat::Raw);
+        }
+        if (!goldenCapturePath.empty()) {
+            frameCapture.Record(commandList, renderTargets[frameIndex].Get(), goldenCapturePath, ImageFileFormat::Png);
+            goldenCapturePath.clear();
+        }
+    }
 
-    commandList->ResourceBarrier(1, &GetTransitionBarrier(
-        barrier, renderTargets[frameIndex].Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET,
-        D3D12_RESOURCE_STATE_PRESENT));
+    GetTransitionBarrier(barriers[0], sceneTarget.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    GetTransitionBarrier(barriers[1], renderTargets[frameIndex].Get(), backBufferState, D3D12_RESOURCE_STATE_PRESENT);
+    commandList->ResourceBarrier(_countof(barriers), barriers);
+    barrierCount += _countof(barriers);
+
+    commandList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampBase + TimestampFrameEnd);
+    commandList->ResolveQueryData(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, timestampBase, TimestampCount,
+        timestampReadback.Get(), timestampBase * sizeof(UINT64));
+    timestampsWritten[frameIndex] = true;
 
     ThrowIfFailed(commandList->Close());
 
     // Execute commands.
-    ID3D12CommandList *commandLists[] = { commandList.Get() };
-    commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+    ThrowIfFailed(residency.PrepareSubmission(fence->GetCompletedValue()));
+    ID3D12CommandList *copyLists[] = { copyCommands.list };
+    ID3D12CommandList *commandLists[] = { commandList };
+    queueScheduler.BeginFrame();
+    PassHandle objectCopy = queueScheduler.AddPass(QueueType::Copy, copyLists, _countof(copyLists));
+    queueScheduler.AddPass(QueueType::Graphics, commandLists, _countof(commandLists), { objectCopy });
+    ThrowIfFailed(queueScheduler.Submit(frameArenas.Get(0)));
+    commandListPool.Release(copyCommands, queueScheduler.GetSubmittedValue(QueueType::Copy));
+
+    // Shown by the HUD of the next frame, once the GPU times of this one are known.
+    const ResidencyStats &residencyStats = residency.GetPolicy().GetStats();
+    hudCounters.drawCount = indirectDraws.GetCommandCount() + 1 + (hudVisible ? 1 : 0);  // Scene, upscale and HUD.
+    hudCounters.barrierCount = barrierCount;
+    hudCounters.issuedStateCount = stateCache.GetIssuedCount();
+    hudCounters.elidedStateCount = stateCache.GetElidedCount();
+    hudCounters.residentBytes = residencyStats.residentBytes;
+    hudCounters.residencyBudget = residencyStats.budget;
+    hudCounters.arenaBytes = frameArenas.GetHighWaterMark();
+    hudCounters.arenaCapacity = frameArenas.GetCapacity();
+    hudCounters.constantBytes = constantAllocator.GetFrameBytes();
+
+    // Memory of this frame is reused once the fence signaled after Present() passes.
+    constantAllocator.EndFrame(fenceValue + 1);
+    frameArenas.EndFrame(fenceValue + 1);
+    commandListPool.Release(frameCommands, fenceValue + 1);
+    indirectDraws.EndFrame(fenceValue + 1);
+    residency.EndSubmission(fenceValue + 1);
+    frameCapture.EndFrame(fenceValue + 1);
 
     // Flip buffers.
-    ThrowIfFailed(swapChain->Present(1, 0));
+    ThrowIfFailed(swapChain->Present(syncInterval, 0));
 
-    // Wait for the process to finish.
-    WaitForPrevFrame();
+    ThrowIfFailed(commandQueue->Signal(fence.Get(), ++fenceValue));
+    frameFenceValues[frameIndex] = fenceValue;
 }
 
-void WaitForPrevFrame() {
-    ThrowIfFailed(commandQueue->Signal(fence.Get(), ++fenceValue));
+// Adds the sorted packets to indirectDraws: a bucket per run of equal layer and pipeline
+// state, and one AddDraws() per run of the same mesh within it. Textures are indexed in
+// the shader, so they do not split buckets and every bucket binds the same bindless table.
+void AddDrawPackets() {
+    // The IDs are read when the draws are written, so they only need to live for the frame.
+    const std::vector<DrawPacket> &packets = drawQueue.GetPackets();
+    UINT *drawObjectIds = frameArenas.Get(0).AllocateArray<UINT>(packets.size());
+    for (size_t i = 0; i < packets.size(); i++) {
+        drawObjectIds[i] = packets[i].objectId;
+    }
 
-    if (fence->GetCompletedValue() < fenceValue) {
-        ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, fenceEvent));
-        WaitForSingleObject(fenceEvent, INFINITE);
+    const uint64_t bucketMask = DrawKey::Layer::Mask | DrawKey::Pipeline::Mask;
+    size_t begin = 0;
+    while (begin < packets.size()) {
+        uint64_t bucketKey = packets[begin].key & bucketMask;
+        ShaderKey key = ShaderKey::FromValue(DrawKey::Pipeline::Decode(bucketKey));
+        if (!indirectDraws.BeginBucket(shaderPermutations.GetPipelineState(key), bindlessHeap.GetTable())) {
+            break;
+        }
+
+        size_t end = begin;
+        while (end < packets.size() && (packets[end].key & bucketMask) == bucketKey) {
+            size_t meshEnd = end + 1;
+            while (meshEnd < packets.size() && (packets[meshEnd].key & bucketMask) == bucketKey && packets[meshEnd].mesh == packets[end].mesh) {
+                meshEnd++;
+            }
+            if (!indirectDraws.AddDraws(geometryPool.GetRange(packets[end].mesh), drawObjectIds + end, UINT(meshEnd - end))) {
+                break;
+            }
+            end = meshEnd;
+        }
+
+        indirectDraws.EndBucket();
+        if (indirectDraws.HasOverflowed()) {
+            break;
+        }
+        begin = end;
     }
 
+    // The rest of the frame is not drawn; reported once, it would repeat every frame.
+    static bool overflowReported = false;
+    if (indirectDraws.HasOverflowed() && !overflowReported) {
+        LogWarning("Indirect draws: %u packets exceed %u buckets or %u draws, drew %u",
+            UINT(packets.size()), MaxIndirectBuckets, MaxIndirectDraws, indirectDraws.GetCommandCount());
+        overflowReported = true;
+    }
+}
+
+// Draws the quads of overlayBatch over the back buffer with one draw. The quads are
+// copied to constant memory and read by the vertex shader as a structured buffer.
+void DrawOverlay() {
+    const std::vector<OverlayQuad> &quads = overlayBatch.GetQuads();
+    if (quads.empty()) {
+        return;
+    }
+
+    void *quadData;
+    D3D12_GPU_VIRTUAL_ADDRESS quadAddress;
+    ThrowIfFailed(constantAllocator.Allocate(quads.size() * sizeof(OverlayQuad), &quadData, &quadAddress));
+    memcpy(quadData, quads.data(), quads.size() * sizeof(OverlayQuad));
+
+    float overlayConstants[] = { 1.0f / Width, 1.0f / Height };
+    stateCache.SetGraphicsRootSignature(overlayRootSignature.Get());
+    stateCache.SetPipelineState(overlayPermutations.GetPipelineState(ShaderKey()));
+    stateCache.SetGraphicsRootDescriptorTable(overlayAtlasParameter, bindlessHeap.GetGpuHandle(overlayAtlasSrv));
+    commandList->SetGraphicsRootShaderResourceView(overlayQuadsParameter, quadAddress);
+    SetGraphicsRootConstants(commandList, overlayConstantsParameter, overlayConstants);
+    stateCache.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList->DrawInstanced(UINT(quads.size() * 6), 1, 0, 0);
+}
+
+// Waits until the last frame that used the current back buffer has completed.
+void WaitForFrame() {
     frameIndex = swapChain->GetCurrentBackBufferIndex();
+    WaitForFence(frameFenceValues[frameIndex]);
+}
+
+// Waits until all work submitted so far has completed.
+void WaitForGpu() {
+    ThrowIfFailed(commandQueue->Signal(fence.Get(), ++fenceValue));
+    WaitForFence(fenceValue);
+}
+
+void WaitForFence(UINT64 value) {
+    if (fence->GetCompletedValue() < value) {
+        ThrowIfFailed(fence->SetEventOnCompletion(value, fenceEvent));
+        WaitForSingleObject(fenceEvent, INFINITE);
+    }
 }
 
 D3D12_BLEND_DESC GetDefaultBlendDesc() {
@@ -702,12 +1770,65 @@ D3D12_RESOURCE_BARRIER &GetTransitionBarrier(
     return barrier;
 }
 
+DXGI_FORMAT GetDxgiFormat(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::L8:
+        return DXGI_FORMAT_R8_UNORM;
+    case PixelFormat::L8A8:
+        return DXGI_FORMAT_R8G8_UNORM;
+    case PixelFormat::R8G8B8A8:
+        return DXGI_FORMAT_R8G8B8A8_UNORM;
+    case PixelFormat::B8G8R8A8:
+        return DXGI_FORMAT_B8G8R8A8_UNORM;
+    case PixelFormat::R16G16B16A16Float:
+        return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    default:
+        return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+UINT GetShaderComponentMapping(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::L8:
+        // (l, l, l, 1)
+        return D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(0, 0, 0, D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1);
+    case PixelFormat::L8A8:
+        // (l, l, l, a)
+        return D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(0, 0, 0, 1);
+    default:
+        return D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    }
+}
+
 LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
 
+    case WM_KEYDOWN:
+        // P toggles between linear and point sampling.
+        if (wParam == 'P') {
+            SamplingMode sampling = shaderKey.GetSamplingMode() == SamplingMode::Linear ? SamplingMode::Point : SamplingMode::Linear;
+            shaderKey = ShaderKey(sampling, shaderKey.HasAlphaTest());
+        }
+        // H shows or hides the performance HUD.
+        if (wParam == 'H') {
+            hudVisible = !hudVisible;
+        }
+        // C saves the next frame as a PNG, R toggles writing every frame to frames/.
+        if (wParam == 'C') {
+            screenshotRequested = true;
+        }
+        if (wParam == 'R') {
+            recordingFrames = !recordingFrames;
+            if (recordingFrames) {
+                CreateDirectoryA("frames", nullptr);
+            }
+            LogInfo("Frame recording %s, %u frames dropped so far", recordingFrames ? "started" : "stopped", (UINT) frameCapture.GetDroppedCount());
+        }
+        return 0;
+
     case WM_PAINT:
         OnUpdate();
         OnRender();
@@ -0,0 +1,789 @@
+#include "MeshLoader.h"
+#include "Parallel.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace {
+
+constexpr size_t ObjChunkSize = 1 << 20;
+
+constexpr uint32_t GlbMagic = 0x46546C67;     // "glTF"
+constexpr uint32_t GlbChunkJson = 0x4E4F534A; // "JSON"
+constexpr uint32_t GlbChunkBin = 0x004E4942;  // "BIN\0"
+
+constexpr uint32_t ComponentUnsignedByte = 5121;
+constexpr uint32_t ComponentUnsignedShort = 5123;
+constexpr uint32_t ComponentUnsignedInt = 5125;
+constexpr uint32_t ComponentFloat = 5126;
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char *SkipSpaces(const char *p, const char *end) {
+    while (p < end && IsSpace(*p)) { p++; }
+    return p;
+}
+
+inline const char *NextLine(const char *p, const char *end) {
+    const char *newline = (const char *) memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// Locale independent number parser; strtod is both slow and locale dependent.
+const char *ParseNumber(const char *p, const char *end, double &value) {
+    static const double Powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    p = SkipSpaces(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    const char *digits = p;
+
+    while (p < end && IsDigit(*p)) {
+        mantissa = mantissa * 10.0 + (*p++ - '0');
+    }
+
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && IsDigit(*p)) {
+            mantissa = mantissa * 10.0 + (*p++ - '0');
+            exponent--;
+        }
+    }
+
+    if (p == digits) {
+        return nullptr;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int e = 0;
+        while (p < end && IsDigit(*p)) {
+            e = e * 10 + (*p++ - '0');
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    if (exponent >= 0) {
+        mantissa *= exponent < (int) (sizeof(Powers) / sizeof(Powers[0])) ? Powers[exponent] : std::pow(10.0, exponent);
+    } else {
+        mantissa /= -exponent < (int) (sizeof(Powers) / sizeof(Powers[0])) ? Powers[-exponent] : std::pow(10.0, -exponent);
+    }
+
+    value = negative ? -mantissa : mantissa;
+    return p;
+}
+
+// value is 0 when no number is found.
+inline const char *ParseFloat(const char *p, const char *end, float &value) {
+    double number = 0.0;
+    p = ParseNumber(p, end, number);
+    value = (float) number;
+    return p;
+}
+
+const char *ParseInt(const char *p, const char *end, int64_t &value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    const char *digits = p;
+    int64_t result = 0;
+    while (p < end && IsDigit(*p)) {
+        result = result * 10 + (*p++ - '0');
+    }
+
+    if (p == digits) {
+        return nullptr;
+    }
+
+    value = negative ? -result : result;
+    return p;
+}
+
+// Resolves a 1-based (or negative, relative) OBJ index to a 0-based one.
+inline bool ResolveObjIndex(int64_t index, uint32_t count, uint32_t &result) {
+    int64_t resolved = index > 0 ? index - 1 : int64_t(count) + index;
+    if (index == 0 || resolved < 0 || resolved >= int64_t(count)) {
+        return false;
+    }
+    result = (uint32_t) resolved;
+    return true;
+}
+
+// Minimal JSON document, only used for the glTF header.
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    double number = 0.0;
+    std::string string;
+    std::vector<std::string> keys;
+    std::vector<JsonValue> values;
+
+    const JsonValue *Find(const char *key) const {
+        if (type != Object) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] == key) {
+                return &values[i];
+            }
+        }
+        return nullptr;
+    }
+
+    const JsonValue *At(size_t index) const {
+        return type == Array && index < values.size() ? &values[index] : nullptr;
+    }
+
+    double GetNumber(const char *key, double defaultValue) const {
+        const JsonValue *value = Find(key);
+        return value && value->type == Number ? value->number : defaultValue;
+    }
+
+    // For indices, counts and offsets. False if the key holds anything but a
+    // non-negative integer; result is defaultValue when the key is missing.
+    bool GetUnsigned(const char *key, uint64_t defaultValue, uint64_t &result) const;
+};
+
+// Converting a negative, fractional, huge or NaN double to an integer is undefined, so
+// every number from the file is checked before the cast.
+bool ToUnsigned(double value, uint64_t &result) {
+    if (!(value >= 0.0 && value <= 9007199254740992.0) || value != std::floor(value)) {
+        return false;
+    }
+    result = (uint64_t) value;
+    return true;
+}
+
+bool JsonValue::GetUnsigned(const char *key, uint64_t defaultValue, uint64_t &result) const {
+    const JsonValue *value = Find(key);
+    if (!value) {
+        result = defaultValue;
+        return true;
+    }
+    return value->type == Number && ToUnsigned(value->number, result);
+}
+
+class JsonParser {
+public:
+    JsonParser(const char *begin, const char *end) : p(begin), end(end) { }
+
+    bool Parse(JsonValue &value) {
+        return ParseValue(value, 0);
+    }
+
+private:
+    static constexpr int MaxDepth = 64;
+
+    void SkipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) { p++; }
+    }
+
+    bool Consume(char c) {
+        SkipWhitespace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    bool ParseString(std::string &result) {
+        if (!Consume('"')) {
+            return false;
+        }
+        while (p < end && *p != '"') {
+            if (*p == '\\') {
+                if (++p >= end) {
+                    return false;
+                }
+                switch (*p) {
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case 'u':
+                    // Non-ASCII characters never appear in the keys we look up.
+                    if (end - p < 5) {
+                        return false;
+                    }
+                    result += '?';
+                    p += 4;
+                    break;
+                default: result += *p; break;
+                }
+                p++;
+            } else {
+                result += *p++;
+            }
+        }
+        return Consume('"');
+    }
+
+    bool ParseValue(JsonValue &value, int depth) {
+        if (depth > MaxDepth) {
+            return false;
+        }
+
+        SkipWhitespace();
+        if (p >= end) {
+            return false;
+        }
+
+        if (*p == '{') {
+            p++;
+            value.type = JsonValue::Object;
+            if (Consume('}')) {
+                return true;
+            }
+            do {
+                value.keys.emplace_back();
+                value.values.emplace_back();
+                if (!ParseString(value.keys.back()) || !Consume(':') || !ParseValue(value.values.back(), depth + 1)) {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume('}');
+        }
+
+        if (*p == '[') {
+            p++;
+            value.type = JsonValue::Array;
+            if (Consume(']')) {
+                return true;
+            }
+            do {
+                value.values.emplace_back();
+                if (!ParseValue(value.values.back(), depth + 1)) {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume(']');
+        }
+
+        if (*p == '"') {
+            value.type = JsonValue::String;
+            return ParseString(value.string);
+        }
+
+        if (end - p >= 4 && memcmp(p, "true", 4) == 0) {
+            value.type = JsonValue::Bool;
+            value.number = 1.0;
+            p += 4;
+            return true;
+        }
+
+        if (end - p >= 5 && memcmp(p, "false", 5) == 0) {
+            value.type = JsonValue::Bool;
+            p += 5;
+            return true;
+        }
+
+        if (end - p >= 4 && memcmp(p, "null", 4) == 0) {
+            p += 4;
+            return true;
+        }
+
+        double number;
+        const char *next = ParseNumber(p, end, number);
+        if (!next) {
+            return false;
+        }
+        value.type = JsonValue::Number;
+        value.number = number;
+        p = next;
+        return true;
+    }
+
+    const char *p;
+    const char *end;
+};
+
+uint32_t GetComponentSize(uint32_t componentType) {
+    switch (componentType) {
+    case ComponentUnsignedByte: return 1;
+    case ComponentUnsignedShort: return 2;
+    case ComponentUnsignedInt: return 4;
+    case ComponentFloat: return 4;
+    }
+    return 0;
+}
+
+uint32_t GetComponentCount(const std::string &type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+inline uint32_t ReadU32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline float ReadComponent(const uint8_t *p, uint32_t componentType) {
+    switch (componentType) {
+    case ComponentUnsignedByte: return *p / 255.0f;
+    case ComponentUnsignedShort: { uint16_t v; memcpy(&v, p, 2); return v / 65535.0f; }
+    default: { float v; memcpy(&v, p, 4); return v; }
+    }
+}
+
+inline uint32_t ReadIndex(const uint8_t *p, uint32_t componentType) {
+    switch (componentType) {
+    case ComponentUnsignedByte: return *p;
+    case ComponentUnsignedShort: { uint16_t v; memcpy(&v, p, 2); return v; }
+    default: return ReadU32(p);
+    }
+}
+
+}
+
+bool MeshFile::Open(const char *path) {
+    vertexCount = 0;
+    indexCount = 0;
+    objChunks.clear();
+    glbPrimitives.clear();
+
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    isGlb = file.GetSize() >= 12 && ReadU32((const uint8_t *) file.GetData()) == GlbMagic;
+    return isGlb ? OpenGlb() : OpenObj();
+}
+
+bool MeshFile::Parse(MeshVertex *vertices, uint32_t *indices) {
+    return isGlb ? ParseGlb(vertices, indices) : ParseObj(vertices, indices);
+}
+
+bool MeshFile::OpenObj() {
+    const char *data = file.GetData();
+    const char *dataEnd = data + file.GetSize();
+
+    // Split the file at line boundaries.
+    for (const char *p = data; p < dataEnd; ) {
+        const char *end = p + (std::min)(ObjChunkSize, size_t(dataEnd - p));
+        end = end < dataEnd ? NextLine(end, dataEnd) : end;
+        ObjChunk chunk = { };
+        chunk.begin = p;
+        chunk.end = end;
+        objChunks.push_back(chunk);
+        p = end;
+    }
+
+    // Count elements per chunk.
+    ParallelFor(objChunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ObjChunk &chunk = objChunks[i];
+
+            for (const char *p = chunk.begin; p < chunk.end; p = NextLine(p, chunk.end)) {
+                const char *q = SkipSpaces(p, chunk.end);
+                if (chunk.end - q < 2) {
+                    continue;
+                }
+
+                if (q[0] == 'v' && IsSpace(q[1])) {
+                    chunk.positionCount++;
+                } else if (q[0] == 'v' && q[1] == 't' && chunk.end - q > 2 && IsSpace(q[2])) {
+                    chunk.uvCount++;
+                } else if (q[0] == 'f' && IsSpace(q[1])) {
+                    uint32_t corners = 0;
+                    for (q += 2; ; corners++) {
+                        q = SkipSpaces(q, chunk.end);
+                        if (q >= chunk.end || *q == '\n' || *q == '#') {
+                            break;
+                        }
+                        while (q < chunk.end && !IsSpace(*q) && *q != '\n') { q++; }
+                    }
+
+                    if (corners < 3) {
+                        chunk.failed = true;
+                    } else {
+                        chunk.cornerCount += corners;
+                        chunk.triangleCount += corners - 2;
+                    }
+                }
+            }
+        }
+    });
+
+    // Prefix sums give every chunk its output offsets.
+    uint64_t positions = 0, uvs = 0, corners = 0, triangles = 0;
+    for (ObjChunk &chunk : objChunks) {
+        if (chunk.failed) {
+            return false;
+        }
+        chunk.positionBase = (uint32_t) positions;
+        chunk.uvBase = (uint32_t) uvs;
+        chunk.cornerBase = (uint32_t) corners;
+        chunk.triangleBase = (uint32_t) triangles;
+        positions += chunk.positionCount;
+        uvs += chunk.uvCount;
+        corners += chunk.cornerCount;
+        triangles += chunk.triangleCount;
+    }
+
+    if (corners == 0 || corners > UINT32_MAX || triangles * 3 > UINT32_MAX) {
+        return false;
+    }
+
+    vertexCount = (uint32_t) corners;
+    indexCount = (uint32_t) (triangles * 3);
+    return true;
+}
+
+bool MeshFile::ParseObj(MeshVertex *vertices, uint32_t *indices) {
+    const ObjChunk &last = objChunks.back();
+    const uint32_t positionCount = last.positionBase + last.positionCount;
+    const uint32_t uvCount = last.uvBase + last.uvCount;
+
+    // Faces may reference attributes from any earlier chunk, so attributes are parsed first.
+    std::vector<float> positions(size_t(positionCount) * 3);
+    std::vector<float> uvs(size_t(uvCount) * 2);
+
+    ParallelFor(objChunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ObjChunk &chunk = objChunks[i];
+            float *position = positions.data() + size_t(chunk.positionBase) * 3;
+            float *uv = uvs.data() + size_t(chunk.uvBase) * 2;
+
+            for (const char *p = chunk.begin; p < chunk.end && !chunk.failed; p = NextLine(p, chunk.end)) {
+                const char *q = SkipSpaces(p, chunk.end);
+                if (chunk.end - q < 2 || q[0] != 'v') {
+                    continue;
+                }
+
+                if (IsSpace(q[1])) {
+                    q += 1;
+                    for (int c = 0; c < 3 && q; c++) { q = ParseFloat(q, chunk.end, *position++); }
+                    chunk.failed = !q;
+                } else if (q[1] == 't' && chunk.end - q > 2 && IsSpace(q[2])) {
+                    q += 2;
+                    for (int c = 0; c < 2 && q; c++) { q = ParseFloat(q, chunk.end, *uv++); }
+                    chunk.failed = !q;
+                }
+            }
+        }
+    });
+
+    ParallelFor(objChunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ObjChunk &chunk = objChunks[i];
+            uint32_t definedPositions = chunk.positionBase;
+            uint32_t definedUVs = chunk.uvBase;
+            MeshVertex *vertex = vertices + chunk.cornerBase;
+            uint32_t *index = indices + size_t(chunk.triangleBase) * 3;
+
+            for (const char *p = chunk.begin; p < chunk.end && !chunk.failed; p = NextLine(p, chunk.end)) {
+                const char *q = SkipSpaces(p, chunk.end);
+                if (chunk.end - q < 2) {
+                    continue;
+                }
+
+                if (q[0] == 'v' && IsSpace(q[1])) {
+                    definedPositions++;
+                    continue;
+                }
+
+                if (q[0] == 'v' && q[1] == 't' && chunk.end - q > 2 && IsSpace(q[2])) {
+                    definedUVs++;
+                    continue;
+                }
+
+                if (q[0] != 'f' || !IsSpace(q[1])) {
+                    continue;
+                }
+
+                const uint32_t first = uint32_t(vertex - vertices);
+                uint32_t corners = 0;
+
+                for (q += 2; ; corners++) {
+                    q = SkipSpaces(q, chunk.end);
+                    if (q >= chunk.end || *q == '\n' || *q == '#') {
+                        break;
+                    }
+
+                    // v, v/vt, v//vn or v/vt/vn
+                    int64_t v, vt = 0;
+                    uint32_t positionIndex, uvIndex = 0;
+                    q = ParseInt(q, chunk.end, v);
+                    if (!q || !ResolveObjIndex(v, definedPositions, positionIndex)) {
+                        chunk.failed = true;
+                        break;
+                    }
+
+                    if (q < chunk.end && *q == '/' && q + 1 < chunk.end && q[1] != '/') {
+                        q = ParseInt(q + 1, chunk.end, vt);
+                        if (!q || !ResolveObjIndex(vt, definedUVs, uvIndex)) {
+                            chunk.failed = true;
+                            break;
+                        }
+                    }
+
+                    while (q < chunk.end && !IsSpace(*q) && *q != '\n') { q++; }
+
+                    const float *position = positions.data() + size_t(positionIndex) * 3;
+                    vertex->position[0] = position[0];
+                    vertex->position[1] = position[1];
+                    vertex->position[2] = position[2];
+
+                    // OBJ puts the texture origin at the bottom left.
+                    if (vt != 0) {
+                        vertex->uv[0] = uvs[size_t(uvIndex) * 2];
+                        vertex->uv[1] = 1.0f - uvs[size_t(uvIndex) * 2 + 1];
+                    } else {
+                        vertex->uv[0] = 0.0f;
+                        vertex->uv[1] = 0.0f;
+                    }
+                    vertex++;
+
+                    // Triangulate as a fan.
+                    if (corners >= 2) {
+                        *index++ = first;
+                        *index++ = first + corners - 1;
+                        *index++ = first + corners;
+                    }
+                }
+            }
+        }
+    });
+
+    for (const ObjChunk &chunk : objChunks) {
+        if (chunk.failed) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MeshFile::OpenGlb() {
+    const uint8_t *data = (const uint8_t *) file.GetData();
+    const size_t size = file.GetSize();
+
+    if (ReadU32(data + 4) != 2 || ReadU32(data + 8) > size) {
+        return false;
+    }
+
+    const char *jsonBegin = nullptr;
+    const char *jsonEnd = nullptr;
+    const uint8_t *bin = nullptr;
+    size_t binSize = 0;
+
+    for (size_t offset = 12; offset + 8 <= size; ) {
+        uint32_t chunkLength = ReadU32(data + offset);
+        uint32_t chunkType = ReadU32(data + offset + 4);
+        if (chunkLength > size - offset - 8) {
+            return false;
+        }
+
+        if (chunkType == GlbChunkJson && !jsonBegin) {
+            jsonBegin = (const char *) data + offset + 8;
+            jsonEnd = jsonBegin + chunkLength;
+        } else if (chunkType == GlbChunkBin && !bin) {
+            bin = data + offset + 8;
+            binSize = chunkLength;
+        }
+
+        offset += 8 + ((chunkLength + 3) & ~3u);
+    }
+
+    JsonValue json;
+    if (!jsonBegin || !JsonParser(jsonBegin, jsonEnd).Parse(json)) {
+        return false;
+    }
+
+    const JsonValue *accessors = json.Find("accessors");
+    const JsonValue *bufferViews = json.Find("bufferViews");
+    const JsonValue *meshes = json.Find("meshes");
+    if (!accessors || !bufferViews || !meshes || meshes->type != JsonValue::Array) {
+        return false;
+    }
+
+    auto resolveAccessor = [&](const JsonValue *attribute, uint32_t components, GlbAccessor &result) {
+        uint64_t accessorIndex;
+        if (!attribute || attribute->type != JsonValue::Number || !ToUnsigned(attribute->number, accessorIndex)) {
+            return false;
+        }
+        const JsonValue *accessor = accessors->At((size_t) accessorIndex);
+        uint64_t viewIndex;
+        if (!accessor || accessor->Find("sparse") || !accessor->GetUnsigned("bufferView", UINT64_MAX, viewIndex)) {
+            return false;
+        }
+
+        const JsonValue *type = accessor->Find("type");
+        const JsonValue *view = bufferViews->At((size_t) viewIndex);
+        if (!type || GetComponentCount(type->string) != components || !view || view->GetNumber("buffer", 0.0) != 0.0 || view->Find("uri")) {
+            return false;
+        }
+
+        uint64_t componentType, count, viewOffset, viewLength, accessorOffset;
+        if (!accessor->GetUnsigned("componentType", 0, componentType) || !accessor->GetUnsigned("count", 0, count) ||
+            !accessor->GetUnsigned("byteOffset", 0, accessorOffset) || !view->GetUnsigned("byteOffset", 0, viewOffset) ||
+            !view->GetUnsigned("byteLength", 0, viewLength) || componentType > UINT32_MAX || count > UINT32_MAX) {
+            return false;
+        }
+        result.componentType = (uint32_t) componentType;
+        result.count = (uint32_t) count;
+        const JsonValue *normalized = accessor->Find("normalized");
+        result.normalized = normalized && normalized->type == JsonValue::Bool && normalized->number != 0.0;
+
+        // A byteStride of 0 means tightly packed, as it did in glTF 1.0. Any other stride
+        // must hold a whole element, or the elements would overlap.
+        const uint64_t elementSize = uint64_t(GetComponentSize(result.componentType)) * components;
+        uint64_t stride;
+        if (!view->GetUnsigned("byteStride", 0, stride) || stride > UINT32_MAX || (stride != 0 && stride < elementSize)) {
+            return false;
+        }
+        result.stride = stride != 0 ? (uint32_t) stride : (uint32_t) elementSize;
+
+        // Offsets from the file go up to 2^53, so the accessor's extent is checked by
+        // subtracting from the view length instead of adding to the offset, which could wrap.
+        if (elementSize == 0 || result.count == 0 || viewOffset > binSize || viewLength > binSize - viewOffset ||
+            accessorOffset > viewLength || elementSize > viewLength - accessorOffset ||
+            uint64_t(result.stride) * (result.count - 1) > viewLength - accessorOffset - elementSize) {
+            return false;
+        }
+
+        result.data = bin + viewOffset + accessorOffset;
+        return true;
+    };
+
+    uint64_t vertices = 0, indices = 0;
+
+    for (const JsonValue &mesh : meshes->values) {
+        const JsonValue *primitives = mesh.Find("primitives");
+        if (!primitives || primitives->type != JsonValue::Array) {
+            return false;
+        }
+
+        for (const JsonValue &primitive : primitives->values) {
+            const JsonValue *attributes = primitive.Find("attributes");
+            if (!attributes || primitive.GetNumber("mode", 4.0) != 4.0) {
+                return false;
+            }
+
+            GlbPrimitive result = { };
+            if (!resolveAccessor(attributes->Find("POSITION"), 3, result.position) || result.position.componentType != ComponentFloat) {
+                return false;
+            }
+
+            // Texture coordinates are floats, or normalized unsigned bytes or shorts.
+            if (attributes->Find("TEXCOORD_0")) {
+                if (!resolveAccessor(attributes->Find("TEXCOORD_0"), 2, result.uv)) {
+                    return false;
+                }
+                const uint32_t uvType = result.uv.componentType;
+                if (uvType != ComponentFloat && !(result.uv.normalized && (uvType == ComponentUnsignedByte || uvType == ComponentUnsignedShort))) {
+                    return false;
+                }
+            }
+
+            if (primitive.Find("indices")) {
+                if (!resolveAccessor(primitive.Find("indices"), 1, result.index) || result.index.componentType == ComponentFloat) {
+                    return false;
+                }
+            }
+
+            result.vertexBase = (uint32_t) vertices;
+            result.indexBase = (uint32_t) indices;
+            vertices += result.position.count;
+            indices += result.index.data ? result.index.count : result.position.count;
+
+            if (vertices > UINT32_MAX || indices > UINT32_MAX) {
+                return false;
+            }
+
+            glbPrimitives.push_back(result);
+        }
+    }
+
+    vertexCount = (uint32_t) vertices;
+    indexCount = (uint32_t) indices;
+    return vertexCount > 0;
+}
+
+bool MeshFile::ParseGlb(MeshVertex *vertices, uint32_t *indices) {
+    constexpr size_t MinRange = 16 * 1024;
+
+    for (const GlbPrimitive &primitive : glbPrimitives) {
+        MeshVertex *vertex = vertices + primitive.vertexBase;
+        uint32_t *index = indices + primitive.indexBase;
+
+        ParallelFor(primitive.position.count, MinRange, [&](size_t begin, size_t end) {
+            const GlbAccessor &position = primitive.position;
+            const GlbAccessor &uv = primitive.uv;
+            const uint32_t uvSize = GetComponentSize(uv.componentType);
+
+            for (size_t i = begin; i < end; i++) {
+                memcpy(vertex[i].position, position.data + i * position.stride, sizeof(vertex[i].position));
+
+                if (uv.data && i < uv.count) {
+                    const uint8_t *p = uv.data + i * uv.stride;
+                    vertex[i].uv[0] = ReadComponent(p, uv.componentType);
+                    vertex[i].uv[1] = ReadComponent(p + uvSize, uv.componentType);
+                } else {
+                    vertex[i].uv[0] = 0.0f;
+                    vertex[i].uv[1] = 0.0f;
+                }
+            }
+        });
+
+        if (!primitive.index.data) {
+            for (uint32_t i = 0; i < primitive.position.count; i++) {
+                index[i] = primitive.vertexBase + i;
+            }
+            continue;
+        }
+
+        std::atomic<bool> failed(false);
+        ParallelFor(primitive.index.count, MinRange, [&](size_t begin, size_t end) {
+            const GlbAccessor &source = primitive.index;
+
+            for (size_t i = begin; i < end; i++) {
+                uint32_t value = ReadIndex(source.data + i * source.stride, source.componentType);
+                if (value >= primitive.position.count) {
+                    failed = true;
+                    value = 0;
+                }
+                index[i] = primitive.vertexBase + value;
+            }
+        });
+
+        if (failed) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Vertex layout written by MeshFile. Matches Vertex in Main.cpp.
+struct MeshVertex {
+    float position[3];
+    float uv[2];
+};
+
+// Mesh asset in Wavefront OBJ or binary glTF (.glb) format.
+// Open() maps the file and counts its contents, Parse() then writes the
+// vertices and 32-bit indices straight into caller-provided memory (e.g. a
+// mapped upload buffer). Both passes run in parallel over chunks of the file
+// and do not allocate per vertex.
+class MeshFile {
+public:
+    bool Open(const char *path);
+
+    uint32_t GetVertexCount() const { return vertexCount; }
+    uint32_t GetIndexCount() const { return indexCount; }
+    size_t GetFileSize() const { return file.GetSize(); }
+
+    bool Parse(MeshVertex *vertices, uint32_t *indices);
+
+private:
+    struct ObjChunk {
+        const char *begin;
+        const char *end;
+        uint32_t positionCount;
+        uint32_t uvCount;
+        uint32_t cornerCount;
+        uint32_t triangleCount;
+        uint32_t positionBase;
+        uint32_t uvBase;
+        uint32_t cornerBase;
+        uint32_t triangleBase;
+        bool failed;
+    };
+
+    struct GlbAccessor {
+        const uint8_t *data;
+        uint32_t count;
+        uint32_t stride;
+        uint32_t componentType;
+        bool normalized;  // Integer components map to [0, 1].
+    };
+
+    struct GlbPrimitive {
+        GlbAccessor position;
+        GlbAccessor uv;
+        GlbAccessor index;
+        uint32_t vertexBase;
+        uint32_t indexBase;
+    };
+
+    bool OpenObj();
+    bool OpenGlb();
+    bool ParseObj(MeshVertex *vertices, uint32_t *indices);
+    bool ParseGlb(MeshVertex *vertices, uint32_t *indices);
+
+    MappedFile file;
+    bool isGlb = false;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    std::vector<ObjChunk> objChunks;
+    std::vector<GlbPrimitive> glbPrimitives;
+};
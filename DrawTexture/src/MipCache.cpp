@@ -0,0 +1,145 @@
+#include "MipCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "MipStreaming.h"
+
+namespace {
+
+constexpr uint32_t MipCacheMagic = 0x4350494D;  // "MIPC"
+constexpr uint32_t MipCacheVersion = 1;
+
+struct MipCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+};
+
+size_t GetMipSize(PixelFormat format, uint32_t width, uint32_t height, uint32_t mip) {
+    return size_t((std::max)(width >> mip, 1u)) * (std::max)(height >> mip, 1u) * GetPixelSize(format);
+}
+
+FILE *OpenFile(const char *path, const char *mode) {
+    FILE *file;
+#ifdef _WIN32
+    if (fopen_s(&file, path, mode) != 0) {
+        return nullptr;
+    }
+#else
+    file = fopen(path, mode);
+#endif
+    return file;
+}
+
+}
+
+MipCacheSource GetMipCacheSource(const void *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    const uint8_t *bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return { size, hash };
+}
+
+bool BuildMipCache(const char *path, const MipCacheSource &source, const void *pixels, size_t rowPitch,
+                   PixelFormat format, uint32_t width, uint32_t height) {
+    uint32_t pixelSize = GetPixelSize(format);
+    if (pixelSize == 0 || width == 0 || height == 0) {
+        return false;
+    }
+
+    FILE *file = OpenFile(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    MipCacheHeader header = { MipCacheMagic, MipCacheVersion, source.size, source.hash,
+                              uint32_t(format), width, height, GetMipCount(width, height) };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t rowBytes = size_t(width) * pixelSize;
+    for (uint32_t y = 0; y < height && written; y++) {
+        written = fwrite((const uint8_t *) pixels + y * rowPitch, 1, rowBytes, file) == rowBytes;
+    }
+
+    // Each level is made from the one before, which is then no longer needed.
+    std::vector<uint8_t> previous, next;
+    const void *level = pixels;
+    size_t levelPitch = rowPitch;
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    for (uint32_t mip = 1; mip < header.mipCount && written; mip++) {
+        uint32_t nextWidth = (std::max)(levelWidth / 2, 1u);
+        uint32_t nextHeight = (std::max)(levelHeight / 2, 1u);
+        next.resize(size_t(nextWidth) * nextHeight * pixelSize);
+        written = DownsamplePixels(level, levelPitch, next.data(), size_t(nextWidth) * pixelSize, format, levelWidth, levelHeight) &&
+                  fwrite(next.data(), 1, next.size(), file) == next.size();
+        previous.swap(next);
+        level = previous.data();
+        levelPitch = size_t(nextWidth) * pixelSize;
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+    return fclose(file) == 0 && written;
+}
+
+bool MipCache::Open(const char *path, const MipCacheSource &source, PixelFormat format, uint32_t width, uint32_t height) {
+    Close();
+    if (!file.Open(path) || file.GetSize() < sizeof(MipCacheHeader)) {
+        Close();
+        return false;
+    }
+
+    MipCacheHeader header;
+    memcpy(&header, file.GetData(), sizeof(header));
+    uint32_t expectedMipCount = ::GetMipCount(width, height);
+    size_t expectedSize = sizeof(header);
+    for (uint32_t mip = 0; mip < expectedMipCount; mip++) {
+        expectedSize += GetMipSize(format, width, height, mip);
+    }
+    if (header.magic != MipCacheMagic || header.version != MipCacheVersion || header.sourceSize != source.size ||
+        header.sourceHash != source.hash || header.format != uint32_t(format) || header.width != width ||
+        header.height != height || header.mipCount != expectedMipCount || file.GetSize() != expectedSize) {
+        Close();
+        return false;
+    }
+
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    mipCount = expectedMipCount;
+    return true;
+}
+
+void MipCache::Close() {
+    file.Close();
+    format = PixelFormat::Unknown;
+    width = 0;
+    height = 0;
+    mipCount = 0;
+}
+
+bool MipCache::ReadMip(uint32_t mip, void *pixels, size_t rowPitch) const {
+    if (mip >= mipCount) {
+        return false;
+    }
+
+    const uint8_t *level = (const uint8_t *) file.GetData() + sizeof(MipCacheHeader);
+    for (uint32_t i = 0; i < mip; i++) {
+        level += GetMipSize(format, width, height, i);
+    }
+    size_t rowBytes = size_t((std::max)(width >> mip, 1u)) * GetPixelSize(format);
+    uint32_t rows = (std::max)(height >> mip, 1u);
+    for (uint32_t y = 0; y < rows; y++) {
+        memcpy((uint8_t *) pixels + y * rowPitch, level + y * rowBytes, rowBytes);
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "PixelFormat.h"
+
+// Identifies the image a mip cache was built from.
+struct MipCacheSource {
+    uint64_t size;
+    uint64_t hash;  // FNV-1a of the whole file.
+};
+
+MipCacheSource GetMipCacheSource(const void *data, size_t size);
+
+// Writes the full mip chain of an image to a file, the finest level first and every level
+// tightly packed. Levels are made with DownsamplePixels(); only two are in memory at a
+// time. pixels is the finest level, rows rowPitch bytes apart.
+bool BuildMipCache(const char *path, const MipCacheSource &source, const void *pixels, size_t rowPitch,
+                   PixelFormat format, uint32_t width, uint32_t height);
+
+// A mip cache file, mapped so that each level is read from disk when it is first copied.
+// Open() rejects files that are truncated or were built from another image or format.
+class MipCache {
+public:
+    bool Open(const char *path, const MipCacheSource &source, PixelFormat format, uint32_t width, uint32_t height);
+    void Close();
+
+    uint32_t GetMipCount() const { return mipCount; }
+
+    // Copies a level into rows rowPitch bytes apart. Safe to call from any thread.
+    bool ReadMip(uint32_t mip, void *pixels, size_t rowPitch) const;
+
+private:
+    MappedFile file;
+    PixelFormat format = PixelFormat::Unknown;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+};
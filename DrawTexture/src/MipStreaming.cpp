@@ -0,0 +1,142 @@
+#include "MipStreaming.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t GetMipCount(uint32_t width, uint32_t height) {
+    uint32_t size = (std::max)(width, height);
+    uint32_t count = 1;
+    while (size > 1) {
+        size >>= 1;
+        count++;
+    }
+    return count;
+}
+
+uint32_t GetDesiredMip(uint32_t width, uint32_t height, uint32_t mipCount, float screenWidth, float screenHeight, float bias) {
+    if (!(screenWidth > 0.0f) || !(screenHeight > 0.0f)) {
+        return mipCount - 1;
+    }
+
+    // Texels per pixel along the more minified axis, as the sampler would pick the level.
+    float ratio = (std::max)(width / screenWidth, height / screenHeight);
+    float lod = std::log2((std::max)(ratio, 1.0f)) + bias;
+    if (!(lod > 0.0f)) {
+        return 0;
+    }
+    return (std::min)((uint32_t) lod, mipCount - 1);
+}
+
+StreamingHandle MipStreamingPolicy::Add(uint32_t mipCount, uint32_t residentMip) {
+    StreamingHandle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = (StreamingHandle) textures.size();
+        textures.emplace_back();
+    }
+
+    Texture &texture = textures[handle];
+    texture.mipCount = mipCount;
+    texture.residentMip = (std::min)(residentMip, mipCount);
+    texture.desiredMip = texture.residentMip;
+    texture.requestedMip = mipCount;
+    texture.coverage = 0.0f;
+    texture.requestValid = false;
+    texture.live = true;
+    return handle;
+}
+
+void MipStreamingPolicy::Remove(StreamingHandle handle) {
+    Texture &texture = textures[handle];
+    EndRequest(texture);
+    texture.live = false;
+    freeHandles.push_back(handle);
+}
+
+void MipStreamingPolicy::SetDesiredMip(StreamingHandle handle, uint32_t mip, float coverage) {
+    Texture &texture = textures[handle];
+    texture.desiredMip = (std::min)(mip, texture.mipCount - 1);
+    texture.coverage = coverage;
+}
+
+void MipStreamingPolicy::Update(uint32_t maxInFlight, std::vector<MipRequest> &requests) {
+    candidates.clear();
+
+    for (StreamingHandle handle = 0; handle < (StreamingHandle) textures.size(); handle++) {
+        Texture &texture = textures[handle];
+        if (!texture.live) {
+            continue;
+        }
+
+        // Drop levels that are two or more steps finer than needed; one step of slack keeps
+        // a texture that hovers around a level boundary from reloading it.
+        if (texture.residentMip + 1 < texture.desiredMip) {
+            texture.residentMip = texture.desiredMip - 1;
+        }
+
+        if (texture.requestedMip != texture.mipCount || texture.residentMip <= texture.desiredMip) {
+            continue;
+        }
+
+        // Coverage breaks ties; the small constant keeps invisible textures ordered by distance.
+        float missing = float(texture.residentMip - texture.desiredMip);
+        candidates.push_back({ handle, texture.residentMip - 1, missing * (texture.coverage + 1.0f / 1024.0f) });
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const MipRequest &a, const MipRequest &b) {
+        return a.priority > b.priority;
+    });
+
+    for (const MipRequest &request : candidates) {
+        if (inFlight >= maxInFlight) {
+            break;
+        }
+        Texture &texture = textures[request.texture];
+        texture.requestedMip = request.mip;
+        texture.requestValid = true;
+        inFlight++;
+        requests.push_back(request);
+    }
+}
+
+bool MipStreamingPolicy::Complete(StreamingHandle handle, uint32_t mip) {
+    Texture &texture = textures[handle];
+    if (!texture.live || texture.requestedMip != mip) {
+        return false;
+    }
+
+    bool valid = texture.requestValid && mip + 1 == texture.residentMip;
+    EndRequest(texture);
+    if (valid) {
+        texture.residentMip = mip;
+    }
+    return valid;
+}
+
+void MipStreamingPolicy::Cancel(StreamingHandle handle, uint32_t mip) {
+    Texture &texture = textures[handle];
+    if (texture.live && texture.requestedMip == mip) {
+        EndRequest(texture);
+    }
+}
+
+void MipStreamingPolicy::Evict(StreamingHandle handle, uint32_t mip) {
+    Texture &texture = textures[handle];
+    if (!texture.live) {
+        return;
+    }
+    if (texture.requestedMip <= mip) {
+        texture.requestValid = false;
+    }
+    texture.residentMip = (std::max)(texture.residentMip, (std::min)(mip + 1, texture.mipCount));
+}
+
+void MipStreamingPolicy::EndRequest(Texture &texture) {
+    if (texture.requestedMip != texture.mipCount) {
+        texture.requestedMip = texture.mipCount;
+        texture.requestValid = false;
+        inFlight--;
+    }
+}
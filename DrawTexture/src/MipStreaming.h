@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using StreamingHandle = uint32_t;
+
+struct MipRequest {
+    StreamingHandle texture;
+    uint32_t mip;
+    float priority;
+};
+
+// Levels of a full mip chain down to 1x1.
+uint32_t GetMipCount(uint32_t width, uint32_t height);
+
+// Finest mip whose texels are no smaller than a screen pixel when the texture covers
+// screenWidth x screenHeight pixels. bias > 0 picks coarser levels.
+uint32_t GetDesiredMip(uint32_t width, uint32_t height, uint32_t mipCount, float screenWidth, float screenHeight, float bias = 0.0f);
+
+// Decides which mip levels to load. Every texture has a resident mip (the finest level
+// loaded, everything coarser is loaded too) and a desired mip, set from the screen-space
+// size or from sampler feedback. Levels are loaded one at a time from coarse to fine, so
+// every completed request improves the image. Requests go to the textures that are
+// furthest from their desired mip, weighted by how much of the screen they cover.
+// Levels more than one step finer than desired are dropped.
+class MipStreamingPolicy {
+public:
+    static constexpr StreamingHandle InvalidHandle = UINT32_MAX;
+
+    StreamingHandle Add(uint32_t mipCount, uint32_t residentMip);
+    void Remove(StreamingHandle handle);
+
+    // coverage is the fraction of the screen the texture covers, 0 when it is not visible.
+    void SetDesiredMip(StreamingHandle handle, uint32_t mip, float coverage);
+
+    // Appends up to maxInFlight - GetInFlightCount() new requests, most important first.
+    // Each texture has at most one request in flight.
+    void Update(uint32_t maxInFlight, std::vector<MipRequest> &requests);
+
+    // Returns true when the level became resident. A request whose level was evicted
+    // while loading, or whose texture dropped below it, is discarded.
+    bool Complete(StreamingHandle handle, uint32_t mip);
+    // The request could not be started or failed to load; it is retried by a later Update().
+    void Cancel(StreamingHandle handle, uint32_t mip);
+    // Part of the level was paged out; it and every finer level are no longer resident.
+    void Evict(StreamingHandle handle, uint32_t mip);
+
+    uint32_t GetResidentMip(StreamingHandle handle) const { return textures[handle].residentMip; }
+    uint32_t GetDesiredMip(StreamingHandle handle) const { return textures[handle].desiredMip; }
+    // The level being loaded, or GetMipCount(handle) when there is none.
+    uint32_t GetRequestedMip(StreamingHandle handle) const { return textures[handle].requestedMip; }
+    uint32_t GetMipCount(StreamingHandle handle) const { return textures[handle].mipCount; }
+    uint32_t GetInFlightCount() const { return inFlight; }
+
+private:
+    struct Texture {
+        uint32_t mipCount;
+        uint32_t residentMip;
+        uint32_t desiredMip;
+        uint32_t requestedMip;
+        float coverage;
+        bool requestValid;
+        bool live;
+    };
+
+    void EndRequest(Texture &texture);
+
+    std::vector<Texture> textures;
+    std::vector<StreamingHandle> freeHandles;
+    std::vector<MipRequest> candidates;
+    uint32_t inFlight = 0;
+};
@@ -0,0 +1,27 @@
+struct OverlayInput {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+    float4 color : COLOR;
+};
+
+// OverlayQuad in OverlayBatch.h.
+struct OverlayQuad {
+    float4 rect;  // left, top, right, bottom in pixels.
+    uint cell;
+    uint color;   // RGBA8, red in the low byte.
+};
+
+// The atlas layout of OverlayFont.h.
+static const uint AtlasColumns = 16;
+static const float CellSize = 8.0f;
+static const float2 GlyphSize = float2(5.0f, 7.0f);
+static const float2 AtlasSize = float2(128.0f, 48.0f);
+static const uint SolidCell = 95;
+
+cbuffer OverlayConstants : register(b0) {
+    float2 g_inverseTargetSize;
+};
+
+StructuredBuffer<OverlayQuad> g_quads : register(t0);
+Texture2D<float> g_atlas : register(t1);
+SamplerState g_sampler : register(s0);
@@ -0,0 +1,97 @@
+#include "OverlayAtlas.h"
+
+#include <cstring>
+#include <vector>
+
+#include "OverlayFont.h"
+
+HRESULT OverlayAtlas::Init(ID3D12Device *device, D3D12_CPU_DESCRIPTOR_HANDLE srv) {
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Alignment          = 0;
+    desc.Width              = OverlayAtlasWidth;
+    desc.Height             = OverlayAtlasHeight;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = 1;
+    desc.Format             = DXGI_FORMAT_R8_UNORM;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    HRESULT hr = device->CreateCommittedResource(
+        &properties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&texture));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    UINT64 uploadSize;
+    device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, nullptr, nullptr, &uploadSize);
+
+    properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Width              = uploadSize;
+    desc.Height             = 1;
+    desc.Format             = DXGI_FORMAT_UNKNOWN;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    hr = device->CreateCommittedResource(
+        &properties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadBuffer));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    // The atlas rows are copied at the footprint's row pitch.
+    std::vector<uint8_t> pixels;
+    BuildOverlayAtlas(pixels);
+    BYTE *data;
+    hr = uploadBuffer->Map(0, nullptr, (void **) &data);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    for (UINT y = 0; y < OverlayAtlasHeight; y++) {
+        memcpy(data + footprint.Offset + size_t(y) * footprint.Footprint.RowPitch, pixels.data() + size_t(y) * OverlayAtlasWidth, OverlayAtlasWidth);
+    }
+    uploadBuffer->Unmap(0, nullptr);
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
+    srvDesc.Format                  = DXGI_FORMAT_R8_UNORM;
+    srvDesc.ViewDimension           = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Texture2D               = { };
+    srvDesc.Texture2D.MipLevels     = 1;
+    device->CreateShaderResourceView(texture.Get(), &srvDesc, srv);
+
+    return S_OK;
+}
+
+void OverlayAtlas::Upload(ID3D12GraphicsCommandList *commandList) {
+    D3D12_TEXTURE_COPY_LOCATION src;
+    src.pResource       = uploadBuffer.Get();
+    src.Type            = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+    src.PlacedFootprint = footprint;
+
+    D3D12_TEXTURE_COPY_LOCATION dst;
+    dst.pResource        = texture.Get();
+    dst.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+    dst.SubresourceIndex = 0;
+
+    commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+    D3D12_RESOURCE_BARRIER barrier;
+    barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Flags                  = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.Transition.pResource   = texture.Get();
+    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    barrier.Transition.StateAfter  = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    commandList->ResourceBarrier(1, &barrier);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+// The glyph atlas of OverlayFont.h as an R8 texture. Init() creates the texture and an
+// upload buffer already holding the atlas; the copy is recorded with the other startup
+// uploads, and the upload buffer is released once they have completed.
+class OverlayAtlas {
+public:
+    // Writes the SRV of the atlas to srv.
+    HRESULT Init(ID3D12Device *device, D3D12_CPU_DESCRIPTOR_HANDLE srv);
+
+    // Records the copy and the transition to PIXEL_SHADER_RESOURCE.
+    void Upload(ID3D12GraphicsCommandList *commandList);
+    // Call once the list passed to Upload() has completed.
+    void EndUpload() { uploadBuffer.Reset(); }
+
+    ID3D12Resource *GetTexture() const { return texture.Get(); }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+    Microsoft::WRL::ComPtr<ID3D12Resource> uploadBuffer;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+};
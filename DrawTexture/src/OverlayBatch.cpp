@@ -0,0 +1,63 @@
+#include "OverlayBatch.h"
+
+#include <algorithm>
+
+void OverlayBatch::AddRect(float x, float y, float width, float height, uint32_t color) {
+    if (width <= 0.0f || height <= 0.0f) {
+        return;
+    }
+    quads.push_back({ x, y, x + width, y + height, OverlaySolidCell, color });
+}
+
+float OverlayBatch::AddText(float x, float y, const char *text, uint32_t color, float scale) {
+    float glyphWidth = OverlayGlyphWidth * scale;
+    float glyphHeight = OverlayGlyphHeight * scale;
+    float penX = x;
+    for (const char *c = text; *c; c++) {
+        if (*c == '\n') {
+            penX = x;
+            y += OverlayLineHeight * scale;
+            continue;
+        }
+        // Spaces only advance.
+        if (*c != ' ') {
+            quads.push_back({ penX, y, penX + glyphWidth, y + glyphHeight, GetOverlayCell(*c), color });
+        }
+        penX += OverlayAdvance * scale;
+    }
+    return penX;
+}
+
+float OverlayBatch::MeasureText(const char *text, float scale) {
+    size_t longest = 0;
+    size_t length = 0;
+    for (const char *c = text; *c; c++) {
+        if (*c == '\n') {
+            length = 0;
+            continue;
+        }
+        length++;
+        longest = (std::max)(longest, length);
+    }
+    // The space after the last glyph is not part of the text.
+    return longest ? (longest * OverlayAdvance - 1.0f) * scale : 0.0f;
+}
+
+void OverlayBatch::AddGraph(float x, float y, float width, float height, const float *values, size_t count, size_t first,
+                            float maxValue, uint32_t color) {
+    if (count == 0 || maxValue <= 0.0f) {
+        return;
+    }
+    float barWidth = width / count;
+    float bottom = y + height;
+    float scale = height / maxValue;
+    for (size_t i = 0; i < count; i++) {
+        float value = values[(first + i) % count];
+        float barHeight = (std::min)(value * scale, height);
+        if (barHeight <= 0.0f) {
+            continue;
+        }
+        float left = x + barWidth * i;
+        quads.push_back({ left, bottom - barHeight, left + barWidth, bottom, OverlaySolidCell, color });
+    }
+}
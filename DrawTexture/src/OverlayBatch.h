@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "OverlayFont.h"
+
+// A screen-space rectangle of the overlay, as read by OverlayVertexShader.hlsl. The
+// vertex shader expands each quad to two triangles, so text, rectangles and graphs of a
+// frame are one structured buffer and one draw.
+struct OverlayQuad {
+    float left, top, right, bottom;  // Pixels from the top-left corner of the target.
+    uint32_t cell;                   // Atlas cell; OverlaySolidCell fills the quad.
+    uint32_t color;                  // RGBA8, red in the low byte.
+};
+
+static_assert(sizeof(OverlayQuad) == 24, "OverlayQuad must match the layout in Overlay.hlsli.");
+
+constexpr float OverlayAdvance = float(OverlayGlyphWidth + 1);
+constexpr float OverlayLineHeight = float(OverlayGlyphHeight + 3);
+
+constexpr uint32_t MakeOverlayColor(uint32_t r, uint32_t g, uint32_t b, uint32_t a = 255) {
+    return r | g << 8 | b << 16 | a << 24;
+}
+
+// Collects the quads of a frame. Clear() keeps the memory, so a HUD of the same size
+// allocates nothing after the first frame. Quads are drawn in the order they are added.
+class OverlayBatch {
+public:
+    void Clear() { quads.clear(); }
+
+    void AddRect(float x, float y, float width, float height, uint32_t color);
+    // Lays out text from the top-left corner (x, y); '\n' starts a new line at x.
+    // Glyphs are scaled by scale, which should be an integer for sharp text. Returns
+    // the x after the last character.
+    float AddText(float x, float y, const char *text, uint32_t color, float scale = 1.0f);
+    // Width of the longest line of text.
+    static float MeasureText(const char *text, float scale = 1.0f);
+    // A bar per value from the bottom of the rectangle, oldest at the left. values is a
+    // ring of count values whose oldest is at first; values at or above maxValue fill
+    // the height.
+    void AddGraph(float x, float y, float width, float height, const float *values, size_t count, size_t first,
+                  float maxValue, uint32_t color);
+
+    const std::vector<OverlayQuad> &GetQuads() const { return quads; }
+    size_t GetQuadCount() const { return quads.size(); }
+
+private:
+    std::vector<OverlayQuad> quads;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Built-in 5x7 bitmap font for the printable ASCII range, baked into a small
+// single-channel atlas. No font file is needed, and glyphs are sampled with point
+// filtering at integer scales, so the overlay stays sharp without mips.
+//
+// The atlas is a grid of OverlayCellSize cells, OverlayAtlasColumns per row, one per
+// character from OverlayFirstChar to OverlayLastChar. The cell after the last character
+// is solid, so rectangles and graphs are drawn with the same texture and pipeline.
+constexpr uint32_t OverlayGlyphWidth = 5;
+constexpr uint32_t OverlayGlyphHeight = 7;
+constexpr uint32_t OverlayCellSize = 8;
+constexpr uint32_t OverlayAtlasColumns = 16;
+constexpr char OverlayFirstChar = ' ';
+constexpr char OverlayLastChar = '~';
+constexpr uint32_t OverlayGlyphCount = uint32_t(OverlayLastChar - OverlayFirstChar + 1);
+constexpr uint32_t OverlaySolidCell = OverlayGlyphCount;
+constexpr uint32_t OverlayAtlasWidth = OverlayAtlasColumns * OverlayCellSize;
+constexpr uint32_t OverlayAtlasHeight = (OverlayGlyphCount + 1 + OverlayAtlasColumns - 1) / OverlayAtlasColumns * OverlayCellSize;
+
+// Coverage of every texel, 0 or 255, OverlayAtlasWidth bytes per row.
+void BuildOverlayAtlas(std::vector<uint8_t> &pixels);
+
+// The cell of a character; characters outside the font map to '?'.
+inline uint32_t GetOverlayCell(char c) {
+    if (c < OverlayFirstChar || c > OverlayLastChar) {
+        c = '?';
+    }
+    return uint32_t(c - OverlayFirstChar);
+}
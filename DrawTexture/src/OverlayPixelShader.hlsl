@@ -0,0 +1,7 @@
+// Shader Model 5.0
+#include "Overlay.hlsli"
+
+float4 Main(OverlayInput input) : SV_TARGET {
+    // The atlas holds coverage only; the color comes from the quad.
+    return float4(input.color.rgb, input.color.a * g_atlas.Sample(g_sampler, input.uv));
+}
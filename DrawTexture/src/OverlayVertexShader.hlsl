@@ -0,0 +1,23 @@
+// Shader Model 5.0
+#include "Overlay.hlsli"
+
+// Six vertices per quad, read from g_quads without vertex buffers.
+OverlayInput Main(uint vertexId : SV_VertexID) {
+    static const uint corners[6] = { 0, 1, 2, 2, 1, 3 };
+
+    OverlayQuad quad = g_quads[vertexId / 6];
+    uint corner = corners[vertexId % 6];
+    float2 t = float2(corner & 1, corner >> 1);
+    float2 pixel = lerp(quad.rect.xy, quad.rect.zw, t);
+
+    // Glyphs map their cell's corners to the quad; the solid cell is sampled at its center.
+    float2 cellOrigin = float2(quad.cell % AtlasColumns, quad.cell / AtlasColumns) * CellSize;
+    float2 texel = quad.cell == SolidCell ? cellOrigin + CellSize * 0.5f : cellOrigin + t * GlyphSize;
+
+    OverlayInput result;
+    result.position = float4(pixel * g_inverseTargetSize * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    result.uv = texel / AtlasSize;
+    result.color = float4(quad.color & 0xFF, (quad.color >> 8) & 0xFF, (quad.color >> 16) & 0xFF, quad.color >> 24) / 255.0f;
+
+    return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of worker threads used by ParallelFor.
+inline unsigned GetWorkerCount() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+// Calls func(begin, end) for contiguous ranges of [0, count) on all cores and waits for completion.
+// Ranges are at least minRange long so that small inputs do not pay for thread start-up.
+template <typename Func>
+void ParallelFor(size_t count, size_t minRange, Func func) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t workers = (std::min<size_t>)(GetWorkerCount(), (count + minRange - 1) / (std::max<size_t>)(minRange, 1));
+    if (workers <= 1) {
+        func(size_t(0), count);
+        return;
+    }
+
+    size_t range = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+
+    for (size_t i = 1; i < workers; i++) {
+        size_t begin = i * range;
+        size_t end = (std::min)(count, begin + range);
+        if (begin < end) {
+            threads.emplace_back([=, &func]() { func(begin, end); });
+        }
+    }
+
+    func(size_t(0), (std::min)(count, range));
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,109 @@
+#include "PerfHud.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+constexpr float TargetFrameTime = 1000.0f / 60.0f;
+constexpr float GraphHeight = 40.0f;
+constexpr float Padding = 4.0f;
+
+const uint32_t BackgroundColor = MakeOverlayColor(0, 0, 0, 160);
+const uint32_t TextColor = MakeOverlayColor(255, 255, 255);
+const uint32_t CpuColor = MakeOverlayColor(90, 170, 255);
+const uint32_t GpuColor = MakeOverlayColor(255, 160, 60);
+const uint32_t TargetColor = MakeOverlayColor(120, 255, 120, 200);
+
+// Appends to a fixed buffer; output that does not fit is cut off.
+void Append(char *buffer, size_t size, size_t &length, const char *format, ...) {
+    if (length + 1 >= size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+    if (written > 0) {
+        length = (std::min)(length + size_t(written), size - 1);
+    }
+}
+
+} // namespace
+
+void PerfHud::SetPasses(const std::vector<std::string> &names) {
+    passNames.assign(names.begin(), names.begin() + (std::min)(names.size(), size_t(MaxPasses)));
+}
+
+void PerfHud::AddFrame(float cpuTime, float gpuTime, const float *passTimes, const PerfHudCounters &counters) {
+    cpuTimes[next] = cpuTime;
+    gpuTimes[next] = gpuTime;
+    for (size_t i = 0; i < passNames.size(); i++) {
+        this->passTimes[i][next] = passTimes ? passTimes[i] : 0.0f;
+    }
+    this->counters = counters;
+    next = (next + 1) % HistorySize;
+    frameCount++;
+}
+
+void PerfHud::Build(OverlayBatch &batch, float x, float y, float scale) {
+    auto start = std::chrono::steady_clock::now();
+
+    float graphMax = TargetFrameTime * 2.0f;
+    for (size_t i = 0; i < HistorySize; i++) {
+        graphMax = (std::max)(graphMax, (std::max)(cpuTimes[i], gpuTimes[i]));
+    }
+
+    float cpuTime = GetAverageCpuTime();
+    char text[512];
+    size_t length = 0;
+    Append(text, sizeof(text), length, "FPS %5.1f  CPU %5.2f ms  GPU %5.2f ms\n",
+        cpuTime > 0.0f ? 1000.0f / cpuTime : 0.0f, cpuTime, GetAverageGpuTime());
+    for (size_t i = 0; i < passNames.size(); i++) {
+        Append(text, sizeof(text), length, "%s%s %.2f", i ? "  " : "", passNames[i].c_str(), GetAverage(passTimes[i]));
+    }
+    if (!passNames.empty()) {
+        Append(text, sizeof(text), length, " ms\n");
+    }
+    Append(text, sizeof(text), length, "draws %u  barriers %u  states %u / %u\n",
+        counters.drawCount, counters.barrierCount, counters.issuedStateCount, counters.issuedStateCount + counters.elidedStateCount);
+    Append(text, sizeof(text), length, "resident %u / %u MB  arena %u / %u KB\n",
+        unsigned(counters.residentBytes >> 20), unsigned(counters.residencyBudget >> 20),
+        unsigned(counters.arenaBytes >> 10), unsigned(counters.arenaCapacity >> 10));
+    Append(text, sizeof(text), length, "constants %u KB  hud %.3f ms  graph %.0f ms",
+        unsigned(counters.constantBytes >> 10), buildTime, graphMax);
+
+    size_t lineCount = 1 + std::count(text, text + length, '\n');
+    float padding = Padding * scale;
+    float textHeight = (lineCount * OverlayLineHeight - (OverlayLineHeight - OverlayGlyphHeight)) * scale;
+    float width = (std::max)(OverlayBatch::MeasureText(text, scale), float(HistorySize) * scale);
+    float graphHeight = GraphHeight * scale;
+
+    // Back to front: the background, the graph, then the text.
+    batch.AddRect(x, y, width + 2.0f * padding, textHeight + graphHeight + 3.0f * padding, BackgroundColor);
+
+    // CPU bars behind GPU bars; the GPU time is normally the shorter of the two. The
+    // line marks 60 Hz, and the top of the graph is the longest frame in the history.
+    float graphX = x + padding;
+    float graphY = y + 2.0f * padding + textHeight;
+    batch.AddGraph(graphX, graphY, width, graphHeight, cpuTimes, HistorySize, next, graphMax, CpuColor);
+    batch.AddGraph(graphX, graphY, width, graphHeight, gpuTimes, HistorySize, next, graphMax, GpuColor);
+    batch.AddRect(graphX, graphY + graphHeight * (1.0f - TargetFrameTime / graphMax), width, scale, TargetColor);
+    batch.AddText(x + padding, y + padding, text, TextColor, scale);
+
+    buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+float PerfHud::GetAverage(const float *history) const {
+    size_t count = (std::min)(frameCount, size_t(AverageFrames));
+    if (count == 0) {
+        return 0.0f;
+    }
+    float sum = 0.0f;
+    for (size_t i = 1; i <= count; i++) {
+        sum += history[(next + HistorySize - i) % HistorySize];
+    }
+    return sum / count;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OverlayBatch.h"
+
+// Figures of one frame that are shown as they are, without history.
+struct PerfHudCounters {
+    uint32_t drawCount;
+    uint32_t barrierCount;
+    uint32_t issuedStateCount;
+    uint32_t elidedStateCount;
+    uint64_t residentBytes;
+    uint64_t residencyBudget;
+    uint64_t arenaBytes;      // High-water mark of the frame arenas.
+    uint64_t arenaCapacity;
+    uint64_t constantBytes;   // Constant memory allocated by the frame.
+};
+
+// Performance overlay: a history of CPU and GPU frame times drawn as a graph, averaged
+// frame and pass times, and the counters of the last frame. Only keeps numbers and lays
+// them out into an OverlayBatch, so it runs and can be measured without a device.
+class PerfHud {
+public:
+    static constexpr size_t HistorySize = 120;
+    static constexpr size_t AverageFrames = 30;   // Averaged text values, so they stay readable.
+    static constexpr size_t MaxPasses = 8;
+
+    // Names the GPU passes whose times AddFrame() receives, in that order.
+    void SetPasses(const std::vector<std::string> &names);
+
+    // Milliseconds: cpuTime between the starts of two frames, gpuTime and passTimes from
+    // timestamps. passTimes holds one value per pass and may be null.
+    void AddFrame(float cpuTime, float gpuTime, const float *passTimes, const PerfHudCounters &counters);
+
+    // Appends the HUD with its top-left corner at (x, y).
+    void Build(OverlayBatch &batch, float x, float y, float scale = 1.0f);
+
+    float GetAverageCpuTime() const { return GetAverage(cpuTimes); }
+    float GetAverageGpuTime() const { return GetAverage(gpuTimes); }
+    size_t GetFrameCount() const { return frameCount; }
+    double GetBuildTime() const { return buildTime; }  // Milliseconds spent in the last Build().
+
+private:
+    float GetAverage(const float *history) const;
+
+    float cpuTimes[HistorySize] = { };
+    float gpuTimes[HistorySize] = { };
+    float passTimes[MaxPasses][HistorySize] = { };
+    std::vector<std::string> passNames;
+    PerfHudCounters counters = { };
+    size_t next = 0;          // Ring position of the next frame; the oldest frame once full.
+    size_t frameCount = 0;
+    double buildTime = 0.0;
+};
@@ -0,0 +1,299 @@
+#include "PixelFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "BatchMath.h"
+#include "Parallel.h"
+
+namespace {
+
+float SrgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float value) {
+    value = !(value > 0.0f) ? 0.0f : value > 1.0f ? 1.0f : value;
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+struct TransferTables {
+    float unormToFloat[256];
+    float srgbToFloat[256];
+    uint8_t srgbToLinear[256];
+    uint8_t linearToSrgb[256];
+};
+
+const TransferTables &GetTransferTables() {
+    static const TransferTables tables = [] {
+        TransferTables t;
+        for (int i = 0; i < 256; i++) {
+            float value = i * (1.0f / 255.0f);
+            t.unormToFloat[i] = value;
+            t.srgbToFloat[i] = SrgbToLinear(value);
+            t.srgbToLinear[i] = FloatToUnorm8(t.srgbToFloat[i]);
+            t.linearToSrgb[i] = FloatToUnorm8(LinearToSrgb(value));
+        }
+        return t;
+    }();
+    return tables;
+}
+
+inline bool IsColor8(PixelFormat format) {
+    return format == PixelFormat::R8G8B8A8 || format == PixelFormat::B8G8R8A8;
+}
+
+// The general path: every pixel goes through float RGBA.
+void LoadPixel(PixelFormat format, const uint8_t *p, float rgba[4]) {
+    switch (format) {
+    case PixelFormat::L8:
+        rgba[0] = rgba[1] = rgba[2] = p[0] * (1.0f / 255.0f);
+        rgba[3] = 1.0f;
+        break;
+    case PixelFormat::L8A8:
+        rgba[0] = rgba[1] = rgba[2] = p[0] * (1.0f / 255.0f);
+        rgba[3] = p[1] * (1.0f / 255.0f);
+        break;
+    case PixelFormat::R8G8B8A8:
+    case PixelFormat::B8G8R8A8: {
+        bool bgra = format == PixelFormat::B8G8R8A8;
+        rgba[0] = p[bgra ? 2 : 0] * (1.0f / 255.0f);
+        rgba[1] = p[1] * (1.0f / 255.0f);
+        rgba[2] = p[bgra ? 0 : 2] * (1.0f / 255.0f);
+        rgba[3] = p[3] * (1.0f / 255.0f);
+        break;
+    }
+    case PixelFormat::R16G16B16A16Float: {
+        uint16_t half[4];
+        memcpy(half, p, sizeof(half));
+        for (int i = 0; i < 4; i++) {
+            rgba[i] = HalfToFloat(half[i]);
+        }
+        break;
+    }
+    default:
+        // ConvertPixels() rejects Unknown; transparent black keeps the output defined anyway.
+        rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0.0f;
+        break;
+    }
+}
+
+void StorePixel(PixelFormat format, const float rgba[4], uint8_t *p) {
+    switch (format) {
+    case PixelFormat::L8:
+    case PixelFormat::L8A8:
+        // Rec. 709 luma; exact for images that were gray to begin with.
+        p[0] = FloatToUnorm8(rgba[0] * 0.2126f + rgba[1] * 0.7152f + rgba[2] * 0.0722f);
+        if (format == PixelFormat::L8A8) {
+            p[1] = FloatToUnorm8(rgba[3]);
+        }
+        break;
+    case PixelFormat::R8G8B8A8:
+    case PixelFormat::B8G8R8A8: {
+        bool bgra = format == PixelFormat::B8G8R8A8;
+        p[bgra ? 2 : 0] = FloatToUnorm8(rgba[0]);
+        p[1] = FloatToUnorm8(rgba[1]);
+        p[bgra ? 0 : 2] = FloatToUnorm8(rgba[2]);
+        p[3] = FloatToUnorm8(rgba[3]);
+        break;
+    }
+    case PixelFormat::R16G16B16A16Float: {
+        uint16_t half[4];
+        for (int i = 0; i < 4; i++) {
+            half[i] = FloatToHalf(rgba[i]);
+        }
+        memcpy(p, half, sizeof(half));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void ConvertRowGeneric(const uint8_t *src, PixelFormat srcFormat, uint8_t *dst, PixelFormat dstFormat, uint32_t width, uint32_t conversion) {
+    uint32_t srcSize = GetPixelSize(srcFormat);
+    uint32_t dstSize = GetPixelSize(dstFormat);
+
+    for (uint32_t x = 0; x < width; x++, src += srcSize, dst += dstSize) {
+        float rgba[4];
+        LoadPixel(srcFormat, src, rgba);
+        for (int i = 0; i < 3; i++) {
+            if (conversion & PixelConversionSrgbToLinear) {
+                rgba[i] = SrgbToLinear(rgba[i]);
+            }
+            if (conversion & PixelConversionPremultiplyAlpha) {
+                rgba[i] *= rgba[3];
+            }
+            if (conversion & PixelConversionLinearToSrgb) {
+                rgba[i] = LinearToSrgb(rgba[i]);
+            }
+        }
+        StorePixel(dstFormat, rgba, dst);
+    }
+}
+
+// 8-bit to 8-bit sRGB transfer through a table. Table lookups do not vectorize usefully
+// without a gather, so there is no SIMD variant.
+void ApplyTransferTable(const uint8_t *src, uint8_t *dst, uint32_t width, const uint8_t *table, bool swapRedBlue) {
+    for (uint32_t x = 0; x < width; x++, src += 4, dst += 4) {
+        uint8_t r = table[src[0]];
+        uint8_t b = table[src[2]];
+        dst[0] = swapRedBlue ? b : r;
+        dst[1] = table[src[1]];
+        dst[2] = swapRedBlue ? r : b;
+        dst[3] = src[3];
+    }
+}
+
+}
+
+const PixelKernels ScalarPixelKernels = {
+    SwapRedBlueScalar,
+    ExpandL8Scalar,
+    ExpandL8A8Scalar,
+    PremultiplyScalar,
+    UnormToHalfScalar,
+    HalfToUnormScalar,
+};
+
+uint32_t GetPixelSize(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::L8:
+        return 1;
+    case PixelFormat::L8A8:
+        return 2;
+    case PixelFormat::R8G8B8A8:
+    case PixelFormat::B8G8R8A8:
+        return 4;
+    case PixelFormat::R16G16B16A16Float:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+const PixelKernels &GetPixelKernels() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    if (GetSimdLevel() >= SimdLevel::Avx2) {
+        return Avx2PixelKernels;
+    }
+#endif
+    return ScalarPixelKernels;
+}
+
+bool ConvertPixels(
+    const void *src, size_t srcPitch, PixelFormat srcFormat,
+    void *dst, size_t dstPitch, PixelFormat dstFormat,
+    uint32_t width, uint32_t height, uint32_t conversion) {
+    if (GetPixelSize(srcFormat) == 0 || GetPixelSize(dstFormat) == 0) {
+        return false;
+    }
+    if ((conversion & PixelConversionSrgbToLinear) && (conversion & PixelConversionLinearToSrgb)) {
+        return false;
+    }
+
+    const PixelKernels &kernels = GetPixelKernels();
+    const TransferTables &tables = GetTransferTables();
+    const bool premultiply = (conversion & PixelConversionPremultiplyAlpha) != 0;
+    const uint32_t transfer = conversion & (PixelConversionSrgbToLinear | PixelConversionLinearToSrgb);
+    const bool swapRedBlue =
+        (srcFormat == PixelFormat::B8G8R8A8 && dstFormat != PixelFormat::B8G8R8A8) ||
+        (srcFormat != PixelFormat::B8G8R8A8 && dstFormat == PixelFormat::B8G8R8A8);
+
+    // Pick the row function once; the float path covers every combination the kernels do not.
+    std::function<void(const uint8_t *, uint8_t *)> convertRow;
+    if (srcFormat == dstFormat && conversion == PixelConversionNone) {
+        size_t rowBytes = size_t(width) * GetPixelSize(srcFormat);
+        convertRow = [=](const uint8_t *s, uint8_t *d) { memcpy(d, s, rowBytes); };
+    } else if (IsColor8(srcFormat) && IsColor8(dstFormat) && transfer == 0) {
+        if (premultiply) {
+            convertRow = [&, width](const uint8_t *s, uint8_t *d) { kernels.premultiply(s, d, width, swapRedBlue); };
+        } else {
+            convertRow = [&, width](const uint8_t *s, uint8_t *d) { kernels.swapRedBlue(s, d, width); };
+        }
+    } else if (IsColor8(srcFormat) && IsColor8(dstFormat) && !premultiply) {
+        const uint8_t *table = transfer == PixelConversionSrgbToLinear ? tables.srgbToLinear : tables.linearToSrgb;
+        convertRow = [=](const uint8_t *s, uint8_t *d) { ApplyTransferTable(s, d, width, table, swapRedBlue); };
+    } else if (srcFormat == PixelFormat::L8 && IsColor8(dstFormat) && transfer == 0) {
+        convertRow = [&, width](const uint8_t *s, uint8_t *d) { kernels.expandL8(s, d, width); };
+    } else if (srcFormat == PixelFormat::L8A8 && IsColor8(dstFormat) && transfer == 0) {
+        convertRow = [&, width](const uint8_t *s, uint8_t *d) { kernels.expandL8A8(s, d, width, premultiply); };
+    } else if (IsColor8(srcFormat) && dstFormat == PixelFormat::R16G16B16A16Float && transfer != PixelConversionLinearToSrgb) {
+        const float *colorToFloat = transfer == PixelConversionSrgbToLinear ? tables.srgbToFloat : tables.unormToFloat;
+        convertRow = [&, width, colorToFloat](const uint8_t *s, uint8_t *d) {
+            kernels.unormToHalf(s, (uint16_t *) d, width, colorToFloat, swapRedBlue, premultiply);
+        };
+    } else if (srcFormat == PixelFormat::R16G16B16A16Float && IsColor8(dstFormat) && conversion == PixelConversionNone) {
+        convertRow = [&, width](const uint8_t *s, uint8_t *d) { kernels.halfToUnorm((const uint16_t *) s, d, width, swapRedBlue); };
+    } else {
+        convertRow = [=](const uint8_t *s, uint8_t *d) { ConvertRowGeneric(s, srcFormat, d, dstFormat, width, conversion); };
+    }
+
+    ParallelFor(height, 16, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            convertRow((const uint8_t *) src + y * srcPitch, (uint8_t *) dst + y * dstPitch);
+        }
+    });
+    return true;
+}
+
+bool DownsamplePixels(
+    const void *src, size_t srcPitch, void *dst, size_t dstPitch,
+    PixelFormat format, uint32_t width, uint32_t height) {
+    bool half = format == PixelFormat::R16G16B16A16Float;
+    uint32_t size = GetPixelSize(format);
+    if (size == 0 || (size > 4 && !half)) {
+        return false;
+    }
+
+    uint32_t dstWidth = (std::max)(width / 2, 1u);
+    uint32_t dstHeight = (std::max)(height / 2, 1u);
+
+    ParallelFor(dstHeight, 16, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) {
+            // The last destination row and column also take the odd source row and column.
+            uint32_t y0 = uint32_t(y) * 2;
+            uint32_t y1 = (std::min)(y0 + 1, height - 1);
+            uint32_t rows = y + 1 == dstHeight && (height & 1) && height > 1 ? 3 : y0 == y1 ? 1 : 2;
+            uint8_t *d = (uint8_t *) dst + y * dstPitch;
+
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                uint32_t x0 = x * 2;
+                uint32_t columns = x + 1 == dstWidth && (width & 1) && width > 1 ? 3 : x0 + 1 < width ? 2 : 1;
+                uint32_t count = rows * columns;
+
+                // Half floats are averaged as floats, every channel alike.
+                if (half) {
+                    for (uint32_t c = 0; c < 4; c++) {
+                        float sum = 0.0f;
+                        for (uint32_t j = 0; j < rows; j++) {
+                            const uint8_t *s = (const uint8_t *) src + (y0 + j) * srcPitch + size_t(x0) * 8 + c * 2;
+                            for (uint32_t i = 0; i < columns; i++) {
+                                uint16_t value;
+                                memcpy(&value, s + i * 8, sizeof(value));
+                                sum += HalfToFloat(value);
+                            }
+                        }
+                        uint16_t value = FloatToHalf(sum / float(count));
+                        memcpy(d + size_t(x) * 8 + c * 2, &value, sizeof(value));
+                    }
+                    continue;
+                }
+
+                for (uint32_t c = 0; c < size; c++) {
+                    uint32_t sum = 0;
+                    for (uint32_t j = 0; j < rows; j++) {
+                        const uint8_t *s = (const uint8_t *) src + (y0 + j) * srcPitch + size_t(x0) * size + c;
+                        for (uint32_t i = 0; i < columns; i++) {
+                            sum += s[i * size];
+                        }
+                    }
+                    d[x * size + c] = (uint8_t) ((sum + count / 2) / count);
+                }
+            }
+        }
+    });
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "PixelFormatKernels.h"
+
+// CPU-side texel layouts. L8 and L8A8 are luminance (and alpha) stored in one or two
+// channels; the GPU view swizzles them back to RGBA.
+enum class PixelFormat {
+    Unknown,
+    L8,
+    L8A8,
+    R8G8B8A8,
+    B8G8R8A8,
+    R16G16B16A16Float,
+};
+
+enum PixelConversion : uint32_t {
+    PixelConversionNone             = 0,
+    PixelConversionSrgbToLinear     = 1 << 0, // Decode sRGB color before anything else.
+    PixelConversionPremultiplyAlpha = 1 << 1,
+    PixelConversionLinearToSrgb     = 1 << 2, // Encode color as sRGB last.
+};
+
+uint32_t GetPixelSize(PixelFormat format);
+
+// Kernels for the current SimdLevel (see BatchMath.h). AVX-512 uses the AVX2 kernels.
+const PixelKernels &GetPixelKernels();
+
+// Converts a width x height image between formats, rows in parallel. Common cases
+// (swizzle, L8/L8A8 expansion, premultiply, 8-bit <-> 16F, 8-bit sRGB transfer) use
+// dedicated kernels; everything else goes through a per-pixel float path.
+bool ConvertPixels(
+    const void *src, size_t srcPitch, PixelFormat srcFormat,
+    void *dst, size_t dstPitch, PixelFormat dstFormat,
+    uint32_t width, uint32_t height, uint32_t conversion = PixelConversionNone);
+
+// Box-filters an image to the next mip level, max(width / 2, 1) x max(height / 2, 1).
+// An odd last row or column is folded into its neighbor. Every format but Unknown works:
+// 8-bit channels are averaged with rounding, half floats as floats.
+bool DownsamplePixels(
+    const void *src, size_t srcPitch, void *dst, size_t dstPitch,
+    PixelFormat format, uint32_t width, uint32_t height);
@@ -0,0 +1,144 @@
+// Compiled with AVX2 enabled (see DrawTexture.vcxproj). Only reached after CPUID reports AVX2 and F16C.
+#include "PixelFormatKernels.h"
+
+#include <immintrin.h>
+
+namespace {
+
+// Byte shuffle that swaps bytes 0 and 2 of every pixel, per 128-bit lane.
+inline __m256i SwapRedBlueMask() {
+    return _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+}
+
+// round(a * b / 255) on 16-bit lanes, exact like MultiplyUnorm8.
+inline __m256i MultiplyUnorm8x16(__m256i a, __m256i b) {
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+void SwapRedBlueAvx2(const uint8_t *src, uint8_t *dst, size_t count) {
+    const __m256i mask = SwapRedBlueMask();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_shuffle_epi8(pixels, mask));
+    }
+    SwapRedBlueScalar(src + i * 4, dst + i * 4, count - i);
+}
+
+void ExpandL8Avx2(const uint8_t *src, uint8_t *dst, size_t count) {
+    const __m256i replicate = _mm256_set1_epi32(0x00010101);
+    const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i l = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (src + i)));
+        __m256i pixels = _mm256_or_si256(_mm256_mullo_epi32(l, replicate), alpha);
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), pixels);
+    }
+    ExpandL8Scalar(src + i, dst + i * 4, count - i);
+}
+
+void ExpandL8A8Avx2(const uint8_t *src, uint8_t *dst, size_t count, bool premultiply) {
+    const __m256i replicate = _mm256_set1_epi32(0x00010101);
+    const __m256i lowByte = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i la = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (src + i * 2)));
+        __m256i l = _mm256_and_si256(la, lowByte);
+        __m256i a = _mm256_srli_epi32(la, 8);
+        if (premultiply) {
+            // 32-bit lanes hold the same values MultiplyUnorm8 computes.
+            __m256i x = _mm256_add_epi32(_mm256_mullo_epi32(l, a), _mm256_set1_epi32(128));
+            l = _mm256_srli_epi32(_mm256_add_epi32(x, _mm256_srli_epi32(x, 8)), 8);
+        }
+        __m256i pixels = _mm256_or_si256(_mm256_mullo_epi32(l, replicate), _mm256_slli_epi32(a, 24));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), pixels);
+    }
+    ExpandL8A8Scalar(src + i * 2, dst + i * 4, count - i, premultiply);
+}
+
+void PremultiplyAvx2(const uint8_t *src, uint8_t *dst, size_t count, bool swapRedBlue) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32((int) 0xFF000000);
+    // Alpha of pixels 0-1 (low half) and 2-3 (high half) of each lane, widened to 16 bits.
+    const __m256i alphaLow = _mm256_setr_epi8(
+        3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1,
+        3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1, 7, -1);
+    const __m256i alphaHigh = _mm256_setr_epi8(
+        11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1,
+        11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1, 15, -1, 15, -1);
+    const __m256i swap = SwapRedBlueMask();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        __m256i low = MultiplyUnorm8x16(_mm256_unpacklo_epi8(pixels, zero), _mm256_shuffle_epi8(pixels, alphaLow));
+        __m256i high = MultiplyUnorm8x16(_mm256_unpackhi_epi8(pixels, zero), _mm256_shuffle_epi8(pixels, alphaHigh));
+        __m256i result = _mm256_blendv_epi8(_mm256_packus_epi16(low, high), pixels, alphaMask);
+        if (swapRedBlue) {
+            result = _mm256_shuffle_epi8(result, swap);
+        }
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), result);
+    }
+    PremultiplyScalar(src + i * 4, dst + i * 4, count - i, swapRedBlue);
+}
+
+// Two pixels per step: color through the table with a gather, alpha as unorm.
+void UnormToHalfAvx2(const uint8_t *src, uint16_t *dst, size_t count, const float *colorToFloat, bool swapRedBlue, bool premultiply) {
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256i broadcastAlpha = _mm256_setr_epi32(3, 3, 3, 3, 7, 7, 7, 7);
+    const __m256 toUnorm = _mm256_set1_ps(1.0f / 255.0f);
+    const int alphaLanes = 0x88;
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *) (src + i * 4));
+        if (swapRedBlue) {
+            bytes = _mm_shuffle_epi8(bytes, swap);
+        }
+        __m256i indices = _mm256_cvtepu8_epi32(bytes);
+        __m256 color = _mm256_i32gather_ps(colorToFloat, indices, 4);
+        __m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(indices), toUnorm);
+        if (premultiply) {
+            color = _mm256_mul_ps(color, _mm256_permutevar8x32_ps(alpha, broadcastAlpha));
+        }
+        __m256 values = _mm256_blend_ps(color, alpha, alphaLanes);
+        _mm_storeu_si128((__m128i *) (dst + i * 4), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+    }
+    UnormToHalfScalar(src + i * 4, dst + i * 4, count - i, colorToFloat, swapRedBlue, premultiply);
+}
+
+void HalfToUnormAvx2(const uint16_t *src, uint8_t *dst, size_t count, bool swapRedBlue) {
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(255.0f);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m256 values = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (src + i * 4)));
+        // max() first so that NaN becomes 0, like FloatToUnorm8.
+        values = _mm256_min_ps(_mm256_max_ps(values, zero), one);
+        __m256i integers = _mm256_cvtps_epi32(_mm256_mul_ps(values, scale));
+        __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(integers), _mm256_extracti128_si256(integers, 1));
+        __m128i bytes = _mm_packus_epi16(words, words);
+        if (swapRedBlue) {
+            bytes = _mm_shuffle_epi8(bytes, swap);
+        }
+        _mm_storel_epi64((__m128i *) (dst + i * 4), bytes);
+    }
+    HalfToUnormScalar(src + i * 4, dst + i * 4, count - i, swapRedBlue);
+}
+
+}
+
+const PixelKernels Avx2PixelKernels = {
+    SwapRedBlueAvx2,
+    ExpandL8Avx2,
+    ExpandL8A8Avx2,
+    PremultiplyAvx2,
+    UnormToHalfAvx2,
+    HalfToUnormAvx2,
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Row kernels for the conversions that show up when loading textures. count is in pixels;
+// 8-bit color pixels are RGBA in memory, swapRedBlue reads or writes BGRA instead.
+struct PixelKernels {
+    // RGBA8 <-> BGRA8.
+    void (*swapRedBlue)(const uint8_t *src, uint8_t *dst, size_t count);
+    // L8 -> RGBA8 as (l, l, l, 255).
+    void (*expandL8)(const uint8_t *src, uint8_t *dst, size_t count);
+    // L8A8 -> RGBA8 as (l, l, l, a), optionally premultiplied.
+    void (*expandL8A8)(const uint8_t *src, uint8_t *dst, size_t count, bool premultiply);
+    // RGBA8 -> RGBA8 with color multiplied by alpha.
+    void (*premultiply)(const uint8_t *src, uint8_t *dst, size_t count, bool swapRedBlue);
+    // RGBA8 -> RGBA16F. colorToFloat maps 8-bit color values (unorm or sRGB decode), alpha is unorm.
+    void (*unormToHalf)(const uint8_t *src, uint16_t *dst, size_t count, const float *colorToFloat, bool swapRedBlue, bool premultiply);
+    // RGBA16F -> RGBA8, clamped to [0, 1].
+    void (*halfToUnorm)(const uint16_t *src, uint8_t *dst, size_t count, bool swapRedBlue);
+};
+
+extern const PixelKernels ScalarPixelKernels;
+extern const PixelKernels Avx2PixelKernels;
+
+// Shared scalar code. The SIMD kernels use it for row tails and must produce identical results.
+namespace {
+
+inline uint8_t MultiplyUnorm8(uint32_t a, uint32_t b) {
+    uint32_t x = a * b + 128;
+    return (uint8_t) ((x + (x >> 8)) >> 8); // round(a * b / 255)
+}
+
+inline uint8_t FloatToUnorm8(float value) {
+    value = !(value > 0.0f) ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (uint8_t) lrintf(value * 255.0f);
+}
+
+// Round to nearest even, like F16C.
+inline uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7FFFFFFF;
+
+    if (bits >= 0x47800000) {
+        return (uint16_t) (sign | (bits > 0x7F800000 ? 0x7E00 : 0x7C00));
+    }
+    if (bits < 0x38800000) {
+        // Subnormal: adding 0.5f lets the FPU round the mantissa into the low bits.
+        float input;
+        memcpy(&input, &bits, sizeof(input));
+        float sum = input + 0.5f;
+        memcpy(&bits, &sum, sizeof(bits));
+        return (uint16_t) (sign | (bits - 0x3F000000));
+    }
+    bits += ((15u - 127u) << 23) + 0xFFF + ((bits >> 13) & 1);
+    return (uint16_t) (sign | (bits >> 13));
+}
+
+inline float HalfToFloat(uint16_t half) {
+    uint32_t sign = uint32_t(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 31;
+    uint32_t mantissa = half & 0x3FF;
+
+    if (exponent == 0) {
+        float value = mantissa * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+    uint32_t bits = exponent == 31 ? sign | 0x7F800000 | (mantissa << 13) : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void SwapRedBlueScalar(const uint8_t *src, uint8_t *dst, size_t count) {
+    for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+        uint8_t r = src[0];
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = r;
+        dst[3] = src[3];
+    }
+}
+
+inline void ExpandL8Scalar(const uint8_t *src, uint8_t *dst, size_t count) {
+    for (size_t i = 0; i < count; i++, dst += 4) {
+        dst[0] = dst[1] = dst[2] = src[i];
+        dst[3] = 255;
+    }
+}
+
+inline void ExpandL8A8Scalar(const uint8_t *src, uint8_t *dst, size_t count, bool premultiply) {
+    for (size_t i = 0; i < count; i++, src += 2, dst += 4) {
+        uint8_t l = premultiply ? MultiplyUnorm8(src[0], src[1]) : src[0];
+        dst[0] = dst[1] = dst[2] = l;
+        dst[3] = src[1];
+    }
+}
+
+inline void PremultiplyScalar(const uint8_t *src, uint8_t *dst, size_t count, bool swapRedBlue) {
+    for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+        uint8_t a = src[3];
+        uint8_t r = MultiplyUnorm8(src[0], a);
+        uint8_t g = MultiplyUnorm8(src[1], a);
+        uint8_t b = MultiplyUnorm8(src[2], a);
+        dst[0] = swapRedBlue ? b : r;
+        dst[1] = g;
+        dst[2] = swapRedBlue ? r : b;
+        dst[3] = a;
+    }
+}
+
+inline void UnormToHalfScalar(const uint8_t *src, uint16_t *dst, size_t count, const float *colorToFloat, bool swapRedBlue, bool premultiply) {
+    for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+        float a = src[3] * (1.0f / 255.0f);
+        float scale = premultiply ? a : 1.0f;
+        dst[0] = FloatToHalf(colorToFloat[src[swapRedBlue ? 2 : 0]] * scale);
+        dst[1] = FloatToHalf(colorToFloat[src[1]] * scale);
+        dst[2] = FloatToHalf(colorToFloat[src[swapRedBlue ? 0 : 2]] * scale);
+        dst[3] = FloatToHalf(a);
+    }
+}
+
+inline void HalfToUnormScalar(const uint16_t *src, uint8_t *dst, size_t count, bool swapRedBlue) {
+    for (size_t i = 0; i < count; i++, src += 4, dst += 4) {
+        dst[0] = FloatToUnorm8(HalfToFloat(src[swapRedBlue ? 2 : 0]));
+        dst[1] = FloatToUnorm8(HalfToFloat(src[1]));
+        dst[2] = FloatToUnorm8(HalfToFloat(src[swapRedBlue ? 0 : 2]));
+        dst[3] = FloatToUnorm8(HalfToFloat(src[3]));
+    }
+}
+
+}
@@ -1,6 +1,18 @@
-// Shader Model 5.0
+// Shader Model 5.1
 #include "Header.hlsli"
 
 float4 Main(PSInput input) : SV_TARGET {
-    return g_texture.Sample(g_sampler, input.uv);
+    // One object per draw, so the index is uniform and needs no NonUniformResourceIndex().
+    Texture2D<float4> objectTexture = g_textures[input.textureIndex];
+#if SAMPLING_POINT
+    float4 color = objectTexture.Sample(g_pointSampler, input.uv);
+#else
+    float4 color = objectTexture.Sample(g_sampler, input.uv);
+#endif
+
+#if ALPHA_TEST
+    clip(color.a - 0.5f);
+#endif
+
+    return color;
 }
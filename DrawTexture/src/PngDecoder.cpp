@@ -0,0 +1,820 @@
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Parallel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PNG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+inline uint32_t ReadU32(const uint8_t *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+// Inflate (RFC 1950/1951)
+
+constexpr int InflateFastBits = 10;
+constexpr int InflateMaxBits = 15;
+
+struct InflateTable {
+    uint16_t fast[1 << InflateFastBits]; // (symbol << 4) | length, 0 when the code is longer.
+    uint16_t count[InflateMaxBits + 1];
+    uint16_t symbol[288];
+};
+
+const uint16_t LengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+const uint8_t LengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+const uint16_t DistanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+const uint8_t DistanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+// Builds canonical decoding tables. Incomplete codes are allowed (a single distance code is legal).
+bool BuildInflateTable(InflateTable &table, const uint8_t *lengths, int n) {
+    memset(table.count, 0, sizeof(table.count));
+    for (int i = 0; i < n; i++) {
+        table.count[lengths[i]]++;
+    }
+    table.count[0] = 0;
+
+    int left = 1;
+    for (int length = 1; length <= InflateMaxBits; length++) {
+        left = (left << 1) - table.count[length];
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    uint16_t offsets[InflateMaxBits + 2];
+    offsets[1] = 0;
+    for (int length = 1; length <= InflateMaxBits; length++) {
+        offsets[length + 1] = (uint16_t) (offsets[length] + table.count[length]);
+    }
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) {
+            table.symbol[offsets[lengths[i]]++] = (uint16_t) i;
+        }
+    }
+
+    memset(table.fast, 0, sizeof(table.fast));
+    uint32_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= InflateFastBits; length++) {
+        for (int i = 0; i < table.count[length]; i++, code++) {
+            // Codes are stored MSB first but read LSB first, so index the table by the reversed code.
+            uint32_t reversed = 0;
+            for (int b = 0; b < length; b++) {
+                reversed |= ((code >> b) & 1) << (length - 1 - b);
+            }
+            uint16_t entry = (uint16_t) ((table.symbol[index++] << 4) | length);
+            for (uint32_t j = reversed; j < (1u << InflateFastBits); j += 1u << length) {
+                table.fast[j] = entry;
+            }
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+class Inflater {
+public:
+    Inflater(const uint8_t *begin, const uint8_t *end, uint8_t *out, size_t outSize)
+        : p(begin), end(end), outBegin(out), out(out), outEnd(out + outSize) {}
+
+    bool Run() {
+        int last;
+        do {
+            last = GetBits(1);
+            int type = GetBits(2);
+            bool ok;
+            switch (type) {
+            case 0:
+                ok = Stored();
+                break;
+            case 1:
+                ok = Fixed();
+                break;
+            case 2:
+                ok = Dynamic();
+                break;
+            default:
+                ok = false;
+                break;
+            }
+            if (!ok || overrun > 8) {
+                return false;
+            }
+        } while (!last && out < outEnd);
+        return out == outEnd;
+    }
+
+private:
+    void Refill() {
+        while (count <= 56) {
+            uint64_t byte = 0;
+            if (p < end) {
+                byte = *p++;
+            } else {
+                overrun++;
+            }
+            bits |= byte << count;
+            count += 8;
+        }
+    }
+
+    int GetBits(int n) {
+        if (count < n) {
+            Refill();
+        }
+        int value = int(bits & ((1u << n) - 1));
+        bits >>= n;
+        count -= n;
+        return value;
+    }
+
+    int Decode(const InflateTable &table) {
+        if (count < InflateMaxBits) {
+            Refill();
+        }
+        uint16_t entry = table.fast[bits & ((1u << InflateFastBits) - 1)];
+        if (entry) {
+            bits >>= entry & 15;
+            count -= entry & 15;
+            return entry >> 4;
+        }
+
+        // Slow path for long codes, one bit at a time.
+        int code = 0, first = 0, index = 0;
+        for (int length = 1; length <= InflateMaxBits; length++) {
+            code |= GetBits(1);
+            int n = table.count[length];
+            if (code - n < first) {
+                return table.symbol[index + (code - first)];
+            }
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool Stored() {
+        // Drop to the byte boundary and hand the buffered bytes back to the input.
+        int drop = count & 7;
+        bits >>= drop;
+        count -= drop;
+        size_t buffered = count / 8;
+        if (size_t(overrun) >= buffered) {
+            return false;
+        }
+        p -= buffered - overrun;
+        bits = 0;
+        count = 0;
+        overrun = 0;
+
+        if (end - p < 4) {
+            return false;
+        }
+        uint32_t length = p[0] | (p[1] << 8);
+        uint32_t complement = p[2] | (p[3] << 8);
+        p += 4;
+        if (length != (~complement & 0xFFFF) || size_t(end - p) < length || size_t(outEnd - out) < length) {
+            return false;
+        }
+        memcpy(out, p, length);
+        out += length;
+        p += length;
+        return true;
+    }
+
+    bool Fixed() {
+        static InflateTable literals, distances;
+        static bool built = [] {
+            uint8_t lengths[288];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            BuildInflateTable(literals, lengths, 288);
+            memset(lengths, 5, 30);
+            BuildInflateTable(distances, lengths, 30);
+            return true;
+        }();
+        (void) built;
+        return Codes(literals, distances);
+    }
+
+    bool Dynamic() {
+        static const uint8_t Order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int literalCount = GetBits(5) + 257;
+        int distanceCount = GetBits(5) + 1;
+        int codeCount = GetBits(4) + 4;
+        if (literalCount > 286 || distanceCount > 30) {
+            return false;
+        }
+
+        uint8_t lengths[288 + 32] = { };
+        for (int i = 0; i < codeCount; i++) {
+            lengths[Order[i]] = (uint8_t) GetBits(3);
+        }
+        InflateTable lengthTable;
+        if (!BuildInflateTable(lengthTable, lengths, 19)) {
+            return false;
+        }
+
+        memset(lengths, 0, sizeof(lengths));
+        for (int i = 0; i < literalCount + distanceCount; ) {
+            int symbol = Decode(lengthTable);
+            if (symbol < 0) {
+                return false;
+            }
+            if (symbol < 16) {
+                lengths[i++] = (uint8_t) symbol;
+                continue;
+            }
+
+            int repeat;
+            uint8_t value = 0;
+            if (symbol == 16) {
+                if (i == 0) {
+                    return false;
+                }
+                value = lengths[i - 1];
+                repeat = 3 + GetBits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + GetBits(3);
+            } else {
+                repeat = 11 + GetBits(7);
+            }
+            if (i + repeat > literalCount + distanceCount) {
+                return false;
+            }
+            memset(lengths + i, value, repeat);
+            i += repeat;
+        }
+        if (lengths[256] == 0) {
+            return false;
+        }
+
+        InflateTable literals, distances;
+        if (!BuildInflateTable(literals, lengths, literalCount) || !BuildInflateTable(distances, lengths + literalCount, distanceCount)) {
+            return false;
+        }
+        return Codes(literals, distances);
+    }
+
+    bool Codes(const InflateTable &literals, const InflateTable &distances) {
+        while (true) {
+            int symbol = Decode(literals);
+            if (symbol < 0) {
+                return false;
+            }
+            if (symbol < 256) {
+                if (out == outEnd) {
+                    return false;
+                }
+                *out++ = (uint8_t) symbol;
+                continue;
+            }
+            if (symbol == 256) {
+                return true;
+            }
+
+            symbol -= 257;
+            if (symbol >= 29) {
+                return false;
+            }
+            size_t length = LengthBase[symbol] + GetBits(LengthExtra[symbol]);
+
+            int distanceSymbol = Decode(distances);
+            if (distanceSymbol < 0 || distanceSymbol >= 30) {
+                return false;
+            }
+            size_t distance = DistanceBase[distanceSymbol] + GetBits(DistanceExtra[distanceSymbol]);
+            if (distance > size_t(out - outBegin) || length > size_t(outEnd - out) || overrun > 8) {
+                return false;
+            }
+
+            const uint8_t *from = out - distance;
+            if (distance >= 8 && size_t(outEnd - out) >= length + 8) {
+                // Non-overlapping 8-byte chunks; the tail past length is overwritten later.
+                for (size_t i = 0; i < length; i += 8) {
+                    memcpy(out + i, from + i, 8);
+                }
+                out += length;
+            } else {
+                for (size_t i = 0; i < length; i++) {
+                    out[i] = from[i];
+                }
+                out += length;
+            }
+        }
+    }
+
+    const uint8_t *p;
+    const uint8_t *end;
+    uint8_t *outBegin;
+    uint8_t *out;
+    uint8_t *outEnd;
+    uint64_t bits = 0;
+    int count = 0;
+    int overrun = 0; // Zero bytes fed past the end of the input.
+};
+
+bool Inflate(const uint8_t *data, size_t size, uint8_t *out, size_t outSize) {
+    if (size < 2 || (data[0] & 15) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 || (data[1] & 0x20)) {
+        return false;
+    }
+    // The Adler-32 trailer is not checked; the PNG chunk CRCs are not either.
+    return Inflater(data + 2, data + size, out, outSize).Run();
+}
+
+// Filters
+
+#ifdef PNG_SSE2
+
+inline __m128i Load4(const uint8_t *p) {
+    int32_t value;
+    memcpy(&value, p, 4);
+    return _mm_cvtsi32_si128(value);
+}
+
+inline void Store4(uint8_t *p, __m128i v) {
+    int32_t value = _mm_cvtsi128_si32(v);
+    memcpy(p, &value, 4);
+}
+
+inline __m128i Load3(const uint8_t *p) {
+    int32_t value = 0;
+    memcpy(&value, p, 3);
+    return _mm_cvtsi32_si128(value);
+}
+
+inline void Store3(uint8_t *p, __m128i v) {
+    int32_t value = _mm_cvtsi128_si32(v);
+    memcpy(p, &value, 3);
+}
+
+inline __m128i Select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i Abs16(__m128i x) {
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// Sub, Avg and Paeth depend on the pixel to the left, so SIMD works on one pixel's
+// channels at a time; this is the same approach libpng takes for 3 and 4 byte pixels.
+template <int Bpp>
+void UnfilterPixels(int filter, uint8_t *row, const uint8_t *prior, size_t rowBytes) {
+    // A 3-byte load right after a 3-byte store stalls store forwarding, so read four bytes
+    // wherever the row has room for them.
+    auto load = [rowBytes](const uint8_t *p, size_t x) { return Bpp == 4 || x + 4 <= rowBytes ? Load4(p + x) : Load3(p + x); };
+    auto store = [](uint8_t *p, __m128i v) { if (Bpp == 4) Store4(p, v); else Store3(p, v); };
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i a = zero, b = zero, c = zero, d = zero;
+    switch (filter) {
+    case 1:
+        for (size_t x = 0; x < rowBytes; x += Bpp) {
+            d = _mm_add_epi8(load(row, x), d);
+            store(row + x, d);
+        }
+        break;
+    case 3:
+        for (size_t x = 0; x < rowBytes; x += Bpp) {
+            a = d;
+            b = load(prior, x);
+            d = load(row, x);
+            __m128i average = _mm_avg_epu8(a, b);
+            average = _mm_sub_epi8(average, _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            d = _mm_add_epi8(d, average);
+            store(row + x, d);
+        }
+        break;
+    case 4:
+        for (size_t x = 0; x < rowBytes; x += Bpp) {
+            c = b;
+            b = _mm_unpacklo_epi8(load(prior, x), zero);
+            a = d;
+            d = _mm_unpacklo_epi8(load(row, x), zero);
+
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = _mm_add_epi16(pa, pb);
+            pa = Abs16(pa);
+            pb = Abs16(pb);
+            pc = Abs16(pc);
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            __m128i nearest = Select(_mm_cmpeq_epi16(smallest, pa), a, Select(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+            d = _mm_add_epi8(d, nearest);
+            store(row + x, _mm_packus_epi16(d, d));
+        }
+        break;
+    }
+}
+
+#endif
+
+inline uint8_t Paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    return (uint8_t) (pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+// Reverses the row filter in place. prior is the already reconstructed previous row (zeros for the first).
+bool Unfilter(int filter, uint8_t *row, const uint8_t *prior, size_t rowBytes, size_t bpp) {
+    if (filter == 0) {
+        return true;
+    }
+    if (filter > 4) {
+        return false;
+    }
+
+    if (filter == 2) {
+        size_t x = 0;
+#ifdef PNG_SSE2
+        for (; x + 16 <= rowBytes; x += 16) {
+            __m128i up = _mm_loadu_si128((const __m128i *) (prior + x));
+            __m128i value = _mm_loadu_si128((const __m128i *) (row + x));
+            _mm_storeu_si128((__m128i *) (row + x), _mm_add_epi8(value, up));
+        }
+#endif
+        for (; x < rowBytes; x++) {
+            row[x] = (uint8_t) (row[x] + prior[x]);
+        }
+        return true;
+    }
+
+#ifdef PNG_SSE2
+    if (bpp == 4) {
+        UnfilterPixels<4>(filter, row, prior, rowBytes);
+        return true;
+    }
+    if (bpp == 3) {
+        UnfilterPixels<3>(filter, row, prior, rowBytes);
+        return true;
+    }
+#endif
+
+    for (size_t x = 0; x < rowBytes; x++) {
+        int a = x >= bpp ? row[x - bpp] : 0;
+        int b = prior[x];
+        int c = x >= bpp ? prior[x - bpp] : 0;
+        switch (filter) {
+        case 1:
+            row[x] = (uint8_t) (row[x] + a);
+            break;
+        case 3:
+            row[x] = (uint8_t) (row[x] + ((a + b) >> 1));
+            break;
+        case 4:
+            row[x] = (uint8_t) (row[x] + Paeth(a, b, c));
+            break;
+        }
+    }
+    return true;
+}
+
+// Decoding
+
+struct Header {
+    uint32_t width;
+    uint32_t height;
+    int bitDepth;
+    int colorType;
+    bool interlaced;
+    int channels;
+};
+
+struct Palette {
+    uint8_t rgba[256][4];
+    bool hasTransparency;   // tRNS for gray and truecolor images.
+    uint16_t transparent[3];
+};
+
+struct Pass {
+    uint32_t x0, y0, dx, dy;
+};
+
+const Pass Adam7[7] = {
+    { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+    { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 },
+};
+
+bool ReadHeader(const uint8_t *data, size_t size, Header &header) {
+    if (size < 33 || memcmp(data, Signature, 8) != 0 || ReadU32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4) != 0) {
+        return false;
+    }
+
+    const uint8_t *p = data + 16;
+    header.width = ReadU32(p);
+    header.height = ReadU32(p + 4);
+    header.bitDepth = p[8];
+    header.colorType = p[9];
+    header.interlaced = p[12] == 1;
+    if (header.width == 0 || header.height == 0 || header.width > (1u << 24) || header.height > (1u << 24)) {
+        return false;
+    }
+    if (p[10] != 0 || p[11] != 0 || p[12] > 1) {
+        return false;
+    }
+
+    int depth = header.bitDepth;
+    switch (header.colorType) {
+    case 0:
+        header.channels = 1;
+        return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+    case 3:
+        header.channels = 1;
+        return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+    case 2:
+        header.channels = 3;
+        break;
+    case 4:
+        header.channels = 2;
+        break;
+    case 6:
+        header.channels = 4;
+        break;
+    default:
+        return false;
+    }
+    return depth == 8 || depth == 16;
+}
+
+inline size_t RowBytes(const Header &header, uint32_t width) {
+    return (size_t(width) * header.channels * header.bitDepth + 7) / 8;
+}
+
+// Expands one reconstructed row to RGBA8, writing every step-th pixel of out.
+void ConvertRow(const Header &header, const Palette &palette, const uint8_t *row, uint32_t width, uint8_t *out, size_t step) {
+    const int depth = header.bitDepth;
+
+    if (depth < 8) {
+        const int mask = (1 << depth) - 1;
+        const int scale = 255 / mask;
+        for (uint32_t x = 0; x < width; x++, out += step) {
+            size_t bit = size_t(x) * depth;
+            int value = (row[bit >> 3] >> (8 - depth - (bit & 7))) & mask;
+            if (header.colorType == 3) {
+                memcpy(out, palette.rgba[value], 4);
+            } else {
+                out[0] = out[1] = out[2] = (uint8_t) (value * scale);
+                out[3] = palette.hasTransparency && value == palette.transparent[0] ? 0 : 255;
+            }
+        }
+        return;
+    }
+
+    // 16-bit samples keep their most significant byte; transparency compares the full value.
+    const size_t sampleBytes = depth / 8;
+    auto sample = [&](const uint8_t *p) { return sampleBytes == 2 ? uint16_t((p[0] << 8) | p[1]) : uint16_t(p[0]); };
+
+    switch (header.colorType) {
+    case 0:
+        for (uint32_t x = 0; x < width; x++, out += step, row += sampleBytes) {
+            out[0] = out[1] = out[2] = row[0];
+            out[3] = palette.hasTransparency && sample(row) == palette.transparent[0] ? 0 : 255;
+        }
+        break;
+    case 3:
+        for (uint32_t x = 0; x < width; x++, out += step) {
+            memcpy(out, palette.rgba[row[x]], 4);
+        }
+        break;
+    case 2:
+        for (uint32_t x = 0; x < width; x++, out += step, row += sampleBytes * 3) {
+            out[0] = row[0];
+            out[1] = row[sampleBytes];
+            out[2] = row[sampleBytes * 2];
+            bool transparent = palette.hasTransparency &&
+                sample(row) == palette.transparent[0] &&
+                sample(row + sampleBytes) == palette.transparent[1] &&
+                sample(row + sampleBytes * 2) == palette.transparent[2];
+            out[3] = transparent ? 0 : 255;
+        }
+        break;
+    case 4:
+        for (uint32_t x = 0; x < width; x++, out += step, row += sampleBytes * 2) {
+            out[0] = out[1] = out[2] = row[0];
+            out[3] = row[sampleBytes];
+        }
+        break;
+    case 6:
+        if (sampleBytes == 1 && step == 4) {
+            memcpy(out, row, size_t(width) * 4);
+            break;
+        }
+        for (uint32_t x = 0; x < width; x++, out += step, row += sampleBytes * 4) {
+            out[0] = row[0];
+            out[1] = row[sampleBytes];
+            out[2] = row[sampleBytes * 2];
+            out[3] = row[sampleBytes * 3];
+        }
+        break;
+    }
+}
+
+}
+
+bool ReadPngInfo(const uint8_t *data, size_t size, ImageInfo &info) {
+    Header header;
+    if (!ReadHeader(data, size, header)) {
+        return false;
+    }
+
+    info.format = ImageFormat::Png;
+    info.width = header.width;
+    info.height = header.height;
+    info.progressive = header.interlaced;
+
+    // tRNS adds an alpha channel. It has to come before the first IDAT, so the scan stops there.
+    bool transparency = false;
+    const uint8_t *p = data + 8;
+    const uint8_t *end = data + size;
+    while (end - p >= 12) {
+        uint32_t length = ReadU32(p);
+        if (memcmp(p + 4, "IDAT", 4) == 0 || size_t(end - p) - 12 < length) {
+            break;
+        }
+        if (memcmp(p + 4, "tRNS", 4) == 0) {
+            transparency = true;
+        }
+        p += size_t(length) + 12;
+    }
+
+    switch (header.colorType) {
+    case 0:
+        info.channels = transparency ? 2 : 1;
+        break;
+    case 4:
+        info.channels = 2;
+        break;
+    case 6:
+        info.channels = 4;
+        break;
+    default:
+        info.channels = transparency ? 4 : 3;
+        break;
+    }
+    return true;
+}
+
+bool DecodePng(const uint8_t *data, size_t size, uint8_t *pixels, size_t rowPitch) {
+    Header header;
+    if (!ReadHeader(data, size, header)) {
+        return false;
+    }
+
+    Palette palette = { };
+    for (int i = 0; i < 256; i++) {
+        palette.rgba[i][3] = 255;
+    }
+
+    // Collect the chunks. A single IDAT is inflated in place, several are concatenated first.
+    std::vector<std::pair<const uint8_t *, size_t>> idats;
+    bool ended = false;
+    const uint8_t *p = data + 8;
+    const uint8_t *end = data + size;
+    while (end - p >= 12) {
+        uint32_t length = ReadU32(p);
+        const uint8_t *type = p + 4;
+        const uint8_t *chunk = p + 8;
+        if (size_t(end - chunk) < size_t(length) + 4) {
+            return false;
+        }
+        p = chunk + length + 4;
+
+        if (memcmp(type, "IDAT", 4) == 0) {
+            idats.emplace_back(chunk, length);
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            if (length % 3 || length > 768) {
+                return false;
+            }
+            for (uint32_t i = 0; i < length / 3; i++) {
+                memcpy(palette.rgba[i], chunk + i * 3, 3);
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            if (header.colorType == 3) {
+                for (uint32_t i = 0; i < length && i < 256; i++) {
+                    palette.rgba[i][3] = chunk[i];
+                }
+            } else if (header.colorType == 0 && length >= 2) {
+                palette.hasTransparency = true;
+                palette.transparent[0] = (uint16_t) ((chunk[0] << 8) | chunk[1]);
+            } else if (header.colorType == 2 && length >= 6) {
+                palette.hasTransparency = true;
+                for (int i = 0; i < 3; i++) {
+                    palette.transparent[i] = (uint16_t) ((chunk[i * 2] << 8) | chunk[i * 2 + 1]);
+                }
+            }
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+            break;
+        }
+    }
+    // Without IEND the file was cut off, possibly between two IDAT chunks.
+    if (idats.empty() || !ended) {
+        return false;
+    }
+
+    std::vector<uint8_t> compressed;
+    const uint8_t *stream = idats[0].first;
+    size_t streamSize = idats[0].second;
+    if (idats.size() > 1) {
+        for (const auto &idat : idats) {
+            compressed.insert(compressed.end(), idat.first, idat.first + idat.second);
+        }
+        stream = compressed.data();
+        streamSize = compressed.size();
+    }
+
+    // Lay out the filtered rows of every pass (one pass when not interlaced).
+    struct PassLayout {
+        Pass pass;
+        uint32_t width, height;
+        size_t rowBytes;
+        size_t offset;
+    };
+    std::vector<PassLayout> passes;
+    size_t filteredSize = 0;
+    for (int i = 0; i < (header.interlaced ? 7 : 1); i++) {
+        Pass pass = header.interlaced ? Adam7[i] : Pass { 0, 0, 1, 1 };
+        if (pass.x0 >= header.width || pass.y0 >= header.height) {
+            continue;
+        }
+        PassLayout layout;
+        layout.pass = pass;
+        layout.width = (header.width - pass.x0 + pass.dx - 1) / pass.dx;
+        layout.height = (header.height - pass.y0 + pass.dy - 1) / pass.dy;
+        layout.rowBytes = RowBytes(header, layout.width);
+        layout.offset = filteredSize;
+        filteredSize += (layout.rowBytes + 1) * layout.height;
+        passes.push_back(layout);
+    }
+
+    std::vector<uint8_t> filtered(filteredSize);
+    if (!Inflate(stream, streamSize, filtered.data(), filtered.size())) {
+        return false;
+    }
+
+    // Unfiltering is serial by nature; row expansion afterwards is independent per row.
+    size_t bpp = (std::max)(1, header.channels * header.bitDepth / 8);
+    std::vector<uint8_t> zeros(RowBytes(header, header.width));
+    for (const PassLayout &layout : passes) {
+        const uint8_t *prior = zeros.data();
+        for (uint32_t y = 0; y < layout.height; y++) {
+            uint8_t *row = &filtered[layout.offset + y * (layout.rowBytes + 1)];
+            if (!Unfilter(row[0], row + 1, prior, layout.rowBytes, bpp)) {
+                return false;
+            }
+            prior = row + 1;
+        }
+    }
+
+    struct Job {
+        const PassLayout *layout;
+        uint32_t y;
+    };
+    std::vector<Job> jobs;
+    for (const PassLayout &layout : passes) {
+        for (uint32_t y = 0; y < layout.height; y++) {
+            jobs.push_back({ &layout, y });
+        }
+    }
+
+    ParallelFor(jobs.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const PassLayout &layout = *jobs[i].layout;
+            uint32_t y = jobs[i].y;
+            const uint8_t *row = &filtered[layout.offset + y * (layout.rowBytes + 1) + 1];
+            uint8_t *out = pixels + (layout.pass.y0 + size_t(y) * layout.pass.dy) * rowPitch + layout.pass.x0 * 4;
+            ConvertRow(header, palette, row, layout.width, out, layout.pass.dx * 4);
+        }
+    });
+    return true;
+}
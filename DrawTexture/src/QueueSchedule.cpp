@@ -0,0 +1,181 @@
+#include "QueueSchedule.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint32_t NoBatch = UINT32_MAX;
+
+}
+
+void QueueSchedule::Reset() {
+    passes.clear();
+    dependencies.clear();
+    batches.clear();
+    batchClocks.clear();
+    order.clear();
+    batchPasses.clear();
+    waits.clear();
+    stats = { };
+}
+
+PassHandle QueueSchedule::AddPass(QueueType queue, const PassHandle *dependencies, uint32_t dependencyCount) {
+    PassHandle handle = (PassHandle) passes.size();
+    for (uint32_t i = 0; i < dependencyCount; i++) {
+        if (dependencies[i] >= handle) {
+            return InvalidHandle;
+        }
+    }
+
+    passes.push_back({ (uint32_t) queue, (uint32_t) this->dependencies.size(), dependencyCount, NoBatch });
+    this->dependencies.insert(this->dependencies.end(), dependencies, dependencies + dependencyCount);
+    return handle;
+}
+
+void QueueSchedule::Resolve(FrameArena &scratch) {
+    batches.clear();
+    batchClocks.clear();
+    order.clear();
+    batchPasses.clear();
+    waits.clear();
+    stats = { };
+    std::fill(openBatches, openBatches + QueueCount, NoBatch);
+
+    for (PassHandle handle = 0; handle < (PassHandle) passes.size(); handle++) {
+        Pass &pass = passes[handle];
+        uint32_t queue = pass.queue;
+
+        // Latest batch needed from every other queue. A dependency in a batch that is still
+        // open closes it, so its signal is submitted before the wait.
+        uint32_t required[QueueCount];
+        std::fill(required, required + QueueCount, NoBatch);
+        for (uint32_t i = 0; i < pass.dependencyCount; i++) {
+            const Pass &dependency = passes[dependencies[pass.firstDependency + i]];
+            uint32_t source = dependency.queue;
+            if (source == queue) {
+                continue;
+            }
+            if (openBatches[source] == dependency.batch) {
+                CloseBatch(source);
+            }
+            if (required[source] == NoBatch || batches[dependency.batch].value > batches[required[source]].value) {
+                required[source] = dependency.batch;
+            }
+        }
+
+        // A wait is implied when this queue already waited for the value, or when another
+        // required batch's queue did before that batch.
+        ScheduledWait newWaits[QueueCount];
+        uint32_t waitCount = 0;
+        Clock merged = known[queue];
+        for (uint32_t source = 0; source < QueueCount; source++) {
+            if (required[source] == NoBatch) {
+                continue;
+            }
+
+            uint64_t value = batches[required[source]].value;
+            uint64_t implied = known[queue].values[source];
+            for (uint32_t other = 0; other < QueueCount; other++) {
+                if (other != source && required[other] != NoBatch) {
+                    implied = (std::max)(implied, batchClocks[required[other]].values[source]);
+                }
+            }
+            for (uint32_t timeline = 0; timeline < QueueCount; timeline++) {
+                merged.values[timeline] = (std::max)(merged.values[timeline], batchClocks[required[source]].values[timeline]);
+            }
+
+            if (value > implied) {
+                newWaits[waitCount++] = { (QueueType) source, value };
+                batches[required[source]].signal = true;
+            } else {
+                stats.elidedWaits++;
+            }
+        }
+        known[queue] = merged;
+
+        // Waits are only possible in front of a batch, so they split the queue's open one.
+        uint32_t batch = openBatches[queue];
+        if (waitCount > 0 || batch == NoBatch) {
+            if (batch != NoBatch) {
+                CloseBatch(queue);
+            }
+            batch = OpenBatch(queue, newWaits, waitCount);
+        }
+        pass.batch = batch;
+        batches[batch].passCount++;
+        stats.passes[queue]++;
+    }
+
+    for (uint32_t queue = 0; queue < QueueCount; queue++) {
+        if (openBatches[queue] != NoBatch) {
+            CloseBatch(queue);
+        }
+    }
+
+    // The last batch of every queue signals too, so the CPU can tell when the queue is done.
+    uint32_t lastBatches[QueueCount];
+    std::fill(lastBatches, lastBatches + QueueCount, NoBatch);
+    for (uint32_t batch = 0; batch < (uint32_t) batches.size(); batch++) {
+        lastBatches[(uint32_t) batches[batch].queue] = batch;
+    }
+    for (uint32_t queue = 0; queue < QueueCount; queue++) {
+        if (lastBatches[queue] != NoBatch) {
+            batches[lastBatches[queue]].signal = true;
+        }
+    }
+
+    // Pass lists of the batches, in pass order.
+    uint32_t offset = 0;
+    for (ScheduledBatch &batch : batches) {
+        batch.firstPass = offset;
+        offset += batch.passCount;
+        batch.passCount = 0;
+        stats.batches[(uint32_t) batch.queue]++;
+        stats.signals += batch.signal ? 1 : 0;
+    }
+    batchPasses.resize(passes.size());
+    for (PassHandle handle = 0; handle < (PassHandle) passes.size(); handle++) {
+        ScheduledBatch &batch = batches[passes[handle].batch];
+        batchPasses[batch.firstPass + batch.passCount++] = handle;
+    }
+    stats.waits = (uint32_t) waits.size();
+
+    // Two passes on different queues may overlap unless one batch's clock covers the other.
+    FrameArenaScope scope(scratch);
+    FrameVector<bool> overlappable(passes.size(), false, scratch);
+    for (PassHandle a = 0; a < (PassHandle) passes.size(); a++) {
+        for (PassHandle b = a + 1; b < (PassHandle) passes.size(); b++) {
+            if (passes[a].queue == passes[b].queue) {
+                continue;
+            }
+            const ScheduledBatch &batchA = batches[passes[a].batch];
+            const ScheduledBatch &batchB = batches[passes[b].batch];
+            bool ordered =
+                batchClocks[passes[b].batch].values[passes[a].queue] >= batchA.value ||
+                batchClocks[passes[a].batch].values[passes[b].queue] >= batchB.value;
+            if (!ordered) {
+                overlappable[a] = true;
+                overlappable[b] = true;
+            }
+        }
+    }
+    stats.overlappablePasses = (uint32_t) std::count(overlappable.begin(), overlappable.end(), true);
+}
+
+uint32_t QueueSchedule::OpenBatch(uint32_t queue, const ScheduledWait *newWaits, uint32_t waitCount) {
+    uint32_t batch = (uint32_t) batches.size();
+    batches.push_back({ (QueueType) queue, ++lastValues[queue], 0, 0, (uint32_t) waits.size(), waitCount, false });
+    waits.insert(waits.end(), newWaits, newWaits + waitCount);
+
+    Clock clock = known[queue];
+    clock.values[queue] = batches[batch].value;
+    batchClocks.push_back(clock);
+
+    openBatches[queue] = batch;
+    return batch;
+}
+
+void QueueSchedule::CloseBatch(uint32_t queue) {
+    order.push_back(openBatches[queue]);
+    openBatches[queue] = NoBatch;
+}
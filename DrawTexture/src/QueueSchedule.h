@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "FrameArena.h"
+
+enum class QueueType : uint32_t {
+    Graphics,
+    Compute,
+    Copy,
+};
+
+constexpr uint32_t QueueCount = 3;
+
+using PassHandle = uint32_t;
+
+// Cross-queue wait of a batch: the queue stalls until queue's timeline reaches value.
+struct ScheduledWait {
+    QueueType queue;
+    uint64_t value;
+};
+
+// Passes submitted with one ExecuteCommandLists. The waits run before it, the signal
+// (if any) sets the queue's timeline to value after it.
+struct ScheduledBatch {
+    QueueType queue;
+    uint64_t value;
+    uint32_t firstPass;  // Into GetBatchPasses().
+    uint32_t passCount;
+    uint32_t firstWait;  // Into GetWaits().
+    uint32_t waitCount;
+    bool signal;
+};
+
+struct ScheduleStats {
+    uint32_t passes[QueueCount];
+    uint32_t batches[QueueCount];
+    uint32_t waits;
+    uint32_t elidedWaits;        // Cross-queue dependencies already implied by earlier waits.
+    uint32_t signals;
+    uint32_t overlappablePasses; // Passes not ordered against some pass of another queue.
+};
+
+// Turns passes with declared dependencies into per-queue batches with the fewest
+// cross-queue Wait/Signal pairs. Passes on one queue run in the order they were added;
+// dependencies must name earlier passes. Each batch carries a vector clock of the
+// timeline values its queue is known to have waited for, so a dependency that an earlier
+// wait already covers, directly or through another queue, adds no wait. Consecutive
+// passes on a queue share a batch until a new wait splits it. Batches are listed in an
+// order in which every signal is submitted before the waits on it, and the result only
+// depends on the order of the calls. Timeline values continue across Reset().
+class QueueSchedule {
+public:
+    static constexpr PassHandle InvalidHandle = UINT32_MAX;
+
+    // Starts a new set of passes; timelines and known waits carry over.
+    void Reset();
+
+    // Returns InvalidHandle when a dependency does not name an earlier pass.
+    PassHandle AddPass(QueueType queue, const PassHandle *dependencies, uint32_t dependencyCount);
+    PassHandle AddPass(QueueType queue, std::initializer_list<PassHandle> dependencies = { }) {
+        return AddPass(queue, dependencies.begin(), (uint32_t) dependencies.size());
+    }
+
+    // scratch holds temporary data of the call.
+    void Resolve(FrameArena &scratch);
+
+    // Batch indices in submission order.
+    const std::vector<uint32_t> &GetSubmissionOrder() const { return order; }
+    const std::vector<ScheduledBatch> &GetBatches() const { return batches; }
+    const std::vector<PassHandle> &GetBatchPasses() const { return batchPasses; }
+    const std::vector<ScheduledWait> &GetWaits() const { return waits; }
+    const ScheduleStats &GetStats() const { return stats; }
+
+    // Value signaled by the last batch of the queue so far.
+    uint64_t GetLastValue(QueueType queue) const { return lastValues[(uint32_t) queue]; }
+
+private:
+    struct Pass {
+        uint32_t queue;
+        uint32_t firstDependency;
+        uint32_t dependencyCount;
+        uint32_t batch;
+    };
+
+    struct Clock {
+        uint64_t values[QueueCount];
+    };
+
+    uint32_t OpenBatch(uint32_t queue, const ScheduledWait *newWaits, uint32_t waitCount);
+    void CloseBatch(uint32_t queue);
+
+    std::vector<Pass> passes;
+    std::vector<PassHandle> dependencies;
+    std::vector<ScheduledBatch> batches;
+    std::vector<Clock> batchClocks;
+    std::vector<uint32_t> order;
+    std::vector<PassHandle> batchPasses;
+    std::vector<ScheduledWait> waits;
+    uint32_t openBatches[QueueCount];
+    uint64_t lastValues[QueueCount] = { };
+    Clock known[QueueCount] = { };      // Per queue, the values of every timeline it is known to be past.
+    ScheduleStats stats = { };
+};
@@ -0,0 +1,104 @@
+#include "QueueScheduler.h"
+
+QueueScheduler::~QueueScheduler() {
+    if (fenceEvent) {
+        CloseHandle(fenceEvent);
+    }
+}
+
+HRESULT QueueScheduler::Init(ID3D12Device *device, ID3D12CommandQueue *graphicsQueue) {
+    queues[(uint32_t) QueueType::Graphics] = graphicsQueue;
+
+    const D3D12_COMMAND_LIST_TYPE types[] = { D3D12_COMMAND_LIST_TYPE_COMPUTE, D3D12_COMMAND_LIST_TYPE_COPY };
+    const QueueType created[] = { QueueType::Compute, QueueType::Copy };
+    for (UINT i = 0; i < _countof(types); i++) {
+        D3D12_COMMAND_QUEUE_DESC desc;
+        desc.Type     = types[i];
+        desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+        desc.Flags    = D3D12_COMMAND_QUEUE_FLAG_NONE;
+        desc.NodeMask = 0;
+        HRESULT hr = device->CreateCommandQueue(&desc, IID_PPV_ARGS(&queues[(uint32_t) created[i]]));
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    for (uint32_t queue = 0; queue < QueueCount; queue++) {
+        HRESULT hr = device->CreateFence(schedule.GetLastValue((QueueType) queue), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fences[queue]));
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    fenceEvent = CreateEvent(nullptr, false, false, nullptr);
+    return fenceEvent ? S_OK : E_FAIL;
+}
+
+void QueueScheduler::BeginFrame() {
+    schedule.Reset();
+    passLists.clear();
+    commandLists.clear();
+}
+
+PassHandle QueueScheduler::AddPass(QueueType queue, ID3D12CommandList *const *lists, UINT count,
+                                   std::initializer_list<PassHandle> dependencies) {
+    PassHandle handle = schedule.AddPass(queue, dependencies);
+    if (handle != QueueSchedule::InvalidHandle) {
+        passLists.push_back({ (UINT) commandLists.size(), count });
+        commandLists.insert(commandLists.end(), lists, lists + count);
+    }
+    return handle;
+}
+
+HRESULT QueueScheduler::Submit(FrameArena &scratch) {
+    schedule.Resolve(scratch);
+
+    const std::vector<ScheduledBatch> &batches = schedule.GetBatches();
+    const std::vector<PassHandle> &batchPasses = schedule.GetBatchPasses();
+    const std::vector<ScheduledWait> &waits = schedule.GetWaits();
+
+    for (uint32_t index : schedule.GetSubmissionOrder()) {
+        const ScheduledBatch &batch = batches[index];
+        ID3D12CommandQueue *queue = queues[(uint32_t) batch.queue].Get();
+
+        for (uint32_t i = 0; i < batch.waitCount; i++) {
+            const ScheduledWait &wait = waits[batch.firstWait + i];
+            HRESULT hr = queue->Wait(fences[(uint32_t) wait.queue].Get(), wait.value);
+            if (FAILED(hr)) {
+                return hr;
+            }
+        }
+
+        batchLists.clear();
+        for (uint32_t i = 0; i < batch.passCount; i++) {
+            const PassLists &lists = passLists[batchPasses[batch.firstPass + i]];
+            batchLists.insert(batchLists.end(), commandLists.begin() + lists.first, commandLists.begin() + lists.first + lists.count);
+        }
+        if (!batchLists.empty()) {
+            queue->ExecuteCommandLists((UINT) batchLists.size(), batchLists.data());
+        }
+
+        if (batch.signal) {
+            HRESULT hr = queue->Signal(fences[(uint32_t) batch.queue].Get(), batch.value);
+            if (FAILED(hr)) {
+                return hr;
+            }
+        }
+    }
+    return S_OK;
+}
+
+HRESULT QueueScheduler::WaitIdle() {
+    for (uint32_t queue = 0; queue < QueueCount; queue++) {
+        UINT64 value = schedule.GetLastValue((QueueType) queue);
+        if (fences[queue]->GetCompletedValue() >= value) {
+            continue;
+        }
+        HRESULT hr = fences[queue]->SetEventOnCompletion(value, fenceEvent);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        WaitForSingleObject(fenceEvent, INFINITE);
+    }
+    return S_OK;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <vector>
+
+#include "QueueSchedule.h"
+
+// Graphics, compute and copy queues with one timeline fence each. Work is added as passes
+// with their command lists and dependencies; Submit() resolves them with QueueSchedule
+// and issues one ExecuteCommandLists per batch, with Wait before and Signal after it
+// only where the schedule needs them.
+class QueueScheduler {
+public:
+    ~QueueScheduler();
+
+    // graphicsQueue is the existing direct queue; the compute and copy queues are created.
+    HRESULT Init(ID3D12Device *device, ID3D12CommandQueue *graphicsQueue);
+
+    ID3D12CommandQueue *GetQueue(QueueType queue) const { return queues[(uint32_t) queue].Get(); }
+    ID3D12Fence *GetFence(QueueType queue) const { return fences[(uint32_t) queue].Get(); }
+
+    void BeginFrame();
+    PassHandle AddPass(QueueType queue, ID3D12CommandList *const *commandLists, UINT count,
+                       std::initializer_list<PassHandle> dependencies = { });
+    HRESULT Submit(FrameArena &scratch);
+
+    // Fence value each queue reaches once everything submitted so far has finished.
+    UINT64 GetSubmittedValue(QueueType queue) const { return schedule.GetLastValue(queue); }
+    HRESULT WaitIdle();
+
+    const QueueSchedule &GetSchedule() const { return schedule; }
+    const ScheduleStats &GetStats() const { return schedule.GetStats(); }
+
+private:
+    struct PassLists {
+        UINT first;
+        UINT count;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> queues[QueueCount];
+    Microsoft::WRL::ComPtr<ID3D12Fence> fences[QueueCount];
+    HANDLE fenceEvent = nullptr;
+    QueueSchedule schedule;
+    std::vector<PassLists> passLists;  // Indexed by pass handle.
+    std::vector<ID3D12CommandList *> commandLists;
+    std::vector<ID3D12CommandList *> batchLists;
+};
@@ -0,0 +1,115 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    Reset(capacity);
+}
+
+void RangeAllocator::Reset(uint32_t capacity) {
+    this->capacity = capacity;
+    freeSize = capacity;
+    freeBlocks.clear();
+
+    if (capacity > 0) {
+        freeBlocks.push_back({ 0, capacity });
+    }
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    if (size > freeSize) {
+        return InvalidOffset;
+    }
+
+    // Best fit keeps large blocks intact for large meshes.
+    size_t best = freeBlocks.size();
+    for (size_t i = 0; i < freeBlocks.size(); i++) {
+        if (freeBlocks[i].size >= size && (best == freeBlocks.size() || freeBlocks[i].size < freeBlocks[best].size)) {
+            best = i;
+            if (freeBlocks[i].size == size) {
+                break;
+            }
+        }
+    }
+
+    if (best == freeBlocks.size()) {
+        return InvalidOffset;
+    }
+
+    Block &block = freeBlocks[best];
+    uint32_t offset = block.offset;
+
+    if (block.size == size) {
+        freeBlocks.erase(freeBlocks.begin() + best);
+    } else {
+        block.offset += size;
+        block.size -= size;
+    }
+
+    freeSize -= size;
+    return offset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    assert(offset + size <= capacity);
+
+    auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset, [](const Block &block, uint32_t value) {
+        return block.offset < value;
+    });
+
+    assert(next == freeBlocks.end() || offset + size <= next->offset);
+
+    bool mergePrev = next != freeBlocks.begin() && (next - 1)->offset + (next - 1)->size == offset;
+    bool mergeNext = next != freeBlocks.end() && offset + size == next->offset;
+
+    if (mergePrev && mergeNext) {
+        (next - 1)->size += size + next->size;
+        freeBlocks.erase(next);
+    } else if (mergePrev) {
+        (next - 1)->size += size;
+    } else if (mergeNext) {
+        next->offset = offset;
+        next->size += size;
+    } else {
+        freeBlocks.insert(next, { offset, size });
+    }
+
+    freeSize += size;
+}
+
+uint32_t RangeAllocator::GetLargestFreeBlock() const {
+    uint32_t largest = 0;
+    for (const Block &block : freeBlocks) {
+        largest = (std::max)(largest, block.size);
+    }
+    return largest;
+}
+
+float RangeAllocator::GetFragmentation() const {
+    return freeSize ? 1.0f - (float) GetLargestFreeBlock() / (float) freeSize : 0.0f;
+}
+
+void PackRanges(std::vector<AllocatedRange> &ranges, std::vector<RangeCopy> &copies) {
+    copies.clear();
+    uint32_t dstOffset = 0;
+
+    for (AllocatedRange &range : ranges) {
+        if (range.size > 0) {
+            if (!copies.empty() && copies.back().srcOffset + copies.back().size == range.offset) {
+                copies.back().size += range.size;
+            } else {
+                copies.push_back({ range.offset, dstOffset, range.size });
+            }
+        }
+        range.offset = dstOffset;
+        dstOffset += range.size;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Free-list allocator for element ranges of a fixed-size buffer.
+// It only tracks free space, so callers keep the offset and size of what they allocated.
+class RangeAllocator {
+public:
+    static constexpr uint32_t InvalidOffset = UINT32_MAX;
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    void Reset(uint32_t capacity);
+
+    // Returns the offset of the best fitting free block or InvalidOffset. An empty range
+    // always succeeds at offset 0 and takes no space.
+    uint32_t Allocate(uint32_t size);
+    void Free(uint32_t offset, uint32_t size);
+
+    uint32_t GetCapacity() const { return capacity; }
+    uint32_t GetFreeSize() const { return freeSize; }
+    uint32_t GetLargestFreeBlock() const;
+    size_t GetFreeBlockCount() const { return freeBlocks.size(); }
+
+    // 0 when all free space is contiguous, approaching 1 as it splits into small blocks.
+    float GetFragmentation() const;
+
+private:
+    struct Block {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    std::vector<Block> freeBlocks; // Sorted by offset, never adjacent.
+    uint32_t capacity = 0;
+    uint32_t freeSize = 0;
+};
+
+struct AllocatedRange {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// A copy of size elements from srcOffset of the old buffer to dstOffset of the new one.
+struct RangeCopy {
+    uint32_t srcOffset;
+    uint32_t dstOffset;
+    uint32_t size;
+};
+
+// Plans compaction: packs ranges, sorted by offset, to the front of a new buffer in the
+// same order and rewrites their offsets. Ranges adjacent in the old buffer become one
+// copy. Afterwards Reset() and one Allocate() of the total size match the new layout.
+void PackRanges(std::vector<AllocatedRange> &ranges, std::vector<RangeCopy> &copies);
@@ -0,0 +1,62 @@
+#include "ReadbackRing.h"
+
+#include <algorithm>
+#include <cassert>
+
+ReadbackRing::ReadbackRing(uint32_t slotCount) {
+    Reset(slotCount);
+}
+
+void ReadbackRing::Reset(uint32_t slotCount) {
+    slots.assign(slotCount, { State::Free, 0, 0 });
+    next = 0;
+    sequence = 0;
+    droppedCount = 0;
+}
+
+uint32_t ReadbackRing::Acquire() {
+    uint32_t count = uint32_t(slots.size());
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot = (next + i) % count;
+        if (slots[slot].state == State::Free) {
+            slots[slot] = { State::Recorded, 0, sequence++ };
+            next = (slot + 1) % count;
+            return slot;
+        }
+    }
+
+    droppedCount++;
+    return InvalidSlot;
+}
+
+void ReadbackRing::Submit(uint64_t fenceValue) {
+    for (Slot &slot : slots) {
+        if (slot.state == State::Recorded) {
+            slot.state = State::InFlight;
+            slot.fenceValue = fenceValue;
+        }
+    }
+}
+
+void ReadbackRing::Poll(uint64_t completedFenceValue, std::vector<uint32_t> &ready) {
+    size_t first = ready.size();
+    for (uint32_t i = 0; i < uint32_t(slots.size()); i++) {
+        Slot &slot = slots[i];
+        if (slot.state == State::InFlight && slot.fenceValue <= completedFenceValue) {
+            slot.state = State::Reading;
+            ready.push_back(i);
+        }
+    }
+    std::sort(ready.begin() + first, ready.end(), [&](uint32_t a, uint32_t b) {
+        return slots[a].sequence < slots[b].sequence;
+    });
+}
+
+void ReadbackRing::Release(uint32_t slot) {
+    assert(slot < slots.size() && slots[slot].state == State::Reading);
+    slots[slot].state = State::Free;
+}
+
+uint32_t ReadbackRing::GetFreeCount() const {
+    return uint32_t(std::count_if(slots.begin(), slots.end(), [](const Slot &slot) { return slot.state == State::Free; }));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Bookkeeping for a ring of readback buffers. A slot is acquired when a copy into it is
+// recorded, waits for the fence of its submission, and is handed to a reader once that
+// fence has completed; the reader releases it when it no longer needs the data. Nothing
+// waits: when every slot is busy, Acquire() fails and the caller drops the capture
+// instead of stalling the frame. No D3D12 types are involved, so the slot life cycle can
+// be exercised without a device. Not thread-safe; callers that release from other
+// threads lock around it.
+class ReadbackRing {
+public:
+    static constexpr uint32_t InvalidSlot = UINT32_MAX;
+
+    explicit ReadbackRing(uint32_t slotCount = 0);
+
+    void Reset(uint32_t slotCount);
+
+    // Returns a free slot for a copy recorded in the current submission, or InvalidSlot.
+    uint32_t Acquire();
+    // Slots acquired since the last Submit() wait for fenceValue.
+    void Submit(uint64_t fenceValue);
+    // Appends the slots whose fence has completed to ready, oldest first. They stay
+    // owned by the caller until Release().
+    void Poll(uint64_t completedFenceValue, std::vector<uint32_t> &ready);
+    void Release(uint32_t slot);
+
+    uint32_t GetSlotCount() const { return uint32_t(slots.size()); }
+    uint32_t GetFreeCount() const;
+    uint64_t GetDroppedCount() const { return droppedCount; }  // Failed Acquire() calls.
+
+private:
+    enum class State : uint8_t {
+        Free,
+        Recorded,   // Acquired, not yet submitted.
+        InFlight,   // Waiting for its fence.
+        Reading,    // Handed out by Poll().
+    };
+
+    struct Slot {
+        State state;
+        uint64_t fenceValue;
+        uint64_t sequence;   // Order of Acquire(), so Poll() returns captures in frame order.
+    };
+
+    std::vector<Slot> slots;
+    uint32_t next = 0;       // Where Acquire() starts looking, so slots are used round robin.
+    uint64_t sequence = 0;
+    uint64_t droppedCount = 0;
+};
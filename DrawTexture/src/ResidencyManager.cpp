@@ -0,0 +1,86 @@
+#include "ResidencyManager.h"
+
+HRESULT ResidencyManager::Init(ID3D12Device *device, IDXGIAdapter *adapter) {
+    this->device = device;
+    this->adapter.Reset();
+    objects.clear();
+    policy = ResidencyPolicy();
+
+    // Without IDXGIAdapter3 there is no budget to follow; everything stays resident.
+    if (adapter) {
+        adapter->QueryInterface(IID_PPV_ARGS(&this->adapter));
+    }
+    return S_OK;
+}
+
+ResidencyHandle ResidencyManager::Track(ID3D12Pageable *object, UINT64 size) {
+    ResidencyHandle handle = policy.Add(size);
+    if (handle >= objects.size()) {
+        objects.resize(handle + 1);
+    }
+    objects[handle] = object;
+    return handle;
+}
+
+ResidencyHandle ResidencyManager::Track(ID3D12Resource *resource) {
+    D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &desc);
+    return Track(resource, info.SizeInBytes);
+}
+
+ResidencyHandle ResidencyManager::TrackMapped(ID3D12Resource *resource) {
+    ResidencyHandle handle = Track(resource);
+    policy.SetEvictable(handle, false);
+    return handle;
+}
+
+void ResidencyManager::Untrack(ResidencyHandle handle) {
+    // Evicted objects may be released as they are; residency is reference counted per object.
+    policy.Remove(handle);
+    objects[handle].Reset();
+}
+
+HRESULT ResidencyManager::PrepareSubmission(UINT64 completedFenceValue) {
+    UpdateBudget();
+    policy.Plan(completedFenceValue, makeResident, evict);
+
+    if (!evict.empty()) {
+        batch.clear();
+        for (ResidencyHandle handle : evict) {
+            batch.push_back(objects[handle].Get());
+        }
+        HRESULT hr = device->Evict((UINT) batch.size(), batch.data());
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    if (!makeResident.empty()) {
+        batch.clear();
+        for (ResidencyHandle handle : makeResident) {
+            batch.push_back(objects[handle].Get());
+        }
+        return device->MakeResident((UINT) batch.size(), batch.data());
+    }
+    return S_OK;
+}
+
+void ResidencyManager::UpdateBudget() {
+    if (simulatedBudget != 0) {
+        policy.SetBudget(simulatedBudget);
+        return;
+    }
+    if (!adapter) {
+        return;
+    }
+
+    DXGI_QUERY_VIDEO_MEMORY_INFO info;
+    if (FAILED(adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info))) {
+        return;
+    }
+
+    // CurrentUsage includes our resident objects; the rest belongs to untracked allocations.
+    UINT64 tracked = policy.GetResidentBytes();
+    UINT64 untracked = info.CurrentUsage > tracked ? info.CurrentUsage - tracked : 0;
+    policy.SetBudget(info.Budget > untracked ? info.Budget - untracked : 0);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <d3d12.h>
+#include <dxgi1_4.h>
+#include <wrl.h>
+
+#include <vector>
+
+#include "ResidencyPolicy.h"
+
+// Keeps tracked heaps and resources within the local video memory budget reported by
+// QueryVideoMemoryInfo. Objects used by a submission are marked with Use(); before the
+// submission, PrepareSubmission() pages out least recently used objects with one Evict
+// call and pages in the used ones with one MakeResident call. The policy itself is
+// ResidencyPolicy. Untracked memory (swap chain, startup upload heaps) still counts
+// against the budget, so only what is left over is given to the policy.
+class ResidencyManager {
+public:
+    HRESULT Init(ID3D12Device *device, IDXGIAdapter *adapter);
+
+    // size is the allocation size of the object; the ID3D12Resource overload queries it.
+    ResidencyHandle Track(ID3D12Pageable *object, UINT64 size);
+    ResidencyHandle Track(ID3D12Resource *resource);
+    // Persistently mapped upload and readback buffers are counted but never evicted: the
+    // CPU reads and writes them outside of submissions, when they may not be resident.
+    ResidencyHandle TrackMapped(ID3D12Resource *resource);
+    void Untrack(ResidencyHandle handle);
+
+    void Use(ResidencyHandle handle) { policy.Use(handle); }
+
+    // A non-zero budget replaces QueryVideoMemoryInfo, to exercise eviction on any GPU.
+    void SetSimulatedBudget(UINT64 budget) { simulatedBudget = budget; }
+
+    // Call after recording and before ExecuteCommandLists. MakeResident blocks until the
+    // objects are resident.
+    HRESULT PrepareSubmission(UINT64 completedFenceValue);
+    // Call with the fence value signaled after the submission.
+    void EndSubmission(UINT64 fenceValue) { policy.Submit(fenceValue); }
+
+    const ResidencyPolicy &GetPolicy() const { return policy; }
+
+private:
+    void UpdateBudget();
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<IDXGIAdapter3> adapter; // Null when the budget cannot be queried.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Pageable>> objects; // Indexed by handle.
+    std::vector<ResidencyHandle> makeResident;
+    std::vector<ResidencyHandle> evict;
+    std::vector<ID3D12Pageable *> batch;
+    ResidencyPolicy policy;
+    UINT64 simulatedBudget = 0;
+};
@@ -0,0 +1,131 @@
+#include "ResidencyPolicy.h"
+
+#include <algorithm>
+
+namespace {
+
+// Eviction continues until residency is 1/16 below the budget.
+constexpr uint64_t HysteresisDivisor = 16;
+
+}
+
+ResidencyHandle ResidencyPolicy::Add(uint64_t size, bool resident) {
+    ResidencyHandle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = (ResidencyHandle) objects.size();
+        objects.emplace_back();
+    }
+
+    Object &object = objects[handle];
+    object.size = size;
+    object.lastUsedFence = 0;
+    object.lastUsedSubmission = submission;
+    object.evictedSubmission = 0;
+    object.resident = resident;
+    object.evictable = true;
+    object.live = true;
+    object.used = false;
+
+    if (resident) {
+        residentBytes += size;
+    }
+    return handle;
+}
+
+void ResidencyPolicy::Remove(ResidencyHandle handle) {
+    Object &object = objects[handle];
+    if (object.resident) {
+        residentBytes -= object.size;
+    }
+    object.resident = false;
+    object.live = false;
+    object.used = false;
+    freeHandles.push_back(handle);
+}
+
+void ResidencyPolicy::Use(ResidencyHandle handle) {
+    Object &object = objects[handle];
+    if (!object.used) {
+        object.used = true;
+        object.lastUsedSubmission = submission;
+        used.push_back(handle);
+    }
+}
+
+void ResidencyPolicy::Plan(uint64_t completedFenceValue, std::vector<ResidencyHandle> &makeResident, std::vector<ResidencyHandle> &evict) {
+    makeResident.clear();
+    evict.clear();
+    stats = { };
+    stats.budget = budget;
+
+    // Everything the submission references has to be resident, budget or not.
+    for (ResidencyHandle handle : used) {
+        Object &object = objects[handle];
+        if (!object.used || object.resident) {
+            continue;
+        }
+        if (object.evictedSubmission != 0 && submission - object.evictedSubmission <= ThrashWindow) {
+            stats.refaultCount++;
+        }
+        object.resident = true;
+        residentBytes += object.size;
+        stats.madeResidentBytes += object.size;
+        makeResident.push_back(handle);
+    }
+
+    if (residentBytes > budget) {
+        uint64_t target = budget - budget / HysteresisDivisor;
+
+        candidates.clear();
+        for (ResidencyHandle handle = 0; handle < (ResidencyHandle) objects.size(); handle++) {
+            const Object &object = objects[handle];
+            if (!object.live || !object.resident || !object.evictable || object.used || object.lastUsedFence > completedFenceValue ||
+                submission - object.lastUsedSubmission <= protectedSubmissions) {
+                continue;
+            }
+            candidates.push_back(handle);
+        }
+
+        // Least recently used first; among equals, larger objects free more with one call.
+        std::sort(candidates.begin(), candidates.end(), [&](ResidencyHandle a, ResidencyHandle b) {
+            const Object &objectA = objects[a];
+            const Object &objectB = objects[b];
+            if (objectA.lastUsedSubmission != objectB.lastUsedSubmission) {
+                return objectA.lastUsedSubmission < objectB.lastUsedSubmission;
+            }
+            return objectA.size > objectB.size;
+        });
+
+        for (ResidencyHandle handle : candidates) {
+            if (residentBytes <= target) {
+                break;
+            }
+            Object &object = objects[handle];
+            object.resident = false;
+            object.evictedSubmission = submission;
+            residentBytes -= object.size;
+            stats.evictedBytes += object.size;
+            evict.push_back(handle);
+        }
+    }
+
+    stats.residentBytes = residentBytes;
+    stats.overBudgetBytes = residentBytes > budget ? residentBytes - budget : 0;
+    stats.evictCount = (uint32_t) evict.size();
+    stats.makeResidentCount = (uint32_t) makeResident.size();
+}
+
+void ResidencyPolicy::Submit(uint64_t fenceValue) {
+    for (ResidencyHandle handle : used) {
+        Object &object = objects[handle];
+        if (object.used) {
+            object.used = false;
+            object.lastUsedFence = fenceValue;
+        }
+    }
+    used.clear();
+    submission++;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using ResidencyHandle = uint32_t;
+
+// Result of the last Plan().
+struct ResidencyStats {
+    uint64_t budget;
+    uint64_t residentBytes;
+    uint64_t overBudgetBytes;    // Resident bytes above the budget that could not be evicted.
+    uint64_t evictedBytes;
+    uint64_t madeResidentBytes;
+    uint32_t evictCount;
+    uint32_t makeResidentCount;
+    uint32_t refaultCount;       // Objects made resident within ThrashWindow submissions of their eviction.
+};
+
+// Decides which objects stay in video memory. It knows sizes, budget and when each
+// object was last used, but nothing about D3D12, so it runs against any budget.
+//
+// Objects referenced by the submission being built are marked with Use(). Plan() then
+// returns the objects to make resident and, when that goes over budget, the least
+// recently used objects to evict. To avoid thrashing:
+//   - eviction starts above the budget but continues down to a lower watermark, so a
+//     budget hovering around the working set does not evict one object per frame;
+//   - objects the GPU may still be reading (last fence not completed) are never evicted;
+//   - objects used in the last ProtectedSubmissions submissions are kept even over budget.
+//     When the recent working set does not fit, LRU would evict exactly what the next
+//     frame needs; overcommitting is cheaper than paging everything every frame.
+// Objects that are not evictable count against the budget but stay resident.
+class ResidencyPolicy {
+public:
+    static constexpr ResidencyHandle InvalidHandle = UINT32_MAX;
+    static constexpr uint32_t DefaultProtectedSubmissions = 2;
+    static constexpr uint32_t ThrashWindow = 8;
+
+    // New objects are resident, like freshly created D3D12 resources.
+    ResidencyHandle Add(uint64_t size, bool resident = true);
+    void Remove(ResidencyHandle handle);
+    void SetEvictable(ResidencyHandle handle, bool evictable) { objects[handle].evictable = evictable; }
+
+    void SetBudget(uint64_t budget) { this->budget = budget; }
+    uint64_t GetBudget() const { return budget; }
+    void SetProtectedSubmissions(uint32_t count) { protectedSubmissions = count; }
+
+    // Marks an object as referenced by the submission being built.
+    void Use(ResidencyHandle handle);
+
+    // Fills makeResident with used objects that are evicted and evict with objects to page
+    // out, and updates the residency state as if both had been applied.
+    void Plan(uint64_t completedFenceValue, std::vector<ResidencyHandle> &makeResident, std::vector<ResidencyHandle> &evict);
+
+    // Stamps the objects used since the last Submit() with the fence value of their submission.
+    void Submit(uint64_t fenceValue);
+
+    bool IsResident(ResidencyHandle handle) const { return objects[handle].resident; }
+    uint64_t GetSize(ResidencyHandle handle) const { return objects[handle].size; }
+    uint64_t GetResidentBytes() const { return residentBytes; }
+    const ResidencyStats &GetStats() const { return stats; }
+
+private:
+    struct Object {
+        uint64_t size;
+        uint64_t lastUsedFence;       // 0 until first submitted.
+        uint64_t lastUsedSubmission;
+        uint64_t evictedSubmission;
+        bool resident;
+        bool evictable;
+        bool live;
+        bool used;                    // Referenced by the current submission.
+    };
+
+    std::vector<Object> objects;
+    std::vector<ResidencyHandle> freeHandles;
+    std::vector<ResidencyHandle> used;
+    std::vector<ResidencyHandle> candidates;
+    uint64_t budget = UINT64_MAX;
+    uint64_t residentBytes = 0;
+    uint64_t submission = 1;
+    uint32_t protectedSubmissions = DefaultProtectedSubmissions;
+    ResidencyStats stats = { };
+};
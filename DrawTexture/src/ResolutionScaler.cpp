@@ -0,0 +1,68 @@
+#include "ResolutionScaler.h"
+
+#include <algorithm>
+#include <cmath>
+
+ResolutionScaler::ResolutionScaler(const ResolutionScalerSettings &settings) {
+    Reset(settings);
+}
+
+void ResolutionScaler::Reset(const ResolutionScalerSettings &settings) {
+    this->settings = settings;
+    scale = settings.maxScale;
+    fullTime = 0.0f;
+    hasSample = false;
+    overFrames = 0;
+    overMinTime = 0.0f;
+    underFrames = 0;
+    changeCount = 0;
+}
+
+float ResolutionScaler::Update(float gpuTime, float renderScale) {
+    if (gpuTime <= 0.0f || renderScale <= 0.0f) {
+        return scale;
+    }
+
+    float sample = gpuTime / (renderScale * renderScale);
+    fullTime = hasSample ? fullTime + settings.smoothing * (sample - fullTime) : sample;
+    hasSample = true;
+
+    // Scaling down needs every frame of the streak over the band, so a single slow frame
+    // does not lower the resolution; the fastest of them decides how far.
+    float upper = settings.targetTime * settings.upperBand;
+    float lower = settings.targetTime * settings.lowerBand;
+    float middle = settings.targetTime * (settings.lowerBand + settings.upperBand) * 0.5f;
+    if (sample * scale * scale > upper) {
+        underFrames = 0;
+        overMinTime = overFrames == 0 ? sample : (std::min)(overMinTime, sample);
+        if (++overFrames >= settings.downFrames) {
+            overFrames = 0;
+            SetScale((std::max)(std::sqrt(middle / overMinTime), scale - settings.maxDecrease));
+        }
+    } else if (GetPredictedTime() < lower) {
+        overFrames = 0;
+        if (++underFrames >= settings.upFrames) {
+            underFrames = 0;
+            SetScale((std::min)(std::sqrt(middle / fullTime), scale + settings.maxIncrease));
+        }
+    } else {
+        overFrames = 0;
+        underFrames = 0;
+    }
+    return scale;
+}
+
+uint32_t ResolutionScaler::GetScaledSize(uint32_t size) const {
+    return (std::max)(1u, (uint32_t) (size * scale + 0.5f));
+}
+
+void ResolutionScaler::SetScale(float desired) {
+    // Down is rounded down and up is rounded up, so a step always leaves the band side it came from.
+    float steps = desired / settings.scaleStep;
+    steps = desired < scale ? std::floor(steps) : std::ceil(steps);
+    float quantized = (std::min)(settings.maxScale, (std::max)(settings.minScale, steps * settings.scaleStep));
+    if (quantized != scale) {
+        scale = quantized;
+        changeCount++;
+    }
+}
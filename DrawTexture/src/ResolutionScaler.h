@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+struct ResolutionScalerSettings {
+    float targetTime = 16.0f;   // GPU milliseconds per frame.
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float scaleStep = 1.0f / 32; // Scales are multiples of this, so small corrections do not resize.
+
+    // Hysteresis: the scale drops when the predicted time is above targetTime * upperBand
+    // and rises when it is below targetTime * lowerBand. Changes aim at the middle.
+    float lowerBand = 0.80f;
+    float upperBand = 0.95f;
+
+    float smoothing = 0.25f;    // Weight of a new sample in the moving average.
+    uint32_t downFrames = 3;    // Consecutive frames over the band before scaling down.
+    uint32_t upFrames = 30;     // Consecutive frames under the band before scaling up.
+    float maxDecrease = 0.25f;  // Largest change of the scale in one step.
+    float maxIncrease = 0.0625f;
+};
+
+// Chooses the render scale from measured GPU frame times. The GPU time of a frame is
+// assumed to be proportional to its pixel count, so samples are normalized to full
+// resolution with the scale they were rendered at; samples that arrive a few frames late
+// still predict the current scale correctly. Scaling down reacts within a few frames,
+// scaling up only after a long stretch under budget, so a frame time near the target
+// does not make the resolution oscillate.
+class ResolutionScaler {
+public:
+    ResolutionScaler() = default;
+    explicit ResolutionScaler(const ResolutionScalerSettings &settings);
+
+    void Reset(const ResolutionScalerSettings &settings);
+
+    // gpuTime is the measured time of a frame rendered at renderScale. Returns the new scale.
+    float Update(float gpuTime, float renderScale);
+
+    float GetScale() const { return scale; }
+
+    // size * scale, at least 1.
+    uint32_t GetScaledSize(uint32_t size) const;
+
+    // Moving average of the GPU time predicted for the current scale.
+    float GetPredictedTime() const { return fullTime * scale * scale; }
+    uint32_t GetChangeCount() const { return changeCount; }
+
+private:
+    void SetScale(float desired);
+
+    ResolutionScalerSettings settings;
+    float scale = 1.0f;
+    float fullTime = 0.0f;      // Average GPU time normalized to scale 1.
+    bool hasSample = false;
+    uint32_t overFrames = 0;
+    float overMinTime = 0.0f;   // Fastest normalized sample of the current streak over the band.
+    uint32_t underFrames = 0;
+    uint32_t changeCount = 0;
+};
@@ -0,0 +1,288 @@
+#include "RootSignatureCache.h"
+
+#include <d3d12shader.h>
+#include <d3dcompiler.h>
+
+using Microsoft::WRL::ComPtr;
+
+static_assert(DescriptorFlags::DescriptorsVolatile == D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE, "Descriptor flags must match D3D12.");
+static_assert(DescriptorFlags::DataVolatile == D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE, "Descriptor flags must match D3D12.");
+static_assert(DescriptorFlags::DataStaticWhileSetAtExecute == D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, "Descriptor flags must match D3D12.");
+static_assert(DescriptorFlags::DataStatic == D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC, "Descriptor flags must match D3D12.");
+static_assert(DescriptorFlags::DataStatic == D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC, "Descriptor flags must match D3D12.");
+
+namespace {
+
+D3D12_SHADER_VISIBILITY GetShaderVisibility(ShaderVisibility visibility) {
+    switch (visibility) {
+    case ShaderVisibility::Vertex: return D3D12_SHADER_VISIBILITY_VERTEX;
+    case ShaderVisibility::Pixel:  return D3D12_SHADER_VISIBILITY_PIXEL;
+    default:                       return D3D12_SHADER_VISIBILITY_ALL;
+    }
+}
+
+D3D12_DESCRIPTOR_RANGE_TYPE GetRangeType(ShaderBindingType type) {
+    switch (type) {
+    case ShaderBindingType::ConstantBuffer: return D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+    case ShaderBindingType::ReadWrite:      return D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+    case ShaderBindingType::Sampler:        return D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+    default:                                return D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    }
+}
+
+D3D12_ROOT_PARAMETER_TYPE GetParameterType(RootParameterType type) {
+    switch (type) {
+    case RootParameterType::Constants:           return D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    case RootParameterType::ConstantBufferView:  return D3D12_ROOT_PARAMETER_TYPE_CBV;
+    case RootParameterType::ShaderResourceView:  return D3D12_ROOT_PARAMETER_TYPE_SRV;
+    case RootParameterType::UnorderedAccessView: return D3D12_ROOT_PARAMETER_TYPE_UAV;
+    default:                                     return D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    }
+}
+
+}
+
+HRESULT ReflectShader(ID3DBlob *bytecode, ShaderStage stage, ShaderReflectionData &data) {
+    if (!bytecode) {
+        return E_INVALIDARG;
+    }
+
+    ComPtr<ID3D12ShaderReflection> reflection;
+    HRESULT hr = D3DReflect(bytecode->GetBufferPointer(), bytecode->GetBufferSize(), IID_PPV_ARGS(&reflection));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    D3D12_SHADER_DESC desc;
+    hr = reflection->GetDesc(&desc);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    data = ShaderReflectionData();
+    data.stage = stage;
+
+    for (UINT i = 0; i < desc.BoundResources; i++) {
+        D3D12_SHADER_INPUT_BIND_DESC bind;
+        hr = reflection->GetResourceBindingDesc(i, &bind);
+        if (FAILED(hr)) {
+            return hr;
+        }
+
+        ShaderBinding binding;
+        binding.name = bind.Name;
+        binding.shaderRegister = bind.BindPoint;
+        binding.space = bind.Space;
+        binding.count = bind.BindCount == UINT_MAX ? 0 : bind.BindCount;  // Unbounded arrays report 0 or UINT_MAX.
+        binding.size = 0;
+
+        switch (bind.Type) {
+        case D3D_SIT_CBUFFER: {
+            binding.type = ShaderBindingType::ConstantBuffer;
+            D3D12_SHADER_BUFFER_DESC bufferDesc;
+            if (SUCCEEDED(reflection->GetConstantBufferByName(bind.Name)->GetDesc(&bufferDesc))) {
+                binding.size = bufferDesc.Size;
+            }
+            break;
+        }
+        case D3D_SIT_TBUFFER:
+        case D3D_SIT_TEXTURE:
+            binding.type = ShaderBindingType::Texture;
+            break;
+        case D3D_SIT_STRUCTURED:
+        case D3D_SIT_BYTEADDRESS:
+            binding.type = ShaderBindingType::Buffer;
+            break;
+        case D3D_SIT_SAMPLER:
+            binding.type = ShaderBindingType::Sampler;
+            break;
+        default:
+            binding.type = ShaderBindingType::ReadWrite;
+            break;
+        }
+        data.bindings.push_back(binding);
+    }
+
+    // Pixel shader inputs are interpolants; only vertex inputs make an input layout.
+    for (UINT i = 0; stage == ShaderStage::Vertex && i < desc.InputParameters; i++) {
+        D3D12_SIGNATURE_PARAMETER_DESC parameter;
+        hr = reflection->GetInputParameterDesc(i, &parameter);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        if (parameter.SystemValueType != D3D_NAME_UNDEFINED) {
+            continue;
+        }
+
+        ShaderInput input;
+        input.semantic = parameter.SemanticName;
+        input.semanticIndex = parameter.SemanticIndex;
+        input.componentCount = 0;
+        for (BYTE mask = parameter.Mask; mask; mask >>= 1) {
+            input.componentCount += mask & 1;
+        }
+        data.inputs.push_back(input);
+    }
+
+    return S_OK;
+}
+
+void GetInputElements(const std::vector<VertexAttribute> &layout, std::vector<D3D12_INPUT_ELEMENT_DESC> &elements) {
+    elements.clear();
+    for (const VertexAttribute &attribute : layout) {
+        elements.push_back({ attribute.semantic, attribute.semanticIndex, DXGI_FORMAT(attribute.format), attribute.slot,
+                             attribute.offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+    }
+}
+
+HRESULT RootSignatureCache::Init(ID3D12Device *device, const std::vector<D3D12_STATIC_SAMPLER_DESC> &samplers) {
+    this->device = device;
+    this->samplers = samplers;
+    rootSignatures.clear();
+    requestCount = 0;
+
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE feature = { D3D_ROOT_SIGNATURE_VERSION_1_1 };
+    if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &feature, sizeof(feature)))) {
+        version = feature.HighestVersion;
+    } else {
+        version = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+
+    return S_OK;
+}
+
+HRESULT RootSignatureCache::Get(const RootLayout &layout, ComPtr<ID3D12RootSignature> &rootSignature) {
+    requestCount++;
+
+    std::string key = layout.GetKey();
+    auto found = rootSignatures.find(key);
+    if (found != rootSignatures.end()) {
+        rootSignature = found->second;
+        return S_OK;
+    }
+
+    HRESULT hr = Create(layout, rootSignature);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    rootSignatures[key] = rootSignature;
+    return S_OK;
+}
+
+HRESULT RootSignatureCache::Create(const RootLayout &layout, ComPtr<ID3D12RootSignature> &rootSignature) const {
+    const std::vector<RootParameterLayout> &parameterLayouts = layout.GetParameters();
+
+    // Version 1.1 structures; converted to 1.0 below if needed.
+    std::vector<std::vector<D3D12_DESCRIPTOR_RANGE1>> ranges(parameterLayouts.size());
+    std::vector<D3D12_ROOT_PARAMETER1> parameters(parameterLayouts.size());
+    for (size_t i = 0; i < parameterLayouts.size(); i++) {
+        const RootParameterLayout &source = parameterLayouts[i];
+        D3D12_ROOT_PARAMETER1 &parameter = parameters[i];
+        parameter.ParameterType = GetParameterType(source.type);
+        parameter.ShaderVisibility = GetShaderVisibility(source.visibility);
+
+        switch (source.type) {
+        case RootParameterType::Constants:
+            parameter.Constants.ShaderRegister = source.shaderRegister;
+            parameter.Constants.RegisterSpace = source.space;
+            parameter.Constants.Num32BitValues = source.constantCount;
+            break;
+        case RootParameterType::DescriptorTable:
+            for (const DescriptorRangeLayout &range : source.ranges) {
+                D3D12_DESCRIPTOR_RANGE1 descriptorRange;
+                descriptorRange.RangeType = GetRangeType(range.type);
+                descriptorRange.NumDescriptors = range.count ? range.count : UINT_MAX;
+                descriptorRange.BaseShaderRegister = range.baseRegister;
+                descriptorRange.RegisterSpace = range.space;
+                descriptorRange.Flags = D3D12_DESCRIPTOR_RANGE_FLAGS(range.flags);
+                descriptorRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+                ranges[i].push_back(descriptorRange);
+            }
+            parameter.DescriptorTable.NumDescriptorRanges = UINT(ranges[i].size());
+            parameter.DescriptorTable.pDescriptorRanges = ranges[i].data();
+            break;
+        default:
+            parameter.Descriptor.ShaderRegister = source.shaderRegister;
+            parameter.Descriptor.RegisterSpace = source.space;
+            parameter.Descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAGS(source.flags);
+            break;
+        }
+    }
+
+    std::vector<D3D12_STATIC_SAMPLER_DESC> staticSamplers;
+    for (const StaticSamplerLayout &source : layout.GetStaticSamplers()) {
+        if (source.sampler >= samplers.size()) {
+            return E_INVALIDARG;
+        }
+        D3D12_STATIC_SAMPLER_DESC sampler = samplers[source.sampler];
+        sampler.ShaderRegister = source.shaderRegister;
+        sampler.RegisterSpace = source.space;
+        sampler.ShaderVisibility = GetShaderVisibility(source.visibility);
+        staticSamplers.push_back(sampler);
+    }
+
+    D3D12_ROOT_SIGNATURE_FLAGS flags = D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+                                       D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+                                       D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+    if (layout.AllowsInputLayout()) {
+        flags |= D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    }
+    if (layout.DeniesStage(ShaderStage::Vertex)) {
+        flags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS;
+    }
+    if (layout.DeniesStage(ShaderStage::Pixel)) {
+        flags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS;
+    }
+
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC desc;
+    std::vector<std::vector<D3D12_DESCRIPTOR_RANGE>> ranges10;
+    std::vector<D3D12_ROOT_PARAMETER> parameters10;
+    if (version >= D3D_ROOT_SIGNATURE_VERSION_1_1) {
+        desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+        desc.Desc_1_1.NumParameters = UINT(parameters.size());
+        desc.Desc_1_1.pParameters = parameters.data();
+        desc.Desc_1_1.NumStaticSamplers = UINT(staticSamplers.size());
+        desc.Desc_1_1.pStaticSamplers = staticSamplers.data();
+        desc.Desc_1_1.Flags = flags;
+    } else {
+        ranges10.resize(parameters.size());
+        parameters10.resize(parameters.size());
+        for (size_t i = 0; i < parameters.size(); i++) {
+            D3D12_ROOT_PARAMETER &parameter = parameters10[i];
+            parameter.ParameterType = parameters[i].ParameterType;
+            parameter.ShaderVisibility = parameters[i].ShaderVisibility;
+            if (parameter.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS) {
+                parameter.Constants = parameters[i].Constants;
+            } else if (parameter.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
+                for (const D3D12_DESCRIPTOR_RANGE1 &range : ranges[i]) {
+                    ranges10[i].push_back({ range.RangeType, range.NumDescriptors, range.BaseShaderRegister, range.RegisterSpace,
+                                            range.OffsetInDescriptorsFromTableStart });
+                }
+                parameter.DescriptorTable.NumDescriptorRanges = UINT(ranges10[i].size());
+                parameter.DescriptorTable.pDescriptorRanges = ranges10[i].data();
+            } else {
+                parameter.Descriptor.ShaderRegister = parameters[i].Descriptor.ShaderRegister;
+                parameter.Descriptor.RegisterSpace = parameters[i].Descriptor.RegisterSpace;
+            }
+        }
+
+        desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_0;
+        desc.Desc_1_0.NumParameters = UINT(parameters10.size());
+        desc.Desc_1_0.pParameters = parameters10.data();
+        desc.Desc_1_0.NumStaticSamplers = UINT(staticSamplers.size());
+        desc.Desc_1_0.pStaticSamplers = staticSamplers.data();
+        desc.Desc_1_0.Flags = flags;
+    }
+
+    ComPtr<ID3DBlob> blob;
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3D12SerializeVersionedRootSignature(&desc, &blob, &errors);
+    if (errors) {
+        OutputDebugStringA((const char *) errors->GetBufferPointer());
+    }
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    return device->CreateRootSignature(0, blob->GetBufferPointer(), blob->GetBufferSize(), IID_PPV_ARGS(&rootSignature));
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <d3d12.h>
+#include <d3dcommon.h>
+#include <wrl.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ShaderLayout.h"
+
+// Reads the bindings and, for vertex shaders, the inputs of compiled bytecode.
+HRESULT ReflectShader(ID3DBlob *bytecode, ShaderStage stage, ShaderReflectionData &data);
+
+// Input elements of a layout from BuildInputLayout(). Semantic names point to the
+// attributes' strings, which must outlive the elements.
+void GetInputElements(const std::vector<VertexAttribute> &layout, std::vector<D3D12_INPUT_ELEMENT_DESC> &elements);
+
+// Creates root signatures from RootLayouts. Layouts with the same key share one root
+// signature, so shaders with equal bindings do not cause root signature switches.
+// Version 1.1 is used where the device supports it; on 1.0 the descriptor flags are dropped.
+class RootSignatureCache {
+public:
+    // Static samplers of the layouts index into samplers; their register, space and
+    // visibility come from the layout.
+    HRESULT Init(ID3D12Device *device, const std::vector<D3D12_STATIC_SAMPLER_DESC> &samplers);
+
+    HRESULT Get(const RootLayout &layout, Microsoft::WRL::ComPtr<ID3D12RootSignature> &rootSignature);
+
+    UINT GetCount() const { return UINT(rootSignatures.size()); }
+    UINT GetRequestCount() const { return requestCount; }
+    D3D_ROOT_SIGNATURE_VERSION GetVersion() const { return version; }
+
+private:
+    HRESULT Create(const RootLayout &layout, Microsoft::WRL::ComPtr<ID3D12RootSignature> &rootSignature) const;
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    std::vector<D3D12_STATIC_SAMPLER_DESC> samplers;
+    D3D_ROOT_SIGNATURE_VERSION version = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    std::map<std::string, Microsoft::WRL::ComPtr<ID3D12RootSignature>> rootSignatures;
+    UINT requestCount = 0;
+};
@@ -0,0 +1,30 @@
+#include "ShaderKey.h"
+
+ShaderBuildPlan PlanShaderBuild(
+    const std::vector<ShaderKey> &keys,
+    uint32_t vertexAxes,
+    uint32_t pixelAxes,
+    const bool (&builtVertexShaders)[ShaderKey::Count],
+    const bool (&builtPixelShaders)[ShaderKey::Count],
+    const bool (&builtPipelines)[ShaderKey::Count]) {
+    ShaderBuildPlan plan;
+    bool queued[3][ShaderKey::Count] = { };
+    for (ShaderKey key : keys) {
+        ShaderKey vertexKey = key.Masked(vertexAxes);
+        ShaderKey pixelKey = key.Masked(pixelAxes);
+
+        if (!queued[0][vertexKey.GetValue()] && !builtVertexShaders[vertexKey.GetValue()]) {
+            queued[0][vertexKey.GetValue()] = true;
+            plan.vertexShaders.push_back(vertexKey);
+        }
+        if (!queued[1][pixelKey.GetValue()] && !builtPixelShaders[pixelKey.GetValue()]) {
+            queued[1][pixelKey.GetValue()] = true;
+            plan.pixelShaders.push_back(pixelKey);
+        }
+        if (!queued[2][key.GetValue()] && !builtPipelines[key.GetValue()]) {
+            queued[2][key.GetValue()] = true;
+            plan.pipelines.push_back(key);
+        }
+    }
+    return plan;
+}
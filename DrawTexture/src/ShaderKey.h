@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A value stored in bits [Shift, Shift + Bits) of a ShaderKey.
+template <uint32_t Shift, uint32_t Bits>
+struct ShaderKeyField {
+    static constexpr uint32_t Mask = ((1u << Bits) - 1) << Shift;
+    static constexpr uint32_t ValueCount = 1u << Bits;
+
+    // A value that does not fit is a compile error in constant expressions.
+    static constexpr uint32_t Encode(uint32_t value) {
+        return value < ValueCount ? value << Shift : throw "Value does not fit in the shader key field.";
+    }
+
+    static constexpr uint32_t Decode(uint32_t key) {
+        return (key & Mask) >> Shift;
+    }
+};
+
+enum class SamplingMode : uint32_t {
+    Linear,
+    Point,
+};
+
+// Feature axes of the DrawTexture shaders packed into one integer. The key is
+// the index into the bytecode and pipeline state tables, so lookups are O(1).
+class ShaderKey {
+public:
+    using Sampling = ShaderKeyField<0, 1>;
+    using AlphaTest = ShaderKeyField<1, 1>;
+
+    static constexpr uint32_t Bits = 2;
+    static constexpr uint32_t Count = 1u << Bits;
+    static constexpr uint32_t AllAxes = Sampling::Mask | AlphaTest::Mask;
+
+    constexpr ShaderKey() : value(0) { }
+    constexpr ShaderKey(SamplingMode sampling, bool alphaTest)
+        : value(Sampling::Encode(uint32_t(sampling)) | AlphaTest::Encode(alphaTest)) { }
+
+    static constexpr ShaderKey FromValue(uint32_t value) {
+        return value < Count ? ShaderKey(value) : throw "Shader key out of range.";
+    }
+
+    constexpr uint32_t GetValue() const { return value; }
+    constexpr SamplingMode GetSamplingMode() const { return SamplingMode(Sampling::Decode(value)); }
+    constexpr bool HasAlphaTest() const { return AlphaTest::Decode(value) != 0; }
+
+    // The key with only the given axes kept, used to share bytecode between keys.
+    constexpr ShaderKey Masked(uint32_t axes) const { return ShaderKey(value & axes); }
+
+private:
+    explicit constexpr ShaderKey(uint32_t value) : value(value) { }
+
+    uint32_t value;
+};
+
+static_assert((ShaderKey::Sampling::Mask & ShaderKey::AlphaTest::Mask) == 0, "Shader key fields overlap.");
+static_assert(ShaderKey::AllAxes < ShaderKey::Count, "Shader key fields exceed ShaderKey::Bits.");
+static_assert(ShaderKey(SamplingMode::Point, true).GetValue() == 3, "Unexpected shader key layout.");
+
+// What a set of keys still needs: the vertex and pixel shader variants, as keys masked to
+// the axes of their stage, and the pipeline states. Each appears once, in key order.
+struct ShaderBuildPlan {
+    std::vector<ShaderKey> vertexShaders;
+    std::vector<ShaderKey> pixelShaders;
+    std::vector<ShaderKey> pipelines;
+};
+
+// The built* tables are indexed by key value and mark what exists already; built
+// variants and pipelines are left out of the plan.
+ShaderBuildPlan PlanShaderBuild(
+    const std::vector<ShaderKey> &keys,
+    uint32_t vertexAxes,
+    uint32_t pixelAxes,
+    const bool (&builtVertexShaders)[ShaderKey::Count],
+    const bool (&builtPixelShaders)[ShaderKey::Count],
+    const bool (&builtPipelines)[ShaderKey::Count]);
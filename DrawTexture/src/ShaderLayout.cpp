@@ -0,0 +1,337 @@
+#include "ShaderLayout.h"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <tuple>
+
+namespace {
+
+const char *const BindingTypeNames[] = { "cbuffer", "texture", "buffer", "readwrite", "sampler" };
+const char *const StageNames[] = { "vertex", "pixel" };
+
+// Register class of a binding type: b, t, u or s.
+uint32_t GetRegisterClass(ShaderBindingType type) {
+    switch (type) {
+    case ShaderBindingType::ConstantBuffer: return 0;
+    case ShaderBindingType::Texture:
+    case ShaderBindingType::Buffer:         return 1;
+    case ShaderBindingType::ReadWrite:      return 2;
+    default:                                return 3;
+    }
+}
+
+template <typename Enum, size_t Count>
+bool ParseName(const std::string &text, const char *const (&names)[Count], Enum &value) {
+    for (size_t i = 0; i < Count; i++) {
+        if (text == names[i]) {
+            value = Enum(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EqualsIgnoreCase(const std::string &a, const char *b) {
+    size_t i = 0;
+    for (; i < a.size() && b[i]; i++) {
+        if (std::tolower((unsigned char) a[i]) != std::tolower((unsigned char) b[i])) {
+            return false;
+        }
+    }
+    return i == a.size() && !b[i];
+}
+
+struct MergedBinding {
+    ShaderBinding binding;
+    uint32_t stages;  // Bit per ShaderStage.
+};
+
+ShaderVisibility GetVisibility(uint32_t stages) {
+    switch (stages) {
+    case 1u << uint32_t(ShaderStage::Vertex): return ShaderVisibility::Vertex;
+    case 1u << uint32_t(ShaderStage::Pixel):  return ShaderVisibility::Pixel;
+    default:                                  return ShaderVisibility::All;
+    }
+}
+
+uint32_t GetDefaultFlags(ShaderBindingType type) {
+    switch (type) {
+    case ShaderBindingType::Sampler:   return DescriptorFlags::None;
+    case ShaderBindingType::ReadWrite: return DescriptorFlags::DataVolatile;
+    default:                           return DescriptorFlags::DataStaticWhileSetAtExecute;
+    }
+}
+
+uint32_t GetConstantCount(const ShaderBinding &binding) {
+    return (binding.size + 3) / 4;
+}
+
+}
+
+std::string SerializeReflection(const ShaderReflectionData &data) {
+    std::ostringstream stream;
+    stream << "stage " << StageNames[uint32_t(data.stage)] << "\n";
+    for (const ShaderBinding &binding : data.bindings) {
+        stream << "binding " << BindingTypeNames[uint32_t(binding.type)] << " " << binding.name << " "
+               << binding.shaderRegister << " " << binding.space << " " << binding.count << " " << binding.size << "\n";
+    }
+    for (const ShaderInput &input : data.inputs) {
+        stream << "input " << input.semantic << " " << input.semanticIndex << " " << input.componentCount << "\n";
+    }
+    return stream.str();
+}
+
+bool ParseReflection(const std::string &text, ShaderReflectionData &data) {
+    data = ShaderReflectionData();
+    data.stage = ShaderStage::Vertex;
+
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream stream(line);
+        std::string kind;
+        if (!(stream >> kind) || kind[0] == '#') {
+            continue;
+        }
+
+        std::string name;
+        if (kind == "stage") {
+            if (!(stream >> name) || !ParseName(name, StageNames, data.stage)) {
+                return false;
+            }
+        } else if (kind == "binding") {
+            ShaderBinding binding;
+            std::string type;
+            if (!(stream >> type >> binding.name >> binding.shaderRegister >> binding.space >> binding.count >> binding.size) ||
+                !ParseName(type, BindingTypeNames, binding.type)) {
+                return false;
+            }
+            data.bindings.push_back(binding);
+        } else if (kind == "input") {
+            ShaderInput input;
+            if (!(stream >> input.semantic >> input.semanticIndex >> input.componentCount)) {
+                return false;
+            }
+            data.inputs.push_back(input);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MergeReflection(const ShaderReflectionData &source, ShaderReflectionData &target) {
+    for (const ShaderBinding &binding : source.bindings) {
+        auto found = std::find_if(target.bindings.begin(), target.bindings.end(), [&](const ShaderBinding &other) {
+            return other.type == binding.type && other.shaderRegister == binding.shaderRegister && other.space == binding.space;
+        });
+        if (found == target.bindings.end()) {
+            target.bindings.push_back(binding);
+        } else {
+            found->count = found->count == 0 || binding.count == 0 ? 0 : (std::max)(found->count, binding.count);
+            found->size = (std::max)(found->size, binding.size);
+        }
+    }
+
+    for (const ShaderInput &input : source.inputs) {
+        auto found = std::find_if(target.inputs.begin(), target.inputs.end(), [&](const ShaderInput &other) {
+            return EqualsIgnoreCase(other.semantic, input.semantic.c_str()) && other.semanticIndex == input.semanticIndex;
+        });
+        if (found == target.inputs.end()) {
+            target.inputs.push_back(input);
+        }
+    }
+}
+
+bool RootLayout::Build(const std::vector<ShaderReflectionData> &stages, const RootLayoutOptions &options) {
+    parameters.clear();
+    staticSamplers.clear();
+    allowInputLayout = false;
+    deniedStages = 0;
+
+    // Bindings of all stages by register class, space and register, so the layout does
+    // not depend on the order in which shaders list them.
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, MergedBinding> bindings;
+    uint32_t usedStages = 0;
+    for (const ShaderReflectionData &stage : stages) {
+        uint32_t stageBit = 1u << uint32_t(stage.stage);
+        for (const ShaderBinding &binding : stage.bindings) {
+            auto key = std::make_tuple(GetRegisterClass(binding.type), binding.space, binding.shaderRegister);
+            auto found = bindings.find(key);
+            if (found == bindings.end()) {
+                bindings[key] = { binding, stageBit };
+            } else if (found->second.binding.type != binding.type) {
+                return false;
+            } else {
+                found->second.stages |= stageBit;
+                found->second.binding.size = (std::max)(found->second.binding.size, binding.size);
+            }
+            usedStages |= stageBit;
+        }
+        allowInputLayout |= stage.stage == ShaderStage::Vertex && !stage.inputs.empty();
+    }
+    deniedStages = ~usedStages & ((1u << uint32_t(ShaderStage::Vertex)) | (1u << uint32_t(ShaderStage::Pixel)));
+
+    auto getFlags = [&](const ShaderBinding &binding) {
+        auto found = options.flags.find(binding.name);
+        return found != options.flags.end() ? found->second : GetDefaultFlags(binding.type);
+    };
+
+    // Root constants and root descriptors first; everything else goes into tables.
+    std::vector<const MergedBinding *> constants, descriptors, tabled;
+    for (const auto &entry : bindings) {
+        const MergedBinding &merged = entry.second;
+        const ShaderBinding &binding = merged.binding;
+        if (binding.type == ShaderBindingType::Sampler && options.staticSamplers.count(binding.name) && binding.count == 1) {
+            staticSamplers.push_back({ binding.name, binding.shaderRegister, binding.space, GetVisibility(merged.stages),
+                                       options.staticSamplers.at(binding.name) });
+        } else if (binding.type == ShaderBindingType::ConstantBuffer && binding.count == 1 &&
+                   binding.size > 0 && GetConstantCount(binding) <= options.maxRootConstants) {
+            constants.push_back(&merged);
+        } else if ((binding.type == ShaderBindingType::ConstantBuffer || binding.type == ShaderBindingType::Buffer) && binding.count == 1) {
+            descriptors.push_back(&merged);
+        } else {
+            tabled.push_back(&merged);
+        }
+    }
+
+    // Over budget, the largest root constants become root descriptors, then root
+    // descriptors move into tables. A table is counted for every binding here, which
+    // overestimates the cost and keeps the loop simple.
+    auto getCost = [&]() {
+        uint32_t cost = uint32_t(descriptors.size() * 2 + tabled.size());
+        for (const MergedBinding *merged : constants) {
+            cost += GetConstantCount(merged->binding);
+        }
+        return cost;
+    };
+    std::stable_sort(constants.begin(), constants.end(), [](const MergedBinding *a, const MergedBinding *b) {
+        return GetConstantCount(a->binding) < GetConstantCount(b->binding);
+    });
+    while (getCost() > MaxCost && !constants.empty()) {
+        descriptors.push_back(constants.back());
+        constants.pop_back();
+    }
+    while (getCost() > MaxCost && !descriptors.empty()) {
+        tabled.push_back(descriptors.back());
+        descriptors.pop_back();
+    }
+    if (getCost() > MaxCost) {
+        return false;
+    }
+
+    auto byRegister = [](const MergedBinding *a, const MergedBinding *b) {
+        return std::make_tuple(a->binding.space, a->binding.shaderRegister) < std::make_tuple(b->binding.space, b->binding.shaderRegister);
+    };
+    std::stable_sort(constants.begin(), constants.end(), byRegister);
+    std::stable_sort(descriptors.begin(), descriptors.end(), byRegister);
+    for (const MergedBinding *merged : constants) {
+        const ShaderBinding &binding = merged->binding;
+        RootParameterLayout parameter = { RootParameterType::Constants, GetVisibility(merged->stages),
+                                          binding.shaderRegister, binding.space, GetConstantCount(binding), DescriptorFlags::None, { }, binding.name };
+        parameters.push_back(parameter);
+    }
+
+    for (const MergedBinding *merged : descriptors) {
+        const ShaderBinding &binding = merged->binding;
+        RootParameterType type = binding.type == ShaderBindingType::ConstantBuffer ? RootParameterType::ConstantBufferView : RootParameterType::ShaderResourceView;
+        RootParameterLayout parameter = { type, GetVisibility(merged->stages), binding.shaderRegister, binding.space, 0,
+                                          getFlags(binding) & ~DescriptorFlags::DescriptorsVolatile, { }, binding.name };
+        parameters.push_back(parameter);
+    }
+
+    // One CBV/SRV/UAV table and one sampler table per visibility. Contiguous registers of
+    // the same type and flags share a range.
+    std::stable_sort(tabled.begin(), tabled.end(), [](const MergedBinding *a, const MergedBinding *b) {
+        return std::make_tuple(GetRegisterClass(a->binding.type), a->binding.space, a->binding.shaderRegister) <
+               std::make_tuple(GetRegisterClass(b->binding.type), b->binding.space, b->binding.shaderRegister);
+    });
+    for (bool samplers : { false, true }) {
+        for (ShaderVisibility visibility : { ShaderVisibility::All, ShaderVisibility::Vertex, ShaderVisibility::Pixel }) {
+            RootParameterLayout table = { RootParameterType::DescriptorTable, visibility, 0, 0, 0, DescriptorFlags::None, { }, "" };
+            for (const MergedBinding *merged : tabled) {
+                const ShaderBinding &binding = merged->binding;
+                if ((binding.type == ShaderBindingType::Sampler) != samplers || GetVisibility(merged->stages) != visibility) {
+                    continue;
+                }
+
+                uint32_t flags = getFlags(binding);
+                DescriptorRangeLayout *last = table.ranges.empty() ? nullptr : &table.ranges.back();
+                if (last && GetRegisterClass(last->type) == GetRegisterClass(binding.type) && last->space == binding.space &&
+                    last->flags == flags && last->count != 0 && binding.count != 0 && last->baseRegister + last->count == binding.shaderRegister) {
+                    last->count += binding.count;
+                    last->names.push_back(binding.name);
+                } else {
+                    table.ranges.push_back({ binding.type, binding.shaderRegister, binding.space, binding.count, flags, { binding.name } });
+                }
+            }
+            if (!table.ranges.empty()) {
+                parameters.push_back(table);
+            }
+        }
+    }
+
+    return GetCost() <= MaxCost;
+}
+
+uint32_t RootLayout::GetCost() const {
+    uint32_t cost = 0;
+    for (const RootParameterLayout &parameter : parameters) {
+        cost += parameter.type == RootParameterType::Constants ? parameter.constantCount :
+                parameter.type == RootParameterType::DescriptorTable ? 1 : 2;
+    }
+    return cost;
+}
+
+uint32_t RootLayout::FindParameter(const char *name) const {
+    for (uint32_t i = 0; i < uint32_t(parameters.size()); i++) {
+        const RootParameterLayout &parameter = parameters[i];
+        if (parameter.name == name) {
+            return i;
+        }
+        for (const DescriptorRangeLayout &range : parameter.ranges) {
+            if (std::find(range.names.begin(), range.names.end(), name) != range.names.end()) {
+                return i;
+            }
+        }
+    }
+    return InvalidIndex;
+}
+
+std::string RootLayout::GetKey() const {
+    std::ostringstream stream;
+    stream << "ia" << allowInputLayout << " deny" << deniedStages;
+    for (const RootParameterLayout &parameter : parameters) {
+        stream << " p" << uint32_t(parameter.type) << "," << uint32_t(parameter.visibility);
+        if (parameter.type == RootParameterType::DescriptorTable) {
+            for (const DescriptorRangeLayout &range : parameter.ranges) {
+                stream << " r" << GetRegisterClass(range.type) << "," << range.baseRegister << "," << range.space << "," << range.count << "," << range.flags;
+            }
+        } else {
+            stream << "," << parameter.shaderRegister << "," << parameter.space << "," << parameter.constantCount << "," << parameter.flags;
+        }
+    }
+    for (const StaticSamplerLayout &sampler : staticSamplers) {
+        stream << " s" << sampler.shaderRegister << "," << sampler.space << "," << uint32_t(sampler.visibility) << "," << sampler.sampler;
+    }
+    return stream.str();
+}
+
+bool BuildInputLayout(const ShaderReflectionData &vertexShader, const std::vector<VertexAttribute> &attributes,
+                      std::vector<VertexAttribute> &layout, std::string *missing) {
+    layout.clear();
+    for (const ShaderInput &input : vertexShader.inputs) {
+        auto found = std::find_if(attributes.begin(), attributes.end(), [&](const VertexAttribute &attribute) {
+            return EqualsIgnoreCase(input.semantic, attribute.semantic) && attribute.semanticIndex == input.semanticIndex;
+        });
+        if (found == attributes.end()) {
+            if (missing) {
+                *missing = input.semantic;
+            }
+            return false;
+        }
+        layout.push_back(*found);
+    }
+    return true;
+}
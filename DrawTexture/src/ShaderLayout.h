@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reflected shader interfaces and the root signature and input layouts derived from
+// them. Everything here is plain data, so layouts can be generated and checked from
+// serialized reflection without a device; RootSignatureCache turns them into D3D12 objects.
+
+enum class ShaderStage : uint32_t {
+    Vertex,
+    Pixel,
+};
+
+enum class ShaderBindingType : uint32_t {
+    ConstantBuffer,   // b
+    Texture,          // t, typed views
+    Buffer,           // t, structured and byte address buffers
+    ReadWrite,        // u
+    Sampler,          // s
+};
+
+struct ShaderBinding {
+    std::string name;
+    ShaderBindingType type;
+    uint32_t shaderRegister;
+    uint32_t space;
+    uint32_t count;   // 0 for unbounded arrays.
+    uint32_t size;    // Bytes of a constant buffer, 0 otherwise.
+};
+
+// A vertex shader input that is not a system value.
+struct ShaderInput {
+    std::string semantic;
+    uint32_t semanticIndex;
+    uint32_t componentCount;
+};
+
+struct ShaderReflectionData {
+    ShaderStage stage;
+    std::vector<ShaderBinding> bindings;
+    std::vector<ShaderInput> inputs;
+};
+
+// One line per entry, e.g. "binding cbuffer DrawConstants 0 0 1 4"; see ShaderLayout.cpp.
+std::string SerializeReflection(const ShaderReflectionData &data);
+bool ParseReflection(const std::string &text, ShaderReflectionData &data);
+
+// Bindings of several variants of one stage, merged so that the variants share a root signature.
+void MergeReflection(const ShaderReflectionData &source, ShaderReflectionData &target);
+
+// Same values as D3D12_DESCRIPTOR_RANGE_FLAGS and D3D12_ROOT_DESCRIPTOR_FLAGS.
+namespace DescriptorFlags {
+constexpr uint32_t None = 0;
+constexpr uint32_t DescriptorsVolatile = 0x1;  // Tables only.
+constexpr uint32_t DataVolatile = 0x2;
+constexpr uint32_t DataStaticWhileSetAtExecute = 0x4;
+constexpr uint32_t DataStatic = 0x8;
+}
+
+enum class ShaderVisibility : uint32_t {
+    All,
+    Vertex,
+    Pixel,
+};
+
+enum class RootParameterType : uint32_t {
+    Constants,
+    ConstantBufferView,
+    ShaderResourceView,
+    UnorderedAccessView,
+    DescriptorTable,
+};
+
+struct DescriptorRangeLayout {
+    ShaderBindingType type;
+    uint32_t baseRegister;
+    uint32_t space;
+    uint32_t count;   // 0 for unbounded.
+    uint32_t flags;
+    std::vector<std::string> names;  // Of the bindings in the range, by register.
+};
+
+struct RootParameterLayout {
+    RootParameterType type;
+    ShaderVisibility visibility;
+    uint32_t shaderRegister;  // Not used by tables.
+    uint32_t space;
+    uint32_t constantCount;   // 32-bit values of root constants.
+    uint32_t flags;           // Root descriptors only.
+    std::vector<DescriptorRangeLayout> ranges;
+    std::string name;         // Not used by tables.
+};
+
+struct StaticSamplerLayout {
+    std::string name;
+    uint32_t shaderRegister;
+    uint32_t space;
+    ShaderVisibility visibility;
+    uint32_t sampler;  // Index into RootLayoutOptions::staticSamplers' values.
+};
+
+struct RootLayoutOptions {
+    // Constant buffers up to this many 32-bit values become root constants.
+    uint32_t maxRootConstants = 16;
+    // Binding name -> DescriptorFlags, for bindings that differ from the defaults:
+    // DataStaticWhileSetAtExecute for CBVs and SRVs, DataVolatile for UAVs.
+    std::map<std::string, uint32_t> flags;
+    // Sampler name -> index of a caller-defined sampler description. Other samplers go
+    // into a sampler descriptor table.
+    std::map<std::string, uint32_t> staticSamplers;
+};
+
+// A minimal root signature for a set of stages: small constant buffers as root constants,
+// other constant buffers and structured buffers as root descriptors, and the remaining
+// views of each visibility in one descriptor table. Parameters are ordered root
+// constants first, then root descriptors, then tables, which is also the order from the
+// most to the least frequently changed in this sample. Stages without bindings are denied
+// root access.
+class RootLayout {
+public:
+    static constexpr uint32_t InvalidIndex = UINT32_MAX;
+    static constexpr uint32_t MaxCost = 64;  // 32-bit values a root signature may hold.
+
+    // False if the stages bind different types to the same register.
+    bool Build(const std::vector<ShaderReflectionData> &stages, const RootLayoutOptions &options);
+
+    const std::vector<RootParameterLayout> &GetParameters() const { return parameters; }
+    const std::vector<StaticSamplerLayout> &GetStaticSamplers() const { return staticSamplers; }
+    bool AllowsInputLayout() const { return allowInputLayout; }
+    bool DeniesStage(ShaderStage stage) const { return (deniedStages & (1u << uint32_t(stage))) != 0; }
+    uint32_t GetCost() const;
+
+    // The parameter that holds the binding, or InvalidIndex.
+    uint32_t FindParameter(const char *name) const;
+
+    // Equal for layouts that produce the same root signature; binding names are ignored.
+    std::string GetKey() const;
+
+private:
+    std::vector<RootParameterLayout> parameters;
+    std::vector<StaticSamplerLayout> staticSamplers;
+    bool allowInputLayout = false;
+    uint32_t deniedStages = 0;
+};
+
+// An attribute of the vertex streams. format is passed through, e.g. a DXGI_FORMAT.
+struct VertexAttribute {
+    const char *semantic;
+    uint32_t semanticIndex;
+    uint32_t format;
+    uint32_t slot;
+    uint32_t offset;
+};
+
+// The attributes the vertex shader reads, in the order of its inputs. Attributes it does
+// not read are left out. False if an input has no attribute; missing is set to its semantic.
+bool BuildInputLayout(const ShaderReflectionData &vertexShader, const std::vector<VertexAttribute> &attributes,
+                      std::vector<VertexAttribute> &layout, std::string *missing = nullptr);
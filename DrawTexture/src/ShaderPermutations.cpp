@@ -0,0 +1,147 @@
+#include "ShaderPermutations.h"
+
+#include <d3dcompiler.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "Parallel.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+struct CompileJob {
+    const ShaderStageDesc *stage;
+    ShaderKey key;
+    ComPtr<ID3DBlob> *output;
+};
+
+HRESULT CompileVariant(const CompileJob &job, UINT compileFlags) {
+    const char *values[] = { "0", "1" };
+    D3D_SHADER_MACRO defines[] = {
+        { "SAMPLING_POINT", values[job.key.GetSamplingMode() == SamplingMode::Point] },
+        { "ALPHA_TEST", values[job.key.HasAlphaTest()] },
+        { nullptr, nullptr },
+    };
+
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DCompileFromFile(
+        job.stage->file, defines, D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        job.stage->entryPoint, job.stage->target, compileFlags, 0, job.output->GetAddressOf(), &errors);
+    if (errors) {
+        OutputDebugStringA((const char *) errors->GetBufferPointer());
+    }
+    return hr;
+}
+
+}
+
+HRESULT ShaderPermutations::Build(
+    ID3D12Device *device,
+    const ShaderStageDesc &vertexShader,
+    const ShaderStageDesc &pixelShader,
+    UINT compileFlags,
+    const std::vector<ShaderKey> &keys,
+    const PipelineDescFunc &fillDesc) {
+    HRESULT hr = Compile(vertexShader, pixelShader, compileFlags, keys);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    return CreatePipelines(device, keys, fillDesc);
+}
+
+HRESULT ShaderPermutations::Compile(
+    const ShaderStageDesc &vertexShader,
+    const ShaderStageDesc &pixelShader,
+    UINT compileFlags,
+    const std::vector<ShaderKey> &keys) {
+    auto start = std::chrono::steady_clock::now();
+
+    vertexAxes = vertexShader.axes;
+    pixelAxes = pixelShader.axes;
+
+    // Every distinct (stage, masked key) pair is compiled once.
+    bool builtVertexShaders[ShaderKey::Count], builtPixelShaders[ShaderKey::Count], builtPipelines[ShaderKey::Count] = { };
+    for (uint32_t i = 0; i < ShaderKey::Count; i++) {
+        builtVertexShaders[i] = vertexShaders[i] != nullptr;
+        builtPixelShaders[i] = pixelShaders[i] != nullptr;
+    }
+    ShaderBuildPlan plan = PlanShaderBuild(keys, vertexAxes, pixelAxes, builtVertexShaders, builtPixelShaders, builtPipelines);
+
+    std::vector<CompileJob> jobs;
+    for (ShaderKey key : plan.vertexShaders) {
+        jobs.push_back({ &vertexShader, key, vertexShaders + key.GetValue() });
+    }
+    for (ShaderKey key : plan.pixelShaders) {
+        jobs.push_back({ &pixelShader, key, pixelShaders + key.GetValue() });
+    }
+
+    std::atomic<HRESULT> result(S_OK);
+
+    ParallelFor(jobs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            HRESULT hr = CompileVariant(jobs[i], compileFlags);
+            if (FAILED(hr)) {
+                result = hr;
+            }
+        }
+    });
+
+    if (SUCCEEDED(result)) {
+        shaderVariantCount += UINT(jobs.size());
+    }
+
+    buildTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+}
+
+HRESULT ShaderPermutations::CreatePipelines(
+    ID3D12Device *device,
+    const std::vector<ShaderKey> &keys,
+    const PipelineDescFunc &fillDesc) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Every key gets one pipeline state.
+    bool builtShaders[ShaderKey::Count], builtPipelines[ShaderKey::Count];
+    for (uint32_t i = 0; i < ShaderKey::Count; i++) {
+        builtShaders[i] = true;
+        builtPipelines[i] = pipelineStates[i] != nullptr;
+    }
+    std::vector<ShaderKey> newKeys = PlanShaderBuild(keys, vertexAxes, pixelAxes, builtShaders, builtShaders, builtPipelines).pipelines;
+
+    std::atomic<HRESULT> result(S_OK);
+
+    // The device is free-threaded, so pipeline states are created in parallel as well.
+    ParallelFor(newKeys.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ShaderKey key = newKeys[i];
+            ID3DBlob *vs = GetVertexShader(key);
+            ID3DBlob *ps = GetPixelShader(key);
+            if (!vs || !ps) {
+                result = E_INVALIDARG;
+                continue;
+            }
+
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+            fillDesc(key, desc);
+            desc.VS = { vs->GetBufferPointer(), vs->GetBufferSize() };
+            desc.PS = { ps->GetBufferPointer(), ps->GetBufferSize() };
+
+            HRESULT hr = device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineStates[key.GetValue()]));
+            if (FAILED(hr)) {
+                result = hr;
+            }
+        }
+    });
+
+    pipelineCount = 0;
+    for (const ComPtr<ID3D12PipelineState> &pipelineState : pipelineStates) {
+        pipelineCount += pipelineState ? 1 : 0;
+    }
+
+    buildTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+}
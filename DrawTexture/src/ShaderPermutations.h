@@ -0,0 +1,67 @@
+#pragma once
+
+#include <d3d12.h>
+#include <d3dcommon.h>
+#include <wrl.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ShaderKey.h"
+
+// One shader stage and the axes that change its code. Keys that only differ in
+// other axes share the same bytecode.
+struct ShaderStageDesc {
+    LPCWSTR file;
+    const char *entryPoint;
+    const char *target;
+    uint32_t axes;
+};
+
+// Compiles the needed variants of a vertex/pixel shader pair in parallel, then
+// creates one pipeline state per key. The variant of a key is selected with the
+// defines SAMPLING_POINT and ALPHA_TEST (0 or 1).
+class ShaderPermutations {
+public:
+    using PipelineDescFunc = std::function<void(ShaderKey key, D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc)>;
+
+    // fillDesc sets everything but the VS and PS bytecode.
+    HRESULT Build(
+        ID3D12Device *device,
+        const ShaderStageDesc &vertexShader,
+        const ShaderStageDesc &pixelShader,
+        UINT compileFlags,
+        const std::vector<ShaderKey> &keys,
+        const PipelineDescFunc &fillDesc);
+
+    // Build() in two steps, so shaders can be compiled before the device exists.
+    HRESULT Compile(
+        const ShaderStageDesc &vertexShader,
+        const ShaderStageDesc &pixelShader,
+        UINT compileFlags,
+        const std::vector<ShaderKey> &keys);
+    HRESULT CreatePipelines(
+        ID3D12Device *device,
+        const std::vector<ShaderKey> &keys,
+        const PipelineDescFunc &fillDesc);
+
+    // Null if the key was not built.
+    ID3D12PipelineState *GetPipelineState(ShaderKey key) const { return pipelineStates[key.GetValue()].Get(); }
+    ID3DBlob *GetVertexShader(ShaderKey key) const { return vertexShaders[key.Masked(vertexAxes).GetValue()].Get(); }
+    ID3DBlob *GetPixelShader(ShaderKey key) const { return pixelShaders[key.Masked(pixelAxes).GetValue()].Get(); }
+
+    UINT GetShaderVariantCount() const { return shaderVariantCount; }
+    UINT GetPipelineCount() const { return pipelineCount; }
+    double GetBuildTime() const { return buildTime; } // Milliseconds, compilation and PSO creation.
+
+private:
+    Microsoft::WRL::ComPtr<ID3DBlob> vertexShaders[ShaderKey::Count];
+    Microsoft::WRL::ComPtr<ID3DBlob> pixelShaders[ShaderKey::Count];
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineStates[ShaderKey::Count];
+    uint32_t vertexAxes = 0;
+    uint32_t pixelAxes = 0;
+    UINT shaderVariantCount = 0;
+    UINT pipelineCount = 0;
+    double buildTime = 0.0;
+};
@@ -0,0 +1,146 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <thread>
+
+TaskHandle TaskGraph::Add(const char *name, const TaskFunc &func, std::initializer_list<TaskHandle> dependencies, TaskThread thread) {
+    TaskHandle handle = (TaskHandle) tasks.size();
+    for (TaskHandle dependency : dependencies) {
+        if (dependency >= handle) {
+            return InvalidHandle;
+        }
+    }
+
+    Task task;
+    task.name = name;
+    task.func = func;
+    task.thread = thread;
+    task.dependencies = dependencies;
+    task.waitCount = 0;
+    task.timing = { -1.0, -1.0, 0 };
+    tasks.push_back(std::move(task));
+
+    for (TaskHandle dependency : dependencies) {
+        tasks[dependency].dependents.push_back(handle);
+    }
+    return handle;
+}
+
+bool TaskGraph::Run(uint32_t workerCount) {
+    start = std::chrono::steady_clock::now();
+
+    readyTasks.clear();
+    readyMainTasks.clear();
+    unfinishedCount = (uint32_t) tasks.size();
+    runningCount = 0;
+    failed = false;
+    exception = nullptr;
+    for (TaskHandle handle = 0; handle < (TaskHandle) tasks.size(); handle++) {
+        Task &task = tasks[handle];
+        task.waitCount = (uint32_t) task.dependencies.size();
+        task.timing = { -1.0, -1.0, 0 };
+        if (task.waitCount == 0) {
+            Enqueue(handle);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&TaskGraph::RunTasks, this, i + 1);
+    }
+    RunTasks(0);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    totalTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+    return !failed;
+}
+
+std::vector<TaskHandle> TaskGraph::GetCriticalPath() const {
+    std::vector<TaskHandle> path;
+    TaskHandle last = InvalidHandle;
+    for (TaskHandle handle = 0; handle < (TaskHandle) tasks.size(); handle++) {
+        if (tasks[handle].timing.start >= 0.0 && (last == InvalidHandle || tasks[handle].timing.end > tasks[last].timing.end)) {
+            last = handle;
+        }
+    }
+
+    while (last != InvalidHandle) {
+        path.push_back(last);
+        TaskHandle previous = InvalidHandle;
+        for (TaskHandle dependency : tasks[last].dependencies) {
+            if (previous == InvalidHandle || tasks[dependency].timing.end > tasks[previous].timing.end) {
+                previous = dependency;
+            }
+        }
+        last = previous;
+    }
+
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void TaskGraph::RunTasks(uint32_t thread) {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        // Main-thread tasks are only taken by the calling thread, which takes them first.
+        wake.wait(lock, [&] { return unfinishedCount == 0 || !readyTasks.empty() || (thread == 0 && !readyMainTasks.empty()); });
+        if (unfinishedCount == 0) {
+            return;
+        }
+
+        std::deque<TaskHandle> &queue = thread == 0 && !readyMainTasks.empty() ? readyMainTasks : readyTasks;
+        TaskHandle handle = queue.front();
+        queue.pop_front();
+        Task &task = tasks[handle];
+        runningCount++;
+        lock.unlock();
+
+        auto taskStart = std::chrono::steady_clock::now();
+        bool succeeded = false;
+        std::exception_ptr taskException;
+        try {
+            succeeded = task.func();
+        } catch (...) {
+            taskException = std::current_exception();
+        }
+        auto taskEnd = std::chrono::steady_clock::now();
+
+        lock.lock();
+        task.timing.start = std::chrono::duration<double, std::milli>(taskStart - start).count();
+        task.timing.end = std::chrono::duration<double, std::milli>(taskEnd - start).count();
+        task.timing.thread = thread;
+        runningCount--;
+        unfinishedCount--;
+
+        if (!succeeded && !failed) {
+            // Tasks that have not started are dropped; only the running ones are waited for.
+            failed = true;
+            exception = taskException;
+            readyTasks.clear();
+            readyMainTasks.clear();
+            unfinishedCount = runningCount;
+        } else if (!failed) {
+            for (TaskHandle dependent : task.dependents) {
+                if (--tasks[dependent].waitCount == 0) {
+                    Enqueue(dependent);
+                }
+            }
+        }
+        wake.notify_all();
+    }
+}
+
+void TaskGraph::Enqueue(TaskHandle handle) {
+    if (tasks[handle].thread == TaskThread::Main) {
+        readyMainTasks.push_back(handle);
+    } else {
+        readyTasks.push_back(handle);
+    }
+}
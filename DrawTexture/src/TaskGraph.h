@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+
+using TaskHandle = uint32_t;
+
+// Returns false on failure.
+using TaskFunc = std::function<bool()>;
+
+enum class TaskThread : uint32_t {
+    Any,
+    Main,   // The thread that calls Run(), e.g. for work on windows it owns.
+};
+
+struct TaskTiming {
+    double start;   // Milliseconds since Run() started, -1 if the task did not run.
+    double end;
+    uint32_t thread; // 0 is the thread that called Run().
+};
+
+// Runs a set of tasks once, each as soon as the tasks it depends on have finished, on
+// the calling thread and a number of workers. Used for startup, where independent
+// stages overlap instead of adding up. A task that fails or throws cancels the tasks
+// that have not started; Run() returns false, or rethrows the first exception, once the
+// running ones have finished. The timings of the last run give the critical path.
+class TaskGraph {
+public:
+    static constexpr TaskHandle InvalidHandle = UINT32_MAX;
+
+    // Dependencies must have been added before. Ready tasks start in the order they were added.
+    TaskHandle Add(const char *name, const TaskFunc &func, std::initializer_list<TaskHandle> dependencies = { },
+                   TaskThread thread = TaskThread::Any);
+
+    bool Run(uint32_t workerCount);
+
+    uint32_t GetTaskCount() const { return (uint32_t) tasks.size(); }
+    const char *GetName(TaskHandle handle) const { return tasks[handle].name; }
+    const TaskTiming &GetTiming(TaskHandle handle) const { return tasks[handle].timing; }
+    double GetTotalTime() const { return totalTime; }
+
+    // The chain of tasks that determined the total time, first to last: the task that
+    // finished last, preceded by its dependency that finished last, and so on.
+    std::vector<TaskHandle> GetCriticalPath() const;
+
+private:
+    struct Task {
+        const char *name;
+        TaskFunc func;
+        TaskThread thread;
+        std::vector<TaskHandle> dependencies;
+        std::vector<TaskHandle> dependents;
+        uint32_t waitCount;  // Dependencies that have not finished.
+        TaskTiming timing;
+    };
+
+    void RunTasks(uint32_t thread);
+    void Enqueue(TaskHandle handle);
+
+    std::vector<Task> tasks;
+    double totalTime = 0.0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TaskHandle> readyTasks;
+    std::deque<TaskHandle> readyMainTasks;
+    uint32_t unfinishedCount = 0;
+    uint32_t runningCount = 0;
+    bool failed = false;
+    std::exception_ptr exception;
+    std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,518 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+TextureStreamer::~TextureStreamer() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+    if (fenceEvent) {
+        CloseHandle(fenceEvent);
+    }
+}
+
+HRESULT TextureStreamer::Init(ID3D12Device *device, ID3D12CommandQueue *commandQueue, UINT poolTileCount) {
+    this->device = device;
+    this->commandQueue = commandQueue;
+
+    D3D12_HEAP_DESC desc;
+    desc.SizeInBytes                     = UINT64(poolTileCount) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    desc.Properties.Type                 = D3D12_HEAP_TYPE_DEFAULT;
+    desc.Properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    desc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    desc.Properties.CreationNodeMask     = 0;
+    desc.Properties.VisibleNodeMask      = 0;
+    desc.Alignment                       = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    desc.Flags                           = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+
+    HRESULT hr = device->CreateHeap(&desc, IID_PPV_ARGS(&heap));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator));
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList));
+    if (FAILED(hr)) {
+        return hr;
+    }
+    commandList->Close();
+
+    hr = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
+    if (FAILED(hr)) {
+        return hr;
+    }
+    fenceEvent = CreateEvent(nullptr, false, false, nullptr);
+    if (!fenceEvent) {
+        return E_FAIL;
+    }
+
+    pageCache.Reset(poolTileCount);
+    worker = std::thread(&TextureStreamer::WorkerMain, this);
+    return S_OK;
+}
+
+HRESULT TextureStreamer::Add(UINT width, UINT height, DXGI_FORMAT format, UINT shaderComponentMapping,
+                             const MipLoader &loader, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, StreamingHandle &handle) {
+    Texture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.mipCount = GetMipCount(width, height);
+    texture.format = format;
+    texture.shaderComponentMapping = shaderComponentMapping;
+    texture.loader = loader;
+    texture.srvHandle = srvHandle;
+    texture.screenWidth = 0.0f;
+    texture.screenHeight = 0.0f;
+    texture.state = D3D12_RESOURCE_STATE_COPY_DEST;
+
+    D3D12_RESOURCE_DESC desc;
+    desc.Dimension          = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Alignment          = 0;
+    desc.Width              = (UINT64) width;
+    desc.Height             = height;
+    desc.DepthOrArraySize   = 1;
+    desc.MipLevels          = (UINT16) texture.mipCount;
+    desc.Format             = format;
+    desc.SampleDesc.Count   = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Layout             = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+    desc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    HRESULT hr = device->CreateReservedResource(&desc, texture.state, nullptr, IID_PPV_ARGS(&texture.resource));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    UINT tileCount;
+    D3D12_PACKED_MIP_INFO packedMipInfo;
+    D3D12_TILE_SHAPE tileShape;
+    UINT subresourceCount = texture.mipCount;
+    texture.tiling.resize(texture.mipCount);
+    device->GetResourceTiling(texture.resource.Get(), &tileCount, &packedMipInfo, &tileShape, &subresourceCount, 0, texture.tiling.data());
+    texture.standardMipCount = packedMipInfo.NumStandardMips;
+
+    std::vector<uint32_t> mipTileCounts(texture.standardMipCount);
+    for (UINT mip = 0; mip < texture.standardMipCount; mip++) {
+        const D3D12_SUBRESOURCE_TILING &tiling = texture.tiling[mip];
+        mipTileCounts[mip] = tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles;
+    }
+    texture.pageTable = pageCache.AddTexture(mipTileCounts.data(), texture.standardMipCount, packedMipInfo.NumTilesForPackedMips);
+    if (texture.pageTable == TilePageCache::InvalidHandle) {
+        return E_OUTOFMEMORY;
+    }
+
+    handle = (StreamingHandle) textures.size();
+    textures.push_back(std::move(texture));
+    if (pageTableTextures.size() <= textures[handle].pageTable) {
+        pageTableTextures.resize(textures[handle].pageTable + 1);
+    }
+    pageTableTextures[textures[handle].pageTable] = handle;
+
+    // The packed tail is loaded right away, so the texture is never without an image.
+    hr = FlushTileMappings();
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    std::vector<Load> loads(textures[handle].mipCount - textures[handle].standardMipCount);
+    for (UINT i = 0; i < (UINT) loads.size(); i++) {
+        hr = StartLoad(handle, textures[handle].standardMipCount + i, loads[i]);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        if (!loader(loads[i].mip, loads[i].pixels, loads[i].layout.Footprint.RowPitch)) {
+            return E_FAIL;
+        }
+    }
+    hr = SubmitCopies(loads.data(), loads.size());
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = WaitForFence(fenceValue);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    StreamingHandle policyHandle = policy.Add(textures[handle].mipCount, textures[handle].standardMipCount);
+    (void) policyHandle; // Textures are never removed, so both handles count up together.
+
+    textures[handle].viewMip = UINT(-1);
+    WriteView(handle);
+    return S_OK;
+}
+
+void TextureStreamer::SetScreenSize(StreamingHandle handle, float width, float height) {
+    textures[handle].screenWidth = width;
+    textures[handle].screenHeight = height;
+}
+
+HRESULT TextureStreamer::Update(float screenWidth, float screenHeight, FrameArena &scratch) {
+    FrameArenaScope scope(scratch);
+
+    // Copies whose fence passed make their level resident.
+    UINT64 completed = fence->GetCompletedValue();
+    submitted.erase(std::remove_if(submitted.begin(), submitted.end(), [&](const Load &load) {
+        if (load.fenceValue > completed) {
+            return false;
+        }
+        policy.Complete(load.texture, load.mip);
+        return true;
+    }), submitted.end());
+
+    // Visible textures keep their resident and loading levels; the rest can be recycled.
+    pageCache.BeginFrame();
+    float screenArea = (std::max)(screenWidth * screenHeight, 1.0f);
+    for (StreamingHandle handle = 0; handle < (StreamingHandle) textures.size(); handle++) {
+        const Texture &texture = textures[handle];
+        uint32_t desired = GetDesiredMip(texture.width, texture.height, texture.mipCount, texture.screenWidth, texture.screenHeight);
+        float coverage = (std::min)(texture.screenWidth * texture.screenHeight / screenArea, 1.0f);
+        policy.SetDesiredMip(handle, desired, coverage);
+
+        if (coverage > 0.0f) {
+            UINT first = (std::min)(policy.GetResidentMip(handle), policy.GetRequestedMip(handle));
+            for (UINT mip = first; mip < texture.standardMipCount; mip++) {
+                for (uint32_t tile = 0, count = pageCache.GetTileCount(texture.pageTable, mip); tile < count; tile++) {
+                    pageCache.Touch(texture.pageTable, mip, tile);
+                }
+            }
+        }
+    }
+
+    // Copy what the worker has loaded.
+    FrameVector<Load> copies(scratch);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        copies.reserve(loaded.size());
+        for (Load &load : loaded) {
+            copies.push_back(std::move(load));
+        }
+        loaded.clear();
+    }
+    copies.erase(std::remove_if(copies.begin(), copies.end(), [&](const Load &load) {
+        if (load.succeeded) {
+            return false;
+        }
+        policy.Cancel(load.texture, load.mip);
+        return true;
+    }), copies.end());
+
+    HRESULT hr = SubmitCopies(copies.data(), copies.size());
+    if (FAILED(hr)) {
+        return hr;
+    }
+    for (Load &load : copies) {
+        submitted.push_back(std::move(load));
+    }
+
+    // Start new loads for levels whose tiles fit in the pool this frame.
+    requests.clear();
+    policy.Update(MaxInFlightLoads, requests);
+    for (const MipRequest &request : requests) {
+        const Texture &texture = textures[request.texture];
+        uint32_t count = pageCache.GetTileCount(texture.pageTable, request.mip);
+        uint32_t missing = 0;
+        for (uint32_t tile = 0; tile < count; tile++) {
+            missing += pageCache.IsMapped(texture.pageTable, request.mip, tile) ? 0 : 1;
+        }
+        if (missing > pageCache.GetAvailableTileCount()) {
+            policy.Cancel(request.texture, request.mip);
+            continue;
+        }
+        for (uint32_t tile = 0; tile < count; tile++) {
+            pageCache.Map(texture.pageTable, request.mip, tile);
+        }
+
+        Load load;
+        hr = StartLoad(request.texture, request.mip, load);
+        if (FAILED(hr)) {
+            policy.Cancel(request.texture, request.mip);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(std::move(load));
+        }
+        wake.notify_one();
+    }
+
+    return FlushTileMappings();
+}
+
+bool TextureStreamer::HasStaleViews() const {
+    for (StreamingHandle handle = 0; handle < (StreamingHandle) textures.size(); handle++) {
+        if (policy.GetResidentMip(handle) != textures[handle].viewMip) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextureStreamer::WriteViews() {
+    for (StreamingHandle handle = 0; handle < (StreamingHandle) textures.size(); handle++) {
+        if (policy.GetResidentMip(handle) != textures[handle].viewMip) {
+            WriteView(handle);
+        }
+    }
+}
+
+HRESULT TextureStreamer::StartLoad(StreamingHandle handle, UINT mip, Load &load) {
+    const Texture &texture = textures[handle];
+    D3D12_RESOURCE_DESC desc = texture.resource->GetDesc();
+    UINT64 size;
+    device->GetCopyableFootprints(&desc, mip, 1, 0, &load.layout, nullptr, nullptr, &size);
+
+    D3D12_HEAP_PROPERTIES properties;
+    properties.Type                 = D3D12_HEAP_TYPE_UPLOAD;
+    properties.CPUPageProperty      = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    properties.CreationNodeMask     = 0;
+    properties.VisibleNodeMask      = 0;
+
+    D3D12_RESOURCE_DESC bufferDesc;
+    bufferDesc.Dimension          = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferDesc.Alignment          = 0;
+    bufferDesc.Width              = size;
+    bufferDesc.Height             = 1;
+    bufferDesc.DepthOrArraySize   = 1;
+    bufferDesc.MipLevels          = 1;
+    bufferDesc.Format             = DXGI_FORMAT_UNKNOWN;
+    bufferDesc.SampleDesc.Count   = 1;
+    bufferDesc.SampleDesc.Quality = 0;
+    bufferDesc.Layout             = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferDesc.Flags              = D3D12_RESOURCE_FLAG_NONE;
+
+    HRESULT hr = device->CreateCommittedResource(
+        &properties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&load.upload));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    void *buffer;
+    hr = load.upload->Map(0, nullptr, &buffer);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    load.texture = handle;
+    load.mip = mip;
+    load.loader = texture.loader;
+    load.pixels = buffer;
+    load.succeeded = false;
+    load.fenceValue = 0;
+    return S_OK;
+}
+
+HRESULT TextureStreamer::FlushTileMappings() {
+    pageCache.TakeUpdates(updates);
+
+    // Updates come sorted by texture: one UpdateTileMappings call each.
+    for (size_t begin = 0; begin < updates.size();) {
+        size_t end = begin;
+        while (end < updates.size() && updates[end].texture == updates[begin].texture) {
+            end++;
+        }
+
+        StreamingHandle handle = pageTableTextures[updates[begin].texture];
+        const Texture &texture = textures[handle];
+        coordinates.clear();
+        rangeFlags.clear();
+        heapOffsets.clear();
+
+        for (size_t i = begin; i < end; i++) {
+            const TileMappingUpdate &update = updates[i];
+            D3D12_TILED_RESOURCE_COORDINATE coordinate;
+            if (update.mip < texture.standardMipCount) {
+                UINT widthInTiles = texture.tiling[update.mip].WidthInTiles;
+                coordinate.X = update.tile % widthInTiles;
+                coordinate.Y = update.tile / widthInTiles;
+            } else {
+                // The packed tail is addressed by tile index within its first subresource.
+                coordinate.X = update.tile;
+                coordinate.Y = 0;
+            }
+            coordinate.Z = 0;
+            coordinate.Subresource = update.mip;
+            coordinates.push_back(coordinate);
+
+            bool unmap = update.poolTile == TilePageCache::InvalidTile;
+            rangeFlags.push_back(unmap ? D3D12_TILE_RANGE_FLAG_NULL : D3D12_TILE_RANGE_FLAG_NONE);
+            heapOffsets.push_back(unmap ? 0 : update.poolTile);
+
+            // Losing any tile of a level drops it and the finer levels.
+            if (unmap && update.mip < texture.standardMipCount) {
+                policy.Evict(handle, update.mip);
+            }
+        }
+
+        UINT count = (UINT) coordinates.size();
+        regionSizes.assign(count, { 1, false, 0, 0, 0 });
+        rangeTileCounts.assign(count, 1);
+        commandQueue->UpdateTileMappings(
+            texture.resource.Get(),
+            count, coordinates.data(), regionSizes.data(),
+            heap.Get(),
+            count, rangeFlags.data(), heapOffsets.data(), rangeTileCounts.data(),
+            D3D12_TILE_MAPPING_FLAG_NONE);
+
+        begin = end;
+    }
+    return S_OK;
+}
+
+HRESULT TextureStreamer::SubmitCopies(Load *loads, size_t count) {
+    if (count == 0) {
+        return S_OK;
+    }
+
+    // The allocator is reused, so the previous batch has to be done.
+    HRESULT hr = WaitForFence(fenceValue);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = commandAllocator->Reset();
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = commandList->Reset(commandAllocator.Get(), nullptr);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    copyTargets.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (std::find(copyTargets.begin(), copyTargets.end(), loads[i].texture) == copyTargets.end()) {
+            copyTargets.push_back(loads[i].texture);
+        }
+    }
+
+    barriers.clear();
+    for (StreamingHandle handle : copyTargets) {
+        Texture &texture = textures[handle];
+        if (texture.state != D3D12_RESOURCE_STATE_COPY_DEST) {
+            D3D12_RESOURCE_BARRIER barrier = { };
+            barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barrier.Transition.pResource   = texture.resource.Get();
+            barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            barrier.Transition.StateBefore = texture.state;
+            barrier.Transition.StateAfter  = D3D12_RESOURCE_STATE_COPY_DEST;
+            barriers.push_back(barrier);
+        }
+    }
+    if (!barriers.empty()) {
+        commandList->ResourceBarrier((UINT) barriers.size(), barriers.data());
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const Load &load = loads[i];
+        D3D12_TEXTURE_COPY_LOCATION src;
+        src.pResource       = load.upload.Get();
+        src.Type            = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.PlacedFootprint = load.layout;
+
+        D3D12_TEXTURE_COPY_LOCATION dst;
+        dst.pResource        = textures[load.texture].resource.Get();
+        dst.Type             = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst.SubresourceIndex = load.mip;
+
+        commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+
+    barriers.clear();
+    for (StreamingHandle handle : copyTargets) {
+        Texture &texture = textures[handle];
+        D3D12_RESOURCE_BARRIER barrier = { };
+        barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+        barrier.Transition.pResource   = texture.resource.Get();
+        barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+        barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+        barrier.Transition.StateAfter  = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+        barriers.push_back(barrier);
+        texture.state = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    }
+    commandList->ResourceBarrier((UINT) barriers.size(), barriers.data());
+
+    hr = commandList->Close();
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    ID3D12CommandList *commandLists[] = { commandList.Get() };
+    commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+    hr = commandQueue->Signal(fence.Get(), ++fenceValue);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        loads[i].upload->Unmap(0, nullptr);
+        loads[i].fenceValue = fenceValue;
+    }
+    return S_OK;
+}
+
+HRESULT TextureStreamer::WaitForFence(UINT64 value) {
+    if (fence->GetCompletedValue() >= value) {
+        return S_OK;
+    }
+    HRESULT hr = fence->SetEventOnCompletion(value, fenceEvent);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    WaitForSingleObject(fenceEvent, INFINITE);
+    return S_OK;
+}
+
+void TextureStreamer::WriteView(StreamingHandle handle) {
+    Texture &texture = textures[handle];
+    UINT residentMip = policy.GetResidentMip(handle);
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC desc;
+    desc.Format                  = texture.format;
+    desc.ViewDimension           = D3D12_SRV_DIMENSION_TEXTURE2D;
+    desc.Shader4ComponentMapping = texture.shaderComponentMapping;
+    desc.Texture2D               = { };
+
+    if (residentMip < texture.mipCount) {
+        desc.Texture2D.MostDetailedMip = residentMip;
+        desc.Texture2D.MipLevels       = texture.mipCount - residentMip;
+        device->CreateShaderResourceView(texture.resource.Get(), &desc, texture.srvHandle);
+    } else {
+        // Nothing resident (no packed tail and the coarsest level evicted): a null view reads 0.
+        desc.Texture2D.MipLevels = 1;
+        device->CreateShaderResourceView(nullptr, &desc, texture.srvHandle);
+    }
+    texture.viewMip = residentMip;
+}
+
+void TextureStreamer::WorkerMain() {
+    for (;;) {
+        Load load;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !queued.empty(); });
+            if (stopping) {
+                return;
+            }
+            load = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        load.succeeded = load.loader(load.mip, load.pixels, load.layout.Footprint.RowPitch);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded.push_back(std::move(load));
+    }
+}
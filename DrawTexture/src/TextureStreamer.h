@@ -0,0 +1,128 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameArena.h"
+#include "MipStreaming.h"
+#include "TilePageCache.h"
+
+// Writes one mip level. rowPitch is the row pitch of the upload footprint; the loader
+// writes GetCopyableFootprints' row count. Called on the streaming thread.
+using MipLoader = std::function<bool(uint32_t mip, void *pixels, size_t rowPitch)>;
+
+// Streams the mip levels of reserved textures that share one heap of 64 KB tiles.
+// A texture starts with its packed mip tail loaded; finer levels are requested by
+// MipStreamingPolicy from the screen size set with SetScreenSize(), mapped through
+// TilePageCache, loaded by the loader on a background thread and copied on the given
+// queue. The SRV of a texture always covers the resident levels only, so sampling
+// never reaches unmapped tiles.
+class TextureStreamer {
+public:
+    static constexpr UINT MaxInFlightLoads = 4;
+
+    ~TextureStreamer();
+
+    HRESULT Init(ID3D12Device *device, ID3D12CommandQueue *commandQueue, UINT poolTileCount);
+
+    // Creates a reserved texture with a full mip chain and loads its packed mips before
+    // returning. srvHandle receives the texture's SRV whenever its resident levels change.
+    HRESULT Add(UINT width, UINT height, DXGI_FORMAT format, UINT shaderComponentMapping,
+                const MipLoader &loader, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle, StreamingHandle &handle);
+
+    // Size of the texture on screen in pixels, 0 x 0 when it is not drawn.
+    void SetScreenSize(StreamingHandle handle, float width, float height);
+
+    // Call once per frame. Finished loads are copied and submitted, new requests are
+    // started and tile mappings are updated with one UpdateTileMappings per texture; all
+    // of it on the queue, after the frames already submitted. scratch holds temporary
+    // data of the call.
+    HRESULT Update(float screenWidth, float screenHeight, FrameArena &scratch);
+
+    // True when the resident levels of a texture changed and its SRV must be rewritten.
+    bool HasStaleViews() const;
+    // Rewrites those SRVs. The GPU must not be using them, so wait for the frames in
+    // flight first.
+    void WriteViews();
+
+    ID3D12Heap *GetHeap() const { return heap.Get(); }
+    ID3D12Resource *GetResource(StreamingHandle handle) const { return textures[handle].resource.Get(); }
+    const MipStreamingPolicy &GetPolicy() const { return policy; }
+    const TilePageCache &GetPageCache() const { return pageCache; }
+
+private:
+    struct Texture {
+        Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+        D3D12_RESOURCE_STATES state;
+        MipLoader loader;
+        D3D12_CPU_DESCRIPTOR_HANDLE srvHandle;
+        UINT width;
+        UINT height;
+        UINT mipCount;
+        DXGI_FORMAT format;
+        UINT shaderComponentMapping;
+        UINT standardMipCount;
+        std::vector<D3D12_SUBRESOURCE_TILING> tiling;
+        uint32_t pageTable;
+        float screenWidth;
+        float screenHeight;
+        UINT viewMip; // Most detailed mip of the current SRV, mipCount for a null view.
+    };
+
+    struct Load {
+        StreamingHandle texture;
+        UINT mip;
+        MipLoader loader; // Copied, the worker must not touch textures.
+        Microsoft::WRL::ComPtr<ID3D12Resource> upload;
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+        void *pixels;
+        bool succeeded;
+        UINT64 fenceValue;
+    };
+
+    HRESULT StartLoad(StreamingHandle handle, UINT mip, Load &load);
+    HRESULT FlushTileMappings();
+    HRESULT SubmitCopies(Load *loads, size_t count);
+    HRESULT WaitForFence(UINT64 value);
+    void WriteView(StreamingHandle handle);
+    void WorkerMain();
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> commandQueue;
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+    Microsoft::WRL::ComPtr<ID3D12Fence> fence;
+    UINT64 fenceValue = 0;
+    HANDLE fenceEvent = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+
+    std::vector<Texture> textures;
+    std::vector<StreamingHandle> pageTableTextures; // Texture of each TilePageCache handle.
+    MipStreamingPolicy policy;
+    TilePageCache pageCache;
+    std::vector<MipRequest> requests;
+    std::vector<TileMappingUpdate> updates;
+    std::vector<D3D12_TILED_RESOURCE_COORDINATE> coordinates;
+    std::vector<D3D12_TILE_REGION_SIZE> regionSizes;
+    std::vector<D3D12_TILE_RANGE_FLAGS> rangeFlags;
+    std::vector<UINT> heapOffsets;
+    std::vector<UINT> rangeTileCounts;
+    std::vector<Load> submitted; // Copies waiting for their fence.
+    std::vector<StreamingHandle> copyTargets;
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+
+    // Loads are handed to the worker thread and come back once the loader has run.
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Load> queued;
+    std::vector<Load> loaded;
+    bool stopping = false;
+};
@@ -0,0 +1,225 @@
+#include "TilePageCache.h"
+
+#include <algorithm>
+
+TilePageCache::TilePageCache(uint32_t poolTileCount) {
+    Reset(poolTileCount);
+}
+
+void TilePageCache::Reset(uint32_t poolTileCount) {
+    textures.clear();
+    freeHandles.clear();
+    pending.clear();
+    poolTiles.assign(poolTileCount, PoolTile());
+    freeTiles.resize(poolTileCount);
+    for (uint32_t i = 0; i < poolTileCount; i++) {
+        // Popped from the back, so tiles are handed out in ascending order.
+        freeTiles[i] = poolTileCount - 1 - i;
+    }
+    head = InvalidTile;
+    tail = InvalidTile;
+    pinnedTiles = 0;
+    touchedTiles = 0;
+    frame = 1;
+    evictions = 0;
+}
+
+uint32_t TilePageCache::AddTexture(const uint32_t *mipTileCounts, uint32_t mipCount, uint32_t packedTileCount) {
+    if (packedTileCount > GetAvailableTileCount()) {
+        return InvalidHandle;
+    }
+
+    uint32_t handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = (uint32_t) textures.size();
+        textures.emplace_back();
+    }
+
+    Texture &texture = textures[handle];
+    texture.mipOffsets.resize(mipCount + 1);
+    uint32_t offset = 0;
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+        texture.mipOffsets[mip] = offset;
+        offset += mipTileCounts[mip];
+    }
+    texture.mipOffsets[mipCount] = offset;
+    texture.pageTable.assign(offset, uint32_t(InvalidTile));
+    texture.packedTiles.clear();
+    texture.live = true;
+
+    // The packed tail cannot be mapped partially, so it is resident for the texture's lifetime.
+    for (uint32_t i = 0; i < packedTileCount; i++) {
+        uint32_t poolTile = AllocateTile();
+        PoolTile &entry = poolTiles[poolTile];
+        entry.texture = handle;
+        entry.mip = mipCount;
+        entry.tile = i;
+        entry.pinned = true;
+        pinnedTiles++;
+        texture.packedTiles.push_back(poolTile);
+        pending.push_back({ handle, mipCount, i, poolTile });
+    }
+    return handle;
+}
+
+void TilePageCache::RemoveTexture(uint32_t handle) {
+    Texture &texture = textures[handle];
+    for (uint32_t poolTile : texture.pageTable) {
+        if (poolTile != InvalidTile) {
+            Unlink(poolTile);
+            if (poolTiles[poolTile].lastUsedFrame == frame) {
+                touchedTiles--;
+            }
+            freeTiles.push_back(poolTile);
+        }
+    }
+    for (uint32_t poolTile : texture.packedTiles) {
+        poolTiles[poolTile].pinned = false;
+        pinnedTiles--;
+        freeTiles.push_back(poolTile);
+    }
+
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [&](const TileMappingUpdate &update) {
+        return update.texture == handle;
+    }), pending.end());
+
+    texture.pageTable.clear();
+    texture.packedTiles.clear();
+    texture.live = false;
+    freeHandles.push_back(handle);
+}
+
+bool TilePageCache::Touch(uint32_t handle, uint32_t mip, uint32_t tile) {
+    const Texture &texture = textures[handle];
+    uint32_t poolTile = texture.pageTable[texture.mipOffsets[mip] + tile];
+    if (poolTile == InvalidTile) {
+        return false;
+    }
+    MarkUsed(poolTile);
+    return true;
+}
+
+bool TilePageCache::Map(uint32_t handle, uint32_t mip, uint32_t tile) {
+    uint32_t &entry = textures[handle].pageTable[textures[handle].mipOffsets[mip] + tile];
+    if (entry != InvalidTile) {
+        MarkUsed(entry);
+        return true;
+    }
+
+    uint32_t poolTile = AllocateTile();
+    if (poolTile == InvalidTile) {
+        return false;
+    }
+
+    PoolTile &target = poolTiles[poolTile];
+    target.texture = handle;
+    target.mip = mip;
+    target.tile = tile;
+    target.pinned = false;
+    target.lastUsedFrame = 0;
+    PushBack(poolTile);
+    MarkUsed(poolTile);
+
+    entry = poolTile;
+    pending.push_back({ handle, mip, tile, poolTile });
+    return true;
+}
+
+bool TilePageCache::IsMapped(uint32_t handle, uint32_t mip, uint32_t tile) const {
+    const Texture &texture = textures[handle];
+    return texture.pageTable[texture.mipOffsets[mip] + tile] != InvalidTile;
+}
+
+uint32_t TilePageCache::GetTileCount(uint32_t handle, uint32_t mip) const {
+    const Texture &texture = textures[handle];
+    return texture.mipOffsets[mip + 1] - texture.mipOffsets[mip];
+}
+
+void TilePageCache::TakeUpdates(std::vector<TileMappingUpdate> &updates) {
+    // Stable, so the last change of a tile stays last among its equals.
+    std::stable_sort(pending.begin(), pending.end(), [](const TileMappingUpdate &a, const TileMappingUpdate &b) {
+        if (a.texture != b.texture) {
+            return a.texture < b.texture;
+        }
+        if (a.mip != b.mip) {
+            return a.mip < b.mip;
+        }
+        return a.tile < b.tile;
+    });
+
+    updates.clear();
+    for (size_t i = 0; i < pending.size(); i++) {
+        const TileMappingUpdate &update = pending[i];
+        if (i + 1 < pending.size() && pending[i + 1].texture == update.texture &&
+            pending[i + 1].mip == update.mip && pending[i + 1].tile == update.tile) {
+            continue;
+        }
+        updates.push_back(update);
+    }
+    pending.clear();
+}
+
+void TilePageCache::Unlink(uint32_t poolTile) {
+    PoolTile &entry = poolTiles[poolTile];
+    if (entry.prev != InvalidTile) {
+        poolTiles[entry.prev].next = entry.next;
+    } else {
+        head = entry.next;
+    }
+    if (entry.next != InvalidTile) {
+        poolTiles[entry.next].prev = entry.prev;
+    } else {
+        tail = entry.prev;
+    }
+    entry.prev = entry.next = InvalidTile;
+}
+
+void TilePageCache::PushBack(uint32_t poolTile) {
+    PoolTile &entry = poolTiles[poolTile];
+    entry.prev = tail;
+    entry.next = InvalidTile;
+    if (tail != InvalidTile) {
+        poolTiles[tail].next = poolTile;
+    } else {
+        head = poolTile;
+    }
+    tail = poolTile;
+}
+
+void TilePageCache::MarkUsed(uint32_t poolTile) {
+    PoolTile &entry = poolTiles[poolTile];
+    if (entry.pinned || entry.lastUsedFrame == frame) {
+        return;
+    }
+    entry.lastUsedFrame = frame;
+    touchedTiles++;
+    if (tail != poolTile) {
+        Unlink(poolTile);
+        PushBack(poolTile);
+    }
+}
+
+uint32_t TilePageCache::AllocateTile() {
+    if (!freeTiles.empty()) {
+        uint32_t poolTile = freeTiles.back();
+        freeTiles.pop_back();
+        return poolTile;
+    }
+
+    // Touched tiles are moved to the back, so a head used this frame means all tiles are.
+    if (head == InvalidTile || poolTiles[head].lastUsedFrame == frame) {
+        return InvalidTile;
+    }
+
+    uint32_t poolTile = head;
+    PoolTile &victim = poolTiles[poolTile];
+    Texture &owner = textures[victim.texture];
+    owner.pageTable[owner.mipOffsets[victim.mip] + victim.tile] = InvalidTile;
+    pending.push_back({ victim.texture, victim.mip, victim.tile, InvalidTile });
+    Unlink(poolTile);
+    evictions++;
+    return poolTile;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Change to the tile mapping of a reserved texture. tile is the linear tile index within
+// the mip (row-major in tiles); for the packed mip tail, mip is the first packed level
+// and tile counts through the tail's tiles.
+struct TileMappingUpdate {
+    uint32_t texture;
+    uint32_t mip;
+    uint32_t tile;
+    uint32_t poolTile; // TilePageCache::InvalidTile unmaps the tile.
+};
+
+// CPU-side page table for reserved textures that share one pool of physical tiles.
+// Each texture has one page table entry per tile of every standard mip; the packed mip
+// tail is mapped when the texture is added and stays pinned. Tiles are recycled in least
+// recently used order, but never ones touched in the current frame. Mapping changes are
+// queued and handed out in batches, sorted so that each texture can be updated with one
+// UpdateTileMappings call.
+class TilePageCache {
+public:
+    static constexpr uint32_t InvalidTile = UINT32_MAX;
+    static constexpr uint32_t InvalidHandle = UINT32_MAX;
+
+    explicit TilePageCache(uint32_t poolTileCount = 0);
+
+    void Reset(uint32_t poolTileCount);
+
+    // mipTileCounts holds the tile count of each standard mip. Returns InvalidHandle when
+    // the pool cannot hold the packed tail.
+    uint32_t AddTexture(const uint32_t *mipTileCounts, uint32_t mipCount, uint32_t packedTileCount);
+    // Frees the texture's tiles without queuing unmaps; the resource is about to be released.
+    void RemoveTexture(uint32_t texture);
+
+    void BeginFrame() { frame++; touchedTiles = 0; }
+
+    // Marks a mapped tile as used by this frame. Returns false when it is not mapped.
+    bool Touch(uint32_t texture, uint32_t mip, uint32_t tile);
+    // Maps a tile, taking a free pool tile or the least recently used one. Returns false
+    // when every pool tile is pinned or used by this frame.
+    bool Map(uint32_t texture, uint32_t mip, uint32_t tile);
+    bool IsMapped(uint32_t texture, uint32_t mip, uint32_t tile) const;
+
+    uint32_t GetTileCount(uint32_t texture, uint32_t mip) const;
+    // Tiles Map() can still hand out this frame.
+    uint32_t GetAvailableTileCount() const { return (uint32_t) poolTiles.size() - pinnedTiles - touchedTiles; }
+    uint32_t GetPoolTileCount() const { return (uint32_t) poolTiles.size(); }
+    uint32_t GetFreeTileCount() const { return (uint32_t) freeTiles.size(); }
+    uint64_t GetEvictionCount() const { return evictions; }
+
+    // Moves the queued updates into updates, sorted by texture, mip and tile. When a tile
+    // changed more than once only the last change is kept.
+    void TakeUpdates(std::vector<TileMappingUpdate> &updates);
+
+private:
+    struct Texture {
+        std::vector<uint32_t> mipOffsets; // Start of each mip in pageTable, plus the end.
+        std::vector<uint32_t> pageTable;  // Pool tile of every standard tile or InvalidTile.
+        std::vector<uint32_t> packedTiles;
+        bool live;
+    };
+
+    struct PoolTile {
+        uint32_t texture;
+        uint32_t mip;
+        uint32_t tile;
+        uint64_t lastUsedFrame;
+        uint32_t prev;   // LRU list, head is the least recently used.
+        uint32_t next;
+        bool pinned;
+    };
+
+    void Unlink(uint32_t poolTile);
+    void PushBack(uint32_t poolTile);
+    void MarkUsed(uint32_t poolTile);
+    uint32_t AllocateTile();
+
+    std::vector<Texture> textures;
+    std::vector<uint32_t> freeHandles;
+    std::vector<PoolTile> poolTiles;
+    std::vector<uint32_t> freeTiles;
+    std::vector<TileMappingUpdate> pending;
+    uint32_t head = InvalidTile;
+    uint32_t tail = InvalidTile;
+    uint32_t pinnedTiles = 0;
+    uint32_t touchedTiles = 0;
+    uint64_t frame = 1;
+    uint64_t evictions = 0;
+};
@@ -0,0 +1,12 @@
+struct UpscaleInput {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+cbuffer UpscaleConstants : register(b0) {
+    float2 g_uvScale; // Render size / target size.
+    float2 g_uvMax;   // Render size minus half a texel / target size.
+};
+
+Texture2D<float4> g_scene : register(t0);
+SamplerState g_sampler : register(s0);
@@ -0,0 +1,9 @@
+// Shader Model 5.0
+#include "Upscale.hlsli"
+
+float4 Main(UpscaleInput input) : SV_TARGET {
+    // The scene covers the top-left part of the target; the clamp keeps the bilinear
+    // footprint from reading texels outside it.
+    float2 uv = min(input.uv * g_uvScale, g_uvMax);
+    return g_scene.Sample(g_sampler, uv);
+}
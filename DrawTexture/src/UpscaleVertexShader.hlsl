@@ -0,0 +1,12 @@
+// Shader Model 5.0
+#include "Upscale.hlsli"
+
+// One triangle that covers the screen, without vertex buffers.
+UpscaleInput Main(uint vertexId : SV_VertexID) {
+    UpscaleInput result;
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    result.position = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    result.uv = uv;
+
+    return result;
+}
@@ -1,10 +1,12 @@
-// Shader Model 5.0
+// Shader Model 5.1
 #include "Header.hlsli"
 
 PSInput Main(float4 position : POSITION, float2 uv : TEXCOORD) {
     PSInput result;
-    result.position = position;
+    ObjectConstants object = g_objects[g_objectId];
+    result.position = mul(position, object.world);
     result.uv = uv;
+    result.textureIndex = object.textureIndex;
 
     return result;
 }
@@ -0,0 +1,347 @@
+#include "BatchMath.h"
+#include "Test.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BATCH_MATH_TESTS_SSE
+#endif
+
+namespace {
+
+constexpr size_t ObjectCount = 1003; // Not a multiple of 8 or 16, so the scalar tails run too.
+
+float Uniform(TestRandom &random, float low, float high) {
+    return low + (high - low) * random.Unit();
+}
+
+void FillTransforms(TestRandom &random, TransformSoA &transforms) {
+    transforms.Resize(ObjectCount);
+    for (size_t i = 0; i < ObjectCount; i++) {
+        transforms.position.x[i] = Uniform(random, -100.0f, 100.0f);
+        transforms.position.y[i] = Uniform(random, -100.0f, 100.0f);
+        transforms.position.z[i] = Uniform(random, -100.0f, 100.0f);
+        // Not normalized on purpose: the kernels must not depend on it.
+        transforms.rotation.x[i] = Uniform(random, -1.0f, 1.0f);
+        transforms.rotation.y[i] = Uniform(random, -1.0f, 1.0f);
+        transforms.rotation.z[i] = Uniform(random, -1.0f, 1.0f);
+        transforms.rotation.w[i] = Uniform(random, -1.0f, 1.0f);
+        transforms.scale.x[i] = Uniform(random, 0.1f, 4.0f);
+        transforms.scale.y[i] = Uniform(random, 0.1f, 4.0f);
+        transforms.scale.z[i] = Uniform(random, 0.1f, 4.0f);
+    }
+}
+
+void FillPoints(TestRandom &random, Float3SoA &points, float range) {
+    points.Resize(ObjectCount);
+    for (size_t i = 0; i < ObjectCount; i++) {
+        points.x[i] = Uniform(random, -range, range);
+        points.y[i] = Uniform(random, -range, range);
+        points.z[i] = Uniform(random, -range, range);
+    }
+}
+
+void FillMatrices(TestRandom &random, std::vector<Matrix4x4> &matrices) {
+    matrices.resize(ObjectCount);
+    for (Matrix4x4 &matrix : matrices) {
+        for (auto &row : matrix.m) {
+            for (float &value : row) {
+                value = Uniform(random, -2.0f, 2.0f);
+            }
+        }
+    }
+}
+
+TransformStreams GetStreams(const TransformSoA &t) {
+    return { t.position.x.data(), t.position.y.data(), t.position.z.data(),
+             t.rotation.x.data(), t.rotation.y.data(), t.rotation.z.data(), t.rotation.w.data(),
+             t.scale.x.data(), t.scale.y.data(), t.scale.z.data() };
+}
+
+bool SameBits(const void *a, const void *b, size_t size) {
+    return memcmp(a, b, size) == 0;
+}
+
+bool SameBits(const Float3SoA &a, const Float3SoA &b) {
+    size_t size = a.GetCount() * sizeof(float);
+    return a.GetCount() == b.GetCount() && SameBits(a.x.data(), b.x.data(), size) &&
+           SameBits(a.y.data(), b.y.data(), size) && SameBits(a.z.data(), b.z.data(), size);
+}
+
+#ifdef BATCH_MATH_TESTS_SSE
+
+// A transcription of DirectXMath's SSE paths without FMA (_XM_SSE_INTRINSICS_): the same
+// operations in the same order, which the batch kernels must match bit for bit. The
+// portable build does not depend on DirectXMath, so the test checks against this
+// transcription rather than the library.
+
+__m128 Splat(__m128 v, int lane) {
+    switch (lane) {
+    case 0: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    case 1: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+    case 2: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+    default: return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+
+struct SseMatrix {
+    __m128 r[4];
+};
+
+SseMatrix Load(const Matrix4x4 &matrix) {
+    SseMatrix result;
+    for (int i = 0; i < 4; i++) {
+        result.r[i] = _mm_loadu_ps(matrix.m[i]);
+    }
+    return result;
+}
+
+Matrix4x4 Store(const SseMatrix &matrix) {
+    Matrix4x4 result;
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_ps(result.m[i], matrix.r[i]);
+    }
+    return result;
+}
+
+// XMMatrixMultiply
+SseMatrix Multiply(const SseMatrix &a, const SseMatrix &b) {
+    SseMatrix result;
+    for (int i = 0; i < 4; i++) {
+        __m128 x = _mm_mul_ps(Splat(a.r[i], 0), b.r[0]);
+        __m128 y = _mm_mul_ps(Splat(a.r[i], 1), b.r[1]);
+        __m128 z = _mm_mul_ps(Splat(a.r[i], 2), b.r[2]);
+        __m128 w = _mm_mul_ps(Splat(a.r[i], 3), b.r[3]);
+        x = _mm_add_ps(x, z);
+        y = _mm_add_ps(y, w);
+        result.r[i] = _mm_add_ps(x, y);
+    }
+    return result;
+}
+
+// XMMatrixRotationQuaternion
+SseMatrix RotationQuaternion(__m128 q) {
+    const __m128 one110 = _mm_setr_ps(1.0f, 1.0f, 1.0f, 0.0f);
+    const __m128 mask3 = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+
+    __m128 q0 = _mm_add_ps(q, q);
+    __m128 q1 = _mm_mul_ps(q, q0);
+
+    __m128 v0 = _mm_and_ps(_mm_shuffle_ps(q1, q1, _MM_SHUFFLE(3, 0, 0, 1)), mask3);
+    __m128 v1 = _mm_and_ps(_mm_shuffle_ps(q1, q1, _MM_SHUFFLE(3, 1, 2, 2)), mask3);
+    __m128 r0 = _mm_sub_ps(_mm_sub_ps(one110, v0), v1);
+
+    v0 = _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 1, 0, 0));
+    v1 = _mm_shuffle_ps(q0, q0, _MM_SHUFFLE(3, 2, 1, 2));
+    v0 = _mm_mul_ps(v0, v1);
+    v1 = _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 v2 = _mm_shuffle_ps(q0, q0, _MM_SHUFFLE(3, 0, 2, 1));
+    v1 = _mm_mul_ps(v1, v2);
+
+    __m128 r1 = _mm_add_ps(v0, v1);
+    __m128 r2 = _mm_sub_ps(v0, v1);
+
+    v0 = _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1));
+    v0 = _mm_shuffle_ps(v0, v0, _MM_SHUFFLE(1, 3, 2, 0));
+    v1 = _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(2, 2, 0, 0));
+    v1 = _mm_shuffle_ps(v1, v1, _MM_SHUFFLE(2, 0, 2, 0));
+
+    SseMatrix result;
+    q1 = _mm_shuffle_ps(r0, v0, _MM_SHUFFLE(1, 0, 3, 0));
+    result.r[0] = _mm_shuffle_ps(q1, q1, _MM_SHUFFLE(1, 3, 2, 0));
+    q1 = _mm_shuffle_ps(r0, v0, _MM_SHUFFLE(3, 2, 3, 1));
+    result.r[1] = _mm_shuffle_ps(q1, q1, _MM_SHUFFLE(1, 3, 0, 2));
+    q1 = _mm_shuffle_ps(v1, r0, _MM_SHUFFLE(3, 2, 1, 0));
+    result.r[2] = q1;
+    result.r[3] = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    return result;
+}
+
+SseMatrix Scaling(float x, float y, float z) {
+    return { { _mm_setr_ps(x, 0.0f, 0.0f, 0.0f), _mm_setr_ps(0.0f, y, 0.0f, 0.0f),
+               _mm_setr_ps(0.0f, 0.0f, z, 0.0f), _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f) } };
+}
+
+SseMatrix Translation(float x, float y, float z) {
+    return { { _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f), _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f),
+               _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f), _mm_setr_ps(x, y, z, 1.0f) } };
+}
+
+// XMVector3Transform; returns x, y, z.
+void Transform(const SseMatrix &m, float x, float y, float z, float *result) {
+    __m128 v = _mm_mul_ps(_mm_set1_ps(z), m.r[2]);
+    v = _mm_add_ps(v, m.r[3]);
+    v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(y), m.r[1]), v);
+    v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(x), m.r[0]), v);
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+    memcpy(result, lanes, 3 * sizeof(float));
+}
+
+#endif
+
+} // namespace
+
+#ifdef BATCH_MATH_TESTS_SSE
+
+TEST(BatchMathMatchesSseTranscription) {
+    TestRandom random(29);
+    TransformSoA transforms;
+    FillTransforms(random, transforms);
+    Float3SoA points;
+    FillPoints(random, points, 50.0f);
+    std::vector<Matrix4x4> a, b;
+    FillMatrices(random, a);
+    FillMatrices(random, b);
+
+    SimdLevel supported = GetSupportedSimdLevel();
+    SetSimdLevel(SimdLevel::Scalar);
+
+    std::vector<Matrix4x4> worlds(ObjectCount);
+    BuildWorldMatrices(transforms, worlds.data());
+    size_t worldMismatches = 0;
+    for (size_t i = 0; i < ObjectCount; i++) {
+        __m128 q = _mm_setr_ps(transforms.rotation.x[i], transforms.rotation.y[i], transforms.rotation.z[i], transforms.rotation.w[i]);
+        SseMatrix world = Multiply(Scaling(transforms.scale.x[i], transforms.scale.y[i], transforms.scale.z[i]), RotationQuaternion(q));
+        world = Multiply(world, Translation(transforms.position.x[i], transforms.position.y[i], transforms.position.z[i]));
+        Matrix4x4 expected = Store(world);
+        worldMismatches += !SameBits(&expected, &worlds[i], sizeof(Matrix4x4));
+    }
+    CHECK_EQ(worldMismatches, size_t(0));
+
+    Float3SoA transformed;
+    TransformPoints(worlds[7], points, transformed);
+    SseMatrix matrix = Load(worlds[7]);
+    size_t pointMismatches = 0;
+    for (size_t i = 0; i < ObjectCount; i++) {
+        float expected[3];
+        Transform(matrix, points.x[i], points.y[i], points.z[i], expected);
+        float actual[3] = { transformed.x[i], transformed.y[i], transformed.z[i] };
+        pointMismatches += !SameBits(expected, actual, sizeof(actual));
+    }
+    CHECK_EQ(pointMismatches, size_t(0));
+
+    std::vector<Matrix4x4> products(ObjectCount);
+    MultiplyMatrices(a.data(), b.data(), products.data(), ObjectCount);
+    size_t productMismatches = 0;
+    for (size_t i = 0; i < ObjectCount; i++) {
+        Matrix4x4 expected = Store(Multiply(Load(a[i]), Load(b[i])));
+        productMismatches += !SameBits(&expected, &products[i], sizeof(Matrix4x4));
+    }
+    CHECK_EQ(productMismatches, size_t(0));
+
+    SetSimdLevel(supported);
+}
+
+#endif
+
+TEST(BatchMathSimdLevelsMatchScalar) {
+    TestRandom random(30);
+    TransformSoA transforms;
+    FillTransforms(random, transforms);
+    Float3SoA points;
+    FillPoints(random, points, 50.0f);
+    std::vector<Matrix4x4> a, b;
+    FillMatrices(random, a);
+    FillMatrices(random, b);
+
+    // Objects spread well beyond the frustum, so both the sphere and the box test decide.
+    BoundsSoA local;
+    local.Resize(ObjectCount);
+    FillPoints(random, local.center, 1.0f);
+    for (size_t i = 0; i < ObjectCount; i++) {
+        local.extents.x[i] = Uniform(random, 0.1f, 2.0f);
+        local.extents.y[i] = Uniform(random, 0.1f, 2.0f);
+        local.extents.z[i] = Uniform(random, 0.1f, 2.0f);
+    }
+    Frustum frustum = { {
+        { 1.0f, 0.0f, 0.0f, 70.0f }, { -1.0f, 0.0f, 0.0f, 70.0f },
+        { 0.0f, 1.0f, 0.0f, 70.0f }, { 0.0f, -1.0f, 0.0f, 70.0f },
+        { 0.0f, 0.0f, 1.0f, 90.0f }, { 0.6f, 0.0f, -0.8f, 40.0f },
+    } };
+    IndirectDrawRecord draw = { 0, 36, 1, 6, -3, 0 };
+
+    const BatchKernels *levels[] = { &ScalarBatchKernels, &Avx2BatchKernels, &Avx512BatchKernels };
+    SimdLevel supported = GetSupportedSimdLevel();
+
+    struct Results {
+        std::vector<Matrix4x4> worlds, products;
+        Float3SoA points;
+        BoundsSoA bounds;
+        std::vector<float> radius;
+        std::vector<uint32_t> visible;
+        std::vector<IndirectDrawRecord> records;
+    };
+    Results reference;
+
+    for (int level = 0; level <= int(supported); level++) {
+        const BatchKernels &kernels = *levels[level];
+        Results results;
+
+        results.worlds.resize(ObjectCount);
+        kernels.buildWorldMatrices(GetStreams(transforms), results.worlds.data(), 0, ObjectCount);
+
+        results.points.Resize(ObjectCount);
+        kernels.transformPoints(results.worlds[3], { points.x.data(), points.y.data(), points.z.data() },
+            { results.points.x.data(), results.points.y.data(), results.points.z.data() }, 0, ObjectCount);
+
+        results.bounds.Resize(ObjectCount);
+        kernels.transformBounds(results.worlds.data(),
+            { local.center.x.data(), local.center.y.data(), local.center.z.data(),
+              local.extents.x.data(), local.extents.y.data(), local.extents.z.data() },
+            { results.bounds.center.x.data(), results.bounds.center.y.data(), results.bounds.center.z.data(),
+              results.bounds.extents.x.data(), results.bounds.extents.y.data(), results.bounds.extents.z.data() },
+            0, ObjectCount);
+
+        results.products.resize(ObjectCount);
+        kernels.multiplyMatrices(a.data(), b.data(), results.products.data(), 0, ObjectCount);
+
+        // Spheres around the world boxes; the compaction writes one element past the count.
+        const BoundsSoA &world = results.bounds;
+        results.radius.resize(ObjectCount);
+        for (size_t i = 0; i < ObjectCount; i++) {
+            float ex = world.extents.x[i], ey = world.extents.y[i], ez = world.extents.z[i];
+            results.radius[i] = ex + ey + ez;
+        }
+        results.visible.resize(ObjectCount + 1);
+        CullStreams objects = {
+            world.center.x.data(), world.center.y.data(), world.center.z.data(), results.radius.data(),
+            world.center.x.data(), world.center.y.data(), world.center.z.data(),
+            world.extents.x.data(), world.extents.y.data(), world.extents.z.data(),
+        };
+        size_t visibleCount = kernels.cullObjects(frustum, objects, results.visible.data(), 0, ObjectCount);
+        results.visible.resize(visibleCount);
+
+        results.records.resize(visibleCount);
+        kernels.writeIndirectDraws(draw, results.visible.data(), results.records.data(), visibleCount);
+
+        if (level == 0) {
+            // The scene must exercise both outcomes.
+            CHECK(visibleCount > ObjectCount / 10);
+            CHECK(visibleCount < ObjectCount * 9 / 10);
+            CHECK_EQ(results.records[visibleCount - 1].objectId, results.visible.back());
+            CHECK_EQ(results.records[0].baseVertexLocation, -3);
+            reference = results;
+            continue;
+        }
+
+        CHECK(SameBits(results.worlds.data(), reference.worlds.data(), ObjectCount * sizeof(Matrix4x4)));
+        CHECK(SameBits(results.points, reference.points));
+        CHECK(SameBits(results.bounds.center, reference.bounds.center));
+        CHECK(SameBits(results.bounds.extents, reference.bounds.extents));
+        CHECK(SameBits(results.products.data(), reference.products.data(), ObjectCount * sizeof(Matrix4x4)));
+        CHECK(results.visible == reference.visible);
+        REQUIRE(results.records.size() == reference.records.size());
+        CHECK(SameBits(results.records.data(), reference.records.data(), visibleCount * sizeof(IndirectDrawRecord)));
+    }
+
+    // The batch entry points dispatch on the level that is set.
+    SetSimdLevel(SimdLevel::Scalar);
+    std::vector<Matrix4x4> worlds(ObjectCount);
+    BuildWorldMatrices(transforms, worlds.data());
+    CHECK(SameBits(worlds.data(), reference.worlds.data(), ObjectCount * sizeof(Matrix4x4)));
+    SetSimdLevel(supported);
+    CHECK_EQ(int(GetSimdLevel()), int(supported));
+}
@@ -0,0 +1,187 @@
+#include "CommandListPolicy.h"
+#include "Test.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Stands in for an ID3D12Fence: Signal() hands out the next value of the queue's
+// submissions, and Advance(), called from the thread playing the GPU, completes them in
+// order some time later.
+class StandInFence {
+public:
+    uint64_t Signal() { return signaled.fetch_add(1) + 1; }
+    uint64_t GetCompletedValue() const { return completed.load(std::memory_order_acquire); }
+
+    bool Advance() {
+        uint64_t value = completed.load(std::memory_order_relaxed);
+        if (value >= signaled.load()) {
+            return false;
+        }
+        completed.store(value + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::atomic<uint64_t> signaled{ 0 };
+    std::atomic<uint64_t> completed{ 0 };
+};
+
+struct StressResult {
+    uint64_t acquires;
+    uint64_t exhausted;
+    uint64_t doubleAcquires;    // An entry handed to a second owner before its Release().
+    uint64_t wrongQueue;        // An entry outside the range of the queue it was acquired for.
+    uint64_t reusedEarly;       // An entry reused before the fence of its last submission.
+    CommandListStats stats;
+};
+
+// threadCount threads each acquire acquiresPerThread entries, rotating over the queues,
+// while one more thread completes fence values. The GPU falls behind whenever the workers
+// run ahead of it, so most pools are exhausted most of the time. Some lists are released
+// without a submission, with fence value 0.
+StressResult RunStress(uint32_t threadCount, uint32_t acquiresPerThread) {
+    const uint32_t maxEntries[QueueCount] = { 4, 3, 2 };
+    CommandListPolicy policy;
+    policy.Reset(maxEntries);
+    StandInFence fences[QueueCount];
+
+    // What the owners of the entries see; lastFences is handed over through the policy's
+    // lock, from the Release() of one owner to the Acquire() of the next.
+    std::unique_ptr<std::atomic<bool>[]> inUse(new std::atomic<bool>[policy.GetEntryCount()]);
+    std::vector<uint64_t> lastFences(policy.GetEntryCount(), 0);
+    for (uint32_t i = 0; i < policy.GetEntryCount(); i++) {
+        inUse[i] = false;
+    }
+
+    std::atomic<uint64_t> exhausted{ 0 };
+    std::atomic<uint64_t> doubleAcquires{ 0 };
+    std::atomic<uint64_t> wrongQueue{ 0 };
+    std::atomic<uint64_t> reusedEarly{ 0 };
+    std::atomic<uint32_t> runningCount{ threadCount };
+
+    std::thread gpu([&]() {
+        while (runningCount.load() != 0) {
+            for (StandInFence &fence : fences) {
+                fence.Advance();
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < threadCount; thread++) {
+        threads.emplace_back([&, thread]() {
+            for (uint32_t i = 0; i < acquiresPerThread; i++) {
+                QueueType queue = (QueueType) ((thread + i) % QueueCount);
+                StandInFence &fence = fences[(uint32_t) queue];
+
+                uint64_t completed;
+                uint32_t entry;
+                CommandListPolicy::AcquireResult result;
+                for (;;) {
+                    completed = fence.GetCompletedValue();
+                    result = policy.Acquire(queue, completed, entry);
+                    if (result != CommandListPolicy::AcquireResult::Exhausted) {
+                        break;
+                    }
+                    exhausted++;
+                    std::this_thread::yield();
+                }
+
+                wrongQueue += policy.GetQueue(entry) != queue;
+                doubleAcquires += inUse[entry].exchange(true);
+                reusedEarly += result == CommandListPolicy::AcquireResult::Reused && lastFences[entry] > completed;
+                reusedEarly += result == CommandListPolicy::AcquireResult::Created && lastFences[entry] != 0;
+
+                // Record, then submit, or give the list back unused.
+                uint64_t fenceValue = i % 8 == 7 ? 0 : fence.Signal();
+                lastFences[entry] = fenceValue;
+                inUse[entry] = false;
+                policy.Release(entry, fenceValue);
+            }
+            runningCount--;
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    gpu.join();
+
+    StressResult result;
+    result.acquires = uint64_t(threadCount) * acquiresPerThread;
+    result.exhausted = exhausted;
+    result.doubleAcquires = doubleAcquires;
+    result.wrongQueue = wrongQueue;
+    result.reusedEarly = reusedEarly;
+    result.stats = policy.GetStats();
+    return result;
+}
+
+void CheckStress(const StressResult &result) {
+    CHECK_EQ(result.doubleAcquires, uint64_t(0));
+    CHECK_EQ(result.wrongQueue, uint64_t(0));
+    CHECK_EQ(result.reusedEarly, uint64_t(0));
+    CHECK_EQ(result.stats.createdCount + result.stats.reusedCount, result.acquires);
+    CHECK_EQ(result.stats.exhaustedCount, result.exhausted);
+    CHECK(result.stats.createdCount <= 9);
+    CHECK_EQ(result.stats.acquiredCount, 0u);
+    CHECK_EQ(uint64_t(result.stats.pendingCount), result.stats.createdCount);
+}
+
+} // namespace
+
+// The retired entry with the oldest fence comes back first, and only once that fence has
+// completed; a list released without a submission is ready right away.
+TEST(CommandListPolicyReusesOldestFence) {
+    const uint32_t maxEntries[QueueCount] = { 2, 1, 0 };
+    CommandListPolicy policy;
+    policy.Reset(maxEntries);
+    CHECK_EQ(policy.GetEntryCount(), 3u);
+
+    uint32_t first, second, entry;
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Graphics, 0, first), (uint32_t) CommandListPolicy::AcquireResult::Created);
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Graphics, 0, second), (uint32_t) CommandListPolicy::AcquireResult::Created);
+    CHECK_EQ(first, 0u);
+    CHECK_EQ(second, 1u);
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Graphics, 100, entry), (uint32_t) CommandListPolicy::AcquireResult::Exhausted);
+    CHECK_EQ(entry, CommandListPolicy::InvalidEntry);
+    CHECK_EQ(policy.GetOldestFenceValue(QueueType::Graphics), uint64_t(0));
+
+    policy.Release(second, 5);
+    policy.Release(first, 3);
+    CHECK_EQ(policy.GetOldestFenceValue(QueueType::Graphics), uint64_t(3));
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Graphics, 2, entry), (uint32_t) CommandListPolicy::AcquireResult::Exhausted);
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Graphics, 5, entry), (uint32_t) CommandListPolicy::AcquireResult::Reused);
+    CHECK_EQ(entry, first);
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Graphics, 5, entry), (uint32_t) CommandListPolicy::AcquireResult::Reused);
+    CHECK_EQ(entry, second);
+
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Compute, 0, entry), (uint32_t) CommandListPolicy::AcquireResult::Created);
+    CHECK_EQ(entry, 2u);
+    CHECK_EQ((uint32_t) policy.GetQueue(entry), (uint32_t) QueueType::Compute);
+    policy.Release(entry, 0);
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Compute, 0, entry), (uint32_t) CommandListPolicy::AcquireResult::Reused);
+    CHECK_EQ((uint32_t) policy.Acquire(QueueType::Copy, 0, entry), (uint32_t) CommandListPolicy::AcquireResult::Exhausted);
+
+    CommandListStats stats = policy.GetStats();
+    CHECK_EQ(stats.createdCount, uint64_t(3));
+    CHECK_EQ(stats.reusedCount, uint64_t(3));
+    CHECK_EQ(stats.exhaustedCount, uint64_t(3));
+    CHECK_EQ(stats.acquiredCount, 3u);
+    CHECK_EQ(stats.pendingCount, 0u);
+}
+
+TEST(CommandListPolicyStress) {
+    CheckStress(RunStress(8, 5000));
+}
+
+TEST(CommandListPolicyStressManyThreads) {
+    StressResult result = RunStress(16, 20000);
+    CheckStress(result);
+    CHECK(result.exhausted > 0);  // The pools ran dry, so entries waited for the fence.
+    CHECK(result.stats.reusedCount > result.acquires - 10);
+}
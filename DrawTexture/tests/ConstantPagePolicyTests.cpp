@@ -0,0 +1,94 @@
+#include "ConstantPagePolicy.h"
+#include "Test.h"
+
+namespace {
+
+// Allocates like ConstantAllocator, adding pages on demand.
+void Allocate(ConstantPagePolicy &policy, uint64_t size, size_t &page, uint64_t &offset) {
+    if (!policy.Allocate(size, page, offset)) {
+        policy.AddPage(policy.GetNewPageSize(size));
+        REQUIRE(policy.Allocate(size, page, offset));
+    }
+}
+
+} // namespace
+
+TEST(ConstantPagePolicyAligns) {
+    ConstantPagePolicy policy;
+    policy.Reset(1000);
+    CHECK_EQ(policy.GetPageSize(), uint64_t(1024));
+    policy.AddPage(policy.GetPageSize());
+    policy.BeginFrame(0);
+
+    size_t page;
+    uint64_t offset;
+    uint64_t expected[] = { 0, 256, 512, 768 };
+    for (uint64_t value : expected) {
+        REQUIRE(policy.Allocate(value == 256 ? 0 : 4, page, offset));
+        CHECK_EQ(page, size_t(0));
+        CHECK_EQ(offset, value);
+    }
+    CHECK_EQ(policy.GetFrameBytes(), uint64_t(1024));
+    CHECK_EQ(policy.GetFrameAllocations(), 4u);
+
+    // The page is full; a larger one is added for an oversized allocation.
+    CHECK(!policy.Allocate(1, page, offset));
+    CHECK_EQ(policy.GetNewPageSize(1), uint64_t(1024));
+    CHECK_EQ(policy.GetNewPageSize(3000), uint64_t(3072));
+}
+
+TEST(ConstantPagePolicyWaitsForFence) {
+    ConstantPagePolicy policy;
+    policy.Reset(1024);
+    size_t page;
+    uint64_t offset;
+
+    // Frame 1 fills two pages and frame 2 needs new ones while frame 1 is in flight.
+    policy.BeginFrame(0);
+    Allocate(policy, 1024, page, offset);
+    Allocate(policy, 1024, page, offset);
+    policy.EndFrame(1);
+    CHECK_EQ(policy.GetPageCount(), size_t(2));
+
+    policy.BeginFrame(0);
+    Allocate(policy, 512, page, offset);
+    CHECK_EQ(page, size_t(2));
+    policy.EndFrame(2);
+    CHECK_EQ(policy.GetFreePageCount(), size_t(0));
+
+    // Frame 1 completes: its pages come back, frame 2's page stays in flight.
+    policy.BeginFrame(1);
+    CHECK_EQ(policy.GetFreePageCount(), size_t(2));
+    Allocate(policy, 1024, page, offset);
+    CHECK(page < 2);
+    Allocate(policy, 1024, page, offset);
+    CHECK(page < 2);
+    Allocate(policy, 1024, page, offset);
+    CHECK_EQ(page, size_t(3));
+    policy.EndFrame(3);
+    CHECK_EQ(policy.GetPageCount(), size_t(4));
+}
+
+TEST(ConstantPagePolicySteadyState) {
+    // Three frames in flight of the same size stop adding pages after the first three.
+    const uint64_t framesInFlight = 3;
+    ConstantPagePolicy policy;
+    policy.Reset(64 * 1024);
+
+    size_t pageCount = 0;
+    for (uint64_t frame = 1; frame <= 100; frame++) {
+        policy.BeginFrame(frame > framesInFlight ? frame - framesInFlight : 0);
+        for (int i = 0; i < 600; i++) {
+            size_t page;
+            uint64_t offset;
+            Allocate(policy, 64, page, offset);
+            CHECK(offset + 64 <= 64 * 1024);
+        }
+        policy.EndFrame(frame);
+        if (frame == framesInFlight) {
+            pageCount = policy.GetPageCount();
+        }
+    }
+    CHECK_EQ(policy.GetPageCount(), pageCount);
+    CHECK_EQ(pageCount, size_t(3 * 3));
+}
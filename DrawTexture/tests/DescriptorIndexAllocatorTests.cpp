@@ -0,0 +1,200 @@
+#include "DescriptorIndexAllocator.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+namespace {
+
+// The allocator's contract written out plainly: an index is free, allocated, or waiting
+// for the fence value it was freed with, and Allocate() takes the lowest free one.
+class ReferenceAllocator {
+public:
+    explicit ReferenceAllocator(uint32_t capacity) : fenceValues(capacity, 0), allocated(capacity, false) {
+        for (uint32_t i = 0; i < capacity; i++) {
+            freeIndices.insert(i);
+        }
+    }
+
+    uint32_t Allocate() {
+        if (freeIndices.empty()) {
+            return DescriptorIndexAllocator::InvalidIndex;
+        }
+        uint32_t index = *freeIndices.begin();
+        freeIndices.erase(freeIndices.begin());
+        allocated[index] = true;
+        return index;
+    }
+
+    bool Free(uint32_t index, uint64_t fenceValue) {
+        if (index >= allocated.size() || !allocated[index]) {
+            return false;
+        }
+        allocated[index] = false;
+        fenceValues[index] = fenceValue;
+        pending.insert(index);
+        return true;
+    }
+
+    void Reclaim(uint64_t completedFenceValue) {
+        for (auto i = pending.begin(); i != pending.end();) {
+            if (fenceValues[*i] <= completedFenceValue) {
+                freeIndices.insert(*i);
+                i = pending.erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    uint64_t GetFenceValue(uint32_t index) const { return fenceValues[index]; }
+    bool IsAllocated(uint32_t index) const { return allocated[index]; }
+    uint32_t GetPendingCount() const { return uint32_t(pending.size()); }
+    uint32_t GetAllocatedCount() const { return uint32_t(std::count(allocated.begin(), allocated.end(), true)); }
+
+private:
+    std::vector<uint64_t> fenceValues;  // Of the last Free().
+    std::vector<bool> allocated;
+    std::set<uint32_t> freeIndices;
+    std::set<uint32_t> pending;
+};
+
+} // namespace
+
+TEST(DescriptorIndexAllocatorExhaustion) {
+    DescriptorIndexAllocator allocator(4);
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK_EQ(allocator.Allocate(), i);
+    }
+    CHECK_EQ(allocator.Allocate(), DescriptorIndexAllocator::InvalidIndex);
+    CHECK_EQ(allocator.GetHighWaterMark(), 4u);
+
+    // A freed index is not available until its fence completes, even with the heap full.
+    CHECK(allocator.Free(2, 10));
+    CHECK_EQ(allocator.Allocate(), DescriptorIndexAllocator::InvalidIndex);
+    allocator.Reclaim(9);
+    CHECK_EQ(allocator.Allocate(), DescriptorIndexAllocator::InvalidIndex);
+    allocator.Reclaim(10);
+    CHECK_EQ(allocator.Allocate(), 2u);
+    CHECK_EQ(allocator.Allocate(), DescriptorIndexAllocator::InvalidIndex);
+    CHECK_EQ(allocator.GetAllocatedCount(), 4u);
+
+    allocator.Reset(2);
+    CHECK_EQ(allocator.GetAllocatedCount(), 0u);
+    CHECK_EQ(allocator.GetHighWaterMark(), 0u);
+    CHECK(!allocator.IsAllocated(0));
+    CHECK_EQ(allocator.Allocate(), 0u);
+
+    DescriptorIndexAllocator empty;
+    CHECK_EQ(empty.Allocate(), DescriptorIndexAllocator::InvalidIndex);
+    CHECK(!empty.Free(0, 1));
+}
+
+TEST(DescriptorIndexAllocatorRejectsDoubleFree) {
+    DescriptorIndexAllocator allocator(8);
+    uint32_t index = allocator.Allocate();
+    CHECK(allocator.Free(index, 1));
+    CHECK(!allocator.Free(index, 2));  // Pending.
+    CHECK_EQ(allocator.GetPendingCount(), 1u);
+    allocator.Reclaim(1);
+    CHECK(!allocator.Free(index, 3));  // Free.
+    CHECK(!allocator.Free(5, 3));      // Never allocated.
+    CHECK(!allocator.Free(8, 3));      // Out of range.
+    CHECK(!allocator.Free(DescriptorIndexAllocator::InvalidIndex, 3));
+    CHECK_EQ(allocator.GetPendingCount(), 0u);
+    CHECK_EQ(allocator.GetAllocatedCount(), 0u);
+}
+
+// Indices freed on different queues complete out of order; each comes back with its own
+// fence, and the lowest of the reclaimed ones is handed out first.
+TEST(DescriptorIndexAllocatorReusesInFenceOrder) {
+    DescriptorIndexAllocator allocator(8);
+    for (uint32_t i = 0; i < 6; i++) {
+        allocator.Allocate();
+    }
+    CHECK(allocator.Free(1, 5));
+    CHECK(allocator.Free(3, 3));
+    CHECK(allocator.Free(4, 3));
+    CHECK(allocator.Free(0, 7));
+
+    allocator.Reclaim(2);
+    CHECK_EQ(allocator.GetPendingCount(), 4u);
+    CHECK_EQ(allocator.Allocate(), 6u);  // Nothing reclaimed: a fresh index.
+
+    allocator.Reclaim(3);
+    CHECK_EQ(allocator.GetPendingCount(), 2u);
+    CHECK_EQ(allocator.Allocate(), 3u);
+    CHECK_EQ(allocator.Allocate(), 4u);
+    CHECK_EQ(allocator.Allocate(), 7u);
+
+    allocator.Reclaim(7);
+    CHECK_EQ(allocator.Allocate(), 0u);
+    CHECK_EQ(allocator.Allocate(), 1u);
+    CHECK_EQ(allocator.Allocate(), DescriptorIndexAllocator::InvalidIndex);
+    CHECK_EQ(allocator.GetHighWaterMark(), 8u);
+}
+
+// 200K random operations against ReferenceAllocator, with several frames in flight and
+// indices freed with fence values out of order: every result matches the model and no
+// index is handed out again before the fence it was freed with has completed.
+TEST(DescriptorIndexAllocatorMatchesReference) {
+    const uint32_t capacity = 512;
+    DescriptorIndexAllocator allocator(capacity);
+    ReferenceAllocator reference(capacity);
+    TestRandom random(45);
+
+    std::vector<uint32_t> allocated;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint32_t exhausted = 0;
+    uint32_t rejected = 0;
+    for (int operation = 0; operation < 200000; operation++) {
+        uint32_t kind = random.Below(100);
+        if (kind < 45) {
+            uint32_t index = allocator.Allocate();
+            REQUIRE(index == reference.Allocate());
+            if (index == DescriptorIndexAllocator::InvalidIndex) {
+                exhausted++;
+                continue;
+            }
+            REQUIRE(reference.GetFenceValue(index) <= completed);
+            allocated.push_back(index);
+        } else if (kind < 85 && !allocated.empty()) {
+            uint32_t slot = random.Below(uint32_t(allocated.size()));
+            uint32_t index = allocated[slot];
+            allocated[slot] = allocated.back();
+            allocated.pop_back();
+            // The last use may be in the frame being recorded or in one still to come.
+            uint64_t fenceValue = submitted + 1 + random.Below(3);
+            REQUIRE(allocator.Free(index, fenceValue));
+            REQUIRE(reference.Free(index, fenceValue));
+        } else if (kind < 90) {
+            // Any index: usually one freed already or never allocated.
+            uint32_t index = random.Below(capacity + 4);
+            bool expected = reference.Free(index, submitted + 1);
+            REQUIRE(allocator.Free(index, submitted + 1) == expected);
+            if (expected) {
+                allocated.erase(std::find(allocated.begin(), allocated.end(), index));
+            } else {
+                rejected++;
+            }
+        } else {
+            // A frame is submitted, and the GPU catches up with some of the frames in flight.
+            submitted++;
+            completed = (std::min)(submitted, completed + random.Below(3));
+            allocator.Reclaim(completed);
+            reference.Reclaim(completed);
+        }
+
+        REQUIRE(allocator.GetAllocatedCount() == reference.GetAllocatedCount());
+        REQUIRE(allocator.GetPendingCount() == reference.GetPendingCount());
+    }
+
+    for (uint32_t i = 0; i < capacity; i++) {
+        CHECK_EQ(allocator.IsAllocated(i), reference.IsAllocated(i));
+    }
+    CHECK(exhausted > 0);
+    CHECK(rejected > 1000);
+    CHECK(allocator.GetHighWaterMark() <= capacity);
+}
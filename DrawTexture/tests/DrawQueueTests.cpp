@@ -0,0 +1,160 @@
+#include "DrawQueue.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Sorts a copy of the queue's packets with std::stable_sort, the order Sort() must give.
+std::vector<DrawPacket> StableSorted(const DrawQueue &queue) {
+    std::vector<DrawPacket> packets = queue.GetPackets();
+    std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket &a, const DrawPacket &b) { return a.key < b.key; });
+    return packets;
+}
+
+bool SamePackets(const std::vector<DrawPacket> &a, const std::vector<DrawPacket> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].key != b[i].key || a[i].objectId != b[i].objectId || a[i].mesh != b[i].mesh) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<uint32_t> GetObjectIds(const DrawQueue &queue) {
+    std::vector<uint32_t> ids;
+    for (const DrawPacket &packet : queue.GetPackets()) {
+        ids.push_back(packet.objectId);
+    }
+    return ids;
+}
+
+} // namespace
+
+TEST(DrawQueueSortsEmptyAndSingle) {
+    DrawQueue queue;
+    queue.Sort();
+    CHECK_EQ(queue.GetCount(), size_t(0));
+    CHECK_EQ(queue.GetSortPasses(), 0u);
+
+    queue.Add(DrawKey::Make(3, 2, 1, 4.0f), 7, 9);
+    queue.Sort();
+    REQUIRE(queue.GetCount() == 1);
+    CHECK_EQ(queue.GetPackets()[0].objectId, 7u);
+    CHECK_EQ(queue.GetPackets()[0].mesh, 9u);
+    CHECK_EQ(queue.GetSortPasses(), 0u);  // Every digit is the same in a single key.
+}
+
+// Only the digits that differ between keys are scattered; keys that are all equal are
+// not moved at all.
+TEST(DrawQueueSkipsUniformDigits) {
+    DrawQueue queue;
+    for (uint32_t i = 0; i < 100; i++) {
+        queue.Add(DrawKey::Make(1, 5, 9, 2.0f), i, 0);
+    }
+    queue.Sort();
+    CHECK_EQ(queue.GetSortPasses(), 0u);
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < 100; i++) {
+        expected.push_back(i);
+    }
+    CHECK(GetObjectIds(queue) == expected);
+
+    // Materials below 256 differ only in the lowest byte of their field.
+    queue.Clear();
+    for (uint32_t i = 0; i < 100; i++) {
+        queue.Add(DrawKey::Make(1, 5, (i * 37) & 255, 2.0f), i, 0);
+    }
+    std::vector<DrawPacket> sorted = StableSorted(queue);
+    queue.Sort();
+    CHECK_EQ(queue.GetSortPasses(), 1u);
+    CHECK(SamePackets(queue.GetPackets(), sorted));
+
+    // Layer and pipeline both change in the top byte; the material in its two bytes.
+    queue.Clear();
+    for (uint32_t i = 0; i < 100; i++) {
+        queue.Add(DrawKey::Make(i & 1, 0, i * 601, 2.0f), i, 0);
+    }
+    sorted = StableSorted(queue);
+    queue.Sort();
+    CHECK_EQ(queue.GetSortPasses(), 3u);
+    CHECK(SamePackets(queue.GetPackets(), sorted));
+
+    queue.Clear();
+    queue.Add(0x0101010101010101ull, 0, 0);
+    queue.Add(0, 1, 0);
+    queue.Sort();
+    CHECK_EQ(queue.GetSortPasses(), 8u);
+    CHECK_EQ(queue.GetPackets()[0].objectId, 1u);
+}
+
+// Equal keys keep the order they were added in, across chunks that are counted and
+// scattered in parallel.
+TEST(DrawQueueIsStable) {
+    TestRandom random(43);
+    DrawQueue queue;
+    const size_t count = DrawQueue::ChunkSize * 3 + 123;
+    for (size_t i = 0; i < count; i++) {
+        queue.Add(DrawKey::Make(random.Below(2), random.Below(4), random.Below(16), float(random.Below(8))), uint32_t(i), random.Below(3));
+    }
+    std::vector<DrawPacket> sorted = StableSorted(queue);
+    queue.Sort();
+    CHECK(SamePackets(queue.GetPackets(), sorted));
+
+    queue.Clear();
+    for (size_t i = 0; i < count; i++) {
+        queue.Add(i % 5 == 0 ? 42 : random.Next(), uint32_t(i), 0);
+    }
+    sorted = StableSorted(queue);
+    queue.Sort();
+    CHECK_EQ(queue.GetSortPasses(), 8u);
+    CHECK(SamePackets(queue.GetPackets(), sorted));
+}
+
+// Opaque layers sort front to back, translucent ones back to front, and the layer and
+// pipeline come before any depth.
+TEST(DrawQueueOrdersByDepth) {
+    const float depths[] = { 3.5f, 0.25f, 100.0f, 1.0f, 1e-30f, 7.0f };
+    DrawQueue queue;
+    for (uint32_t i = 0; i < 6; i++) {
+        queue.Add(DrawKey::Make(0, 1, 0, depths[i]), i, 0);
+        queue.Add(DrawKey::Make(1, 1, 0, depths[i], true), 10 + i, 0);
+    }
+    queue.Add(DrawKey::Make(0, 0, 0, 1000.0f), 20, 0);
+    queue.Sort();
+
+    std::vector<uint32_t> expected = { 20, 4, 1, 3, 0, 5, 2, 12, 15, 10, 13, 11, 14 };
+    CHECK(GetObjectIds(queue) == expected);
+}
+
+// Negative depths and both zeros make the same key, which sorts before every positive
+// depth, however small.
+TEST(DrawQueueClampsNegativeDepths) {
+    uint64_t zero = DrawKey::Make(0, 0, 0, 0.0f);
+    CHECK_EQ(DrawKey::Make(0, 0, 0, -0.0f), zero);
+    CHECK_EQ(DrawKey::Make(0, 0, 0, -5.0f), zero);
+    CHECK_EQ(DrawKey::Make(0, 0, 0, -1e30f), zero);
+    CHECK_EQ(DrawKey::Depth::Decode(zero), 0u);
+    CHECK(DrawKey::Make(0, 0, 0, 1e-45f) > zero);  // The smallest denormal.
+    CHECK_EQ(DrawKey::Make(0, 0, 0, -5.0f, true), DrawKey::Make(0, 0, 0, 0.0f, true));
+    CHECK_EQ(DrawKey::Depth::Decode(DrawKey::Make(0, 0, 0, -5.0f, true)), UINT32_MAX);
+
+    DrawQueue queue;
+    queue.Add(DrawKey::Make(0, 0, 0, 2.0f), 0, 0);
+    queue.Add(DrawKey::Make(0, 0, 0, -1.0f), 1, 0);
+    queue.Add(DrawKey::Make(0, 0, 0, 0.5f), 2, 0);
+    queue.Add(DrawKey::Make(0, 0, 0, -0.0f), 3, 0);
+    queue.Add(DrawKey::Make(0, 0, 0, 0.0f), 4, 0);
+    queue.Sort();
+    std::vector<uint32_t> expected = { 1, 3, 4, 2, 0 };
+    CHECK(GetObjectIds(queue) == expected);
+
+    // Fields that do not fit are truncated, not carried into the next one.
+    CHECK_EQ(DrawKey::Material::Decode(DrawKey::Make(0, 0, 0x12345, 0.0f)), 0x2345u);
+    CHECK_EQ(DrawKey::Pipeline::Decode(DrawKey::Make(0, 0x1001, 0, 0.0f)), 1u);
+    CHECK_EQ(DrawKey::Layer::Decode(DrawKey::Make(17, 0, 0, 0.0f)), 1u);
+}
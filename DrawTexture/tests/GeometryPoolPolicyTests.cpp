@@ -0,0 +1,186 @@
+#include "GeometryPoolPolicy.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Stand-ins for the pool's buffers: every element holds the handle of the mesh it
+// belongs to, so a compaction can be replayed and checked element by element.
+struct StandInBuffers {
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> indices;
+
+    StandInBuffers(uint32_t vertexCapacity, uint32_t indexCapacity)
+        : vertices(vertexCapacity, UINT32_MAX), indices(indexCapacity, UINT32_MAX) { }
+
+    void Upload(const GeometryPoolPolicy &policy, MeshHandle handle) {
+        const MeshRange &range = policy.GetRange(handle);
+        std::fill(vertices.begin() + range.baseVertex, vertices.begin() + range.baseVertex + range.vertexCount, handle);
+        std::fill(indices.begin() + range.startIndex, indices.begin() + range.startIndex + range.indexCount, handle);
+    }
+
+    // Copies into fresh buffers the way GeometryPool::Compact() records it.
+    void Replay(const std::vector<RangeCopy> &vertexCopies, const std::vector<RangeCopy> &indexCopies) {
+        auto replay = [](std::vector<uint32_t> &buffer, const std::vector<RangeCopy> &copies) {
+            std::vector<uint32_t> packed(buffer.size(), UINT32_MAX);
+            for (const RangeCopy &copy : copies) {
+                REQUIRE(copy.srcOffset + copy.size <= buffer.size() && copy.dstOffset + copy.size <= buffer.size());
+                std::copy(buffer.begin() + copy.srcOffset, buffer.begin() + copy.srcOffset + copy.size, packed.begin() + copy.dstOffset);
+            }
+            buffer.swap(packed);
+        };
+        replay(vertices, vertexCopies);
+        replay(indices, indexCopies);
+    }
+
+    bool Holds(const GeometryPoolPolicy &policy, MeshHandle handle) const {
+        const MeshRange &range = policy.GetRange(handle);
+        for (uint32_t i = 0; i < range.vertexCount; i++) {
+            if (vertices[range.baseVertex + i] != handle) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < range.indexCount; i++) {
+            if (indices[range.startIndex + i] != handle) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+TEST(GeometryPoolPolicyAllocates) {
+    GeometryPoolPolicy policy;
+    policy.Reset(100, 300);
+
+    MeshHandle a, b, c;
+    REQUIRE(policy.Allocate(10, 30, a));
+    REQUIRE(policy.Allocate(20, 60, b));
+    CHECK_EQ(policy.GetRange(b).baseVertex, 10u);
+    CHECK_EQ(policy.GetRange(b).startIndex, 30u);
+
+    // No index space: the vertices taken for it are given back.
+    CHECK(!policy.Allocate(10, 211, c));
+    CHECK_EQ(policy.GetVertexAllocator().GetFreeSize(), 70u);
+    CHECK(!policy.Allocate(71, 0, c));
+
+    // Freed handles are reused; freeing twice is ignored.
+    policy.Free(a);
+    policy.Free(a);
+    CHECK_EQ(policy.GetVertexAllocator().GetFreeSize(), 80u);
+    REQUIRE(policy.Allocate(5, 15, c));
+    CHECK_EQ(c, a);
+    CHECK_EQ(policy.GetRange(c).baseVertex, 0u);
+}
+
+// Holes left by freed meshes are closed, the survivors keep their handles and their
+// order, and adjacent survivors move with one copy.
+TEST(GeometryPoolPolicyCompacts) {
+    GeometryPoolPolicy policy;
+    policy.Reset(80, 240);
+    StandInBuffers buffers(80, 240);
+
+    MeshHandle handles[6];
+    const uint32_t vertexCounts[] = { 10, 20, 5, 15, 10, 10 };
+    const uint32_t indexCounts[] = { 30, 60, 0, 45, 30, 30 };
+    for (int i = 0; i < 6; i++) {
+        REQUIRE(policy.Allocate(vertexCounts[i], indexCounts[i], handles[i]));
+        buffers.Upload(policy, handles[i]);
+    }
+    CHECK(!policy.NeedsCompaction());
+
+    // Vertices 0-10 and 70-80 free: the largest block is half the free space.
+    policy.Free(handles[0]);
+    CHECK(!policy.NeedsCompaction());
+    policy.Free(handles[4]);
+    CHECK(policy.NeedsCompaction());
+    policy.Free(handles[2]);
+
+    std::vector<RangeCopy> vertexCopies;
+    std::vector<RangeCopy> indexCopies;
+    policy.Compact(vertexCopies, indexCopies);
+    buffers.Replay(vertexCopies, indexCopies);
+
+    REQUIRE(vertexCopies.size() == 3);
+    CHECK_EQ(vertexCopies[0].srcOffset, 10u);
+    CHECK_EQ(vertexCopies[0].dstOffset, 0u);
+    CHECK_EQ(vertexCopies[0].size, 20u);
+    CHECK_EQ(vertexCopies[1].srcOffset, 35u);
+    CHECK_EQ(vertexCopies[1].dstOffset, 20u);
+    CHECK_EQ(vertexCopies[2].srcOffset, 60u);
+    CHECK_EQ(vertexCopies[2].dstOffset, 35u);
+    // The third mesh had no indices, so the second and fourth are adjacent there.
+    REQUIRE(indexCopies.size() == 2);
+    CHECK_EQ(indexCopies[0].srcOffset, 30u);
+    CHECK_EQ(indexCopies[0].dstOffset, 0u);
+    CHECK_EQ(indexCopies[0].size, 105u);
+    CHECK_EQ(indexCopies[1].srcOffset, 165u);
+    CHECK_EQ(indexCopies[1].dstOffset, 105u);
+
+    for (int i : { 1, 3, 5 }) {
+        CHECK(buffers.Holds(policy, handles[i]));
+    }
+    CHECK_EQ(policy.GetRange(handles[5]).baseVertex, 35u);
+    CHECK_EQ(policy.GetRange(handles[5]).startIndex, 105u);
+    CHECK(!policy.NeedsCompaction());
+    CHECK_EQ(policy.GetVertexAllocator().GetFreeBlockCount(), size_t(1));
+    CHECK_EQ(policy.GetVertexAllocator().GetFreeSize(), 35u);
+    CHECK_EQ(policy.GetIndexAllocator().GetFreeSize(), 105u);
+
+    // New meshes go after the packed ones.
+    MeshHandle added;
+    REQUIRE(policy.Allocate(35, 105, added));
+    CHECK_EQ(policy.GetRange(added).baseVertex, 45u);
+    CHECK_EQ(policy.GetRange(added).startIndex, 135u);
+}
+
+// Random allocations and frees with a compaction whenever it is due: every live mesh
+// keeps its contents, and no copy overlaps another.
+TEST(GeometryPoolPolicyKeepsContentsAcrossCompactions) {
+    const uint32_t vertexCapacity = 4096;
+    const uint32_t indexCapacity = 8192;
+    TestRandom random(27);
+    GeometryPoolPolicy policy;
+    policy.Reset(vertexCapacity, indexCapacity);
+    StandInBuffers buffers(vertexCapacity, indexCapacity);
+
+    std::vector<MeshHandle> live;
+    uint32_t compactions = 0;
+    for (int step = 0; step < 5000; step++) {
+        MeshHandle handle;
+        if (live.empty() || random.Below(3) != 0) {
+            if (policy.Allocate(random.Below(64), random.Below(160), handle)) {
+                buffers.Upload(policy, handle);
+                live.push_back(handle);
+            }
+        } else {
+            size_t index = random.Below(uint32_t(live.size()));
+            policy.Free(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        if (policy.NeedsCompaction()) {
+            uint32_t freeVertices = policy.GetVertexAllocator().GetFreeSize();
+            uint32_t freeIndices = policy.GetIndexAllocator().GetFreeSize();
+            std::vector<RangeCopy> vertexCopies;
+            std::vector<RangeCopy> indexCopies;
+            policy.Compact(vertexCopies, indexCopies);
+            buffers.Replay(vertexCopies, indexCopies);
+            compactions++;
+
+            REQUIRE(policy.GetVertexAllocator().GetFreeSize() == freeVertices);
+            REQUIRE(policy.GetIndexAllocator().GetFreeSize() == freeIndices);
+            REQUIRE(policy.GetVertexAllocator().GetFragmentation() == 0.0f);
+            REQUIRE(policy.GetIndexAllocator().GetFragmentation() == 0.0f);
+            for (MeshHandle mesh : live) {
+                REQUIRE(buffers.Holds(policy, mesh));
+            }
+        }
+    }
+    CHECK(compactions > 10);
+}
@@ -0,0 +1,292 @@
+#include "GoldenTest.h"
+#include "ImageCompare.h"
+#include "ImageDecoder.h"
+#include "Test.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The image pairs in tests/images: reference.png, a copy with noise of at most 1 per
+// channel, one with an inverted 12 x 10 block, and its top-left 64 x 48 pixels.
+const char *const ImageDirectory = "tests/images/";
+
+struct Image {
+    std::vector<uint8_t> pixels;
+    ImageView view;
+};
+
+bool LoadImage(const std::string &path, Image &image) {
+    ImageDecoder decoder;
+    if (!decoder.Open(path.c_str())) {
+        return false;
+    }
+    const ImageInfo &info = decoder.GetInfo();
+    image.pixels.resize(size_t(info.width) * info.height * 4);
+    image.view = { image.pixels.data(), info.width, info.height, size_t(info.width) * 4, ChannelOrder::Rgba };
+    return decoder.Decode(image.pixels.data(), image.view.rowPitch);
+}
+
+Image LoadTestImage(const char *name) {
+    Image image;
+    REQUIRE(LoadImage(std::string(ImageDirectory) + name, image));
+    return image;
+}
+
+uint32_t GetLuma(const uint8_t *pixel) {
+    return (77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8;
+}
+
+// PSNR over RGB and the mean SSIM of 8 x 8 luma blocks, the slow way.
+void GetReferenceMetrics(const Image &a, const Image &b, double &psnr, double &ssim) {
+    const uint32_t width = a.view.width;
+    const uint32_t height = a.view.height;
+    double squaredError = 0.0;
+    for (size_t i = 0; i < a.pixels.size(); i++) {
+        if (i % 4 != 3) {
+            double d = double(a.pixels[i]) - double(b.pixels[i]);
+            squaredError += d * d;
+        }
+    }
+    double meanSquaredError = squaredError / (double(width) * height * 3);
+    psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+
+    const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+    const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+    double sum = 0.0;
+    uint32_t blocks = 0;
+    for (uint32_t y0 = 0; y0 < height; y0 += 8) {
+        for (uint32_t x0 = 0; x0 < width; x0 += 8) {
+            std::vector<double> x, y;
+            for (uint32_t py = y0; py < y0 + 8 && py < height; py++) {
+                for (uint32_t px = x0; px < x0 + 8 && px < width; px++) {
+                    x.push_back(GetLuma(&a.pixels[(size_t(py) * width + px) * 4]));
+                    y.push_back(GetLuma(&b.pixels[(size_t(py) * width + px) * 4]));
+                }
+            }
+            double meanX = 0.0, meanY = 0.0;
+            for (size_t i = 0; i < x.size(); i++) {
+                meanX += x[i] / x.size();
+                meanY += y[i] / y.size();
+            }
+            double varianceX = 0.0, varianceY = 0.0, covariance = 0.0;
+            for (size_t i = 0; i < x.size(); i++) {
+                varianceX += (x[i] - meanX) * (x[i] - meanX) / x.size();
+                varianceY += (y[i] - meanY) * (y[i] - meanY) / y.size();
+                covariance += (x[i] - meanX) * (y[i] - meanY) / x.size();
+            }
+            sum += ((2.0 * meanX * meanY + c1) * (2.0 * covariance + c2)) /
+                   ((meanX * meanX + meanY * meanY + c1) * (varianceX + varianceY + c2));
+            blocks++;
+        }
+    }
+    ssim = sum / blocks;
+}
+
+const GoldenTest *FindTest(const std::vector<GoldenTest> &tests, const char *name) {
+    for (const GoldenTest &test : tests) {
+        if (test.name == name) {
+            return &test;
+        }
+    }
+    return nullptr;
+}
+
+bool IsFile(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file) {
+        fclose(file);
+    }
+    return file != nullptr;
+}
+
+} // namespace
+
+// The metrics of the checked-in pairs against a direct implementation of their definitions.
+TEST(ImageCompareMatchesReferenceMetrics) {
+    Image reference = LoadTestImage("reference.png");
+    for (const char *name : { "reference.png", "noise.png", "defect.png" }) {
+        Image image = LoadTestImage(name);
+        ImageComparison comparison;
+        std::vector<uint8_t> diff;
+        REQUIRE(CompareImages(image.view, reference.view, 1, comparison, &diff));
+
+        double psnr, ssim;
+        GetReferenceMetrics(image, reference, psnr, ssim);
+        if (std::isinf(psnr)) {
+            CHECK(std::isinf(comparison.psnr));
+        } else {
+            CHECK_NEAR(comparison.psnr, psnr, 1e-9);
+        }
+        CHECK_NEAR(comparison.ssim, ssim, 1e-9);
+
+        uint32_t maxDifference = 0;
+        uint64_t exceedCount = 0;
+        for (size_t i = 0; i < image.pixels.size(); i += 4) {
+            uint32_t pixelDifference = 0;
+            for (size_t c = 0; c < 3; c++) {
+                uint32_t d = uint32_t(std::abs(int(image.pixels[i + c]) - int(reference.pixels[i + c])));
+                pixelDifference = d > pixelDifference ? d : pixelDifference;
+                CHECK_EQ(diff[i + c], uint8_t(d * 8 > 255 ? 255 : d * 8));
+            }
+            maxDifference = pixelDifference > maxDifference ? pixelDifference : maxDifference;
+            exceedCount += pixelDifference > 1;
+        }
+        CHECK_EQ(comparison.maxDifference, maxDifference);
+        CHECK_EQ(comparison.exceedCount, exceedCount);
+    }
+
+    // The expected ranges of the pairs, so a regenerated image that no longer tests what
+    // it should is noticed.
+    ImageComparison comparison;
+    REQUIRE(CompareImages(LoadTestImage("noise.png").view, reference.view, 1, comparison));
+    CHECK(comparison.psnr > 45.0 && comparison.psnr < 55.0);
+    CHECK_EQ(comparison.maxDifference, 1u);
+    REQUIRE(CompareImages(LoadTestImage("defect.png").view, reference.view, 2, comparison));
+    CHECK_EQ(comparison.exceedCount, uint64_t(120));
+    CHECK(comparison.ssim < 0.995 && comparison.psnr < 30.0);
+
+    // Channel order does not matter, and neither do the sizes of the rows.
+    Image swapped = reference;
+    for (size_t i = 0; i < swapped.pixels.size(); i += 4) {
+        std::swap(swapped.pixels[i], swapped.pixels[i + 2]);
+    }
+    swapped.view.pixels = swapped.pixels.data();
+    swapped.view.order = ChannelOrder::Bgra;
+    REQUIRE(CompareImages(swapped.view, reference.view, 0, comparison));
+    CHECK(std::isinf(comparison.psnr));
+    CHECK_EQ(comparison.ssim, 1.0);
+
+    CHECK(!CompareImages(LoadTestImage("cropped.png").view, reference.view, 0, comparison));
+}
+
+TEST(GoldenTestParsesConfig) {
+    std::vector<GoldenTest> tests;
+    REQUIRE(LoadGoldenTests("tests/images/golden.txt", tests));
+    REQUIRE(tests.size() == 5);
+    const GoldenTest *noise = FindTest(tests, "noise");
+    REQUIRE(noise != nullptr);
+    CHECK_EQ(noise->goldenPath, std::string("tests/images/reference.png"));
+    CHECK_EQ(noise->tolerance, 1u);
+    CHECK_EQ(noise->maxExceedFraction, 0.0);
+    CHECK_EQ(noise->minPsnr, 45.0);
+    CHECK_EQ(noise->minSsim, 0.99);
+    CHECK(!noise->pointSampling);
+
+    const GoldenTest *defect = FindTest(tests, "defect");  // Defaults, and a trailing comment.
+    REQUIRE(defect != nullptr);
+    CHECK_EQ(defect->warmupFrames, 8u);
+    CHECK_EQ(defect->measuredFrames, 60u);
+    CHECK_EQ(defect->minPsnr, 40.0);
+    CHECK_EQ(defect->tolerance, 2u);
+
+    const GoldenTest *missing = FindTest(tests, "missing");
+    REQUIRE(missing != nullptr);
+    CHECK_EQ(missing->warmupFrames, 0u);
+    CHECK_EQ(missing->measuredFrames, 1u);
+    CHECK_EQ(missing->maxFrameTime, 16.7);
+    CHECK(missing->pointSampling);
+
+    // Every malformed line is reported; the file as a whole fails.
+    const char *lines[] = {
+        "nameonly\n",
+        "a golden.png sampling=bilinear\n",
+        "a golden.png frames=0\n",
+        "a golden.png warmup=-1\n",
+        "a golden.png tolerance=1.5\n",
+        "a golden.png psnr=high\n",
+        "a golden.png exceed\n",
+        "a golden.png colors=16\n",
+    };
+    std::string path = GetTestDirectory() + "/golden.txt";
+    for (const char *line : lines) {
+        FILE *file = fopen(path.c_str(), "wb");
+        REQUIRE(file != nullptr);
+        fprintf(file, "# A comment\n\nok golden.png\n%s", line);
+        fclose(file);
+        tests.clear();
+        CHECK(!LoadGoldenTests(path.c_str(), tests));
+        CHECK(!tests.empty());
+    }
+    CHECK(!LoadGoldenTests((GetTestDirectory() + "/none.txt").c_str(), tests));
+}
+
+// The config's tests checked against their rendered stand-ins: statuses, the diff image,
+// missing goldens and the report.
+TEST(GoldenTestChecksImages) {
+    std::vector<GoldenTest> tests;
+    REQUIRE(LoadGoldenTests("tests/images/golden.txt", tests));
+    const std::string outputDir = GetTestDirectory();
+    const std::string reference = std::string(ImageDirectory) + "reference.png";
+
+    struct Expected {
+        const char *name;
+        const char *actual;
+        GoldenStatus status;
+    };
+    const Expected expected[] = {
+        { "identical", "reference.png", GoldenStatus::Passed },
+        { "noise", "noise.png", GoldenStatus::Passed },
+        { "defect", "defect.png", GoldenStatus::Failed },
+        { "cropped", "cropped.png", GoldenStatus::Error },
+        { "missing", "reference.png", GoldenStatus::Missing },
+    };
+    std::vector<GoldenResult> results;
+    for (const Expected &entry : expected) {
+        const GoldenTest *test = FindTest(tests, entry.name);
+        REQUIRE(test != nullptr);
+        std::string actual = std::string(ImageDirectory) + entry.actual;
+        GoldenResult result = CheckGolden(*test, actual.c_str(), outputDir.c_str(), 4.0, 3.0);
+        CHECK_EQ(std::string(GetGoldenStatusName(result.status)), std::string(GetGoldenStatusName(entry.status)));
+        results.push_back(result);
+    }
+    CHECK(!IsFile("tests/images/missing.png"));  // Not created without createMissing.
+
+    // The defect shows in the diff image, amplified; the rest is black.
+    Image diff;
+    REQUIRE(LoadImage(outputDir + "/defect_diff.png", diff));
+    CHECK_EQ(diff.pixels[(size_t(45) * diff.view.width + 10) * 4], uint8_t(255));
+    CHECK_EQ(diff.pixels[(size_t(20) * diff.view.width + 60) * 4], uint8_t(0));
+
+    // Over the frame time limit fails even with identical images.
+    GoldenTest timed = *FindTest(tests, "identical");
+    timed.maxFrameTime = 3.0;
+    CHECK_EQ((uint32_t) CheckGolden(timed, reference.c_str(), outputDir.c_str(), 2.9, 0.0).status, (uint32_t) GoldenStatus::Passed);
+    CHECK_EQ((uint32_t) CheckGolden(timed, reference.c_str(), outputDir.c_str(), 3.1, 0.0).status, (uint32_t) GoldenStatus::Failed);
+
+    // With createMissing the rendered image becomes the golden; the next run compares with it.
+    GoldenTest created = *FindTest(tests, "missing");
+    created.goldenPath = outputDir + "/created.png";
+    std::string noise = std::string(ImageDirectory) + "noise.png";
+    CHECK_EQ((uint32_t) CheckGolden(created, noise.c_str(), outputDir.c_str(), 0.0, 0.0, true).status, (uint32_t) GoldenStatus::Created);
+    GoldenResult again = CheckGolden(created, noise.c_str(), outputDir.c_str(), 0.0, 0.0, true);
+    CHECK_EQ((uint32_t) again.status, (uint32_t) GoldenStatus::Passed);
+    CHECK(std::isinf(again.comparison.psnr));
+    std::string unreadable = outputDir + "/none.png";
+    CHECK_EQ((uint32_t) CheckGolden(created, unreadable.c_str(), outputDir.c_str(), 0.0, 0.0).status, (uint32_t) GoldenStatus::Error);
+
+    // One line per test after the header.
+    std::string reportPath = outputDir + "/report.txt";
+    std::vector<GoldenTest> reported(tests.begin(), tests.begin() + results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        reported[i] = *FindTest(tests, expected[i].name);
+    }
+    REQUIRE(WriteGoldenReport(reportPath.c_str(), reported, results));
+    FILE *file = fopen(reportPath.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    char line[256];
+    std::vector<std::string> lines;
+    while (fgets(line, sizeof(line), file)) {
+        lines.push_back(line);
+    }
+    fclose(file);
+    REQUIRE(lines.size() == 6);
+    CHECK_EQ(lines[3].substr(0, 14), std::string("defect FAILED "));
+    CHECK_EQ(lines[5].substr(0, 16), std::string("missing MISSING "));
+}
@@ -0,0 +1,244 @@
+#include "ImageDecoder.h"
+#include "Test.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The images in tests/images/decoder, 37 x 29 so that no MCU or Adam7 pass is complete
+// at the edges. Each has a .rgba file of the pixels expected from it: for the JPEGs what
+// libjpeg decodes, for the PNGs the samples written, expanded to RGBA8 by the rules of
+// the format (low depths scaled, 16-bit samples cut to their high byte).
+const char *const DecoderDirectory = "tests/images/decoder/";
+const uint32_t FixtureWidth = 37;
+const uint32_t FixtureHeight = 29;
+
+struct Fixture {
+    const char *name;
+    uint32_t channels;
+    bool progressive;
+};
+
+const Fixture JpegFixtures[] = {
+    { "baseline444.jpg", 3, false },
+    { "baseline422.jpg", 3, false },
+    { "baseline420.jpg", 3, false },
+    { "progressive420.jpg", 3, true },
+    { "progressive444.jpg", 3, true },
+    { "restart420.jpg", 3, false },       // A restart marker after every MCU.
+    { "restartrows422.jpg", 3, false },   // After every MCU row.
+    { "gray.jpg", 1, false },
+    { "grayprogressive.jpg", 1, true },
+};
+
+// Filters cycle through all five types by row; the image data spans two IDAT chunks.
+const Fixture PngFixtures[] = {
+    { "gray1.png", 1, false },
+    { "gray2.png", 1, false },
+    { "gray4.png", 1, false },
+    { "gray8.png", 1, false },
+    { "gray16.png", 1, false },
+    { "gray4trns.png", 2, false },
+    { "gray16trns.png", 2, false },
+    { "graya8.png", 2, false },
+    { "graya16.png", 2, false },
+    { "rgb8.png", 3, false },
+    { "rgb16.png", 3, false },
+    { "rgb8trns.png", 4, false },
+    { "rgb16trns.png", 4, false },
+    { "rgba8.png", 4, false },
+    { "rgba16.png", 4, false },
+    { "palette1.png", 3, false },
+    { "palette2.png", 3, false },
+    { "palette4.png", 3, false },
+    { "palette8.png", 3, false },
+    { "palette2trns.png", 4, false },   // tRNS shorter than the palette.
+    { "palette8trns.png", 4, false },
+    { "gray1adam7.png", 1, true },
+    { "gray4trnsadam7.png", 2, true },
+    { "graya16adam7.png", 2, true },
+    { "rgb16adam7.png", 3, true },
+    { "rgba8adam7.png", 4, true },
+    { "palette4adam7.png", 3, true },
+    { "palette8trnsadam7.png", 4, true },
+};
+
+std::vector<uint8_t> ReadFixture(const std::string &name) {
+    MappedFile file;
+    REQUIRE(file.Open((DecoderDirectory + name).c_str()));
+    const uint8_t *data = (const uint8_t *) file.GetData();
+    return std::vector<uint8_t>(data, data + file.GetSize());
+}
+
+std::vector<uint8_t> ReadExpectedPixels(const char *name) {
+    std::string path = name;
+    std::vector<uint8_t> pixels = ReadFixture(path.substr(0, path.rfind('.')) + ".rgba");
+    REQUIRE(pixels.size() == size_t(FixtureWidth) * FixtureHeight * 4);
+    return pixels;
+}
+
+// Decodes into rows padded like a texture footprint, then checks that the padding was not
+// written and returns the pixels without it.
+bool DecodeFixture(const std::vector<uint8_t> &file, std::vector<uint8_t> &pixels) {
+    const uint8_t Canary = 0xCD;
+    ImageDecoder decoder;
+    if (!decoder.OpenMemory(file.data(), file.size())) {
+        return false;
+    }
+    const ImageInfo &info = decoder.GetInfo();
+    size_t rowBytes = size_t(info.width) * 4;
+    size_t rowPitch = rowBytes + 12;
+    std::vector<uint8_t> padded(rowPitch * info.height + 16, Canary);
+    if (!decoder.Decode(padded.data(), rowPitch)) {
+        return false;
+    }
+
+    pixels.resize(rowBytes * info.height);
+    for (uint32_t y = 0; y < info.height; y++) {
+        memcpy(&pixels[y * rowBytes], &padded[y * rowPitch], rowBytes);
+        for (size_t x = rowBytes; x < rowPitch; x++) {
+            REQUIRE(padded[y * rowPitch + x] == Canary);
+        }
+    }
+    for (size_t i = rowPitch * info.height; i < padded.size(); i++) {
+        REQUIRE(padded[i] == Canary);
+    }
+    return true;
+}
+
+void CheckInfo(const Fixture &fixture, const std::vector<uint8_t> &file, ImageFormat format) {
+    ImageDecoder decoder;
+    REQUIRE(decoder.OpenMemory(file.data(), file.size()));
+    const ImageInfo &info = decoder.GetInfo();
+    CHECK_EQ((uint32_t) info.format, (uint32_t) format);
+    CHECK_EQ(info.width, FixtureWidth);
+    CHECK_EQ(info.height, FixtureHeight);
+    CHECK_EQ(info.channels, fixture.channels);
+    CHECK_EQ(info.progressive, fixture.progressive);
+}
+
+// Every prefix of the file: either Open() or Decode() must fail, and neither may read
+// past the end, which the sanitizer builds catch.
+void CheckTruncations(const std::vector<uint8_t> &file, size_t step, uint32_t &accepted) {
+    std::vector<uint8_t> pixels;
+    for (size_t size = 0; size < file.size(); size += step) {
+        // A copy of exactly size bytes, so reads past the end are out of bounds.
+        std::vector<uint8_t> prefix(file.begin(), file.begin() + size);
+        accepted += DecodeFixture(prefix, pixels);
+    }
+}
+
+} // namespace
+
+// JPEG: libjpeg uses an integer IDCT and interpolates chroma; the built-in decoder uses
+// a float AAN IDCT and the same triangle filter, so values may differ by rounding.
+TEST(ImageDecoderMatchesJpegFixtures) {
+    for (const Fixture &fixture : JpegFixtures) {
+        std::vector<uint8_t> file = ReadFixture(fixture.name);
+        CheckInfo(fixture, file, ImageFormat::Jpeg);
+        std::vector<uint8_t> expected = ReadExpectedPixels(fixture.name);
+        std::vector<uint8_t> pixels;
+        REQUIRE(DecodeFixture(file, pixels));
+
+        int maxError = 0;
+        double totalError = 0.0;
+        for (size_t i = 0; i < pixels.size(); i++) {
+            int error = abs(int(pixels[i]) - int(expected[i]));
+            maxError = error > maxError ? error : maxError;
+            totalError += error;
+        }
+        double meanError = totalError / pixels.size();
+        if (maxError > 3 || meanError > 0.1) {
+            fprintf(stderr, "%s: max error %d, mean error %.3f\n", fixture.name, maxError, meanError);
+        }
+        CHECK(maxError <= 3);
+        CHECK(meanError <= 0.1);
+    }
+}
+
+// PNG is lossless, so every pixel must match.
+TEST(ImageDecoderMatchesPngFixtures) {
+    for (const Fixture &fixture : PngFixtures) {
+        std::vector<uint8_t> file = ReadFixture(fixture.name);
+        CheckInfo(fixture, file, ImageFormat::Png);
+        std::vector<uint8_t> expected = ReadExpectedPixels(fixture.name);
+        std::vector<uint8_t> pixels;
+        REQUIRE(DecodeFixture(file, pixels));
+        if (pixels != expected) {
+            fprintf(stderr, "%s: pixels differ\n", fixture.name);
+        }
+        CHECK(pixels == expected);
+    }
+}
+
+TEST(ImageDecoderRejectsTruncatedInput) {
+    uint32_t accepted = 0;
+    for (const Fixture &fixture : JpegFixtures) {
+        CheckTruncations(ReadFixture(fixture.name), 1, accepted);
+    }
+    for (const Fixture &fixture : PngFixtures) {
+        CheckTruncations(ReadFixture(fixture.name), 3, accepted);
+    }
+    CHECK_EQ(accepted, 0u);
+}
+
+// Damaged headers must be rejected; damage anywhere else may decode to wrong pixels but
+// must neither crash nor write outside the destination.
+TEST(ImageDecoderSurvivesCorruptInput) {
+    std::vector<uint8_t> pixels;
+
+    std::vector<uint8_t> png = ReadFixture("rgba8.png");
+    std::vector<uint8_t> bad = png;
+    bad[1] = 'Q';                           // Signature.
+    CHECK(!DecodeFixture(bad, pixels));
+    bad = png;
+    bad[24] = 3;                            // Bit depth 3.
+    CHECK(!DecodeFixture(bad, pixels));
+    bad = png;
+    bad[25] = 5;                            // Color type 5.
+    CHECK(!DecodeFixture(bad, pixels));
+    bad = png;
+    bad[16] = bad[17] = bad[18] = bad[19] = 0;  // Width 0.
+    CHECK(!DecodeFixture(bad, pixels));
+
+    std::vector<uint8_t> jpeg = ReadFixture("baseline420.jpg");
+    size_t sof = 2;
+    while (sof + 1 < jpeg.size() && !(jpeg[sof] == 0xFF && jpeg[sof + 1] == 0xC0)) {
+        sof++;
+    }
+    REQUIRE(sof + 10 < jpeg.size());
+    bad = jpeg;
+    bad[sof + 4] = 12;                      // 12-bit precision.
+    CHECK(!DecodeFixture(bad, pixels));
+    bad = jpeg;
+    bad[sof + 7] = bad[sof + 8] = 0;        // Width 0.
+    CHECK(!DecodeFixture(bad, pixels));
+    bad = jpeg;
+    bad[sof + 1] = 0xC3;                    // Lossless.
+    CHECK(!DecodeFixture(bad, pixels));
+
+    TestRandom random(33);
+    uint32_t decoded = 0;
+    const char *const names[] = { "baseline420.jpg", "progressive420.jpg", "restart420.jpg", "gray.jpg",
+                                  "rgba8.png", "palette4adam7.png", "rgb16.png" };
+    for (const char *name : names) {
+        std::vector<uint8_t> file = ReadFixture(name);
+        for (int i = 0; i < 1000; i++) {
+            bad = file;
+            for (uint32_t flips = 1 + random.Below(4); flips > 0; flips--) {
+                bad[random.Below(uint32_t(bad.size()))] ^= uint8_t(1 + random.Below(255));
+            }
+            // Damaged sizes can ask for gigabytes; the header checks above cover them.
+            ImageDecoder decoder;
+            if (decoder.OpenMemory(bad.data(), bad.size()) &&
+                uint64_t(decoder.GetInfo().width) * decoder.GetInfo().height > FixtureWidth * FixtureHeight * 4) {
+                continue;
+            }
+            decoded += DecodeFixture(bad, pixels);
+        }
+    }
+    CHECK(decoded > 0);  // Damage in pixel data still decodes.
+}
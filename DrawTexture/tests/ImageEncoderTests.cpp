@@ -0,0 +1,343 @@
+#include "ImageDecoder.h"
+#include "ImageEncoder.h"
+#include "Test.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint32_t ReadBigEndian(const uint8_t *data) {
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+// Bit by bit, as in the PNG specification, so that it shares nothing with the encoder's table.
+uint32_t GetReferenceCrc32(const uint8_t *data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+uint32_t GetReferenceAdler32(const std::vector<uint8_t> &data) {
+    uint32_t a = 1, b = 0;
+    for (uint8_t value : data) {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Inflates the two block types the encoder writes, stored and fixed Huffman, so the
+// Adler-32 trailer can be checked against the decompressed scanlines.
+class FixedInflater {
+public:
+    FixedInflater(const uint8_t *data, size_t size) : data(data), size(size) { }
+
+    bool Inflate(std::vector<uint8_t> &out) {
+        static const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                                   513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        bool final = false;
+        while (!final) {
+            final = Bits(1) != 0;
+            uint32_t type = Bits(2);
+            if (type == 0) {
+                bitCount = 0;  // To the byte boundary.
+                if (position + 4 > size) {
+                    return false;
+                }
+                uint32_t length = data[position] | (data[position + 1] << 8);
+                uint32_t inverse = data[position + 2] | (data[position + 3] << 8);
+                position += 4;
+                if ((length ^ 0xFFFF) != inverse || position + length > size) {
+                    return false;
+                }
+                out.insert(out.end(), data + position, data + position + length);
+                position += length;
+                storedBlocks++;
+            } else if (type == 1) {
+                for (;;) {
+                    uint32_t symbol = FixedSymbol();
+                    if (failed || symbol > 285) {
+                        return false;
+                    }
+                    if (symbol < 256) {
+                        out.push_back(uint8_t(symbol));
+                        continue;
+                    }
+                    if (symbol == 256) {
+                        break;
+                    }
+                    uint32_t length = LengthBase[symbol - 257] + Bits(LengthExtra[symbol - 257]);
+                    uint32_t distanceCode = Reverse(Bits(5), 5);
+                    if (distanceCode >= 30) {
+                        return false;
+                    }
+                    uint32_t distance = DistanceBase[distanceCode] + Bits(DistanceExtra[distanceCode]);
+                    if (distance > out.size()) {
+                        return false;
+                    }
+                    for (uint32_t i = 0; i < length; i++) {
+                        out.push_back(out[out.size() - distance]);
+                    }
+                    matches++;
+                }
+                fixedBlocks++;
+            } else {
+                return false;
+            }
+        }
+        return !failed;
+    }
+
+    size_t GetPosition() const { return position; }
+
+    uint32_t storedBlocks = 0;
+    uint32_t fixedBlocks = 0;
+    uint32_t matches = 0;
+
+private:
+    // Values are packed from the least significant bit.
+    uint32_t Bits(uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (bitCount == 0) {
+                if (position >= size) {
+                    failed = true;
+                    return 0;
+                }
+                byte = data[position++];
+                bitCount = 8;
+            }
+            value |= uint32_t(byte & 1) << i;
+            byte >>= 1;
+            bitCount--;
+        }
+        return value;
+    }
+
+    static uint32_t Reverse(uint32_t value, uint32_t count) {
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            result = (result << 1) | ((value >> i) & 1);
+        }
+        return result;
+    }
+
+    // Huffman codes are packed from their most significant bit. The fixed code lengths
+    // are 7 bits for 256-279, 8 for 0-143 and 280-287, and 9 for 144-255.
+    uint32_t FixedSymbol() {
+        uint32_t code = Reverse(Bits(7), 7);
+        if (code <= 0x17) {
+            return 256 + code;
+        }
+        code = (code << 1) | Bits(1);
+        if (code >= 0x30 && code <= 0xBF) {
+            return code - 0x30;
+        }
+        if (code >= 0xC0 && code <= 0xC7) {
+            return 280 + code - 0xC0;
+        }
+        code = (code << 1) | Bits(1);
+        return code >= 0x190 ? 144 + code - 0x190 : 0xFFFF;
+    }
+
+    const uint8_t *data;
+    size_t size;
+    size_t position = 0;
+    uint8_t byte = 0;
+    uint32_t bitCount = 0;
+    bool failed = false;
+};
+
+struct PngChunk {
+    std::string type;
+    const uint8_t *data;
+    uint32_t size;
+};
+
+// Splits the file into chunks and checks each chunk's CRC.
+bool ReadChunks(const std::vector<uint8_t> &file, std::vector<PngChunk> &chunks) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (file.size() < 8 || memcmp(file.data(), signature, 8) != 0) {
+        return false;
+    }
+    size_t position = 8;
+    while (position < file.size()) {
+        if (position + 12 > file.size()) {
+            return false;
+        }
+        uint32_t size = ReadBigEndian(&file[position]);
+        if (position + 12 + size > file.size()) {
+            return false;
+        }
+        const uint8_t *type = &file[position + 4];
+        if (ReadBigEndian(type + 4 + size) != GetReferenceCrc32(type, size + 4)) {
+            return false;
+        }
+        chunks.push_back({ std::string((const char *) type, 4), type + 4, size });
+        position += 12 + size;
+    }
+    return true;
+}
+
+// A BGRA or RGBA image with padded rows: smooth gradients, which the fixed codes
+// compress, or noise, which goes into stored blocks.
+std::vector<uint8_t> MakeImage(uint32_t width, uint32_t height, size_t rowPitch, bool opaque, bool noise, uint64_t seed) {
+    TestRandom random(seed);
+    std::vector<uint8_t> pixels(rowPitch * height, 0xCD);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t *pixel = &pixels[rowPitch * y + x * 4];
+            for (uint32_t c = 0; c < 4; c++) {
+                pixel[c] = noise ? uint8_t(random.Next() >> 56) : uint8_t(x * (c + 1) + y * (3 - c) + (x / 7) * 13);
+            }
+            if (opaque) {
+                pixel[3] = 0xFF;
+            }
+        }
+    }
+    return pixels;
+}
+
+struct EncodedPng {
+    uint8_t colorType;
+    std::vector<uint8_t> scanlines;
+    uint32_t storedBlocks;
+    uint32_t fixedBlocks;
+};
+
+// Checks the structure of an encoded file down to the zlib trailer.
+void CheckPng(const std::vector<uint8_t> &file, uint32_t width, uint32_t height, EncodedPng &png) {
+    std::vector<PngChunk> chunks;
+    REQUIRE(ReadChunks(file, chunks));
+    REQUIRE(chunks.size() == 3);
+    CHECK_EQ(chunks[0].type, std::string("IHDR"));
+    CHECK_EQ(chunks[1].type, std::string("IDAT"));
+    CHECK_EQ(chunks[2].type, std::string("IEND"));
+    CHECK_EQ(chunks[2].size, 0u);
+
+    REQUIRE(chunks[0].size == 13);
+    const uint8_t *header = chunks[0].data;
+    CHECK_EQ(ReadBigEndian(header), width);
+    CHECK_EQ(ReadBigEndian(header + 4), height);
+    CHECK_EQ(header[8], uint8_t(8));
+    png.colorType = header[9];
+    CHECK_EQ(header[12], uint8_t(0));  // Not interlaced.
+
+    const PngChunk &idat = chunks[1];
+    REQUIRE(idat.size >= 6);
+    CHECK_EQ((uint32_t(idat.data[0]) << 8 | idat.data[1]) % 31, 0u);
+    CHECK_EQ(idat.data[0] & 0x0F, 8);   // Deflate.
+    CHECK_EQ(idat.data[1] & 0x20, 0);   // No preset dictionary.
+
+    FixedInflater inflater(idat.data + 2, idat.size - 6);
+    png.scanlines.clear();
+    REQUIRE(inflater.Inflate(png.scanlines));
+    CHECK_EQ(inflater.GetPosition(), size_t(idat.size - 6));
+    uint32_t channels = png.colorType == 6 ? 4 : 3;
+    REQUIRE(png.scanlines.size() == (size_t(width) * channels + 1) * height);
+    for (uint32_t y = 0; y < height; y++) {
+        REQUIRE(png.scanlines[(size_t(width) * channels + 1) * y] <= 4);  // Filter type.
+    }
+    CHECK_EQ(ReadBigEndian(idat.data + idat.size - 4), GetReferenceAdler32(png.scanlines));
+    png.storedBlocks = inflater.storedBlocks;
+    png.fixedBlocks = inflater.fixedBlocks;
+}
+
+} // namespace
+
+// Images written by EncodePng are valid PNG files, checksums included, and decode to the
+// pixels they were encoded from.
+TEST(ImageEncoderPngRoundTrip) {
+    struct Case {
+        uint32_t width, height;
+        bool opaque, noise;
+        ChannelOrder order;
+    };
+    const Case cases[] = {
+        { 1, 1, true, false, ChannelOrder::Rgba },
+        { 37, 19, true, false, ChannelOrder::Bgra },
+        { 64, 48, false, false, ChannelOrder::Rgba },
+        { 200, 120, false, true, ChannelOrder::Bgra },   // Over 64 KiB of noise: several stored blocks.
+        { 17, 300, true, true, ChannelOrder::Rgba },
+    };
+
+    uint64_t seed = 46;
+    for (const Case &test : cases) {
+        size_t rowPitch = size_t(test.width) * 4 + 12;
+        std::vector<uint8_t> pixels = MakeImage(test.width, test.height, rowPitch, test.opaque, test.noise, seed++);
+        std::vector<uint8_t> file;
+        EncodePng({ pixels.data(), test.width, test.height, rowPitch, test.order }, file);
+
+        EncodedPng png;
+        CheckPng(file, test.width, test.height, png);
+        CHECK_EQ(png.colorType, uint8_t(test.opaque ? 2 : 6));
+        if (test.noise) {
+            CHECK(png.storedBlocks >= 1);
+        } else {
+            CHECK_EQ(png.fixedBlocks, 1u);
+        }
+        CHECK(test.width * test.height < 64 || file.size() < pixels.size() + 1024);
+
+        ImageDecoder decoder;
+        REQUIRE(decoder.OpenMemory(file.data(), file.size()));
+        CHECK_EQ(decoder.GetInfo().width, test.width);
+        CHECK_EQ(decoder.GetInfo().height, test.height);
+        CHECK_EQ(decoder.GetInfo().channels, test.opaque ? 3u : 4u);
+        std::vector<uint8_t> decoded(size_t(test.width) * test.height * 4);
+        REQUIRE(decoder.Decode(decoded.data(), size_t(test.width) * 4));
+
+        uint32_t red = test.order == ChannelOrder::Bgra ? 2 : 0;
+        uint32_t mismatches = 0;
+        for (uint32_t y = 0; y < test.height; y++) {
+            for (uint32_t x = 0; x < test.width; x++) {
+                const uint8_t *source = &pixels[rowPitch * y + x * 4];
+                const uint8_t *result = &decoded[(size_t(test.width) * y + x) * 4];
+                mismatches += result[0] != source[red] || result[1] != source[1] || result[2] != source[2 - red] ||
+                              result[3] != source[3];
+            }
+        }
+        CHECK_EQ(mismatches, 0u);
+    }
+}
+
+// A corrupted byte is caught by the chunk CRC, and the raw format is the rows unpadded.
+TEST(ImageEncoderChecksumsAndRaw) {
+    std::vector<uint8_t> pixels = MakeImage(16, 16, 16 * 4 + 4, false, false, 461);
+    ImageView image = { pixels.data(), 16, 16, 16 * 4 + 4, ChannelOrder::Bgra };
+    std::vector<uint8_t> file;
+    EncodePng(image, file);
+    std::vector<PngChunk> chunks;
+    REQUIRE(ReadChunks(file, chunks));
+
+    // The scanline checksum was verified above; the known values of "123456789" pin the
+    // reference implementations themselves.
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    CHECK_EQ(GetReferenceCrc32(check, 9), 0xCBF43926u);
+    CHECK_EQ(GetReferenceAdler32(std::vector<uint8_t>(check, check + 9)), 0x091E01DEu);
+
+    file[8 + 8 + 13 + 4 + 8 + 3] ^= 0x10;  // Inside the IDAT data.
+    chunks.clear();
+    CHECK(!ReadChunks(file, chunks));
+
+    std::vector<uint8_t> raw;
+    EncodeRaw(image, raw);
+    REQUIRE(raw.size() == 16 * 16 * 4);
+    for (uint32_t y = 0; y < 16; y++) {
+        const uint8_t *source = &pixels[(16 * 4 + 4) * y];
+        CHECK_EQ(raw[16 * 4 * y + 0], source[2]);
+        CHECK_EQ(raw[16 * 4 * y + 2], source[0]);
+        CHECK_EQ(raw[16 * 4 * y + 3], source[3]);
+    }
+}
@@ -0,0 +1,117 @@
+#include "BatchMath.h"
+#include "IndirectDrawLayout.h"
+#include "Test.h"
+
+#include <cstddef>
+
+// The command signature reads one root constant and then D3D12_DRAW_INDEXED_ARGUMENTS,
+// five 32-bit fields; IndirectDraw.h checks the same against the D3D12 headers.
+TEST(IndirectDrawRecordLayout) {
+    CHECK_EQ(sizeof(IndirectDrawRecord), size_t(24));
+    CHECK_EQ(offsetof(IndirectDrawRecord, objectId), size_t(0));
+    CHECK_EQ(offsetof(IndirectDrawRecord, indexCountPerInstance), size_t(4));
+    CHECK_EQ(offsetof(IndirectDrawRecord, instanceCount), size_t(8));
+    CHECK_EQ(offsetof(IndirectDrawRecord, startIndexLocation), size_t(12));
+    CHECK_EQ(offsetof(IndirectDrawRecord, baseVertexLocation), size_t(16));
+    CHECK_EQ(offsetof(IndirectDrawRecord, startInstanceLocation), size_t(20));
+}
+
+TEST(IndirectDrawLayoutPlacesBuckets) {
+    IndirectDrawLayout layout;
+    layout.Reset(100, 4);
+
+    uint32_t first = 0;
+    CHECK(!layout.AddCommands(1, first)); // No bucket open.
+
+    REQUIRE(layout.BeginBucket());
+    REQUIRE(layout.AddCommands(10, first));
+    CHECK_EQ(first, 0u);
+    REQUIRE(layout.AddCommands(5, first));
+    CHECK_EQ(first, 10u);
+    CHECK(layout.EndBucket());
+    CHECK(!layout.EndBucket());
+    CHECK(!layout.AddCommands(1, first)); // Closed.
+
+    // Empty buckets keep their slot in the count buffer.
+    REQUIRE(layout.BeginBucket());
+    CHECK(layout.EndBucket());
+
+    REQUIRE(layout.BeginBucket());
+    REQUIRE(layout.AddCommands(7, first));
+    CHECK_EQ(first, 15u);
+    CHECK(layout.EndBucket());
+
+    const std::vector<IndirectBucket> &buckets = layout.GetBuckets();
+    REQUIRE(buckets.size() == 3);
+    CHECK_EQ(buckets[0].firstCommand, 0u);
+    CHECK_EQ(buckets[0].commandCount, 15u);
+    CHECK_EQ(buckets[1].firstCommand, 15u);
+    CHECK_EQ(buckets[1].commandCount, 0u);
+    CHECK_EQ(buckets[2].firstCommand, 15u);
+    CHECK_EQ(buckets[2].commandCount, 7u);
+    CHECK_EQ(layout.GetCommandCount(), 22u);
+    CHECK(!layout.HasOverflowed());
+
+    layout.Clear();
+    CHECK(layout.GetBuckets().empty());
+    CHECK_EQ(layout.GetCommandCount(), 0u);
+}
+
+TEST(IndirectDrawLayoutStopsAtMaxBuckets) {
+    IndirectDrawLayout layout;
+    layout.Reset(1000, 16);
+
+    uint32_t first;
+    for (int i = 0; i < 16; i++) {
+        REQUIRE(layout.BeginBucket());
+        REQUIRE(layout.AddCommands(2, first));
+        layout.EndBucket();
+    }
+
+    // The 17th bucket fails and nothing after it is recorded, even with commands to spare.
+    CHECK(!layout.BeginBucket());
+    CHECK(layout.HasOverflowed());
+    CHECK(!layout.IsBucketOpen());
+    CHECK(!layout.AddCommands(1, first));
+    CHECK(!layout.EndBucket());
+    CHECK(!layout.BeginBucket());
+    CHECK_EQ(layout.GetBuckets().size(), size_t(16));
+    CHECK_EQ(layout.GetCommandCount(), 32u);
+
+    // The next frame starts over.
+    layout.Clear();
+    CHECK(!layout.HasOverflowed());
+    CHECK(layout.BeginBucket());
+}
+
+TEST(IndirectDrawLayoutStopsAtMaxCommands) {
+    IndirectDrawLayout layout;
+    layout.Reset(10, 4);
+
+    uint32_t first;
+    REQUIRE(layout.BeginBucket());
+    REQUIRE(layout.AddCommands(6, first));
+    CHECK(!layout.AddCommands(5, first));
+    CHECK(layout.HasOverflowed());
+
+    // A smaller run would fit, but recording has stopped; the bucket keeps what it had.
+    CHECK(!layout.AddCommands(4, first));
+    CHECK(layout.EndBucket());
+    CHECK(!layout.BeginBucket());
+    REQUIRE(layout.GetBuckets().size() == 1);
+    CHECK_EQ(layout.GetBuckets()[0].commandCount, 6u);
+    CHECK_EQ(layout.GetCommandCount(), 6u);
+}
+
+TEST(IndirectDrawLayoutFillsExactly) {
+    IndirectDrawLayout layout;
+    layout.Reset(8, 1);
+
+    uint32_t first;
+    REQUIRE(layout.BeginBucket());
+    REQUIRE(layout.AddCommands(8, first));
+    REQUIRE(layout.AddCommands(0, first));
+    CHECK_EQ(first, 8u);
+    CHECK(!layout.HasOverflowed());
+    CHECK(layout.EndBucket());
+}
@@ -0,0 +1,240 @@
+#include "Log.h"
+#include "Test.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A string of the longest length that is copied whole.
+const std::string LongText(MaxLogStringLength, 'x');
+
+// Starts logging to a new file in the test directory. Records that other tests left in
+// the rings are drained to no sink first, so the file only gets the caller's.
+std::string StartTestLog(const char *name) {
+    REQUIRE(StartLog(nullptr, 0));
+    StopLog();
+    std::string path = GetTestDirectory() + "/" + name;
+    REQUIRE(StartLog(path.c_str(), LogSinkFile));
+    return path;
+}
+
+// Reads back the messages of a log file, without the time, level, location and thread.
+std::vector<std::string> ReadMessages(const std::string &path) {
+    std::vector<std::string> messages;
+    FILE *file = fopen(path.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        std::string text = line;
+        size_t start = text.find(": ");
+        REQUIRE(start != std::string::npos && text.back() == '\n');
+        messages.push_back(text.substr(start + 2, text.size() - start - 3));
+    }
+    fclose(file);
+    return messages;
+}
+
+template <typename... Args>
+constexpr bool IsValid(const char *format, const Args &...args) {
+    return IsLogFormatValid(format, decltype(GetLogArgKinds(args...))());
+}
+
+} // namespace
+
+// Conversions must match the kinds of the arguments one for one; flags, width and
+// precision are allowed, length modifiers are not.
+TEST(LogChecksFormats) {
+    static_assert(IsValid("plain"), "");
+    static_assert(IsValid("%d %s %f %p", 1, "text", 1.0, (void *) nullptr), "");
+    static_assert(!IsValid("%d", "text"), "");
+
+    const char *text = "text";
+    char buffer[4] = "abc";
+    int value = 0;
+    CHECK(IsValid("100%% done"));
+    CHECK(IsValid("%d %i %u %x %X %H", 1, 2u, (short) 3, (uint8_t) 4, (int64_t) 5, (long) 6));
+    CHECK(IsValid("%f %e %g", 1.0, 2.0f, 3.0));
+    CHECK(IsValid("%s %s", text, buffer));
+    CHECK(IsValid("%p %p", &value, (const void *) text));
+    CHECK(IsValid("%-08.3f|%+5d|% x|%#X|%.2s", 1.0, 2, 3u, 4, text));
+    CHECK(IsValid("%u", true));
+
+    CHECK(!IsValid("%d"));
+    CHECK(!IsValid("%d", 1, 2));
+    CHECK(!IsValid("no conversion", 1));
+    CHECK(!IsValid("%s", 1));
+    CHECK(!IsValid("%d", 1.0));
+    CHECK(!IsValid("%f", 1));
+    CHECK(!IsValid("%p", text));    // Strings are copied, not printed as addresses.
+    CHECK(!IsValid("%s", &value));
+    CHECK(!IsValid("%ld", 1L));     // The argument type decides the size.
+    CHECK(!IsValid("%lld", (int64_t) 1));
+    CHECK(!IsValid("%c", 'c'));
+    CHECK(!IsValid("%n", &value));
+    CHECK(!IsValid("%5", 1));       // Ends inside the conversion.
+    CHECK(!IsValid("%", 1));
+}
+
+TEST(LogNamesHresults) {
+    CHECK_EQ(std::string(GetHresultName(0)), std::string("S_OK"));
+    CHECK_EQ(std::string(GetHresultName((int32_t) 0x80004005)), std::string("E_FAIL"));
+    CHECK_EQ(std::string(GetHresultName((int32_t) 0x887A0005)), std::string("DXGI_ERROR_DEVICE_REMOVED"));
+    CHECK_EQ(std::string(GetHresultName((int32_t) 0x887E0002)), std::string("D3D12_ERROR_DRIVER_VERSION_MISMATCH"));
+    CHECK(GetHresultName((int32_t) 0x80004006) == nullptr);
+    CHECK(GetHresultName(2) == nullptr);
+
+    std::string path = StartTestLog("hresult.log");
+    LogError("%H", (int32_t) 0x80070057);
+    LogError("%H", (uint32_t) 0x8007000E);
+    LogError("%H", (int32_t) 0x12345678);
+    LogError("%H", 0);
+    // Widths and flags do not apply to %H.
+    LogError("[%12H]", (int32_t) 0x80004005);
+    StopLog();
+
+    std::vector<std::string> expected = {
+        "0x80070057 (E_INVALIDARG)",
+        "0x8007000E (E_OUTOFMEMORY)",
+        "0x12345678",
+        "0x00000000 (S_OK)",
+        "[0x80004005 (E_FAIL)]",
+    };
+    CHECK(ReadMessages(path) == expected);
+}
+
+// Arguments are formatted as printf would format them at the type they were logged with.
+TEST(LogFormatsArguments) {
+    std::string path = StartTestLog("arguments.log");
+    LogInfo("%u %d %x", -1, 4294967295u, (short) -1);
+    LogInfo("%d %u %u %d", (signed char) -1, (signed char) -1, (uint8_t) 255, (uint16_t) 65535);
+    LogInfo("%d %u %x", (int64_t) -5, (uint64_t) -5, (uint64_t) 1 << 40);
+    LogInfo("%5d|%-5d|%05u|%+d|%#x", 42, 42, 42u, 42, 255);
+    LogInfo("%.2f %e %g", 3.14159, 1.5f, 0.25);
+    LogInfo("%s|%s|%s", "text", (const char *) nullptr, LongText.c_str());
+    std::string tooLong = LongText + "yz";
+    LogInfo("%s", tooLong.c_str());
+    LogInfo("%p", (const void *) (uintptr_t) 0xABCD);
+    StopLog();
+
+    std::vector<std::string> expected = {
+        "4294967295 -1 ffffffff",
+        "-1 4294967295 255 65535",
+        "-5 18446744073709551611 10000000000",
+        "   42|42   |00042|+42|0xff",
+        "3.14 1.500000e+00 0.25",
+        "text||" + LongText,
+        LongText,
+        "0x000000000000ABCD",
+    };
+    CHECK(ReadMessages(path) == expected);
+}
+
+// Records of every size, flushed often enough that none are dropped, wrap around the ring
+// many times and come out whole and in order.
+TEST(LogWrapsAroundTheRing) {
+    std::string path = StartTestLog("wrap.log");
+    uint64_t dropped = GetDroppedLogCount();
+
+    // Each batch fills at most half the ring. Records average about 160 bytes, so the ring
+    // wraps around about ten times.
+    const uint32_t maxRecordSize = 64 + MaxLogStringLength;
+    const uint32_t batchCount = 40;
+    const uint32_t batchSize = uint32_t(LogRingSize / 2 / maxRecordSize);
+    std::vector<std::string> expected;
+    for (uint32_t batch = 0; batch < batchCount; batch++) {
+        for (uint32_t i = 0; i < batchSize; i++) {
+            uint32_t record = batch * batchSize + i;
+            std::string text = LongText.substr(0, (record * 37) % (MaxLogStringLength + 1));
+            LogInfo("%u %s", record, text.c_str());
+            expected.push_back(std::to_string(record) + " " + text);
+        }
+        FlushLog();
+    }
+    StopLog();
+
+    CHECK_EQ(GetDroppedLogCount() - dropped, uint64_t(0));
+    std::vector<std::string> messages = ReadMessages(path);
+    CHECK_EQ(messages.size(), expected.size());
+    CHECK(messages == expected);
+}
+
+// Without a drain, a full ring drops the records that do not fit and counts them; the
+// ones before stay intact.
+TEST(LogCountsDroppedRecords) {
+    // Stopping leaves no drain thread and no file, so records stay in the ring.
+    std::string path = StartTestLog("dropped.log");
+    LogInfo("first");
+    StopLog();
+
+    uint64_t dropped = GetDroppedLogCount();
+    const uint32_t recordCount = uint32_t(2 * LogRingSize / MaxLogStringLength);
+    for (uint32_t i = 0; i < recordCount; i++) {
+        LogInfo("%u %s", i, LongText.c_str());
+    }
+    uint64_t droppedNow = GetDroppedLogCount() - dropped;
+
+    // Starting again drains what the ring kept into the new file.
+    REQUIRE(StartLog(path.c_str(), LogSinkFile));
+    StopLog();
+    std::vector<std::string> messages = ReadMessages(path);
+    CHECK(droppedNow > 0);
+    CHECK(messages.size() > LogRingSize / 2 / MaxLogStringLength);
+    CHECK_EQ(messages.size() + droppedNow, uint64_t(recordCount));
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (messages[i] != std::to_string(i) + " " + LongText) {
+            CHECK_EQ(messages[i], std::to_string(i) + " " + LongText);
+            break;
+        }
+    }
+
+    // Once drained, the ring takes records again.
+    REQUIRE(StartLog(path.c_str(), LogSinkFile));
+    LogInfo("after");
+    StopLog();
+    CHECK_EQ(GetDroppedLogCount() - dropped, droppedNow);
+    std::vector<std::string> expected = { "after" };
+    CHECK(ReadMessages(path) == expected);
+}
+
+// Every thread logs into its own ring, so threads logging at once lose nothing, and each
+// thread's records come out in the order it logged them.
+TEST(LogOrdersRecordsOfManyThreads) {
+    std::string path = StartTestLog("threads.log");
+    uint64_t dropped = GetDroppedLogCount();
+
+    const uint32_t threadCount = 4;
+    const uint32_t recordCount = 1000;
+    std::atomic<uint32_t> ready { 0 };
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < threadCount; thread++) {
+        threads.emplace_back([&, thread]() {
+            ready++;
+            while (ready < threadCount) {
+                std::this_thread::yield();
+            }
+            for (uint32_t i = 0; i < recordCount; i++) {
+                LogInfo("%u %u", thread, i);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    StopLog();
+
+    CHECK_EQ(GetDroppedLogCount() - dropped, uint64_t(0));
+    std::vector<std::string> messages = ReadMessages(path);
+    REQUIRE(messages.size() == threadCount * recordCount);
+    std::vector<uint32_t> next(threadCount, 0);
+    uint32_t misordered = 0;
+    for (const std::string &message : messages) {
+        uint32_t thread, record;
+        REQUIRE(sscanf(message.c_str(), "%u %u", &thread, &record) == 2 && thread < threadCount);
+        misordered += record != next[thread]++;
+    }
+    CHECK_EQ(misordered, 0u);
+}
@@ -0,0 +1,239 @@
+#include "MeshLoader.h"
+#include "Test.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string WriteFile(const char *name, const std::vector<uint8_t> &contents) {
+    std::string path = GetTestDirectory() + "/" + name;
+    FILE *file = fopen(path.c_str(), "wb");
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+    return path;
+}
+
+std::string WriteFile(const char *name, const std::string &contents) {
+    return WriteFile(name, std::vector<uint8_t>(contents.begin(), contents.end()));
+}
+
+void AppendU32(std::vector<uint8_t> &data, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        data.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+// A .glb file of one JSON chunk and one BIN chunk.
+std::vector<uint8_t> MakeGlb(std::string json, std::vector<uint8_t> bin) {
+    json.resize((json.size() + 3) & ~size_t(3), ' ');
+    bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+    std::vector<uint8_t> data;
+    AppendU32(data, 0x46546C67);
+    AppendU32(data, 2);
+    AppendU32(data, uint32_t(12 + 8 + json.size() + 8 + bin.size()));
+    AppendU32(data, uint32_t(json.size()));
+    AppendU32(data, 0x4E4F534A);
+    data.insert(data.end(), json.begin(), json.end());
+    AppendU32(data, uint32_t(bin.size()));
+    AppendU32(data, 0x004E4942);
+    data.insert(data.end(), bin.begin(), bin.end());
+    return data;
+}
+
+const float TrianglePositions[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+const uint16_t TriangleIndices[] = { 0, 2, 1, 0 };
+
+// A triangle with positions at 0, uvs at 36 and 16-bit indices after the uvs. uvAccessor,
+// indexAccessor and uvView are spliced into the JSON so tests can make them invalid.
+std::vector<uint8_t> MakeTriangleGlb(const std::string &uvAccessor, const void *uvs, size_t uvSize,
+                                     const std::string &indexAccessor = "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3",
+                                     const std::string &uvView = "") {
+    std::vector<uint8_t> bin((const uint8_t *) TrianglePositions, (const uint8_t *) TrianglePositions + sizeof(TrianglePositions));
+    bin.insert(bin.end(), (const uint8_t *) uvs, (const uint8_t *) uvs + uvSize);
+    bin.resize((bin.size() + 3) & ~size_t(3), 0);
+    size_t indexOffset = bin.size();
+    bin.insert(bin.end(), (const uint8_t *) TriangleIndices, (const uint8_t *) TriangleIndices + sizeof(TriangleIndices));
+
+    std::string json =
+        "{\"asset\": {\"version\": \"2.0\"},"
+        " \"buffers\": [{\"byteLength\": " + std::to_string(bin.size()) + "}],"
+        " \"bufferViews\": ["
+        "{\"buffer\": 0, \"byteOffset\": 0, \"byteLength\": 36},"
+        "{\"buffer\": 0, \"byteOffset\": 36, \"byteLength\": " + std::to_string(uvSize) + uvView + "},"
+        "{\"buffer\": 0, \"byteOffset\": " + std::to_string(indexOffset) + ", \"byteLength\": 8}],"
+        " \"accessors\": ["
+        "{\"bufferView\": 0, \"componentType\": 5126, \"count\": 3, \"type\": \"VEC3\"},"
+        "{\"bufferView\": 1, " + uvAccessor + ", \"count\": 3, \"type\": \"VEC2\"},"
+        "{" + indexAccessor + ", \"type\": \"SCALAR\"}],"
+        " \"meshes\": [{\"primitives\": [{\"attributes\": {\"POSITION\": 0, \"TEXCOORD_0\": 1}, \"indices\": 2}]}]}";
+    return MakeGlb(json, bin);
+}
+
+const float FloatUvs[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f };
+const uint8_t ByteUvs[] = { 0, 0, 255, 0, 0, 255, 0, 0 };
+
+bool OpenGlb(const std::vector<uint8_t> &contents) {
+    MeshFile mesh;
+    return mesh.Open(WriteFile("mesh.glb", contents).c_str());
+}
+
+} // namespace
+
+TEST(MeshLoaderParsesObj) {
+    std::string path = WriteFile("quad.obj",
+        "# quad\n"
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "f 1/1 2/2 3/3 4/4\n");
+
+    MeshFile mesh;
+    REQUIRE(mesh.Open(path.c_str()));
+    CHECK_EQ(mesh.GetIndexCount(), 6u);
+    std::vector<MeshVertex> vertices(mesh.GetVertexCount());
+    std::vector<uint32_t> indices(mesh.GetIndexCount());
+    REQUIRE(mesh.Parse(vertices.data(), indices.data()));
+
+    for (uint32_t index : indices) {
+        REQUIRE(index < vertices.size());
+    }
+    // The corner of the second triangle that is not on the shared edge.
+    const MeshVertex &corner = vertices[indices[4]];
+    CHECK_EQ(corner.position[0], 1.0f);
+    CHECK_EQ(corner.position[1], 1.0f);
+    // OBJ has v up; texture coordinates are flipped to the top-left origin of D3D.
+    CHECK_EQ(corner.uv[0], 1.0f);
+    CHECK_EQ(corner.uv[1], 0.0f);
+}
+
+TEST(MeshLoaderParsesGlb) {
+    std::string path = WriteFile("triangle.glb", MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs)));
+
+    MeshFile mesh;
+    REQUIRE(mesh.Open(path.c_str()));
+    REQUIRE(mesh.GetVertexCount() == 3);
+    REQUIRE(mesh.GetIndexCount() == 3);
+    MeshVertex vertices[3];
+    uint32_t indices[3];
+    REQUIRE(mesh.Parse(vertices, indices));
+
+    CHECK_EQ(indices[0], 0u);
+    CHECK_EQ(indices[1], 2u);
+    CHECK_EQ(indices[2], 1u);
+    CHECK_EQ(vertices[2].position[1], 1.0f);
+    CHECK_EQ(vertices[1].uv[0], 1.0f);
+    CHECK_EQ(vertices[2].uv[1], 1.0f);
+}
+
+TEST(MeshLoaderReadsNormalizedUvs) {
+    std::string path = WriteFile("triangle.glb",
+        MakeTriangleGlb("\"componentType\": 5121, \"normalized\": true", ByteUvs, sizeof(ByteUvs)));
+
+    MeshFile mesh;
+    REQUIRE(mesh.Open(path.c_str()));
+    MeshVertex vertices[3];
+    uint32_t indices[3];
+    REQUIRE(mesh.Parse(vertices, indices));
+    CHECK_EQ(vertices[1].uv[0], 1.0f);
+    CHECK_EQ(vertices[1].uv[1], 0.0f);
+    CHECK_EQ(vertices[2].uv[1], 1.0f);
+}
+
+TEST(MeshLoaderRejectsUnnormalizedUvs) {
+    // glTF only allows float texture coordinates, or normalized unsigned bytes and shorts.
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5121", ByteUvs, sizeof(ByteUvs))));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5121, \"normalized\": false", ByteUvs, sizeof(ByteUvs))));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5123", ByteUvs, sizeof(ByteUvs))));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5120, \"normalized\": true", ByteUvs, sizeof(ByteUvs))));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5125, \"normalized\": true", FloatUvs, sizeof(FloatUvs))));
+}
+
+TEST(MeshLoaderRejectsInvalidNumbers) {
+    const char *valid = "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3, \"byteOffset\": 0";
+    REQUIRE(OpenGlb(MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs), valid)));
+
+    // Negative, fractional and out-of-range indices, counts and offsets.
+    const char *invalid[] = {
+        "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3, \"byteOffset\": -2",
+        "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3, \"byteOffset\": 0.5",
+        "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3, \"byteOffset\": 1e300",
+        "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3, \"byteOffset\": -1e300",
+        "\"bufferView\": -1, \"componentType\": 5123, \"count\": 3",
+        "\"bufferView\": 1.5, \"componentType\": 5123, \"count\": 3",
+        "\"bufferView\": 2, \"componentType\": 5123, \"count\": -3",
+        "\"bufferView\": 2, \"componentType\": 4294972419, \"count\": 3",
+    };
+    for (const char *accessor : invalid) {
+        CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs), accessor)));
+    }
+
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126, \"byteOffset\": -8", FloatUvs, sizeof(FloatUvs))));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126.5", FloatUvs, sizeof(FloatUvs))));
+}
+
+TEST(MeshLoaderRejectsInvalidObjNumbers) {
+    std::string path = WriteFile("invalid.obj", "v 0 0 0\nv 1 0 x\nv 0 1 0\nf 1 2 3\n");
+
+    MeshFile mesh;
+    REQUIRE(mesh.Open(path.c_str()));
+    std::vector<MeshVertex> vertices(mesh.GetVertexCount());
+    std::vector<uint32_t> indices(mesh.GetIndexCount());
+    CHECK(!mesh.Parse(vertices.data(), indices.data()));
+}
+
+// Vertex buffer views may interleave attributes with byteStride; 0 means tightly packed.
+TEST(MeshLoaderReadsByteStrides) {
+    const char *index = "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3";
+    const float interleavedUvs[] = { 0.0f, 0.0f, 9.0f, 9.0f, 1.0f, 0.0f, 9.0f, 9.0f, 0.0f, 1.0f };
+    const std::vector<uint8_t> files[] = {
+        MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs), index, ", \"byteStride\": 0"),
+        MakeTriangleGlb("\"componentType\": 5126", interleavedUvs, sizeof(interleavedUvs), index, ", \"byteStride\": 16"),
+    };
+    for (const std::vector<uint8_t> &file : files) {
+        MeshFile mesh;
+        REQUIRE(mesh.Open(WriteFile("strided.glb", file).c_str()));
+        MeshVertex vertices[3];
+        uint32_t indices[3];
+        REQUIRE(mesh.Parse(vertices, indices));
+        CHECK_EQ(vertices[1].uv[0], 1.0f);
+        CHECK_EQ(vertices[1].uv[1], 0.0f);
+        CHECK_EQ(vertices[2].uv[1], 1.0f);
+    }
+
+    // Shorter than an element, so elements would overlap.
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs), index, ", \"byteStride\": 4")));
+    // The last element ends past the view.
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs), index, ", \"byteStride\": 12")));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs), index, ", \"byteStride\": -8")));
+}
+
+TEST(MeshLoaderRejectsMalformedGlb) {
+    std::vector<uint8_t> valid = MakeTriangleGlb("\"componentType\": 5126", FloatUvs, sizeof(FloatUvs));
+    REQUIRE(OpenGlb(valid));
+
+    // An accessor whose offset plus stride times count wraps around 2^64 to a small value.
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126, \"count\": 4294967295, \"byteOffset\": 12884901886",
+                                   FloatUvs, sizeof(FloatUvs), "\"bufferView\": 2, \"componentType\": 5123, \"count\": 3",
+                                   ", \"byteStride\": 4294967295")));
+    // An accessor that starts inside its view and ends past it.
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126, \"byteOffset\": 8", FloatUvs, sizeof(FloatUvs))));
+    CHECK(!OpenGlb(MakeTriangleGlb("\"componentType\": 5126, \"byteOffset\": 9007199254740992", FloatUvs, sizeof(FloatUvs))));
+
+    // Truncated files, another version, and a chunk longer than the file.
+    CHECK(!OpenGlb(std::vector<uint8_t>(valid.begin(), valid.begin() + valid.size() / 2)));
+    CHECK(!OpenGlb(std::vector<uint8_t>(valid.begin(), valid.begin() + 12)));
+    std::vector<uint8_t> damaged = valid;
+    damaged[4] = 1;
+    CHECK(!OpenGlb(damaged));
+    damaged = valid;
+    damaged[12 + 3] = 0x7F;
+    CHECK(!OpenGlb(damaged));
+
+    // JSON that is cut short, or lacks what a mesh needs.
+    CHECK(!OpenGlb(MakeGlb("{\"accessors\": [", { })));
+    CHECK(!OpenGlb(MakeGlb("{}", { })));
+    CHECK(!OpenGlb(MakeGlb("{\"accessors\": [], \"bufferViews\": [], \"meshes\": [{}]}", { })));
+    CHECK(!OpenGlb(MakeGlb("{\"accessors\": [], \"bufferViews\": [], \"meshes\": [{\"primitives\": [{\"attributes\": {\"POSITION\": 0}}]}]}", { })));
+}
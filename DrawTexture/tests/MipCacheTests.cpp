@@ -0,0 +1,148 @@
+#include "MipCache.h"
+#include "MipStreaming.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t ImageWidth = 37;
+const uint32_t ImageHeight = 10;
+
+struct Image {
+    std::vector<uint8_t> pixels;
+    size_t rowPitch;
+};
+
+// Random pixels in rows padded like a texture footprint.
+Image MakeImage(TestRandom &random, PixelFormat format) {
+    Image image;
+    image.rowPitch = size_t(ImageWidth) * GetPixelSize(format) + 12;
+    image.pixels.resize(image.rowPitch * ImageHeight);
+    for (uint8_t &byte : image.pixels) {
+        byte = uint8_t(random.Next() >> 56);
+    }
+    if (format == PixelFormat::R16G16B16A16Float) {
+        // Finite halves only; NaNs would not compare equal.
+        for (size_t i = 1; i < image.pixels.size(); i += 2) {
+            image.pixels[i] &= 0x3B;
+        }
+    }
+    return image;
+}
+
+std::vector<uint8_t> ReadFile(const std::string &path) {
+    std::vector<uint8_t> data;
+    FILE *file = fopen(path.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        data.push_back(uint8_t(c));
+    }
+    fclose(file);
+    return data;
+}
+
+void WriteFile(const std::string &path, const std::vector<uint8_t> &data) {
+    FILE *file = fopen(path.c_str(), "wb");
+    REQUIRE(file != nullptr);
+    REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+}
+
+} // namespace
+
+// Every level read back is the one DownsamplePixels() makes from the level before, in
+// rows of any pitch, and the padding between them is not written.
+TEST(MipCacheReadsEveryLevel) {
+    TestRandom random(36);
+    const MipCacheSource source = { 1234, 0x0123456789ABCDEFull };
+    for (PixelFormat format : { PixelFormat::L8, PixelFormat::R8G8B8A8, PixelFormat::R16G16B16A16Float }) {
+        std::string path = GetTestDirectory() + "/levels.mips";
+        Image image = MakeImage(random, format);
+        REQUIRE(BuildMipCache(path.c_str(), source, image.pixels.data(), image.rowPitch, format, ImageWidth, ImageHeight));
+
+        MipCache cache;
+        REQUIRE(cache.Open(path.c_str(), source, format, ImageWidth, ImageHeight));
+        REQUIRE(cache.GetMipCount() == GetMipCount(ImageWidth, ImageHeight));
+
+        uint32_t pixelSize = GetPixelSize(format);
+        std::vector<uint8_t> expected(image.pixels);
+        size_t expectedPitch = image.rowPitch;
+        for (uint32_t mip = 0; mip < cache.GetMipCount(); mip++) {
+            uint32_t width = (std::max)(ImageWidth >> mip, 1u);
+            uint32_t height = (std::max)(ImageHeight >> mip, 1u);
+            size_t rowBytes = size_t(width) * pixelSize;
+            size_t rowPitch = rowBytes + 8;
+            std::vector<uint8_t> level(rowPitch * height, 0xCD);
+            REQUIRE(cache.ReadMip(mip, level.data(), rowPitch));
+
+            uint32_t wrongBytes = 0;
+            for (uint32_t y = 0; y < height; y++) {
+                for (size_t x = 0; x < rowPitch; x++) {
+                    uint8_t want = x < rowBytes ? expected[y * expectedPitch + x] : 0xCD;
+                    wrongBytes += level[y * rowPitch + x] != want;
+                }
+            }
+            CHECK_EQ(wrongBytes, 0u);
+
+            std::vector<uint8_t> next(size_t((std::max)(width / 2, 1u)) * (std::max)(height / 2, 1u) * pixelSize);
+            REQUIRE(DownsamplePixels(expected.data(), expectedPitch, next.data(), size_t((std::max)(width / 2, 1u)) * pixelSize,
+                                     format, width, height));
+            expected.swap(next);
+            expectedPitch = size_t((std::max)(width / 2, 1u)) * pixelSize;
+        }
+
+        std::vector<uint8_t> unused(4);
+        CHECK(!cache.ReadMip(cache.GetMipCount(), unused.data(), 4));
+    }
+}
+
+// A cache of another image, format or size, or a damaged file, is not used.
+TEST(MipCacheRejectsStaleFiles) {
+    TestRandom random(37);
+    const MipCacheSource source = GetMipCacheSource("source image", 12);
+    CHECK(source.size == 12);
+    CHECK(source.hash != GetMipCacheSource("source imagf", 12).hash);
+
+    std::string path = GetTestDirectory() + "/stale.mips";
+    Image image = MakeImage(random, PixelFormat::R8G8B8A8);
+    REQUIRE(BuildMipCache(path.c_str(), source, image.pixels.data(), image.rowPitch, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+
+    MipCache cache;
+    CHECK(cache.Open(path.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    CHECK(!cache.Open(path.c_str(), { source.size + 1, source.hash }, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    CHECK(!cache.Open(path.c_str(), { source.size, source.hash + 1 }, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    CHECK(!cache.Open(path.c_str(), source, PixelFormat::B8G8R8A8, ImageWidth, ImageHeight));
+    CHECK(!cache.Open(path.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth + 1, ImageHeight));
+    CHECK(!cache.Open(path.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight - 1));
+    CHECK_EQ(cache.GetMipCount(), 0u);
+    CHECK(!cache.Open((GetTestDirectory() + "/missing.mips").c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+
+    std::vector<uint8_t> file = ReadFile(path);
+    std::string damagedPath = GetTestDirectory() + "/damaged.mips";
+    std::vector<uint8_t> damaged(file.begin(), file.end() - 1);  // Truncated.
+    WriteFile(damagedPath, damaged);
+    CHECK(!cache.Open(damagedPath.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    damaged = file;
+    damaged.push_back(0);                                          // Longer.
+    WriteFile(damagedPath, damaged);
+    CHECK(!cache.Open(damagedPath.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    damaged = file;
+    damaged[0] ^= 1;                                               // Magic.
+    WriteFile(damagedPath, damaged);
+    CHECK(!cache.Open(damagedPath.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    damaged = file;
+    damaged[4] ^= 1;                                               // Version.
+    WriteFile(damagedPath, damaged);
+    CHECK(!cache.Open(damagedPath.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+    WriteFile(damagedPath, std::vector<uint8_t>(file.begin(), file.begin() + 8));  // Shorter than the header.
+    CHECK(!cache.Open(damagedPath.c_str(), source, PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+
+    CHECK(!BuildMipCache(path.c_str(), source, image.pixels.data(), image.rowPitch, PixelFormat::Unknown, ImageWidth, ImageHeight));
+    CHECK(!BuildMipCache((GetTestDirectory() + "/no/such/directory.mips").c_str(), source, image.pixels.data(), image.rowPitch,
+                         PixelFormat::R8G8B8A8, ImageWidth, ImageHeight));
+}
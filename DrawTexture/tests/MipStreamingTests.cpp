@@ -0,0 +1,121 @@
+#include "MipStreaming.h"
+#include "Test.h"
+
+#include <vector>
+
+TEST(MipStreamingDesiredMip) {
+    CHECK_EQ(GetMipCount(1, 1), 1u);
+    CHECK_EQ(GetMipCount(1024, 256), 11u);
+    CHECK_EQ(GetMipCount(1000, 3), 10u);
+
+    // 1024 texels over 256 pixels: two levels down. Partial steps round to the finer level.
+    CHECK_EQ(GetDesiredMip(1024, 1024, 11, 256.0f, 256.0f), 2u);
+    CHECK_EQ(GetDesiredMip(1024, 1024, 11, 300.0f, 300.0f), 1u);
+    CHECK_EQ(GetDesiredMip(1024, 512, 11, 1024.0f, 64.0f), 3u); // The more minified axis.
+    CHECK_EQ(GetDesiredMip(1024, 1024, 11, 4096.0f, 4096.0f), 0u);
+    CHECK_EQ(GetDesiredMip(1024, 1024, 11, 256.0f, 256.0f, 1.0f), 3u);
+    CHECK_EQ(GetDesiredMip(1024, 1024, 11, 0.5f, 0.5f), 10u);
+    CHECK_EQ(GetDesiredMip(1024, 1024, 11, 0.0f, 100.0f), 10u); // Off screen.
+}
+
+TEST(MipStreamingPriorityOrder) {
+    MipStreamingPolicy policy;
+    StreamingHandle a = policy.Add(11, 5);
+    StreamingHandle b = policy.Add(11, 5);
+    StreamingHandle c = policy.Add(11, 3);
+    StreamingHandle d = policy.Add(11, 6);
+    policy.SetDesiredMip(a, 2, 0.1f);  // Three levels missing, small on screen.
+    policy.SetDesiredMip(b, 4, 0.9f);  // One level missing, fills the screen.
+    policy.SetDesiredMip(c, 3, 0.5f);  // Done.
+    policy.SetDesiredMip(d, 0, 0.0f);  // Not visible.
+
+    std::vector<MipRequest> requests;
+    policy.Update(2, requests);
+    REQUIRE(requests.size() == 2);
+    CHECK_EQ(requests[0].texture, b);
+    CHECK_EQ(requests[0].mip, 4u);
+    CHECK_EQ(requests[1].texture, a);
+    CHECK_EQ(requests[1].mip, 4u); // One level at a time, coarse to fine.
+    CHECK(requests[0].priority > requests[1].priority);
+    CHECK_EQ(policy.GetInFlightCount(), 2u);
+
+    // Nothing new while the budget is used up, and a texture never has two requests.
+    requests.clear();
+    policy.Update(2, requests);
+    CHECK(requests.empty());
+    policy.Update(4, requests);
+    REQUIRE(requests.size() == 1);
+    CHECK_EQ(requests[0].texture, d);
+    CHECK_EQ(requests[0].mip, 5u);
+
+    CHECK(policy.Complete(b, 4));
+    CHECK_EQ(policy.GetResidentMip(b), 4u);
+    CHECK(policy.Complete(a, 4));
+    CHECK(!policy.Complete(a, 4)); // Not requested anymore.
+    CHECK_EQ(policy.GetInFlightCount(), 1u);
+
+    requests.clear();
+    policy.Update(4, requests);
+    REQUIRE(requests.size() == 1);
+    CHECK_EQ(requests[0].texture, a);
+    CHECK_EQ(requests[0].mip, 3u);
+    CHECK_EQ(policy.GetRequestedMip(c), policy.GetMipCount(c));
+}
+
+TEST(MipStreamingDropsAndEvicts) {
+    MipStreamingPolicy policy;
+    StreamingHandle texture = policy.Add(8, 7);
+    policy.SetDesiredMip(texture, 0, 1.0f);
+
+    std::vector<MipRequest> requests;
+    for (uint32_t mip = 7; mip-- > 3;) {
+        requests.clear();
+        policy.Update(1, requests);
+        REQUIRE(requests.size() == 1);
+        CHECK_EQ(requests[0].mip, mip);
+        REQUIRE(policy.Complete(texture, mip));
+    }
+    CHECK_EQ(policy.GetResidentMip(texture), 3u);
+
+    // Level 2 is evicted while loading: the result is discarded and the texture keeps
+    // only what is still resident, then asks again.
+    requests.clear();
+    policy.Update(1, requests);
+    REQUIRE(requests.size() == 1);
+    policy.Evict(texture, 4);
+    CHECK_EQ(policy.GetResidentMip(texture), 5u);
+    CHECK(!policy.Complete(texture, 2));
+    CHECK_EQ(policy.GetInFlightCount(), 0u);
+    requests.clear();
+    policy.Update(1, requests);
+    REQUIRE(requests.size() == 1);
+    CHECK_EQ(requests[0].mip, 4u);
+
+    // A cancelled request is retried.
+    policy.Cancel(texture, 4);
+    CHECK_EQ(policy.GetInFlightCount(), 0u);
+    requests.clear();
+    policy.Update(1, requests);
+    REQUIRE(requests.size() == 1);
+    CHECK_EQ(requests[0].mip, 4u);
+    REQUIRE(policy.Complete(texture, 4));
+
+    // Needing much less drops all but one of the extra levels.
+    policy.SetDesiredMip(texture, 7, 0.0f);
+    requests.clear();
+    policy.Update(1, requests);
+    CHECK(requests.empty());
+    CHECK_EQ(policy.GetResidentMip(texture), 6u);
+    policy.SetDesiredMip(texture, 6, 0.0f);
+    policy.Update(1, requests);
+    CHECK(requests.empty());
+    CHECK_EQ(policy.GetResidentMip(texture), 6u);
+
+    // A removed texture's request does not count anymore and its handle is reused.
+    policy.SetDesiredMip(texture, 0, 1.0f);
+    policy.Update(1, requests);
+    CHECK_EQ(policy.GetInFlightCount(), 1u);
+    policy.Remove(texture);
+    CHECK_EQ(policy.GetInFlightCount(), 0u);
+    CHECK_EQ(policy.Add(4, 3), texture);
+}
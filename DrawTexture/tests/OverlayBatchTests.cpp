@@ -0,0 +1,124 @@
+#include "OverlayBatch.h"
+#include "Test.h"
+
+#include <vector>
+
+namespace {
+
+const uint32_t White = MakeOverlayColor(255, 255, 255);
+
+// Texels of a cell that are set, counted in a built atlas.
+uint32_t CountCellTexels(const std::vector<uint8_t> &atlas, uint32_t cell) {
+    uint32_t left = cell % OverlayAtlasColumns * OverlayCellSize;
+    uint32_t top = cell / OverlayAtlasColumns * OverlayCellSize;
+    uint32_t count = 0;
+    for (uint32_t y = top; y < top + OverlayCellSize; y++) {
+        for (uint32_t x = left; x < left + OverlayCellSize; x++) {
+            count += atlas[size_t(y) * OverlayAtlasWidth + x] != 0;
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+// Spaces advance without a quad, and '\n' returns to x one line further down.
+TEST(OverlayBatchLaysOutText) {
+    OverlayBatch batch;
+    float end = batch.AddText(10.0f, 20.0f, "A B\nCD", White, 2.0f);
+    REQUIRE(batch.GetQuadCount() == 4);
+    const std::vector<OverlayQuad> &quads = batch.GetQuads();
+
+    CHECK_EQ(quads[0].left, 10.0f);
+    CHECK_EQ(quads[0].top, 20.0f);
+    CHECK_EQ(quads[0].right, 10.0f + OverlayGlyphWidth * 2.0f);
+    CHECK_EQ(quads[0].bottom, 20.0f + OverlayGlyphHeight * 2.0f);
+    CHECK_EQ(quads[0].cell, GetOverlayCell('A'));
+    CHECK_EQ(quads[0].color, White);
+    CHECK_EQ(quads[1].left, 10.0f + 2.0f * OverlayAdvance * 2.0f);
+    CHECK_EQ(quads[1].cell, GetOverlayCell('B'));
+
+    CHECK_EQ(quads[2].left, 10.0f);
+    CHECK_EQ(quads[2].top, 20.0f + OverlayLineHeight * 2.0f);
+    CHECK_EQ(quads[3].left, 10.0f + OverlayAdvance * 2.0f);
+    CHECK_EQ(quads[3].top, quads[2].top);
+    CHECK_EQ(end, 10.0f + 2.0f * OverlayAdvance * 2.0f);
+
+    // Trailing spaces and empty lines add nothing but still move the pen.
+    batch.Clear();
+    CHECK_EQ(batch.AddText(0.0f, 0.0f, "  ", White), 2.0f * OverlayAdvance);
+    CHECK_EQ(batch.AddText(0.0f, 0.0f, "\n\nx", White), OverlayAdvance);
+    REQUIRE(batch.GetQuadCount() == 1);
+    CHECK_EQ(batch.GetQuads()[0].top, 2.0f * OverlayLineHeight);
+    CHECK_EQ(batch.AddText(5.0f, 0.0f, "", White), 5.0f);
+    CHECK_EQ(batch.GetQuadCount(), size_t(1));
+}
+
+// The width of the longest line, without the gap after its last glyph.
+TEST(OverlayBatchMeasuresText) {
+    CHECK_EQ(OverlayBatch::MeasureText(""), 0.0f);
+    CHECK_EQ(OverlayBatch::MeasureText("\n\n"), 0.0f);
+    CHECK_EQ(OverlayBatch::MeasureText("A"), float(OverlayGlyphWidth));
+    CHECK_EQ(OverlayBatch::MeasureText("ABC"), 3.0f * OverlayAdvance - 1.0f);
+    CHECK_EQ(OverlayBatch::MeasureText("AB\nCDEF\nG"), 4.0f * OverlayAdvance - 1.0f);
+    CHECK_EQ(OverlayBatch::MeasureText("A  "), 3.0f * OverlayAdvance - 1.0f);  // Spaces count.
+    CHECK_EQ(OverlayBatch::MeasureText("ABC", 3.0f), (3.0f * OverlayAdvance - 1.0f) * 3.0f);
+
+    // The measured width reaches the right edge of the last glyph AddText() places.
+    OverlayBatch batch;
+    batch.AddText(7.0f, 0.0f, "x\nwide", White, 2.0f);
+    CHECK_EQ(batch.GetQuads().back().right, 7.0f + OverlayBatch::MeasureText("x\nwide", 2.0f));
+}
+
+// Bars start at the oldest value of the ring and are clamped to the rectangle; values at
+// or below zero add no bar.
+TEST(OverlayBatchDrawsGraphs) {
+    const float values[] = { 4.0f, -1.0f, 1.0f, 20.0f, 0.0f };
+    OverlayBatch batch;
+    batch.AddGraph(100.0f, 50.0f, 50.0f, 8.0f, values, 5, 2, 8.0f, White);
+    REQUIRE(batch.GetQuadCount() == 3);
+    const std::vector<OverlayQuad> &quads = batch.GetQuads();
+
+    // Oldest first: values[2], values[3], (values[4] is 0), values[0], (values[1] < 0).
+    CHECK_EQ(quads[0].left, 100.0f);
+    CHECK_EQ(quads[0].right, 110.0f);
+    CHECK_EQ(quads[0].top, 57.0f);
+    CHECK_EQ(quads[1].left, 110.0f);
+    CHECK_EQ(quads[1].top, 50.0f);  // Clamped to the height.
+    CHECK_EQ(quads[2].left, 130.0f);
+    CHECK_EQ(quads[2].top, 54.0f);
+    for (const OverlayQuad &quad : quads) {
+        CHECK_EQ(quad.bottom, 58.0f);
+        CHECK_EQ(quad.cell, OverlaySolidCell);
+    }
+
+    // Nothing to draw without values or a positive maximum.
+    batch.Clear();
+    batch.AddGraph(0.0f, 0.0f, 10.0f, 10.0f, values, 0, 0, 8.0f, White);
+    batch.AddGraph(0.0f, 0.0f, 10.0f, 10.0f, values, 5, 0, 0.0f, White);
+    batch.AddRect(0.0f, 0.0f, 0.0f, 10.0f, White);
+    CHECK_EQ(batch.GetQuadCount(), size_t(0));
+}
+
+// Characters outside the font use the '?' glyph, and every cell, solid included, is
+// inside the atlas.
+TEST(OverlayBatchMapsGlyphsToTheAtlas) {
+    CHECK_EQ(GetOverlayCell(' '), 0u);
+    CHECK_EQ(GetOverlayCell('~'), OverlayGlyphCount - 1);
+    for (char c : { '\t', '\x01', '\x7F', char(0x80), char(0xE9), char(0xFF) }) {
+        CHECK_EQ(GetOverlayCell(c), GetOverlayCell('?'));
+    }
+
+    OverlayBatch batch;
+    batch.AddText(0.0f, 0.0f, "\t\xE9", White);
+    REQUIRE(batch.GetQuadCount() == 2);
+    CHECK_EQ(batch.GetQuads()[1].cell, GetOverlayCell('?'));
+
+    std::vector<uint8_t> atlas;
+    BuildOverlayAtlas(atlas);
+    REQUIRE(atlas.size() == size_t(OverlayAtlasWidth) * OverlayAtlasHeight);
+    CHECK(OverlaySolidCell / OverlayAtlasColumns * OverlayCellSize < OverlayAtlasHeight);
+    CHECK_EQ(CountCellTexels(atlas, OverlaySolidCell), OverlayCellSize * OverlayCellSize);
+    CHECK_EQ(CountCellTexels(atlas, GetOverlayCell(' ')), 0u);
+    CHECK(CountCellTexels(atlas, GetOverlayCell('?')) > 0);
+}
@@ -0,0 +1,235 @@
+#include "BatchMath.h"
+#include "PixelFormat.h"
+#include "Test.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr size_t PixelCount = 1001; // Odd, so the SIMD kernels also run their scalar tails.
+
+std::vector<uint8_t> RandomBytes(TestRandom &random, size_t count) {
+    std::vector<uint8_t> bytes(count);
+    for (uint8_t &byte : bytes) {
+        byte = uint8_t(random.Next() >> 56);
+    }
+    // Alpha of 0 and 255 and every byte value appear at least once.
+    for (size_t i = 0; i < 256 && i < count; i++) {
+        bytes[i] = uint8_t(i);
+    }
+    return bytes;
+}
+
+float FromBits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// A color table with the values where float to half conversion is easy to get wrong: the
+// subnormal range, ties between two halves, overflow, infinity, NaN and signed zero.
+void MakeEdgeTable(float table[256]) {
+    const float edges[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 65504.0f, 65519.0f, 65520.0f, 1e6f, -1e6f,
+        FromBits(0x7F800000), FromBits(0xFF800000), FromBits(0x7FC00000),
+        6.1035156e-5f, 6.0975552e-5f, 5.9604645e-8f, 2.9802322e-8f, 2.9802326e-8f, 1e-10f,
+        1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f, 1.0f + 1.0f / 4096.0f, 0.33333334f,
+    };
+    const size_t edgeCount = sizeof(edges) / sizeof(edges[0]);
+    TestRandom random(34);
+    for (size_t i = 0; i < 256; i++) {
+        if (i < edgeCount) {
+            table[i] = edges[i];
+        } else {
+            // Any bit pattern except NaN payloads, which F16C keeps and the scalar code does not.
+            uint32_t bits = uint32_t(random.Next() >> 32);
+            table[i] = (bits & 0x7F800000) == 0x7F800000 ? FromBits(bits & 0xFF800000) : FromBits(bits);
+        }
+    }
+}
+
+} // namespace
+
+TEST(PixelFormatHalfRoundTrip) {
+    // Every half except NaNs survives half -> float -> half.
+    size_t mismatches = 0;
+    for (uint32_t half = 0; half < 0x10000; half++) {
+        bool nan = (half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0;
+        if (!nan && FloatToHalf(HalfToFloat(uint16_t(half))) != half) {
+            mismatches++;
+        }
+    }
+    CHECK_EQ(mismatches, size_t(0));
+
+    CHECK_EQ(FloatToHalf(1.0f + 1.0f / 2048.0f), uint16_t(0x3C00)); // Tie to even, down.
+    CHECK_EQ(FloatToHalf(1.0f + 3.0f / 2048.0f), uint16_t(0x3C02)); // Tie to even, up.
+    CHECK_EQ(FloatToHalf(65519.0f), uint16_t(0x7BFF));
+    CHECK_EQ(FloatToHalf(65520.0f), uint16_t(0x7C00));
+    CHECK_EQ(FloatToHalf(2.9802322e-8f), uint16_t(0x0000));         // Half the smallest subnormal.
+    CHECK_EQ(FloatToHalf(2.9802326e-8f), uint16_t(0x0001));
+    CHECK_EQ(FloatToHalf(-0.0f), uint16_t(0x8000));
+    CHECK_EQ(FloatToHalf(FromBits(0x7FC00000)), uint16_t(0x7E00));
+    CHECK_EQ(HalfToFloat(0x0001), 5.9604645e-8f);
+}
+
+TEST(PixelFormatAvx2MatchesScalar) {
+    if (GetSupportedSimdLevel() < SimdLevel::Avx2) {
+        return;
+    }
+
+    TestRandom random(34);
+    const PixelKernels &scalar = ScalarPixelKernels;
+    const PixelKernels &avx2 = Avx2PixelKernels;
+    std::vector<uint8_t> rgba = RandomBytes(random, PixelCount * 4);
+    std::vector<uint8_t> la = RandomBytes(random, PixelCount * 2);
+    std::vector<uint8_t> expected(PixelCount * 4), actual(PixelCount * 4);
+
+    auto compare = [&]() {
+        bool same = expected == actual;
+        std::fill(expected.begin(), expected.end(), uint8_t(0xCD));
+        std::fill(actual.begin(), actual.end(), uint8_t(0xCD));
+        return same;
+    };
+
+    scalar.swapRedBlue(rgba.data(), expected.data(), PixelCount);
+    avx2.swapRedBlue(rgba.data(), actual.data(), PixelCount);
+    CHECK(compare());
+
+    scalar.expandL8(la.data(), expected.data(), PixelCount);
+    avx2.expandL8(la.data(), actual.data(), PixelCount);
+    CHECK(compare());
+
+    for (bool premultiply : { false, true }) {
+        scalar.expandL8A8(la.data(), expected.data(), PixelCount, premultiply);
+        avx2.expandL8A8(la.data(), actual.data(), PixelCount, premultiply);
+        CHECK(compare());
+    }
+
+    for (bool swap : { false, true }) {
+        scalar.premultiply(rgba.data(), expected.data(), PixelCount, swap);
+        avx2.premultiply(rgba.data(), actual.data(), PixelCount, swap);
+        CHECK(compare());
+    }
+
+    // Every 16-bit half, including infinities, NaNs and subnormals, through F16C and back.
+    std::vector<uint16_t> halves(0x10000);
+    for (size_t i = 0; i < halves.size(); i++) {
+        halves[i] = uint16_t(i);
+    }
+    size_t halfPixels = halves.size() / 4;
+    std::vector<uint8_t> expectedBytes(halfPixels * 4), actualBytes(halfPixels * 4);
+    for (bool swap : { false, true }) {
+        scalar.halfToUnorm(halves.data(), expectedBytes.data(), halfPixels, swap);
+        avx2.halfToUnorm(halves.data(), actualBytes.data(), halfPixels, swap);
+        CHECK(expectedBytes == actualBytes);
+    }
+
+    float unormTable[256];
+    for (int i = 0; i < 256; i++) {
+        unormTable[i] = i * (1.0f / 255.0f);
+    }
+    float edgeTable[256];
+    MakeEdgeTable(edgeTable);
+
+    std::vector<uint16_t> expectedHalves(PixelCount * 4), actualHalves(PixelCount * 4);
+    for (const float *table : { (const float *) unormTable, (const float *) edgeTable }) {
+        for (bool swap : { false, true }) {
+            for (bool premultiply : { false, true }) {
+                scalar.unormToHalf(rgba.data(), expectedHalves.data(), PixelCount, table, swap, premultiply);
+                avx2.unormToHalf(rgba.data(), actualHalves.data(), PixelCount, table, swap, premultiply);
+                CHECK(expectedHalves == actualHalves);
+            }
+        }
+    }
+}
+
+// ConvertPixels with the supported kernels gives the same images as with the scalar ones.
+TEST(PixelFormatConvertMatchesScalar) {
+    const uint32_t width = 67;
+    const uint32_t height = 9;
+    TestRandom random(341);
+    std::vector<uint8_t> source = RandomBytes(random, (size_t(width) * 8 + 4) * height);
+
+    struct Case {
+        PixelFormat src;
+        PixelFormat dst;
+        uint32_t conversion;
+    };
+    const Case cases[] = {
+        { PixelFormat::R8G8B8A8, PixelFormat::B8G8R8A8, PixelConversionNone },
+        { PixelFormat::B8G8R8A8, PixelFormat::R8G8B8A8, PixelConversionPremultiplyAlpha },
+        { PixelFormat::L8, PixelFormat::R8G8B8A8, PixelConversionNone },
+        { PixelFormat::L8A8, PixelFormat::B8G8R8A8, PixelConversionPremultiplyAlpha },
+        { PixelFormat::R8G8B8A8, PixelFormat::R16G16B16A16Float, PixelConversionSrgbToLinear | PixelConversionPremultiplyAlpha },
+        { PixelFormat::B8G8R8A8, PixelFormat::R16G16B16A16Float, PixelConversionNone },
+        { PixelFormat::R16G16B16A16Float, PixelFormat::B8G8R8A8, PixelConversionNone },
+        { PixelFormat::R8G8B8A8, PixelFormat::R8G8B8A8, PixelConversionLinearToSrgb },
+    };
+
+    SimdLevel supported = GetSupportedSimdLevel();
+    for (const Case &c : cases) {
+        size_t srcPitch = size_t(width) * GetPixelSize(c.src) + 4; // Padded rows, like footprints.
+        size_t dstPitch = size_t(width) * GetPixelSize(c.dst) + 8;
+        std::vector<uint8_t> expected(dstPitch * height), actual(dstPitch * height);
+
+        SetSimdLevel(SimdLevel::Scalar);
+        REQUIRE(ConvertPixels(source.data(), srcPitch, c.src, expected.data(), dstPitch, c.dst, width, height, c.conversion));
+        SetSimdLevel(supported);
+        REQUIRE(ConvertPixels(source.data(), srcPitch, c.src, actual.data(), dstPitch, c.dst, width, height, c.conversion));
+        CHECK(expected == actual);
+    }
+
+    CHECK(!ConvertPixels(source.data(), width * 4, PixelFormat::R8G8B8A8, source.data(), width * 4, PixelFormat::Unknown, width, 1));
+    CHECK(!ConvertPixels(source.data(), width * 4, PixelFormat::R8G8B8A8, source.data(), width * 4, PixelFormat::R8G8B8A8, width, 1,
+                         PixelConversionSrgbToLinear | PixelConversionLinearToSrgb));
+}
+
+TEST(PixelFormatConvertsValues) {
+    const uint8_t rgba[8] = { 10, 20, 30, 255, 200, 100, 50, 128 };
+    uint8_t bgra[8];
+    REQUIRE(ConvertPixels(rgba, 8, PixelFormat::R8G8B8A8, bgra, 8, PixelFormat::B8G8R8A8, 2, 1, PixelConversionPremultiplyAlpha));
+    const uint8_t expected[8] = { 30, 20, 10, 255, 25, 50, 100, 128 };
+    CHECK(memcmp(bgra, expected, sizeof(expected)) == 0);
+
+    uint16_t halves[8];
+    REQUIRE(ConvertPixels(rgba, 8, PixelFormat::R8G8B8A8, halves, 16, PixelFormat::R16G16B16A16Float, 2, 1));
+    CHECK_EQ(halves[3], uint16_t(0x3C00));
+    CHECK_NEAR(HalfToFloat(halves[4]), 200.0f / 255.0f, 1e-3f);
+
+    uint8_t back[8];
+    REQUIRE(ConvertPixels(halves, 16, PixelFormat::R16G16B16A16Float, back, 8, PixelFormat::R8G8B8A8, 2, 1));
+    CHECK(memcmp(back, rgba, sizeof(rgba)) == 0);
+}
+
+// A 5 x 3 image goes to 2 x 1: the odd last row and column fold into the last texels, so
+// the left texel averages 2 x 3 source texels and the right one 3 x 3.
+TEST(PixelFormatDownsamples) {
+    const uint32_t width = 5;
+    const uint32_t height = 3;
+    uint8_t gray[height][width];
+    uint16_t halves[height][width][4];
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            gray[y][x] = uint8_t(x + 10 * y);
+            for (uint32_t c = 0; c < 4; c++) {
+                halves[y][x][c] = FloatToHalf(float(x + 10 * y) + 0.25f * c);
+            }
+        }
+    }
+
+    // (0 + 1 + 10 + 11 + 20 + 21) / 6 = 10.5 rounds up; (2 + 3 + 4) / 3 + 10 = 13.
+    uint8_t grayMip[2];
+    REQUIRE(DownsamplePixels(gray, width, grayMip, sizeof(grayMip), PixelFormat::L8, width, height));
+    CHECK_EQ(grayMip[0], uint8_t(11));
+    CHECK_EQ(grayMip[1], uint8_t(13));
+
+    uint16_t halfMip[2][4];
+    REQUIRE(DownsamplePixels(halves, width * 8, halfMip, sizeof(halfMip), PixelFormat::R16G16B16A16Float, width, height));
+    for (uint32_t c = 0; c < 4; c++) {
+        CHECK_EQ(HalfToFloat(halfMip[0][c]), 10.5f + 0.25f * c);
+        CHECK_EQ(HalfToFloat(halfMip[1][c]), 13.0f + 0.25f * c);
+    }
+
+    CHECK(!DownsamplePixels(gray, width, grayMip, sizeof(grayMip), PixelFormat::Unknown, width, height));
+}
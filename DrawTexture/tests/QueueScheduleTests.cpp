@@ -0,0 +1,252 @@
+#include "QueueSchedule.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <vector>
+
+namespace {
+
+const QueueType Graphics = QueueType::Graphics;
+const QueueType Compute = QueueType::Compute;
+const QueueType Copy = QueueType::Copy;
+
+// Replays a resolved schedule the way the queues would run it and checks it without the
+// schedule's own clocks: every wait names a batch submitted and signaled before it, no
+// wait is already implied by the earlier ones, and every dependency has completed before
+// the pass that names it runs.
+class ScheduleChecker {
+public:
+    bool Check(const QueueSchedule &schedule, const std::vector<std::vector<PassHandle>> &dependencies) {
+        const std::vector<ScheduledBatch> &batches = schedule.GetBatches();
+        const std::vector<ScheduledWait> &waits = schedule.GetWaits();
+        const std::vector<PassHandle> &batchPasses = schedule.GetBatchPasses();
+
+        std::vector<uint32_t> passBatches(dependencies.size(), UINT32_MAX);
+        for (uint32_t batch = 0; batch < (uint32_t) batches.size(); batch++) {
+            for (uint32_t i = 0; i < batches[batch].passCount; i++) {
+                passBatches[batchPasses[batches[batch].firstPass + i]] = batch;
+            }
+        }
+
+        bool valid = schedule.GetSubmissionOrder().size() == batches.size();
+        for (uint32_t batch : schedule.GetSubmissionOrder()) {
+            const ScheduledBatch &current = batches[batch];
+            uint32_t queue = (uint32_t) current.queue;
+            for (uint32_t i = 0; i < current.waitCount; i++) {
+                const ScheduledWait &wait = waits[current.firstWait + i];
+                uint32_t source = (uint32_t) wait.queue;
+                valid &= source != queue;
+                valid &= wait.value > clocks[queue][source];
+                auto signaled = signals[source].find(wait.value);
+                if (signaled == signals[source].end()) {
+                    return false;  // Not submitted yet, or submitted without a signal.
+                }
+                for (uint32_t timeline = 0; timeline < QueueCount; timeline++) {
+                    clocks[queue][timeline] = (std::max)(clocks[queue][timeline], signaled->second[timeline]);
+                }
+            }
+            clocks[queue][queue] = current.value;
+            if (current.signal) {
+                signals[queue][current.value] = clocks[queue];
+            }
+
+            for (uint32_t i = 0; i < current.passCount; i++) {
+                PassHandle pass = batchPasses[current.firstPass + i];
+                for (PassHandle dependency : dependencies[pass]) {
+                    const ScheduledBatch &needed = batches[passBatches[dependency]];
+                    valid &= clocks[queue][(uint32_t) needed.queue] >= needed.value;
+                }
+            }
+        }
+        return valid;
+    }
+
+private:
+    using Clock = std::array<uint64_t, QueueCount>;
+    Clock clocks[QueueCount] = { };
+    std::map<uint64_t, Clock> signals[QueueCount];
+};
+
+// Adds a pass to the schedule and records its dependencies for ScheduleChecker.
+PassHandle Add(QueueSchedule &schedule, std::vector<std::vector<PassHandle>> &dependencies,
+               QueueType queue, std::initializer_list<PassHandle> passDependencies = { }) {
+    PassHandle handle = schedule.AddPass(queue, passDependencies);
+    dependencies.emplace_back(passDependencies);
+    return handle;
+}
+
+} // namespace
+
+// Graphics and compute hand results back and forth: every dependency needs a wait and
+// every batch but the last signals for the other queue.
+TEST(QueueSchedulePingPong) {
+    FrameArena scratch;
+    scratch.Init();
+    QueueSchedule schedule;
+    std::vector<std::vector<PassHandle>> dependencies;
+
+    PassHandle pass = Add(schedule, dependencies, Graphics);
+    for (int i = 1; i < 6; i++) {
+        pass = Add(schedule, dependencies, i % 2 ? Compute : Graphics, { pass });
+    }
+    schedule.Resolve(scratch);
+
+    const std::vector<ScheduledBatch> &batches = schedule.GetBatches();
+    REQUIRE(batches.size() == 6);
+    const std::vector<uint32_t> &order = schedule.GetSubmissionOrder();
+    for (uint32_t i = 0; i < 6; i++) {
+        CHECK_EQ(order[i], i);
+        CHECK_EQ((uint32_t) batches[i].queue, (uint32_t) (i % 2 ? Compute : Graphics));
+        CHECK_EQ(batches[i].value, uint64_t(i / 2 + 1));
+        CHECK_EQ(batches[i].waitCount, i == 0 ? 0u : 1u);
+        CHECK(batches[i].signal);
+    }
+    const ScheduleStats &stats = schedule.GetStats();
+    CHECK_EQ(stats.waits, 5u);
+    CHECK_EQ(stats.elidedWaits, 0u);
+    CHECK_EQ(stats.signals, 6u);
+    CHECK_EQ(stats.batches[(uint32_t) Graphics], 3u);
+    CHECK_EQ(stats.batches[(uint32_t) Compute], 3u);
+    CHECK_EQ(stats.overlappablePasses, 0u);
+    CHECK(ScheduleChecker().Check(schedule, dependencies));
+
+    // Independent passes on two queues need nothing and may overlap.
+    schedule.Reset();
+    schedule.AddPass(Graphics);
+    schedule.AddPass(Compute);
+    schedule.Resolve(scratch);
+    CHECK_EQ(schedule.GetStats().waits, 0u);
+    CHECK_EQ(schedule.GetStats().overlappablePasses, 2u);
+}
+
+// copy -> compute -> graphics: graphics has seen the copy through compute's wait, so
+// depending on the copy again adds no wait, whether in a later pass or next to the
+// compute dependency.
+TEST(QueueScheduleElidesTransitiveWaits) {
+    FrameArena scratch;
+    scratch.Init();
+    QueueSchedule schedule;
+    std::vector<std::vector<PassHandle>> dependencies;
+
+    PassHandle upload = Add(schedule, dependencies, Copy);
+    PassHandle simulate = Add(schedule, dependencies, Compute, { upload });
+    PassHandle draw = Add(schedule, dependencies, Graphics, { simulate });
+    Add(schedule, dependencies, Graphics, { upload, draw });
+    schedule.Resolve(scratch);
+
+    const ScheduleStats &stats = schedule.GetStats();
+    CHECK_EQ(stats.waits, 2u);
+    CHECK_EQ(stats.elidedWaits, 1u);
+    CHECK_EQ(stats.batches[(uint32_t) Graphics], 1u);  // The elided wait does not split the batch.
+    CHECK_EQ(stats.signals, 3u);
+    CHECK(ScheduleChecker().Check(schedule, dependencies));
+
+    // Both dependencies on one pass: the compute wait covers the copy.
+    schedule.Reset();
+    dependencies.clear();
+    upload = Add(schedule, dependencies, Copy);
+    simulate = Add(schedule, dependencies, Compute, { upload });
+    Add(schedule, dependencies, Graphics, { upload, simulate });
+    schedule.Resolve(scratch);
+    REQUIRE(schedule.GetWaits().size() == 2);
+    CHECK_EQ((uint32_t) schedule.GetWaits()[1].queue, (uint32_t) Compute);
+    CHECK_EQ(schedule.GetStats().elidedWaits, 1u);
+    CHECK(ScheduleChecker().Check(schedule, dependencies));
+
+    // Timelines continue across Reset(): the third frame's copy signals 3.
+    schedule.Reset();
+    dependencies.clear();
+    upload = Add(schedule, dependencies, Copy);
+    Add(schedule, dependencies, Graphics);
+    Add(schedule, dependencies, Graphics, { upload });
+    schedule.Resolve(scratch);
+    CHECK_EQ(schedule.GetStats().waits, 1u);
+    CHECK_EQ(schedule.GetLastValue(Copy), uint64_t(3));
+}
+
+// Consecutive passes on a queue share a batch; only a pass that needs a new wait starts
+// another. A dependency on a batch still open closes it so its signal comes first.
+TEST(QueueScheduleBatchesPasses) {
+    FrameArena scratch;
+    scratch.Init();
+    QueueSchedule schedule;
+    std::vector<std::vector<PassHandle>> dependencies;
+
+    PassHandle shadows = Add(schedule, dependencies, Graphics);
+    Add(schedule, dependencies, Graphics, { shadows });  // Same queue: ordered already.
+    PassHandle culling = Add(schedule, dependencies, Compute);
+    Add(schedule, dependencies, Graphics);
+    Add(schedule, dependencies, Graphics, { culling });
+    Add(schedule, dependencies, Graphics);
+    Add(schedule, dependencies, Compute);
+    schedule.Resolve(scratch);
+
+    const std::vector<ScheduledBatch> &batches = schedule.GetBatches();
+    REQUIRE(batches.size() == 4);
+    CHECK_EQ((uint32_t) batches[0].queue, (uint32_t) Graphics);
+    CHECK_EQ(batches[0].passCount, 3u);
+    CHECK(!batches[0].signal);  // Nothing waits for it and it is not the last graphics batch.
+    CHECK_EQ(batches[1].passCount, 1u);
+    CHECK(batches[1].signal);
+    CHECK_EQ(batches[2].passCount, 2u);
+    CHECK_EQ(batches[2].waitCount, 1u);
+    CHECK_EQ(batches[3].passCount, 1u);  // A closed batch stays closed.
+    CHECK_EQ(schedule.GetStats().signals, 3u);
+
+    // The compute batch is closed by the wait on it, so it is submitted before the graphics
+    // batch that was open at the time.
+    const std::vector<uint32_t> &order = schedule.GetSubmissionOrder();
+    REQUIRE(order.size() == 4);
+    CHECK_EQ(order[0], 1u);
+    CHECK_EQ(order[1], 0u);
+    CHECK_EQ(order[2], 2u);
+    CHECK_EQ(order[3], 3u);
+    CHECK(ScheduleChecker().Check(schedule, dependencies));
+
+    // Dependencies must name earlier passes.
+    CHECK_EQ(schedule.AddPass(Graphics, { 100 }), QueueSchedule::InvalidHandle);
+    PassHandle next = (PassHandle) dependencies.size();
+    CHECK_EQ(schedule.AddPass(Graphics, { next }), QueueSchedule::InvalidHandle);
+    CHECK_EQ(schedule.AddPass(Graphics, { next - 1 }), next);
+}
+
+// Random passes over the three queues for many frames; every schedule replays correctly
+// and the timelines only move forward.
+TEST(QueueScheduleRandomGraphs) {
+    FrameArena scratch;
+    scratch.Init();
+    QueueSchedule schedule;
+    TestRandom random(37);
+    ScheduleChecker checker;  // Carries the queues' clocks from frame to frame.
+
+    uint64_t lastValues[QueueCount] = { };
+    for (int frame = 0; frame < 500; frame++) {
+        schedule.Reset();
+        std::vector<std::vector<PassHandle>> dependencies;
+        uint32_t passCount = 1 + random.Below(24);
+        for (PassHandle pass = 0; pass < passCount; pass++) {
+            std::vector<PassHandle> passDependencies;
+            uint32_t dependencyCount = pass > 0 ? random.Below(4) : 0;
+            for (uint32_t i = 0; i < dependencyCount; i++) {
+                passDependencies.push_back(random.Below(pass));
+            }
+            REQUIRE(schedule.AddPass((QueueType) random.Below(QueueCount), passDependencies.data(),
+                                     (uint32_t) passDependencies.size()) == pass);
+            dependencies.push_back(passDependencies);
+        }
+        schedule.Resolve(scratch);
+        REQUIRE(checker.Check(schedule, dependencies));
+
+        const ScheduleStats &stats = schedule.GetStats();
+        uint32_t passes = 0;
+        for (uint32_t queue = 0; queue < QueueCount; queue++) {
+            passes += stats.passes[queue];
+            REQUIRE(schedule.GetLastValue((QueueType) queue) == lastValues[queue] + stats.batches[queue]);
+            lastValues[queue] = schedule.GetLastValue((QueueType) queue);
+        }
+        REQUIRE(passes == passCount);
+        REQUIRE(schedule.GetBatchPasses().size() == passCount);
+    }
+}
@@ -0,0 +1,156 @@
+#include "RangeAllocator.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+TEST(RangeAllocatorBestFit) {
+    RangeAllocator allocator(100);
+    uint32_t a = allocator.Allocate(10);
+    uint32_t b = allocator.Allocate(30);
+    uint32_t c = allocator.Allocate(10);
+    uint32_t d = allocator.Allocate(20);
+    uint32_t e = allocator.Allocate(10);
+    CHECK_EQ(a, 0u);
+    CHECK_EQ(b, 10u);
+    CHECK_EQ(c, 40u);
+    CHECK_EQ(d, 50u);
+    CHECK_EQ(e, 70u);
+
+    // Holes of 30 at 10 and 20 at 50, and 20 free at the end.
+    allocator.Free(b, 30);
+    allocator.Free(d, 20);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(3));
+
+    // The smallest block that fits, and exact fits.
+    CHECK_EQ(allocator.Allocate(15), 50u);
+    CHECK_EQ(allocator.Allocate(30), 10u);
+    CHECK_EQ(allocator.Allocate(20), 80u);
+    CHECK_EQ(allocator.Allocate(6), RangeAllocator::InvalidOffset);
+    CHECK_EQ(allocator.Allocate(5), 65u);
+    CHECK_EQ(allocator.GetFreeSize(), 0u);
+}
+
+TEST(RangeAllocatorCoalesces) {
+    RangeAllocator allocator(40);
+    uint32_t offsets[4];
+    for (uint32_t &offset : offsets) {
+        offset = allocator.Allocate(10);
+    }
+
+    // Neither neighbour free, then the previous, the next, and both.
+    allocator.Free(offsets[1], 10);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(1));
+    allocator.Free(offsets[2], 10);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(1));
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 20u);
+    allocator.Free(offsets[0], 10);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(1));
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 30u);
+    allocator.Free(offsets[3], 10);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(1));
+    CHECK_EQ(allocator.GetFreeSize(), 40u);
+    CHECK_EQ(allocator.GetFragmentation(), 0.0f);
+
+    allocator.Allocate(40);
+    allocator.Free(10, 10);
+    allocator.Free(30, 10);
+    allocator.Free(20, 10);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(1));
+    CHECK_EQ(allocator.GetLargestFreeBlock(), 30u);
+}
+
+TEST(RangeAllocatorEmptyRange) {
+    RangeAllocator allocator(8);
+    CHECK_EQ(allocator.Allocate(0), 0u);
+    CHECK_EQ(allocator.GetFreeSize(), 8u);
+    allocator.Free(0, 0);
+    CHECK_EQ(allocator.GetFreeBlockCount(), size_t(1));
+
+    // Also when nothing is left.
+    CHECK_EQ(allocator.Allocate(8), 0u);
+    CHECK_EQ(allocator.Allocate(0), 0u);
+    CHECK_EQ(allocator.Allocate(1), RangeAllocator::InvalidOffset);
+}
+
+TEST(RangeAllocatorMatchesModel) {
+    // Random allocations and frees against a map of used elements.
+    const uint32_t capacity = 4096;
+    RangeAllocator allocator(capacity);
+    std::vector<bool> used(capacity, false);
+    std::vector<AllocatedRange> live;
+    TestRandom random(27);
+
+    for (int step = 0; step < 20000; step++) {
+        if (live.empty() || random.Below(100) < 55) {
+            uint32_t size = 1 + random.Below(random.Below(4) ? 16 : 256);
+            uint32_t offset = allocator.Allocate(size);
+            if (offset == RangeAllocator::InvalidOffset) {
+                // Fails only if no free run is long enough.
+                CHECK(allocator.GetLargestFreeBlock() < size);
+                continue;
+            }
+            REQUIRE(offset + size <= capacity);
+            for (uint32_t i = offset; i < offset + size; i++) {
+                REQUIRE(!used[i]);
+                used[i] = true;
+            }
+            live.push_back({ offset, size });
+        } else {
+            size_t index = random.Below(uint32_t(live.size()));
+            AllocatedRange range = live[index];
+            live[index] = live.back();
+            live.pop_back();
+            allocator.Free(range.offset, range.size);
+            std::fill(used.begin() + range.offset, used.begin() + range.offset + range.size, false);
+        }
+
+        // Free blocks never touch, so their count is the number of free runs.
+        uint32_t freeSize = 0;
+        size_t runs = 0;
+        uint32_t longest = 0;
+        uint32_t run = 0;
+        for (uint32_t i = 0; i < capacity; i++) {
+            if (used[i]) {
+                run = 0;
+                continue;
+            }
+            freeSize++;
+            runs += run == 0;
+            longest = (std::max)(longest, ++run);
+        }
+        REQUIRE(allocator.GetFreeSize() == freeSize);
+        REQUIRE(allocator.GetFreeBlockCount() == runs);
+        REQUIRE(allocator.GetLargestFreeBlock() == longest);
+    }
+}
+
+TEST(RangeAllocatorCompaction) {
+    RangeAllocator allocator(100);
+    std::vector<AllocatedRange> ranges;
+    for (uint32_t i = 0; i < 10; i++) {
+        ranges.push_back({ allocator.Allocate(10), 10 });
+    }
+    // Keep 10-20, 20-30 and 50-60, plus an empty range.
+    for (uint32_t i : { 0, 3, 4, 6, 7, 8, 9 }) {
+        allocator.Free(ranges[i].offset, ranges[i].size);
+    }
+    ranges = { { 0, 0 }, { 10, 10 }, { 20, 10 }, { 50, 10 } };
+    CHECK(allocator.GetFragmentation() > 0.0f);
+
+    std::vector<RangeCopy> copies;
+    PackRanges(ranges, copies);
+
+    // The adjacent ranges are one copy.
+    REQUIRE(copies.size() == 2);
+    CHECK_EQ(copies[0].srcOffset, 10u);
+    CHECK_EQ(copies[0].dstOffset, 0u);
+    CHECK_EQ(copies[0].size, 20u);
+    CHECK_EQ(copies[1].srcOffset, 50u);
+    CHECK_EQ(copies[1].dstOffset, 20u);
+    CHECK_EQ(copies[1].size, 10u);
+    CHECK_EQ(ranges[0].offset, 0u);
+    CHECK_EQ(ranges[1].offset, 0u);
+    CHECK_EQ(ranges[2].offset, 10u);
+    CHECK_EQ(ranges[3].offset, 20u);
+}
@@ -0,0 +1,156 @@
+#include "ReadbackRing.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+namespace {
+
+// What a capture goes through, tracked outside the ring: recorded, submitted with a
+// fence value, handed to the reader, released.
+enum class Capture : uint32_t {
+    Free,
+    Recorded,
+    InFlight,
+    Reading,
+};
+
+} // namespace
+
+// Captures every frame with the GPU two frames behind: three slots are enough, and
+// captures come out in frame order once their fence completes.
+TEST(ReadbackRingCapturesEveryFrame) {
+    ReadbackRing ring(3);
+    std::vector<uint32_t> ready;
+    std::vector<uint32_t> frames(3, UINT32_MAX);
+    uint32_t nextFrame = 0;
+    for (uint64_t fence = 1; fence <= 100; fence++) {
+        uint32_t slot = ring.Acquire();
+        REQUIRE(slot != ReadbackRing::InvalidSlot);
+        CHECK_EQ(slot, uint32_t((fence - 1) % 3));  // Round robin.
+        frames[slot] = uint32_t(fence);
+        ring.Submit(fence);
+
+        ready.clear();
+        ring.Poll(fence >= 2 ? fence - 2 : 0, ready);
+        CHECK_EQ(ready.size(), size_t(fence >= 3 ? 1 : 0));
+        for (uint32_t readySlot : ready) {
+            CHECK_EQ(frames[readySlot], ++nextFrame);
+            ring.Release(readySlot);
+        }
+    }
+    CHECK_EQ(ring.GetDroppedCount(), uint64_t(0));
+    CHECK_EQ(ring.GetFreeCount(), 1u);
+}
+
+// A reader that holds on to its slots makes Acquire() fail instead of waiting, and
+// nothing comes back from Poll() before its fence, nor twice.
+TEST(ReadbackRingDropsWhenFull) {
+    ReadbackRing ring(2);
+    std::vector<uint32_t> ready;
+    CHECK_EQ(ring.Acquire(), 0u);
+    CHECK_EQ(ring.Acquire(), 1u);
+    CHECK_EQ(ring.Acquire(), ReadbackRing::InvalidSlot);
+    CHECK_EQ(ring.GetDroppedCount(), uint64_t(1));
+
+    ring.Poll(100, ready);
+    CHECK(ready.empty());  // Recorded but not submitted.
+    ring.Submit(5);
+    ring.Poll(4, ready);
+    CHECK(ready.empty());
+    ring.Poll(5, ready);
+    REQUIRE(ready.size() == 2);
+    ring.Poll(6, ready);
+    CHECK_EQ(ready.size(), size_t(2));
+
+    CHECK_EQ(ring.Acquire(), ReadbackRing::InvalidSlot);  // Both are being read.
+    ring.Release(ready[1]);
+    CHECK_EQ(ring.Acquire(), ready[1]);
+    CHECK_EQ(ring.GetDroppedCount(), uint64_t(2));
+
+    ring.Reset(4);
+    CHECK_EQ(ring.GetFreeCount(), 4u);
+    CHECK_EQ(ring.GetDroppedCount(), uint64_t(0));
+    ReadbackRing empty;
+    CHECK_EQ(empty.Acquire(), ReadbackRing::InvalidSlot);
+}
+
+// Random interleavings of captures, submissions, fence progress and late releases. The
+// slots' states are tracked outside the ring and every transition it makes is checked
+// against them.
+TEST(ReadbackRingStateMachine) {
+    const uint32_t slotCount = 5;
+    ReadbackRing ring(slotCount);
+    TestRandom random(46);
+
+    std::vector<Capture> states(slotCount, Capture::Free);
+    std::vector<uint64_t> fences(slotCount, 0);
+    std::vector<uint64_t> frames(slotCount, 0);
+    std::deque<uint32_t> reading;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t frame = 0;
+    uint64_t lastReadFrame = 0;
+    uint64_t dropped = 0;
+    uint32_t next = 0;
+    std::vector<uint32_t> ready;
+    for (int operation = 0; operation < 100000; operation++) {
+        uint32_t kind = random.Below(10);
+        if (kind < 3) {
+            // The ring searches from the slot after the last one it handed out.
+            uint32_t expected = ReadbackRing::InvalidSlot;
+            for (uint32_t i = 0; i < slotCount && expected == ReadbackRing::InvalidSlot; i++) {
+                if (states[(next + i) % slotCount] == Capture::Free) {
+                    expected = (next + i) % slotCount;
+                }
+            }
+            uint32_t slot = ring.Acquire();
+            REQUIRE(slot == expected);
+            if (slot == ReadbackRing::InvalidSlot) {
+                dropped++;
+            } else {
+                states[slot] = Capture::Recorded;
+                frames[slot] = ++frame;
+                next = (slot + 1) % slotCount;
+            }
+        } else if (kind < 5) {
+            ring.Submit(++submitted);
+            for (uint32_t slot = 0; slot < slotCount; slot++) {
+                if (states[slot] == Capture::Recorded) {
+                    states[slot] = Capture::InFlight;
+                    fences[slot] = submitted;
+                }
+            }
+        } else if (kind < 7) {
+            completed = (std::min)(submitted, completed + random.Below(4));
+            ready.clear();
+            ring.Poll(completed, ready);
+            uint32_t expectedCount = 0;
+            for (uint32_t slot = 0; slot < slotCount; slot++) {
+                expectedCount += states[slot] == Capture::InFlight && fences[slot] <= completed;
+            }
+            REQUIRE(ready.size() == expectedCount);
+            for (uint32_t slot : ready) {
+                REQUIRE(states[slot] == Capture::InFlight);
+                REQUIRE(fences[slot] <= completed);
+                REQUIRE(frames[slot] > lastReadFrame);  // Oldest first, across polls too.
+                lastReadFrame = frames[slot];
+                states[slot] = Capture::Reading;
+                reading.push_back(slot);
+            }
+        } else if (!reading.empty()) {
+            // The reader finishes in any order.
+            size_t index = random.Below(uint32_t(reading.size()));
+            uint32_t slot = reading[index];
+            reading.erase(reading.begin() + index);
+            ring.Release(slot);
+            states[slot] = Capture::Free;
+        }
+
+        REQUIRE(ring.GetFreeCount() == uint32_t(std::count(states.begin(), states.end(), Capture::Free)));
+        REQUIRE(ring.GetDroppedCount() == dropped);
+    }
+    CHECK(dropped > 5000);
+    CHECK(lastReadFrame > 10000);
+}
@@ -0,0 +1,299 @@
+#include "ResidencyPolicy.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const uint64_t MB = 1024 * 1024;
+
+// A device that applies the plans of a ResidencyPolicy and completes submissions a fixed
+// number of frames after they were made, like a GPU running behind the CPU.
+class SimulatedDevice {
+public:
+    SimulatedDevice(ResidencyPolicy &policy, uint64_t latency) : policy(policy), latency(latency) { }
+
+    // One submission referencing objects; returns false when a plan broke a rule.
+    bool Frame(const std::vector<ResidencyHandle> &objects) {
+        for (ResidencyHandle handle : objects) {
+            policy.Use(handle);
+        }
+        policy.Plan(GetCompletedFenceValue(), makeResident, evict);
+
+        bool valid = true;
+        for (ResidencyHandle handle : evict) {
+            // Never an object the GPU may still read, nor one this submission needs.
+            valid &= lastFences[handle] <= GetCompletedFenceValue();
+            valid &= std::find(objects.begin(), objects.end(), handle) == objects.end();
+            valid &= !policy.IsResident(handle);
+        }
+        for (ResidencyHandle handle : objects) {
+            valid &= policy.IsResident(handle);
+        }
+
+        fenceValue++;
+        for (ResidencyHandle handle : objects) {
+            lastFences[handle] = fenceValue;
+        }
+        policy.Submit(fenceValue);
+        return valid;
+    }
+
+    ResidencyHandle Add(uint64_t size) {
+        ResidencyHandle handle = policy.Add(size);
+        lastFences.resize((std::max)(lastFences.size(), size_t(handle) + 1));
+        lastFences[handle] = 0; // A reused handle is a new resource.
+        return handle;
+    }
+
+    uint64_t GetCompletedFenceValue() const { return fenceValue > latency ? fenceValue - latency : 0; }
+
+    std::vector<ResidencyHandle> makeResident;
+    std::vector<ResidencyHandle> evict;
+
+private:
+    ResidencyPolicy &policy;
+    uint64_t latency;
+    uint64_t fenceValue = 0;
+    std::vector<uint64_t> lastFences;
+};
+
+} // namespace
+
+TEST(ResidencyPolicyEvictsToLowWatermark) {
+    ResidencyPolicy policy;
+    SimulatedDevice device(policy, 0);
+    std::vector<ResidencyHandle> objects;
+    for (int i = 0; i < 20; i++) {
+        objects.push_back(device.Add(16 * MB));
+    }
+    // Last used in the order they were added, so they are evicted in that order.
+    for (ResidencyHandle handle : objects) {
+        REQUIRE(device.Frame({ handle }));
+    }
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(device.Frame({ }));
+    }
+
+    // 320 MB resident, budget 256 MB: eviction goes on to 256 - 256 / 16 = 240 MB.
+    policy.SetBudget(256 * MB);
+    REQUIRE(device.Frame({ }));
+    CHECK_EQ(device.evict.size(), size_t(5));
+    for (size_t i = 0; i < device.evict.size(); i++) {
+        CHECK_EQ(device.evict[i], objects[i]);
+    }
+    CHECK_EQ(policy.GetResidentBytes(), 240 * MB);
+    CHECK_EQ(policy.GetStats().evictedBytes, 80 * MB);
+    CHECK_EQ(policy.GetStats().overBudgetBytes, uint64_t(0));
+
+    // Up to the budget nothing is evicted; the hysteresis absorbs small growth.
+    device.Add(16 * MB);
+    REQUIRE(device.Frame({ }));
+    CHECK(device.evict.empty());
+    CHECK_EQ(policy.GetResidentBytes(), 256 * MB);
+
+    // One byte over goes back down to the watermark, not just under the budget.
+    device.Add(1);
+    REQUIRE(device.Frame({ }));
+    CHECK_EQ(device.evict.size(), size_t(2));
+    CHECK_EQ(device.evict[0], objects[5]);
+    CHECK_EQ(policy.GetResidentBytes(), 224 * MB + 1);
+}
+
+// Objects that are not evictable, like persistently mapped upload pages, count against the
+// budget and are skipped by eviction, so the evictable ones make room instead.
+TEST(ResidencyPolicyKeepsUnevictableObjects) {
+    ResidencyPolicy policy;
+    SimulatedDevice device(policy, 0);
+    ResidencyHandle mapped = device.Add(64 * MB);
+    policy.SetEvictable(mapped, false);
+    std::vector<ResidencyHandle> objects;
+    for (int i = 0; i < 4; i++) {
+        objects.push_back(device.Add(64 * MB));
+    }
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(device.Frame({ }));
+    }
+
+    // 320 MB resident, budget 256 MB: the mapped object is the least recently used but
+    // stays, and two others go to get under 240 MB.
+    policy.SetBudget(256 * MB);
+    REQUIRE(device.Frame({ }));
+    std::vector<ResidencyHandle> expected = { objects[0], objects[1] };
+    CHECK(device.evict == expected);
+    CHECK(policy.IsResident(mapped));
+    CHECK_EQ(policy.GetResidentBytes(), 192 * MB);
+
+    // With nothing else left to evict, it overcommits rather than evict the mapped object.
+    policy.SetBudget(32 * MB);
+    REQUIRE(device.Frame({ }));
+    CHECK(policy.IsResident(mapped));
+    CHECK_EQ(policy.GetResidentBytes(), 64 * MB);
+    CHECK_EQ(policy.GetStats().overBudgetBytes, 32 * MB);
+
+    // A reused handle is evictable again.
+    policy.Remove(mapped);
+    REQUIRE(device.Add(64 * MB) == mapped);
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(device.Frame({ }));
+    }
+    CHECK(!policy.IsResident(mapped));
+}
+
+TEST(ResidencyPolicyOvercommitsForRecentWork) {
+    ResidencyPolicy policy;
+    SimulatedDevice device(policy, 0);
+    std::vector<ResidencyHandle> frameA, frameB;
+    for (int i = 0; i < 8; i++) {
+        frameA.push_back(device.Add(16 * MB));
+        frameB.push_back(device.Add(16 * MB));
+    }
+    policy.SetBudget(160 * MB);
+
+    // Two alternating working sets of 128 MB each: both are within the last
+    // ProtectedSubmissions submissions, so nothing is evicted although 256 MB are resident.
+    for (int i = 0; i < 10; i++) {
+        REQUIRE(device.Frame(i % 2 ? frameB : frameA));
+        CHECK(device.evict.empty());
+        CHECK(device.makeResident.empty());
+        CHECK_EQ(policy.GetStats().overBudgetBytes, 96 * MB);
+    }
+
+    // frameA was used one submission ago; once that is more than ProtectedSubmissions
+    // submissions back, it goes.
+    uint32_t frames = 0;
+    while (policy.GetResidentBytes() > 160 * MB) {
+        REQUIRE(frames++ < ResidencyPolicy::DefaultProtectedSubmissions);
+        REQUIRE(device.Frame(frameB));
+    }
+    CHECK_EQ(frames, ResidencyPolicy::DefaultProtectedSubmissions);
+    CHECK_EQ(policy.GetResidentBytes(), 144 * MB); // 150 MB watermark, in 16 MB steps.
+    for (ResidencyHandle handle : frameB) {
+        CHECK(policy.IsResident(handle));
+    }
+
+    // Without protection the other set is evicted as soon as it is not used.
+    ResidencyPolicy unprotected;
+    unprotected.SetProtectedSubmissions(0);
+    SimulatedDevice device2(unprotected, 0);
+    std::vector<ResidencyHandle> setA, setB;
+    for (int i = 0; i < 8; i++) {
+        setA.push_back(device2.Add(16 * MB));
+        setB.push_back(device2.Add(16 * MB));
+    }
+    unprotected.SetBudget(160 * MB);
+    REQUIRE(device2.Frame({ })); // Objects are protected in the submission that adds them.
+    CHECK(device2.evict.empty());
+    REQUIRE(device2.Frame(setA));
+    CHECK_EQ(device2.evict.size(), size_t(7)); // 256 -> 144 MB, all from setB.
+    REQUIRE(device2.Frame(setB));
+    CHECK_EQ(device2.makeResident.size(), size_t(7));
+    CHECK(!device2.evict.empty());
+}
+
+TEST(ResidencyPolicyWaitsForFence) {
+    ResidencyPolicy policy;
+    SimulatedDevice device(policy, 6); // The GPU is six submissions behind.
+    std::vector<ResidencyHandle> objects;
+    for (int i = 0; i < 8; i++) {
+        objects.push_back(device.Add(32 * MB));
+    }
+    for (ResidencyHandle handle : objects) {
+        REQUIRE(device.Frame({ handle }));
+    }
+
+    // Objects 0 and 1 are the only ones whose last submission has completed.
+    policy.SetBudget(128 * MB);
+    REQUIRE(device.Frame({ }));
+    CHECK_EQ(device.evict.size(), size_t(2));
+    CHECK_EQ(policy.GetStats().overBudgetBytes, 64 * MB);
+    for (size_t i = 2; i < objects.size(); i++) {
+        CHECK(policy.IsResident(objects[i]));
+    }
+
+    // As the fence advances the rest follow, oldest first.
+    REQUIRE(device.Frame({ }));
+    REQUIRE(device.evict.size() == 1);
+    CHECK_EQ(device.evict[0], objects[2]);
+    for (int i = 0; i < 8; i++) {
+        REQUIRE(device.Frame({ }));
+    }
+    // Eviction stops at the budget because the object that would reach the watermark
+    // was not evictable yet when residency went over; within the budget nothing more goes.
+    CHECK_EQ(policy.GetResidentBytes(), 128 * MB);
+}
+
+TEST(ResidencyPolicyCountsRefaults) {
+    ResidencyPolicy policy;
+    policy.SetProtectedSubmissions(0);
+    SimulatedDevice device(policy, 0);
+    ResidencyHandle a = device.Add(64 * MB);
+    ResidencyHandle b = device.Add(64 * MB);
+    ResidencyHandle c = device.Add(64 * MB);
+    policy.SetBudget(128 * MB);
+    REQUIRE(device.Frame({ }));
+
+    // a and b are used, c is evicted; c comes back within ThrashWindow: a refault.
+    REQUIRE(device.Frame({ a, b }));
+    REQUIRE(device.evict.size() == 1);
+    CHECK_EQ(device.evict[0], c);
+    for (uint32_t i = 1; i < ResidencyPolicy::ThrashWindow; i++) {
+        REQUIRE(device.Frame({ a, b }));
+    }
+    REQUIRE(device.Frame({ c }));
+    CHECK_EQ(device.makeResident.size(), size_t(1));
+    CHECK_EQ(policy.GetStats().refaultCount, 1u);
+
+    // a and b were evicted by that frame; reloaded after more than ThrashWindow
+    // submissions they are not refaults.
+    CHECK(!policy.IsResident(a));
+    for (uint32_t i = 0; i < ResidencyPolicy::ThrashWindow; i++) {
+        REQUIRE(device.Frame({ c }));
+    }
+    REQUIRE(device.Frame({ a }));
+    CHECK_EQ(device.makeResident.size(), size_t(1));
+    CHECK_EQ(policy.GetStats().refaultCount, 0u);
+}
+
+// Random working sets against a budget that changes now and then, with the GPU a few
+// frames behind; the device checks every plan, and the resident bytes are recounted.
+TEST(ResidencyPolicyRandomWorkload) {
+    ResidencyPolicy policy;
+    SimulatedDevice device(policy, 3);
+    TestRandom random(35);
+
+    std::vector<ResidencyHandle> live;
+    for (int i = 0; i < 200; i++) {
+        live.push_back(device.Add((1 + random.Below(16)) * MB));
+    }
+
+    for (int frame = 0; frame < 5000; frame++) {
+        if (frame % 500 == 0) {
+            policy.SetBudget((200 + random.Below(1200)) * MB);
+        }
+        if (random.Below(20) == 0) {
+            size_t index = random.Below(uint32_t(live.size()));
+            policy.Remove(live[index]);
+            live[index] = device.Add((1 + random.Below(16)) * MB);
+        }
+
+        std::vector<ResidencyHandle> objects;
+        uint32_t count = 5 + random.Below(40);
+        // Mostly a hot set at the start of the list, sometimes anything.
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t range = random.Below(4) == 0 ? uint32_t(live.size()) : 40;
+            ResidencyHandle handle = live[random.Below(range)];
+            if (std::find(objects.begin(), objects.end(), handle) == objects.end()) {
+                objects.push_back(handle);
+            }
+        }
+        REQUIRE(device.Frame(objects));
+
+        uint64_t resident = 0;
+        for (ResidencyHandle handle : live) {
+            resident += policy.IsResident(handle) ? policy.GetSize(handle) : 0;
+        }
+        REQUIRE(resident == policy.GetResidentBytes());
+    }
+}
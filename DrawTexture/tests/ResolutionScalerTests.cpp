@@ -0,0 +1,165 @@
+#include "ResolutionScaler.h"
+#include "Test.h"
+
+#include <deque>
+
+namespace {
+
+// A GPU whose frame time is proportional to the pixel count, with a little noise. Like
+// the timestamps in DrawTexture, a frame's time reaches the scaler latency frames later,
+// together with the scale the frame was rendered at.
+class SimulatedGpu {
+public:
+    SimulatedGpu(ResolutionScaler &scaler, uint32_t latency, uint64_t seed) : scaler(scaler), latency(latency), random(seed) { }
+
+    // One frame of work that takes fullTime milliseconds at scale 1.
+    void Frame(float fullTime) {
+        float scale = scaler.GetScale();
+        float noise = 1.0f + (random.Unit() - 0.5f) * 0.04f;
+        inFlight.push_back({ fullTime * scale * scale * noise, scale });
+        if (inFlight.size() > latency) {
+            scaler.Update(inFlight.front().time, inFlight.front().scale);
+            inFlight.pop_front();
+        }
+    }
+
+    void Frames(float fullTime, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            Frame(fullTime);
+        }
+    }
+
+private:
+    struct Sample {
+        float time;
+        float scale;
+    };
+
+    ResolutionScaler &scaler;
+    uint32_t latency;
+    TestRandom random;
+    std::deque<Sample> inFlight;
+};
+
+bool IsInBand(const ResolutionScaler &scaler, float fullTime, const ResolutionScalerSettings &settings) {
+    float time = fullTime * scaler.GetScale() * scaler.GetScale();
+    return time >= settings.targetTime * settings.lowerBand && time <= settings.targetTime * settings.upperBand;
+}
+
+} // namespace
+
+// The load doubles: within a few frames the scale drops to one that fits the band, then
+// stays there without oscillating.
+TEST(ResolutionScalerDoubleLoad) {
+    ResolutionScalerSettings settings;
+    ResolutionScaler scaler(settings);
+    SimulatedGpu gpu(scaler, 2, 39);
+
+    gpu.Frames(12.0f, 100);
+    CHECK_EQ(scaler.GetScale(), 1.0f);
+    CHECK_EQ(scaler.GetChangeCount(), 0u);
+
+    uint32_t frames = 0;
+    while (scaler.GetScale() == 1.0f) {
+        REQUIRE(frames++ < 10);
+        gpu.Frame(24.0f);
+    }
+    CHECK(frames <= settings.downFrames + 2 + 1);  // The streak plus the latency.
+    // One step to the middle of the band: 15.2 and 12.8 ms around sqrt(14 / 24) = 0.76.
+    CHECK_NEAR(scaler.GetScale(), 0.75f, 1e-6f);
+    CHECK(IsInBand(scaler, 24.0f, settings));
+
+    uint32_t changes = scaler.GetChangeCount();
+    gpu.Frames(24.0f, 1000);
+    CHECK_EQ(scaler.GetChangeCount(), changes);
+    CHECK_EQ(scaler.GetScaledSize(640), 480u);
+}
+
+// Single slow frames, and bursts shorter than downFrames, never lower the resolution.
+TEST(ResolutionScalerIgnoresSpikes) {
+    ResolutionScalerSettings settings;
+    ResolutionScaler scaler(settings);
+    SimulatedGpu gpu(scaler, 2, 391);
+
+    for (int i = 0; i < 40; i++) {
+        gpu.Frames(12.0f, 49);
+        gpu.Frame(60.0f);
+    }
+    for (int i = 0; i < 40; i++) {
+        gpu.Frames(12.0f, 20);
+        gpu.Frames(40.0f, settings.downFrames - 1);
+    }
+    CHECK_EQ(scaler.GetChangeCount(), 0u);
+    CHECK_EQ(scaler.GetScale(), 1.0f);
+
+    // At a reduced scale, a spike does not push it further down either, nor does the
+    // average it disturbs make the scale rise early.
+    gpu.Frames(24.0f, 20);
+    float scale = scaler.GetScale();
+    REQUIRE(scale < 1.0f);
+    uint32_t changes = scaler.GetChangeCount();
+    for (int i = 0; i < 20; i++) {
+        gpu.Frames(24.0f, 25);
+        gpu.Frame(80.0f);
+    }
+    CHECK_EQ(scaler.GetChangeCount(), changes);
+    CHECK_EQ(scaler.GetScale(), scale);
+}
+
+// After the load goes back down the scale rises again, but only after upFrames under the
+// band and by at most maxIncrease per step, until it is back at full resolution.
+TEST(ResolutionScalerRecovers) {
+    ResolutionScalerSettings settings;
+    ResolutionScaler scaler(settings);
+    SimulatedGpu gpu(scaler, 2, 392);
+
+    gpu.Frames(24.0f, 100);
+    REQUIRE(scaler.GetScale() == 0.75f);
+    uint32_t changes = scaler.GetChangeCount();
+
+    gpu.Frames(12.0f, settings.upFrames);
+    CHECK_EQ(scaler.GetScale(), 0.75f);  // The samples in flight and the streak come first.
+
+    float previous = scaler.GetScale();
+    uint32_t frames = 0;
+    while (scaler.GetScale() < 1.0f) {
+        REQUIRE(frames++ < 400);
+        gpu.Frame(12.0f);
+        CHECK(scaler.GetScale() >= previous);
+        CHECK(scaler.GetScale() - previous <= settings.maxIncrease + 1e-6f);
+        previous = scaler.GetScale();
+    }
+    CHECK(scaler.GetChangeCount() - changes <= 4u);  // 0.75 to 1 in steps of at most 1/16.
+
+    changes = scaler.GetChangeCount();
+    gpu.Frames(12.0f, 1000);
+    CHECK_EQ(scaler.GetChangeCount(), changes);
+}
+
+// A load the GPU cannot meet even at minScale ends at minScale and stays there.
+TEST(ResolutionScalerStopsAtMinimumScale) {
+    ResolutionScalerSettings settings;
+    settings.minScale = 0.5f;
+    ResolutionScaler scaler(settings);
+    SimulatedGpu gpu(scaler, 2, 393);
+
+    float previous = scaler.GetScale();
+    for (int i = 0; i < 200; i++) {
+        gpu.Frame(160.0f);
+        // Never more than maxDecrease at once, even this far over budget.
+        CHECK(previous - scaler.GetScale() <= settings.maxDecrease + 1e-6f);
+        previous = scaler.GetScale();
+    }
+    CHECK_EQ(scaler.GetScale(), 0.5f);
+    CHECK_EQ(scaler.GetScaledSize(640), 320u);
+    CHECK_EQ(scaler.GetScaledSize(1), 1u);
+    CHECK(scaler.GetPredictedTime() > settings.targetTime);
+
+    uint32_t changes = scaler.GetChangeCount();
+    gpu.Frames(160.0f, 500);
+    CHECK_EQ(scaler.GetChangeCount(), changes);
+
+    // Samples without a time, as before the first timestamps are read back, change nothing.
+    CHECK_EQ(scaler.Update(0.0f, 0.5f), 0.5f);
+    CHECK_EQ(scaler.Update(10.0f, 0.0f), 0.5f);
+}
@@ -0,0 +1,120 @@
+#include "DrawQueue.h"
+#include "ShaderKey.h"
+#include "Test.h"
+
+#include <vector>
+
+namespace {
+
+std::vector<uint32_t> GetValues(const std::vector<ShaderKey> &keys) {
+    std::vector<uint32_t> values;
+    for (ShaderKey key : keys) {
+        values.push_back(key.GetValue());
+    }
+    return values;
+}
+
+// Every key, in value order.
+std::vector<ShaderKey> GetAllKeys() {
+    std::vector<ShaderKey> keys;
+    for (uint32_t value = 0; value < ShaderKey::Count; value++) {
+        keys.push_back(ShaderKey::FromValue(value));
+    }
+    return keys;
+}
+
+} // namespace
+
+// Every combination of axes packs into its own value below Count and unpacks to itself.
+TEST(ShaderKeyPacksAxes) {
+    static_assert(ShaderKey::Sampling::Encode(1) == 1 && ShaderKey::AlphaTest::Encode(1) == 2, "");
+    static_assert(ShaderKey(SamplingMode::Point, true).Masked(ShaderKey::AlphaTest::Mask).GetValue() == 2, "");
+    static_assert(ShaderKey::FromValue(3).HasAlphaTest(), "");
+    // The key is stored in the pipeline field of draw keys.
+    static_assert(ShaderKey::Count <= DrawKey::Pipeline::ValueCount, "");
+
+    bool seen[ShaderKey::Count] = { };
+    for (SamplingMode sampling : { SamplingMode::Linear, SamplingMode::Point }) {
+        for (bool alphaTest : { false, true }) {
+            ShaderKey key(sampling, alphaTest);
+            REQUIRE(key.GetValue() < ShaderKey::Count);
+            CHECK(!seen[key.GetValue()]);
+            seen[key.GetValue()] = true;
+
+            CHECK(key.GetSamplingMode() == sampling);
+            CHECK_EQ(key.HasAlphaTest(), alphaTest);
+            CHECK_EQ(ShaderKey::FromValue(key.GetValue()).GetValue(), key.GetValue());
+            CHECK_EQ(key.Masked(ShaderKey::AllAxes).GetValue(), key.GetValue());
+            CHECK_EQ(key.Masked(0).GetValue(), ShaderKey().GetValue());
+            CHECK(key.Masked(ShaderKey::Sampling::Mask).GetSamplingMode() == sampling);
+            CHECK(!key.Masked(ShaderKey::Sampling::Mask).HasAlphaTest());
+        }
+    }
+    CHECK_EQ(ShaderKey().GetValue(), 0u);
+    CHECK(ShaderKey().GetSamplingMode() == SamplingMode::Linear);
+}
+
+// Keys that only differ in axes a stage ignores share its variant, so four keys need one
+// vertex shader, two pixel shaders and four pipeline states.
+TEST(ShaderKeyPlansSharedVariants) {
+    const bool none[ShaderKey::Count] = { };
+    std::vector<ShaderKey> keys = GetAllKeys();
+    keys.push_back(ShaderKey(SamplingMode::Point, false));  // Repeated keys are planned once.
+
+    ShaderBuildPlan plan = PlanShaderBuild(keys, 0, ShaderKey::Sampling::Mask, none, none, none);
+    CHECK(GetValues(plan.vertexShaders) == std::vector<uint32_t>({ 0 }));
+    CHECK(GetValues(plan.pixelShaders) == std::vector<uint32_t>({ 0, 1 }));
+    CHECK(GetValues(plan.pipelines) == std::vector<uint32_t>({ 0, 1, 2, 3 }));
+
+    plan = PlanShaderBuild(keys, ShaderKey::AllAxes, ShaderKey::AllAxes, none, none, none);
+    CHECK_EQ(plan.vertexShaders.size(), size_t(ShaderKey::Count));
+    CHECK_EQ(plan.pixelShaders.size(), size_t(ShaderKey::Count));
+
+    // Keys come in the order they were first asked for.
+    plan = PlanShaderBuild({ ShaderKey(SamplingMode::Linear, true), ShaderKey(SamplingMode::Point, false) },
+                           ShaderKey::AllAxes, ShaderKey::AllAxes, none, none, none);
+    CHECK(GetValues(plan.vertexShaders) == std::vector<uint32_t>({ 2, 1 }));
+    CHECK(GetValues(plan.pipelines) == std::vector<uint32_t>({ 2, 1 }));
+
+    plan = PlanShaderBuild({ }, ShaderKey::AllAxes, ShaderKey::AllAxes, none, none, none);
+    CHECK(plan.vertexShaders.empty() && plan.pixelShaders.empty() && plan.pipelines.empty());
+}
+
+// What is built already is left out, so the counts ShaderPermutations reports after a
+// second Compile() or CreatePipelines() only grow by the new variants and pipelines.
+TEST(ShaderKeyPlansOnlyMissingVariants) {
+    bool vertexShaders[ShaderKey::Count] = { };
+    bool pixelShaders[ShaderKey::Count] = { };
+    bool pipelines[ShaderKey::Count] = { };
+    uint32_t variantCount = 0;
+    uint32_t pipelineCount = 0;
+    auto build = [&](const std::vector<ShaderKey> &keys) {
+        ShaderBuildPlan plan = PlanShaderBuild(keys, 0, ShaderKey::AllAxes, vertexShaders, pixelShaders, pipelines);
+        for (ShaderKey key : plan.vertexShaders) {
+            vertexShaders[key.GetValue()] = true;
+        }
+        for (ShaderKey key : plan.pixelShaders) {
+            pixelShaders[key.GetValue()] = true;
+        }
+        for (ShaderKey key : plan.pipelines) {
+            pipelines[key.GetValue()] = true;
+        }
+        variantCount += uint32_t(plan.vertexShaders.size() + plan.pixelShaders.size());
+        pipelineCount += uint32_t(plan.pipelines.size());
+    };
+
+    build({ ShaderKey(SamplingMode::Linear, false), ShaderKey(SamplingMode::Point, false) });
+    CHECK_EQ(variantCount, 3u);
+    CHECK_EQ(pipelineCount, 2u);
+
+    build({ ShaderKey(SamplingMode::Point, false), ShaderKey(SamplingMode::Point, true) });
+    CHECK_EQ(variantCount, 4u);
+    CHECK_EQ(pipelineCount, 3u);
+
+    build(GetAllKeys());
+    CHECK_EQ(variantCount, 1u + ShaderKey::Count);
+    CHECK_EQ(pipelineCount, ShaderKey::Count);
+
+    ShaderBuildPlan plan = PlanShaderBuild(GetAllKeys(), 0, ShaderKey::AllAxes, vertexShaders, pixelShaders, pipelines);
+    CHECK(plan.vertexShaders.empty() && plan.pixelShaders.empty() && plan.pipelines.empty());
+}
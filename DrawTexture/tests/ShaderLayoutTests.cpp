@@ -0,0 +1,319 @@
+#include "ShaderLayout.h"
+#include "Test.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Serialized reflection of the sample's shaders in tests/reflection, one file per variant.
+ShaderReflectionData LoadReflection(const char *name) {
+    std::string path = std::string("tests/reflection/") + name;
+    FILE *file = fopen(path.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    std::string text;
+    char buffer[4096];
+    for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+        text.append(buffer, read);
+    }
+    fclose(file);
+
+    ShaderReflectionData data;
+    REQUIRE(ParseReflection(text, data));
+    return data;
+}
+
+// The scene stages with every variant merged, as InitRootSignatures does.
+void LoadScene(ShaderReflectionData &vertex, ShaderReflectionData &pixel) {
+    vertex = { ShaderStage::Vertex, { }, { } };
+    pixel = { ShaderStage::Pixel, { }, { } };
+    MergeReflection(LoadReflection("VertexShader.txt"), vertex);
+    for (const char *name : { "PixelShader.txt", "PixelShaderPoint.txt" }) {
+        MergeReflection(LoadReflection(name), pixel);
+    }
+}
+
+RootLayoutOptions GetSceneOptions() {
+    RootLayoutOptions options;
+    options.staticSamplers = { { "g_sampler", 0 }, { "g_pointSampler", 1 } };
+    options.flags = { { "g_textures", DescriptorFlags::DescriptorsVolatile | DescriptorFlags::DataStaticWhileSetAtExecute } };
+    return options;
+}
+
+ShaderBinding MakeBinding(const char *name, ShaderBindingType type, uint32_t shaderRegister, uint32_t count = 1, uint32_t size = 0) {
+    return { name, type, shaderRegister, 0, count, size };
+}
+
+} // namespace
+
+TEST(ShaderLayoutParsesReflection) {
+    ShaderReflectionData data = LoadReflection("VertexShaderColor.txt");
+    CHECK_EQ((uint32_t) data.stage, (uint32_t) ShaderStage::Vertex);
+    REQUIRE(data.bindings.size() == 2);
+    CHECK_EQ(data.bindings[1].name, std::string("DrawConstants"));
+    CHECK_EQ((uint32_t) data.bindings[1].type, (uint32_t) ShaderBindingType::ConstantBuffer);
+    CHECK_EQ(data.bindings[1].size, 16u);
+    REQUIRE(data.inputs.size() == 3);
+    CHECK_EQ(data.inputs[2].semantic, std::string("COLOR"));
+    CHECK_EQ(data.inputs[2].componentCount, 4u);
+
+    ShaderReflectionData pixel = LoadReflection("PixelShader.txt");
+    CHECK_EQ((uint32_t) pixel.stage, (uint32_t) ShaderStage::Pixel);
+    REQUIRE(pixel.bindings.size() == 2);
+    CHECK_EQ(pixel.bindings[1].space, 1u);
+    CHECK_EQ(pixel.bindings[1].count, 0u);  // Unbounded.
+    CHECK(pixel.inputs.empty());
+
+    // Serializing and parsing again gives the same text.
+    std::string text = SerializeReflection(data);
+    ShaderReflectionData again;
+    REQUIRE(ParseReflection(text, again));
+    CHECK_EQ(SerializeReflection(again), text);
+
+    // Comments and blank lines are skipped; a missing stage line means vertex.
+    REQUIRE(ParseReflection("\n  # comment\n\nbinding sampler s 2 0 1 0\n", again));
+    CHECK_EQ((uint32_t) again.stage, (uint32_t) ShaderStage::Vertex);
+    CHECK_EQ(again.bindings.size(), size_t(1));
+
+    CHECK(!ParseReflection("stage geometry\n", again));
+    CHECK(!ParseReflection("binding cbuffer DrawConstants 0 0\n", again));
+    CHECK(!ParseReflection("binding constants DrawConstants 0 0 1 16\n", again));
+    CHECK(!ParseReflection("binding cbuffer DrawConstants b0 0 1 16\n", again));
+    CHECK(!ParseReflection("input COLOR\n", again));
+    CHECK(!ParseReflection("output SV_TARGET 0 4\n", again));
+}
+
+// The variants' bindings and inputs are merged into one interface per stage.
+TEST(ShaderLayoutMergesVariants) {
+    ShaderReflectionData vertex, pixel;
+    LoadScene(vertex, pixel);
+    CHECK_EQ(vertex.bindings.size(), size_t(2));
+    CHECK_EQ(vertex.inputs.size(), size_t(2));
+    REQUIRE(pixel.bindings.size() == 3);  // Both samplers and the bindless textures.
+    CHECK_EQ(pixel.bindings[2].name, std::string("g_pointSampler"));
+
+    // An input only one variant reads is added after the others.
+    MergeReflection(LoadReflection("VertexShaderColor.txt"), vertex);
+    CHECK_EQ(vertex.bindings.size(), size_t(2));
+    REQUIRE(vertex.inputs.size() == 3);
+    CHECK_EQ(vertex.inputs[0].semantic, std::string("POSITION"));
+    CHECK_EQ(vertex.inputs[2].semantic, std::string("COLOR"));
+
+    // Semantics match regardless of case; another index is another input.
+    ShaderReflectionData source = { ShaderStage::Vertex, { }, { } };
+    source.inputs = { { "color", 0, 4 }, { "COLOR", 1, 4 } };
+    MergeReflection(source, vertex);
+    REQUIRE(vertex.inputs.size() == 4);
+    CHECK_EQ(vertex.inputs[3].semanticIndex, 1u);
+
+    // Arrays take the larger count, and unbounded wins; constant buffers the larger size.
+    ShaderReflectionData target = { ShaderStage::Pixel, { }, { } };
+    target.bindings = { MakeBinding("a", ShaderBindingType::Texture, 0, 4), MakeBinding("b", ShaderBindingType::Texture, 8, 4),
+                        MakeBinding("c", ShaderBindingType::ConstantBuffer, 0, 1, 16) };
+    source = { ShaderStage::Pixel, { }, { } };
+    source.bindings = { MakeBinding("a", ShaderBindingType::Texture, 0, 8), MakeBinding("b", ShaderBindingType::Texture, 8, 0),
+                        MakeBinding("c", ShaderBindingType::ConstantBuffer, 0, 1, 48), MakeBinding("d", ShaderBindingType::Buffer, 8) };
+    MergeReflection(source, target);
+    REQUIRE(target.bindings.size() == 4);  // A buffer at t8 is not the texture at t8.
+    CHECK_EQ(target.bindings[0].count, 8u);
+    CHECK_EQ(target.bindings[1].count, 0u);
+    CHECK_EQ(target.bindings[2].size, 48u);
+    MergeReflection(source, target);
+    CHECK_EQ(target.bindings.size(), size_t(4));
+}
+
+// The sample's three root signatures: root constants, then root descriptors, then tables.
+TEST(ShaderLayoutOrdersParameters) {
+    ShaderReflectionData vertex, pixel;
+    LoadScene(vertex, pixel);
+    RootLayout scene;
+    REQUIRE(scene.Build({ vertex, pixel }, GetSceneOptions()));
+
+    const std::vector<RootParameterLayout> &parameters = scene.GetParameters();
+    REQUIRE(parameters.size() == 3);
+    CHECK_EQ((uint32_t) parameters[0].type, (uint32_t) RootParameterType::Constants);
+    CHECK_EQ((uint32_t) parameters[0].visibility, (uint32_t) ShaderVisibility::Vertex);
+    CHECK_EQ(parameters[0].constantCount, 4u);
+    CHECK_EQ((uint32_t) parameters[1].type, (uint32_t) RootParameterType::ShaderResourceView);
+    CHECK_EQ(parameters[1].shaderRegister, 1u);
+    CHECK_EQ(parameters[1].flags, DescriptorFlags::DataStaticWhileSetAtExecute);
+    CHECK_EQ((uint32_t) parameters[2].type, (uint32_t) RootParameterType::DescriptorTable);
+    CHECK_EQ((uint32_t) parameters[2].visibility, (uint32_t) ShaderVisibility::Pixel);
+    REQUIRE(parameters[2].ranges.size() == 1);
+    CHECK_EQ(parameters[2].ranges[0].space, 1u);
+    CHECK_EQ(parameters[2].ranges[0].count, 0u);
+    CHECK_EQ(parameters[2].ranges[0].flags, DescriptorFlags::DescriptorsVolatile | DescriptorFlags::DataStaticWhileSetAtExecute);
+    CHECK_EQ(scene.GetCost(), 7u);
+
+    const std::vector<StaticSamplerLayout> &samplers = scene.GetStaticSamplers();
+    REQUIRE(samplers.size() == 2);
+    CHECK_EQ(samplers[0].sampler, 0u);
+    CHECK_EQ(samplers[1].shaderRegister, 1u);
+    CHECK_EQ(samplers[1].sampler, 1u);
+    CHECK_EQ((uint32_t) samplers[1].visibility, (uint32_t) ShaderVisibility::Pixel);
+
+    CHECK(scene.AllowsInputLayout());
+    CHECK(!scene.DeniesStage(ShaderStage::Vertex));
+    CHECK(!scene.DeniesStage(ShaderStage::Pixel));
+    CHECK_EQ(scene.FindParameter("DrawConstants"), 0u);
+    CHECK_EQ(scene.FindParameter("g_objects"), 1u);
+    CHECK_EQ(scene.FindParameter("g_textures"), 2u);
+    CHECK_EQ(scene.FindParameter("g_sampler"), RootLayout::InvalidIndex);
+
+    // The upscale vertex shader binds nothing and reads no vertex buffers.
+    RootLayoutOptions options;
+    options.staticSamplers = { { "g_sampler", 2 } };
+    RootLayout upscale;
+    REQUIRE(upscale.Build({ LoadReflection("UpscaleVertexShader.txt"), LoadReflection("UpscalePixelShader.txt") }, options));
+    REQUIRE(upscale.GetParameters().size() == 2);
+    CHECK_EQ(upscale.FindParameter("UpscaleConstants"), 0u);
+    CHECK_EQ(upscale.FindParameter("g_scene"), 1u);
+    CHECK_EQ((uint32_t) upscale.GetParameters()[0].visibility, (uint32_t) ShaderVisibility::Pixel);
+    CHECK(upscale.DeniesStage(ShaderStage::Vertex));
+    CHECK(!upscale.DeniesStage(ShaderStage::Pixel));
+    CHECK(!upscale.AllowsInputLayout());
+
+    options.staticSamplers = { { "g_sampler", 1 } };
+    RootLayout overlay;
+    REQUIRE(overlay.Build({ LoadReflection("OverlayVertexShader.txt"), LoadReflection("OverlayPixelShader.txt") }, options));
+    REQUIRE(overlay.GetParameters().size() == 3);
+    CHECK_EQ(overlay.FindParameter("OverlayConstants"), 0u);
+    CHECK_EQ(overlay.FindParameter("g_quads"), 1u);
+    CHECK_EQ(overlay.FindParameter("g_atlas"), 2u);
+    CHECK(!overlay.DeniesStage(ShaderStage::Vertex));
+    CHECK(!overlay.AllowsInputLayout());
+}
+
+// Tables merge contiguous registers, keep samplers apart and come in visibility order;
+// over MaxCost the largest root constants move into root descriptors.
+TEST(ShaderLayoutBuildsTablesWithinBudget) {
+    ShaderReflectionData vertex = { ShaderStage::Vertex, { }, { } };
+    vertex.bindings = { MakeBinding("shared", ShaderBindingType::Texture, 8) };
+    ShaderReflectionData pixel = { ShaderStage::Pixel, { }, { } };
+    pixel.bindings = { MakeBinding("t2", ShaderBindingType::Texture, 2), MakeBinding("t0", ShaderBindingType::Texture, 0),
+                       MakeBinding("t1", ShaderBindingType::Texture, 1), MakeBinding("t4", ShaderBindingType::Texture, 4),
+                       MakeBinding("u0", ShaderBindingType::ReadWrite, 0), MakeBinding("linear", ShaderBindingType::Sampler, 3),
+                       MakeBinding("shared", ShaderBindingType::Texture, 8),
+                       MakeBinding("big", ShaderBindingType::ConstantBuffer, 1, 1, 256) };
+    RootLayoutOptions options;
+    options.flags = { { "big", DescriptorFlags::DescriptorsVolatile | DescriptorFlags::DataVolatile } };
+    RootLayout layout;
+    REQUIRE(layout.Build({ vertex, pixel }, options));
+
+    const std::vector<RootParameterLayout> &parameters = layout.GetParameters();
+    REQUIRE(parameters.size() == 4);
+    CHECK_EQ((uint32_t) parameters[0].type, (uint32_t) RootParameterType::ConstantBufferView);  // Too large for constants.
+    CHECK_EQ(parameters[0].flags, DescriptorFlags::DataVolatile);
+    CHECK_EQ((uint32_t) parameters[1].visibility, (uint32_t) ShaderVisibility::All);
+    CHECK_EQ(parameters[1].ranges.size(), size_t(1));
+
+    const RootParameterLayout &table = parameters[2];
+    CHECK_EQ((uint32_t) table.visibility, (uint32_t) ShaderVisibility::Pixel);
+    REQUIRE(table.ranges.size() == 3);
+    CHECK_EQ(table.ranges[0].baseRegister, 0u);
+    CHECK_EQ(table.ranges[0].count, 3u);
+    REQUIRE(table.ranges[0].names.size() == 3);
+    CHECK_EQ(table.ranges[0].names[2], std::string("t2"));
+    CHECK_EQ(table.ranges[1].baseRegister, 4u);
+    CHECK_EQ((uint32_t) table.ranges[2].type, (uint32_t) ShaderBindingType::ReadWrite);
+    CHECK_EQ(table.ranges[2].flags, DescriptorFlags::DataVolatile);
+    REQUIRE(parameters[3].ranges.size() == 1);
+    CHECK_EQ((uint32_t) parameters[3].ranges[0].type, (uint32_t) ShaderBindingType::Sampler);
+    CHECK_EQ(layout.FindParameter("t1"), 2u);
+    CHECK_EQ(layout.FindParameter("linear"), 3u);
+    CHECK(layout.GetStaticSamplers().empty());
+
+    // Five constant buffers of 16 values cost 80; two become root descriptors, those with
+    // the highest registers since all are the same size.
+    ShaderReflectionData constants = { ShaderStage::Vertex, { }, { } };
+    for (uint32_t i = 0; i < 5; i++) {
+        constants.bindings.push_back(MakeBinding("constants", ShaderBindingType::ConstantBuffer, i, 1, 64));
+    }
+    REQUIRE(layout.Build({ constants }, RootLayoutOptions()));
+    REQUIRE(layout.GetParameters().size() == 5);
+    for (uint32_t i = 0; i < 5; i++) {
+        const RootParameterLayout &parameter = layout.GetParameters()[i];
+        CHECK_EQ((uint32_t) parameter.type, (uint32_t) (i < 3 ? RootParameterType::Constants : RootParameterType::ConstantBufferView));
+        CHECK_EQ(parameter.shaderRegister, i);
+    }
+    CHECK_EQ(layout.GetCost(), 52u);
+    CHECK(layout.DeniesStage(ShaderStage::Pixel));
+
+    // A texture and a buffer at the same register cannot share a root signature.
+    ShaderReflectionData conflicting = { ShaderStage::Pixel, { }, { } };
+    conflicting.bindings = { MakeBinding("objects", ShaderBindingType::Texture, 1) };
+    CHECK(!layout.Build({ vertex, conflicting, LoadReflection("VertexShader.txt") }, options));
+}
+
+// The key identifies the root signature: names do not matter, registers and samplers do.
+TEST(ShaderLayoutKeyIgnoresNames) {
+    ShaderReflectionData vertex, pixel;
+    LoadScene(vertex, pixel);
+    RootLayout scene;
+    REQUIRE(scene.Build({ vertex, pixel }, GetSceneOptions()));
+
+    ShaderReflectionData renamedVertex = vertex, renamedPixel = pixel;
+    for (ShaderBinding &binding : renamedVertex.bindings) {
+        binding.name += "Renamed";
+    }
+    for (ShaderBinding &binding : renamedPixel.bindings) {
+        binding.name += "Renamed";
+    }
+    RootLayoutOptions options;
+    options.staticSamplers = { { "g_samplerRenamed", 0 }, { "g_pointSamplerRenamed", 1 } };
+    options.flags = { { "g_texturesRenamed", DescriptorFlags::DescriptorsVolatile | DescriptorFlags::DataStaticWhileSetAtExecute } };
+    RootLayout renamed;
+    REQUIRE(renamed.Build({ renamedPixel, renamedVertex }, options));  // Stage order does not matter either.
+    CHECK_EQ(renamed.GetKey(), scene.GetKey());
+    CHECK_EQ(renamed.FindParameter("g_objects"), RootLayout::InvalidIndex);
+    CHECK_EQ(renamed.FindParameter("g_objectsRenamed"), 1u);
+
+    ShaderReflectionData moved = vertex;
+    moved.bindings[0].shaderRegister = 2;
+    RootLayout other;
+    REQUIRE(other.Build({ moved, pixel }, GetSceneOptions()));
+    CHECK(other.GetKey() != scene.GetKey());
+
+    options = GetSceneOptions();
+    options.staticSamplers["g_pointSampler"] = 2;
+    REQUIRE(other.Build({ vertex, pixel }, options));
+    CHECK(other.GetKey() != scene.GetKey());
+
+    options = GetSceneOptions();
+    options.flags.clear();
+    REQUIRE(other.Build({ vertex, pixel }, options));
+    CHECK(other.GetKey() != scene.GetKey());
+
+    // Without vertex inputs the input assembler is not allowed.
+    ShaderReflectionData noInputs = vertex;
+    noInputs.inputs.clear();
+    REQUIRE(other.Build({ noInputs, pixel }, GetSceneOptions()));
+    CHECK(other.GetKey() != scene.GetKey());
+}
+
+// Input layouts follow the vertex shader's inputs, not the order of the attributes.
+TEST(ShaderLayoutBuildsInputLayouts) {
+    const std::vector<VertexAttribute> attributes = {
+        { "COLOR",    0, 28, 1, 0 },
+        { "TexCoord", 0, 16, 0, 12 },
+        { "POSITION", 0, 6,  0, 0 },
+    };
+
+    std::vector<VertexAttribute> layout;
+    REQUIRE(BuildInputLayout(LoadReflection("VertexShader.txt"), attributes, layout));
+    REQUIRE(layout.size() == 2);
+    CHECK_EQ(std::string(layout[0].semantic), std::string("POSITION"));
+    CHECK_EQ(layout[1].offset, 12u);
+
+    REQUIRE(BuildInputLayout(LoadReflection("VertexShaderColor.txt"), attributes, layout));
+    REQUIRE(layout.size() == 3);
+    CHECK_EQ(layout[2].slot, 1u);
+
+    std::string missing;
+    std::vector<VertexAttribute> withoutColor(attributes.begin() + 1, attributes.end());
+    CHECK(!BuildInputLayout(LoadReflection("VertexShaderColor.txt"), withoutColor, layout, &missing));
+    CHECK_EQ(missing, std::string("COLOR"));
+    CHECK(BuildInputLayout(LoadReflection("UpscaleVertexShader.txt"), { }, layout));
+    CHECK(layout.empty());
+}
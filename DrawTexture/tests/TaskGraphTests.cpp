@@ -0,0 +1,220 @@
+#include "TaskGraph.h"
+#include "Test.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t WorkerCount = 3;
+
+// Numbers the tasks in the order they finish.
+class FinishOrder {
+public:
+    explicit FinishOrder(size_t taskCount) : order(taskCount, UINT32_MAX) { }
+
+    TaskFunc Record(TaskHandle handle) {
+        return [this, handle]() {
+            order[handle] = next++;
+            return true;
+        };
+    }
+
+    uint32_t operator[](TaskHandle handle) const { return order[handle]; }
+
+private:
+    std::vector<uint32_t> order;
+    std::atomic<uint32_t> next { 0 };
+};
+
+} // namespace
+
+// A random graph of tasks with up to two dependencies each: every task runs once, after
+// all of its dependencies have finished.
+TEST(TaskGraphRunsDependenciesFirst) {
+    const uint32_t taskCount = 200;
+    TestRandom random(42);
+    for (uint32_t workerCount : { 0u, WorkerCount }) {
+        TaskGraph graph;
+        FinishOrder order(taskCount);
+        std::vector<std::vector<TaskHandle>> dependencies(taskCount);
+        for (TaskHandle handle = 0; handle < taskCount; handle++) {
+            TaskHandle added;
+            if (handle == 0 || random.Below(4) == 0) {
+                added = graph.Add("Root", order.Record(handle));
+            } else if (random.Below(2) == 0) {
+                dependencies[handle] = { random.Below(handle) };
+                added = graph.Add("One", order.Record(handle), { dependencies[handle][0] });
+            } else {
+                dependencies[handle] = { random.Below(handle), random.Below(handle) };
+                added = graph.Add("Two", order.Record(handle), { dependencies[handle][0], dependencies[handle][1] });
+            }
+            REQUIRE(added == handle);
+        }
+
+        CHECK(graph.Run(workerCount));
+        uint32_t misordered = 0;
+        for (TaskHandle handle = 0; handle < taskCount; handle++) {
+            CHECK(order[handle] < taskCount);
+            CHECK(graph.GetTiming(handle).start >= 0.0);
+            for (TaskHandle dependency : dependencies[handle]) {
+                misordered += order[dependency] > order[handle];
+                misordered += graph.GetTiming(dependency).end > graph.GetTiming(handle).start;
+            }
+        }
+        CHECK_EQ(misordered, 0u);
+    }
+
+    // A dependency must already exist.
+    TaskGraph graph;
+    TaskHandle first = graph.Add("First", []() { return true; });
+    CHECK_EQ(graph.Add("Self", []() { return true; }, { first + 1 }), TaskGraph::InvalidHandle);
+    CHECK_EQ(graph.GetTaskCount(), 1u);
+}
+
+// Main-thread tasks run on the thread that called Run(), however many workers are idle,
+// including ones that depend on tasks that ran on a worker.
+TEST(TaskGraphPinsTasksToMainThread) {
+    std::thread::id mainThread = std::this_thread::get_id();
+    std::atomic<uint32_t> wrongThread { 0 };
+    auto mainTask = [&]() {
+        wrongThread += std::this_thread::get_id() != mainThread;
+        return true;
+    };
+    auto anyTask = [&]() {
+        // Long enough for the workers to be waiting when the main-thread tasks become ready.
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return true;
+    };
+
+    TaskGraph graph;
+    std::vector<TaskHandle> mainTasks;
+    for (uint32_t i = 0; i < 20; i++) {
+        TaskHandle previous = graph.Add("Any", anyTask);
+        mainTasks.push_back(graph.Add("Main", mainTask, { previous }, TaskThread::Main));
+    }
+    CHECK(graph.Run(WorkerCount));
+    CHECK_EQ(wrongThread.load(), 0u);
+    for (TaskHandle handle : mainTasks) {
+        CHECK_EQ(graph.GetTiming(handle).thread, 0u);
+    }
+}
+
+// A failure drops every task that has not started, dependents or not; the tasks already
+// running finish first.
+TEST(TaskGraphCancelsAfterFailure) {
+    std::atomic<uint32_t> runCount { 0 };
+    auto succeed = [&]() {
+        runCount++;
+        return true;
+    };
+
+    // Without workers the ready tasks run in the order they were added.
+    TaskGraph graph;
+    TaskHandle before = graph.Add("Before", succeed);
+    TaskHandle failing = graph.Add("Failing", [&]() {
+        runCount++;
+        return false;
+    });
+    TaskHandle independent = graph.Add("Independent", succeed);
+    TaskHandle dependent = graph.Add("Dependent", succeed, { failing });
+    TaskHandle indirect = graph.Add("Indirect", succeed, { dependent, before });
+    CHECK(!graph.Run(0));
+    CHECK_EQ(runCount.load(), 2u);
+    CHECK(graph.GetTiming(before).start >= 0.0);
+    CHECK(graph.GetTiming(failing).start >= 0.0);
+    CHECK_EQ(graph.GetTiming(independent).start, -1.0);
+    CHECK_EQ(graph.GetTiming(dependent).start, -1.0);
+    CHECK_EQ(graph.GetTiming(indirect).start, -1.0);
+
+    // The graph can run again, and with workers no dependent of the failure runs.
+    runCount = 0;
+    TaskGraph wide;
+    TaskHandle root = wide.Add("Failing", []() { return false; });
+    for (uint32_t i = 0; i < 50; i++) {
+        wide.Add("Dependent", succeed, { root });
+    }
+    for (int run = 0; run < 2; run++) {
+        CHECK(!wide.Run(WorkerCount));
+        CHECK_EQ(runCount.load(), 0u);
+    }
+}
+
+// The first exception reaches the caller of Run() once the workers have stopped, and
+// cancels like a failure.
+TEST(TaskGraphRethrowsExceptions) {
+    std::atomic<uint32_t> runCount { 0 };
+    for (uint32_t workerCount : { 0u, WorkerCount }) {
+        TaskGraph graph;
+        TaskHandle throwing = graph.Add("Throwing", []() -> bool { throw std::runtime_error("task failed"); });
+        TaskHandle dependent = graph.Add("Dependent", [&]() {
+            runCount++;
+            return true;
+        }, { throwing });
+
+        std::string message;
+        try {
+            graph.Run(workerCount);
+        } catch (const std::runtime_error &error) {
+            message = error.what();
+        }
+        CHECK_EQ(message, std::string("task failed"));
+        CHECK_EQ(runCount.load(), 0u);
+        CHECK(graph.GetTiming(throwing).end >= 0.0);
+        CHECK_EQ(graph.GetTiming(dependent).start, -1.0);
+    }
+
+    // A task that fails without throwing does not rethrow an earlier run's exception.
+    TaskGraph graph;
+    bool fail = false;
+    graph.Add("Task", [&]() -> bool {
+        if (!fail) {
+            throw std::runtime_error("first run");
+        }
+        return false;
+    });
+    bool threw = false;
+    try {
+        graph.Run(0);
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+    fail = true;
+    CHECK(!graph.Run(0));
+}
+
+// Without workers the order is known: Load, Shaders, then Parse, which was queued when
+// Load finished, then Upload. Parse finished after Shaders, so the path runs through it.
+TEST(TaskGraphReportsCriticalPath) {
+    auto work = []() {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return true;
+    };
+
+    TaskGraph graph;
+    TaskHandle load = graph.Add("Load", work);
+    TaskHandle shaders = graph.Add("Shaders", work);
+    TaskHandle parse = graph.Add("Parse", work, { load });
+    TaskHandle upload = graph.Add("Upload", work, { shaders, parse });
+    CHECK(graph.GetCriticalPath().empty());  // Nothing has run.
+
+    CHECK(graph.Run(0));
+    std::vector<TaskHandle> expected = { load, parse, upload };
+    CHECK(graph.GetCriticalPath() == expected);
+    CHECK(graph.GetTiming(shaders).end < graph.GetTiming(parse).start);
+    CHECK(graph.GetTotalTime() >= graph.GetTiming(upload).end);
+    CHECK_EQ(std::string(graph.GetName(parse)), std::string("Parse"));
+
+    // After a failure the path ends at the task that finished last, the failed one.
+    TaskGraph failing;
+    TaskHandle first = failing.Add("First", work);
+    TaskHandle broken = failing.Add("Broken", []() { return false; }, { first });
+    failing.Add("Never", work, { broken });
+    CHECK(!failing.Run(0));
+    expected = { first, broken };
+    CHECK(failing.GetCriticalPath() == expected);
+}
@@ -0,0 +1,235 @@
+#include "TilePageCache.h"
+#include "Test.h"
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+using TileKey = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+// Tile mappings of the reserved resources as the GPU sees them after each batch.
+class MappingModel {
+public:
+    // Applies a batch the way TextureStreamer issues it: one UpdateTileMappings call per
+    // texture, so each texture must form one run. Returns false for a malformed batch.
+    bool Apply(const std::vector<TileMappingUpdate> &updates) {
+        bool valid = true;
+        for (size_t i = 0; i < updates.size(); i++) {
+            const TileMappingUpdate &update = updates[i];
+            if (i > 0) {
+                TileKey previous(updates[i - 1].texture, updates[i - 1].mip, updates[i - 1].tile);
+                TileKey current(update.texture, update.mip, update.tile);
+                valid &= previous < current; // Sorted, one change per tile.
+            }
+            TileKey key(update.texture, update.mip, update.tile);
+            if (update.poolTile == TilePageCache::InvalidTile) {
+                mappings.erase(key);
+            } else {
+                mappings[key] = update.poolTile;
+            }
+        }
+        return valid;
+    }
+
+    void RemoveTexture(uint32_t texture) {
+        for (auto i = mappings.begin(); i != mappings.end();) {
+            i = std::get<0>(i->first) == texture ? mappings.erase(i) : std::next(i);
+        }
+    }
+
+    bool IsMapped(uint32_t texture, uint32_t mip, uint32_t tile) const {
+        return mappings.count(TileKey(texture, mip, tile)) != 0;
+    }
+
+    // No pool tile backs two texture tiles.
+    bool IsConsistent() const {
+        std::map<uint32_t, int> uses;
+        for (const auto &mapping : mappings) {
+            if (++uses[mapping.second] > 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::map<TileKey, uint32_t> mappings;
+};
+
+} // namespace
+
+TEST(TilePageCacheEvictsLeastRecentlyUsed) {
+    TilePageCache cache(4);
+    const uint32_t mipTiles[] = { 8, 2 };
+    uint32_t texture = cache.AddTexture(mipTiles, 2, 0);
+    REQUIRE(texture != TilePageCache::InvalidHandle);
+
+    cache.BeginFrame();
+    for (uint32_t tile = 0; tile < 4; tile++) {
+        REQUIRE(cache.Map(texture, 0, tile));
+    }
+    CHECK_EQ(cache.GetFreeTileCount(), 0u);
+    CHECK_EQ(cache.GetAvailableTileCount(), 0u);
+    CHECK(!cache.Map(texture, 0, 4)); // Everything is used by this frame.
+
+    // Tiles 0 and 2 are used again, so 1 and then 3 are the least recently used.
+    cache.BeginFrame();
+    CHECK(cache.Touch(texture, 0, 0));
+    CHECK(cache.Touch(texture, 0, 2));
+    CHECK(!cache.Touch(texture, 0, 5));
+    CHECK_EQ(cache.GetAvailableTileCount(), 2u);
+
+    REQUIRE(cache.Map(texture, 0, 4));
+    CHECK(!cache.IsMapped(texture, 0, 1));
+    REQUIRE(cache.Map(texture, 1, 0));
+    CHECK(!cache.IsMapped(texture, 0, 3));
+    CHECK(!cache.Map(texture, 0, 5));
+    CHECK_EQ(cache.GetEvictionCount(), uint64_t(2));
+    for (uint32_t tile : { 0u, 2u, 4u }) {
+        CHECK(cache.IsMapped(texture, 0, tile));
+    }
+
+    // A mapped tile counts as used when mapped again, without taking a pool tile.
+    cache.BeginFrame();
+    REQUIRE(cache.Map(texture, 0, 0));
+    REQUIRE(cache.Map(texture, 0, 6));
+    CHECK(!cache.IsMapped(texture, 0, 2)); // Oldest of the tiles not used by this frame.
+    CHECK_EQ(cache.GetEvictionCount(), uint64_t(3));
+}
+
+TEST(TilePageCachePinsPackedTail) {
+    TilePageCache cache(6);
+    const uint32_t mipTiles[] = { 4 };
+    uint32_t a = cache.AddTexture(mipTiles, 1, 2);
+    uint32_t b = cache.AddTexture(mipTiles, 1, 2);
+    REQUIRE(a != TilePageCache::InvalidHandle && b != TilePageCache::InvalidHandle);
+    CHECK_EQ(cache.GetAvailableTileCount(), 2u);
+
+    // Standard tiles compete for the two unpinned pool tiles; the tails are never evicted.
+    for (uint32_t frame = 0; frame < 4; frame++) {
+        cache.BeginFrame();
+        REQUIRE(cache.Map(frame % 2 ? b : a, 0, frame));
+    }
+    CHECK_EQ(cache.GetEvictionCount(), uint64_t(2));
+
+    std::vector<TileMappingUpdate> updates;
+    cache.TakeUpdates(updates);
+    uint32_t tailUpdates = 0;
+    for (const TileMappingUpdate &update : updates) {
+        tailUpdates += update.mip == 1;
+    }
+    CHECK_EQ(tailUpdates, 4u);
+
+    // A third tail does not fit next to the two pinned ones plus this frame's tiles.
+    uint32_t c = cache.AddTexture(mipTiles, 1, 3);
+    CHECK_EQ(c, TilePageCache::InvalidHandle);
+
+    // Removing a texture returns its tail and its mapped tiles to the free list.
+    cache.RemoveTexture(a);
+    CHECK_EQ(cache.GetFreeTileCount(), 3u);
+    cache.BeginFrame();
+    c = cache.AddTexture(mipTiles, 1, 3);
+    CHECK_EQ(c, a); // The handle is reused.
+    CHECK_EQ(cache.GetAvailableTileCount(), 1u);
+}
+
+TEST(TilePageCacheBatchesUpdates) {
+    TilePageCache cache(3);
+    const uint32_t mipTiles[] = { 4, 1 };
+    uint32_t a = cache.AddTexture(mipTiles, 2, 0);
+    uint32_t b = cache.AddTexture(mipTiles, 2, 0);
+
+    cache.BeginFrame();
+    REQUIRE(cache.Map(b, 1, 0));
+    REQUIRE(cache.Map(a, 0, 3));
+    REQUIRE(cache.Map(b, 0, 2));
+
+    std::vector<TileMappingUpdate> updates;
+    cache.TakeUpdates(updates);
+    REQUIRE(updates.size() == 3);
+    CHECK_EQ(updates[0].texture, a);
+    CHECK_EQ(updates[1].texture, b);
+    CHECK_EQ(updates[1].mip, 0u);
+    CHECK_EQ(updates[2].mip, 1u);
+    CHECK_EQ(updates[0].poolTile, 1u); // Pool tiles are handed out in ascending order.
+
+    // b's mip 1 tile is evicted and mapped again in the same batch: only the final mapping
+    // is sent. a's tile is evicted: its unmap is sent.
+    cache.BeginFrame();
+    REQUIRE(cache.Map(a, 0, 0)); // Evicts b mip 1.
+    cache.BeginFrame();
+    REQUIRE(cache.Map(b, 1, 0)); // Evicts a tile 3.
+    cache.TakeUpdates(updates);
+    REQUIRE(updates.size() == 3);
+    CHECK_EQ(updates[0].texture, a);
+    CHECK_EQ(updates[0].tile, 0u);
+    CHECK_EQ(updates[1].texture, a);
+    CHECK_EQ(updates[1].tile, 3u);
+    CHECK_EQ(updates[1].poolTile, TilePageCache::InvalidTile);
+    CHECK_EQ(updates[2].texture, b);
+    CHECK(updates[2].poolTile != TilePageCache::InvalidTile);
+
+    cache.TakeUpdates(updates);
+    CHECK(updates.empty());
+
+    // Updates of a removed texture are dropped; its resource is released anyway.
+    cache.BeginFrame();
+    REQUIRE(cache.Map(b, 0, 1));
+    cache.RemoveTexture(b);
+    cache.TakeUpdates(updates);
+    CHECK(updates.empty());
+}
+
+// Random maps and touches over several textures; applying the batches to a model of
+// the GPU page tables must give the same mappings as the cache reports.
+TEST(TilePageCacheMatchesModel) {
+    TilePageCache cache(64);
+    MappingModel model;
+    TestRandom random(36);
+
+    const uint32_t mipTiles[] = { 64, 16, 4 };
+    std::vector<uint32_t> textures;
+    for (int i = 0; i < 6; i++) {
+        textures.push_back(cache.AddTexture(mipTiles, 3, 1 + i % 2));
+    }
+
+    std::vector<TileMappingUpdate> updates;
+    for (int frame = 0; frame < 2000; frame++) {
+        cache.BeginFrame();
+        if (frame % 250 == 249) {
+            size_t index = random.Below(uint32_t(textures.size()));
+            cache.RemoveTexture(textures[index]);
+            model.RemoveTexture(textures[index]);
+            textures[index] = cache.AddTexture(mipTiles, 3, 2);
+            REQUIRE(textures[index] != TilePageCache::InvalidHandle);
+        }
+
+        uint32_t operations = 10 + random.Below(40);
+        for (uint32_t i = 0; i < operations; i++) {
+            uint32_t texture = textures[random.Below(uint32_t(textures.size()))];
+            uint32_t mip = random.Below(3);
+            uint32_t tile = random.Below(cache.GetTileCount(texture, mip));
+            bool available = cache.GetAvailableTileCount() > 0 || cache.IsMapped(texture, mip, tile);
+            if (random.Below(3) == 0) {
+                CHECK_EQ(cache.Touch(texture, mip, tile), cache.IsMapped(texture, mip, tile));
+            } else {
+                REQUIRE(cache.Map(texture, mip, tile) == available);
+            }
+        }
+
+        cache.TakeUpdates(updates);
+        REQUIRE(model.Apply(updates));
+        REQUIRE(model.IsConsistent());
+
+        for (uint32_t texture : textures) {
+            for (uint32_t mip = 0; mip < 3; mip++) {
+                for (uint32_t tile = 0; tile < mipTiles[mip]; tile++) {
+                    REQUIRE(model.IsMapped(texture, mip, tile) == cache.IsMapped(texture, mip, tile));
+                }
+            }
+        }
+    }
+    CHECK(cache.GetEvictionCount() > 0);
+}
@@ -4,59 +4,48 @@
 #include <dxgi1_6.h>
 #include <wrl.h>
 
+#include <algorithm>
+#include <vector>
+
+#include "Log.h"
+#include "Renderer.h"
+
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 
-inline void ThrowIfFailed(HRESULT hr, LPCWSTR file, int line) {
+inline void ThrowIfFailed(HRESULT hr, const LogSite &site) {
     if (FAILED(hr)) {
-        TCHAR buffer[256];
-        wsprintf(buffer, TEXT("\nFILE:[%s]\nLINE:[%d]\n\n"), file, line);
-        OutputDebugString(buffer);
+        WriteLog(site, hr);
+        FlushLog();
         throw hr;
     }
 }
 
-#define __FILENAME__ (wcsrchr(__FILEW__, TEXT('\\')) ? wcsrchr(__FILEW__, TEXT('\\')) + 1 : __FILEW__)
-#define ThrowIfFailed(hr) ThrowIfFailed(hr, __FILENAME__, __LINE__);
+#define ThrowIfFailed(hr) do { static constexpr LogSite throwSite = { LogLevel::Error, __FILE__, __LINE__, "Failed with %H" }; ThrowIfFailed(hr, throwSite); } while (0)
 
 constexpr UINT Width = 640;
 constexpr UINT Height = 480;
-constexpr UINT FrameCount = 2;
+constexpr UINT MinWindowCount = 2;
 
-// Win32 objects.
+// Win32 objects. One window per monitor.
 HINSTANCE hInstance;
-HWND hWindow;
-
-// Pipeline objects.
-ComPtr<ID3D12Device> device;
-ComPtr<ID3D12CommandQueue> commandQueue;
-ComPtr<IDXGISwapChain4> swapChain;
-ComPtr<ID3D12DescriptorHeap> rtvHeap;
-UINT rtvDescriptorSize;
-ComPtr<ID3D12Resource> renderTargets[FrameCount];
-ComPtr<ID3D12CommandAllocator> commandAllocator;
-ComPtr<ID3D12GraphicsCommandList> commandList;
+std::vector<HWND> windows;
+
+// Pipeline objects. The renderer owns the device and the swap chains; the rest is shared by all windows.
+Renderer renderer;
 ComPtr<ID3D12RootSignature> rootSignature;
 ComPtr<ID3D12PipelineState> pipelineState;
-D3D12_VIEWPORT viewport;
-D3D12_RECT scissorRect;
 
 // Resources.
 ComPtr<ID3D12Resource> vertexBuffer;
 D3D12_VERTEX_BUFFER_VIEW vbView;
 
-// Synchronization objects.
-ComPtr<ID3D12Fence> fence;
-UINT64 fenceValue;
-HANDLE fenceEvent;
-UINT frameIndex;
-
 HRESULT InitWindow();
 HRESULT InitDirectX();
 HRESULT InitResource();
 void OnUpdate();
 void OnRender();
-void WaitForPrevFrame();
+void RecordScene(ID3D12GraphicsCommandList *commandList, const RenderView &view);
 D3D12_BLEND_DESC GetDefaultBlendDesc();
 D3D12_RASTERIZER_DESC GetDefaultRasterizerDesc();
 D3D12_RESOURCE_DESC &GetBufferResourceDesc(
@@ -64,13 +53,6 @@ D3D12_RESOURCE_DESC &GetBufferResourceDesc(
     UINT64 width,
     D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE,
     UINT64 alignment = 0);
-D3D12_RESOURCE_BARRIER &GetTransitionBarrier(
-    D3D12_RESOURCE_BARRIER &barrier,
-    ID3D12Resource *pResource,
-    D3D12_RESOURCE_STATES before,
-    D3D12_RESOURCE_STATES after,
-    UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-    D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE);
 LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In_ int nCmdShow) {
@@ -78,6 +60,8 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In
 
     ::hInstance = hInstance;
 
+    StartLog("DrawTriangle.log");
+
     if (FAILED(InitWindow())) {
         return -10;
     }
@@ -90,10 +74,18 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE, _In_ LPSTR, _In
         return -12;
     }
 
-    ShowWindow(hWindow, nCmdShow);
+    for (HWND hwnd : windows) {
+        ShowWindow(hwnd, nCmdShow);
+    }
 
-    while (GetMessage(&msg, nullptr, 0, 0)) {
-        DispatchMessage(&msg);
+    // All windows are drawn together whenever no message is waiting.
+    while (msg.message != WM_QUIT) {
+        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            DispatchMessage(&msg);
+        } else {
+            OnUpdate();
+            OnRender();
+        }
     }
 
     return (int) msg.wParam;
@@ -118,133 +110,67 @@ HRESULT InitWindow() {
         return E_FAIL;
     }
 
-    hWindow = CreateWindow(
-        WindowClassName, TEXT("DrawTriangle - DirectX12"),
-        WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX,
-        CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
-        nullptr, nullptr, hInstance, nullptr
-    );
-
-    if (!hWindow) {
-        return E_FAIL;
-    }
-
-    // Resize Window.
-    {
-        RECT rd, rw, rc;
-        int width, height;
-
+    std::vector<RECT> monitors;
+    EnumDisplayMonitors(nullptr, nullptr, [](HMONITOR monitor, HDC, LPRECT, LPARAM data) -> BOOL {
+        MONITORINFO info;
+        info.cbSize = sizeof(info);
+        if (GetMonitorInfo(monitor, &info)) {
+            ((std::vector<RECT> *) data)->push_back(info.rcWork);
+        }
+        return true;
+    }, (LPARAM) &monitors);
+    if (monitors.empty()) {
+        RECT rd;
         GetWindowRect(GetDesktopWindow(), &rd);
-        GetWindowRect(hWindow, &rw);
-        GetClientRect(hWindow, &rc);
-
-        width = (rw.right - rw.left) - (rc.right - rc.left) + Width;
-        height = (rw.bottom - rw.top) - (rc.bottom - rc.top) + Height;
-
-        SetWindowPos(hWindow, HWND_TOP, (rd.right - width) / 2, (rd.bottom - height) / 2, width, height, 0);
+        monitors.push_back(rd);
     }
 
-    return S_OK;
-}
-
-HRESULT InitDirectX() {
-    UINT factoryFlags = 0;
-
-#ifdef _DEBUG
-    {
-        ComPtr<ID3D12Debug> debug;
-        if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debug)))) {
-            debug->EnableDebugLayer();
-            factoryFlags |= DXGI_CREATE_FACTORY_DEBUG;
+    UINT monitorCount = (UINT) monitors.size();
+    UINT windowCount = (std::max)(monitorCount, MinWindowCount);
+    for (UINT i = 0; i < windowCount; i++) {
+        TCHAR title[64];
+        wsprintf(title, TEXT("DrawTriangle - DirectX12 (%u/%u)"), i + 1, windowCount);
+
+        HWND hwnd = CreateWindow(
+            WindowClassName, title,
+            WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX,
+            CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
+            nullptr, nullptr, hInstance, nullptr
+        );
+
+        if (!hwnd) {
+            return E_FAIL;
         }
-    }
-#endif
+        windows.push_back(hwnd);
 
-    ComPtr<IDXGIFactory4> factory4;
-    ThrowIfFailed(CreateDXGIFactory2(factoryFlags, IID_PPV_ARGS(&factory4)));
+        // Resize Window. Windows sharing a monitor are centered side by side.
+        {
+            RECT rw, rc;
+            int width, height;
+            const RECT &rd = monitors[i % monitorCount];
+            int slot = (int) (i / monitorCount);
+            int slots = (int) ((windowCount - i % monitorCount + monitorCount - 1) / monitorCount);
 
-    ComPtr<IDXGIAdapter1> adapter;
-    ComPtr<IDXGIFactory6> factory6;
-    if (SUCCEEDED(factory4->QueryInterface(IID_PPV_ARGS(&factory6)))) {
-        factory6->EnumAdapterByGpuPreference(0, DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&adapter));
-    } else {
-        factory4->EnumAdapters1(0, &adapter);
-    }
-
-    ThrowIfFailed(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device)));
+            GetWindowRect(hwnd, &rw);
+            GetClientRect(hwnd, &rc);
 
-    // Command Queue
-    {
-        D3D12_COMMAND_QUEUE_DESC desc;
-        desc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-        desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
-        desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
-        desc.NodeMask = 0;
-        ThrowIfFailed(device->CreateCommandQueue(&desc, IID_PPV_ARGS(&commandQueue)));
-    }
-
-    // Swap Chain
-    {
-        DXGI_SWAP_CHAIN_DESC1 desc;
-        desc.Width = 0;
-        desc.Height = 0;
-        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        desc.Stereo = false;
-        desc.SampleDesc.Count = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-        desc.BufferCount = FrameCount;
-        desc.Scaling = DXGI_SCALING_STRETCH;
-        desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD; // DXGI_SWAP_EFFECT_DISCARD ƊԈႦȂ悤ɁIII
-        desc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
-        desc.Flags = 0;
-
-        ComPtr<IDXGISwapChain1> swapChain1;
-        ThrowIfFailed(factory4->CreateSwapChainForHwnd(
-            commandQueue.Get(),
-            hWindow,
-            &desc,
-            nullptr,
-            nullptr,
-            &swapChain1
-        ));
-
-        ThrowIfFailed(swapChain1.As(&swapChain));
-        frameIndex = swapChain->GetCurrentBackBufferIndex();
-    }
+            width = (rw.right - rw.left) - (rc.right - rc.left) + Width;
+            height = (rw.bottom - rw.top) - (rc.bottom - rc.top) + Height;
 
-    // Descriptor Heap for RTV
-    {
-        D3D12_DESCRIPTOR_HEAP_DESC desc;
-        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-        desc.NumDescriptors = FrameCount;
-        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        desc.NodeMask = 0;
-
-        ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&rtvHeap)));
-
-        rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(desc.Type);
+            SetWindowPos(hwnd, HWND_TOP, (rd.left + rd.right - slots * width) / 2 + slot * width, (rd.top + rd.bottom - height) / 2, width, height, 0);
+        }
     }
 
-    // Render Target View (RTV)
-    {
-        D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
+    return S_OK;
+}
 
-        for (UINT i = 0; i < FrameCount; i++) {
-            ThrowIfFailed(swapChain->GetBuffer(i, IID_PPV_ARGS(&renderTargets[i])));
-            device->CreateRenderTargetView(renderTargets[i].Get(), nullptr, rtvHandle);
+HRESULT InitDirectX() {
+    ThrowIfFailed(renderer.Init());
 
-            rtvHandle.ptr += rtvDescriptorSize;
-        }
+    for (HWND hwnd : windows) {
+        ThrowIfFailed(renderer.AddWindow(hwnd));
     }
 
-    // Command Allocator
-    ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator)));
-
-    // Command List
-    ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList)));
-    ThrowIfFailed(commandList->Close());
-
     // Root Signature
     {
         ComPtr<ID3DBlob> rsBlob;
@@ -256,7 +182,7 @@ HRESULT InitDirectX() {
         desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
 
         ThrowIfFailed(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1_0, &rsBlob, nullptr));
-        ThrowIfFailed(device->CreateRootSignature(0, rsBlob->GetBufferPointer(), rsBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
+        ThrowIfFailed(renderer.GetDevice()->CreateRootSignature(0, rsBlob->GetBufferPointer(), rsBlob->GetBufferSize(), IID_PPV_ARGS(&rootSignature)));
     }
 
     // Pipeline State
@@ -301,30 +227,7 @@ HRESULT InitDirectX() {
         desc.CachedPSO = { };
         desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 
-        ThrowIfFailed(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
-    }
-
-    // Viewport & Scissor Rect
-    {
-        viewport.TopLeftX = 0.0f;
-        viewport.TopLeftY = 0.0f;
-        viewport.Width = (float) Width;
-        viewport.Height = (float) Height;
-        viewport.MinDepth = 0.0f;
-        viewport.MaxDepth = 1.0f;
-
-        scissorRect.left = 0;
-        scissorRect.top = 0;
-        scissorRect.right = Width;
-        scissorRect.bottom = Height;
-    }
-
-    // Fence
-    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
-
-    fenceEvent = CreateEvent(nullptr, false, false, nullptr);
-    if (!fenceEvent) {
-        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+        ThrowIfFailed(renderer.GetDevice()->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
     }
 
     return S_OK;
@@ -348,7 +251,7 @@ HRESULT InitResource() {
 
         D3D12_RESOURCE_DESC desc;
 
-        ThrowIfFailed(device->CreateCommittedResource(
+        ThrowIfFailed(renderer.GetDevice()->CreateCommittedResource(
             &properties,
             D3D12_HEAP_FLAG_NONE,
             &GetBufferResourceDesc(desc, sizeof(vertices)),
@@ -374,59 +277,19 @@ HRESULT InitResource() {
 void OnUpdate() { }
 
 void OnRender() {
-    ThrowIfFailed(commandAllocator->Reset());
-
-    ThrowIfFailed(commandList->Reset(commandAllocator.Get(), pipelineState.Get()));
+    ThrowIfFailed(renderer.Render(RecordScene));
+}
 
+// Called for every window, on several threads at once.
+void RecordScene(ID3D12GraphicsCommandList *commandList, const RenderView &view) {
+    commandList->SetPipelineState(pipelineState.Get());
     commandList->SetGraphicsRootSignature(rootSignature.Get());
-    commandList->RSSetViewports(1, &viewport);
-    commandList->RSSetScissorRects(1, &scissorRect);
-
-    D3D12_RESOURCE_BARRIER barrier;
-    commandList->ResourceBarrier(1, &GetTransitionBarrier(
-        barrier, renderTargets[frameIndex].Get(),
-        D3D12_RESOURCE_STATE_PRESENT,
-        D3D12_RESOURCE_STATE_RENDER_TARGET));
-
-    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = rtvHeap->GetCPUDescriptorHandleForHeapStart();
-    rtvHandle.ptr += SIZE_T(INT64(rtvDescriptorSize) * INT64(frameIndex));
-
-    // Set render target.
-    commandList->OMSetRenderTargets(1, &rtvHandle, false, nullptr);
 
     float bgcolor[] = { 0.5f, 0.5f, 0.5f, 1.0f };
-    commandList->ClearRenderTargetView(rtvHandle, bgcolor, 0, nullptr);
+    commandList->ClearRenderTargetView(view.rtvHandle, bgcolor, 0, nullptr);
     commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     commandList->IASetVertexBuffers(0, 1, &vbView);
     commandList->DrawInstanced(3, 1, 0, 0);
-
-    commandList->ResourceBarrier(1, &GetTransitionBarrier(
-        barrier, renderTargets[frameIndex].Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET,
-        D3D12_RESOURCE_STATE_PRESENT));
-
-    ThrowIfFailed(commandList->Close());
-
-    // Execute commands.
-    ID3D12CommandList *commandLists[] = { commandList.Get() };
-    commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
-
-    // Flip buffers.
-    ThrowIfFailed(swapChain->Present(1, 0));
-
-    // Wait for the process to finish.
-    WaitForPrevFrame();
-}
-
-void WaitForPrevFrame() {
-    ThrowIfFailed(commandQueue->Signal(fence.Get(), ++fenceValue));
-
-    if (fence->GetCompletedValue() < fenceValue) {
-        ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, fenceEvent));
-        WaitForSingleObject(fenceEvent, INFINITE);
-    }
-
-    frameIndex = swapChain->GetCurrentBackBufferIndex();
 }
 
 D3D12_BLEND_DESC GetDefaultBlendDesc() {
@@ -478,32 +341,14 @@ D3D12_RESOURCE_DESC &GetBufferResourceDesc(
     return desc;
 }
 
-D3D12_RESOURCE_BARRIER &GetTransitionBarrier(
-    D3D12_RESOURCE_BARRIER &barrier,
-    ID3D12Resource *pResource,
-    D3D12_RESOURCE_STATES before,
-    D3D12_RESOURCE_STATES after,
-    UINT subresource,
-    D3D12_RESOURCE_BARRIER_FLAGS flags) {
-    barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier.Flags                  = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    barrier.Transition.pResource   = pResource;
-    barrier.Transition.Subresource = subresource;
-    barrier.Transition.StateBefore = before;
-    barrier.Transition.StateAfter  = after;
-
-    return barrier;
-}
-
 LRESULT CALLBACK WindowProcedure(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
     case WM_DESTROY:
-        PostQuitMessage(0);
-        return 0;
-
-    case WM_PAINT:
-        OnUpdate();
-        OnRender();
+        // Closing the last window ends the process.
+        renderer.RemoveWindow(hwnd);
+        if (renderer.GetWindowCount() == 0) {
+            PostQuitMessage(0);
+        }
         return 0;
     }
 
@@ -0,0 +1,343 @@
+#include "Renderer.h"
+
+#include <algorithm>
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+D3D12_RESOURCE_BARRIER GetTransition(ID3D12Resource *resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after) {
+    D3D12_RESOURCE_BARRIER barrier;
+    barrier.Type                   = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Flags                  = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.Transition.pResource   = resource;
+    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    barrier.Transition.StateBefore = before;
+    barrier.Transition.StateAfter  = after;
+    return barrier;
+}
+
+}
+
+Renderer::~Renderer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    // Swap chains and command lists must outlive the frames that use them.
+    if (fence) {
+        WaitIdle();
+    }
+    if (fenceEvent) {
+        CloseHandle(fenceEvent);
+    }
+}
+
+HRESULT Renderer::Init() {
+    UINT factoryFlags = 0;
+
+#ifdef _DEBUG
+    {
+        ComPtr<ID3D12Debug> debug;
+        if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debug)))) {
+            debug->EnableDebugLayer();
+            factoryFlags |= DXGI_CREATE_FACTORY_DEBUG;
+        }
+    }
+#endif
+
+    HRESULT hr = CreateDXGIFactory2(factoryFlags, IID_PPV_ARGS(&factory));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    ComPtr<IDXGIAdapter1> adapter;
+    ComPtr<IDXGIFactory6> factory6;
+    if (SUCCEEDED(factory.As(&factory6))) {
+        factory6->EnumAdapterByGpuPreference(0, DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&adapter));
+    } else {
+        factory->EnumAdapters1(0, &adapter);
+    }
+
+    hr = D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    D3D12_COMMAND_QUEUE_DESC desc;
+    desc.Type     = D3D12_COMMAND_LIST_TYPE_DIRECT;
+    desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    desc.Flags    = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    desc.NodeMask = 0;
+    hr = device->CreateCommandQueue(&desc, IID_PPV_ARGS(&commandQueue));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+    hr = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    fenceEvent = CreateEvent(nullptr, false, false, nullptr);
+    if (!fenceEvent) {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    // The rendering thread records too.
+    unsigned cores = std::thread::hardware_concurrency();
+    UINT workerCount = (std::min)(cores > 1 ? (UINT) cores - 1 : 0, UINT(MaxWorkers));
+    for (UINT i = 0; i < workerCount; i++) {
+        workers.emplace_back(&Renderer::WorkerMain, this);
+    }
+
+    return S_OK;
+}
+
+HRESULT Renderer::AddWindow(HWND hwnd) {
+    std::unique_ptr<Window> window = std::make_unique<Window>();
+    window->hwnd = hwnd;
+
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    window->width = (UINT) (std::max)(rect.right - rect.left, 1L);
+    window->height = (UINT) (std::max)(rect.bottom - rect.top, 1L);
+
+    // Swap Chain
+    {
+        DXGI_SWAP_CHAIN_DESC1 desc;
+        desc.Width = window->width;
+        desc.Height = window->height;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.Stereo = false;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        desc.BufferCount = FrameCount;
+        desc.Scaling = DXGI_SCALING_STRETCH;
+        desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD; // Not DXGI_SWAP_EFFECT_DISCARD.
+        desc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+        desc.Flags = 0;
+
+        ComPtr<IDXGISwapChain1> swapChain1;
+        HRESULT hr = factory->CreateSwapChainForHwnd(commandQueue.Get(), hwnd, &desc, nullptr, nullptr, &swapChain1);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        hr = swapChain1.As(&window->swapChain);
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    // Render Target Views
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc;
+        desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        desc.NumDescriptors = FrameCount;
+        desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        desc.NodeMask = 0;
+        HRESULT hr = device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&window->rtvHeap));
+        if (FAILED(hr)) {
+            return hr;
+        }
+
+        D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = window->rtvHeap->GetCPUDescriptorHandleForHeapStart();
+        for (UINT i = 0; i < FrameCount; i++) {
+            hr = window->swapChain->GetBuffer(i, IID_PPV_ARGS(&window->renderTargets[i]));
+            if (FAILED(hr)) {
+                return hr;
+            }
+            device->CreateRenderTargetView(window->renderTargets[i].Get(), nullptr, rtvHandle);
+            rtvHandle.ptr += rtvDescriptorSize;
+        }
+    }
+
+    // Command Allocators & List
+    for (UINT i = 0; i < FrameCount; i++) {
+        HRESULT hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&window->commandAllocators[i]));
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+    HRESULT hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, window->commandAllocators[0].Get(), nullptr, IID_PPV_ARGS(&window->commandList));
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = window->commandList->Close();
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    window->backBuffer = 0;
+    window->result = S_OK;
+    windows.push_back(std::move(window));
+    return S_OK;
+}
+
+HRESULT Renderer::RemoveWindow(HWND hwnd) {
+    auto found = std::find_if(windows.begin(), windows.end(), [&](const std::unique_ptr<Window> &window) { return window->hwnd == hwnd; });
+    if (found == windows.end()) {
+        return S_OK;
+    }
+
+    HRESULT hr = WaitIdle();
+    windows.erase(found);
+    return hr;
+}
+
+HRESULT Renderer::Render(const RecordFunc &record) {
+    if (windows.empty()) {
+        return S_OK;
+    }
+
+    // The allocators of this slot were last used FrameCount frames ago.
+    frameSlot = UINT(frameNumber % FrameCount);
+    HRESULT hr = WaitForFence(frameFenceValues[frameSlot]);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    for (const std::unique_ptr<Window> &window : windows) {
+        window->backBuffer = window->swapChain->GetCurrentBackBufferIndex();
+    }
+
+    this->record = &record;
+    nextWindow = 0;
+    if (windows.size() > 1 && !workers.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers = (UINT) workers.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        RecordWindows();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busyWorkers == 0; });
+    } else {
+        RecordWindows();
+    }
+    this->record = nullptr;
+
+    commandLists.clear();
+    for (const std::unique_ptr<Window> &window : windows) {
+        if (FAILED(window->result)) {
+            return window->result;
+        }
+        commandLists.push_back(window->commandList.Get());
+    }
+    commandQueue->ExecuteCommandLists((UINT) commandLists.size(), commandLists.data());
+
+    // All windows' work is queued before the first present, so no window waits for the
+    // GPU on behalf of another.
+    for (const std::unique_ptr<Window> &window : windows) {
+        hr = window->swapChain->Present(1, 0);
+        if (FAILED(hr)) {
+            return hr;
+        }
+    }
+
+    hr = commandQueue->Signal(fence.Get(), ++fenceValue);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    frameFenceValues[frameSlot] = fenceValue;
+    frameNumber++;
+    return S_OK;
+}
+
+HRESULT Renderer::WaitIdle() {
+    HRESULT hr = commandQueue->Signal(fence.Get(), ++fenceValue);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    return WaitForFence(fenceValue);
+}
+
+HRESULT Renderer::WaitForFence(UINT64 value) {
+    if (fence->GetCompletedValue() >= value) {
+        return S_OK;
+    }
+    HRESULT hr = fence->SetEventOnCompletion(value, fenceEvent);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    WaitForSingleObject(fenceEvent, INFINITE);
+    return S_OK;
+}
+
+void Renderer::RecordWindows() {
+    for (UINT index = nextWindow++; index < (UINT) windows.size(); index = nextWindow++) {
+        windows[index]->result = RecordWindow(index);
+    }
+}
+
+HRESULT Renderer::RecordWindow(UINT index) {
+    Window &window = *windows[index];
+    ID3D12CommandAllocator *allocator = window.commandAllocators[frameSlot].Get();
+    ID3D12GraphicsCommandList *commandList = window.commandList.Get();
+    ID3D12Resource *renderTarget = window.renderTargets[window.backBuffer].Get();
+
+    HRESULT hr = allocator->Reset();
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = commandList->Reset(allocator, nullptr);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    D3D12_RESOURCE_BARRIER barrier = GetTransition(renderTarget, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    commandList->ResourceBarrier(1, &barrier);
+
+    RenderView view;
+    view.hwnd = window.hwnd;
+    view.index = index;
+    view.width = window.width;
+    view.height = window.height;
+    view.rtvHandle = window.rtvHeap->GetCPUDescriptorHandleForHeapStart();
+    view.rtvHandle.ptr += SIZE_T(INT64(rtvDescriptorSize) * INT64(window.backBuffer));
+    view.viewport = { 0.0f, 0.0f, (float) window.width, (float) window.height, 0.0f, 1.0f };
+    view.scissorRect = { 0, 0, (LONG) window.width, (LONG) window.height };
+
+    commandList->OMSetRenderTargets(1, &view.rtvHandle, false, nullptr);
+    commandList->RSSetViewports(1, &view.viewport);
+    commandList->RSSetScissorRects(1, &view.scissorRect);
+
+    (*record)(commandList, view);
+
+    barrier = GetTransition(renderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+    commandList->ResourceBarrier(1, &barrier);
+
+    return commandList->Close();
+}
+
+void Renderer::WorkerMain() {
+    UINT64 seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        RecordWindows();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            done.notify_one();
+        }
+    }
+}
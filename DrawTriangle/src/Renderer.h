@@ -0,0 +1,99 @@
+#pragma once
+
+#include <d3d12.h>
+#include <dxgi1_6.h>
+#include <wrl.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What a window's command list draws into. The back buffer is already a bound render
+// target with the viewport and scissor rectangle set.
+struct RenderView {
+    HWND hwnd;
+    UINT index;     // Position of the window in the renderer.
+    UINT width;
+    UINT height;
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
+    D3D12_VIEWPORT viewport;
+    D3D12_RECT scissorRect;
+};
+
+// Records the commands of one window. Called on several threads at once, one window
+// each, so it must only read shared state.
+using RecordFunc = std::function<void(ID3D12GraphicsCommandList *commandList, const RenderView &view)>;
+
+// Owns the device and the direct queue, and a swap chain with its own command lists for
+// each window. Render() records all windows in parallel on worker threads, submits their
+// command lists with one ExecuteCommandLists and presents the swap chains back to back.
+// Up to FrameCount frames are in flight; one fence covers all windows.
+class Renderer {
+public:
+    static constexpr UINT FrameCount = 2;
+    static constexpr UINT MaxWorkers = 7;
+
+    ~Renderer();
+
+    HRESULT Init();
+
+    ID3D12Device *GetDevice() const { return device.Get(); }
+    ID3D12CommandQueue *GetCommandQueue() const { return commandQueue.Get(); }
+
+    // The swap chain has the size of the window's client area.
+    HRESULT AddWindow(HWND hwnd);
+    // Waits for the GPU before releasing the window's swap chain.
+    HRESULT RemoveWindow(HWND hwnd);
+    UINT GetWindowCount() const { return (UINT) windows.size(); }
+
+    HRESULT Render(const RecordFunc &record);
+    HRESULT WaitIdle();
+
+private:
+    struct Window {
+        HWND hwnd;
+        UINT width;
+        UINT height;
+        Microsoft::WRL::ComPtr<IDXGISwapChain4> swapChain;
+        Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> rtvHeap;
+        Microsoft::WRL::ComPtr<ID3D12Resource> renderTargets[FrameCount];
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocators[FrameCount]; // Per frame in flight.
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+        UINT backBuffer;
+        HRESULT result;  // Of the last recording.
+    };
+
+    void RecordWindows();
+    HRESULT RecordWindow(UINT index);
+    void WorkerMain();
+    HRESULT WaitForFence(UINT64 value);
+
+    Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> commandQueue;
+    UINT rtvDescriptorSize = 0;
+    std::vector<std::unique_ptr<Window>> windows;
+    std::vector<ID3D12CommandList *> commandLists;
+
+    Microsoft::WRL::ComPtr<ID3D12Fence> fence;
+    UINT64 fenceValue = 0;
+    UINT64 frameFenceValues[FrameCount] = { };
+    HANDLE fenceEvent = nullptr;
+    UINT64 frameNumber = 0;
+
+    // Recording. Workers and the rendering thread take windows from nextWindow.
+    const RecordFunc *record = nullptr;
+    UINT frameSlot = 0;
+    std::atomic<UINT> nextWindow;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    UINT64 generation = 0;
+    UINT busyWorkers = 0;
+    bool stopping = false;
+};
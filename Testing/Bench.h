@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Benchmarks of the portable parts of the samples. A benchmark is a function registered
+// with BENCH(); it times its own loops with BenchTimer and prints its results with
+// ReportBench(). With --quick the runner asks for fewer iterations, so the benchmarks can
+// run as a smoke test.
+
+struct BenchCase {
+    const char *name;
+    void (*run)();
+};
+
+std::vector<BenchCase> &GetBenchCases();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char *name, void (*run)()) { GetBenchCases().push_back({ name, run }); }
+};
+
+#define BENCH(name)                                                     \
+    static void name();                                                 \
+    static BenchRegistrar name##Registrar(#name, name);                 \
+    static void name()
+
+// Scales an iteration count down for --quick runs; never below 1.
+uint64_t BenchIterations(uint64_t iterations);
+
+// Prints one result line: the benchmark, what was measured, and its value.
+void ReportBench(const char *name, const char *metric, double value, const char *unit);
+
+// Reports a wrong result, not a slow one, in printf style: the message goes to stderr and
+// the runner exits with a nonzero status, so the --quick smoke test fails.
+void ReportBenchFailure(const char *name, const char *format, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+// Keeps a computed value alive so the loop producing it is not optimized away.
+template <typename T>
+void KeepBenchValue(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchTimer {
+public:
+    BenchTimer() : start(std::chrono::steady_clock::now()) { }
+    double GetMilliseconds() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    double GetSeconds() const { return GetMilliseconds() / 1000.0; }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
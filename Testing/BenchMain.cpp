@@ -0,0 +1,57 @@
+#include "Bench.h"
+
+#include <cstdarg>
+#include <cstring>
+
+namespace {
+
+bool quick = false;
+bool failed = false;
+
+} // namespace
+
+std::vector<BenchCase> &GetBenchCases() {
+    static std::vector<BenchCase> benchCases;
+    return benchCases;
+}
+
+uint64_t BenchIterations(uint64_t iterations) {
+    if (!quick) {
+        return iterations;
+    }
+    return iterations / 100 ? iterations / 100 : 1;
+}
+
+void ReportBench(const char *name, const char *metric, double value, const char *unit) {
+    printf("%-28s %-36s %12.3f %s\n", name, metric, value, unit);
+    fflush(stdout);
+}
+
+void ReportBenchFailure(const char *name, const char *format, ...) {
+    fprintf(stderr, "%s: ", name);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    failed = true;
+}
+
+// Usage: bench [--quick] [filter]
+int main(int argc, char **argv) {
+    const char *filter = "";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    for (const BenchCase &bench : GetBenchCases()) {
+        if (strstr(bench.name, filter)) {
+            bench.run();
+        }
+    }
+    return failed ? 1 : 0;
+}
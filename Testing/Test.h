@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Minimal unit test harness for the portable parts of the samples, built on Linux with
+// CMake. A test is a function registered with TEST(); CHECK() records a failure and
+// continues, REQUIRE() records it and leaves the test. The runner takes an optional
+// substring and runs the tests whose names contain it.
+
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &GetTestCases();
+void ReportTestFailure(const char *file, int line, const std::string &message);
+
+struct TestRegistrar {
+    TestRegistrar(const char *name, void (*run)()) { GetTestCases().push_back({ name, run }); }
+};
+
+// Thrown by REQUIRE() and caught by the runner.
+struct TestAbort { };
+
+template <typename T>
+std::string FormatTestValue(const T &value) {
+    return std::to_string(value);
+}
+
+inline std::string FormatTestValue(const std::string &value) { return "\"" + value + "\""; }
+inline std::string FormatTestValue(const char *value) { return value ? FormatTestValue(std::string(value)) : "null"; }
+inline std::string FormatTestValue(bool value) { return value ? "true" : "false"; }
+
+#define TEST(name)                                                      \
+    static void name();                                                 \
+    static TestRegistrar name##Registrar(#name, name);                  \
+    static void name()
+
+#define CHECK(condition)                                                \
+    do {                                                                \
+        if (!(condition)) {                                             \
+            ReportTestFailure(__FILE__, __LINE__, #condition);          \
+        }                                                               \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                      \
+    do {                                                                \
+        auto checkActual = (actual);                                    \
+        auto checkExpected = (expected);                                \
+        if (!(checkActual == checkExpected)) {                          \
+            ReportTestFailure(__FILE__, __LINE__, std::string(#actual " == " #expected ": ") + \
+                FormatTestValue(checkActual) + " vs " + FormatTestValue(checkExpected)); \
+        }                                                               \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                         \
+    do {                                                                \
+        double checkActual = double(actual);                            \
+        double checkExpected = double(expected);                        \
+        if (!(checkActual >= checkExpected - (tolerance) && checkActual <= checkExpected + (tolerance))) { \
+            ReportTestFailure(__FILE__, __LINE__, std::string(#actual " ~= " #expected ": ") + \
+                FormatTestValue(checkActual) + " vs " + FormatTestValue(checkExpected)); \
+        }                                                               \
+    } while (0)
+
+#define REQUIRE(condition)                                              \
+    do {                                                                \
+        if (!(condition)) {                                             \
+            ReportTestFailure(__FILE__, __LINE__, #condition);          \
+            throw TestAbort();                                          \
+        }                                                               \
+    } while (0)
+
+// Directory for files written by tests, created by the runner and removed afterwards.
+const std::string &GetTestDirectory();
+
+// Reproducible pseudo-random numbers for randomized tests (xorshift64*).
+class TestRandom {
+public:
+    explicit TestRandom(uint64_t seed = 1) : state(seed ? seed : 1) { }
+
+    uint64_t Next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ull;
+    }
+    // In [0, bound).
+    uint32_t Below(uint32_t bound) { return bound ? uint32_t(Next() >> 32) % bound : 0; }
+    // In [0, 1).
+    float Unit() { return float(Next() >> 40) / float(1 << 24); }
+
+private:
+    uint64_t state;
+};
@@ -0,0 +1,69 @@
+#include "Test.h"
+
+#include <cstdlib>
+#include <exception>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int failureCount = 0;
+std::string testDirectory;
+
+void RemoveDirectory(const std::string &path) {
+    std::string command = "rm -rf '" + path + "'";
+    if (system(command.c_str()) != 0) {
+        fprintf(stderr, "Could not remove %s\n", path.c_str());
+    }
+}
+
+} // namespace
+
+std::vector<TestCase> &GetTestCases() {
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+void ReportTestFailure(const char *file, int line, const std::string &message) {
+    fprintf(stderr, "%s:%d: FAILED %s\n", file, line, message.c_str());
+    failureCount++;
+}
+
+const std::string &GetTestDirectory() {
+    return testDirectory;
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : "";
+
+    char directory[] = "/tmp/dx12testXXXXXX";
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "Could not create a test directory\n");
+        return 1;
+    }
+    testDirectory = directory;
+
+    int testCount = 0;
+    int failedTestCount = 0;
+    for (const TestCase &test : GetTestCases()) {
+        if (!strstr(test.name, filter)) {
+            continue;
+        }
+        int failuresBefore = failureCount;
+        try {
+            test.run();
+        } catch (const TestAbort &) {
+        } catch (const std::exception &e) {
+            ReportTestFailure(test.name, 0, std::string("exception: ") + e.what());
+        }
+        bool passed = failureCount == failuresBefore;
+        printf("%s %s\n", passed ? "[ OK ]" : "[FAIL]", test.name);
+        testCount++;
+        failedTestCount += passed ? 0 : 1;
+    }
+
+    RemoveDirectory(testDirectory);
+    printf("%d of %d tests passed\n", testCount - failedTestCount, testCount);
+    return failedTestCount == 0 && testCount > 0 ? 0 : 1;
+}